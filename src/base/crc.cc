@@ -0,0 +1,325 @@
+/* <base/crc.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <base/crc.h>.
+ */
+
+#include <base/crc.h>
+
+#include <cstring>
+
+#include <boost/crc.hpp>
+
+#if defined(__x86_64__) && (defined(__clang__) || (__GNUC__ >= 5))
+#define BASE_CRC_X86_64
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+using namespace Base;
+using namespace Base::Crc;
+
+/* Bit-reversed forms of the CRC32 polynomial 0x04C11DB7 and the CRC32C
+   polynomial 0x1EDC6F41. */
+static const uint32_t CRC32_POLY = 0xedb88320;
+static const uint32_t CRC32C_POLY = 0x82f63b78;
+
+namespace {
+
+  /* Lookup tables for the slice-by-8 algorithm.  Entry [0] is the usual
+     bytewise table, and entry [k] gives the effect of a byte followed by k
+     zero bytes. */
+  struct TSliceBy8Table {
+    uint32_t Table[8][256];
+
+    explicit TSliceBy8Table(uint32_t poly) {
+      for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+
+        for (size_t j = 0; j < 8; ++j) {
+          crc = (crc & 1) ? ((crc >> 1) ^ poly) : (crc >> 1);
+        }
+
+        Table[0][i] = crc;
+      }
+
+      for (size_t i = 0; i < 256; ++i) {
+        for (size_t k = 1; k < 8; ++k) {
+          uint32_t prev = Table[k - 1][i];
+          Table[k][i] = (prev >> 8) ^ Table[0][prev & 0xff];
+        }
+      }
+    }
+  };  // TSliceBy8Table
+
+  typedef uint32_t (*TCrcFn)(const void *, size_t);
+
+  struct TCrcImpl {
+    TCrcFn Fn;
+
+    const char *Name;
+  };  // TCrcImpl
+
+}  // namespace
+
+static const TSliceBy8Table &GetCrc32Table() {
+  static const TSliceBy8Table table(CRC32_POLY);
+  return table;
+}
+
+static const TSliceBy8Table &GetCrc32cTable() {
+  static const TSliceBy8Table table(CRC32C_POLY);
+  return table;
+}
+
+static inline uint64_t LoadLittleEndian64(const uint8_t *p) {
+  uint64_t result;
+  std::memcpy(&result, p, sizeof(result));
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  result = __builtin_bswap64(result);
+#endif
+
+  return result;
+}
+
+/* Update CRC register 'crc' (which holds the bitwise complement of the CRC
+   computed so far) with 'size' bytes starting at 'p'. */
+static uint32_t SliceBy8Update(const TSliceBy8Table &table, uint32_t crc,
+    const uint8_t *p, size_t size) {
+  const uint32_t (&t)[8][256] = table.Table;
+
+  for (; size >= 8; p += 8, size -= 8) {
+    uint64_t word = LoadLittleEndian64(p);
+    uint32_t lo = crc ^ static_cast<uint32_t>(word);
+    uint32_t hi = static_cast<uint32_t>(word >> 32);
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+          t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+          t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+  }
+
+  for (; size; ++p, --size) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+  }
+
+  return crc;
+}
+
+#ifdef BASE_CRC_X86_64
+
+/* Fold 64 bytes at a time with carryless multiplication, then reduce to 32
+   bits.  This follows Intel's white paper "Fast CRC Computation for Generic
+   Polynomials Using PCLMULQDQ Instruction".  'size' must be a multiple of 16
+   and at least 64.  'crc' is a CRC register as for SliceBy8Update(). */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t PclmulUpdate(uint32_t crc, const uint8_t *p, size_t size) {
+  alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+  alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+  alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+  alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+  const __m128i *in = reinterpret_cast<const __m128i *>(p);
+  __m128i x1 = _mm_loadu_si128(in);
+  __m128i x2 = _mm_loadu_si128(in + 1);
+  __m128i x3 = _mm_loadu_si128(in + 2);
+  __m128i x4 = _mm_loadu_si128(in + 3);
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+  __m128i k = _mm_load_si128(reinterpret_cast<const __m128i *>(k1k2));
+
+  for (in += 4, size -= 64; size >= 64; in += 4, size -= 64) {
+    __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    __m128i x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+    __m128i x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+    __m128i x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(in));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(in + 1));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(in + 2));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(in + 3));
+  }
+
+  /* Fold the four accumulators into one. */
+  k = _mm_load_si128(reinterpret_cast<const __m128i *>(k3k4));
+  __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  /* Fold any remaining 16-byte blocks. */
+  for (; size >= 16; ++in, size -= 16) {
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128(in)), x5);
+  }
+
+  /* Fold 128 bits down to 64. */
+  x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  k = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(k5k0));
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x00), x2);
+
+  /* Barrett reduction to 32 bits. */
+  k = _mm_load_si128(reinterpret_cast<const __m128i *>(poly));
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, k, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, k, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t Sse42Update(uint32_t crc, const uint8_t *p, size_t size) {
+  for (; size && (reinterpret_cast<uintptr_t>(p) & 7); ++p, --size) {
+    crc = _mm_crc32_u8(crc, *p);
+  }
+
+  uint64_t crc64 = crc;
+
+  for (; size >= 8; p += 8, size -= 8) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+
+  crc = static_cast<uint32_t>(crc64);
+
+  for (; size; ++p, --size) {
+    crc = _mm_crc32_u8(crc, *p);
+  }
+
+  return crc;
+}
+
+#endif  // BASE_CRC_X86_64
+
+bool Base::Crc::CpuHasPclmul() {
+#ifdef BASE_CRC_X86_64
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) &&
+      (ecx & bit_SSE4_1);
+#else
+  return false;
+#endif
+}
+
+bool Base::Crc::CpuHasSse42() {
+#ifdef BASE_CRC_X86_64
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2);
+#else
+  return false;
+#endif
+}
+
+uint32_t Base::Crc::Crc32Boost(const void *data, size_t data_size) {
+  boost::crc_32_type result;
+  result.process_bytes(data, data_size);
+  return result.checksum();
+}
+
+uint32_t Base::Crc::Crc32SliceBy8(const void *data, size_t data_size) {
+  return ~SliceBy8Update(GetCrc32Table(), ~uint32_t(0),
+      static_cast<const uint8_t *>(data), data_size);
+}
+
+uint32_t Base::Crc::Crc32Pclmul(const void *data, size_t data_size) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  uint32_t crc = ~uint32_t(0);
+
+#ifdef BASE_CRC_X86_64
+  if (data_size >= 64) {
+    size_t chunk_size = data_size & ~size_t(15);
+    crc = PclmulUpdate(crc, p, chunk_size);
+    p += chunk_size;
+    data_size -= chunk_size;
+  }
+#endif
+
+  return ~SliceBy8Update(GetCrc32Table(), crc, p, data_size);
+}
+
+uint32_t Base::Crc::Crc32cSliceBy8(const void *data, size_t data_size) {
+  return ~SliceBy8Update(GetCrc32cTable(), ~uint32_t(0),
+      static_cast<const uint8_t *>(data), data_size);
+}
+
+uint32_t Base::Crc::Crc32cSse42(const void *data, size_t data_size) {
+#ifdef BASE_CRC_X86_64
+  return ~Sse42Update(~uint32_t(0), static_cast<const uint8_t *>(data),
+      data_size);
+#else
+  return Crc32cSliceBy8(data, data_size);
+#endif
+}
+
+static TCrcImpl ChooseCrc32Impl() {
+  if (CpuHasPclmul()) {
+    return TCrcImpl{&Crc32Pclmul, "pclmul"};
+  }
+
+  return TCrcImpl{&Crc32SliceBy8, "slice-by-8"};
+}
+
+static TCrcImpl ChooseCrc32cImpl() {
+  if (CpuHasSse42()) {
+    return TCrcImpl{&Crc32cSse42, "sse4.2"};
+  }
+
+  return TCrcImpl{&Crc32cSliceBy8, "slice-by-8"};
+}
+
+/* Function-local statics make the CPU check happen once, on first use, and
+   are safe if another translation unit computes a CRC during static
+   initialization. */
+static const TCrcImpl &GetCrc32Impl() {
+  static const TCrcImpl impl = ChooseCrc32Impl();
+  return impl;
+}
+
+static const TCrcImpl &GetCrc32cImpl() {
+  static const TCrcImpl impl = ChooseCrc32cImpl();
+  return impl;
+}
+
+uint32_t Base::ComputeCrc32(const void *data, size_t data_size) {
+  return GetCrc32Impl().Fn(data, data_size);
+}
+
+uint32_t Base::ComputeCrc32c(const void *data, size_t data_size) {
+  return GetCrc32cImpl().Fn(data, data_size);
+}
+
+const char *Base::GetCrc32ImplName() {
+  return GetCrc32Impl().Name;
+}
+
+const char *Base::GetCrc32cImplName() {
+  return GetCrc32cImpl().Name;
+}
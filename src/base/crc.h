@@ -16,21 +16,62 @@
    limitations under the License.
    ----------------------------------------------------------------------------
 
-   Function for computing 32-bit CRC.
+   Functions for computing 32-bit CRCs.  ComputeCrc32() computes the CRC used
+   by Kafka message format versions 0 and 1 (the same CRC that zlib and
+   Ethernet use).  ComputeCrc32c() computes the Castagnoli CRC used by newer
+   Kafka message formats.  The first call to each function chooses the fastest
+   implementation that the CPU supports.
  */
 
 #pragma once
 
 #include <cstddef>
-
-#include <boost/crc.hpp>
+#include <cstdint>
 
 namespace Base {
 
-  static inline uint32_t ComputeCrc32(const void *data, size_t data_size) {
-    boost::crc_32_type result;
-    result.process_bytes(data, data_size);
-    return result.checksum();
-  }
+  uint32_t ComputeCrc32(const void *data, size_t data_size);
+
+  uint32_t ComputeCrc32c(const void *data, size_t data_size);
+
+  /* Return a short name such as "pclmul" identifying the implementation that
+     ComputeCrc32() uses. */
+  const char *GetCrc32ImplName();
+
+  /* Return a short name such as "sse4.2" identifying the implementation that
+     ComputeCrc32c() uses. */
+  const char *GetCrc32cImplName();
+
+  /* The individual implementations are exposed below for testing and
+     benchmarking.  Normal code should call ComputeCrc32() or ComputeCrc32c()
+     instead. */
+  namespace Crc {
+
+    /* Return true if the CPU supports the PCLMULQDQ instruction (and SSE4.1,
+       which Crc32Pclmul() also uses). */
+    bool CpuHasPclmul();
+
+    /* Return true if the CPU supports the SSE4.2 CRC32 instruction. */
+    bool CpuHasSse42();
+
+    /* Reference implementation using boost::crc_32_type, which processes one
+       byte at a time. */
+    uint32_t Crc32Boost(const void *data, size_t data_size);
+
+    /* Table-driven implementation processing 8 bytes per iteration. */
+    uint32_t Crc32SliceBy8(const void *data, size_t data_size);
+
+    /* Folding implementation using carryless multiplication.  Must only be
+       called if CpuHasPclmul() returns true. */
+    uint32_t Crc32Pclmul(const void *data, size_t data_size);
+
+    /* Table-driven implementation processing 8 bytes per iteration. */
+    uint32_t Crc32cSliceBy8(const void *data, size_t data_size);
+
+    /* Implementation using the SSE4.2 CRC32 instruction.  Must only be called
+       if CpuHasSse42() returns true. */
+    uint32_t Crc32cSse42(const void *data, size_t data_size);
+
+  }  // Crc
 
 }  // Base
@@ -0,0 +1,143 @@
+/* <base/crc.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <base/crc.h>.
+ */
+
+#include <base/crc.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <boost/crc.hpp>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+using namespace Base::Crc;
+
+namespace {
+
+  typedef uint32_t (*TCrcFn)(const void *, size_t);
+
+  uint32_t Crc32cBoost(const void *data, size_t data_size) {
+    boost::crc_optimal<32, 0x1edc6f41, 0xffffffff, 0xffffffff, true, true>
+        result;
+    result.process_bytes(data, data_size);
+    return result.checksum();
+  }
+
+  std::vector<uint8_t> MakeRandomBuf(size_t size) {
+    std::vector<uint8_t> result(size);
+
+    for (uint8_t &b : result) {
+      b = static_cast<uint8_t>(std::rand());
+    }
+
+    return result;
+  }
+
+  /* Compare 'fn' against 'reference' for all lengths up to 'max_len' and
+     all alignments within a 16-byte block. */
+  void CheckEquivalent(TCrcFn fn, TCrcFn reference, size_t max_len) {
+    std::vector<uint8_t> buf = MakeRandomBuf(max_len + 16);
+
+    for (size_t offset = 0; offset < 16; ++offset) {
+      for (size_t len = 0; len <= max_len; ++len) {
+        const uint8_t *p = &buf[offset];
+        ASSERT_EQ(fn(p, len), reference(p, len)) << "offset " << offset
+            << " len " << len;
+      }
+    }
+  }
+
+  class TCrcTest : public ::testing::Test {
+    protected:
+    TCrcTest() {
+    }
+
+    virtual ~TCrcTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TCrcTest
+
+  TEST_F(TCrcTest, CheckValues) {
+    static const char data[] = "123456789";
+    size_t len = sizeof(data) - 1;
+    ASSERT_EQ(ComputeCrc32(data, len), 0xcbf43926U);
+    ASSERT_EQ(Crc32Boost(data, len), 0xcbf43926U);
+    ASSERT_EQ(Crc32SliceBy8(data, len), 0xcbf43926U);
+    ASSERT_EQ(ComputeCrc32c(data, len), 0xe3069283U);
+    ASSERT_EQ(Crc32cSliceBy8(data, len), 0xe3069283U);
+    ASSERT_EQ(ComputeCrc32(data, 0), 0U);
+    ASSERT_EQ(ComputeCrc32c(data, 0), 0U);
+  }
+
+  TEST_F(TCrcTest, Crc32SliceBy8) {
+    CheckEquivalent(&Crc32SliceBy8, &Crc32Boost, 300);
+  }
+
+  TEST_F(TCrcTest, Crc32Pclmul) {
+    if (!CpuHasPclmul()) {
+      std::cout << "Skipping test: CPU lacks PCLMULQDQ" << std::endl;
+      return;
+    }
+
+    CheckEquivalent(&Crc32Pclmul, &Crc32Boost, 300);
+    std::vector<uint8_t> buf = MakeRandomBuf(1024 * 1024 + 13);
+    ASSERT_EQ(Crc32Pclmul(&buf[0], buf.size()),
+        Crc32Boost(&buf[0], buf.size()));
+  }
+
+  TEST_F(TCrcTest, Crc32cSliceBy8) {
+    CheckEquivalent(&Crc32cSliceBy8, &Crc32cBoost, 300);
+  }
+
+  TEST_F(TCrcTest, Crc32cSse42) {
+    if (!CpuHasSse42()) {
+      std::cout << "Skipping test: CPU lacks SSE4.2" << std::endl;
+      return;
+    }
+
+    CheckEquivalent(&Crc32cSse42, &Crc32cBoost, 300);
+    std::vector<uint8_t> buf = MakeRandomBuf(1024 * 1024 + 13);
+    ASSERT_EQ(Crc32cSse42(&buf[0], buf.size()),
+        Crc32cBoost(&buf[0], buf.size()));
+  }
+
+  TEST_F(TCrcTest, Dispatch) {
+    std::vector<uint8_t> buf = MakeRandomBuf(4096 + 7);
+    ASSERT_EQ(ComputeCrc32(&buf[0], buf.size()),
+        Crc32Boost(&buf[0], buf.size()));
+    ASSERT_EQ(ComputeCrc32c(&buf[0], buf.size()),
+        Crc32cBoost(&buf[0], buf.size()));
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
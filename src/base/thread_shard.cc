@@ -0,0 +1,35 @@
+/* <base/thread_shard.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <base/thread_shard.h>.
+ */
+
+#include <base/thread_shard.h>
+
+using namespace Base;
+
+size_t TThreadShard::AssignIndex() {
+  ThreadIndex = NextIndex.fetch_add(1, std::memory_order_relaxed) % COUNT;
+  return ThreadIndex;
+}
+
+const size_t TThreadShard::COUNT;
+
+thread_local size_t TThreadShard::ThreadIndex = TThreadShard::COUNT;
+
+std::atomic<size_t> TThreadShard::NextIndex(0);
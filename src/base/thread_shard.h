@@ -0,0 +1,64 @@
+/* <base/thread_shard.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Assignment of threads to shards, for data structures split per thread to
+   avoid contention.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include <base/no_construction.h>
+
+namespace Base {
+
+  /* Data structures that many threads update, such as statistics counters,
+     can be split into COUNT shards so that threads don't contend with each
+     other.  Each thread is assigned a shard index the first time it asks for
+     one, in round-robin order, and keeps it for its lifetime.  The index is
+     the same for all such data structures, so a thread touches one shard of
+     each.  More than COUNT threads share shards, which is still correct but
+     may cost some contention. */
+  class TThreadShard final {
+    NO_CONSTRUCTION(TThreadShard);
+
+    public:
+    static const size_t COUNT = 16;
+
+    /* Return the shard index assigned to the calling thread, which is less
+       than COUNT. */
+    static size_t GetIndex() {
+      size_t index = ThreadIndex;
+      return (index < COUNT) ? index : AssignIndex();
+    }
+
+    private:
+    /* Assign the calling thread a shard index and return it. */
+    static size_t AssignIndex();
+
+    /* The shard index for the calling thread, or COUNT if the thread hasn't
+       been assigned one yet. */
+    static thread_local size_t ThreadIndex;
+
+    /* The next shard index to hand out. */
+    static std::atomic<size_t> NextIndex;
+  };  // TThreadShard
+
+}  // Base
@@ -0,0 +1,77 @@
+/* <base/thread_shard.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <base/thread_shard.h>.
+ */
+
+#include <base/thread_shard.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+
+namespace {
+
+  /* The fixture for testing class TThreadShard. */
+  class TThreadShardTest : public ::testing::Test {
+    protected:
+    TThreadShardTest() {
+    }
+
+    virtual ~TThreadShardTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TThreadShardTest
+
+  TEST_F(TThreadShardTest, Typical) {
+    size_t index = TThreadShard::GetIndex();
+    ASSERT_LT(index, TThreadShard::COUNT);
+    ASSERT_EQ(TThreadShard::GetIndex(), index);
+
+    /* Threads get indexes in round-robin order, so as many threads as there
+       are shards get distinct indexes. */
+    std::vector<size_t> indexes(TThreadShard::COUNT);
+
+    for (size_t &thread_index : indexes) {
+      std::thread t(
+          [&thread_index] {
+            thread_index = TThreadShard::GetIndex();
+          });
+      t.join();
+    }
+
+    std::set<size_t> index_set(indexes.begin(), indexes.end());
+    ASSERT_EQ(index_set.size(), TThreadShard::COUNT);
+    ASSERT_LT(*index_set.rbegin(), TThreadShard::COUNT);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
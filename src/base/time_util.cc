@@ -83,4 +83,16 @@ namespace Base {
     return (static_cast<uint64_t>(t.tv_sec) * 1000) + (t.tv_nsec / 1000000);
   }
 
+  uint64_t GetMonotonicRawMicroseconds() {
+    struct timespec t;
+    IfLt0(clock_gettime(CLOCK_MONOTONIC_RAW, &t));
+    return (static_cast<uint64_t>(t.tv_sec) * 1000000) + (t.tv_nsec / 1000);
+  }
+
+  uint64_t GetMonotonicRawNanoseconds() {
+    struct timespec t;
+    IfLt0(clock_gettime(CLOCK_MONOTONIC_RAW, &t));
+    return (static_cast<uint64_t>(t.tv_sec) * 1000000000) + t.tv_nsec;
+  }
+
 }  // Base
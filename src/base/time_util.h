@@ -54,4 +54,10 @@ namespace Base {
      past.  Uses clock_gettime() with clock type of CLOCK_MONOTONIC_RAW. */
   uint64_t GetMonotonicRawMilliseconds();
 
+  /* Same as above, but returns microseconds. */
+  uint64_t GetMonotonicRawMicroseconds();
+
+  /* Same as above, but returns nanoseconds. */
+  uint64_t GetMonotonicRawNanoseconds();
+
 }  // Base
@@ -0,0 +1,295 @@
+/* <base/timer_wheel.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <base/timer_wheel.h>.
+ */
+
+#include <base/timer_wheel.h>
+
+using namespace Base;
+
+const uint32_t TTimerWheel::NONE;
+
+const uint32_t TTimerWheel::EXPIRED;
+
+static uint32_t FindFirstSet(uint64_t bits) {
+  assert(bits);
+  return static_cast<uint32_t>(__builtin_ctzll(bits));
+}
+
+static uint32_t FindLastSet(uint64_t bits) {
+  assert(bits);
+  return static_cast<uint32_t>(63 - __builtin_clzll(bits));
+}
+
+TTimerWheel::TTimerWheel()
+    : Now(0),
+      Count(0),
+      ExpiredList(NONE) {
+}
+
+void TTimerWheel::Schedule(size_t id, uint64_t expiry) {
+  assert(this);
+  assert(id < EXPIRED);
+  Reserve(id + 1);
+  uint32_t index = static_cast<uint32_t>(id);
+
+  if (Timers[index].Level == NONE) {
+    ++Count;
+  } else {
+    Unlink(index);
+  }
+
+  Timers[index].Expiry = expiry;
+  Insert(index);
+}
+
+void TTimerWheel::Cancel(size_t id) {
+  assert(this);
+
+  if (IsScheduled(id)) {
+    uint32_t index = static_cast<uint32_t>(id);
+    Unlink(index);
+    Timers[index].Level = NONE;
+    assert(Count);
+    --Count;
+  }
+}
+
+TOpt<uint64_t> TTimerWheel::GetNextExpiry() const {
+  assert(this);
+  TOpt<uint64_t> result;
+  uint32_t head = ExpiredList;
+
+  if (head == NONE) {
+    for (const TLevel &level : Levels) {
+      if (level.Occupied) {
+        head = level.Heads[FindFirstSet(level.Occupied)];
+        break;
+      }
+    }
+  }
+
+  for (uint32_t id = head; id != NONE; id = Timers[id].Next) {
+    if (result.IsUnknown()) {
+      result.MakeKnown(Timers[id].Expiry);
+    } else if (Timers[id].Expiry < *result) {
+      *result = Timers[id].Expiry;
+    }
+  }
+
+  return result;
+}
+
+TOpt<size_t> TTimerWheel::PopExpired(uint64_t now) {
+  assert(this);
+  Advance(now);
+
+  if (ExpiredList == NONE) {
+    return TOpt<size_t>();
+  }
+
+  uint32_t id = ExpiredList;
+  Unlink(id);
+  Timers[id].Level = NONE;
+  assert(Count);
+  --Count;
+  return TOpt<size_t>(id);
+}
+
+void TTimerWheel::Clear() {
+  assert(this);
+
+  for (TTimer &timer : Timers) {
+    timer = TTimer();
+  }
+
+  for (TLevel &level : Levels) {
+    level = TLevel();
+  }
+
+  ExpiredList = NONE;
+  Count = 0;
+}
+
+bool TTimerWheel::SanityCheck() const {
+  assert(this);
+  size_t count = 0;
+
+  for (uint32_t l = 0; l < NumLevels; ++l) {
+    const TLevel &level = Levels[l];
+
+    for (uint32_t s = 0; s < SlotsPerLevel; ++s) {
+      uint32_t head = level.Heads[s];
+
+      if ((head == NONE) != !(level.Occupied & (uint64_t(1) << s))) {
+        return false;
+      }
+
+      uint32_t prev = NONE;
+
+      for (uint32_t id = head; id != NONE; id = Timers[id].Next) {
+        const TTimer &timer = Timers[id];
+
+        if ((timer.Prev != prev) || (timer.Level != l) || (timer.Slot != s) ||
+            (timer.Expiry <= Now) || (GetDigit(timer.Expiry, l) != s) ||
+            (FindLastSet(timer.Expiry ^ Now) / LEVEL_BITS != l)) {
+          return false;
+        }
+
+        prev = id;
+        ++count;
+      }
+    }
+  }
+
+  uint32_t prev = NONE;
+
+  for (uint32_t id = ExpiredList; id != NONE; id = Timers[id].Next) {
+    const TTimer &timer = Timers[id];
+
+    if ((timer.Prev != prev) || (timer.Level != EXPIRED) ||
+        (timer.Expiry > Now)) {
+      return false;
+    }
+
+    prev = id;
+    ++count;
+  }
+
+  return (count == Count);
+}
+
+void TTimerWheel::Insert(uint32_t id) {
+  assert(this);
+  TTimer &timer = Timers[id];
+
+  if (timer.Expiry <= Now) {
+    PushExpired(id);
+    return;
+  }
+
+  uint32_t level = FindLastSet(timer.Expiry ^ Now) / LEVEL_BITS;
+  uint32_t slot = GetDigit(timer.Expiry, level);
+  TLevel &lev = Levels[level];
+  uint32_t &head = lev.Heads[slot];
+  timer.Level = level;
+  timer.Slot = slot;
+  timer.Prev = NONE;
+  timer.Next = head;
+
+  if (head != NONE) {
+    Timers[head].Prev = id;
+  }
+
+  head = id;
+  lev.Occupied |= uint64_t(1) << slot;
+}
+
+void TTimerWheel::Unlink(uint32_t id) {
+  assert(this);
+  TTimer &timer = Timers[id];
+  assert(timer.Level != NONE);
+
+  if (timer.Next != NONE) {
+    Timers[timer.Next].Prev = timer.Prev;
+  }
+
+  if (timer.Prev != NONE) {
+    Timers[timer.Prev].Next = timer.Next;
+  } else if (timer.Level == EXPIRED) {
+    ExpiredList = timer.Next;
+  } else {
+    TLevel &lev = Levels[timer.Level];
+    lev.Heads[timer.Slot] = timer.Next;
+
+    if (timer.Next == NONE) {
+      lev.Occupied &= ~(uint64_t(1) << timer.Slot);
+    }
+  }
+
+  timer.Prev = NONE;
+  timer.Next = NONE;
+}
+
+void TTimerWheel::PushExpired(uint32_t id) {
+  assert(this);
+  TTimer &timer = Timers[id];
+  timer.Level = EXPIRED;
+  timer.Prev = NONE;
+  timer.Next = ExpiredList;
+
+  if (ExpiredList != NONE) {
+    Timers[ExpiredList].Prev = id;
+  }
+
+  ExpiredList = id;
+}
+
+void TTimerWheel::DrainSlot(uint32_t level, uint32_t slot, bool expire) {
+  assert(this);
+  TLevel &lev = Levels[level];
+  uint32_t id = lev.Heads[slot];
+  lev.Heads[slot] = NONE;
+  lev.Occupied &= ~(uint64_t(1) << slot);
+
+  while (id != NONE) {
+    uint32_t next = Timers[id].Next;
+
+    if (expire) {
+      PushExpired(id);
+    } else {
+      Insert(id);
+    }
+
+    id = next;
+  }
+}
+
+void TTimerWheel::Advance(uint64_t now) {
+  assert(this);
+
+  if (now <= Now) {
+    return;
+  }
+
+  /* Level 'top' is the highest level whose digit changes.  Timers at higher
+     levels stay where they are.  At level 'top', timers in slots before the
+     new digit have expired, and timers in the slot for the new digit must be
+     placed again since they now share that digit with the current time.  All
+     timers at lower levels share the old digit, so they have expired. */
+  uint32_t top = FindLastSet(now ^ Now) / LEVEL_BITS;
+  uint32_t new_digit = GetDigit(now, top);
+  Now = now;
+
+  for (uint32_t level = 0; level < top; ++level) {
+    while (Levels[level].Occupied) {
+      DrainSlot(level, FindFirstSet(Levels[level].Occupied), true);
+    }
+  }
+
+  uint64_t before_mask = (uint64_t(1) << new_digit) - 1;
+
+  while (Levels[top].Occupied & before_mask) {
+    DrainSlot(top, FindFirstSet(Levels[top].Occupied), true);
+  }
+
+  if (Levels[top].Occupied & (uint64_t(1) << new_digit)) {
+    DrainSlot(top, new_digit, false);
+  }
+}
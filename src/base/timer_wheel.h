@@ -0,0 +1,200 @@
+/* <base/timer_wheel.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Hierarchical timer wheel.  Each timer is identified by a small integer ID
+   chosen by the client, and has a 64-bit expiry time in arbitrary units
+   (milliseconds in practice).  Scheduling, cancelling, and popping an expired
+   timer take constant time and do not allocate memory once the wheel has
+   seen the largest ID it will be given.  This is meant for things like batch
+   expiry, where a timer is set and cleared for each batch.
+
+   Timers live in one of 'NumLevels' levels of 'SlotsPerLevel' slots each.  A
+   timer is placed at the level given by the most significant 6-bit digit in
+   which its expiry differs from the wheel's current time, and at the slot
+   given by the value of that digit in its expiry.  Therefore all timers at a
+   given level expire later than all timers at lower levels, and the wheel
+   only needs to look at the first occupied slot of the lowest occupied level
+   to find the next expiry.  As the current time advances, timers move down
+   to lower levels until they expire.
+ */
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <base/no_copy_semantics.h>
+#include <base/opt.h>
+
+namespace Base {
+
+  class TTimerWheel final {
+    NO_COPY_SEMANTICS(TTimerWheel);
+
+    public:
+    TTimerWheel();
+
+    /* Make IDs in [0, size) usable without further memory allocation. */
+    void Reserve(size_t size) {
+      assert(this);
+
+      if (size > Timers.size()) {
+        Timers.resize(size);
+      }
+    }
+
+    bool IsEmpty() const {
+      assert(this);
+      return (Count == 0);
+    }
+
+    size_t GetCount() const {
+      assert(this);
+      return Count;
+    }
+
+    bool IsScheduled(size_t id) const {
+      assert(this);
+      return (id < Timers.size()) && (Timers[id].Level != NONE);
+    }
+
+    /* Timer 'id' must be scheduled. */
+    uint64_t GetExpiry(size_t id) const {
+      assert(this);
+      assert(IsScheduled(id));
+      return Timers[id].Expiry;
+    }
+
+    /* Schedule timer 'id' to expire at time 'expiry'.  If the timer is
+       already scheduled, it is rescheduled.  An expiry time at or before the
+       current time is allowed, and causes the timer to be returned by the
+       next call to PopExpired(). */
+    void Schedule(size_t id, uint64_t expiry);
+
+    /* Cancel timer 'id' if it is scheduled.  Otherwise do nothing. */
+    void Cancel(size_t id);
+
+    /* Return the earliest expiry time of any scheduled timer, or an unknown
+       value if no timers are scheduled.  This takes time proportional to the
+       number of timers in a single slot, which is small in practice. */
+    TOpt<uint64_t> GetNextExpiry() const;
+
+    /* Advance the current time to 'now' if it is later, and then unschedule
+       and return the ID of a timer whose expiry is at or before 'now'.
+       Return an unknown value if there is no such timer.  Expired timers are
+       not necessarily returned in order of expiry.  The current time never
+       moves backward, so if the clock steps back then timers that expire
+       before the latest value of 'now' seen are still treated as expired. */
+    TOpt<size_t> PopExpired(uint64_t now);
+
+    /* Cancel all timers. */
+    void Clear();
+
+    /* For testing. */
+    bool SanityCheck() const;
+
+    private:
+    enum { LEVEL_BITS = 6 };
+
+    enum { SlotsPerLevel = 1 << LEVEL_BITS };
+
+    /* Enough levels to cover all 64 bits of an expiry time. */
+    enum { NumLevels = (64 + LEVEL_BITS - 1) / LEVEL_BITS };
+
+    /* Marks a timer that isn't scheduled, or the end of a list. */
+    static const uint32_t NONE = static_cast<uint32_t>(-1);
+
+    /* Marks a timer that is on 'ExpiredList'. */
+    static const uint32_t EXPIRED = NONE - 1;
+
+    struct TTimer {
+      /* Links for the doubly linked list of timers in a slot. */
+      uint32_t Prev;
+
+      uint32_t Next;
+
+      /* Level and slot where the timer lives.  'Level' is NONE if the timer
+         isn't scheduled or EXPIRED if it is on 'ExpiredList'. */
+      uint32_t Level;
+
+      uint32_t Slot;
+
+      uint64_t Expiry;
+
+      TTimer()
+          : Prev(NONE),
+            Next(NONE),
+            Level(NONE),
+            Slot(0),
+            Expiry(0) {
+      }
+    };  // TTimer
+
+    struct TLevel {
+      /* Bit i is set if and only if 'Heads[i]' is a nonempty list. */
+      uint64_t Occupied;
+
+      std::array<uint32_t, SlotsPerLevel> Heads;
+
+      TLevel()
+          : Occupied(0) {
+        Heads.fill(NONE);
+      }
+    };  // TLevel
+
+    static uint32_t GetDigit(uint64_t t, uint32_t level) {
+      return static_cast<uint32_t>(t >> (level * LEVEL_BITS)) &
+          (SlotsPerLevel - 1);
+    }
+
+    /* Place timer 'id', which must be unlinked, according to its expiry and
+       the current time. */
+    void Insert(uint32_t id);
+
+    /* Remove timer 'id' from whatever list it is on, leaving it unlinked. */
+    void Unlink(uint32_t id);
+
+    void PushExpired(uint32_t id);
+
+    /* Move all timers in the given slot to 'ExpiredList' if 'expire' is true,
+       or place them again according to the current time otherwise. */
+    void DrainSlot(uint32_t level, uint32_t slot, bool expire);
+
+    void Advance(uint64_t now);
+
+    /* Current time of the wheel.  All scheduled timers not on 'ExpiredList'
+       have an expiry after this time. */
+    uint64_t Now;
+
+    /* Number of scheduled timers, including those on 'ExpiredList'. */
+    size_t Count;
+
+    /* Timer state, indexed by ID. */
+    std::vector<TTimer> Timers;
+
+    std::array<TLevel, NumLevels> Levels;
+
+    /* Head of list of timers that have expired but not yet been returned by
+       PopExpired(). */
+    uint32_t ExpiredList;
+  };  // TTimerWheel
+
+}  // Base
@@ -0,0 +1,188 @@
+/* <base/timer_wheel.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <base/timer_wheel.h>.
+ */
+
+#include <base/timer_wheel.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+
+namespace {
+
+  /* The fixture for testing class TTimerWheel. */
+  class TTimerWheelTest : public ::testing::Test {
+    protected:
+    TTimerWheelTest() {
+    }
+
+    virtual ~TTimerWheelTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TTimerWheelTest
+
+  std::set<size_t> PopAll(TTimerWheel &wheel, uint64_t now) {
+    std::set<size_t> result;
+
+    for (; ; ) {
+      TOpt<size_t> id = wheel.PopExpired(now);
+
+      if (id.IsUnknown()) {
+        break;
+      }
+
+      result.insert(*id);
+    }
+
+    return result;
+  }
+
+  TEST_F(TTimerWheelTest, BasicTest) {
+    TTimerWheel wheel;
+    ASSERT_TRUE(wheel.IsEmpty());
+    ASSERT_TRUE(wheel.GetNextExpiry().IsUnknown());
+    ASSERT_TRUE(wheel.PopExpired(1000).IsUnknown());
+    wheel.Schedule(3, 1010);
+    wheel.Schedule(0, 1500);
+    wheel.Schedule(7, 1005);
+    ASSERT_TRUE(wheel.SanityCheck());
+    ASSERT_EQ(wheel.GetCount(), 3U);
+    ASSERT_TRUE(wheel.IsScheduled(3));
+    ASSERT_FALSE(wheel.IsScheduled(1));
+    ASSERT_FALSE(wheel.IsScheduled(100));
+    ASSERT_EQ(wheel.GetExpiry(0), 1500U);
+    ASSERT_EQ(*wheel.GetNextExpiry(), 1005U);
+    ASSERT_TRUE(wheel.PopExpired(1004).IsUnknown());
+    ASSERT_TRUE(wheel.SanityCheck());
+    ASSERT_EQ(*wheel.GetNextExpiry(), 1005U);
+    std::set<size_t> expired = PopAll(wheel, 1010);
+    ASSERT_EQ(expired, std::set<size_t>({3, 7}));
+    ASSERT_TRUE(wheel.SanityCheck());
+    ASSERT_EQ(wheel.GetCount(), 1U);
+    ASSERT_EQ(*wheel.GetNextExpiry(), 1500U);
+
+    /* Reschedule to an earlier time. */
+    wheel.Schedule(0, 1200);
+    ASSERT_EQ(wheel.GetCount(), 1U);
+    ASSERT_EQ(*wheel.GetNextExpiry(), 1200U);
+    wheel.Cancel(0);
+    ASSERT_TRUE(wheel.IsEmpty());
+    ASSERT_TRUE(wheel.GetNextExpiry().IsUnknown());
+    ASSERT_TRUE(wheel.SanityCheck());
+
+    /* An expiry time that has already passed is returned right away. */
+    wheel.Schedule(5, 900);
+    ASSERT_EQ(*wheel.GetNextExpiry(), 900U);
+    TOpt<size_t> id = wheel.PopExpired(1010);
+    ASSERT_TRUE(id.IsKnown());
+    ASSERT_EQ(*id, 5U);
+    ASSERT_TRUE(wheel.IsEmpty());
+
+    wheel.Schedule(1, 5000);
+    wheel.Schedule(2, 6000);
+    wheel.Clear();
+    ASSERT_TRUE(wheel.IsEmpty());
+    ASSERT_FALSE(wheel.IsScheduled(1));
+    ASSERT_TRUE(wheel.GetNextExpiry().IsUnknown());
+    ASSERT_TRUE(wheel.SanityCheck());
+  }
+
+  TEST_F(TTimerWheelTest, RandomTest) {
+    const size_t num_ids = 200;
+    TTimerWheel wheel;
+    wheel.Reserve(num_ids);
+    std::map<size_t, uint64_t> expected;
+    uint64_t now = 1500000000000ULL;
+    std::srand(12345);
+
+    for (size_t i = 0; i < 20000; ++i) {
+      size_t id = static_cast<size_t>(std::rand()) % num_ids;
+
+      switch (std::rand() % 4) {
+        case 0:
+        case 1: {
+          /* Mix short and long time limits, so timers live at many levels. */
+          uint64_t delay = (std::rand() % 2) ?
+              static_cast<uint64_t>(std::rand() % 100) :
+              static_cast<uint64_t>(std::rand() % 10000000);
+          wheel.Schedule(id, now + delay);
+          expected[id] = now + delay;
+          break;
+        }
+        case 2: {
+          wheel.Cancel(id);
+          expected.erase(id);
+          break;
+        }
+        default: {
+          now += static_cast<uint64_t>(std::rand() % 5000);
+          std::set<size_t> expired = PopAll(wheel, now);
+          std::set<size_t> expected_expired;
+
+          for (auto iter = expected.begin(); iter != expected.end(); ) {
+            if (iter->second <= now) {
+              expected_expired.insert(iter->first);
+              iter = expected.erase(iter);
+            } else {
+              ++iter;
+            }
+          }
+
+          ASSERT_EQ(expired, expected_expired);
+          break;
+        }
+      }
+
+      ASSERT_TRUE(wheel.SanityCheck());
+      ASSERT_EQ(wheel.GetCount(), expected.size());
+      TOpt<uint64_t> next = wheel.GetNextExpiry();
+
+      if (expected.empty()) {
+        ASSERT_TRUE(next.IsUnknown());
+      } else {
+        uint64_t min_expiry = expected.begin()->second;
+
+        for (const auto &item : expected) {
+          min_expiry = std::min(min_expiry, item.second);
+        }
+
+        ASSERT_TRUE(next.IsKnown());
+        ASSERT_EQ(*next, min_expiry);
+      }
+    }
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
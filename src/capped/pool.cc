@@ -32,7 +32,8 @@ using namespace Capped;
 
 TPool::TPool(size_t block_size, size_t block_count, TSync sync_policy)
     : BlockSize(max(block_size, sizeof(TBlock))), BlockCount(block_count),
-      Guarded(sync_policy != TSync::Unguarded), FirstFreeBlock(nullptr) {
+      Guarded(sync_policy != TSync::Unguarded), FirstFreeBlock(nullptr),
+      AllocatedBlockCount(0), HighWaterMark(0) {
   /* Allocate enough storage space for all our blocks. */
   size_t size = BlockSize * BlockCount;
   Storage = new char[size];
@@ -62,6 +63,7 @@ void *TPool::Alloc() {
     throw TMemoryCapReached();
   }
 
+  CountAllocatedBlock();
   return TBlock::Unlink(FirstFreeBlock);
 }
 
@@ -86,6 +88,7 @@ TPool::TBlock *TPool::AllocList(size_t block_count) {
       }
 
       TBlock::Unlink(FirstFreeBlock)->Link(first_block);
+      CountAllocatedBlock();
     }
   }
 
@@ -122,12 +125,39 @@ void TPool::FreeList(TBlock *first_block) {
   DoFreeList(first_block);
 }
 
+size_t TPool::ResetHighWaterMark() {
+  assert(this);
+  TOpt<std::lock_guard<std::mutex>> opt_lock;
+
+  if (Guarded) {
+    opt_lock.MakeKnown(Mutex);
+  }
+
+  size_t result = HighWaterMark.load(memory_order_relaxed);
+  HighWaterMark.store(AllocatedBlockCount.load(memory_order_relaxed),
+      memory_order_relaxed);
+  return result;
+}
+
+void TPool::CountAllocatedBlock() noexcept {
+  assert(this);
+  size_t count = AllocatedBlockCount.load(memory_order_relaxed) + 1;
+  AllocatedBlockCount.store(count, memory_order_relaxed);
+
+  if (count > HighWaterMark.load(memory_order_relaxed)) {
+    HighWaterMark.store(count, memory_order_relaxed);
+  }
+}
+
 void TPool::DoFree(void *ptr) noexcept {
   assert(this);
   assert(ptr);
   assert(Storage <= ptr);
   assert(ptr < Storage + BlockSize * BlockCount);
+  assert(AllocatedBlockCount.load(memory_order_relaxed) > 0);
   new (ptr) TBlock(FirstFreeBlock);
+  AllocatedBlockCount.store(AllocatedBlockCount.load(memory_order_relaxed) - 1,
+      memory_order_relaxed);
 }
 
 void TPool::DoFreeList(TBlock *first_block) {
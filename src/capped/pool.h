@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <mutex>
@@ -128,7 +129,32 @@ namespace Capped {
       return BlockSize;
     }
 
+    /* The number of blocks currently allocated.  This may be called from any
+       thread without acquiring the mutex, so the value may be slightly out of
+       date. */
+    size_t GetAllocatedBlockCount() const {
+      assert(this);
+      return AllocatedBlockCount.load(std::memory_order_relaxed);
+    }
+
+    /* The largest number of blocks allocated at once since the pool was
+       created or ResetHighWaterMark() was last called.  Like
+       GetAllocatedBlockCount(), this may be called from any thread without
+       acquiring the mutex. */
+    size_t GetHighWaterMark() const {
+      assert(this);
+      return HighWaterMark.load(std::memory_order_relaxed);
+    }
+
+    /* Reset the high water mark to the number of blocks currently allocated,
+       and return its previous value. */
+    size_t ResetHighWaterMark();
+
     private:
+    /* Update counts for one newly allocated block.  Caller must hold the
+       mutex if 'Guarded' is true. */
+    void CountAllocatedBlock() noexcept;
+
     /* Similar to Free() but mutex is not acquired.  Assumes that 'ptr' is not
        null. */
     void DoFree(void *ptr) noexcept;
@@ -153,6 +179,15 @@ namespace Capped {
        blocks. */
     TBlock *FirstFreeBlock;
 
+    /* See accessor.  This is only modified while holding the mutex (if
+       'Guarded' is true), but is atomic so it can be read without the mutex.
+     */
+    std::atomic<size_t> AllocatedBlockCount;
+
+    /* See GetHighWaterMark().  Protected in the same way as
+       'AllocatedBlockCount'. */
+    std::atomic<size_t> HighWaterMark;
+
     /* Our storage space.  Never null. */
     char *Storage;
   };  // TPool
@@ -102,6 +102,51 @@ namespace {
     ASSERT_FALSE(TryNewPoint());
   }
 
+  TEST_F(TPoolTest, AllocatedBlockCount) {
+    TPool pool(64, 4, TPool::TSync::Mutexed);
+    ASSERT_EQ(pool.GetAllocatedBlockCount(), 0U);
+    void *block = pool.Alloc();
+    ASSERT_EQ(pool.GetAllocatedBlockCount(), 1U);
+    TPool::TBlock *list = pool.AllocList(3);
+    ASSERT_EQ(pool.GetAllocatedBlockCount(), 4U);
+    ASSERT_THROW(pool.AllocList(1), TMemoryCapReached);
+    ASSERT_EQ(pool.GetAllocatedBlockCount(), 4U);
+    pool.FreeList(list);
+    ASSERT_EQ(pool.GetAllocatedBlockCount(), 1U);
+    pool.Free(block);
+    ASSERT_EQ(pool.GetAllocatedBlockCount(), 0U);
+
+    /* A failed list allocation leaves the count unchanged. */
+    ASSERT_THROW(pool.AllocList(5), TMemoryCapReached);
+    ASSERT_EQ(pool.GetAllocatedBlockCount(), 0U);
+  }
+
+  TEST_F(TPoolTest, HighWaterMark) {
+    TPool pool(64, 8, TPool::TSync::Mutexed);
+    ASSERT_EQ(pool.GetHighWaterMark(), 0U);
+    void *block = pool.Alloc();
+    TPool::TBlock *list = pool.AllocList(3);
+    ASSERT_EQ(pool.GetHighWaterMark(), 4U);
+    pool.FreeList(list);
+    ASSERT_EQ(pool.GetAllocatedBlockCount(), 1U);
+    ASSERT_EQ(pool.GetHighWaterMark(), 4U);
+    list = pool.AllocList(2);
+    ASSERT_EQ(pool.GetHighWaterMark(), 4U);
+    ASSERT_EQ(pool.ResetHighWaterMark(), 4U);
+    ASSERT_EQ(pool.GetHighWaterMark(), 3U);
+    pool.FreeList(list);
+    pool.Free(block);
+    ASSERT_EQ(pool.GetHighWaterMark(), 3U);
+    ASSERT_EQ(pool.ResetHighWaterMark(), 3U);
+    ASSERT_EQ(pool.GetHighWaterMark(), 0U);
+
+    /* Blocks obtained by a list allocation that fails count toward the high
+       water mark, since they were briefly allocated. */
+    ASSERT_THROW(pool.AllocList(9), TMemoryCapReached);
+    ASSERT_EQ(pool.GetAllocatedBlockCount(), 0U);
+    ASSERT_EQ(pool.GetHighWaterMark(), 8U);
+  }
+
 }  // namespace
 
 int main(int argc, char **argv) {
@@ -82,8 +82,11 @@ void TAnomalyTracker::TrackDiscard(TMsg &msg, TDiscardReason reason) {
   AdvanceReportPeriod(now);
   UpdateTopicMap(FillingReport->DiscardTopicMap, std::move(topic),
                  msg.GetTimestamp());
+  TTopicTotals &totals = GetTopicTotals(msg_topic);
+  ++totals.DiscardCount;
 
   if (reason == TDiscardReason::RateLimit) {
+    ++totals.RateLimitDiscardCount;
     TRateLimitMap &rmap = FillingReport->RateLimitDiscardMap;
     auto iter = rmap.find(msg_topic);
 
@@ -104,6 +107,7 @@ void TAnomalyTracker::TrackDuplicate(const TMsg &msg) {
 
   std::lock_guard<std::mutex> lock(Mutex);
   AdvanceReportPeriod(now);
+  ++GetTopicTotals(topic).DuplicateCount;
   UpdateTopicMap(FillingReport->DuplicateTopicMap, std::move(topic),
                  msg.GetTimestamp());
 }
@@ -125,6 +129,7 @@ void TAnomalyTracker::TrackNoMemDiscard(TMsg::TTimestamp timestamp,
 
   std::lock_guard<std::mutex> lock(Mutex);
   AdvanceReportPeriod(now);
+  ++GetTopicTotals(topic).DiscardCount;
   UpdateTopicMap(FillingReport->DiscardTopicMap, std::move(topic), timestamp);
 }
 
@@ -140,6 +145,7 @@ void TAnomalyTracker::TrackMalformedMsgDiscard(const void *prefix_begin,
   std::lock_guard<std::mutex> lock(Mutex);
   AdvanceReportPeriod(now);
   ++FillingReport->MalformedMsgCount;
+  ++Totals.MalformedMsgCount;
   UpdateLruList(std::move(msg_prefix), FillingReport->MalformedMsgs,
                 MAX_MALFORMED_MSGS);
 }
@@ -160,9 +166,11 @@ void TAnomalyTracker::TrackStreamClientUncleanDisconnect(bool is_tcp,
 
   if (is_tcp) {
     ++FillingReport->TcpUncleanDisconnectCount;
+    ++Totals.TcpUncleanDisconnectCount;
     msg_list = &FillingReport->TcpUncleanDisconnectMsgs;
   } else {
     ++FillingReport->UnixStreamUncleanDisconnectCount;
+    ++Totals.UnixStreamUncleanDisconnectCount;
     msg_list = &FillingReport->UnixStreamUncleanDisconnectMsgs;
   }
 
@@ -179,6 +187,7 @@ void TAnomalyTracker::TrackUnsupportedApiKeyDiscard(
   std::lock_guard<std::mutex> lock(Mutex);
   AdvanceReportPeriod(now);
   ++FillingReport->UnsupportedApiKeyMsgCount;
+  ++Totals.UnsupportedApiKeyMsgCount;
 }
 
 void TAnomalyTracker::TrackUnsupportedMsgVersionDiscard(
@@ -191,6 +200,7 @@ void TAnomalyTracker::TrackUnsupportedMsgVersionDiscard(
   std::lock_guard<std::mutex> lock(Mutex);
   AdvanceReportPeriod(now);
   ++FillingReport->UnsupportedVersionMsgCount;
+  ++Totals.UnsupportedVersionMsgCount;
   auto result = FillingReport->UnsupportedVersionMsgs.insert(
       std::make_pair(version, 1));
 
@@ -217,6 +227,7 @@ void TAnomalyTracker::TrackBadTopicDiscard(TMsg::TTimestamp timestamp,
   std::lock_guard<std::mutex> lock(Mutex);
   AdvanceReportPeriod(now);
   ++FillingReport->BadTopicMsgCount;
+  ++Totals.BadTopicMsgCount;
   UpdateLruList(std::move(topic), FillingReport->BadTopics, MAX_BAD_TOPICS);
 }
 
@@ -229,6 +240,7 @@ void TAnomalyTracker::TrackBadTopicDiscard(TMsg &msg) {
   std::lock_guard<std::mutex> lock(Mutex);
   AdvanceReportPeriod(now);
   ++FillingReport->BadTopicMsgCount;
+  ++Totals.BadTopicMsgCount;
   UpdateLruList(std::move(topic), FillingReport->BadTopics, MAX_BAD_TOPICS);
 }
 
@@ -255,6 +267,7 @@ void TAnomalyTracker::TrackLongMsgDiscard(TMsg &msg) {
 
   std::lock_guard<std::mutex> lock(Mutex);
   AdvanceReportPeriod(now);
+  ++GetTopicTotals(topic).DiscardCount;
   UpdateLruList(std::move(tmp_msg_prefix), FillingReport->LongMsgs,
                 MAX_LONG_MSGS);
   UpdateTopicMap(FillingReport->DiscardTopicMap, std::move(topic),
@@ -273,6 +286,12 @@ TAnomalyTracker::GetInfo(TInfo &filling_report_copy) const {
   return LastFullReport;
 }
 
+void TAnomalyTracker::GetTotals(TTotals &totals) const {
+  assert(this);
+  std::lock_guard<std::mutex> lock(Mutex);
+  totals = Totals;
+}
+
 void TAnomalyTracker::CheckGetInfoRate() const {
   assert(this);
   uint64_t now = ClockFn();
@@ -376,3 +395,19 @@ void TAnomalyTracker::UpdateTopicMap(TMap &topic_map, std::string &&topic,
     interval.Last = timestamp;
   }
 }
+
+TAnomalyTracker::TTopicTotals &TAnomalyTracker::GetTopicTotals(
+    const std::string &topic) {
+  assert(this);
+  auto iter = Totals.Topics.find(topic);
+
+  if (iter != Totals.Topics.end()) {
+    return iter->second;
+  }
+
+  if (Totals.Topics.size() >= MAX_TOTALS_TOPICS) {
+    return Totals.OtherTopics;
+  }
+
+  return Totals.Topics[topic];
+}
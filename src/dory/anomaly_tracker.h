@@ -222,6 +222,61 @@ namespace Dory {
       }
     };  // TInfo
 
+    /* Per-topic anomaly counts accumulated since startup. */
+    struct TTopicTotals {
+      /* Discarded messages with valid topics. */
+      uint64_t DiscardCount;
+
+      /* Messages discarded due to rate limiting.  These are also included in
+         'DiscardCount'. */
+      uint64_t RateLimitDiscardCount;
+
+      /* Possibly duplicated messages. */
+      uint64_t DuplicateCount;
+
+      TTopicTotals()
+          : DiscardCount(0),
+            RateLimitDiscardCount(0),
+            DuplicateCount(0) {
+      }
+    };  // TTopicTotals
+
+    /* Anomaly counts accumulated since startup.  Unlike TInfo, these are
+       never reset, so they are suitable for monitoring systems that compute
+       rates from counters. */
+    struct TTotals {
+      /* Keys are topics.  To bound memory usage, at most MAX_TOTALS_TOPICS
+         topics are tracked.  Counts for topics beyond that are added to
+         'OtherTopics'. */
+      std::map<std::string, TTopicTotals> Topics;
+
+      TTopicTotals OtherTopics;
+
+      uint64_t MalformedMsgCount;
+
+      uint64_t UnixStreamUncleanDisconnectCount;
+
+      uint64_t TcpUncleanDisconnectCount;
+
+      uint64_t UnsupportedApiKeyMsgCount;
+
+      uint64_t UnsupportedVersionMsgCount;
+
+      uint64_t BadTopicMsgCount;
+
+      TTotals()
+          : MalformedMsgCount(0),
+            UnixStreamUncleanDisconnectCount(0),
+            TcpUncleanDisconnectCount(0),
+            UnsupportedApiKeyMsgCount(0),
+            UnsupportedVersionMsgCount(0),
+            BadTopicMsgCount(0) {
+      }
+    };  // TTotals
+
+    /* The maximum number of topics to keep totals for.  See TTotals. */
+    static const size_t MAX_TOTALS_TOPICS = 10000;
+
     using TClockFn = std::function<uint64_t()>;
     using TDiscardReason = TDiscardFileLogger::TDiscardReason;
 
@@ -335,6 +390,11 @@ namespace Dory {
        error if we are not. */
     void CheckGetInfoRate() const;
 
+    /* Copy the anomaly counts accumulated since startup into 'totals'.  Unlike
+       GetInfo(), this doesn't count as a discard query for
+       CheckGetInfoRate(). */
+    void GetTotals(TTotals &totals) const;
+
     /* Return the reporting interval length in seconds. */
     size_t GetReportInterval() const {
       assert(this);
@@ -353,6 +413,9 @@ namespace Dory {
     void UpdateTopicMap(TMap &topic_map, std::string &&topic,
                         TMsg::TTimestamp timestamp);
 
+    /* Caller must hold 'Mutex'.  Return the totals entry for 'topic'. */
+    TTopicTotals &GetTopicTotals(const std::string &topic);
+
     TDiscardFileLogger &DiscardFileLogger;
 
     /* Value is in seconds. */
@@ -365,12 +428,15 @@ namespace Dory {
     /* Value is in seconds since the epoch. */
     mutable std::atomic<uint64_t> LastGetInfoTime;
 
-    /* Protects 'LastFullReport' and 'FillingReport'. */
+    /* Protects 'LastFullReport', 'FillingReport', and 'Totals'. */
     mutable std::mutex Mutex;
 
     mutable std::shared_ptr<const TInfo> LastFullReport;
 
     mutable std::unique_ptr<TInfo> FillingReport;
+
+    /* See GetTotals(). */
+    TTotals Totals;
   };  // TAnomalyTracker
 
 }  // Dory
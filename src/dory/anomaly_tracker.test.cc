@@ -502,6 +502,41 @@ namespace {
     ASSERT_EQ(TAnomalyTracker::GetNoDiscardQueryCount(), 2U);
   }
 
+  TEST_F(TAnomalyTrackerTest, GetTotalsTest) {
+    TAnomalyTrackerConfig cfg(10);
+    TAnomalyTracker &tracker = cfg.AnomalyTracker;
+    TMsg::TPtr msg1 = cfg.NewMsg("t1", "msg 1");
+    TMsg::TPtr msg2 = cfg.NewMsg("t2", "msg 2");
+    tracker.TrackDiscard(msg1, TAnomalyTracker::TDiscardReason::KafkaErrorAck);
+    tracker.TrackDiscard(msg1, TAnomalyTracker::TDiscardReason::RateLimit);
+    tracker.TrackDuplicate(msg2);
+    std::string bad("bad");
+    tracker.TrackMalformedMsgDiscard(bad.data(), bad.data() + bad.size());
+    tracker.TrackStreamClientUncleanDisconnect(true, bad.data(),
+        bad.data() + bad.size());
+
+    /* Totals carry across reporting intervals. */
+    cfg.Clock = 25;
+    tracker.TrackDiscard(msg1, TAnomalyTracker::TDiscardReason::KafkaErrorAck);
+    tracker.TrackBadTopicDiscard(msg2);
+
+    TAnomalyTracker::TTotals totals;
+    tracker.GetTotals(totals);
+    ASSERT_EQ(totals.Topics.size(), 2U);
+    const TAnomalyTracker::TTopicTotals &t1 = totals.Topics["t1"];
+    ASSERT_EQ(t1.DiscardCount, 3U);
+    ASSERT_EQ(t1.RateLimitDiscardCount, 1U);
+    ASSERT_EQ(t1.DuplicateCount, 0U);
+    const TAnomalyTracker::TTopicTotals &t2 = totals.Topics["t2"];
+    ASSERT_EQ(t2.DiscardCount, 0U);
+    ASSERT_EQ(t2.DuplicateCount, 1U);
+    ASSERT_EQ(totals.OtherTopics.DiscardCount, 0U);
+    ASSERT_EQ(totals.MalformedMsgCount, 1U);
+    ASSERT_EQ(totals.TcpUncleanDisconnectCount, 1U);
+    ASSERT_EQ(totals.UnixStreamUncleanDisconnectCount, 0U);
+    ASSERT_EQ(totals.BadTopicMsgCount, 1U);
+  }
+
 }  // namespace
 
 int main(int argc, char **argv) {
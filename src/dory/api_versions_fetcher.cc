@@ -0,0 +1,157 @@
+/* <dory/api_versions_fetcher.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/api_versions_fetcher.h>.
+ */
+
+#include <dory/api_versions_fetcher.h>
+
+#include <cerrno>
+#include <system_error>
+
+#include <syslog.h>
+
+#include <base/io_utils.h>
+#include <dory/kafka_proto/api_versions/api_versions_request_writer.h>
+#include <dory/kafka_proto/api_versions/api_versions_response_reader.h>
+#include <dory/kafka_proto/errors.h>
+#include <dory/kafka_proto/kafka_error_code.h>
+#include <dory/kafka_proto/request_response.h>
+#include <dory/util/system_error_codes.h>
+#include <server/counter.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::KafkaProto;
+using namespace Dory::KafkaProto::ApiVersions;
+using namespace Dory::Util;
+
+SERVER_COUNTER(ApiVersionsBadResponse);
+SERVER_COUNTER(ApiVersionsErrorResponse);
+SERVER_COUNTER(ApiVersionsFetchSuccess);
+SERVER_COUNTER(ApiVersionsLostTcpConnection);
+SERVER_COUNTER(ApiVersionsNotSupported);
+SERVER_COUNTER(ApiVersionsTimedOut);
+SERVER_COUNTER(ApiVersionsUnexpectedCorrelationId);
+
+TApiVersionsFetcher::TResult
+TApiVersionsFetcher::Fetch(const TFd &sock, int timeout_ms) {
+  assert(this);
+  assert(sock.IsOpen());
+  Apis.clear();
+  TApiVersionsRequestWriter().WriteRequest(Buf, 0);
+
+  try {
+    if (!TryWriteExactly(sock, &Buf[0], Buf.size(), timeout_ms)) {
+      ApiVersionsNotSupported.Increment();
+      return TResult::NotSupported;
+    }
+
+    Buf.resize(REQUEST_OR_RESPONSE_SIZE_SIZE);
+
+    /* A broker that doesn't know about ApiVersions requests closes the
+       connection without responding. */
+    if (!TryReadExactly(sock, &Buf[0], Buf.size(), timeout_ms)) {
+      ApiVersionsNotSupported.Increment();
+      return TResult::NotSupported;
+    }
+
+    size_t response_size = GetRequestOrResponseSize(&Buf[0]);
+
+    if (response_size < TApiVersionsResponseReader::MinSize()) {
+      ApiVersionsBadResponse.Increment();
+      syslog(LOG_ERR, "Got ApiVersions response with bad size %lu",
+          static_cast<unsigned long>(response_size));
+      return TResult::Error;
+    }
+
+    Buf.resize(response_size);
+
+    if (!TryReadExactly(sock, &Buf[REQUEST_OR_RESPONSE_SIZE_SIZE],
+        Buf.size() - REQUEST_OR_RESPONSE_SIZE_SIZE, timeout_ms)) {
+      ApiVersionsLostTcpConnection.Increment();
+      syslog(LOG_ERR, "Lost TCP connection to broker while reading "
+          "ApiVersions response");
+      return TResult::Error;
+    }
+  } catch (const std::system_error &x) {
+    if (x.code().value() == ETIMEDOUT) {
+      ApiVersionsTimedOut.Increment();
+      syslog(LOG_ERR, "Timed out waiting for ApiVersions response");
+      return TResult::Error;
+    }
+
+    if (LostTcpConnection(x)) {
+      /* Treat a reset as an old broker rejecting the request.  If the broker
+         really went away, the caller's reconnect attempt will fail. */
+      ApiVersionsNotSupported.Increment();
+      return TResult::NotSupported;
+    }
+
+    throw;  // anything else is fatal
+  } catch (const TUnexpectedEnd &) {
+    ApiVersionsLostTcpConnection.Increment();
+    syslog(LOG_ERR, "Lost TCP connection to broker while reading ApiVersions "
+        "response");
+    return TResult::Error;
+  } catch (const TBadRequestOrResponseSize &) {
+    ApiVersionsBadResponse.Increment();
+    syslog(LOG_ERR, "Got ApiVersions response with bad size");
+    return TResult::Error;
+  }
+
+  try {
+    TApiVersionsResponseReader reader(&Buf[0], Buf.size());
+
+    if (reader.GetCorrelationId() != 0) {
+      ApiVersionsUnexpectedCorrelationId.Increment();
+      syslog(LOG_ERR, "Got ApiVersions response with unexpected correlation "
+          "ID %d", static_cast<int>(reader.GetCorrelationId()));
+      return TResult::Error;
+    }
+
+    int16_t error_code = reader.GetErrorCode();
+
+    if (error_code != TKafkaErrorCode::None) {
+      /* The connection remains usable, but treat this like an old broker and
+         fall back to default API versions. */
+      ApiVersionsErrorResponse.Increment();
+      syslog(LOG_WARNING, "Got ApiVersions response with error code %d: "
+          "using default API versions", static_cast<int>(error_code));
+      return TResult::NotSupported;
+    }
+
+    Apis = reader.GetAllApis();
+  } catch (const TApiVersionsResponseReader::TBadApiVersionsResponse &x) {
+    ApiVersionsBadResponse.Increment();
+    syslog(LOG_ERR, "Failed to parse ApiVersions response: %s", x.what());
+    return TResult::Error;
+  }
+
+  ApiVersionsFetchSuccess.Increment();
+  return TResult::Ok;
+}
+
+TOpt<size_t> TApiVersionsFetcher::ChooseVersion(TApiKey api_key,
+    const std::vector<size_t> &supported) const {
+  assert(this);
+  const TApiVersionRange *range = FindApiVersionRange(Apis,
+      static_cast<int16_t>(api_key));
+  return range ? ChooseHighestCommonVersion(supported, *range) :
+      TOpt<size_t>();
+}
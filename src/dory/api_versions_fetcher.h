@@ -0,0 +1,85 @@
+/* <dory/api_versions_fetcher.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for asking a Kafka broker which API versions it supports, using the
+   ApiVersions request introduced in Kafka 0.10.0.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <base/fd.h>
+#include <base/no_copy_semantics.h>
+#include <base/opt.h>
+#include <dory/kafka_proto/api_key.h>
+#include <dory/kafka_proto/api_versions/api_version_range.h>
+
+namespace Dory {
+
+  class TApiVersionsFetcher final {
+    NO_COPY_SEMANTICS(TApiVersionsFetcher);
+
+    public:
+    enum class TResult {
+      /* Broker responded with its supported API versions. */
+      Ok,
+
+      /* Broker predates the ApiVersions request (Kafka < 0.10.0).  Brokers
+         of this vintage close the connection when they get a request with an
+         unknown API key, so the caller must reconnect before sending anything
+         else.  Fall back to default API versions. */
+      NotSupported,
+
+      /* Communication failed (timeout, lost connection after partial
+         response, or malformed response). */
+      Error
+    };  // TResult
+
+    TApiVersionsFetcher() = default;
+
+    /* Send an ApiVersions request on connected socket 'sock' and read the
+       response.  Timeout is specified in milliseconds.  A negative timeout
+       value means "infinite timeout". */
+    TResult Fetch(const Base::TFd &sock, int timeout_ms);
+
+    /* Return the API version ranges obtained by the last successful call to
+       Fetch(). */
+    const std::vector<KafkaProto::ApiVersions::TApiVersionRange> &
+    GetApis() const {
+      assert(this);
+      return Apis;
+    }
+
+    /* Return the highest version in 'supported' (sorted in ascending order)
+       that the broker also supports for API 'api_key', according to the last
+       successful call to Fetch().  Result is unknown if the broker doesn't
+       advertise the API, or there is no version in common. */
+    Base::TOpt<size_t> ChooseVersion(KafkaProto::TApiKey api_key,
+        const std::vector<size_t> &supported) const;
+
+    private:
+    std::vector<KafkaProto::ApiVersions::TApiVersionRange> Apis;
+
+    std::vector<uint8_t> Buf;
+  };  // TApiVersionsFetcher
+
+}  // Dory
@@ -0,0 +1,166 @@
+/* <dory/batch/batch_auto_tuner.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/batch/batch_auto_tuner.h>.
+ */
+
+#include <dory/batch/batch_auto_tuner.h>
+
+#include <algorithm>
+
+#include <syslog.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Batch;
+
+/* Weight given to the newest rate sample when updating a smoothed rate. */
+static const double RATE_SMOOTHING = 0.25;
+
+/* Return true if 'new_value' differs from 'old_value' by more than 20%.  This
+   keeps the tuner from making many small adjustments as rates fluctuate. */
+static bool IsSignificantChange(size_t old_value, size_t new_value) {
+  size_t diff = (new_value > old_value) ?
+      (new_value - old_value) : (old_value - new_value);
+  return (diff * 5) > old_value;
+}
+
+TBatchAutoTuner::TBatchAutoTuner(const TParams &params)
+    : Params(params),
+      LastTuneTime(0),
+      NextTuneTime(0) {
+}
+
+std::vector<std::pair<std::string, TBatchConfig>>
+TBatchAutoTuner::Tune(TMsg::TTimestamp now, size_t ack_latency,
+    const TPerTopicBatcher::TConfig &config) {
+  assert(this);
+  std::vector<std::pair<std::string, TBatchConfig>> result;
+  NextTuneTime = now + std::max<TMsg::TTimestamp>(Params.Interval, 1);
+
+  if ((LastTuneTime == 0) || (now <= LastTuneTime)) {
+    /* Start the first measurement interval. */
+    for (auto &item : TopicStates) {
+      item.second.MsgCount = 0;
+      item.second.ByteCount = 0;
+    }
+
+    LastTuneTime = now;
+    return std::move(result);
+  }
+
+  double elapsed = static_cast<double>(now - LastTuneTime);
+  LastTuneTime = now;
+  std::vector<TDecision> decisions;
+
+  for (auto &item : TopicStates) {
+    const std::string &topic = item.first;
+    TTopicState &state = item.second;
+    double msg_rate = static_cast<double>(state.MsgCount) / elapsed;
+    double byte_rate = static_cast<double>(state.ByteCount) / elapsed;
+    state.MsgCount = 0;
+    state.ByteCount = 0;
+
+    if (state.OptConfig.IsKnown()) {
+      state.MsgRate += RATE_SMOOTHING * (msg_rate - state.MsgRate);
+      state.ByteRate += RATE_SMOOTHING * (byte_rate - state.ByteRate);
+    } else {
+      state.MsgRate = msg_rate;
+      state.ByteRate = byte_rate;
+    }
+
+    const TBatchConfig &base = config.Get(topic);
+
+    if (!BatchingIsEnabled(base)) {
+      continue;
+    }
+
+    TBatchConfig new_config = ComputeConfig(state, base, ack_latency);
+
+    if (state.OptConfig.IsUnknown() ||
+        IsSignificantChange(state.OptConfig->TimeLimit,
+            new_config.TimeLimit) ||
+        IsSignificantChange(state.OptConfig->ByteCount,
+            new_config.ByteCount)) {
+      syslog(LOG_INFO, "Batch auto-tuning topic [%s]: time limit %lu ms, "
+          "byte limit %lu, message rate %.1f/s, byte rate %.1f/s",
+          topic.c_str(), static_cast<unsigned long>(new_config.TimeLimit),
+          static_cast<unsigned long>(new_config.ByteCount),
+          state.MsgRate * 1000.0, state.ByteRate * 1000.0);
+      state.OptConfig = new_config;
+      result.push_back(std::make_pair(topic, new_config));
+    }
+
+    TDecision decision;
+    decision.Topic = topic;
+    decision.MsgRate = state.MsgRate * 1000.0;
+    decision.ByteRate = state.ByteRate * 1000.0;
+    decision.TimeLimit = state.OptConfig->TimeLimit;
+    decision.ByteCount = state.OptConfig->ByteCount;
+    decisions.push_back(std::move(decision));
+  }
+
+  std::sort(decisions.begin(), decisions.end(),
+      [](const TDecision &x, const TDecision &y) {
+        return x.Topic < y.Topic;
+      });
+
+  std::lock_guard<std::mutex> lock(Mutex);
+  Decisions = std::move(decisions);
+  return std::move(result);
+}
+
+std::vector<TBatchAutoTuner::TDecision>
+TBatchAutoTuner::GetDecisions() const {
+  assert(this);
+  std::lock_guard<std::mutex> lock(Mutex);
+  return Decisions;
+}
+
+TBatchConfig TBatchAutoTuner::ComputeConfig(const TTopicState &state,
+    const TBatchConfig &base, size_t ack_latency) const {
+  assert(this);
+  size_t min_time = std::max<size_t>(Params.MinTimeLimit, 1);
+  size_t max_time = std::max(Params.MaxTimeLimit, min_time);
+  size_t time_limit = min_time;
+
+  /* Waiting only pays off if we expect at least two messages within the
+     maximum time limit. */
+  if ((state.MsgRate * static_cast<double>(max_time)) >= 2.0) {
+    double fill_time = static_cast<double>(Params.TargetBytes) /
+        std::max(state.ByteRate, 1e-9);
+    time_limit = (fill_time >= static_cast<double>(max_time)) ?
+        max_time : std::max(static_cast<size_t>(fill_time), min_time);
+
+    /* While the broker takes this long to ACK a request, sending batches
+       more often mainly adds requests without reducing latency much. */
+    time_limit = std::max(time_limit, std::min(ack_latency, max_time));
+  }
+
+  size_t byte_count = std::max<size_t>(Params.TargetBytes,
+      static_cast<size_t>(state.ByteRate * static_cast<double>(min_time)));
+
+  if (Params.MaxBytes) {
+    byte_count = std::min(byte_count, Params.MaxBytes);
+  }
+
+  TBatchConfig result(base);
+  result.TimeLimit = time_limit;
+  result.ByteCount = std::max<size_t>(byte_count, 1);
+  return result;
+}
@@ -0,0 +1,193 @@
+/* <dory/batch/batch_auto_tuner.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for adjusting per-topic batching thresholds based on observed message
+   arrival rates and ACK latency.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <base/no_copy_semantics.h>
+#include <base/opt.h>
+#include <dory/batch/batch_config.h>
+#include <dory/batch/per_topic_batcher.h>
+#include <dory/msg.h>
+
+namespace Dory {
+
+  namespace Batch {
+
+    /* The router thread feeds this with the sizes of AnyPartition messages
+       that undergo per-topic batching.  Every 'Interval' milliseconds, it
+       computes a new time limit and byte limit for each such topic.  The
+       time limit is the time we expect it to take for a batch to reach the
+       target size, bounded by a minimum and maximum.  Topics that we expect
+       to get fewer than two messages within the maximum time limit get the
+       minimum time limit, since waiting would not let them form batches. */
+    class TBatchAutoTuner final {
+      NO_COPY_SEMANTICS(TBatchAutoTuner);
+
+      public:
+      struct TParams {
+        /* A false value means that the tuner does nothing. */
+        bool Enable;
+
+        /* Batch data size (keys and values) that we aim for. */
+        size_t TargetBytes;
+
+        /* Bounds for the time limit in milliseconds. */
+        size_t MinTimeLimit;
+
+        size_t MaxTimeLimit;
+
+        /* The byte limit never exceeds this.  It is the produce request data
+           limit. */
+        size_t MaxBytes;
+
+        /* Milliseconds between tuning decisions. */
+        size_t Interval;
+
+        TParams()
+            : Enable(false),
+              TargetBytes(0),
+              MinTimeLimit(0),
+              MaxTimeLimit(0),
+              MaxBytes(0),
+              Interval(0) {
+        }
+      };  // TParams
+
+      /* The current tuning state for a single topic. */
+      struct TDecision {
+        std::string Topic;
+
+        /* Smoothed arrival rates per second. */
+        double MsgRate;
+
+        double ByteRate;
+
+        /* Chosen limits. */
+        size_t TimeLimit;
+
+        size_t ByteCount;
+
+        TDecision()
+            : MsgRate(0),
+              ByteRate(0),
+              TimeLimit(0),
+              ByteCount(0) {
+        }
+      };  // TDecision
+
+      explicit TBatchAutoTuner(const TParams &params);
+
+      bool IsEnabled() const {
+        assert(this);
+        return Params.Enable;
+      }
+
+      /* Called by router thread for each message that undergoes per-topic
+         batching.  'size' is the message key and value size. */
+      void RecordMsg(const std::string &topic, size_t size) {
+        assert(this);
+        TTopicState &state = TopicStates[topic];
+        ++state.MsgCount;
+        state.ByteCount += size;
+      }
+
+      /* Called by router thread when a topic is no longer present in the
+         metadata.  Forget all tuning state for the topic. */
+      void DeleteTopic(const std::string &topic) {
+        assert(this);
+        TopicStates.erase(topic);
+      }
+
+      /* Return true if it is time to call Tune(). */
+      bool IsDue(TMsg::TTimestamp now) const {
+        assert(this);
+        return Params.Enable && (now >= NextTuneTime);
+      }
+
+      /* Called by router thread.  Compute new limits for each topic seen
+         since the last call, starting from its configured batching settings
+         in 'config'.  'ack_latency' is the worst recent ACK latency over all
+         brokers in milliseconds.  Return the topics and batch configs to
+         apply to the per-topic batcher.  Changes in limits are logged. */
+      std::vector<std::pair<std::string, TBatchConfig>>
+      Tune(TMsg::TTimestamp now, size_t ack_latency,
+          const TPerTopicBatcher::TConfig &config);
+
+      /* Return a snapshot of the current decisions.  May be called by any
+         thread. */
+      std::vector<TDecision> GetDecisions() const;
+
+      private:
+      struct TTopicState {
+        /* Counts since the last call to Tune(). */
+        size_t MsgCount;
+
+        size_t ByteCount;
+
+        /* Smoothed arrival rates per millisecond. */
+        double MsgRate;
+
+        double ByteRate;
+
+        /* Limits chosen by the last call to Tune(), if any. */
+        Base::TOpt<TBatchConfig> OptConfig;
+
+        TTopicState()
+            : MsgCount(0),
+              ByteCount(0),
+              MsgRate(0),
+              ByteRate(0) {
+        }
+      };  // TTopicState
+
+      /* Compute the limits for a topic, starting from 'base'. */
+      TBatchConfig ComputeConfig(const TTopicState &state,
+          const TBatchConfig &base, size_t ack_latency) const;
+
+      const TParams Params;
+
+      /* Key is topic.  Only accessed by router thread. */
+      std::unordered_map<std::string, TTopicState> TopicStates;
+
+      TMsg::TTimestamp LastTuneTime;
+
+      TMsg::TTimestamp NextTuneTime;
+
+      /* Protects 'Decisions'. */
+      mutable std::mutex Mutex;
+
+      /* Snapshot of tuning state for reporting through the web interface. */
+      std::vector<TDecision> Decisions;
+    };  // TBatchAutoTuner
+
+  }  // Batch
+
+}  // Dory
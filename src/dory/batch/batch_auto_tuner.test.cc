@@ -0,0 +1,206 @@
+/* <dory/batch/batch_auto_tuner.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/batch/batch_auto_tuner.h>
+ */
+
+#include <dory/batch/batch_auto_tuner.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <dory/batch/batch_config.h>
+#include <dory/batch/per_topic_batcher.h>
+
+#include <gtest/gtest.h>
+
+using namespace Dory;
+using namespace Dory::Batch;
+
+namespace {
+
+  TBatchAutoTuner::TParams MakeParams() {
+    TBatchAutoTuner::TParams params;
+    params.Enable = true;
+    params.TargetBytes = 10000;
+    params.MinTimeLimit = 1;
+    params.MaxTimeLimit = 1000;
+    params.MaxBytes = 50000;
+    params.Interval = 1000;
+    return params;
+  }
+
+  TPerTopicBatcher::TConfig MakeConfig() {
+    std::unordered_map<std::string, TBatchConfig> per_topic;
+    per_topic.insert(std::make_pair(std::string("disabled"), TBatchConfig()));
+    return TPerTopicBatcher::TConfig(TBatchConfig(100, 50, 0),
+        std::move(per_topic));
+  }
+
+  /* The fixture for testing class TBatchAutoTuner. */
+  class TBatchAutoTunerTest : public ::testing::Test {
+    protected:
+    TBatchAutoTunerTest() {
+    }
+
+    virtual ~TBatchAutoTunerTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TBatchAutoTunerTest
+
+  TEST_F(TBatchAutoTunerTest, DisabledTest) {
+    TBatchAutoTuner::TParams params = MakeParams();
+    params.Enable = false;
+    TBatchAutoTuner tuner(params);
+    ASSERT_FALSE(tuner.IsEnabled());
+    ASSERT_FALSE(tuner.IsDue(1000000));
+  }
+
+  TEST_F(TBatchAutoTunerTest, BasicTest) {
+    TBatchAutoTuner tuner(MakeParams());
+    TPerTopicBatcher::TConfig config = MakeConfig();
+    ASSERT_TRUE(tuner.IsEnabled());
+    ASSERT_TRUE(tuner.IsDue(1000));
+
+    /* The first call starts the measurement interval. */
+    auto changes = tuner.Tune(1000, 0, config);
+    ASSERT_TRUE(changes.empty());
+    ASSERT_FALSE(tuner.IsDue(1999));
+    ASSERT_TRUE(tuner.IsDue(2000));
+
+    /* "fast" gets 1000 bytes/ms, so a 10000 byte batch fills in 10 ms.
+       "slow" gets 10 bytes/ms, and would need 1000 ms.  "trickle" gets a
+       single message, which is too few to batch.  "disabled" has batching
+       disabled in the config, so it is left alone. */
+    for (size_t i = 0; i < 10000; ++i) {
+      tuner.RecordMsg("fast", 100);
+    }
+
+    for (size_t i = 0; i < 100; ++i) {
+      tuner.RecordMsg("slow", 100);
+    }
+
+    tuner.RecordMsg("trickle", 100);
+    tuner.RecordMsg("disabled", 100);
+    changes = tuner.Tune(2000, 0, config);
+    ASSERT_EQ(changes.size(), 3U);
+    std::unordered_map<std::string, TBatchConfig> change_map(changes.begin(),
+        changes.end());
+    ASSERT_EQ(change_map.count("disabled"), 0U);
+    const TBatchConfig &fast = change_map["fast"];
+    ASSERT_EQ(fast.TimeLimit, 10U);
+    ASSERT_EQ(fast.ByteCount, 10000U);
+    ASSERT_EQ(fast.MsgCount, 50U);
+    const TBatchConfig &slow = change_map["slow"];
+    ASSERT_EQ(slow.TimeLimit, 1000U);
+    ASSERT_EQ(slow.ByteCount, 10000U);
+    const TBatchConfig &trickle = change_map["trickle"];
+    ASSERT_EQ(trickle.TimeLimit, 1U);
+
+    auto decisions = tuner.GetDecisions();
+    ASSERT_EQ(decisions.size(), 3U);
+    ASSERT_EQ(decisions[0].Topic, "fast");
+    ASSERT_EQ(decisions[0].TimeLimit, 10U);
+    ASSERT_EQ(decisions[0].MsgRate, 10000.0);
+    ASSERT_EQ(decisions[1].Topic, "slow");
+    ASSERT_EQ(decisions[2].Topic, "trickle");
+
+    /* Same traffic again: nothing changes. */
+    for (size_t i = 0; i < 10000; ++i) {
+      tuner.RecordMsg("fast", 100);
+    }
+
+    for (size_t i = 0; i < 100; ++i) {
+      tuner.RecordMsg("slow", 100);
+    }
+
+    tuner.RecordMsg("trickle", 100);
+    changes = tuner.Tune(3000, 0, config);
+    ASSERT_TRUE(changes.empty());
+
+    /* A slow broker raises the time limit for "fast", since sending more
+       often would not help. */
+    for (size_t i = 0; i < 10000; ++i) {
+      tuner.RecordMsg("fast", 100);
+    }
+
+    changes = tuner.Tune(4000, 200, config);
+    ASSERT_EQ(changes.size(), 1U);
+    ASSERT_EQ(changes[0].first, "fast");
+    ASSERT_EQ(changes[0].second.TimeLimit, 200U);
+  }
+
+  TEST_F(TBatchAutoTunerTest, MaxBytesTest) {
+    TBatchAutoTuner::TParams params = MakeParams();
+    params.MinTimeLimit = 100;
+    TBatchAutoTuner tuner(params);
+    TPerTopicBatcher::TConfig config = MakeConfig();
+    tuner.Tune(1000, 0, config);
+
+    /* 1000 bytes/ms would accumulate 100000 bytes within the minimum time
+       limit, but the byte limit is capped at 'MaxBytes'. */
+    for (size_t i = 0; i < 10000; ++i) {
+      tuner.RecordMsg("fast", 100);
+    }
+
+    auto changes = tuner.Tune(2000, 0, config);
+    ASSERT_EQ(changes.size(), 1U);
+    ASSERT_EQ(changes[0].second.TimeLimit, 100U);
+    ASSERT_EQ(changes[0].second.ByteCount, 50000U);
+  }
+
+  TEST_F(TBatchAutoTunerTest, DeleteTopicTest) {
+    TBatchAutoTuner tuner(MakeParams());
+    TPerTopicBatcher::TConfig config = MakeConfig();
+    tuner.Tune(1000, 0, config);
+    tuner.RecordMsg("t1", 100);
+    tuner.RecordMsg("t2", 100);
+    auto changes = tuner.Tune(2000, 0, config);
+    ASSERT_EQ(changes.size(), 2U);
+    ASSERT_EQ(tuner.GetDecisions().size(), 2U);
+
+    /* A deleted topic is dropped from the decisions, and is treated as new
+       if it comes back. */
+    tuner.DeleteTopic("t1");
+    changes = tuner.Tune(3000, 0, config);
+    ASSERT_TRUE(changes.empty());
+    auto decisions = tuner.GetDecisions();
+    ASSERT_EQ(decisions.size(), 1U);
+    ASSERT_EQ(decisions[0].Topic, "t2");
+    tuner.RecordMsg("t1", 100);
+    changes = tuner.Tune(4000, 0, config);
+    ASSERT_EQ(changes.size(), 1U);
+    ASSERT_EQ(changes[0].first, "t1");
+
+    /* Deleting an unknown topic does nothing. */
+    tuner.DeleteTopic("t3");
+    ASSERT_EQ(tuner.GetDecisions().size(), 2U);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
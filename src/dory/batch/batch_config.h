@@ -32,13 +32,16 @@ namespace Dory {
       TBatchConfig()
           : TimeLimit(0),
             MsgCount(0),
-            ByteCount(0) {
+            ByteCount(0),
+            LatencyBudget(0) {
       }
 
-      TBatchConfig(size_t time_limit, size_t msg_count, size_t byte_count)
+      TBatchConfig(size_t time_limit, size_t msg_count, size_t byte_count,
+          size_t latency_budget = 0)
           : TimeLimit(time_limit),
             MsgCount(msg_count),
-            ByteCount(byte_count) {
+            ByteCount(byte_count),
+            LatencyBudget(latency_budget) {
       }
 
       TBatchConfig(const TBatchConfig &) = default;
@@ -55,16 +58,27 @@ namespace Dory {
       size_t MsgCount;
 
       size_t ByteCount;
+
+      /* Maximum time in milliseconds from the timestamp of the oldest message
+         in a batch until we expect the batch to be acknowledged by Kafka.
+         The batch is completed early enough to leave time for the expected
+         send and ACK time. */
+      size_t LatencyBudget;
     };  // TBatchConfig
 
     inline bool BatchingIsEnabled(const TBatchConfig &config) {
-      return config.TimeLimit || config.MsgCount || config.ByteCount;
+      return config.TimeLimit || config.MsgCount || config.ByteCount ||
+          config.LatencyBudget;
     }
 
     inline bool TimeLimitIsEnabled(const TBatchConfig &config) {
       return (config.TimeLimit != 0);
     }
 
+    inline bool LatencyBudgetIsEnabled(const TBatchConfig &config) {
+      return (config.LatencyBudget != 0);
+    }
+
     inline bool MsgCountLimitIsEnabled(const TBatchConfig &config) {
       return (config.MsgCount != 0);
     }
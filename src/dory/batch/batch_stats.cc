@@ -0,0 +1,173 @@
+/* <dory/batch/batch_stats.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/batch/batch_stats.h>.
+ */
+
+#include <dory/batch/batch_stats.h>
+
+#include <map>
+
+#include <base/no_default_case.h>
+
+using namespace Dory;
+using namespace Dory::Batch;
+
+const char *TBatchStats::ReasonToString(TCompletionReason reason) {
+  const char *text;
+
+  switch (reason) {
+    case TCompletionReason::TimeLimit: {
+      text = "time_limit";
+      break;
+    }
+    case TCompletionReason::MsgCount: {
+      text = "msg_count";
+      break;
+    }
+    case TCompletionReason::ByteCount: {
+      text = "byte_count";
+      break;
+    }
+    case TCompletionReason::Flush: {
+      text = "flush";
+      break;
+    }
+    NO_DEFAULT_CASE;
+  }
+
+  return text;
+}
+
+static size_t SumDataSizes(const std::list<TMsg::TPtr> &batch) {
+  size_t sum = 0;
+
+  for (const TMsg::TPtr &msg : batch) {
+    sum += msg->GetKeyAndValue().Size();
+  }
+
+  return sum;
+}
+
+void TBatchStats::RecordBatch(const std::string &topic, long broker_id,
+    TCompletionReason reason, const std::list<TMsg::TPtr> &batch) {
+  assert(this);
+
+  if (batch.empty()) {
+    return;
+  }
+
+  size_t msg_count = batch.size();
+  size_t byte_count = SumDataSizes(batch);
+  std::lock_guard<std::mutex> lock(Mutex);
+  RecordBatchInfo(Topics[topic], reason, msg_count, byte_count);
+
+  if (broker_id >= 0) {
+    RecordBatchInfo(Brokers[broker_id], reason, msg_count, byte_count);
+  }
+}
+
+void TBatchStats::RecordCombinedBatch(long broker_id,
+    TCompletionReason reason, const std::list<std::list<TMsg::TPtr>> &batch) {
+  assert(this);
+  size_t msg_count = 0;
+  size_t byte_count = 0;
+
+  for (const auto &topic_batch : batch) {
+    msg_count += topic_batch.size();
+    byte_count += SumDataSizes(topic_batch);
+  }
+
+  if (msg_count == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(Mutex);
+  RecordBatchInfo(Brokers[broker_id], reason, msg_count, byte_count);
+}
+
+void TBatchStats::RecordProduceRequest(long broker_id, size_t data_size,
+    size_t data_limit, bool limit_reached) {
+  assert(this);
+  uint64_t fill_percent = data_limit ?
+      ((static_cast<uint64_t>(data_size) * 100) / data_limit) : 100;
+  std::lock_guard<std::mutex> lock(Mutex);
+  TRequestInfo &info = Requests[broker_id];
+  info.DataLimit = data_limit;
+
+  if (limit_reached) {
+    ++info.LimitReachedCount;
+  }
+
+  info.DataBytes.Record(data_size);
+  info.FillPercent.Record(fill_percent);
+}
+
+TBatchStats::TSnapshot TBatchStats::GetSnapshot() const {
+  assert(this);
+
+  /* Use ordered maps so the output is sorted by topic and broker ID. */
+  std::map<std::string, TBatchInfo> topics;
+  std::map<long, TBatchInfo> brokers;
+  std::map<long, TRequestInfo> requests;
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    topics.insert(Topics.begin(), Topics.end());
+    brokers.insert(Brokers.begin(), Brokers.end());
+    requests.insert(Requests.begin(), Requests.end());
+  }
+
+  TSnapshot result;
+
+  for (auto &item : topics) {
+    result.Topics.emplace_back(item.first, std::move(item.second));
+  }
+
+  for (auto &item : brokers) {
+    result.Brokers.emplace_back(item.first, std::move(item.second));
+  }
+
+  for (auto &item : requests) {
+    result.Requests.emplace_back(item.first, std::move(item.second));
+  }
+
+  return result;
+}
+
+void TBatchStats::PruneTopics(const TTopicExistsFn &topic_exists_fn) {
+  assert(this);
+  std::lock_guard<std::mutex> lock(Mutex);
+
+  for (auto iter = Topics.begin(); iter != Topics.end(); ) {
+    if (topic_exists_fn(iter->first)) {
+      ++iter;
+    } else {
+      iter = Topics.erase(iter);
+    }
+  }
+}
+
+void TBatchStats::RecordBatchInfo(TBatchInfo &info, TCompletionReason reason,
+    size_t msg_count, size_t byte_count) {
+  ++info.CompletionCounts[static_cast<size_t>(reason)];
+  info.MsgCounts.Record(msg_count);
+  info.ByteCounts.Record(byte_count);
+}
+
+const size_t TBatchStats::REASON_COUNT;
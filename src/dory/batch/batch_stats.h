@@ -0,0 +1,165 @@
+/* <dory/batch/batch_stats.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Statistics on completed batches and on how full produce requests are.
+ */
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <base/no_copy_semantics.h>
+#include <dory/batch/batcher_core.h>
+#include <dory/msg.h>
+#include <dory/util/histogram.h>
+
+namespace Dory {
+
+  namespace Batch {
+
+    /* Counts completed batches by completion reason, and keeps histograms of
+       batch sizes, both per topic and per broker.  Batches completed by the
+       router thread's per-topic batcher are counted only per topic, since no
+       broker has been chosen yet.  Batches completed by a broker's combined
+       topics batcher are counted only per broker.  Also keeps per-broker
+       histograms of how full produce requests are compared with the produce
+       request data limit.
+
+       This is thread-safe.  The router thread and all connector threads
+       record into it, but they do so once per batch or produce request, not
+       once per message, so a single lock is sufficient. */
+    class TBatchStats final {
+      NO_COPY_SEMANTICS(TBatchStats);
+
+      public:
+      using TCompletionReason = TBatcherCore::TCompletionReason;
+
+      static const size_t REASON_COUNT = 4;
+
+      /* Returns the name used for 'reason' in web interface output. */
+      static const char *ReasonToString(TCompletionReason reason);
+
+      struct TBatchInfo {
+        /* Index is a TCompletionReason value. */
+        std::array<uint64_t, REASON_COUNT> CompletionCounts;
+
+        /* Number of messages in each batch. */
+        Util::THistogram MsgCounts;
+
+        /* Total size in bytes of the message keys and values in each
+           batch. */
+        Util::THistogram ByteCounts;
+
+        TBatchInfo()
+            : CompletionCounts() {
+        }
+      };  // TBatchInfo
+
+      struct TRequestInfo {
+        /* Produce request data limit in effect for the most recently
+           recorded request. */
+        size_t DataLimit;
+
+        /* Number of requests that were cut short by the data limit, leaving
+           messages that did not fit for a later request. */
+        uint64_t LimitReachedCount;
+
+        /* Total size in bytes of the message keys and values in each
+           request. */
+        Util::THistogram DataBytes;
+
+        /* Data size of each request as a percentage of the data limit.  A
+           single message larger than the limit gets a request to itself, so
+           values above 100 are possible. */
+        Util::THistogram FillPercent;
+
+        TRequestInfo()
+            : DataLimit(0),
+              LimitReachedCount(0) {
+        }
+      };  // TRequestInfo
+
+      /* Copies of all stats, sorted by topic and broker ID. */
+      struct TSnapshot {
+        std::vector<std::pair<std::string, TBatchInfo>> Topics;
+
+        std::vector<std::pair<long, TBatchInfo>> Brokers;
+
+        std::vector<std::pair<long, TRequestInfo>> Requests;
+      };  // TSnapshot
+
+      TBatchStats() = default;
+
+      /* Record the completion of 'batch', whose messages all have topic
+         'topic'.  A negative 'broker_id' means no broker.  Empty batches are
+         ignored. */
+      void RecordBatch(const std::string &topic, long broker_id,
+          TCompletionReason reason, const std::list<TMsg::TPtr> &batch);
+
+      /* Record the completion of a batch that combines messages for
+         multiple topics, grouped by topic, for broker 'broker_id'.  Empty
+         batches are ignored. */
+      void RecordCombinedBatch(long broker_id, TCompletionReason reason,
+          const std::list<std::list<TMsg::TPtr>> &batch);
+
+      /* Record a produce request for broker 'broker_id' whose message keys
+         and values total 'data_size' bytes.  'limit_reached' indicates that
+         the request was cut short by 'data_limit'. */
+      void RecordProduceRequest(long broker_id, size_t data_size,
+          size_t data_limit, bool limit_reached);
+
+      TSnapshot GetSnapshot() const;
+
+      /* A topic name is passed as a parameter.  Function returns true if topic
+         is present in metadata or false otherwise. */
+      using TTopicExistsFn = std::function<bool(const std::string &)>;
+
+      /* Delete stats for topics that are no longer present in the
+         metadata. */
+      void PruneTopics(const TTopicExistsFn &topic_exists_fn);
+
+      private:
+      static void RecordBatchInfo(TBatchInfo &info, TCompletionReason reason,
+          size_t msg_count, size_t byte_count);
+
+      /* Protects 'Topics', 'Brokers', and 'Requests'. */
+      mutable std::mutex Mutex;
+
+      /* Keys are topics. */
+      std::unordered_map<std::string, TBatchInfo> Topics;
+
+      /* Keys are broker IDs. */
+      std::unordered_map<long, TBatchInfo> Brokers;
+
+      /* Keys are broker IDs. */
+      std::unordered_map<long, TRequestInfo> Requests;
+    };  // TBatchStats
+
+  }  // Batch
+
+}  // Dory
@@ -0,0 +1,207 @@
+/* <dory/batch/batch_stats.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/batch/batch_stats.h>.
+ */
+
+#include <dory/batch/batch_stats.h>
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include <dory/batch/batch_config_builder.h>
+#include <dory/batch/per_topic_batcher.h>
+#include <dory/msg.h>
+#include <dory/test_util/misc_util.h>
+#include <gtest/gtest.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Batch;
+using namespace Dory::TestUtil;
+
+namespace {
+
+  using TReason = TBatchStats::TCompletionReason;
+
+  uint64_t GetCount(const TBatchStats::TBatchInfo &info, TReason reason) {
+    return info.CompletionCounts[static_cast<size_t>(reason)];
+  }
+
+  /* The fixture for testing class TBatchStats. */
+  class TBatchStatsTest : public ::testing::Test {
+    protected:
+    TBatchStatsTest() {
+    }
+
+    virtual ~TBatchStatsTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TBatchStatsTest
+
+  TEST_F(TBatchStatsTest, RecordBatchTest) {
+    TTestMsgCreator mc;  // create this first since it contains buffer pool
+    TBatchStats stats;
+    std::list<TMsg::TPtr> batch;
+    batch.push_back(mc.NewMsg("t1", "12345", 0));
+    batch.push_back(mc.NewMsg("t1", "1234567890", 0));
+    stats.RecordBatch("t1", -1, TReason::MsgCount, batch);
+    stats.RecordBatch("t1", 5, TReason::TimeLimit, batch);
+    stats.RecordBatch("t2", 5, TReason::Flush, std::list<TMsg::TPtr>());
+    SetProcessed(std::move(batch));
+    TBatchStats::TSnapshot snapshot = stats.GetSnapshot();
+
+    /* The empty batch is ignored, and the batch with no broker is counted
+       only for its topic. */
+    ASSERT_EQ(snapshot.Topics.size(), 1U);
+    ASSERT_EQ(snapshot.Topics[0].first, "t1");
+    const TBatchStats::TBatchInfo &t1 = snapshot.Topics[0].second;
+    ASSERT_EQ(GetCount(t1, TReason::TimeLimit), 1U);
+    ASSERT_EQ(GetCount(t1, TReason::MsgCount), 1U);
+    ASSERT_EQ(GetCount(t1, TReason::ByteCount), 0U);
+    ASSERT_EQ(GetCount(t1, TReason::Flush), 0U);
+    ASSERT_EQ(t1.MsgCounts.GetCount(), 2U);
+    ASSERT_EQ(t1.MsgCounts.GetMax(), 2U);
+    ASSERT_EQ(t1.ByteCounts.GetMax(), 15U);
+    ASSERT_EQ(snapshot.Brokers.size(), 1U);
+    ASSERT_EQ(snapshot.Brokers[0].first, 5);
+    const TBatchStats::TBatchInfo &b5 = snapshot.Brokers[0].second;
+    ASSERT_EQ(GetCount(b5, TReason::TimeLimit), 1U);
+    ASSERT_EQ(GetCount(b5, TReason::MsgCount), 0U);
+    ASSERT_EQ(b5.MsgCounts.GetCount(), 1U);
+    ASSERT_TRUE(snapshot.Requests.empty());
+  }
+
+  TEST_F(TBatchStatsTest, RecordCombinedBatchTest) {
+    TTestMsgCreator mc;  // create this first since it contains buffer pool
+    TBatchStats stats;
+    std::list<std::list<TMsg::TPtr>> batch(2);
+    batch.front().push_back(mc.NewMsg("t1", "123", 0));
+    batch.front().push_back(mc.NewMsg("t1", "456", 0));
+    batch.back().push_back(mc.NewMsg("t2", "7890", 0));
+    stats.RecordCombinedBatch(3, TReason::ByteCount, batch);
+    SetProcessed(std::move(batch));
+    TBatchStats::TSnapshot snapshot = stats.GetSnapshot();
+
+    /* Combined batches are counted only for their broker. */
+    ASSERT_TRUE(snapshot.Topics.empty());
+    ASSERT_EQ(snapshot.Brokers.size(), 1U);
+    ASSERT_EQ(snapshot.Brokers[0].first, 3);
+    const TBatchStats::TBatchInfo &b3 = snapshot.Brokers[0].second;
+    ASSERT_EQ(GetCount(b3, TReason::ByteCount), 1U);
+    ASSERT_EQ(b3.MsgCounts.GetMax(), 3U);
+    ASSERT_EQ(b3.ByteCounts.GetMax(), 10U);
+  }
+
+  TEST_F(TBatchStatsTest, RecordProduceRequestTest) {
+    TBatchStats stats;
+    stats.RecordProduceRequest(2, 500, 1000, false);
+    stats.RecordProduceRequest(2, 1000, 1000, true);
+    stats.RecordProduceRequest(1, 2000, 1000, false);
+    TBatchStats::TSnapshot snapshot = stats.GetSnapshot();
+    ASSERT_EQ(snapshot.Requests.size(), 2U);
+    ASSERT_EQ(snapshot.Requests[0].first, 1);
+    ASSERT_EQ(snapshot.Requests[1].first, 2);
+    const TBatchStats::TRequestInfo &r1 = snapshot.Requests[0].second;
+    const TBatchStats::TRequestInfo &r2 = snapshot.Requests[1].second;
+
+    /* A single message larger than the limit gets a request to itself. */
+    ASSERT_EQ(r1.FillPercent.GetMax(), 200U);
+    ASSERT_EQ(r1.LimitReachedCount, 0U);
+    ASSERT_EQ(r2.DataLimit, 1000U);
+    ASSERT_EQ(r2.LimitReachedCount, 1U);
+    ASSERT_EQ(r2.DataBytes.GetCount(), 2U);
+    ASSERT_EQ(r2.DataBytes.GetSum(), 1500U);
+    ASSERT_EQ(r2.FillPercent.GetMean(), 75U);
+  }
+
+  TEST_F(TBatchStatsTest, PruneTopicsTest) {
+    TTestMsgCreator mc;  // create this first since it contains buffer pool
+    TBatchStats stats;
+    std::list<TMsg::TPtr> batch;
+    batch.push_back(mc.NewMsg("t1", "x", 0));
+    stats.RecordBatch("t1", 1, TReason::Flush, batch);
+    stats.RecordBatch("t2", 1, TReason::Flush, batch);
+    SetProcessed(std::move(batch));
+    stats.PruneTopics(
+        [](const std::string &topic) {
+          return (topic == "t2");
+        });
+    TBatchStats::TSnapshot snapshot = stats.GetSnapshot();
+    ASSERT_EQ(snapshot.Topics.size(), 1U);
+    ASSERT_EQ(snapshot.Topics[0].first, "t2");
+    ASSERT_EQ(snapshot.Brokers.size(), 1U);
+    ASSERT_EQ(GetCount(snapshot.Brokers[0].second, TReason::Flush), 2U);
+  }
+
+  TEST_F(TBatchStatsTest, PerTopicBatcherTest) {
+    TTestMsgCreator mc;  // create this first since it contains buffer pool
+    TBatchConfigBuilder builder;
+    TBatchConfig config;
+    config.TimeLimit = 10;
+    config.MsgCount = 2;
+    config.ByteCount = 0;
+    builder.SetDefaultTopic(&config);
+    TPerTopicBatcher batcher(builder.Build().GetPerTopicConfig());
+    TBatchStats stats;
+    batcher.SetStats(&stats, 7);
+
+    /* Reach the message count limit. */
+    std::list<std::list<TMsg::TPtr>> complete =
+        SetProcessed(batcher.AddMsg(mc.NewMsg("t1", "a", 0), 0));
+    ASSERT_TRUE(complete.empty());
+    complete = SetProcessed(batcher.AddMsg(mc.NewMsg("t1", "b", 1), 1));
+    ASSERT_EQ(complete.size(), 1U);
+
+    /* Reach the time limit. */
+    complete = SetProcessed(batcher.AddMsg(mc.NewMsg("t1", "c", 2), 2));
+    ASSERT_TRUE(complete.empty());
+    complete = SetProcessed(batcher.GetCompleteBatches(12));
+    ASSERT_EQ(complete.size(), 1U);
+
+    /* Flush. */
+    complete = SetProcessed(batcher.AddMsg(mc.NewMsg("t1", "d", 13), 13));
+    ASSERT_TRUE(complete.empty());
+    std::list<TMsg::TPtr> batch = SetProcessed(batcher.TakeTopicBatch("t1"));
+    ASSERT_EQ(batch.size(), 1U);
+
+    TBatchStats::TSnapshot snapshot = stats.GetSnapshot();
+    ASSERT_EQ(snapshot.Topics.size(), 1U);
+    const TBatchStats::TBatchInfo &t1 = snapshot.Topics[0].second;
+    ASSERT_EQ(GetCount(t1, TReason::MsgCount), 1U);
+    ASSERT_EQ(GetCount(t1, TReason::TimeLimit), 1U);
+    ASSERT_EQ(GetCount(t1, TReason::Flush), 1U);
+    ASSERT_EQ(GetCount(t1, TReason::ByteCount), 0U);
+    ASSERT_EQ(t1.MsgCounts.GetSum(), 4U);
+    ASSERT_EQ(snapshot.Brokers.size(), 1U);
+    ASSERT_EQ(snapshot.Brokers[0].first, 7);
+    ASSERT_EQ(snapshot.Brokers[0].second.MsgCounts.GetCount(), 3U);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
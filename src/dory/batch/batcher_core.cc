@@ -30,28 +30,35 @@ using namespace Dory::Batch;
 TBatcherCore::TBatcherCore()
     : MinTimestamp(std::numeric_limits<TMsg::TTimestamp>::max()),
       MsgCount(0),
-      ByteCount(0) {
+      ByteCount(0),
+      DeliveryEstimate(0),
+      CompletionReason(TCompletionReason::TimeLimit),
+      LeftMsgCompletionReason(TCompletionReason::TimeLimit) {
 }
 
 TBatcherCore::TBatcherCore(const TBatchConfig &config)
     : Config(config),
       MinTimestamp(std::numeric_limits<TMsg::TTimestamp>::max()),
       MsgCount(0),
-      ByteCount(0) {
+      ByteCount(0),
+      DeliveryEstimate(0),
+      CompletionReason(TCompletionReason::TimeLimit),
+      LeftMsgCompletionReason(TCompletionReason::TimeLimit) {
 }
 
 TOpt<TMsg::TTimestamp> TBatcherCore::GetNextCompleteTime() const {
   assert(this);
 
-  if (IsEmpty() || !TimeLimitIsEnabled(Config)) {
+  if (IsEmpty() || !TimeLimitApplies()) {
     return TOpt<TMsg::TTimestamp>();
   }
 
-  return TOpt<TMsg::TTimestamp>(MinTimestamp + Config.TimeLimit);
+  return TOpt<TMsg::TTimestamp>(MinTimestamp + GetEffectiveTimeLimit());
 }
 
 TBatcherCore::TAction
-TBatcherCore::ProcessNewMsg(TMsg::TTimestamp now, const TMsg::TPtr &msg) {
+TBatcherCore::ProcessNewMsg(TMsg::TTimestamp now, const TMsg::TPtr &msg,
+    size_t delivery_estimate) {
   assert(this);
   assert(msg);
 
@@ -59,6 +66,10 @@ TBatcherCore::ProcessNewMsg(TMsg::TTimestamp now, const TMsg::TPtr &msg) {
     return TAction::LeaveMsgAndReturnBatch;
   }
 
+  if (IsEmpty()) {
+    DeliveryEstimate = delivery_estimate;
+  }
+
   TMsg::TTimestamp timestamp = msg->GetTimestamp();
 
   /* If a message is empty, count its body size as 1 byte.  This prevents us
@@ -68,13 +79,26 @@ TBatcherCore::ProcessNewMsg(TMsg::TTimestamp now, const TMsg::TPtr &msg) {
 
   if (ByteCountLimitIsEnabled(Config) && (body_size >= Config.ByteCount)) {
     ClearState();
+    CompletionReason = TCompletionReason::ByteCount;
+    LeftMsgCompletionReason = TCompletionReason::ByteCount;
     return TAction::LeaveMsgAndReturnBatch;
   }
 
   if (TestByteCountExceeded(body_size)) {
     ClearState();
+    CompletionReason = TCompletionReason::ByteCount;
+    DeliveryEstimate = delivery_estimate;
+
+    /* The existing batch is complete.  See whether the new message would
+       also complete a batch by itself, checking limits in the same order as
+       TestAllLimits(). */
+    if (TestTimeLimit(now, timestamp)) {
+      LeftMsgCompletionReason = TCompletionReason::TimeLimit;
+      return TAction::LeaveMsgAndReturnBatch;
+    }
 
-    if (TestMsgCount(true) || TestTimeLimit(now, timestamp)) {
+    if (TestMsgCount(true)) {
+      LeftMsgCompletionReason = TCompletionReason::MsgCount;
       return TAction::LeaveMsgAndReturnBatch;
     }
 
@@ -99,16 +123,53 @@ void TBatcherCore::ClearState() {
   ByteCount = 0;
 }
 
+size_t TBatcherCore::GetEffectiveTimeLimit() const {
+  assert(this);
+  assert(TimeLimitApplies());
+  size_t result = std::numeric_limits<size_t>::max();
+
+  if (TimeLimitIsEnabled(Config)) {
+    result = Config.TimeLimit;
+  }
+
+  if (LatencyBudgetIsEnabled(Config)) {
+    /* Leave room for sending the batch and getting an ACK.  If we expect
+       that to take the entire budget, complete the batch right away. */
+    size_t budget_limit = (Config.LatencyBudget > DeliveryEstimate) ?
+        (Config.LatencyBudget - DeliveryEstimate) : 0;
+    result = std::min(result, budget_limit);
+  }
+
+  return result;
+}
+
+bool TBatcherCore::TestAllLimits(TMsg::TTimestamp now) {
+  assert(this);
+
+  if (TestTimeLimit(now)) {
+    CompletionReason = TCompletionReason::TimeLimit;
+  } else if (TestMsgCount()) {
+    CompletionReason = TCompletionReason::MsgCount;
+  } else if (TestByteCount()) {
+    CompletionReason = TCompletionReason::ByteCount;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
 bool TBatcherCore::TestTimeLimit(TMsg::TTimestamp now,
     TMsg::TTimestamp new_msg_timestamp) const {
   assert(this);
 
-  if (!TimeLimitIsEnabled(Config)) {
+  if (!TimeLimitApplies()) {
     return false;
   }
 
   TMsg::TTimestamp min_ts = std::min(MinTimestamp, new_msg_timestamp);
-  return (now >= static_cast<TMsg::TTimestamp>(min_ts + Config.TimeLimit));
+  return (now >= static_cast<TMsg::TTimestamp>(min_ts +
+      GetEffectiveTimeLimit()));
 }
 
 bool TBatcherCore::TestMsgCount(bool adding_msg) const {
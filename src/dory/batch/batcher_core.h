@@ -42,6 +42,23 @@ namespace Dory {
         TakeMsgAndLeaveBatch
       };  // TAction
 
+      /* Why a batch was completed. */
+      enum class TCompletionReason {
+        /* The time limit or latency budget expired. */
+        TimeLimit,
+
+        /* The message count limit was reached. */
+        MsgCount,
+
+        /* The byte count limit was reached, or the next message would have
+           exceeded it. */
+        ByteCount,
+
+        /* The batch was taken before reaching any limit, because of a flush
+           request, a topic or configuration change, or shutdown. */
+        Flush
+      };  // TCompletionReason
+
       TBatcherCore();
 
       explicit TBatcherCore(const TBatchConfig &config);
@@ -60,6 +77,13 @@ namespace Dory {
         return Config;
       }
 
+      /* Replace the batching limits.  The new limits also apply to the batch
+         currently in progress, if any. */
+      void SetConfig(const TBatchConfig &config) {
+        assert(this);
+        Config = config;
+      }
+
       bool IsEmpty() const {
         assert(this);
         return (MsgCount == 0);
@@ -77,11 +101,46 @@ namespace Dory {
 
       Base::TOpt<TMsg::TTimestamp> GetNextCompleteTime() const;
 
-      TAction ProcessNewMsg(TMsg::TTimestamp now, const TMsg::TPtr &msg);
+      /* 'delivery_estimate' is the expected time in milliseconds to send a
+         batch and get an ACK.  If a latency budget is configured, the value
+         given with the first message of a batch determines how soon the
+         batch must be completed. */
+      TAction ProcessNewMsg(TMsg::TTimestamp now, const TMsg::TPtr &msg,
+          size_t delivery_estimate = 0);
+
+      /* Return the reason the batch returned by the most recent call to
+         ProcessNewMsg() was completed.  Only meaningful if that call
+         returned an action other than TakeMsgAndLeaveBatch.  Never returns
+         TCompletionReason::Flush, since only the caller knows when a batch
+         is taken early. */
+      TCompletionReason GetCompletionReason() const {
+        assert(this);
+        return CompletionReason;
+      }
+
+      /* If the most recent call to ProcessNewMsg() returned
+         LeaveMsgAndReturnBatch, return the reason the message that was left
+         out forms a complete batch by itself.  This can differ from
+         GetCompletionReason(), which applies to the batch returned. */
+      TCompletionReason GetLeftMsgCompletionReason() const {
+        assert(this);
+        return LeftMsgCompletionReason;
+      }
 
       void ClearState();
 
       private:
+      /* Return true if either a time limit or a latency budget applies. */
+      bool TimeLimitApplies() const {
+        assert(this);
+        return TimeLimitIsEnabled(Config) || LatencyBudgetIsEnabled(Config);
+      }
+
+      /* Return the time in milliseconds from the oldest message timestamp
+         until the batch is complete, taking into account both the time limit
+         and the latency budget.  TimeLimitApplies() must return true. */
+      size_t GetEffectiveTimeLimit() const;
+
       bool TestTimeLimit(TMsg::TTimestamp now,
           TMsg::TTimestamp new_msg_timestamp =
               std::numeric_limits<TMsg::TTimestamp>::max()) const;
@@ -92,10 +151,9 @@ namespace Dory {
 
       bool TestByteCountExceeded(size_t bytes_to_add) const;
 
-      bool TestAllLimits(TMsg::TTimestamp now) const {
-        assert(this);
-        return TestTimeLimit(now) || TestMsgCount() || TestByteCount();
-      }
+      /* Return true if any limit has been reached, and set
+         'CompletionReason' to the first one found. */
+      bool TestAllLimits(TMsg::TTimestamp now);
 
       void UpdateState(TMsg::TTimestamp timestamp, size_t body_size);
 
@@ -106,6 +164,16 @@ namespace Dory {
       size_t MsgCount;
 
       size_t ByteCount;
+
+      /* Expected send and ACK time in milliseconds, captured when the first
+         message of the current batch arrived. */
+      size_t DeliveryEstimate;
+
+      /* See GetCompletionReason(). */
+      TCompletionReason CompletionReason;
+
+      /* See GetLeftMsgCompletionReason(). */
+      TCompletionReason LeftMsgCompletionReason;
     };  // TBatcherCore
 
   }  // Batch
@@ -35,7 +35,10 @@ using namespace Dory::Util;
 TCombinedTopicsBatcher::TCombinedTopicsBatcher(const TConfig &config)
     : CoreState(config.BatchConfig),
       TopicFilter(config.TopicFilter),
-      ExcludeTopicFilter(config.ExcludeTopicFilter) {
+      ExcludeTopicFilter(config.ExcludeTopicFilter),
+      DeliveryEstimate(0),
+      Stats(nullptr),
+      StatsBrokerId(-1) {
 }
 
 bool TCombinedTopicsBatcher::BatchingIsEnabled() const {
@@ -67,22 +70,22 @@ TCombinedTopicsBatcher::AddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now) {
   const std::string &topic = msg->GetTopic();
 
   if (!BatchingIsEnabled(topic)) {
-    TOpt<TMsg::TTimestamp> opt_nct = GetNextCompleteTime();
-
-    if (opt_nct.IsKnown() && (now >= *opt_nct)) {
-      return TakeBatch();
-    }
-
-    return std::list<std::list<TMsg::TPtr>>();
+    return GetCompleteBatch(now);
   }
 
-  switch (CoreState.ProcessNewMsg(now, msg)) {
+  switch (CoreState.ProcessNewMsg(now, msg, DeliveryEstimate)) {
     case TBatcherCore::TAction::LeaveMsgAndReturnBatch: {
       break;
     }
     case TBatcherCore::TAction::ReturnBatchAndTakeMsg: {
       std::list<std::list<TMsg::TPtr>> result = TopicMap.Get();
       TopicMap.Put(std::move(msg));
+
+      if (Stats) {
+        Stats->RecordCombinedBatch(StatsBrokerId,
+            CoreState.GetCompletionReason(), result);
+      }
+
       return std::move(result);
     }
     case TBatcherCore::TAction::TakeMsgAndReturnBatch: {
@@ -96,13 +99,43 @@ TCombinedTopicsBatcher::AddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now) {
     NO_DEFAULT_CASE;
   }
 
-  return TopicMap.Get();
+  std::list<std::list<TMsg::TPtr>> result = TopicMap.Get();
+
+  if (Stats) {
+    Stats->RecordCombinedBatch(StatsBrokerId, CoreState.GetCompletionReason(),
+        result);
+  }
+
+  return std::move(result);
+}
+
+std::list<std::list<TMsg::TPtr>>
+TCombinedTopicsBatcher::GetCompleteBatch(TMsg::TTimestamp now) {
+  assert(this);
+  TOpt<TMsg::TTimestamp> opt_nct = GetNextCompleteTime();
+
+  if (opt_nct.IsKnown() && (now >= *opt_nct)) {
+    return DoTakeBatch(TBatcherCore::TCompletionReason::TimeLimit);
+  }
+
+  return std::list<std::list<TMsg::TPtr>>();
 }
 
 std::list<std::list<TMsg::TPtr>>
 TCombinedTopicsBatcher::TakeBatch() {
+  assert(this);
+  return DoTakeBatch(TBatcherCore::TCompletionReason::Flush);
+}
+
+std::list<std::list<TMsg::TPtr>>
+TCombinedTopicsBatcher::DoTakeBatch(TBatcherCore::TCompletionReason reason) {
   assert(this);
   std::list<std::list<TMsg::TPtr>> result = TopicMap.Get();
   CoreState.ClearState();
+
+  if (Stats) {
+    Stats->RecordCombinedBatch(StatsBrokerId, reason, result);
+  }
+
   return std::move(result);
 }
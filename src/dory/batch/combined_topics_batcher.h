@@ -24,6 +24,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <list>
 #include <memory>
 #include <string>
@@ -33,6 +34,7 @@
 
 #include <base/no_copy_semantics.h>
 #include <base/opt.h>
+#include <dory/batch/batch_stats.h>
 #include <dory/batch/batcher_core.h>
 #include <dory/msg.h>
 #include <dory/util/topic_map.h>
@@ -108,19 +110,51 @@ namespace Dory {
       /* Return true if batching is enabled for the given topic. */
       bool BatchingIsEnabled(const std::string &topic) const;
 
+      /* Set the expected time in milliseconds to send a batch and get an
+         ACK.  This affects batches started afterwards if a latency budget is
+         configured. */
+      void SetDeliveryEstimate(size_t delivery_estimate) {
+        assert(this);
+        DeliveryEstimate = delivery_estimate;
+      }
+
+      /* Record each completed batch for broker 'broker_id' in 'stats', which
+         must outlive the batcher.  By default, nothing is recorded. */
+      void SetStats(TBatchStats *stats, long broker_id) {
+        assert(this);
+        Stats = stats;
+        StatsBrokerId = broker_id;
+      }
+
       std::list<std::list<TMsg::TPtr>>
       AddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now);
 
+      /* If the batch's time limit has expired, empty out the batcher and
+         return all messages it contained, grouped by topic.  Otherwise return
+         an empty list. */
+      std::list<std::list<TMsg::TPtr>> GetCompleteBatch(TMsg::TTimestamp now);
+
       Base::TOpt<TMsg::TTimestamp> GetNextCompleteTime() const {
         assert(this);
         return CoreState.GetNextCompleteTime();
       }
 
+      /* Return true if the batch contains messages for the given topic. */
+      bool ContainsTopic(const std::string &topic) const {
+        assert(this);
+        return TopicMap.Contains(topic);
+      }
+
       /* Empty out the batcher, and return all messages it contained, grouped
-         by topic. */
+         by topic.  This is counted as a flush in the stats. */
       std::list<std::list<TMsg::TPtr>> TakeBatch();
 
       private:
+      /* Empty out the batcher, and return all messages it contained.  Record
+         the batch as completed for 'reason'. */
+      std::list<std::list<TMsg::TPtr>>
+      DoTakeBatch(TBatcherCore::TCompletionReason reason);
+
       TBatcherCore CoreState;
 
       std::shared_ptr<TTopicFilter> TopicFilter;
@@ -129,6 +163,14 @@ namespace Dory {
 
       /* Messages are stored here, grouped by topic. */
       Util::TTopicMap TopicMap;
+
+      /* See SetDeliveryEstimate(). */
+      size_t DeliveryEstimate;
+
+      /* See SetStats(). */
+      TBatchStats *Stats;
+
+      long StatsBrokerId;
     };  // TCombinedTopicsBatcher
 
   }  // Batch
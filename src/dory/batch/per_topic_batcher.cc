@@ -30,11 +30,46 @@ using namespace Dory;
 using namespace Dory::Batch;
 
 TPerTopicBatcher::TPerTopicBatcher(const std::shared_ptr<TConfig> &config)
-    : Config(config) {
+    : Config(config),
+      DeliveryEstimate(0),
+      Stats(nullptr),
+      StatsBrokerId(-1) {
 }
 
 TPerTopicBatcher::TPerTopicBatcher(std::shared_ptr<TConfig> &&config)
-    : Config(std::move(config)) {
+    : Config(std::move(config)),
+      DeliveryEstimate(0),
+      Stats(nullptr),
+      StatsBrokerId(-1) {
+}
+
+void TPerTopicBatcher::SetTopicConfig(const std::string &topic,
+    const TBatchConfig &config) {
+  assert(this);
+  ConfigOverrides[topic] = config;
+  auto iter = BatchMap.find(topic);
+
+  if (iter != BatchMap.end()) {
+    TBatchMapEntry &entry = iter->second;
+    entry.Batcher.SetConfig(config);
+    UpdateExpiry(entry);
+  }
+}
+
+void TPerTopicBatcher::ClearTopicConfig(const std::string &topic) {
+  assert(this);
+
+  if (ConfigOverrides.erase(topic) == 0) {
+    return;
+  }
+
+  auto iter = BatchMap.find(topic);
+
+  if (iter != BatchMap.end()) {
+    TBatchMapEntry &entry = iter->second;
+    entry.Batcher.SetConfig(Config->Get(topic));
+    UpdateExpiry(entry);
+  }
 }
 
 std::list<std::list<TMsg::TPtr>>
@@ -47,9 +82,10 @@ TPerTopicBatcher::AddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now) {
   if (iter == BatchMap.end()) {
     auto result = BatchMap.insert(
         std::make_pair(topic,
-            TBatchMapEntry(Config->Get(topic), ExpiryTracker.end())));
+            TBatchMapEntry(GetTopicConfig(topic), AllocTimerId())));
     assert(result.second);
     iter = result.first;
+    EntryByTimerId[iter->second.TimerId] = &iter->second;
   }
 
   std::list<std::list<TMsg::TPtr>> complete_topic_batches;
@@ -60,64 +96,26 @@ TPerTopicBatcher::AddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now) {
     TOpt<TMsg::TTimestamp> opt_nct_initial = batcher.GetNextCompleteTime();
 
     if (opt_nct_initial.IsKnown() !=
-        (entry.ExpiryRef != ExpiryTracker.end())) {
+        ExpiryWheel.IsScheduled(entry.TimerId)) {
       assert(false);
       syslog(LOG_ERR,
-             "Bug!!!  Topic batcher state out of sync with ExpiryRef: %d",
+             "Bug!!!  Topic batcher state out of sync with expiry wheel: %d",
              static_cast<int>(opt_nct_initial.IsKnown()));
     }
 
-    TMsg::TTimestamp expiry = 0;
-
-    if (entry.ExpiryRef != ExpiryTracker.end()) {
-      expiry = entry.ExpiryRef->GetExpiry();
-
-      if (opt_nct_initial.IsUnknown() || (*opt_nct_initial != expiry)) {
-        assert(false);
-        TMsg::TTimestamp nct_initial =
-            (opt_nct_initial.IsKnown()) ? *opt_nct_initial : 0;
-        syslog(LOG_ERR, "Bug!!!  Topic batcher time limit does not match "
-               "expiry tracker time limit: %lu %lu %lu",
-               static_cast<unsigned long>(opt_nct_initial.IsKnown()),
-               static_cast<unsigned long>(nct_initial),
-               static_cast<unsigned long>(expiry));
-      }
-    }
-
-    std::list<TMsg::TPtr> complete_batch = batcher.AddMsg(std::move(msg), now);
-    TOpt<TMsg::TTimestamp> opt_nct_final = batcher.GetNextCompleteTime();
-    bool remove_old_expiry = false;
-    bool add_new_expiry = false;
-
-    if (entry.ExpiryRef != ExpiryTracker.end()) {
-      if (opt_nct_final.IsKnown()) {
-        if (*opt_nct_final != expiry) {
-          remove_old_expiry = true;
-          add_new_expiry = true;
-        }
-      } else {
-        remove_old_expiry = true;
-      }
-    } else if (opt_nct_final.IsKnown()) {
-      add_new_expiry = true;
-    }
-
-    if (remove_old_expiry) {
-      ExpiryTracker.erase(entry.ExpiryRef);
-      entry.ExpiryRef = ExpiryTracker.end();
-    }
-
-    if (add_new_expiry) {
-      entry.ExpiryRef = ExpiryTracker.insert(
-          TBatchExpiryRecord(*opt_nct_final, topic));
-    }
+    std::list<TMsg::TPtr> complete_batch = batcher.AddMsg(std::move(msg), now,
+        DeliveryEstimate);
+    UpdateExpiry(entry);
 
     if (!complete_batch.empty()) {
+      RecordBatch(iter->first, batcher.GetCompletionReason(), complete_batch);
       complete_topic_batches.push_back(std::move(complete_batch));
     }
 
     if (msg) {
       complete_batch.push_back(std::move(msg));
+      RecordBatch(iter->first, batcher.GetLeftMsgCompletionReason(),
+          complete_batch);
       complete_topic_batches.push_back(std::move(complete_batch));
     }
   }
@@ -136,32 +134,29 @@ TPerTopicBatcher::GetCompleteBatches(TMsg::TTimestamp now) {
   assert(this);
   std::list<std::list<TMsg::TPtr>> result;
 
-  for (TExpiryRef iter = ExpiryTracker.begin();
-       (iter != ExpiryTracker.end()) && (iter->GetExpiry() <= now); ) {
-    TExpiryRef curr = iter;
-    ++iter;
-
-    auto map_iter = BatchMap.find(curr->GetTopic());
+  for (; ; ) {
+    TOpt<size_t> opt_id =
+        ExpiryWheel.PopExpired(static_cast<uint64_t>(now));
 
-    if (map_iter == BatchMap.end()) {
-      assert(false);
-      syslog(LOG_ERR, "Bug!!! BatchMap lookup failed in "
-             "TPerTopicBatcher::GetCompleteBatches()");
-      continue;
+    if (opt_id.IsUnknown()) {
+      break;
     }
 
-    TBatchMapEntry &map_entry = map_iter->second;
+    TBatchMapEntry *entry = (*opt_id < EntryByTimerId.size()) ?
+        EntryByTimerId[*opt_id] : nullptr;
 
-    if (map_entry.ExpiryRef != curr) {
+    if (entry == nullptr) {
       assert(false);
-      syslog(LOG_ERR, "Bug!!! TBatchMapEntry ExpiryRef is incorrect in "
+      syslog(LOG_ERR, "Bug!!! Timer ID lookup failed in "
              "TPerTopicBatcher::GetCompleteBatches()");
+      continue;
     }
 
-    assert(!map_entry.Batcher.IsEmpty());
-    result.push_back(map_entry.Batcher.TakeBatch());
-    map_entry.ExpiryRef = ExpiryTracker.end();
-    ExpiryTracker.erase(curr);
+    assert(entry->TimerId == *opt_id);
+    assert(!entry->Batcher.IsEmpty());
+    result.push_back(entry->Batcher.TakeBatch());
+    RecordBatch(result.back().front()->GetTopic(),
+        TBatcherCore::TCompletionReason::TimeLimit, result.back());
   }
 
   return std::move(result);
@@ -169,12 +164,13 @@ TPerTopicBatcher::GetCompleteBatches(TMsg::TTimestamp now) {
 
 TOpt<TMsg::TTimestamp> TPerTopicBatcher::GetNextCompleteTime() const {
   assert(this);
+  TOpt<uint64_t> opt_expiry = ExpiryWheel.GetNextExpiry();
 
-  if (ExpiryTracker.empty()) {
+  if (opt_expiry.IsUnknown()) {
     return TOpt<TMsg::TTimestamp>();
   }
 
-  return TOpt<TMsg::TTimestamp>(ExpiryTracker.begin()->GetExpiry());
+  return TOpt<TMsg::TTimestamp>(static_cast<TMsg::TTimestamp>(*opt_expiry));
 }
 
 std::list<std::list<TMsg::TPtr>> TPerTopicBatcher::GetAllBatches() {
@@ -187,17 +183,17 @@ std::list<std::list<TMsg::TPtr>> TPerTopicBatcher::GetAllBatches() {
     batch = std::move(entry.Batcher.TakeBatch());
 
     if (!batch.empty()) {
+      RecordBatch(item.first, TBatcherCore::TCompletionReason::Flush, batch);
       result.push_back(std::move(batch));
     }
-
-    entry.ExpiryRef = ExpiryTracker.end();
   }
 
-  ExpiryTracker.clear();
+  ExpiryWheel.Clear();
   return std::move(result);
 }
 
-std::list<TMsg::TPtr> TPerTopicBatcher::DeleteTopic(const std::string &topic) {
+std::list<TMsg::TPtr>
+TPerTopicBatcher::TakeTopicBatch(const std::string &topic) {
   assert(this);
   auto iter = BatchMap.find(topic);
 
@@ -206,64 +202,95 @@ std::list<TMsg::TPtr> TPerTopicBatcher::DeleteTopic(const std::string &topic) {
   }
 
   TBatchMapEntry &entry = iter->second;
+  ExpiryWheel.Cancel(entry.TimerId);
   std::list<TMsg::TPtr> batch = entry.Batcher.TakeBatch();
-  TExpiryRef ref = entry.ExpiryRef;
+  RecordBatch(topic, TBatcherCore::TCompletionReason::Flush, batch);
+  return std::move(batch);
+}
 
-  if (ref != ExpiryTracker.end()) {
-    assert(ref->GetTopic() == topic);
-    assert(!batch.empty());
-    ExpiryTracker.erase(ref);
+std::list<TMsg::TPtr> TPerTopicBatcher::DeleteTopic(const std::string &topic) {
+  assert(this);
+  auto iter = BatchMap.find(topic);
+
+  if (iter == BatchMap.end()) {
+    return std::list<TMsg::TPtr>();
   }
 
+  TBatchMapEntry &entry = iter->second;
+  std::list<TMsg::TPtr> batch = entry.Batcher.TakeBatch();
+  assert(!ExpiryWheel.IsScheduled(entry.TimerId) || !batch.empty());
+  ExpiryWheel.Cancel(entry.TimerId);
+  assert(EntryByTimerId[entry.TimerId] == &entry);
+  EntryByTimerId[entry.TimerId] = nullptr;
+  FreeTimerIds.push_back(entry.TimerId);
   BatchMap.erase(iter);
   return std::move(batch);
 }
 
 bool TPerTopicBatcher::SanityCheck() const {
   assert(this);
+  size_t scheduled_count = 0;
 
   for (const auto &map_item : BatchMap) {
-    const std::string &topic = map_item.first;
     const TBatchMapEntry &entry = map_item.second;
-    TExpiryRef expiry_iter = ExpiryTracker.begin();
 
-    for (; expiry_iter != ExpiryTracker.end(); ++expiry_iter) {
-      if (expiry_iter->GetTopic() == topic) {
-        break;
-      }
+    if ((entry.TimerId >= EntryByTimerId.size()) ||
+        (EntryByTimerId[entry.TimerId] != &entry)) {
+      return false;
     }
 
     TOpt<TMsg::TTimestamp> opt_time_limit =
         entry.Batcher.GetNextCompleteTime();
 
+    if (opt_time_limit.IsKnown() != ExpiryWheel.IsScheduled(entry.TimerId)) {
+      return false;
+    }
+
     if (opt_time_limit.IsKnown()) {
-      if ((expiry_iter == ExpiryTracker.end()) ||
-          (entry.ExpiryRef != expiry_iter)) {
+      if (ExpiryWheel.GetExpiry(entry.TimerId) !=
+          static_cast<uint64_t>(*opt_time_limit)) {
         return false;
       }
 
-      if (entry.ExpiryRef->GetExpiry() != *opt_time_limit) {
-        return false;
-      }
-    } else if ((entry.ExpiryRef != ExpiryTracker.end()) ||
-               (expiry_iter != ExpiryTracker.end())) {
-      return false;
+      ++scheduled_count;
     }
   }
 
-  std::set<std::string> topic_set;
+  if (FreeTimerIds.size() + BatchMap.size() != EntryByTimerId.size()) {
+    return false;
+  }
 
-  for (const TBatchExpiryRecord &rec : ExpiryTracker) {
-    if (BatchMap.find(rec.GetTopic()) == BatchMap.end()) {
-      return false;
-    }
+  return (ExpiryWheel.GetCount() == scheduled_count) &&
+      ExpiryWheel.SanityCheck();
+}
 
-    auto result = topic_set.insert(rec.GetTopic());
+size_t TPerTopicBatcher::AllocTimerId() {
+  assert(this);
 
-    if (!result.second) {
-      return false;
-    }
+  if (!FreeTimerIds.empty()) {
+    size_t id = FreeTimerIds.back();
+    FreeTimerIds.pop_back();
+    return id;
   }
 
-  return true;
+  EntryByTimerId.push_back(nullptr);
+  ExpiryWheel.Reserve(EntryByTimerId.size());
+  return EntryByTimerId.size() - 1;
+}
+
+void TPerTopicBatcher::UpdateExpiry(TBatchMapEntry &entry) {
+  assert(this);
+  TOpt<TMsg::TTimestamp> opt_nct = entry.Batcher.GetNextCompleteTime();
+
+  if (opt_nct.IsUnknown()) {
+    ExpiryWheel.Cancel(entry.TimerId);
+    return;
+  }
+
+  uint64_t expiry = static_cast<uint64_t>(*opt_nct);
+
+  if (!ExpiryWheel.IsScheduled(entry.TimerId) ||
+      (ExpiryWheel.GetExpiry(entry.TimerId) != expiry)) {
+    ExpiryWheel.Schedule(entry.TimerId, expiry);
+  }
 }
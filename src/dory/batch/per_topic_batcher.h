@@ -23,15 +23,18 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <list>
 #include <memory>
-#include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <base/no_copy_semantics.h>
 #include <base/opt.h>
+#include <base/timer_wheel.h>
 #include <dory/batch/batch_config.h>
+#include <dory/batch/batch_stats.h>
 #include <dory/batch/single_topic_batcher.h>
 #include <dory/msg.h>
 
@@ -86,6 +89,35 @@ namespace Dory {
         return Config;
       }
 
+      /* Set the expected time in milliseconds to send a batch and get an
+         ACK.  This affects batches started afterwards for topics with a
+         latency budget. */
+      void SetDeliveryEstimate(size_t delivery_estimate) {
+        assert(this);
+        DeliveryEstimate = delivery_estimate;
+      }
+
+      /* Record each completed batch in 'stats', which must outlive the
+         batcher.  A negative 'broker_id' indicates batching done before a
+         broker has been chosen.  By default, nothing is recorded. */
+      void SetStats(TBatchStats *stats, long broker_id) {
+        assert(this);
+        Stats = stats;
+        StatsBrokerId = broker_id;
+      }
+
+      /* Replace the batching limits for a topic, overriding the limits from
+         the config file.  The new limits also apply to the topic's batch in
+         progress, if any.  The override is kept separately from the topic's
+         batch state, so it survives DeleteTopic() and applies again when the
+         topic next gets a message.  Call ClearTopicConfig() to revert to the
+         limits from the config file. */
+      void SetTopicConfig(const std::string &topic,
+          const TBatchConfig &config);
+
+      /* Remove any override set by SetTopicConfig() for the given topic. */
+      void ClearTopicConfig(const std::string &topic);
+
       std::list<std::list<TMsg::TPtr>>
       AddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now);
 
@@ -100,6 +132,11 @@ namespace Dory {
          have no messages.  This is used when dory is shutting down. */
       std::list<std::list<TMsg::TPtr>> GetAllBatches();
 
+      /* Get the batch for the given topic, even if incomplete.  On return,
+         the batcher will have no messages for the topic, but will keep its
+         batch state.  Used when a client requests a flush. */
+      std::list<TMsg::TPtr> TakeTopicBatch(const std::string &topic);
+
       /* Delete all batch state for the given topic and return a list of all
          messages that were batched for that topic. */
       std::list<TMsg::TPtr> DeleteTopic(const std::string &topic);
@@ -108,79 +145,18 @@ namespace Dory {
       bool SanityCheck() const;
 
       private:
-      /* We store these in a multiset.  Each record represents a topic batch
-         with a time limit.  The records are ordered by ascending expiry time,
-         regardless of topic.  In other words, two records with the same
-         timestamp but different topics are considered equal from the
-         multiset's point of view.  The multiset contains at most one record
-         for a given topic.  No record for a given topic appears in the
-         multiset in the case where the batch for that topic is empty or has no
-         time limit. */
-      class TBatchExpiryRecord final {
-        public:
-        TBatchExpiryRecord(TMsg::TTimestamp expiry, const std::string &topic)
-            : Expiry(expiry),
-              Topic(topic) {
-        }
-
-        TBatchExpiryRecord(TMsg::TTimestamp expiry, std::string &&topic)
-            : Expiry(expiry),
-              Topic(std::move(topic)) {
-        }
-
-        TBatchExpiryRecord(TBatchExpiryRecord &&that)
-            : Expiry(that.Expiry),
-              Topic(std::move(that.Topic)) {
-        }
-
-        TBatchExpiryRecord &operator=(TBatchExpiryRecord &&that) {
-          assert(this);
-
-          if (this != &that) {
-            Expiry = that.Expiry;
-            Topic = std::move(that.Topic);
-          }
-
-          return *this;
-        }
-
-        bool operator<(const TBatchExpiryRecord &that) const {
-          assert(this);
-          return (Expiry < that.Expiry);
-        }
-
-        TMsg::TTimestamp GetExpiry() const {
-          assert(this);
-          return Expiry;
-        }
-
-        const std::string &GetTopic() const {
-          assert(this);
-          return Topic;
-        }
-
-        private:
-        /* Batch expiry time. */
-        TMsg::TTimestamp Expiry;
-
-        /* Batch topic. */
-        std::string Topic;
-      };  // TBatchExpiryRecord
-
-      using TExpiryRef = std::multiset<TBatchExpiryRecord>::const_iterator;
-
       struct TBatchMapEntry {
         /* A batch for a single topic. */
         TSingleTopicBatcher Batcher;
 
-        /* If the batch is nonempty and has a time limit, then this references
-           the corresponding entry in 'ExpiryTracker' below.  Otherwise this is
-           set to ExpiryTracker.end(). */
-        TExpiryRef ExpiryRef;
+        /* Identifies the topic's timer in 'ExpiryWheel'.  The timer is
+           scheduled if and only if the batch is nonempty and has a time
+           limit. */
+        size_t TimerId;
 
-        TBatchMapEntry(const TBatchConfig &config, TExpiryRef expiry_ref)
+        TBatchMapEntry(const TBatchConfig &config, size_t timer_id)
             : Batcher(config),
-              ExpiryRef(expiry_ref) {
+              TimerId(timer_id) {
         }
 
         TBatchMapEntry(TBatchMapEntry &&) = default;
@@ -188,16 +164,63 @@ namespace Dory {
         TBatchMapEntry &operator=(TBatchMapEntry &&) = default;
       };  // TBatchMapEntry
 
+      /* Return an unused timer ID for a new topic. */
+      size_t AllocTimerId();
+
+      /* Make the topic's timer in 'ExpiryWheel' match its batch time limit
+         after a change to its batch. */
+      void UpdateExpiry(TBatchMapEntry &entry);
+
+      /* Return the limits for a topic, taking overrides into account. */
+      const TBatchConfig &GetTopicConfig(const std::string &topic) const {
+        assert(this);
+        auto iter = ConfigOverrides.find(topic);
+        return (iter == ConfigOverrides.end()) ?
+            Config->Get(topic) : iter->second;
+      }
+
       /* Per-topic batching configuration obtained from a config file. */
       std::shared_ptr<TConfig> Config;
 
+      /* Key is topic and value is limits set by SetTopicConfig(). */
+      std::unordered_map<std::string, TBatchConfig> ConfigOverrides;
+
       /* Key is topic and value is batch of messages for topic. */
       std::unordered_map<std::string, TBatchMapEntry> BatchMap;
 
-      /* This contains a record for each nonempty topic batch with a time
-         limit.  It lets us efficiently determine the soonest time limit
-         expiration. */
-      std::multiset<TBatchExpiryRecord> ExpiryTracker;
+      /* This contains a timer for each nonempty topic batch with a time
+         limit.  It lets us determine the soonest time limit expiration, and
+         find expired batches, without allocating memory or searching a tree
+         each time a batch is started or completed.  Each topic gets a timer
+         ID when it is first added to 'BatchMap', so IDs stay small. */
+      Base::TTimerWheel ExpiryWheel;
+
+      /* Index is timer ID and value is corresponding entry in 'BatchMap', or
+         nullptr if the ID is unused.  Entries in an unordered_map are not
+         moved by rehashing, so these pointers stay valid. */
+      std::vector<TBatchMapEntry *> EntryByTimerId;
+
+      /* Timer IDs of deleted topics, available for reuse. */
+      std::vector<size_t> FreeTimerIds;
+
+      /* Record 'batch' in 'Stats' if stats are enabled. */
+      void RecordBatch(const std::string &topic,
+          TBatcherCore::TCompletionReason reason,
+          const std::list<TMsg::TPtr> &batch) {
+        assert(this);
+
+        if (Stats) {
+          Stats->RecordBatch(topic, StatsBrokerId, reason, batch);
+        }
+      }
+
+      /* See SetDeliveryEstimate(). */
+      size_t DeliveryEstimate;
+
+      /* See SetStats(). */
+      TBatchStats *Stats;
+
+      long StatsBrokerId;
     };  // TPerTopicBatcher
 
   }  // Batch
@@ -356,6 +356,107 @@ namespace {
     ASSERT_FALSE(opt_nct.IsKnown());
   }
 
+  TEST_F(TPerTopicBatcherTest, SetTopicConfigTest) {
+    TTestMsgCreator mc;  // create this first since it contains buffer pool
+    TPerTopicBatcher batcher(MakeTopicBatchConfig());
+
+    /* Unknown topic: the override is kept and applies to the topic's first
+       batch. */
+    batcher.SetTopicConfig("t2", TBatchConfig(30, 3, 0));
+    ASSERT_TRUE(batcher.SanityCheck());
+    ASSERT_FALSE(batcher.GetNextCompleteTime().IsKnown());
+    TMsg::TPtr msg = mc.NewMsg("t2", "t2 msg 1", 1);
+    std::list<std::list<TMsg::TPtr>> complete_batches =
+        SetProcessed(batcher.AddMsg(std::move(msg), 1));
+    ASSERT_TRUE(complete_batches.empty());
+    TOpt<TMsg::TTimestamp> opt_nct = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_nct.IsKnown());
+    ASSERT_EQ(*opt_nct, 31);
+    std::list<TMsg::TPtr> deleted = SetProcessed(batcher.DeleteTopic("t2"));
+    ASSERT_EQ(deleted.size(), 1U);
+
+    msg = mc.NewMsg("t1", "t1 msg 1", 5);
+    complete_batches = SetProcessed(batcher.AddMsg(std::move(msg), 5));
+    ASSERT_TRUE(complete_batches.empty());
+    opt_nct = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_nct.IsKnown());
+    ASSERT_EQ(*opt_nct, 15);
+
+    /* The new time limit applies to the batch in progress. */
+    batcher.SetTopicConfig("t1", TBatchConfig(50, 3, 0));
+    ASSERT_TRUE(batcher.SanityCheck());
+    opt_nct = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_nct.IsKnown());
+    ASSERT_EQ(*opt_nct, 55);
+    complete_batches = SetProcessed(batcher.GetCompleteBatches(20));
+    ASSERT_TRUE(complete_batches.empty());
+    complete_batches = SetProcessed(batcher.GetCompleteBatches(55));
+    ASSERT_EQ(complete_batches.size(), 1U);
+    ASSERT_TRUE(batcher.SanityCheck());
+
+    /* The override survives deletion of the topic, as happens when the
+       topic is temporarily unavailable. */
+    deleted = batcher.DeleteTopic("t1");
+    ASSERT_TRUE(deleted.empty());
+    msg = mc.NewMsg("t1", "t1 msg 2", 100);
+    complete_batches = SetProcessed(batcher.AddMsg(std::move(msg), 100));
+    ASSERT_TRUE(complete_batches.empty());
+    opt_nct = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_nct.IsKnown());
+    ASSERT_EQ(*opt_nct, 150);
+    ASSERT_TRUE(batcher.SanityCheck());
+
+    /* Clearing the override reverts to the configured limits, including
+       for the batch in progress. */
+    batcher.ClearTopicConfig("t1");
+    ASSERT_TRUE(batcher.SanityCheck());
+    opt_nct = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_nct.IsKnown());
+    ASSERT_EQ(*opt_nct, 110);
+    SetProcessed(batcher.GetAllBatches());
+
+    /* Clearing a topic with no override does nothing. */
+    batcher.ClearTopicConfig("t3");
+    ASSERT_TRUE(batcher.SanityCheck());
+  }
+
+  TEST_F(TPerTopicBatcherTest, TakeTopicBatchTest) {
+    TTestMsgCreator mc;  // create this first since it contains buffer pool
+    TPerTopicBatcher batcher(MakeTopicBatchConfig());
+    std::list<TMsg::TPtr> batch = batcher.TakeTopicBatch("t1");
+    ASSERT_TRUE(batch.empty());
+
+    TMsg::TPtr msg = mc.NewMsg("t1", "t1 msg 1", 5);
+    std::list<std::list<TMsg::TPtr>> complete_batches =
+        SetProcessed(batcher.AddMsg(std::move(msg), 5));
+    ASSERT_TRUE(complete_batches.empty());
+    msg = mc.NewMsg("t2", "t2 msg 1", 6);
+    complete_batches = SetProcessed(batcher.AddMsg(std::move(msg), 6));
+    ASSERT_TRUE(complete_batches.empty());
+    msg = mc.NewMsg("t1", "t1 msg 2", 7);
+    complete_batches = SetProcessed(batcher.AddMsg(std::move(msg), 7));
+    ASSERT_TRUE(complete_batches.empty());
+    TOpt<TMsg::TTimestamp> opt_nct = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_nct.IsKnown());
+    ASSERT_EQ(*opt_nct, 15);
+
+    /* Taking the t1 batch leaves only the t2 batch and its expiry. */
+    batch = SetProcessed(batcher.TakeTopicBatch("t1"));
+    ASSERT_EQ(batch.size(), 2U);
+    ASSERT_EQ(batch.front()->GetTopic(), "t1");
+    ASSERT_TRUE(batcher.SanityCheck());
+    opt_nct = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_nct.IsKnown());
+    ASSERT_EQ(*opt_nct, 26);
+    batch = SetProcessed(batcher.TakeTopicBatch("t1"));
+    ASSERT_TRUE(batch.empty());
+
+    batch = SetProcessed(batcher.TakeTopicBatch("t2"));
+    ASSERT_EQ(batch.size(), 1U);
+    ASSERT_TRUE(batcher.SanityCheck());
+    ASSERT_FALSE(batcher.GetNextCompleteTime().IsKnown());
+  }
+
 }  // namespace
 
 int main(int argc, char **argv) {
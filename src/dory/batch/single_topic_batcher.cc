@@ -27,7 +27,8 @@ using namespace Dory;
 using namespace Dory::Batch;
 
 std::list<TMsg::TPtr>
-TSingleTopicBatcher::DoAddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now) {
+TSingleTopicBatcher::DoAddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now,
+    size_t delivery_estimate) {
   assert(this);
   assert(msg);
 
@@ -35,7 +36,7 @@ TSingleTopicBatcher::DoAddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now) {
     return std::list<TMsg::TPtr>();
   }
 
-  switch (CoreState.ProcessNewMsg(now, msg)) {
+  switch (CoreState.ProcessNewMsg(now, msg, delivery_estimate)) {
     case TBatcherCore::TAction::LeaveMsgAndReturnBatch: {
       break;
     }
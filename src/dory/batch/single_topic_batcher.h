@@ -23,6 +23,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <list>
 #include <string>
 
@@ -59,15 +60,23 @@ namespace Dory {
         return CoreState.GetConfig();
       }
 
+      void SetConfig(const TBatchConfig &config) {
+        assert(this);
+        CoreState.SetConfig(config);
+      }
+
       bool BatchingIsEnabled() const {
         assert(this);
         return CoreState.BatchingIsEnabled();
       }
 
+      /* See TBatcherCore::ProcessNewMsg() for 'delivery_estimate'. */
       std::list<TMsg::TPtr>
-      AddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now) {
+      AddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now,
+          size_t delivery_estimate = 0) {
         assert(this);
-        std::list<TMsg::TPtr> result = DoAddMsg(std::move(msg), now);
+        std::list<TMsg::TPtr> result = DoAddMsg(std::move(msg), now,
+            delivery_estimate);
         assert(MsgList.size() == CoreState.GetMsgCount());
         return std::move(result);
       }
@@ -77,6 +86,21 @@ namespace Dory {
         return CoreState.GetNextCompleteTime();
       }
 
+      /* Return the reason the batch most recently returned by AddMsg() was
+         completed. */
+      TBatcherCore::TCompletionReason GetCompletionReason() const {
+        assert(this);
+        return CoreState.GetCompletionReason();
+      }
+
+      /* If the most recent call to AddMsg() returned a batch without
+         accepting the message, return the reason the message forms a
+         complete batch by itself. */
+      TBatcherCore::TCompletionReason GetLeftMsgCompletionReason() const {
+        assert(this);
+        return CoreState.GetLeftMsgCompletionReason();
+      }
+
       /* Empty out the batcher, and return all messages it contained. */
       std::list<TMsg::TPtr> TakeBatch() {
         assert(this);
@@ -87,7 +111,8 @@ namespace Dory {
 
       private:
       std::list<TMsg::TPtr>
-      DoAddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now);
+      DoAddMsg(TMsg::TPtr &&msg, TMsg::TTimestamp now,
+          size_t delivery_estimate);
 
       TBatcherCore CoreState;
 
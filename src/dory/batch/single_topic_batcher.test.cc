@@ -287,6 +287,118 @@ namespace {
     ASSERT_TRUE(batcher.IsEmpty());
   }
 
+  TEST_F(TSingleTopicBatcherTest, LatencyBudgetTest) {
+    TTestMsgCreator mc;  // create this first since it contains buffer pool
+    TBatchConfig config(100, 0, 0, 60);
+    TSingleTopicBatcher batcher(config);
+    ASSERT_TRUE(batcher.BatchingIsEnabled());
+
+    /* With an expected delivery time of 20 ms, the 60 ms budget completes
+       the batch 40 ms after the oldest message's timestamp, which is sooner
+       than the 100 ms time limit. */
+    TMsg::TPtr msg = mc.NewMsg("Bugs Bunny", "wabbits", 10);
+    std::list<TMsg::TPtr> msg_list =
+        SetProcessed(batcher.AddMsg(std::move(msg), 15, 20));
+    ASSERT_FALSE(!!msg);
+    ASSERT_TRUE(msg_list.empty());
+    TOpt<TMsg::TTimestamp> opt_ts = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_ts.IsKnown());
+    ASSERT_EQ(*opt_ts, 50);
+
+    /* A changed estimate doesn't affect a batch already started. */
+    msg = mc.NewMsg("Bugs Bunny", "wabbits", 30);
+    msg_list = SetProcessed(batcher.AddMsg(std::move(msg), 49, 0));
+    ASSERT_FALSE(!!msg);
+    ASSERT_TRUE(msg_list.empty());
+    opt_ts = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_ts.IsKnown());
+    ASSERT_EQ(*opt_ts, 50);
+    msg = mc.NewMsg("Bugs Bunny", "wabbits", 30);
+    msg_list = SetProcessed(batcher.AddMsg(std::move(msg), 50, 0));
+    ASSERT_FALSE(!!msg);
+    ASSERT_EQ(msg_list.size(), 3U);
+    ASSERT_TRUE(batcher.IsEmpty());
+
+    /* With an expected delivery time of 0, the whole 60 ms budget is
+       available, so the batch completes 60 ms after the message's timestamp.
+       That is still sooner than the 100 ms time limit. */
+    msg = mc.NewMsg("Bugs Bunny", "wabbits", 100);
+    msg_list = SetProcessed(batcher.AddMsg(std::move(msg), 100, 0));
+    ASSERT_TRUE(msg_list.empty());
+    opt_ts = batcher.GetNextCompleteTime();
+    ASSERT_TRUE(opt_ts.IsKnown());
+    ASSERT_EQ(*opt_ts, 160);
+    msg_list = SetProcessed(batcher.TakeBatch());
+    ASSERT_EQ(msg_list.size(), 1U);
+
+    /* If delivery is expected to use up the whole budget, the message is
+       not batched. */
+    msg = mc.NewMsg("Bugs Bunny", "wabbits", 200);
+    msg_list = SetProcessed(batcher.AddMsg(std::move(msg), 200, 70));
+    ASSERT_FALSE(!!msg);
+    ASSERT_EQ(msg_list.size(), 1U);
+    ASSERT_TRUE(batcher.IsEmpty());
+  }
+
+  TEST_F(TSingleTopicBatcherTest, CompletionReasonTest) {
+    using TReason = TBatcherCore::TCompletionReason;
+    TTestMsgCreator mc;  // create this first since it contains buffer pool
+    TBatchConfig config(100, 3, 10);
+    TSingleTopicBatcher batcher(config);
+
+    /* Message count limit. */
+    std::list<TMsg::TPtr> msg_list =
+        SetProcessed(batcher.AddMsg(mc.NewMsg("t", "a", 0), 0));
+    ASSERT_TRUE(msg_list.empty());
+    msg_list = SetProcessed(batcher.AddMsg(mc.NewMsg("t", "b", 0), 0));
+    ASSERT_TRUE(msg_list.empty());
+    msg_list = SetProcessed(batcher.AddMsg(mc.NewMsg("t", "c", 0), 0));
+    ASSERT_EQ(msg_list.size(), 3U);
+    ASSERT_TRUE(batcher.GetCompletionReason() == TReason::MsgCount);
+
+    /* Time limit. */
+    msg_list = SetProcessed(batcher.AddMsg(mc.NewMsg("t", "a", 10), 10));
+    ASSERT_TRUE(msg_list.empty());
+    msg_list = SetProcessed(batcher.AddMsg(mc.NewMsg("t", "b", 110), 110));
+    ASSERT_EQ(msg_list.size(), 2U);
+    ASSERT_TRUE(batcher.GetCompletionReason() == TReason::TimeLimit);
+
+    /* Byte count limit reached exactly. */
+    msg_list = SetProcessed(batcher.AddMsg(mc.NewMsg("t", "12345", 120),
+        120));
+    ASSERT_TRUE(msg_list.empty());
+    msg_list = SetProcessed(batcher.AddMsg(mc.NewMsg("t", "67890", 120),
+        120));
+    ASSERT_EQ(msg_list.size(), 2U);
+    ASSERT_TRUE(batcher.GetCompletionReason() == TReason::ByteCount);
+
+    /* Byte count limit would be exceeded by the next message. */
+    msg_list = SetProcessed(batcher.AddMsg(mc.NewMsg("t", "123456", 130),
+        130));
+    ASSERT_TRUE(msg_list.empty());
+    msg_list = SetProcessed(batcher.AddMsg(mc.NewMsg("t", "789012", 130),
+        130));
+    ASSERT_EQ(msg_list.size(), 1U);
+    ASSERT_TRUE(batcher.GetCompletionReason() == TReason::ByteCount);
+    ASSERT_FALSE(batcher.IsEmpty());
+    SetProcessed(batcher.TakeBatch());
+
+    /* Byte count limit would be exceeded, and the new message is already
+       past its time limit, so it isn't accepted.  The returned batch and the
+       message left out have different reasons. */
+    msg_list = SetProcessed(batcher.AddMsg(mc.NewMsg("t", "123456", 200),
+        200));
+    ASSERT_TRUE(msg_list.empty());
+    TMsg::TPtr msg = mc.NewMsg("t", "789012", 150);
+    msg_list = SetProcessed(batcher.AddMsg(std::move(msg), 250));
+    ASSERT_EQ(msg_list.size(), 1U);
+    ASSERT_TRUE(!!msg);
+    ASSERT_TRUE(batcher.IsEmpty());
+    ASSERT_TRUE(batcher.GetCompletionReason() == TReason::ByteCount);
+    ASSERT_TRUE(batcher.GetLeftMsgCompletionReason() == TReason::TimeLimit);
+    SetProcessed(msg);
+  }
+
 }  // namespace
 
 int main(int argc, char **argv) {
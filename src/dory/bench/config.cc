@@ -0,0 +1,189 @@
+/* <dory/bench/config.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/bench/config.h>.
+ */
+
+#include <dory/bench/config.h>
+
+#include <base/basename.h>
+#include <dory/build_id.h>
+#include <dory/util/arg_parse_error.h>
+#include <tclap/CmdLine.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Bench;
+using namespace Dory::Client;
+using namespace Dory::Util;
+
+static void ParseArgs(int argc, char *argv[], TConfig &config) {
+  using namespace TCLAP;
+  const std::string prog_name = Basename(argv[0]);
+  std::vector<const char *> arg_vec(&argv[0], &argv[0] + argc);
+  arg_vec[0] = prog_name.c_str();
+
+  try {
+    CmdLine cmd("End-to-end throughput benchmark for Dory.  Runs Dory and a "
+        "mock Kafka cluster in process, drives load from client threads, and "
+        "writes results as JSON.", ' ', dory_build_id);
+    SwitchArg arg_log_echo("", "log_echo", "Echo syslog messages to standard "
+        "error.", cmd, config.LogEcho);
+    ValueArg<decltype(config.Duration)> arg_duration("", "duration",
+        "Length of load phase in seconds.", false, config.Duration,
+        "SECONDS");
+    cmd.add(arg_duration);
+    ValueArg<decltype(config.DrainTimeout)> arg_drain_timeout("",
+        "drain_timeout", "Maximum time in seconds to wait after load phase "
+        "for Dory to finish delivering messages.", false,
+        config.DrainTimeout, "SECONDS");
+    cmd.add(arg_drain_timeout);
+    ValueArg<decltype(config.ThreadCount)> arg_threads("", "threads",
+        "Number of client threads sending messages.", false,
+        config.ThreadCount, "COUNT");
+    cmd.add(arg_threads);
+    ValueArg<std::string> arg_transports("", "transports", "Comma-separated "
+        "list of transports from { dg, stream, tcp }.  Client threads are "
+        "assigned transports from the list in round-robin order.", false,
+        "dg", "LIST");
+    cmd.add(arg_transports);
+    ValueArg<decltype(config.TopicCount)> arg_topics("", "topics",
+        "Number of topics.  Each message goes to a randomly chosen topic.",
+        false, config.TopicCount, "COUNT");
+    cmd.add(arg_topics);
+    ValueArg<decltype(config.PartitionCount)> arg_partitions("",
+        "partitions", "Number of partitions per topic.", false,
+        config.PartitionCount, "COUNT");
+    cmd.add(arg_partitions);
+    ValueArg<decltype(config.BrokerCount)> arg_brokers("", "brokers",
+        "Number of mock Kafka brokers.", false, config.BrokerCount, "COUNT");
+    cmd.add(arg_brokers);
+    ValueArg<std::string> arg_value_size("", "value_size", "Message value "
+        "size in bytes, either N or a uniformly distributed range MIN-MAX.",
+        false, "100", "SIZE");
+    cmd.add(arg_value_size);
+    ValueArg<decltype(config.KeySize)> arg_key_size("", "key_size",
+        "Message key size in bytes.", false, config.KeySize, "SIZE");
+    cmd.add(arg_key_size);
+    ValueArg<decltype(config.PartitionKeyPercent)> arg_partition_key_percent(
+        "", "partition_key_percent", "Percentage of messages sent as "
+        "partition key messages.  The rest are sent as any-partition "
+        "messages.", false, config.PartitionKeyPercent, "PERCENT");
+    cmd.add(arg_partition_key_percent);
+    ValueArg<decltype(config.Rate)> arg_rate("", "rate", "Target total rate "
+        "in messages per second.  A value of 0 means \"send messages as fast "
+        "as possible\".", false, config.Rate, "RATE");
+    cmd.add(arg_rate);
+    ValueArg<decltype(config.BatchTimeLimit)> arg_batch_time_limit("",
+        "batch_time_limit", "Per-topic batching time limit in milliseconds "
+        "(0 disables).", false, config.BatchTimeLimit, "MS");
+    cmd.add(arg_batch_time_limit);
+    ValueArg<decltype(config.BatchMsgCount)> arg_batch_msg_count("",
+        "batch_msg_count", "Per-topic batching message count limit "
+        "(0 disables).", false, config.BatchMsgCount, "COUNT");
+    cmd.add(arg_batch_msg_count);
+    ValueArg<decltype(config.BatchByteCount)> arg_batch_byte_count("",
+        "batch_byte_count", "Per-topic batching byte count limit "
+        "(0 disables).", false, config.BatchByteCount, "BYTES");
+    cmd.add(arg_batch_byte_count);
+    ValueArg<decltype(config.Compression)> arg_compression("", "compression",
+        "Compression type: none or snappy.", false, config.Compression,
+        "TYPE");
+    cmd.add(arg_compression);
+    ValueArg<decltype(config.MsgBufferMax)> arg_msg_buffer_max("",
+        "msg_buffer_max", "Maximum amount of memory in Kb for Dory to use "
+        "for buffering messages.", false, config.MsgBufferMax, "MAX_KB");
+    cmd.add(arg_msg_buffer_max);
+    MultiArg<std::string> arg_dory_arg("", "dory_arg", "Extra command line "
+        "argument to pass to Dory.  May be given multiple times.", false,
+        "ARG");
+    cmd.add(arg_dory_arg);
+    ValueArg<decltype(config.Label)> arg_label("", "label", "Label to copy "
+        "to output, for telling results apart.", false, config.Label,
+        "LABEL");
+    cmd.add(arg_label);
+    ValueArg<decltype(config.OutputFile)> arg_output("", "output", "File to "
+        "write JSON results to.  Default is standard output.", false,
+        config.OutputFile, "FILE");
+    cmd.add(arg_output);
+    cmd.parse(argc, &arg_vec[0]);
+    config.LogEcho = arg_log_echo.getValue();
+    config.Duration = arg_duration.getValue();
+    config.DrainTimeout = arg_drain_timeout.getValue();
+    config.ThreadCount = arg_threads.getValue();
+    config.Transports =
+        TLoadGenerator::ParseTransports(arg_transports.getValue());
+    config.TopicCount = arg_topics.getValue();
+    config.PartitionCount = arg_partitions.getValue();
+    config.BrokerCount = arg_brokers.getValue();
+    TLoadGenerator::ParseSizeRange(arg_value_size.getValue(),
+        config.MinValueSize, config.MaxValueSize);
+    config.KeySize = arg_key_size.getValue();
+    config.PartitionKeyPercent = arg_partition_key_percent.getValue();
+    config.Rate = arg_rate.getValue();
+    config.BatchTimeLimit = arg_batch_time_limit.getValue();
+    config.BatchMsgCount = arg_batch_msg_count.getValue();
+    config.BatchByteCount = arg_batch_byte_count.getValue();
+    config.Compression = arg_compression.getValue();
+    config.MsgBufferMax = arg_msg_buffer_max.getValue();
+    config.DoryArgs = arg_dory_arg.getValue();
+    config.Label = arg_label.getValue();
+    config.OutputFile = arg_output.getValue();
+  } catch (const ArgException &x) {
+    throw TArgParseError(x.error(), x.argId());
+  }
+
+  if (config.Duration == 0) {
+    throw TArgParseError("--duration must be at least 1");
+  }
+
+  if ((config.ThreadCount == 0) || (config.TopicCount == 0) ||
+      (config.PartitionCount == 0) || (config.BrokerCount == 0)) {
+    throw TArgParseError(
+        "--threads, --topics, --partitions, and --brokers must be at least 1");
+  }
+
+  if (config.PartitionKeyPercent > 100) {
+    throw TArgParseError("--partition_key_percent must be at most 100");
+  }
+
+  if ((config.Compression != "none") && (config.Compression != "snappy")) {
+    throw TArgParseError("--compression must be none or snappy");
+  }
+}
+
+TConfig::TConfig(int argc, char *argv[])
+    : LogEcho(false),
+      Duration(10),
+      DrainTimeout(30),
+      ThreadCount(4),
+      TopicCount(1),
+      PartitionCount(8),
+      BrokerCount(3),
+      MinValueSize(100),
+      MaxValueSize(100),
+      KeySize(0),
+      PartitionKeyPercent(0),
+      Rate(0),
+      BatchTimeLimit(0),
+      BatchMsgCount(0),
+      BatchByteCount(0),
+      Compression("none"),
+      MsgBufferMax(256 * 1024) {
+  ParseArgs(argc, argv, *this);
+}
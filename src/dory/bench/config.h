@@ -0,0 +1,93 @@
+/* <dory/bench/config.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Configuration for dory_bench.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <dory/client/load_generator.h>
+
+namespace Dory {
+
+  namespace Bench {
+
+    struct TConfig {
+      /* Throws TArgParseError on error parsing args. */
+      TConfig(int argc, char *argv[]);
+
+      bool LogEcho;
+
+      /* Length of the load phase in seconds. */
+      size_t Duration;
+
+      /* After the load phase, wait at most this many seconds for Dory to
+         deliver or discard the messages it has received. */
+      size_t DrainTimeout;
+
+      size_t ThreadCount;
+
+      std::vector<Client::TLoadGenerator::TTransport> Transports;
+
+      size_t TopicCount;
+
+      size_t PartitionCount;
+
+      size_t BrokerCount;
+
+      size_t MinValueSize;
+
+      size_t MaxValueSize;
+
+      size_t KeySize;
+
+      unsigned PartitionKeyPercent;
+
+      /* Target rate in messages per second.  0 means send as fast as
+         possible. */
+      size_t Rate;
+
+      /* Per-topic batching limits.  0 disables a limit.  If all are 0,
+         batching is disabled. */
+      size_t BatchTimeLimit;
+
+      size_t BatchMsgCount;
+
+      size_t BatchByteCount;
+
+      std::string Compression;
+
+      size_t MsgBufferMax;
+
+      /* Extra command line arguments passed to Dory. */
+      std::vector<std::string> DoryArgs;
+
+      /* Free-form label copied to the output, for telling results apart. */
+      std::string Label;
+
+      /* Empty means standard output. */
+      std::string OutputFile;
+    };  // TConfig
+
+  }  // Bench
+
+}  // Dory
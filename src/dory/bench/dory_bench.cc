@@ -0,0 +1,614 @@
+/* <dory/bench/dory_bench.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   End-to-end throughput benchmark.  Starts a mock Kafka cluster and Dory in
+   process, drives load from client threads using TLoadGenerator, and writes
+   throughput, CPU usage, latency, and discard figures as JSON.  Build in
+   release mode for meaningful numbers.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <base/error_utils.h>
+#include <base/indent.h>
+#include <base/opt.h>
+#include <base/time_util.h>
+#include <base/tmp_dir.h>
+#include <base/tmp_file.h>
+#include <base/tmp_file_name.h>
+#include <dory/anomaly_tracker.h>
+#include <dory/bench/config.h>
+#include <dory/build_id.h>
+#include <dory/client/load_generator.h>
+#include <dory/dory_server.h>
+#include <dory/latency_tracker.h>
+#include <dory/mock_kafka_server/config.h>
+#include <dory/mock_kafka_server/main_thread.h>
+#include <dory/mock_kafka_server/received_request_tracker.h>
+#include <dory/msg_state_tracker.h>
+#include <dory/util/arg_parse_error.h>
+#include <dory/util/handle_xml_errors.h>
+#include <dory/util/histogram.h>
+#include <dory/util/json_util.h>
+#include <dory/util/misc_util.h>
+#include <xml/test/xml_test_initializer.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Bench;
+using namespace Dory::Client;
+using namespace Dory::Util;
+using namespace Xml::Test;
+
+/* The mock Kafka server simulates brokers on consecutive virtual ports
+   starting here, and maps them to ephemeral physical ports. */
+static const in_port_t MOCK_KAFKA_VIRTUAL_PORT = 10000;
+
+static std::string TopicName(size_t index) {
+  return "bench_topic_" + std::to_string(index);
+}
+
+static void WriteLine(const TTmpFile &file, const std::string &line) {
+  IfLt0(write(file.GetFd(), line.data(), line.size()));
+  IfLt0(write(file.GetFd(), "\n", 1));
+}
+
+/* Write setup file for mock Kafka server.  Topics have their first partition
+   on consecutive brokers, so load spreads evenly over brokers. */
+static void WriteMockKafkaSetup(const Bench::TConfig &cfg,
+    const TTmpFile &file) {
+  WriteLine(file, "ports " + std::to_string(MOCK_KAFKA_VIRTUAL_PORT) + " " +
+      std::to_string(cfg.BrokerCount));
+
+  for (size_t i = 0; i < cfg.TopicCount; ++i) {
+    WriteLine(file, "topic " + TopicName(i) + " " +
+        std::to_string(cfg.PartitionCount) + " " +
+        std::to_string(i % cfg.BrokerCount));
+  }
+}
+
+static std::string LimitValue(size_t limit) {
+  return limit ? std::to_string(limit) : std::string("disable");
+}
+
+static std::string CreateDoryConf(const Bench::TConfig &cfg,
+    in_port_t broker_port) {
+  bool batching = cfg.BatchTimeLimit || cfg.BatchMsgCount ||
+      cfg.BatchByteCount;
+  std::ostringstream os;
+  os << "<?xml version=\"1.0\" encoding=\"US-ASCII\"?>" << std::endl
+     << "<doryConfig>" << std::endl
+     << "    <batching>" << std::endl;
+
+  if (batching) {
+    os << "        <namedConfigs>" << std::endl
+       << "            <config name=\"bench\">" << std::endl
+       << "                <time value=\"" << LimitValue(cfg.BatchTimeLimit)
+       << "\" />" << std::endl
+       << "                <messages value=\""
+       << LimitValue(cfg.BatchMsgCount) << "\" />" << std::endl
+       << "                <bytes value=\"" << LimitValue(cfg.BatchByteCount)
+       << "\" />" << std::endl
+       << "            </config>" << std::endl
+       << "        </namedConfigs>" << std::endl
+       << "        <produceRequestDataLimit value=\"1024k\" />" << std::endl;
+  } else {
+    os << "        <produceRequestDataLimit value=\"0\" />" << std::endl;
+  }
+
+  os << "        <messageMaxBytes value=\"1024k\" />" << std::endl
+     << "        <combinedTopics enable=\"false\" />" << std::endl;
+
+  if (batching) {
+    os << "        <defaultTopic action=\"perTopic\" config=\"bench\" />"
+       << std::endl;
+  } else {
+    os << "        <defaultTopic action=\"disable\" />" << std::endl;
+  }
+
+  os << "    </batching>" << std::endl
+     << "    <compression>" << std::endl
+     << "        <namedConfigs>" << std::endl
+     << "            <config name=\"bench\" type=\"" << cfg.Compression
+     << "\" />" << std::endl
+     << "        </namedConfigs>" << std::endl
+     << std::endl
+     << "        <defaultTopic config=\"bench\" />" << std::endl
+     << "    </compression>" << std::endl
+     << "    <initialBrokers>" << std::endl
+     << "        <broker host=\"localhost\" port=\"" << broker_port << "\" />"
+     << std::endl
+     << "    </initialBrokers>" << std::endl
+     << "</doryConfig>" << std::endl;
+  return os.str();
+}
+
+static uint64_t GetProcessCpuMicroseconds() {
+  struct rusage usage;
+  IfLt0(getrusage(RUSAGE_SELF, &usage));
+  return (static_cast<uint64_t>(usage.ru_utime.tv_sec +
+      usage.ru_stime.tv_sec) * 1000000) +
+      static_cast<uint64_t>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+/* Consume the requests the mock Kafka server has handled so far, and return
+   the number of messages it acknowledged successfully.  Draining regularly
+   keeps the mock server's request queue from growing without bound. */
+static uint64_t DrainDelivered(MockKafkaServer::TMainThread &kafka) {
+  std::list<MockKafkaServer::TReceivedRequestTracker::TRequestInfo> requests;
+  kafka.NonblockingGetHandledRequests(requests);
+  uint64_t delivered = 0;
+
+  for (const auto &info : requests) {
+    if (info.ProduceRequestInfo.IsKnown() &&
+        (info.ProduceRequestInfo->ReturnedErrorCode == 0)) {
+      delivered += info.ProduceRequestInfo->MsgCount;
+    }
+  }
+
+  return delivered;
+}
+
+static uint64_t GetDiscardCount(const TDoryServer &dory) {
+  TAnomalyTracker::TTotals totals;
+  dory.GetAnomalyTracker().GetTotals(totals);
+  uint64_t count = totals.OtherTopics.DiscardCount +
+      totals.MalformedMsgCount + totals.UnsupportedApiKeyMsgCount +
+      totals.UnsupportedVersionMsgCount + totals.BadTopicMsgCount;
+
+  for (const auto &item : totals.Topics) {
+    count += item.second.DiscardCount;
+  }
+
+  return count;
+}
+
+/* Figures gathered by RunBench(). */
+struct TBenchResult {
+  TLoadGenerator::TResult Client;
+
+  uint64_t Delivered;
+
+  uint64_t Discarded;
+
+  /* Time from start of load until Dory finished delivering, or until the
+     drain timeout expired. */
+  uint64_t DeliveryUs;
+
+  uint64_t ProcessCpuUs;
+
+  /* Latency histograms for all topics merged, indexed by stage. */
+  TLatencyTracker::THistograms Latency;
+
+  TBenchResult()
+      : Delivered(0),
+        Discarded(0),
+        DeliveryUs(0),
+        ProcessCpuUs(0) {
+  }
+};  // TBenchResult
+
+static uint64_t PerSecond(uint64_t count, uint64_t usec) {
+  return usec ? static_cast<uint64_t>(
+      (static_cast<double>(count) * 1000000.0) / usec) : 0;
+}
+
+static void WriteResultJson(std::ostream &os, const Bench::TConfig &cfg,
+    const TBenchResult &result) {
+  const TLoadGenerator::TResult &client = result.Client;
+  std::string indent_str;
+  TIndent ind0(indent_str, TIndent::StartAt::Zero, 4);
+  os << ind0 << "{" << std::endl;
+
+  {
+    TIndent ind1(ind0);
+    os << ind1 << "\"label\": " << JsonString(cfg.Label) << "," << std::endl
+        << ind1 << "\"version\": " << JsonString(dory_build_id) << ","
+        << std::endl
+        << ind1 << "\"config\": {" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      std::string transports;
+
+      for (TLoadGenerator::TTransport t : cfg.Transports) {
+        transports += transports.empty() ? "" : ",";
+        transports += TLoadGenerator::TransportToString(t);
+      }
+
+      os << ind2 << "\"duration_sec\": " << cfg.Duration << "," << std::endl
+          << ind2 << "\"threads\": " << cfg.ThreadCount << "," << std::endl
+          << ind2 << "\"transports\": " << JsonString(transports) << ","
+          << std::endl
+          << ind2 << "\"topics\": " << cfg.TopicCount << "," << std::endl
+          << ind2 << "\"partitions\": " << cfg.PartitionCount << ","
+          << std::endl
+          << ind2 << "\"brokers\": " << cfg.BrokerCount << "," << std::endl
+          << ind2 << "\"min_value_size\": " << cfg.MinValueSize << ","
+          << std::endl
+          << ind2 << "\"max_value_size\": " << cfg.MaxValueSize << ","
+          << std::endl
+          << ind2 << "\"key_size\": " << cfg.KeySize << "," << std::endl
+          << ind2 << "\"partition_key_percent\": " << cfg.PartitionKeyPercent
+          << "," << std::endl
+          << ind2 << "\"rate\": " << cfg.Rate << "," << std::endl
+          << ind2 << "\"batch_time_limit_ms\": " << cfg.BatchTimeLimit << ","
+          << std::endl
+          << ind2 << "\"batch_msg_count\": " << cfg.BatchMsgCount << ","
+          << std::endl
+          << ind2 << "\"batch_byte_count\": " << cfg.BatchByteCount << ","
+          << std::endl
+          << ind2 << "\"compression\": " << JsonString(cfg.Compression) << ","
+          << std::endl
+          << ind2 << "\"msg_buffer_max_kb\": " << cfg.MsgBufferMax << ","
+          << std::endl
+          << ind2 << "\"dory_args\": [";
+
+      for (size_t i = 0; i < cfg.DoryArgs.size(); ++i) {
+        os << (i ? ", " : "") << JsonString(cfg.DoryArgs[i]);
+      }
+
+      os << "]" << std::endl;
+    }
+
+    os << ind1 << "}," << std::endl
+        << ind1 << "\"client\": {" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      os << ind2 << "\"msgs_sent\": " << client.MsgsSent << "," << std::endl
+          << ind2 << "\"bytes_sent\": " << client.BytesSent << ","
+          << std::endl
+          << ind2 << "\"send_errors\": " << client.SendErrors << ","
+          << std::endl
+          << ind2 << "\"elapsed_us\": " << client.ElapsedUs << ","
+          << std::endl
+          << ind2 << "\"msgs_per_sec\": "
+          << PerSecond(client.MsgsSent, client.ElapsedUs) << "," << std::endl
+          << ind2 << "\"bytes_per_sec\": "
+          << PerSecond(client.BytesSent, client.ElapsedUs) << ","
+          << std::endl
+          << ind2 << "\"cpu_us\": " << client.ClientCpuUs << "," << std::endl
+          << ind2 << "\"send_latency_ns\": ";
+      WriteHistogramJson(os, client.SendLatencyNs, ind2);
+      os << "," << std::endl << ind2 << "\"errors\": [";
+
+      for (size_t i = 0; i < client.Errors.size(); ++i) {
+        os << (i ? ", " : "") << JsonString(client.Errors[i]);
+      }
+
+      os << "]" << std::endl;
+    }
+
+    /* The process CPU time includes the mock Kafka server, which runs in the
+       same process as Dory.  Client thread CPU time is subtracted. */
+    uint64_t server_cpu_us = (result.ProcessCpuUs > client.ClientCpuUs) ?
+        (result.ProcessCpuUs - client.ClientCpuUs) : 0;
+    uint64_t accounted = result.Delivered + result.Discarded;
+    uint64_t undelivered = (client.MsgsSent > accounted) ?
+        (client.MsgsSent - accounted) : 0;
+    os << ind1 << "}," << std::endl
+        << ind1 << "\"server\": {" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      os << ind2 << "\"delivered_msgs\": " << result.Delivered << ","
+          << std::endl
+          << ind2 << "\"discarded_msgs\": " << result.Discarded << ","
+          << std::endl
+          << ind2 << "\"undelivered_msgs\": " << undelivered << ","
+          << std::endl
+          << ind2 << "\"delivery_us\": " << result.DeliveryUs << ","
+          << std::endl
+          << ind2 << "\"delivered_msgs_per_sec\": "
+          << PerSecond(result.Delivered, result.DeliveryUs) << ","
+          << std::endl
+          << ind2 << "\"cpu_us\": " << server_cpu_us << "," << std::endl
+          << ind2 << "\"cpu_ns_per_msg\": "
+          << (result.Delivered ?
+              ((server_cpu_us * 1000) / result.Delivered) : 0)
+          << "," << std::endl
+          << ind2 << "\"latency_us\": {" << std::endl;
+
+      {
+        TIndent ind3(ind2);
+
+        for (size_t i = 0; i < TLatencyTracker::STAGE_COUNT; ++i) {
+          os << ind3 << "\"" << TLatencyTracker::StageToString(
+              static_cast<TLatencyTracker::TStage>(i)) << "\": ";
+          WriteHistogramJson(os, result.Latency[i], ind3);
+          os << ((i + 1 < TLatencyTracker::STAGE_COUNT) ? "," : "")
+              << std::endl;
+        }
+      }
+
+      os << ind2 << "}" << std::endl;
+    }
+
+    os << ind1 << "}" << std::endl;
+  }
+
+  os << ind0 << "}" << std::endl;
+}
+
+/* Start Dory with the given configuration file and input sockets.  Returns
+   nullptr on failure, after writing an error message to standard error. */
+static std::unique_ptr<TDoryServer> CreateDory(const Bench::TConfig &cfg,
+    const char *conf_path, const char *dg_path, const char *stream_path) {
+  std::string msg_buffer_max_str = std::to_string(cfg.MsgBufferMax);
+  std::vector<const char *> args;
+  args.push_back("dory");
+  args.push_back("--config_path");
+  args.push_back(conf_path);
+  args.push_back("--msg_buffer_max");
+  args.push_back(msg_buffer_max_str.c_str());
+  args.push_back("--receive_socket_name");
+  args.push_back(dg_path);
+  args.push_back("--receive_stream_socket_name");
+  args.push_back(stream_path);
+  args.push_back("--input_port");
+  args.push_back("0");  // 0 means "request ephemeral port"
+  args.push_back("--client_id");
+  args.push_back("dory_bench");
+  args.push_back("--status_loopback_only");
+  args.push_back("--log_level");
+  args.push_back(cfg.LogEcho ? "LOG_INFO" : "LOG_WARNING");
+
+  if (cfg.LogEcho) {
+    args.push_back("--log_echo");
+  }
+
+  for (const std::string &arg : cfg.DoryArgs) {
+    args.push_back(arg.c_str());
+  }
+
+  args.push_back(nullptr);
+  TOpt<TDoryServer::TServerConfig> dory_config;
+  bool large_sendbuf_required = false;
+  TOpt<std::string> opt_err_msg = HandleXmlErrors(
+      [&]() -> void {
+        dory_config.MakeKnown(TDoryServer::CreateConfig(args.size() - 1,
+            const_cast<char **>(&args[0]), large_sendbuf_required, true));
+      }
+  );
+
+  if (opt_err_msg.IsKnown()) {
+    std::cerr << *opt_err_msg << std::endl;
+    return nullptr;
+  }
+
+  const Dory::TConfig &config = dory_config->GetCmdLineConfig();
+  InitSyslog(args[0], config.LogLevel, config.LogEcho);
+  return std::unique_ptr<TDoryServer>(
+      new TDoryServer(std::move(*dory_config)));
+}
+
+/* Run the load phase and wait for Dory to finish delivering.  Returns false
+   on failure, after writing an error message to standard error. */
+static bool RunLoad(const Bench::TConfig &cfg, TDoryServer &dory,
+    MockKafkaServer::TMainThread &kafka, const char *dg_path,
+    const char *stream_path, TBenchResult &result) {
+  TLoadGenerator::TConfig load_cfg;
+  load_cfg.UnixDgPath = dg_path;
+  load_cfg.UnixStreamPath = stream_path;
+  load_cfg.TcpPort = dory.GetInputPort();
+  load_cfg.Transports = cfg.Transports;
+  load_cfg.ThreadCount = cfg.ThreadCount;
+
+  for (size_t i = 0; i < cfg.TopicCount; ++i) {
+    load_cfg.Topics.emplace_back(TopicName(i), 1);
+  }
+
+  load_cfg.MinValueSize = cfg.MinValueSize;
+  load_cfg.MaxValueSize = cfg.MaxValueSize;
+  load_cfg.KeySize = cfg.KeySize;
+  load_cfg.PartitionKeyPercent = cfg.PartitionKeyPercent;
+  load_cfg.Rate = cfg.Rate;
+  load_cfg.DurationMs = cfg.Duration * 1000;
+
+  /* Discard anything recorded during startup, such as metadata requests. */
+  DrainDelivered(kafka);
+  uint64_t discard_base = GetDiscardCount(dory);
+  uint64_t cpu_base = GetProcessCpuMicroseconds();
+  uint64_t start_us = GetMonotonicRawMicroseconds();
+  TLoadGenerator generator(load_cfg);
+  generator.Start();
+
+  while ((GetMonotonicRawMicroseconds() - start_us) <
+      load_cfg.DurationMs * 1000) {
+    SleepMilliseconds(100);
+    result.Delivered += DrainDelivered(kafka);
+  }
+
+  result.Client = generator.Join();
+
+  if (!result.Client.Errors.empty()) {
+    for (const std::string &err : result.Client.Errors) {
+      std::cerr << err << std::endl;
+    }
+
+    return false;
+  }
+
+  /* Wait until every message sent has been delivered or discarded.  Dory may
+     still hold messages in batches or in flight to the mock brokers. */
+  uint64_t drain_deadline_us = GetMonotonicRawMicroseconds() +
+      (cfg.DrainTimeout * 1000000);
+  result.DeliveryUs = GetMonotonicRawMicroseconds() - start_us;
+
+  for (; ; ) {
+    uint64_t delivered = DrainDelivered(kafka);
+    uint64_t now_us = GetMonotonicRawMicroseconds();
+
+    if (delivered) {
+      result.Delivered += delivered;
+      result.DeliveryUs = now_us - start_us;
+    }
+
+    result.Discarded = GetDiscardCount(dory) - discard_base;
+
+    if (((result.Delivered + result.Discarded) >= result.Client.MsgsSent) ||
+        (now_us >= drain_deadline_us)) {
+      break;
+    }
+
+    SleepMilliseconds(10);
+  }
+
+  result.ProcessCpuUs = GetProcessCpuMicroseconds() - cpu_base;
+  result.Latency = dory.GetMsgStateTracker().GetLatencyTracker()
+      .GetSnapshot().AllTopics;
+
+  return true;
+}
+
+static int BenchMain(int argc, char *argv[]) {
+  std::unique_ptr<Bench::TConfig> cfg;
+
+  try {
+    cfg.reset(new Bench::TConfig(argc, argv));
+  } catch (const TArgParseError &x) {
+    /* Error parsing command line arguments. */
+    std::cerr << x.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  TXmlTestInitializer xml_init;  // initializes Xerces XML library
+
+  /* Start mock Kafka cluster. */
+  TTmpFile kafka_setup_file("/tmp/dory_bench.XXXXXX", true);
+  TTmpDir kafka_output_dir("/tmp/dory_bench.XXXXXX", true);
+  WriteMockKafkaSetup(*cfg, kafka_setup_file);
+  std::vector<const char *> kafka_args;
+  kafka_args.push_back("mock_kafka_server");
+  kafka_args.push_back("--output_dir");
+  kafka_args.push_back(kafka_output_dir.GetName());
+  kafka_args.push_back("--setup_file");
+  kafka_args.push_back(kafka_setup_file.GetName());
+  kafka_args.push_back("--quiet_level");
+  kafka_args.push_back("3");
+  kafka_args.push_back("--single_output_file");
+  kafka_args.push_back(nullptr);
+  MockKafkaServer::TConfig kafka_cfg(kafka_args.size() - 1,
+      const_cast<char **>(&kafka_args[0]));
+  MockKafkaServer::TMainThread kafka(kafka_cfg);
+  kafka.Start();
+
+  if (!kafka.GetInitWaitFd().IsReadable(30000)) {
+    std::cerr << "Mock Kafka server failed to initialize after 30 seconds."
+        << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /* Start Dory. */
+  TTmpFile dory_conf_file("/tmp/dory_bench.XXXXXX", true);
+  std::ofstream ofs(dory_conf_file.GetName());
+  ofs << CreateDoryConf(*cfg,
+      kafka.VirtualPortToPhys(MOCK_KAFKA_VIRTUAL_PORT));
+  ofs.close();
+  TTmpFileName dg_path;
+  TTmpFileName stream_path;
+  std::unique_ptr<TDoryServer> dory = CreateDory(*cfg,
+      dory_conf_file.GetName(), dg_path, stream_path);
+
+  if (!dory) {
+    kafka.RequestShutdown();
+    kafka.Join();
+    return EXIT_FAILURE;
+  }
+
+  int dory_ret = EXIT_FAILURE;
+  std::thread dory_thread(
+      [&]() {
+        try {
+          dory->BindStatusSocket(true);
+          dory_ret = dory->Run();
+        } catch (const std::exception &x) {
+          std::cerr << "Server error: " << x.what() << std::endl;
+        } catch (...) {
+          std::cerr << "Unknown server error" << std::endl;
+        }
+      });
+  TBenchResult result;
+  bool ok = dory->GetInitWaitFd().IsReadable(30000);
+
+  if (ok) {
+    ok = RunLoad(*cfg, *dory, kafka, dg_path, stream_path, result);
+  } else {
+    std::cerr << "Dory server failed to initialize after 30 seconds."
+        << std::endl;
+  }
+
+  dory->RequestShutdown();
+  dory_thread.join();
+  kafka.RequestShutdown();
+  kafka.Join();
+
+  if (!ok || (dory_ret != EXIT_SUCCESS)) {
+    return EXIT_FAILURE;
+  }
+
+  if (cfg->OutputFile.empty()) {
+    WriteResultJson(std::cout, *cfg, result);
+  } else {
+    std::ofstream out(cfg->OutputFile);
+    WriteResultJson(out, *cfg, result);
+
+    if (!out) {
+      std::cerr << "Failed to write output file " << cfg->OutputFile
+          << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  int ret = EXIT_SUCCESS;
+
+  try {
+    ret = BenchMain(argc, argv);
+  } catch (const std::exception &x) {
+    std::cerr << "error: " << x.what() << std::endl;
+    ret = EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "error: unknown exception" << std::endl;
+    ret = EXIT_FAILURE;
+  }
+
+  return ret;
+}
@@ -0,0 +1,973 @@
+/* <dory/bench/dory_microbench.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Microbenchmarks for Dory's hot-path components.  Each benchmark exercises
+   one component in isolation against a fixed fixture for a fixed amount of
+   time, and results are written as JSON.  Build in release mode for
+   meaningful numbers.
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <base/basename.h>
+#include <base/crc.h>
+#include <base/indent.h>
+#include <base/no_copy_semantics.h>
+#include <base/opt.h>
+#include <capped/blob.h>
+#include <capped/pool.h>
+#include <capped/reader.h>
+#include <capped/writer.h>
+#include <dory/anomaly_tracker.h>
+#include <dory/batch/batch_config.h>
+#include <dory/batch/batch_config_builder.h>
+#include <dory/batch/combined_topics_batcher.h>
+#include <dory/batch/global_batch_config.h>
+#include <dory/batch/per_topic_batcher.h>
+#include <dory/bench/microbench.h>
+#include <dory/build_id.h>
+#include <dory/compress/compression_init.h>
+#include <dory/compress/compression_type.h>
+#include <dory/conf/compression_conf.h>
+#include <dory/config.h>
+#include <dory/discard_file_logger.h>
+#include <dory/input_dg/any_partition/v0/v0_write_msg.h>
+#include <dory/input_dg/input_dg_util.h>
+#include <dory/kafka_proto/produce/produce_protocol.h>
+#include <dory/kafka_proto/produce/produce_response_reader_api.h>
+#include <dory/kafka_proto/produce/v0/produce_response_writer.h>
+#include <dory/kafka_proto/produce/version_util.h>
+#include <dory/metadata.h>
+#include <dory/msg.h>
+#include <dory/msg_dispatch/common.h>
+#include <dory/msg_dispatch/produce_request_factory.h>
+#include <dory/msg_state_tracker.h>
+#include <dory/test_util/misc_util.h>
+#include <dory/util/arg_parse_error.h>
+#include <dory/util/event_trace.h>
+#include <dory/util/json_util.h>
+#include <thread/gate.h>
+#include <tclap/CmdLine.h>
+
+using namespace Base;
+using namespace Capped;
+using namespace Dory;
+using namespace Dory::Batch;
+using namespace Dory::Bench;
+using namespace Dory::Compress;
+using namespace Dory::Conf;
+using namespace Dory::InputDg;
+using namespace Dory::KafkaProto::Produce;
+using namespace Dory::MsgDispatch;
+using namespace Dory::TestUtil;
+using namespace Dory::Util;
+
+namespace {
+
+  struct TMicrobenchConfig {
+    /* Throws TArgParseError on error parsing args. */
+    TMicrobenchConfig(int argc, char *argv[]);
+
+    /* Length of each benchmark's timed run in milliseconds. */
+    size_t Time;
+
+    /* Length of each benchmark's untimed warmup run in milliseconds. */
+    size_t Warmup;
+
+    /* Thread count for benchmarks that measure contention. */
+    size_t ThreadCount;
+
+    /* Only run benchmarks whose names contain this. */
+    std::string Filter;
+
+    bool List;
+
+    std::string Label;
+
+    std::string OutputFile;
+  };  // TMicrobenchConfig
+
+  TMicrobenchConfig::TMicrobenchConfig(int argc, char *argv[])
+      : Time(2000),
+        Warmup(200),
+        ThreadCount(4),
+        List(false) {
+    using namespace TCLAP;
+    const std::string prog_name = Basename(argv[0]);
+    std::vector<const char *> arg_vec(&argv[0], &argv[0] + argc);
+    arg_vec[0] = prog_name.c_str();
+
+    try {
+      CmdLine cmd("Microbenchmarks for Dory's hot-path components.", ' ',
+          dory_build_id);
+      ValueArg<decltype(Time)> arg_time("", "time", "Length of each "
+          "benchmark's timed run in milliseconds.", false, Time, "MS");
+      cmd.add(arg_time);
+      ValueArg<decltype(Warmup)> arg_warmup("", "warmup", "Length of each "
+          "benchmark's untimed warmup run in milliseconds.", false, Warmup,
+          "MS");
+      cmd.add(arg_warmup);
+      ValueArg<decltype(ThreadCount)> arg_threads("", "threads", "Thread "
+          "count for benchmarks that measure contention.", false,
+          ThreadCount, "COUNT");
+      cmd.add(arg_threads);
+      ValueArg<decltype(Filter)> arg_filter("", "filter", "Only run "
+          "benchmarks whose names contain this string.", false, Filter,
+          "STRING");
+      cmd.add(arg_filter);
+      SwitchArg arg_list("", "list", "List benchmark names and exit.", cmd,
+          List);
+      ValueArg<decltype(Label)> arg_label("", "label", "Label to include in "
+          "results, for telling runs apart.", false, Label, "LABEL");
+      cmd.add(arg_label);
+      ValueArg<decltype(OutputFile)> arg_output("", "output", "File to write "
+          "JSON results to.  Results go to standard output if this is not "
+          "specified.", false, OutputFile, "FILE");
+      cmd.add(arg_output);
+      cmd.parse(argc, &arg_vec[0]);
+      Time = arg_time.getValue();
+      Warmup = arg_warmup.getValue();
+      ThreadCount = arg_threads.getValue();
+      Filter = arg_filter.getValue();
+      List = arg_list.getValue();
+      Label = arg_label.getValue();
+      OutputFile = arg_output.getValue();
+    } catch (const ArgException &x) {
+      throw TArgParseError(x.error(), x.argId());
+    }
+
+    if (ThreadCount == 0) {
+      throw TArgParseError("--threads must be at least 1");
+    }
+  }
+
+  const size_t TOPIC_COUNT = 10;
+
+  const size_t PARTITION_COUNT = 8;
+
+  std::string TopicName(size_t index) {
+    return "bench_topic_" + std::to_string(index);
+  }
+
+  /* Return 'size' bytes of lowercase text.  The generator has a fixed seed
+     so every run sees the same data. */
+  std::string RandomText(std::mt19937 &gen, size_t size) {
+    std::uniform_int_distribution<int> dist('a', 'z');
+    std::string result;
+
+    for (size_t i = 0; i < size; ++i) {
+      result += static_cast<char>(dist(gen));
+    }
+
+    return result;
+  }
+
+  /* Same as the command line config the unit tests use for code that needs
+     a Dory::TConfig. */
+  std::unique_ptr<Dory::TConfig> CreateDoryConfig() {
+    std::vector<const char *> args;
+    args.push_back("dory");
+    args.push_back("--config_path");
+    args.push_back("/nonexistent/path");
+    args.push_back("--msg_buffer_max");
+    args.push_back("1");  // dummy value
+    args.push_back("--receive_socket_name");
+    args.push_back("dummy_value");
+    args.push_back(nullptr);
+    return std::unique_ptr<Dory::TConfig>(new Dory::TConfig(args.size() - 1,
+        const_cast<char **>(&args[0]), true));
+  }
+
+  /* Allocate and free a single buffer pool block. */
+  class TPoolAllocFreeBench final : public TMicrobench {
+    NO_COPY_SEMANTICS(TPoolAllocFreeBench);
+
+    public:
+    explicit TPoolAllocFreeBench(size_t thread_count)
+        : TMicrobench("pool_alloc_free/threads:" +
+              std::to_string(thread_count), thread_count),
+          Pool(128, 16384, TPool::TSync::Mutexed) {
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t /*thread_index*/) override {
+      assert(this);
+
+      while (loop.KeepRunning()) {
+        Pool.Free(Pool.Alloc());
+      }
+    }
+
+    private:
+    TPool Pool;
+  };  // TPoolAllocFreeBench
+
+  const size_t BLOB_SIZE = 512;
+
+  /* Write a message-sized blob into the buffer pool and release it. */
+  class TBlobWriteBench final : public TMicrobench {
+    NO_COPY_SEMANTICS(TBlobWriteBench);
+
+    public:
+    TBlobWriteBench()
+        : TMicrobench("blob_write"),
+          Pool(128, 16384, TPool::TSync::Mutexed),
+          Data(BLOB_SIZE, 'x') {
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t /*thread_index*/) override {
+      assert(this);
+
+      while (loop.KeepRunning()) {
+        TWriter writer(&Pool);
+        writer.Write(Data.data(), Data.size());
+        TBlob blob = writer.DraftBlob();
+        loop.AddBytes(blob.Size());
+      }
+    }
+
+    private:
+    TPool Pool;
+
+    const std::string Data;
+  };  // TBlobWriteBench
+
+  /* Copy a message-sized blob out of the buffer pool. */
+  class TBlobReadBench final : public TMicrobench {
+    NO_COPY_SEMANTICS(TBlobReadBench);
+
+    public:
+    TBlobReadBench()
+        : TMicrobench("blob_read"),
+          Pool(128, 16384, TPool::TSync::Mutexed),
+          Buf(BLOB_SIZE) {
+    }
+
+    virtual bool SetUp() override {
+      assert(this);
+      std::string data(BLOB_SIZE, 'x');
+      TWriter writer(&Pool);
+      writer.Write(data.data(), data.size());
+      Blob = writer.DraftBlob();
+      return true;
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t /*thread_index*/) override {
+      assert(this);
+
+      while (loop.KeepRunning()) {
+        TReader reader(&Blob);
+        reader.Read(&Buf[0], Buf.size());
+        loop.AddBytes(Buf.size());
+      }
+    }
+
+    virtual void TearDown() override {
+      assert(this);
+      Blob = TBlob();
+    }
+
+    private:
+    TPool Pool;
+
+    TBlob Blob;
+
+    std::vector<uint8_t> Buf;
+  };  // TBlobReadBench
+
+  /* Pass items from one thread to another through a TGate, as the input
+     agents do when handing messages to the router thread.  Thread 0 puts
+     single items and thread 1 gets them in whatever groups are available.
+     Only the putting thread's loop is timed, so ns_per_op is the cost of
+     moving one item through the gate. */
+  class TGatePutGetBench final : public TMicrobench {
+    NO_COPY_SEMANTICS(TGatePutGetBench);
+
+    public:
+    TGatePutGetBench()
+        : TMicrobench("gate_put_get", 2),
+          Consumed(0) {
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t thread_index) override {
+      assert(this);
+
+      if (thread_index == 0) {
+        Produce(loop);
+      } else {
+        Consume();
+      }
+    }
+
+    private:
+    /* Limit how far the putting thread may get ahead, so the gate's list
+       stays short and its memory use doesn't dominate. */
+    static const uint64_t MAX_BACKLOG = 1024;
+
+    /* Tells the getting thread to stop. */
+    static const uint64_t SENTINEL = 0;
+
+    void Produce(TBenchLoop &loop) {
+      assert(this);
+      Consumed.store(0);
+      uint64_t produced = 0;
+
+      while (loop.KeepRunning()) {
+        while ((produced - Consumed.load(std::memory_order_relaxed)) >=
+               MAX_BACKLOG) {
+          std::this_thread::yield();
+        }
+
+        Gate.Put(uint64_t(1));
+        ++produced;
+      }
+
+      Gate.Put(uint64_t(SENTINEL));
+    }
+
+    void Consume() {
+      assert(this);
+
+      for (; ; ) {
+        std::list<uint64_t> items = Gate.Get();
+        uint64_t count = 0;
+        bool done = false;
+
+        for (uint64_t item : items) {
+          if (item == SENTINEL) {
+            done = true;
+          } else {
+            ++count;
+          }
+        }
+
+        Consumed.fetch_add(count, std::memory_order_relaxed);
+
+        if (done) {
+          break;
+        }
+      }
+    }
+
+    Thread::TGate<uint64_t> Gate;
+
+    std::atomic<uint64_t> Consumed;
+  };  // TGatePutGetBench
+
+  /* Turn a UNIX domain datagram into a message, as the datagram input agent
+     does for each datagram it receives. */
+  class TBuildMsgFromDgBench final : public TMicrobench {
+    NO_COPY_SEMANTICS(TBuildMsgFromDgBench);
+
+    public:
+    TBuildMsgFromDgBench()
+        : TMicrobench("build_msg_from_dg"),
+          Pool(128, 16384, TPool::TSync::Mutexed),
+          AnomalyTracker(DiscardFileLogger, 0,
+                         std::numeric_limits<size_t>::max()) {
+    }
+
+    virtual bool SetUp() override {
+      assert(this);
+      Cfg = CreateDoryConfig();
+      std::mt19937 gen(1);
+      std::string topic = TopicName(0);
+      std::string key = RandomText(gen, 16);
+      std::string value = RandomText(gen, 256);
+      size_t dg_size = 0;
+      input_dg_any_p_v0_compute_msg_size(&dg_size, topic.size(), key.size(),
+          value.size());
+      Dg.resize(dg_size);
+      input_dg_any_p_v0_write_msg(&Dg[0], 8675309, topic.data(),
+          topic.data() + topic.size(), key.data(), key.data() + key.size(),
+          value.data(), value.data() + value.size());
+      return true;
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t /*thread_index*/) override {
+      assert(this);
+
+      while (loop.KeepRunning()) {
+        TMsg::TPtr msg = BuildMsgFromDg(&Dg[0], Dg.size(), *Cfg, Pool,
+            AnomalyTracker, MsgStateTracker);
+        assert(msg);
+        SetProcessed(msg);
+        loop.AddBytes(Dg.size());
+      }
+    }
+
+    private:
+    std::unique_ptr<Dory::TConfig> Cfg;
+
+    TPool Pool;
+
+    TDiscardFileLogger DiscardFileLogger;
+
+    TAnomalyTracker AnomalyTracker;
+
+    TMsgStateTracker MsgStateTracker;
+
+    std::vector<uint8_t> Dg;
+  };  // TBuildMsgFromDgBench
+
+  /* A fixed set of messages spread over TOPIC_COUNT topics, which batcher
+     benchmarks recycle so no messages are created in the timed loop. */
+  class TBatcherBenchBase : public TMicrobench {
+    NO_COPY_SEMANTICS(TBatcherBenchBase);
+
+    public:
+    virtual bool SetUp() override {
+      assert(this);
+      std::mt19937 gen(1);
+
+      for (size_t i = 0; i < MSG_COUNT; ++i) {
+        FreeMsgs.push_back(MsgCreator.NewMsg(TopicName(i % TOPIC_COUNT),
+            RandomText(gen, 100), 0, true));
+      }
+
+      return true;
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t /*thread_index*/) override {
+      assert(this);
+
+      while (loop.KeepRunning()) {
+        TMsg::TPtr msg = std::move(FreeMsgs.front());
+        FreeMsgs.pop_front();
+        std::list<std::list<TMsg::TPtr>> complete =
+            AddMsg(std::move(msg));
+
+        /* A message the batcher didn't accept is handed back. */
+        if (msg) {
+          FreeMsgs.push_back(std::move(msg));
+        }
+
+        for (auto &batch : complete) {
+          FreeMsgs.splice(FreeMsgs.end(), batch);
+        }
+      }
+    }
+
+    virtual void TearDown() override {
+      assert(this);
+      TakeAll();
+      FreeMsgs.clear();
+    }
+
+    protected:
+    explicit TBatcherBenchBase(const std::string &name)
+        : TMicrobench(name) {
+    }
+
+    virtual std::list<std::list<TMsg::TPtr>>
+    AddMsg(TMsg::TPtr &&msg) = 0;
+
+    /* Empty out the batcher. */
+    virtual std::list<std::list<TMsg::TPtr>> TakeAll() = 0;
+
+    private:
+    static const size_t MSG_COUNT = 2000;
+
+    /* Declared first, since it contains the pool the messages use. */
+    TTestMsgCreator MsgCreator;
+
+    std::list<TMsg::TPtr> FreeMsgs;
+  };  // TBatcherBenchBase
+
+  /* Batch messages by topic, completing batches on message count. */
+  class TPerTopicBatcherBench final : public TBatcherBenchBase {
+    NO_COPY_SEMANTICS(TPerTopicBatcherBench);
+
+    public:
+    TPerTopicBatcherBench()
+        : TBatcherBenchBase("per_topic_batcher") {
+    }
+
+    virtual bool SetUp() override {
+      assert(this);
+      TBatchConfigBuilder builder;
+      TBatchConfig config(0, 100, 0);
+      builder.SetDefaultTopic(&config);
+      Batcher.reset(new TPerTopicBatcher(builder.Build().GetPerTopicConfig()));
+      return TBatcherBenchBase::SetUp();
+    }
+
+    protected:
+    virtual std::list<std::list<TMsg::TPtr>>
+    AddMsg(TMsg::TPtr &&msg) override {
+      assert(this);
+      return Batcher->AddMsg(std::move(msg), 0);
+    }
+
+    virtual std::list<std::list<TMsg::TPtr>> TakeAll() override {
+      assert(this);
+      return Batcher->GetAllBatches();
+    }
+
+    private:
+    std::unique_ptr<TPerTopicBatcher> Batcher;
+  };  // TPerTopicBatcherBench
+
+  /* Batch messages for all topics together, completing batches on message
+     count. */
+  class TCombinedTopicsBatcherBench final : public TBatcherBenchBase {
+    NO_COPY_SEMANTICS(TCombinedTopicsBatcherBench);
+
+    public:
+    TCombinedTopicsBatcherBench()
+        : TBatcherBenchBase("combined_topics_batcher") {
+    }
+
+    virtual bool SetUp() override {
+      assert(this);
+      /* An empty exclusion filter enables batching for all topics. */
+      std::shared_ptr<std::unordered_set<std::string>> filter(
+          new std::unordered_set<std::string>);
+      Batcher.reset(new TCombinedTopicsBatcher(
+          TCombinedTopicsBatcher::TConfig(TBatchConfig(0, 100, 0), filter,
+              true)));
+      return TBatcherBenchBase::SetUp();
+    }
+
+    protected:
+    virtual std::list<std::list<TMsg::TPtr>>
+    AddMsg(TMsg::TPtr &&msg) override {
+      assert(this);
+      return Batcher->AddMsg(std::move(msg), 0);
+    }
+
+    virtual std::list<std::list<TMsg::TPtr>> TakeAll() override {
+      assert(this);
+      return Batcher->TakeBatch();
+    }
+
+    private:
+    std::unique_ptr<TCombinedTopicsBatcher> Batcher;
+  };  // TCombinedTopicsBatcherBench
+
+  /* Serialize a produce request containing 10 batches of 10 messages each,
+     one batch per topic, optionally with compression. */
+  class TBuildRequestBench final : public TMicrobench {
+    NO_COPY_SEMANTICS(TBuildRequestBench);
+
+    public:
+    explicit TBuildRequestBench(TCompressionType compression_type)
+        : TMicrobench(std::string("build_request/") +
+              ((compression_type == TCompressionType::None) ?
+                  "none" : "snappy")),
+          CompressionType(compression_type) {
+    }
+
+    virtual bool SetUp() override {
+      assert(this);
+
+      try {
+        CompressionInit(CompressionType);
+      } catch (const std::exception &x) {
+        std::cerr << GetName() << ": skipping: " << x.what() << std::endl;
+        return false;
+      }
+
+      Cfg = CreateDoryConfig();
+      TBatchConfigBuilder batch_builder;
+      TBatchConfig disabled;
+      batch_builder.SetDefaultTopic(&disabled);
+      batch_builder.SetProduceRequestDataLimit(1024 * 1024);
+      batch_builder.SetMessageMaxBytes(1024 * 1024);
+      TGlobalBatchConfig batch_config = batch_builder.Build();
+      TCompressionConf::TBuilder compression_builder;
+      compression_builder.AddNamedConfig("bench", CompressionType, 0);
+      compression_builder.SetDefaultTopicConfig("bench");
+      TCompressionConf compression_conf = compression_builder.Build();
+      std::shared_ptr<TProduceProtocol> protocol(ChooseProduceProto(0));
+      TMetadata::TBuilder md_builder;
+      md_builder.OpenBrokerList();
+      md_builder.AddBroker(0, "localhost", 9092);
+      md_builder.CloseBrokerList();
+
+      for (size_t i = 0; i < TOPIC_COUNT; ++i) {
+        md_builder.OpenTopic(TopicName(i));
+
+        for (size_t p = 0; p < PARTITION_COUNT; ++p) {
+          md_builder.AddPartitionToTopic(static_cast<int32_t>(p), 0, true, 0);
+        }
+
+        md_builder.CloseTopic();
+      }
+
+      std::shared_ptr<TMetadata> md(md_builder.Build());
+      Factory.reset(new TProduceRequestFactory(*Cfg, batch_config,
+          compression_conf, protocol, 0));
+      Factory->Init(compression_conf, md);
+      std::mt19937 gen(1);
+
+      for (size_t i = 0; i < TOPIC_COUNT; ++i) {
+        std::list<TMsg::TPtr> batch;
+
+        for (size_t j = 0; j < 10; ++j) {
+          batch.push_back(MsgCreator.NewMsg(TopicName(i),
+              RandomText(gen, 100 + (j * 20)), 0, true));
+        }
+
+        Batches.push_back(std::move(batch));
+      }
+
+      return true;
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t /*thread_index*/) override {
+      assert(this);
+
+      while (loop.KeepRunning()) {
+        Factory->Put(std::move(Batches));
+        Batches.clear();
+        TOpt<TProduceRequest> request = Factory->BuildRequest(Buf);
+        assert(request.IsKnown());
+        assert(Factory->IsEmpty());
+        EmptyAllTopics(request->second, Batches);
+        loop.AddBytes(Buf.size());
+      }
+    }
+
+    virtual void TearDown() override {
+      assert(this);
+      Batches.clear();
+      Factory.reset();
+    }
+
+    private:
+    const TCompressionType CompressionType;
+
+    /* Declared before 'Batches', since it contains the pool the messages
+       use. */
+    TTestMsgCreator MsgCreator;
+
+    std::unique_ptr<Dory::TConfig> Cfg;
+
+    std::unique_ptr<TProduceRequestFactory> Factory;
+
+    std::list<std::list<TMsg::TPtr>> Batches;
+
+    std::vector<uint8_t> Buf;
+  };  // TBuildRequestBench
+
+  /* Walk a produce response for TOPIC_COUNT topics with PARTITION_COUNT
+     partitions each, as the receive thread does for each response. */
+  class TProduceResponseReaderBench final : public TMicrobench {
+    NO_COPY_SEMANTICS(TProduceResponseReaderBench);
+
+    public:
+    TProduceResponseReaderBench()
+        : TMicrobench("produce_response_reader"),
+          Sink(0) {
+    }
+
+    virtual bool SetUp() override {
+      assert(this);
+      V0::TProduceResponseWriter writer;
+      writer.OpenResponse(Response, 12345);
+
+      for (size_t i = 0; i < TOPIC_COUNT; ++i) {
+        std::string topic = TopicName(i);
+        writer.OpenTopic(topic.data(), topic.data() + topic.size());
+
+        for (size_t p = 0; p < PARTITION_COUNT; ++p) {
+          writer.AddPartition(static_cast<int32_t>(p), 0,
+              static_cast<int64_t>((i * 1000) + p));
+        }
+
+        writer.CloseTopic();
+      }
+
+      writer.CloseResponse();
+      std::unique_ptr<TProduceProtocol> protocol(ChooseProduceProto(0));
+      Reader.reset(protocol->CreateProduceResponseReader());
+      return true;
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t /*thread_index*/) override {
+      assert(this);
+
+      while (loop.KeepRunning()) {
+        Reader->SetResponse(&Response[0], Response.size());
+
+        for (bool t = Reader->FirstTopic(); t; t = Reader->NextTopic()) {
+          for (bool p = Reader->FirstPartitionInTopic(); p;
+               p = Reader->NextPartitionInTopic()) {
+            Sink += Reader->GetCurrentPartitionOffset();
+          }
+        }
+
+        loop.AddBytes(Response.size());
+      }
+    }
+
+    virtual void TearDown() override {
+      assert(this);
+      Reader.reset();
+    }
+
+    private:
+    std::vector<uint8_t> Response;
+
+    std::unique_ptr<TProduceResponseReaderApi> Reader;
+
+    /* Keeps the compiler from optimizing away the loop. */
+    volatile int64_t Sink;
+  };  // TProduceResponseReaderBench
+
+  /* Compute the CRC that each serialized message carries. */
+  class TCrc32Bench final : public TMicrobench {
+    NO_COPY_SEMANTICS(TCrc32Bench);
+
+    public:
+    explicit TCrc32Bench(size_t size)
+        : TMicrobench("crc32/" + std::to_string(size)),
+          Data(size),
+          Sink(0) {
+    }
+
+    virtual bool SetUp() override {
+      assert(this);
+      std::mt19937 gen(1);
+
+      for (uint8_t &b : Data) {
+        b = static_cast<uint8_t>(gen());
+      }
+
+      return true;
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t /*thread_index*/) override {
+      assert(this);
+
+      while (loop.KeepRunning()) {
+        Sink = Sink ^ ComputeCrc32(&Data[0], Data.size());
+        loop.AddBytes(Data.size());
+      }
+    }
+
+    private:
+    std::vector<uint8_t> Data;
+
+    /* Keeps the compiler from optimizing away the loop. */
+    volatile uint32_t Sink;
+  };  // TCrc32Bench
+
+  /* Record an event in the calling thread's trace ring, as the hot path does
+     at each traced point. */
+  class TEventTraceBench final : public TMicrobench {
+    NO_COPY_SEMANTICS(TEventTraceBench);
+
+    public:
+    TEventTraceBench()
+        : TMicrobench("event_trace/record") {
+    }
+
+    virtual bool SetUp() override {
+      assert(this);
+
+      /* Nothing else in this program records events, so tracing can be
+         enabled here rather than at startup. */
+      TEventTrace::Init(RING_SIZE);
+      return true;
+    }
+
+    virtual void Run(TBenchLoop &loop, size_t /*thread_index*/) override {
+      assert(this);
+
+      while (loop.KeepRunning()) {
+        TEventTrace::Record(TTraceEvent::BatchHandoff, loop.GetIterations());
+      }
+    }
+
+    virtual void TearDown() override {
+      assert(this);
+      TEventTrace::Init(0);
+    }
+
+    private:
+    static const size_t RING_SIZE = 4096;
+  };  // TEventTraceBench
+
+  std::vector<std::unique_ptr<TMicrobench>>
+  CreateBenchmarks(const TMicrobenchConfig &cfg) {
+    std::vector<std::unique_ptr<TMicrobench>> result;
+    result.emplace_back(new TPoolAllocFreeBench(1));
+
+    if (cfg.ThreadCount > 1) {
+      result.emplace_back(new TPoolAllocFreeBench(cfg.ThreadCount));
+    }
+
+    result.emplace_back(new TBlobWriteBench);
+    result.emplace_back(new TBlobReadBench);
+    result.emplace_back(new TGatePutGetBench);
+    result.emplace_back(new TBuildMsgFromDgBench);
+    result.emplace_back(new TPerTopicBatcherBench);
+    result.emplace_back(new TCombinedTopicsBatcherBench);
+    result.emplace_back(new TBuildRequestBench(TCompressionType::None));
+    result.emplace_back(new TBuildRequestBench(TCompressionType::Snappy));
+    result.emplace_back(new TProduceResponseReaderBench);
+    result.emplace_back(new TCrc32Bench(256));
+    result.emplace_back(new TCrc32Bench(65536));
+    result.emplace_back(new TEventTraceBench);
+    return result;
+  }
+
+  void WriteResultJson(std::ostream &os, const TMicrobenchConfig &cfg,
+      const std::vector<TMicrobenchResult> &results) {
+    std::string indent_str;
+    TIndent ind0(indent_str, TIndent::StartAt::Zero, 4);
+    os << ind0 << "{" << std::endl;
+
+    {
+      TIndent ind1(ind0);
+      os << ind1 << "\"label\": " << JsonString(cfg.Label) << "," << std::endl
+          << ind1 << "\"version\": " << JsonString(dory_build_id) << ","
+          << std::endl
+          << ind1 << "\"time_ms\": " << cfg.Time << "," << std::endl
+          << ind1 << "\"warmup_ms\": " << cfg.Warmup << "," << std::endl
+          << ind1 << "\"crc32_impl\": " << JsonString(GetCrc32ImplName())
+          << "," << std::endl
+          << ind1 << "\"benchmarks\": [";
+
+      for (size_t i = 0; i < results.size(); ++i) {
+        const TMicrobenchResult &r = results[i];
+        os << (i ? "," : "") << std::endl << ind1 << "    {" << std::endl;
+
+        {
+          TIndent ind2(ind1, 8, ' ');
+          os << ind2 << "\"name\": " << JsonString(r.Name) << ","
+              << std::endl
+              << ind2 << "\"threads\": " << r.ThreadCount << "," << std::endl
+              << ind2 << "\"skipped\": " << (r.Skipped ? "true" : "false")
+              << "," << std::endl
+              << ind2 << "\"iterations\": " << r.Iterations << ","
+              << std::endl
+              << ind2 << "\"ns_per_op\": " << r.GetNsPerOp() << ","
+              << std::endl
+              << ind2 << "\"ops_per_sec\": " << r.GetOpsPerSec() << ","
+              << std::endl
+              << ind2 << "\"bytes_per_sec\": " << r.GetBytesPerSec()
+              << std::endl;
+        }
+
+        os << ind1 << "    }";
+      }
+
+      os << std::endl << ind1 << "]" << std::endl;
+    }
+
+    os << ind0 << "}" << std::endl;
+  }
+
+  int MicrobenchMain(int argc, char *argv[]) {
+    std::unique_ptr<TMicrobenchConfig> cfg;
+
+    try {
+      cfg.reset(new TMicrobenchConfig(argc, argv));
+    } catch (const TArgParseError &x) {
+      /* Error parsing command line arguments. */
+      std::cerr << x.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::vector<std::unique_ptr<TMicrobench>> benchmarks =
+        CreateBenchmarks(*cfg);
+
+    if (cfg->List) {
+      for (const auto &bench : benchmarks) {
+        std::cout << bench->GetName() << std::endl;
+      }
+
+      return EXIT_SUCCESS;
+    }
+
+    std::vector<TMicrobenchResult> results;
+
+    for (const auto &bench : benchmarks) {
+      if (bench->GetName().find(cfg->Filter) == std::string::npos) {
+        continue;
+      }
+
+      results.push_back(RunMicrobench(*bench, cfg->Warmup * 1000000,
+          cfg->Time * 1000000));
+      const TMicrobenchResult &r = results.back();
+
+      if (r.Skipped) {
+        std::cerr << r.Name << ": skipped" << std::endl;
+      } else {
+        std::cerr << r.Name << ": " << r.GetNsPerOp() << " ns/op, "
+            << r.GetOpsPerSec() << " ops/s";
+
+        if (r.Bytes) {
+          std::cerr << ", " << (r.GetBytesPerSec() / (1024 * 1024))
+              << " MiB/s";
+        }
+
+        std::cerr << std::endl;
+      }
+    }
+
+    if (cfg->OutputFile.empty()) {
+      WriteResultJson(std::cout, *cfg, results);
+    } else {
+      std::ofstream out(cfg->OutputFile);
+      WriteResultJson(out, *cfg, results);
+
+      if (!out) {
+        std::cerr << "Failed to write output file " << cfg->OutputFile
+            << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    return EXIT_SUCCESS;
+  }
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int ret = EXIT_SUCCESS;
+
+  try {
+    ret = MicrobenchMain(argc, argv);
+  } catch (const std::exception &x) {
+    std::cerr << "error: " << x.what() << std::endl;
+    ret = EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "error: unknown exception" << std::endl;
+    ret = EXIT_FAILURE;
+  }
+
+  return ret;
+}
@@ -0,0 +1,114 @@
+/* <dory/bench/microbench.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/bench/microbench.h>.
+ */
+
+#include <dory/bench/microbench.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <base/time_util.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Bench;
+
+bool TBenchLoop::CheckTime() {
+  assert(this);
+  uint64_t now = GetMonotonicRawNanoseconds();
+
+  if (StartNs == 0) {
+    StartNs = now;
+  }
+
+  ElapsedNs = now - StartNs;
+  return (ElapsedNs < DurationNs);
+}
+
+static uint64_t PerSecond(uint64_t count, uint64_t nsec) {
+  return nsec ? static_cast<uint64_t>(
+      (static_cast<double>(count) * 1000000000.0) / nsec) : 0;
+}
+
+uint64_t TMicrobenchResult::GetOpsPerSec() const {
+  assert(this);
+  return PerSecond(Iterations, ElapsedNs);
+}
+
+uint64_t TMicrobenchResult::GetBytesPerSec() const {
+  assert(this);
+  return PerSecond(Bytes, ElapsedNs);
+}
+
+/* Run all threads of 'bench' once, and return their loops. */
+static std::vector<std::unique_ptr<TBenchLoop>>
+RunThreads(TMicrobench &bench, uint64_t duration_ns) {
+  std::vector<std::unique_ptr<TBenchLoop>> loops;
+
+  for (size_t i = 0; i < bench.GetThreadCount(); ++i) {
+    loops.emplace_back(new TBenchLoop(duration_ns));
+  }
+
+  if (loops.size() == 1) {
+    bench.Run(*loops[0], 0);
+  } else {
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < loops.size(); ++i) {
+      threads.emplace_back(&TMicrobench::Run, &bench, std::ref(*loops[i]),
+          i);
+    }
+
+    for (std::thread &t : threads) {
+      t.join();
+    }
+  }
+
+  return loops;
+}
+
+TMicrobenchResult Dory::Bench::RunMicrobench(TMicrobench &bench,
+    uint64_t warmup_ns, uint64_t duration_ns) {
+  TMicrobenchResult result;
+  result.Name = bench.GetName();
+  result.ThreadCount = bench.GetThreadCount();
+
+  if (!bench.SetUp()) {
+    result.Skipped = true;
+    return result;
+  }
+
+  if (warmup_ns) {
+    RunThreads(bench, warmup_ns);
+  }
+
+  for (const auto &loop : RunThreads(bench, duration_ns)) {
+    result.Iterations += loop->GetIterations();
+    result.Bytes += loop->GetBytes();
+    result.ThreadNs += loop->GetElapsedNs();
+    result.ElapsedNs = std::max(result.ElapsedNs, loop->GetElapsedNs());
+  }
+
+  bench.TearDown();
+  return result;
+}
@@ -0,0 +1,205 @@
+/* <dory/bench/microbench.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Minimal harness for timing microbenchmarks of individual components.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <base/no_copy_semantics.h>
+
+namespace Dory {
+
+  namespace Bench {
+
+    /* Timing loop for one thread of a microbenchmark.  Typical usage:
+
+           while (loop.KeepRunning()) {
+             // operation being measured
+           }
+
+       The timer starts on the first call to KeepRunning().  To keep timing
+       overhead low, the clock is only read every CHECK_INTERVAL
+       iterations. */
+    class TBenchLoop final {
+      NO_COPY_SEMANTICS(TBenchLoop);
+
+      public:
+      static const uint64_t CHECK_INTERVAL = 16;
+
+      explicit TBenchLoop(uint64_t duration_ns)
+          : DurationNs(duration_ns),
+            StartNs(0),
+            ElapsedNs(0),
+            Iterations(0),
+            Bytes(0) {
+      }
+
+      /* Return true if another iteration should be run. */
+      bool KeepRunning() {
+        assert(this);
+
+        if (((Iterations % CHECK_INTERVAL) == 0) && !CheckTime()) {
+          return false;
+        }
+
+        ++Iterations;
+        return true;
+      }
+
+      /* Count bytes processed, for reporting throughput. */
+      void AddBytes(size_t bytes) {
+        assert(this);
+        Bytes += bytes;
+      }
+
+      uint64_t GetIterations() const {
+        assert(this);
+        return Iterations;
+      }
+
+      uint64_t GetBytes() const {
+        assert(this);
+        return Bytes;
+      }
+
+      uint64_t GetElapsedNs() const {
+        assert(this);
+        return ElapsedNs;
+      }
+
+      private:
+      bool CheckTime();
+
+      const uint64_t DurationNs;
+
+      uint64_t StartNs;
+
+      uint64_t ElapsedNs;
+
+      uint64_t Iterations;
+
+      uint64_t Bytes;
+    };  // TBenchLoop
+
+    /* Base class for microbenchmarks.  A benchmark with a thread count
+       greater than 1 has Run() called concurrently from that many threads,
+       which is how contention is measured.  Fixtures are built in SetUp(),
+       outside the timed region, and should not depend on anything that
+       varies between runs so results are comparable. */
+    class TMicrobench {
+      NO_COPY_SEMANTICS(TMicrobench);
+
+      public:
+      virtual ~TMicrobench() noexcept {
+      }
+
+      const std::string &GetName() const {
+        assert(this);
+        return Name;
+      }
+
+      size_t GetThreadCount() const {
+        assert(this);
+        return ThreadCount;
+      }
+
+      /* Prepare fixture.  Return false to skip the benchmark, for instance
+         because a library it needs is unavailable. */
+      virtual bool SetUp() {
+        assert(this);
+        return true;
+      }
+
+      /* Run the timed loop for thread 'thread_index', which is in the range
+         [0, GetThreadCount()).  This may be called more than once after a
+         single call to SetUp(). */
+      virtual void Run(TBenchLoop &loop, size_t thread_index) = 0;
+
+      virtual void TearDown() {
+        assert(this);
+      }
+
+      protected:
+      explicit TMicrobench(const std::string &name, size_t thread_count = 1)
+          : Name(name),
+            ThreadCount(thread_count) {
+        assert(ThreadCount > 0);
+      }
+
+      private:
+      const std::string Name;
+
+      const size_t ThreadCount;
+    };  // TMicrobench
+
+    struct TMicrobenchResult {
+      std::string Name;
+
+      size_t ThreadCount;
+
+      /* True if SetUp() returned false.  The remaining fields are then 0. */
+      bool Skipped;
+
+      /* Total for all threads. */
+      uint64_t Iterations;
+
+      /* Total for all threads. */
+      uint64_t Bytes;
+
+      /* Sum of the time each thread spent in its timed loop. */
+      uint64_t ThreadNs;
+
+      /* Longest time any thread spent in its timed loop. */
+      uint64_t ElapsedNs;
+
+      TMicrobenchResult()
+          : ThreadCount(0),
+            Skipped(false),
+            Iterations(0),
+            Bytes(0),
+            ThreadNs(0),
+            ElapsedNs(0) {
+      }
+
+      /* Average time per iteration as seen by a single thread. */
+      uint64_t GetNsPerOp() const {
+        assert(this);
+        return Iterations ? (ThreadNs / Iterations) : 0;
+      }
+
+      /* Iterations per second for all threads combined. */
+      uint64_t GetOpsPerSec() const;
+
+      /* Bytes per second for all threads combined. */
+      uint64_t GetBytesPerSec() const;
+    };  // TMicrobenchResult
+
+    /* Set up 'bench', run it untimed for 'warmup_ns', then timed for
+       'duration_ns', then tear it down. */
+    TMicrobenchResult RunMicrobench(TMicrobench &bench, uint64_t warmup_ns,
+        uint64_t duration_ns);
+
+  }  // Bench
+
+}  // Dory
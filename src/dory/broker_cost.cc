@@ -0,0 +1,49 @@
+/* <dory/broker_cost.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/broker_cost.h>.
+ */
+
+#include <dory/broker_cost.h>
+
+#include <algorithm>
+
+using namespace Dory;
+using namespace Dory::MsgDispatch;
+
+double Dory::ComputeBrokerCost(const TBrokerLoad &load,
+    size_t produce_request_data_limit) {
+  double backlog = static_cast<double>(load.QueuedBytes + load.InFlightBytes) /
+      static_cast<double>(std::max<size_t>(produce_request_data_limit, 1));
+  double latency = static_cast<double>(load.AckLatency) / 1000.0;
+  return (1.0 + backlog) * (1.0 + latency);
+}
+
+size_t Dory::ChooseLessLoadedBroker(const TKafkaDispatcherApi &dispatcher,
+    size_t produce_request_data_limit, size_t broker_index,
+    size_t other_broker_index) {
+  if ((other_broker_index != broker_index) &&
+      (ComputeBrokerCost(dispatcher.GetBrokerLoad(other_broker_index),
+           produce_request_data_limit) <
+       ComputeBrokerCost(dispatcher.GetBrokerLoad(broker_index),
+           produce_request_data_limit))) {
+    return other_broker_index;
+  }
+
+  return broker_index;
+}
@@ -0,0 +1,51 @@
+/* <dory/broker_cost.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Functions for comparing brokers by load when routing AnyPartition messages.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include <dory/msg_dispatch/api_defs.h>
+#include <dory/msg_dispatch/kafka_dispatcher_api.h>
+
+namespace Dory {
+
+  /* Return a cost for routing more data to a broker with load 'load'.  Lower
+     is better.  Backlog (queued and in flight bytes) is measured in units of
+     'produce_request_data_limit', and ACK latency in milliseconds.  The cost
+     is the product of (1 + backlog) and (1 + latency), so a broker with no
+     backlog and no latency information is ranked purely by the other
+     factor. */
+  double ComputeBrokerCost(const MsgDispatch::TBrokerLoad &load,
+      size_t produce_request_data_limit);
+
+  /* Compare the brokers given by indexes 'broker_index' and
+     'other_broker_index', using load information from 'dispatcher'.  Return
+     'other_broker_index' if it is strictly less costly according to
+     ComputeBrokerCost().  Otherwise return 'broker_index', so ties (including
+     the case of no load information for either broker) go to the first
+     broker. */
+  size_t ChooseLessLoadedBroker(
+      const MsgDispatch::TKafkaDispatcherApi &dispatcher,
+      size_t produce_request_data_limit, size_t broker_index,
+      size_t other_broker_index);
+
+}  // Dory
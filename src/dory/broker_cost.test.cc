@@ -0,0 +1,125 @@
+/* <dory/broker_cost.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/broker_cost.h>
+ */
+
+#include <dory/broker_cost.h>
+
+#include <cstdint>
+
+#include <dory/msg_dispatch/api_defs.h>
+#include <dory/test_util/mock_kafka_dispatcher.h>
+
+#include <gtest/gtest.h>
+
+using namespace Dory;
+using namespace Dory::MsgDispatch;
+using namespace Dory::TestUtil;
+
+namespace {
+
+  const size_t DATA_LIMIT = 1000;
+
+  TBrokerLoad MakeLoad(uint64_t queued_bytes, uint64_t in_flight_bytes,
+      uint64_t ack_latency) {
+    TBrokerLoad load;
+    load.QueuedBytes = queued_bytes;
+    load.InFlightBytes = in_flight_bytes;
+    load.AckLatency = ack_latency;
+    return load;
+  }
+
+  /* The fixture for testing broker cost computation. */
+  class TBrokerCostTest : public ::testing::Test {
+    protected:
+    TBrokerCostTest() {
+    }
+
+    virtual ~TBrokerCostTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TBrokerCostTest
+
+  TEST_F(TBrokerCostTest, CostTest) {
+    ASSERT_EQ(ComputeBrokerCost(TBrokerLoad(), DATA_LIMIT), 1.0);
+
+    /* One full produce request of backlog, split between queued and in
+       flight. */
+    ASSERT_EQ(ComputeBrokerCost(MakeLoad(400, 600, 0), DATA_LIMIT), 2.0);
+
+    /* 3 ms ACK latency. */
+    ASSERT_EQ(ComputeBrokerCost(MakeLoad(0, 0, 3000), DATA_LIMIT), 4.0);
+
+    /* Both factors. */
+    ASSERT_EQ(ComputeBrokerCost(MakeLoad(1000, 1000, 1000), DATA_LIMIT),
+        6.0);
+
+    /* A zero limit is treated as 1. */
+    ASSERT_EQ(ComputeBrokerCost(MakeLoad(2, 0, 0), 0), 3.0);
+  }
+
+  TEST_F(TBrokerCostTest, LessLoadedWinsTest) {
+    TMockKafkaDispatcher dispatcher;
+
+    /* Broker 1 has a backlog, so broker 0 wins in either order. */
+    dispatcher.SetBrokerLoad(1, MakeLoad(5000, 0, 0));
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 0, 1), 0U);
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 1, 0), 0U);
+
+    /* Now broker 0 is slow to ACK, and its cost exceeds that of broker 1. */
+    dispatcher.SetBrokerLoad(0, MakeLoad(0, 0, 10000));
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 0, 1), 1U);
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 1, 0), 1U);
+
+    /* A broker compared with itself is always kept. */
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 0, 0), 0U);
+  }
+
+  TEST_F(TBrokerCostTest, TieTest) {
+    TMockKafkaDispatcher dispatcher;
+
+    /* No load information for either broker: the first (round-robin) choice
+       is kept. */
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 0, 1), 0U);
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 1, 0), 1U);
+
+    /* Different loads with equal cost: (1 + 1) * (1 + 2) == (1 + 2) * (1 + 1).
+       The first choice is still kept, since the second must be strictly less
+       loaded. */
+    dispatcher.SetBrokerLoad(0, MakeLoad(1000, 0, 2000));
+    dispatcher.SetBrokerLoad(1, MakeLoad(0, 2000, 1000));
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 0, 1), 0U);
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 1, 0), 1U);
+
+    /* A slight improvement is enough to switch. */
+    dispatcher.SetBrokerLoad(1, MakeLoad(0, 1999, 1000));
+    ASSERT_EQ(ChooseLessLoadedBroker(dispatcher, DATA_LIMIT, 0, 1), 1U);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
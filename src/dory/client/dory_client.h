@@ -83,6 +83,14 @@
    call dory_find_partition_key_msg_size() instead of
    dory_find_any_partition_msg_size(), and call
    dory_write_partition_key_msg() instead of dory_write_any_partition_msg().
+
+   A client that needs its messages delivered right away, even though their
+   topic is configured for batching, can follow them with a flush request.
+   Use dory_find_flush_msg_size() and dory_write_flush_msg() to create one,
+   and send it in the same way as a message, using the same socket.  Dory
+   then sends any batched messages for the topic without waiting for the
+   batching limits to be reached.  An empty topic requests a flush of all
+   topics.
  */
 
 #pragma once
@@ -163,6 +171,21 @@ int dory_write_partition_key_msg(void *out_buf, size_t out_buf_size,
     int32_t partition_key, const char *topic, int64_t timestamp,
     const void *key, size_t key_size, const void *value, size_t value_size);
 
+/* Compute the total size of a flush request with topic size (as reported by
+   strlen()) 'topic_size' in bytes.  A topic size of 0 requests a flush of all
+   topics.  On success, write total message size to *out_size and return
+   DORY_OK.  The only possible returned error code is DORY_TOPIC_TOO_LARGE. */
+int dory_find_flush_msg_size(size_t topic_size, size_t *out_size);
+
+/* Write a flush request to output buffer 'out_buf' whose size is
+   'out_buf_size'.  'topic' specifies the topic whose batched messages Dory
+   should send immediately, or is empty to specify all topics.  'out_buf_size'
+   must be at least as large as the size reported by
+   dory_find_flush_msg_size().  Return DORY_OK on success.  Possible returned
+   error codes are { DORY_BUF_TOO_SMALL, DORY_TOPIC_TOO_LARGE }. */
+int dory_write_flush_msg(void *out_buf, size_t out_buf_size,
+    const char *topic);
+
 /* Initialize a dory_client_socket_t structure.  This must be called before
    its first use, but should not be called again on the object after that.  It
    serves the same purpose as a constructor in C++.  On return, 'client_socket'
@@ -33,6 +33,7 @@
 #include <base/export_sym.h>
 #include <dory/client/build_id.h>
 #include <dory/input_dg/any_partition/v0/v0_write_msg.h>
+#include <dory/input_dg/flush/v0/v0_write_msg.h>
 #include <dory/input_dg/partition_key/v0/v0_write_msg.h>
 
 const char EXPORT_SYM *dory_get_build_id() {
@@ -106,6 +107,32 @@ int EXPORT_SYM dory_write_partition_key_msg(void *out_buf,
   return DORY_OK;
 }
 
+int EXPORT_SYM dory_find_flush_msg_size(size_t topic_size,
+    size_t *out_size) {
+  assert(out_size);
+  return input_dg_flush_v0_compute_msg_size(out_size, topic_size);
+}
+
+int EXPORT_SYM dory_write_flush_msg(void *out_buf, size_t out_buf_size,
+    const char *topic) {
+  assert(out_buf);
+  assert(topic);
+  size_t topic_len = strlen(topic);
+  size_t dg_size = 0;
+  int ret = dory_find_flush_msg_size(topic_len, &dg_size);
+
+  if (ret != DORY_OK) {
+    return ret;
+  }
+
+  if (out_buf_size < dg_size) {
+    return DORY_BUF_TOO_SMALL;
+  }
+
+  input_dg_flush_v0_write_msg(out_buf, topic, topic + topic_len);
+  return DORY_OK;
+}
+
 void EXPORT_SYM dory_client_socket_init(
     dory_client_socket_t *client_socket) {
   assert(client_socket);
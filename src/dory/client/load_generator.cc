@@ -0,0 +1,398 @@
+/* <dory/client/load_generator.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/client/load_generator.h>.
+ */
+
+#include <dory/client/load_generator.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+
+#include <time.h>
+
+#include <base/error_utils.h>
+#include <base/no_default_case.h>
+#include <base/time_util.h>
+#include <dory/client/client_sender_base.h>
+#include <dory/client/dory_client.h>
+#include <dory/client/status_codes.h>
+#include <dory/client/tcp_sender.h>
+#include <dory/client/unix_dg_sender.h>
+#include <dory/client/unix_stream_sender.h>
+#include <dory/util/arg_parse_error.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Client;
+using namespace Dory::Util;
+
+static uint64_t GetThreadCpuMicroseconds() {
+  struct timespec ts;
+  IfLt0(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts));
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000) +
+      static_cast<uint64_t>(ts.tv_nsec / 1000);
+}
+
+/* Split 'spec' at commas.  An empty string yields a single empty item. */
+static std::vector<std::string> SplitAtCommas(const std::string &spec) {
+  std::vector<std::string> result;
+  size_t pos = 0;
+
+  for (; ; ) {
+    size_t comma = spec.find(',', pos);
+
+    if (comma == std::string::npos) {
+      result.push_back(spec.substr(pos));
+      break;
+    }
+
+    result.push_back(spec.substr(pos, comma - pos));
+    pos = comma + 1;
+  }
+
+  return result;
+}
+
+static bool ParseUnsigned(const std::string &s, unsigned long &result) {
+  if (s.empty() || (s[0] < '0') || (s[0] > '9')) {
+    return false;
+  }
+
+  char *end = nullptr;
+  errno = 0;
+  result = std::strtoul(s.c_str(), &end, 10);
+  return (*end == '\0') && (errno == 0);
+}
+
+std::vector<TLoadGenerator::TTransport>
+TLoadGenerator::ParseTransports(const std::string &spec) {
+  std::vector<TTransport> result;
+
+  for (const std::string &item : SplitAtCommas(spec)) {
+    if (item == "dg") {
+      result.push_back(TTransport::UnixDg);
+    } else if (item == "stream") {
+      result.push_back(TTransport::UnixStream);
+    } else if (item == "tcp") {
+      result.push_back(TTransport::Tcp);
+    } else {
+      throw TArgParseError("Invalid transport [" + item +
+          "]: expected dg, stream, or tcp");
+    }
+  }
+
+  return result;
+}
+
+void TLoadGenerator::ParseSizeRange(const std::string &spec,
+    size_t &min_size, size_t &max_size) {
+  size_t dash = spec.find('-');
+  unsigned long min_value = 0;
+  unsigned long max_value = 0;
+  bool ok = false;
+
+  if (dash == std::string::npos) {
+    ok = ParseUnsigned(spec, min_value);
+    max_value = min_value;
+  } else {
+    ok = ParseUnsigned(spec.substr(0, dash), min_value) &&
+        ParseUnsigned(spec.substr(dash + 1), max_value) &&
+        (min_value <= max_value);
+  }
+
+  if (!ok) {
+    throw TArgParseError("Invalid size [" + spec +
+        "]: expected N or MIN-MAX");
+  }
+
+  min_size = min_value;
+  max_size = max_value;
+}
+
+std::vector<TLoadGenerator::TTopic>
+TLoadGenerator::ParseTopics(const std::string &spec) {
+  std::vector<TTopic> result;
+
+  for (const std::string &item : SplitAtCommas(spec)) {
+    size_t colon = item.find(':');
+    std::string name = item.substr(0, colon);
+    unsigned long weight = 1;
+
+    if (name.empty() || ((colon != std::string::npos) &&
+        (!ParseUnsigned(item.substr(colon + 1), weight) || (weight == 0) ||
+         (weight > std::numeric_limits<unsigned>::max())))) {
+      throw TArgParseError("Invalid topic [" + item +
+          "]: expected TOPIC[:WEIGHT] with positive weight");
+    }
+
+    result.emplace_back(name, static_cast<unsigned>(weight));
+  }
+
+  return result;
+}
+
+const char *TLoadGenerator::TransportToString(TTransport transport) {
+  const char *text = "";
+
+  switch (transport) {
+    case TTransport::UnixDg: {
+      text = "dg";
+      break;
+    }
+    case TTransport::UnixStream: {
+      text = "stream";
+      break;
+    }
+    case TTransport::Tcp: {
+      text = "tcp";
+      break;
+    }
+    NO_DEFAULT_CASE;
+  }
+
+  return text;
+}
+
+TLoadGenerator::TLoadGenerator(const TConfig &config)
+    : Config(config),
+      StopRequested(false),
+      StartUs(0) {
+  assert(Config.ThreadCount > 0);
+  assert(!Config.Transports.empty());
+  assert(!Config.Topics.empty());
+  assert(Config.MinValueSize <= Config.MaxValueSize);
+  assert(Config.PartitionKeyPercent <= 100);
+}
+
+TLoadGenerator::~TLoadGenerator() noexcept {
+  /* This only does something if Join() was never called. */
+  RequestStop();
+
+  for (std::thread &t : Threads) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+}
+
+void TLoadGenerator::Start() {
+  assert(this);
+  assert(Threads.empty());
+  StartUs = GetMonotonicRawMicroseconds();
+  ThreadStates.resize(Config.ThreadCount);
+
+  for (size_t i = 0; i < ThreadStates.size(); ++i) {
+    TThreadState &state = ThreadStates[i];
+    state.Index = i;
+    state.FinishUs = StartUs;
+
+    if (Config.MsgCount) {
+      /* Divide the messages as evenly as possible among the threads. */
+      state.MsgLimit = (Config.MsgCount / Config.ThreadCount) +
+          ((i < (Config.MsgCount % Config.ThreadCount)) ? 1 : 0);
+    } else {
+      state.MsgLimit = std::numeric_limits<size_t>::max();
+    }
+  }
+
+  for (TThreadState &state : ThreadStates) {
+    Threads.emplace_back(&TLoadGenerator::SenderThreadMain, this,
+        std::ref(state));
+  }
+}
+
+TLoadGenerator::TResult TLoadGenerator::Join() {
+  assert(this);
+  TResult result;
+  uint64_t finish_us = StartUs;
+
+  for (std::thread &t : Threads) {
+    t.join();
+  }
+
+  Threads.clear();
+
+  for (const TThreadState &state : ThreadStates) {
+    const TResult &r = state.Result;
+    result.MsgsSent += r.MsgsSent;
+    result.BytesSent += r.BytesSent;
+    result.SendErrors += r.SendErrors;
+    result.ClientCpuUs += r.ClientCpuUs;
+    result.SendLatencyNs.Merge(r.SendLatencyNs);
+    result.Errors.insert(result.Errors.end(), r.Errors.begin(),
+        r.Errors.end());
+    finish_us = std::max(finish_us, state.FinishUs);
+  }
+
+  result.ElapsedUs = finish_us - StartUs;
+  return result;
+}
+
+void TLoadGenerator::SenderThreadMain(TThreadState &state) {
+  assert(this);
+
+  try {
+    DoSend(state);
+  } catch (const std::exception &x) {
+    state.Result.Errors.push_back(std::string("Sender thread ") +
+        std::to_string(state.Index) + ": " + x.what());
+  } catch (...) {
+    state.Result.Errors.push_back(std::string("Sender thread ") +
+        std::to_string(state.Index) + ": unknown error");
+  }
+
+  state.FinishUs = GetMonotonicRawMicroseconds();
+  state.Result.ClientCpuUs = GetThreadCpuMicroseconds();
+}
+
+/* Write a message into 'buf', resizing it as needed. */
+static void CreateMsg(std::vector<uint8_t> &buf, bool use_partition_key,
+    uint32_t partition_key, const std::string &topic, const std::string &key,
+    const char *value, size_t value_size) {
+  size_t msg_size = 0;
+  int ret = use_partition_key ?
+      dory_find_partition_key_msg_size(topic.size(), key.size(), value_size,
+          &msg_size) :
+      dory_find_any_partition_msg_size(topic.size(), key.size(), value_size,
+          &msg_size);
+
+  switch (ret) {
+    case DORY_OK: {
+      break;
+    }
+    case DORY_TOPIC_TOO_LARGE: {
+      throw std::runtime_error("Topic [" + topic + "] is too large");
+    }
+    case DORY_MSG_TOO_LARGE: {
+      throw std::runtime_error("Message is too large");
+    }
+    default: {
+      throw std::logic_error("Unexpected return value from Dory client "
+          "library message size function");
+    }
+  }
+
+  buf.resize(msg_size);
+  uint64_t ts = GetEpochMilliseconds();
+
+  if (use_partition_key) {
+    ret = dory_write_partition_key_msg(&buf[0], buf.size(), partition_key,
+        topic.c_str(), ts, key.data(), key.size(), value, value_size);
+  } else {
+    ret = dory_write_any_partition_msg(&buf[0], buf.size(), topic.c_str(), ts,
+        key.data(), key.size(), value, value_size);
+  }
+
+  assert(ret == DORY_OK);
+}
+
+void TLoadGenerator::DoSend(TThreadState &state) {
+  assert(this);
+  std::unique_ptr<TClientSenderBase> sender;
+  TTransport transport =
+      Config.Transports[state.Index % Config.Transports.size()];
+
+  switch (transport) {
+    case TTransport::UnixDg: {
+      sender.reset(new TUnixDgSender(Config.UnixDgPath));
+      break;
+    }
+    case TTransport::UnixStream: {
+      sender.reset(new TUnixStreamSender(Config.UnixStreamPath));
+      break;
+    }
+    case TTransport::Tcp: {
+      sender.reset(new TTcpSender(Config.TcpPort));
+      break;
+    }
+    NO_DEFAULT_CASE;
+  }
+
+  sender->PrepareToSend();
+  std::vector<unsigned> weights;
+
+  for (const TTopic &topic : Config.Topics) {
+    weights.push_back(topic.Weight);
+  }
+
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(state.Index));
+  std::discrete_distribution<size_t> topic_dist(weights.begin(),
+      weights.end());
+  std::uniform_int_distribution<size_t> size_dist(Config.MinValueSize,
+      Config.MaxValueSize);
+  std::uniform_int_distribution<unsigned> percent_dist(0, 99);
+  std::uniform_int_distribution<uint32_t> partition_key_dist;
+  const std::string key(Config.KeySize, 'k');
+  const std::string value(Config.MaxValueSize, 'v');
+  std::vector<uint8_t> buf;
+  TResult &result = state.Result;
+
+  /* Pacing is per thread, so each thread gets an equal share of the target
+     rate.  A thread that falls behind sends without sleeping until it
+     catches up. */
+  const uint64_t interval_ns = Config.Rate ?
+      ((1000000000ULL * Config.ThreadCount) / Config.Rate) : 0;
+  const uint64_t deadline_ns = Config.DurationMs ?
+      ((StartUs * 1000) + (Config.DurationMs * 1000000ULL)) : 0;
+  uint64_t next_send_ns = GetMonotonicRawNanoseconds();
+
+  for (size_t i = 0; (i < state.MsgLimit) && !StopRequested.load(); ++i) {
+    uint64_t now_ns = GetMonotonicRawNanoseconds();
+
+    if (deadline_ns && (now_ns >= deadline_ns)) {
+      break;
+    }
+
+    if (interval_ns) {
+      if (now_ns < next_send_ns) {
+        SleepMicroseconds((next_send_ns - now_ns) / 1000);
+      }
+
+      next_send_ns += interval_ns;
+    }
+
+    bool use_partition_key = (percent_dist(rng) < Config.PartitionKeyPercent);
+    CreateMsg(buf, use_partition_key, partition_key_dist(rng),
+        Config.Topics[topic_dist(rng)].Name, key, value.data(),
+        size_dist(rng));
+    uint64_t send_start_ns = GetMonotonicRawNanoseconds();
+
+    try {
+      sender->Send(&buf[0], buf.size());
+      ++result.MsgsSent;
+      result.BytesSent += buf.size();
+    } catch (const std::system_error &) {
+      /* Drop the message and reconnect.  If reconnecting fails, the
+         exception ends the thread. */
+      ++result.SendErrors;
+      sender->Reset();
+      sender->PrepareToSend();
+    }
+
+    result.SendLatencyNs.Record(
+        GetMonotonicRawNanoseconds() - send_start_ns);
+  }
+}
@@ -0,0 +1,217 @@
+/* <dory/client/load_generator.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Multithreaded load generator for sending messages to Dory.  Used by the
+   dory_bench benchmark and by to_dory's load generator mode.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include <base/no_copy_semantics.h>
+#include <dory/util/histogram.h>
+
+namespace Dory {
+
+  namespace Client {
+
+    /* Sends messages to Dory from a configurable number of threads, over any
+       mix of UNIX domain datagram, UNIX domain stream, and local TCP sockets.
+       Message sizes, topics, and key vs. any-partition routing are chosen
+       randomly per message according to the configuration.  Each thread
+       seeds its random number generator with its index, so a given
+       configuration produces the same sequence of messages on every run. */
+    class TLoadGenerator final {
+      NO_COPY_SEMANTICS(TLoadGenerator);
+
+      public:
+      enum class TTransport {
+        UnixDg,
+        UnixStream,
+        Tcp
+      };  // TTransport
+
+      struct TTopic {
+        std::string Name;
+
+        /* Relative frequency with which the topic is chosen. */
+        unsigned Weight;
+
+        TTopic(const std::string &name, unsigned weight)
+            : Name(name),
+              Weight(weight) {
+        }
+      };  // TTopic
+
+      struct TConfig {
+        /* For UNIX domain datagram socket input to Dory. */
+        std::string UnixDgPath;
+
+        /* For UNIX domain stream socket input to Dory. */
+        std::string UnixStreamPath;
+
+        /* For local TCP input to Dory. */
+        in_port_t TcpPort;
+
+        /* Sender thread i uses Transports[i % Transports.size()]. */
+        std::vector<TTransport> Transports;
+
+        size_t ThreadCount;
+
+        std::vector<TTopic> Topics;
+
+        /* Message value sizes are uniformly distributed in
+           [MinValueSize, MaxValueSize]. */
+        size_t MinValueSize;
+
+        size_t MaxValueSize;
+
+        size_t KeySize;
+
+        /* Percentage of messages sent as partition key messages.  The rest
+           are sent as any-partition messages. */
+        unsigned PartitionKeyPercent;
+
+        /* Total target rate in messages per second, divided evenly among the
+           threads.  0 means send as fast as possible. */
+        size_t Rate;
+
+        /* Stop after this many milliseconds.  0 means no time limit. */
+        size_t DurationMs;
+
+        /* Stop after sending this many messages in total.  0 means no
+           limit. */
+        size_t MsgCount;
+
+        TConfig()
+            : TcpPort(0),
+              ThreadCount(1),
+              MinValueSize(100),
+              MaxValueSize(100),
+              KeySize(0),
+              PartitionKeyPercent(0),
+              Rate(0),
+              DurationMs(0),
+              MsgCount(0) {
+        }
+      };  // TConfig
+
+      struct TResult {
+        /* Messages successfully handed to the socket. */
+        uint64_t MsgsSent;
+
+        /* Total size of the messages counted in 'MsgsSent'. */
+        uint64_t BytesSent;
+
+        /* Send attempts that failed.  The message is dropped and the sender
+           reconnects. */
+        uint64_t SendErrors;
+
+        /* Wall clock time from Start() until the last thread finished. */
+        uint64_t ElapsedUs;
+
+        /* CPU time consumed by the sender threads. */
+        uint64_t ClientCpuUs;
+
+        /* Time spent in each send call, in nanoseconds. */
+        Util::THistogram SendLatencyNs;
+
+        /* Errors that stopped a thread early, such as failure to connect. */
+        std::vector<std::string> Errors;
+
+        TResult()
+            : MsgsSent(0),
+              BytesSent(0),
+              SendErrors(0),
+              ElapsedUs(0),
+              ClientCpuUs(0) {
+        }
+      };  // TResult
+
+      /* Parse a comma-separated list of transports from { dg, stream,
+         tcp }.  Throws Util::TArgParseError on error. */
+      static std::vector<TTransport> ParseTransports(const std::string &spec);
+
+      /* Parse a size range of the form N or MIN-MAX.  Throws
+         Util::TArgParseError on error. */
+      static void ParseSizeRange(const std::string &spec, size_t &min_size,
+          size_t &max_size);
+
+      /* Parse a comma-separated list of TOPIC[:WEIGHT] items.  The weight
+         defaults to 1.  Throws Util::TArgParseError on error. */
+      static std::vector<TTopic> ParseTopics(const std::string &spec);
+
+      static const char *TransportToString(TTransport transport);
+
+      explicit TLoadGenerator(const TConfig &config);
+
+      ~TLoadGenerator() noexcept;
+
+      /* Start the sender threads. */
+      void Start();
+
+      /* Ask the sender threads to stop early.  They finish the message they
+         are currently sending. */
+      void RequestStop() {
+        assert(this);
+        StopRequested.store(true);
+      }
+
+      /* Wait for the sender threads to finish, and return their combined
+         results. */
+      TResult Join();
+
+      private:
+      struct TThreadState {
+        size_t Index;
+
+        size_t MsgLimit;
+
+        /* Value of GetMonotonicRawMicroseconds() when the thread finished. */
+        uint64_t FinishUs;
+
+        TResult Result;
+      };  // TThreadState
+
+      void SenderThreadMain(TThreadState &state);
+
+      void DoSend(TThreadState &state);
+
+      const TConfig Config;
+
+      std::atomic<bool> StopRequested;
+
+      uint64_t StartUs;
+
+      std::vector<TThreadState> ThreadStates;
+
+      std::vector<std::thread> Threads;
+    };  // TLoadGenerator
+
+  }  // Client
+
+}  // Dory
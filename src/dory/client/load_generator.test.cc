@@ -0,0 +1,232 @@
+/* <dory/client/load_generator.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/client/load_generator.h>.
+ */
+
+#include <dory/client/load_generator.h>
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <base/error_utils.h>
+#include <base/fd.h>
+#include <base/tmp_file_name.h>
+#include <dory/util/arg_parse_error.h>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Client;
+using namespace Dory::Util;
+
+namespace {
+
+  /* The fixture for testing class TLoadGenerator. */
+  class TLoadGeneratorTest : public ::testing::Test {
+    protected:
+    TLoadGeneratorTest() {
+    }
+
+    virtual ~TLoadGeneratorTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TLoadGeneratorTest
+
+  TFd BindUnixSocket(const char *path, int type) {
+    TFd sock(IfLt0(socket(AF_LOCAL, type, 0)));
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_LOCAL;
+    std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    IfLt0(bind(sock, reinterpret_cast<const struct sockaddr *>(&addr),
+        sizeof(addr)));
+    return sock;
+  }
+
+  TLoadGenerator::TConfig CreateConfig() {
+    TLoadGenerator::TConfig config;
+    config.ThreadCount = 3;
+    config.Topics = TLoadGenerator::ParseTopics("topic1:3,topic2");
+    TLoadGenerator::ParseSizeRange("10-200", config.MinValueSize,
+        config.MaxValueSize);
+    config.KeySize = 5;
+    config.PartitionKeyPercent = 50;
+    config.MsgCount = 100;
+    return config;
+  }
+
+  TEST_F(TLoadGeneratorTest, ParseTest) {
+    std::vector<TLoadGenerator::TTransport> transports =
+        TLoadGenerator::ParseTransports("dg,tcp,stream");
+    ASSERT_EQ(transports.size(), 3U);
+    ASSERT_TRUE(transports[0] == TLoadGenerator::TTransport::UnixDg);
+    ASSERT_TRUE(transports[1] == TLoadGenerator::TTransport::Tcp);
+    ASSERT_TRUE(transports[2] == TLoadGenerator::TTransport::UnixStream);
+    ASSERT_THROW(TLoadGenerator::ParseTransports("dg,udp"), TArgParseError);
+    ASSERT_THROW(TLoadGenerator::ParseTransports(""), TArgParseError);
+
+    size_t min_size = 0;
+    size_t max_size = 0;
+    TLoadGenerator::ParseSizeRange("100", min_size, max_size);
+    ASSERT_EQ(min_size, 100U);
+    ASSERT_EQ(max_size, 100U);
+    TLoadGenerator::ParseSizeRange("0-4096", min_size, max_size);
+    ASSERT_EQ(min_size, 0U);
+    ASSERT_EQ(max_size, 4096U);
+    ASSERT_THROW(TLoadGenerator::ParseSizeRange("200-100", min_size,
+        max_size), TArgParseError);
+    ASSERT_THROW(TLoadGenerator::ParseSizeRange("-5", min_size, max_size),
+        TArgParseError);
+    ASSERT_THROW(TLoadGenerator::ParseSizeRange("10x", min_size, max_size),
+        TArgParseError);
+
+    std::vector<TLoadGenerator::TTopic> topics =
+        TLoadGenerator::ParseTopics("a:5,b,c:1");
+    ASSERT_EQ(topics.size(), 3U);
+    ASSERT_EQ(topics[0].Name, "a");
+    ASSERT_EQ(topics[0].Weight, 5U);
+    ASSERT_EQ(topics[1].Name, "b");
+    ASSERT_EQ(topics[1].Weight, 1U);
+    ASSERT_EQ(topics[2].Name, "c");
+    ASSERT_EQ(topics[2].Weight, 1U);
+    ASSERT_THROW(TLoadGenerator::ParseTopics("a,:2"), TArgParseError);
+    ASSERT_THROW(TLoadGenerator::ParseTopics("a:0"), TArgParseError);
+    ASSERT_THROW(TLoadGenerator::ParseTopics("a:x"), TArgParseError);
+  }
+
+  TEST_F(TLoadGeneratorTest, UnixDgTest) {
+    TTmpFileName path;
+    TFd sock = BindUnixSocket(path, SOCK_DGRAM);
+    TLoadGenerator::TConfig config = CreateConfig();
+    config.UnixDgPath = static_cast<const char *>(path);
+    config.Transports.push_back(TLoadGenerator::TTransport::UnixDg);
+    size_t msg_count = 0;
+    size_t byte_count = 0;
+    std::thread receiver(
+        [&]() {
+          std::vector<uint8_t> buf(64 * 1024);
+
+          while (msg_count < config.MsgCount) {
+            ssize_t ret = IfLt0(recv(sock, &buf[0], buf.size(), 0));
+            ++msg_count;
+            byte_count += static_cast<size_t>(ret);
+          }
+        });
+    TLoadGenerator::TResult result;
+
+    {
+      TLoadGenerator generator(config);
+      generator.Start();
+      result = generator.Join();
+    }
+
+    receiver.join();
+    unlink(path);
+    ASSERT_TRUE(result.Errors.empty());
+    ASSERT_EQ(result.MsgsSent, config.MsgCount);
+    ASSERT_EQ(result.SendErrors, 0U);
+    ASSERT_EQ(result.SendLatencyNs.GetCount(), config.MsgCount);
+    ASSERT_EQ(msg_count, config.MsgCount);
+    ASSERT_EQ(byte_count, result.BytesSent);
+  }
+
+  TEST_F(TLoadGeneratorTest, UnixStreamTest) {
+    TTmpFileName path;
+    TFd sock = BindUnixSocket(path, SOCK_STREAM);
+    IfLt0(listen(sock, 16));
+    TLoadGenerator::TConfig config = CreateConfig();
+    config.UnixStreamPath = static_cast<const char *>(path);
+    config.Transports.push_back(TLoadGenerator::TTransport::UnixStream);
+    config.MsgCount = 0;
+    config.DurationMs = 200;
+    config.Rate = 1000;
+    std::vector<size_t> byte_counts(config.ThreadCount, 0);
+    std::thread receiver(
+        [&]() {
+          std::vector<std::thread> readers;
+
+          for (size_t i = 0; i < byte_counts.size(); ++i) {
+            int fd = IfLt0(accept(sock, nullptr, nullptr));
+            readers.emplace_back(
+                [fd, i, &byte_counts]() {
+                  TFd conn(fd);
+                  std::vector<uint8_t> buf(64 * 1024);
+
+                  for (; ; ) {
+                    ssize_t ret = IfLt0(recv(conn, &buf[0], buf.size(), 0));
+
+                    if (ret == 0) {
+                      break;
+                    }
+
+                    byte_counts[i] += static_cast<size_t>(ret);
+                  }
+                });
+          }
+
+          for (std::thread &t : readers) {
+            t.join();
+          }
+        });
+    TLoadGenerator::TResult result;
+
+    {
+      TLoadGenerator generator(config);
+      generator.Start();
+      result = generator.Join();
+    }
+
+    receiver.join();
+    unlink(path);
+    ASSERT_TRUE(result.Errors.empty());
+    ASSERT_EQ(result.SendErrors, 0U);
+
+    /* At 1000 messages per second for 200 ms, expect about 200 messages.
+       Allow plenty of slack for a loaded test machine. */
+    ASSERT_GT(result.MsgsSent, 50U);
+    ASSERT_LE(result.MsgsSent, 250U);
+    ASSERT_GE(result.ElapsedUs, 150000U);
+    size_t byte_count = 0;
+
+    for (size_t n : byte_counts) {
+      byte_count += n;
+    }
+
+    ASSERT_EQ(byte_count, result.BytesSent);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
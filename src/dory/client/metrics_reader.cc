@@ -0,0 +1,197 @@
+/* <dory/client/metrics_reader.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/client/metrics_reader.h>.
+ */
+
+#include <dory/client/metrics_reader.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <base/error_utils.h>
+#include <base/fd.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Client;
+
+std::string Dory::Client::FetchDoryMetrics(in_port_t port, int timeout_ms) {
+  TFd sock(IfLt0(socket(AF_INET, SOCK_STREAM, 0)));
+  struct sockaddr_in servaddr;
+  std::memset(&servaddr, 0, sizeof(servaddr));
+  servaddr.sin_family = AF_INET;
+  servaddr.sin_port = htons(port);
+  inet_pton(AF_INET, "127.0.0.1", &servaddr.sin_addr);
+  IfLt0(connect(sock, reinterpret_cast<const struct sockaddr *>(&servaddr),
+      sizeof(servaddr)));
+  static const char request[] = "GET /metrics HTTP/1.1\r\n"
+      "Host: localhost\r\nConnection: close\r\n\r\n";
+  size_t sent = 0;
+
+  while (sent < (sizeof(request) - 1)) {
+    sent += IfLt0(send(sock, request + sent, sizeof(request) - 1 - sent,
+        MSG_NOSIGNAL));
+  }
+
+  std::string response;
+  char buf[16384];
+
+  for (; ; ) {
+    if (!sock.IsReadable(timeout_ms)) {
+      throw TBadMetricsResponse("Timed out reading Dory's metrics");
+    }
+
+    ssize_t nbytes = IfLt0(read(sock, buf, sizeof(buf)));
+
+    if (nbytes == 0) {
+      break;
+    }
+
+    response.append(buf, static_cast<size_t>(nbytes));
+  }
+
+  return GetHttpResponseBody(response);
+}
+
+/* Return true if 'headers' contains a header line "Transfer-Encoding:
+   chunked", ignoring case. */
+static bool IsChunked(const std::string &headers) {
+  std::string lower;
+
+  for (char c : headers) {
+    lower += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+
+  return (lower.find("\r\ntransfer-encoding: chunked") != std::string::npos);
+}
+
+std::string Dory::Client::GetHttpResponseBody(const std::string &response) {
+  size_t header_end = response.find("\r\n\r\n");
+
+  if (header_end == std::string::npos) {
+    throw TBadMetricsResponse("Incomplete HTTP response headers");
+  }
+
+  size_t status_end = response.find("\r\n");
+  std::string status_line = response.substr(0, status_end);
+  size_t space = status_line.find(' ');
+
+  if ((space == std::string::npos) ||
+      (status_line.compare(space + 1, 3, "200") != 0)) {
+    throw TBadMetricsResponse(
+        ("Unexpected HTTP status: " + status_line).c_str());
+  }
+
+  size_t pos = header_end + 4;
+
+  if (!IsChunked(response.substr(0, pos))) {
+    return response.substr(pos);
+  }
+
+  std::string body;
+
+  for (; ; ) {
+    size_t line_end = response.find("\r\n", pos);
+
+    if (line_end == std::string::npos) {
+      throw TBadMetricsResponse("Truncated HTTP chunk size");
+    }
+
+    const char *size_begin = response.c_str() + pos;
+    char *size_end = nullptr;
+    unsigned long chunk_size = std::strtoul(size_begin, &size_end, 16);
+
+    if (size_end == size_begin) {
+      throw TBadMetricsResponse("Bad HTTP chunk size");
+    }
+
+    pos = line_end + 2;
+
+    if (chunk_size == 0) {
+      break;
+    }
+
+    if ((response.size() - pos) < (chunk_size + 2)) {
+      throw TBadMetricsResponse("Truncated HTTP chunk");
+    }
+
+    body.append(response, pos, chunk_size);
+    pos += chunk_size + 2;
+  }
+
+  return body;
+}
+
+uint64_t Dory::Client::SumMetricSamples(const std::string &metrics,
+    const std::string &sample_name) {
+  uint64_t sum = 0;
+  size_t pos = 0;
+
+  while (pos < metrics.size()) {
+    size_t line_end = metrics.find('\n', pos);
+
+    if (line_end == std::string::npos) {
+      line_end = metrics.size();
+    }
+
+    /* A sample line is the name, optional labels in braces, a space, and
+       the value.  Label values may contain spaces, so look for the value
+       after the closing brace. */
+    if (metrics.compare(pos, sample_name.size(), sample_name) == 0) {
+      size_t name_end = pos + sample_name.size();
+      size_t value_pos = std::string::npos;
+
+      if (metrics[name_end] == ' ') {
+        value_pos = name_end + 1;
+      } else if (metrics[name_end] == '{') {
+        size_t brace = metrics.rfind('}', line_end);
+
+        if ((brace != std::string::npos) && (brace > name_end) &&
+            ((brace + 1) < line_end) && (metrics[brace + 1] == ' ')) {
+          value_pos = brace + 2;
+        }
+      }
+
+      if (value_pos != std::string::npos) {
+        sum += static_cast<uint64_t>(
+            std::strtod(metrics.c_str() + value_pos, nullptr));
+      }
+    }
+
+    pos = line_end + 1;
+  }
+
+  return sum;
+}
+
+TDoryMsgCounts Dory::Client::GetDoryMsgCounts(const std::string &metrics) {
+  TDoryMsgCounts counts;
+  counts.Delivered = SumMetricSamples(metrics, "dory_delivered_msgs_total");
+
+  /* Rate limiting discards are included in dory_discarded_msgs. */
+  counts.Discarded = SumMetricSamples(metrics, "dory_discarded_msgs_total") +
+      SumMetricSamples(metrics, "dory_input_discarded_msgs_total");
+  return counts;
+}
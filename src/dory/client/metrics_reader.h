@@ -0,0 +1,81 @@
+/* <dory/client/metrics_reader.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Reads message counts from the OpenMetrics output of Dory's web interface.
+   to_dory's load generator mode uses this to find out what happened to the
+   messages it sent.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <netinet/in.h>
+
+#include <base/thrower.h>
+
+namespace Dory {
+
+  namespace Client {
+
+    DEFINE_ERROR(TBadMetricsResponse, std::runtime_error,
+                 "Bad response from Dory's web interface");
+
+    struct TDoryMsgCounts {
+      /* Messages delivered to Kafka with a successful ACK. */
+      uint64_t Delivered;
+
+      /* Messages discarded for any reason, including those discarded before
+         their topics were known. */
+      uint64_t Discarded;
+
+      TDoryMsgCounts()
+          : Delivered(0),
+            Discarded(0) {
+      }
+    };  // TDoryMsgCounts
+
+    /* Fetch /metrics from Dory's web interface on local TCP port 'port', and
+       return the body of the response.  Throws std::system_error on socket
+       error, or TBadMetricsResponse if the response is bad or doesn't arrive
+       within 'timeout_ms' milliseconds. */
+    std::string FetchDoryMetrics(in_port_t port, int timeout_ms = 10000);
+
+    /* Return the body of HTTP response 'response', removing chunked transfer
+       encoding if present.  Throws TBadMetricsResponse if the response is
+       malformed or its status is not 200. */
+    std::string GetHttpResponseBody(const std::string &response);
+
+    /* Return the sum of the values of all samples named 'sample_name' in
+       OpenMetrics text 'metrics', regardless of their labels. */
+    uint64_t SumMetricSamples(const std::string &metrics,
+        const std::string &sample_name);
+
+    TDoryMsgCounts GetDoryMsgCounts(const std::string &metrics);
+
+    /* Fetch Dory's message counts from its web interface on local TCP port
+       'port'.  Throws as described for FetchDoryMetrics(). */
+    inline TDoryMsgCounts ReadDoryMsgCounts(in_port_t port) {
+      return GetDoryMsgCounts(FetchDoryMetrics(port));
+    }
+
+  }  // Client
+
+}  // Dory
@@ -0,0 +1,98 @@
+/* <dory/client/metrics_reader.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/client/metrics_reader.h>.
+ */
+
+#include <dory/client/metrics_reader.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace Dory;
+using namespace Dory::Client;
+
+namespace {
+
+  /* The fixture for testing the metrics reader. */
+  class TMetricsReaderTest : public ::testing::Test {
+    protected:
+    TMetricsReaderTest() {
+    }
+
+    virtual ~TMetricsReaderTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TMetricsReaderTest
+
+  const char METRICS[] =
+      "# TYPE dory_delivered_msgs counter\n"
+      "# HELP dory_delivered_msgs Messages delivered.\n"
+      "dory_delivered_msgs_total{topic=\"t1\"} 100\n"
+      "dory_delivered_msgs_total{topic=\"t 2\"} 25\n"
+      "# TYPE dory_discarded_msgs counter\n"
+      "dory_discarded_msgs_total{topic=\"t1\"} 3\n"
+      "# TYPE dory_rate_limit_discarded_msgs counter\n"
+      "dory_rate_limit_discarded_msgs_total{topic=\"t1\"} 2\n"
+      "# TYPE dory_input_discarded_msgs counter\n"
+      "dory_input_discarded_msgs_total{reason=\"malformed\"} 4\n"
+      "dory_input_discarded_msgs_total{reason=\"bad_topic\"} 0\n"
+      "# TYPE dory_new_msgs gauge\n"
+      "dory_new_msgs 7\n"
+      "# EOF\n";
+
+  TEST_F(TMetricsReaderTest, SumSamples) {
+    std::string metrics(METRICS);
+    ASSERT_EQ(SumMetricSamples(metrics, "dory_delivered_msgs_total"), 125U);
+    ASSERT_EQ(SumMetricSamples(metrics, "dory_discarded_msgs_total"), 3U);
+    ASSERT_EQ(SumMetricSamples(metrics, "dory_new_msgs"), 7U);
+    ASSERT_EQ(SumMetricSamples(metrics, "dory_new"), 0U);
+    ASSERT_EQ(SumMetricSamples(metrics, "no_such_metric"), 0U);
+    TDoryMsgCounts counts = GetDoryMsgCounts(metrics);
+    ASSERT_EQ(counts.Delivered, 125U);
+    ASSERT_EQ(counts.Discarded, 7U);
+  }
+
+  TEST_F(TMetricsReaderTest, ResponseBody) {
+    ASSERT_EQ(GetHttpResponseBody("HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n\r\nhello"), "hello");
+    ASSERT_EQ(GetHttpResponseBody("HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n"
+        "5\r\nhello\r\nb\r\n world\nfoo\n\r\n0\r\n\r\n"),
+        "hello world\nfoo\n");
+    ASSERT_THROW(GetHttpResponseBody("HTTP/1.1 404 Not Found\r\n\r\n"),
+        TBadMetricsResponse);
+    ASSERT_THROW(GetHttpResponseBody("HTTP/1.1 200 OK\r\n"),
+        TBadMetricsResponse);
+    ASSERT_THROW(GetHttpResponseBody("HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n10\r\nhello\r\n0\r\n\r\n"),
+        TBadMetricsResponse);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -16,7 +16,9 @@
    limitations under the License.
    ----------------------------------------------------------------------------
 
-   Simple client program that sends messages to Dory daemon.
+   Simple client program that sends messages to Dory daemon.  With --load,
+   it instead generates load from many threads and reports what Dory did
+   with the messages.
  */
 
 #include <algorithm>
@@ -50,12 +52,15 @@
 #include <dory/build_id.h>
 #include <dory/client/dory_client.h>
 #include <dory/client/dory_client_socket.h>
+#include <dory/client/load_generator.h>
+#include <dory/client/metrics_reader.h>
 #include <dory/client/path_too_long.h>
 #include <dory/client/status_codes.h>
 #include <dory/client/tcp_sender.h>
 #include <dory/client/unix_dg_sender.h>
 #include <dory/client/unix_stream_sender.h>
 #include <dory/util/arg_parse_error.h>
+#include <dory/util/histogram.h>
 #include <tclap/CmdLine.h>
 
 using namespace Base;
@@ -101,6 +106,35 @@ struct TConfig {
   bool Bad;
 
   size_t Print;
+
+  /* The remaining fields are for load generator mode. */
+  bool Load;
+
+  bool CountSpecified;
+
+  std::vector<TLoadGenerator::TTopic> Topics;
+
+  size_t ThreadCount;
+
+  /* Load duration in seconds.  0 means no time limit. */
+  size_t Duration;
+
+  size_t Rate;
+
+  size_t MinValueSize;
+
+  size_t MaxValueSize;
+
+  size_t KeySize;
+
+  unsigned PartitionKeyPercent;
+
+  /* Port of Dory's web interface, for reading its counters.  0 means don't
+     read them. */
+  in_port_t StatusPort;
+
+  /* Seconds to wait for Dory to deliver or discard the messages. */
+  size_t DrainTimeout;
 };  // TConfig
 
 static void ParseArgs(int argc, char *argv[], TConfig &config) {
@@ -123,8 +157,10 @@ static void ParseArgs(int argc, char *argv[], TConfig &config) {
         arg_port("", "port", "Local TCP port for sending messages to Dory.",
         false, 0, "PORT");
     cmd.add(arg_port);
-    ValueArg<decltype(config.Topic)> arg_topic("", "topic", "Kafka topic.",
-        true, config.Topic, "TOPIC");
+    ValueArg<decltype(config.Topic)> arg_topic("", "topic", "Kafka topic.  "
+        "With --load, a comma-separated list of TOPIC[:WEIGHT] items, where "
+        "WEIGHT is the topic's relative frequency (default 1).", true,
+        config.Topic, "TOPIC");
     cmd.add(arg_topic);
     ValueArg<decltype(config.PartitionKey)> arg_partition_key("",
         "partition_key", "Partition key.", false, config.PartitionKey,
@@ -156,6 +192,46 @@ static void ParseArgs(int argc, char *argv[], TConfig &config) {
         "print message number every nth message.", false, config.Print,
         "PRINT");
     cmd.add(arg_print);
+    SwitchArg arg_load("", "load", "Load generator mode.  Send randomly "
+        "generated messages from multiple threads, then report what Dory "
+        "did with them.  Any combination of --socket_path, "
+        "--stream_socket_path, and --port may be given, and threads are "
+        "assigned to them in turn.  --count limits the total number of "
+        "messages.", cmd, config.Load);
+    ValueArg<decltype(config.ThreadCount)> arg_threads("", "threads",
+        "Number of sender threads for --load.", false, config.ThreadCount,
+        "COUNT");
+    cmd.add(arg_threads);
+    ValueArg<decltype(config.Duration)> arg_duration("", "duration", "Stop "
+        "--load after this many seconds.", false, config.Duration,
+        "SECONDS");
+    cmd.add(arg_duration);
+    ValueArg<decltype(config.Rate)> arg_rate("", "rate", "Target total rate "
+        "in messages per second for --load.  A value of 0 means \"send "
+        "messages as fast as possible\".", false, config.Rate, "RATE");
+    cmd.add(arg_rate);
+    ValueArg<std::string> arg_value_size("", "value_size", "Message value "
+        "size for --load, either N or MIN-MAX for sizes chosen uniformly from "
+        "a range.", false, "100", "SIZE");
+    cmd.add(arg_value_size);
+    ValueArg<decltype(config.KeySize)> arg_key_size("", "key_size", "Message "
+        "key size for --load.", false, config.KeySize, "SIZE");
+    cmd.add(arg_key_size);
+    ValueArg<decltype(config.PartitionKeyPercent)> arg_partition_key_percent(
+        "", "partition_key_percent", "Percentage of messages sent with a "
+        "random partition key for --load.", false,
+        config.PartitionKeyPercent, "PERCENT");
+    cmd.add(arg_partition_key_percent);
+    ValueArg<decltype(config.StatusPort)> arg_status_port("", "status_port",
+        "Port of Dory's web interface, for reading its counters after "
+        "--load.  A value of 0 means don't read them.", false,
+        config.StatusPort, "PORT");
+    cmd.add(arg_status_port);
+    ValueArg<decltype(config.DrainTimeout)> arg_drain_timeout("",
+        "drain_timeout", "After --load, wait at most this many seconds for "
+        "Dory to deliver or discard the messages.", false,
+        config.DrainTimeout, "SECONDS");
+    cmd.add(arg_drain_timeout);
     cmd.parse(argc, &arg_vec[0]);
     config.SocketPath = arg_socket_path.getValue();
     config.StreamSocketPath = arg_stream_socket_path.getValue();
@@ -185,6 +261,15 @@ static void ParseArgs(int argc, char *argv[], TConfig &config) {
     config.Pad = arg_pad.getValue();
     config.Bad = arg_bad.getValue();
     config.Print = arg_print.getValue();
+    config.Load = arg_load.getValue();
+    config.CountSpecified = arg_count.isSet();
+    config.ThreadCount = arg_threads.getValue();
+    config.Duration = arg_duration.getValue();
+    config.Rate = arg_rate.getValue();
+    config.KeySize = arg_key_size.getValue();
+    config.PartitionKeyPercent = arg_partition_key_percent.getValue();
+    config.StatusPort = arg_status_port.getValue();
+    config.DrainTimeout = arg_drain_timeout.getValue();
 
     if (arg_socket_path.isSet()) {
       ++input_type_count;
@@ -194,7 +279,38 @@ static void ParseArgs(int argc, char *argv[], TConfig &config) {
       ++input_type_count;
     }
 
-    if (input_type_count != 1) {
+    if (config.Load) {
+      if (input_type_count == 0) {
+        throw TArgParseError("At least one of (--socket_path, "
+            "--stream_socket_path, --port) options must be specified.");
+      }
+
+      if (arg_partition_key.isSet() || arg_key.isSet() ||
+          arg_value.isSet() || arg_stdin.isSet() || arg_interval.isSet() ||
+          arg_seq.isSet() || arg_pad.isSet() || arg_bad.isSet() ||
+          arg_print.isSet()) {
+        throw TArgParseError("Options --partition_key, --key, --value, "
+            "--stdin, --interval, --seq, --pad, --bad, and --print are "
+            "invalid with --load.");
+      }
+
+      if (!config.CountSpecified && (config.Duration == 0)) {
+        throw TArgParseError("With --load, at least one of (--count, "
+            "--duration) options must be specified.");
+      }
+
+      if (config.ThreadCount < 1) {
+        throw TArgParseError("--threads must be at least 1");
+      }
+
+      if (config.PartitionKeyPercent > 100) {
+        throw TArgParseError("--partition_key_percent must be at most 100");
+      }
+
+      config.Topics = TLoadGenerator::ParseTopics(config.Topic);
+      TLoadGenerator::ParseSizeRange(arg_value_size.getValue(),
+          config.MinValueSize, config.MaxValueSize);
+    } else if (input_type_count != 1) {
       throw TArgParseError("Exactly one of (--socket_path, "
           "--stream_socket_path, --port) options must be specified.");
     }
@@ -216,7 +332,18 @@ TConfig::TConfig(int argc, char *argv[])
       Seq(false),
       Pad(0),
       Bad(false),
-      Print(0) {
+      Print(0),
+      Load(false),
+      CountSpecified(false),
+      ThreadCount(1),
+      Duration(0),
+      Rate(0),
+      MinValueSize(100),
+      MaxValueSize(100),
+      KeySize(0),
+      PartitionKeyPercent(0),
+      StatusPort(9090),
+      DrainTimeout(30) {
   ParseArgs(argc, argv, *this);
 }
 
@@ -330,6 +457,133 @@ static TClientSenderBase *CreateSender(const TConfig &cfg) {
   return new TTcpSender(*cfg.Port);
 }
 
+static uint64_t PerSecond(uint64_t count, uint64_t usec) {
+  return usec ? static_cast<uint64_t>(
+      (static_cast<double>(count) * 1000000.0) / usec) : 0;
+}
+
+/* Read Dory's message counts, printing a warning on failure. */
+static bool TryReadDoryMsgCounts(in_port_t port, TDoryMsgCounts &counts) {
+  try {
+    counts = ReadDoryMsgCounts(port);
+  } catch (const std::exception &x) {
+    std::cerr << "Failed to read counters from Dory's web interface on port "
+        << port << ": " << x.what() << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+static uint64_t CountDelta(uint64_t before, uint64_t after) {
+  /* Counts go backward if Dory restarts, or if a topic's delivered count
+     goes away because the topic was deleted. */
+  return (after > before) ? (after - before) : 0;
+}
+
+/* Run load generator mode.  Dory's counters are read before and after the
+   load, so messages from other clients sent at the same time are included in
+   the delivered and discarded counts. */
+static int RunLoad(const TConfig &cfg) {
+  TLoadGenerator::TConfig load_cfg;
+  load_cfg.UnixDgPath = cfg.SocketPath;
+  load_cfg.UnixStreamPath = cfg.StreamSocketPath;
+
+  if (!cfg.SocketPath.empty()) {
+    load_cfg.Transports.push_back(TLoadGenerator::TTransport::UnixDg);
+  }
+
+  if (!cfg.StreamSocketPath.empty()) {
+    load_cfg.Transports.push_back(TLoadGenerator::TTransport::UnixStream);
+  }
+
+  if (cfg.Port.IsKnown()) {
+    load_cfg.TcpPort = *cfg.Port;
+    load_cfg.Transports.push_back(TLoadGenerator::TTransport::Tcp);
+  }
+
+  load_cfg.ThreadCount = cfg.ThreadCount;
+  load_cfg.Topics = cfg.Topics;
+  load_cfg.MinValueSize = cfg.MinValueSize;
+  load_cfg.MaxValueSize = cfg.MaxValueSize;
+  load_cfg.KeySize = cfg.KeySize;
+  load_cfg.PartitionKeyPercent = cfg.PartitionKeyPercent;
+  load_cfg.Rate = cfg.Rate;
+  load_cfg.DurationMs = cfg.Duration * 1000;
+  load_cfg.MsgCount = cfg.CountSpecified ? cfg.Count : 0;
+  bool read_counts = (cfg.StatusPort != 0);
+  TDoryMsgCounts before;
+
+  if (read_counts) {
+    read_counts = TryReadDoryMsgCounts(cfg.StatusPort, before);
+  }
+
+  uint64_t start_us = GetMonotonicRawMicroseconds();
+  TLoadGenerator generator(load_cfg);
+  generator.Start();
+  TLoadGenerator::TResult result = generator.Join();
+
+  for (const std::string &error : result.Errors) {
+    std::cerr << "error: " << error << std::endl;
+  }
+
+  const THistogram &latency = result.SendLatencyNs;
+  std::cout << "sent: " << result.MsgsSent << " messages, "
+      << result.BytesSent << " bytes in " << (result.ElapsedUs / 1000)
+      << " ms" << std::endl
+      << "send errors: " << result.SendErrors << std::endl
+      << "send rate: " << PerSecond(result.MsgsSent, result.ElapsedUs)
+      << " messages/s, " << PerSecond(result.BytesSent, result.ElapsedUs)
+      << " bytes/s" << std::endl
+      << "client CPU: " << (result.ClientCpuUs / 1000) << " ms" << std::endl
+      << "send latency (ns): mean " << latency.GetMean() << ", p50 "
+      << latency.GetPercentile(50.0) << ", p90 "
+      << latency.GetPercentile(90.0) << ", p99 "
+      << latency.GetPercentile(99.0) << ", p99.9 "
+      << latency.GetPercentile(99.9) << ", max " << latency.GetMax()
+      << std::endl;
+
+  if (read_counts) {
+    /* Wait for Dory to account for all of the messages we sent. */
+    uint64_t deadline_us =
+        GetMonotonicRawMicroseconds() + (cfg.DrainTimeout * 1000000);
+    uint64_t delivered = 0;
+    uint64_t discarded = 0;
+    uint64_t finish_us = 0;
+
+    for (; ; ) {
+      TDoryMsgCounts after;
+
+      if (!TryReadDoryMsgCounts(cfg.StatusPort, after)) {
+        return EXIT_FAILURE;
+      }
+
+      finish_us = GetMonotonicRawMicroseconds();
+      delivered = CountDelta(before.Delivered, after.Delivered);
+      discarded = CountDelta(before.Discarded, after.Discarded);
+
+      if (((delivered + discarded) >= result.MsgsSent) ||
+          (finish_us >= deadline_us)) {
+        break;
+      }
+
+      SleepMilliseconds(100);
+    }
+
+    uint64_t accounted = delivered + discarded;
+    std::cout << "Dory delivered: " << delivered << " messages" << std::endl
+        << "Dory discarded: " << discarded << " messages" << std::endl
+        << "unaccounted for: "
+        << ((result.MsgsSent > accounted) ?
+            (result.MsgsSent - accounted) : 0)
+        << " messages" << std::endl
+        << "delivery rate: " << PerSecond(delivered, finish_us - start_us)
+        << " messages/s" << std::endl;
+  }
+
+  return result.Errors.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int to_dory_main(int argc, char **argv) {
   std::unique_ptr<TConfig> cfg;
 
@@ -341,6 +595,10 @@ int to_dory_main(int argc, char **argv) {
     return EXIT_FAILURE;
   }
 
+  if (cfg->Load) {
+    return RunLoad(*cfg);
+  }
+
   std::unique_ptr<TClientSenderBase> sender(CreateSender(*cfg));
   sender->PrepareToSend();
   std::vector<uint8_t> dg_buf;
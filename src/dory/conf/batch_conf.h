@@ -54,6 +54,10 @@ namespace Dory {
         Base::TOpt<size_t> OptMsgCount;
 
         Base::TOpt<size_t> OptByteCount;
+
+        /* This is also unknown if the config file omits the setting, since
+           it is optional. */
+        Base::TOpt<size_t> OptLatencyBudget;
       };  // TBatchValues
 
       struct TTopicConf {
@@ -90,7 +90,11 @@ void TConf::TBuilder::ProcessSingleBatchingNamedConfig(
       TOpts::TRIM_WHITESPACE | TOpts::THROW_IF_EMPTY);
   RequireAllChildElementLeaves(config_elem);
   auto subsection_map = GetSubsectionElements(config_elem,
-      {{"time", true}, {"messages", true}, {"bytes", true}}, false);
+      {
+        {"time", true}, {"messages", true}, {"bytes", true},
+        {"latencyBudget", false}
+      },
+      false);
   TBatchConf::TBatchValues values;
   values.OptTimeLimit = TAttrReader::GetOptInt2<size_t>(
       *subsection_map["time"], "value", "disable",
@@ -102,8 +106,15 @@ void TConf::TBuilder::ProcessSingleBatchingNamedConfig(
       *subsection_map["bytes"], "value", "disable",
       TOpts::REQUIRE_PRESENCE | TOpts::STRICT_EMPTY_VALUE | TOpts::ALLOW_K);
 
+  if (subsection_map.count("latencyBudget")) {
+    values.OptLatencyBudget = TAttrReader::GetOptInt2<size_t>(
+        *subsection_map["latencyBudget"], "value", "disable",
+        TOpts::REQUIRE_PRESENCE | TOpts::STRICT_EMPTY_VALUE);
+  }
+
   if (values.OptTimeLimit.IsUnknown() && values.OptMsgCount.IsUnknown() &&
-      values.OptByteCount.IsUnknown()) {
+      values.OptByteCount.IsUnknown() &&
+      values.OptLatencyBudget.IsUnknown()) {
     std::string msg("Named batching config [");
     msg += name;
     msg += "] must not have a setting of [disable] for all values";
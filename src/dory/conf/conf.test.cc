@@ -69,6 +69,7 @@ namespace {
         << "                <time value=\"50\" />" << std::endl
         << "                <messages value=\"100\" />" << std::endl
         << "                <bytes value=\"200\" />" << std::endl
+        << "                <latencyBudget value=\"40\" />" << std::endl
         << "            </config>" << std::endl
         << "            <config name=\"config2\">" << std::endl
         << "                <time value=\"5\" />" << std::endl
@@ -160,6 +161,8 @@ namespace {
     ASSERT_EQ(*values.OptMsgCount, 100U);
     ASSERT_TRUE(values.OptByteCount.IsKnown());
     ASSERT_EQ(*values.OptByteCount, 200U);
+    ASSERT_TRUE(values.OptLatencyBudget.IsKnown());
+    ASSERT_EQ(*values.OptLatencyBudget, 40U);
     ASSERT_TRUE(batch_conf.GetDefaultTopicAction() ==
         TBatchConf::TTopicAction::PerTopic);
     values = batch_conf.GetDefaultTopicConfig();
@@ -168,6 +171,7 @@ namespace {
     ASSERT_FALSE(values.OptMsgCount.IsKnown());
     ASSERT_TRUE(values.OptByteCount.IsKnown());
     ASSERT_EQ(*values.OptByteCount, 20U * 1024U);
+    ASSERT_FALSE(values.OptLatencyBudget.IsKnown());
 
     const TBatchConf::TTopicMap &topic_map = batch_conf.GetTopicConfigs();
     ASSERT_EQ(topic_map.size(), 2U);
@@ -183,6 +187,8 @@ namespace {
     ASSERT_EQ(*values.OptMsgCount, 100U);
     ASSERT_TRUE(values.OptByteCount.IsKnown());
     ASSERT_EQ(*values.OptByteCount, 200U);
+    ASSERT_TRUE(values.OptLatencyBudget.IsKnown());
+    ASSERT_EQ(*values.OptLatencyBudget, 40U);
 
     iter = topic_map.find("topic2");
     ASSERT_TRUE(iter != topic_map.end());
@@ -194,6 +200,7 @@ namespace {
     ASSERT_FALSE(values.OptMsgCount.IsKnown());
     ASSERT_TRUE(values.OptByteCount.IsKnown());
     ASSERT_EQ(*values.OptByteCount, 20U * 1024U);
+    ASSERT_FALSE(values.OptLatencyBudget.IsKnown());
 
     const TCompressionConf &compression_conf = conf.GetCompressionConf();
     ASSERT_EQ(compression_conf.GetSizeThresholdPercent(), 75U);
@@ -71,6 +71,33 @@ static void ProcessModeArg(const std::string &mode_string,
   }
 }
 
+static void ProcessPoolOccupancyLogThresholdsArg(const std::string &arg,
+    std::vector<size_t> &result) {
+  result.clear();
+  std::string s(arg);
+  boost::algorithm::trim(s);
+
+  if (s.empty()) {
+    return;
+  }
+
+  std::vector<std::string> items;
+  boost::algorithm::split(items, s, boost::algorithm::is_any_of(","));
+
+  for (std::string &item : items) {
+    boost::algorithm::trim(item);
+    char *pos = nullptr;
+    long n = item.empty() ? 0 : std::strtol(item.c_str(), &pos, 10);
+
+    if (item.empty() || (*pos != '\0') || (n < 1) || (n > 100)) {
+      throw TArgParseError("Invalid value for --pool_occupancy_log_thresholds: "
+          "expected comma-separated list of percentages from 1 to 100");
+    }
+
+    result.push_back(static_cast<size_t>(n));
+  }
+}
+
 static void ParseArgs(int argc, char *argv[], TConfig &config,
     bool allow_input_bind_ephemeral) {
   using namespace TCLAP;
@@ -122,11 +149,15 @@ static void ParseArgs(int argc, char *argv[], TConfig &config,
     cmd.add(arg_receive_stream_socket_mode);
     ValueArg<std::remove_reference<decltype(*config.MetadataApiVersion)>::type>
         arg_metadata_api_version("", "metadata_api_version",
-        "Version of Kafka metadata API to use.", false, 0, "VERSION");
+        "Version of Kafka metadata API to use.  If unspecified, the highest "
+        "version supported by both Dory and the broker is negotiated.", false,
+        0, "VERSION");
     cmd.add(arg_metadata_api_version);
     ValueArg<std::remove_reference<decltype(*config.ProduceApiVersion)>::type>
         arg_produce_api_version("", "produce_api_version",
-        "Version of Kafka produce API to use.", false, 0, "VERSION");
+        "Version of Kafka produce API to use.  If unspecified, the highest "
+        "version supported by both Dory and the broker is negotiated.", false,
+        0, "VERSION");
     cmd.add(arg_produce_api_version);
     ValueArg<decltype(config.StatusPort)> arg_status_port("", "status_port",
         "HTTP Status monitoring port.", false, config.StatusPort, "PORT");
@@ -138,6 +169,13 @@ static void ParseArgs(int argc, char *argv[], TConfig &config,
         "msg_buffer_max", "Maximum amount of memory in Kb to use for "
         "buffering messages.", true, config.MsgBufferMax, "MAX_KB");
     cmd.add(arg_msg_buffer_max);
+    ValueArg<std::string> arg_pool_occupancy_log_thresholds("",
+        "pool_occupancy_log_thresholds", "Comma-separated list of percentages "
+        "of message buffer space (for instance, 50,75,90).  A message is "
+        "logged whenever buffer usage rises to or falls below one of these "
+        "levels.  By default, no such messages are logged.", false, "",
+        "PERCENTS");
+    cmd.add(arg_pool_occupancy_log_thresholds);
     ValueArg<decltype(config.MaxInputMsgSize)> arg_max_input_msg_size("",
         "max_input_msg_size", "Maximum input message size in bytes expected "
         "from clients sending UNIX domain datagrams.  This limit does NOT "
@@ -206,6 +244,77 @@ static void ParseArgs(int argc, char *argv[], TConfig &config,
         "communicating with Kafka broker.", false, config.KafkaSocketTimeout,
         "TIMEOUT_SECONDS");
     cmd.add(arg_kafka_socket_timeout);
+    ValueArg<decltype(config.ConnectionsPerBroker)>
+        arg_connections_per_broker("", "connections_per_broker", "Number of "
+        "TCP connections to open to each Kafka broker.  Each connection has "
+        "its own thread.  Messages for a given partition always use the same "
+        "connection, so per-partition ordering is preserved.", false,
+        config.ConnectionsPerBroker, "COUNT");
+    cmd.add(arg_connections_per_broker);
+    SwitchArg arg_no_sticky_partitioning("", "no_sticky_partitioning",
+        "Choose a broker for each message without a partition key by "
+        "round-robin selection, rather than sending a topic's messages to one "
+        "broker until it sends a produce request.", cmd,
+        config.NoStickyPartitioning);
+    SwitchArg arg_no_adaptive_broker_selection("",
+        "no_adaptive_broker_selection", "When choosing a broker for messages "
+        "without a partition key, use plain round-robin selection rather than "
+        "preferring brokers with less backlog and lower ACK latency.", cmd,
+        config.NoAdaptiveBrokerSelection);
+    SwitchArg arg_batch_auto_tune("", "batch_auto_tune", "Adjust the batching "
+        "time and byte limits for topics that undergo per-topic batching, "
+        "based on observed message arrival rates and ACK latency.", cmd,
+        config.BatchAutoTune);
+    ValueArg<decltype(config.BatchAutoTuneTargetBytes)>
+        arg_batch_auto_tune_target_bytes("", "batch_auto_tune_target_bytes",
+        "Amount of message data per batch that batch auto-tuning aims for.",
+        false, config.BatchAutoTuneTargetBytes, "BYTES");
+    cmd.add(arg_batch_auto_tune_target_bytes);
+    ValueArg<decltype(config.BatchAutoTuneMinTime)>
+        arg_batch_auto_tune_min_time("", "batch_auto_tune_min_time",
+        "Minimum batching time limit in milliseconds chosen by batch "
+        "auto-tuning.", false, config.BatchAutoTuneMinTime, "MS");
+    cmd.add(arg_batch_auto_tune_min_time);
+    ValueArg<decltype(config.BatchAutoTuneMaxTime)>
+        arg_batch_auto_tune_max_time("", "batch_auto_tune_max_time",
+        "Maximum batching time limit in milliseconds chosen by batch "
+        "auto-tuning.", false, config.BatchAutoTuneMaxTime, "MS");
+    cmd.add(arg_batch_auto_tune_max_time);
+    ValueArg<decltype(config.BatchAutoTuneInterval)>
+        arg_batch_auto_tune_interval("", "batch_auto_tune_interval",
+        "Interval in milliseconds between batch auto-tuning adjustments.",
+        false, config.BatchAutoTuneInterval, "MS");
+    cmd.add(arg_batch_auto_tune_interval);
+    ValueArg<decltype(config.MetadataFetchParallelCount)>
+        arg_metadata_fetch_parallel_count("", "metadata_fetch_parallel_count",
+        "Number of brokers to send metadata requests to at the same time.  "
+        "The first valid response is used.", false,
+        config.MetadataFetchParallelCount, "COUNT");
+    cmd.add(arg_metadata_fetch_parallel_count);
+    ValueArg<decltype(config.MetadataHedgePercentile)>
+        arg_metadata_hedge_percentile("", "metadata_hedge_percentile", "If no "
+        "broker has responded to a metadata request within this percentile "
+        "of recent metadata fetch times, send a request to an additional "
+        "broker.", false, config.MetadataHedgePercentile, "PERCENTILE");
+    cmd.add(arg_metadata_hedge_percentile);
+    ValueArg<decltype(config.MetadataHedgeMinDelay)>
+        arg_metadata_hedge_min_delay("", "metadata_hedge_min_delay",
+        "Minimum delay in milliseconds before sending a metadata request to "
+        "an additional broker when no response has been received.  0 "
+        "disables this behavior.", false, config.MetadataHedgeMinDelay,
+        "MIN_DELAY_MS");
+    cmd.add(arg_metadata_hedge_min_delay);
+    SwitchArg arg_topic_scoped_metadata("", "topic_scoped_metadata", "Only "
+        "request metadata for topics that Dory has gotten messages for, "
+        "rather than for all topics.  Metadata for a new topic is requested "
+        "when its first message arrives.", cmd, config.TopicScopedMetadata);
+    ValueArg<decltype(config.MetadataCacheFile)> arg_metadata_cache_file("",
+        "metadata_cache_file", "Pathname of file where Dory saves the most "
+        "recent metadata it got from Kafka.  On startup, Dory routes messages "
+        "using the saved metadata while it fetches new metadata in the "
+        "background.  If unspecified, metadata is not saved.", false,
+        config.MetadataCacheFile, "PATH");
+    cmd.add(arg_metadata_cache_file);
     ValueArg<decltype(config.PauseRateLimitInitial)>
         arg_pause_rate_limit_initial("", "pause_rate_limit_initial", "Initial "
         "delay value in milliseconds between consecutive metadata fetches due "
@@ -223,6 +332,10 @@ static void ParseArgs(int argc, char *argv[], TConfig &config,
         "metadata from Kafka in response to an error.", false,
         config.MinPauseDelay, "MIN_DELAY_MS");
     cmd.add(arg_min_pause_delay);
+    SwitchArg arg_global_pause("", "global_pause", "When an error occurs on "
+        "a connection to a Kafka broker, shut down the connections to all "
+        "brokers while fetching new metadata, rather than only the connection "
+        "with the error.", cmd, config.GlobalPause);
     ValueArg<decltype(config.DiscardReportInterval)>
         arg_discard_report_interval("", "discard_report_interval",
         "Discard reporting interval in seconds.", false,
@@ -243,6 +356,15 @@ static void ParseArgs(int argc, char *argv[], TConfig &config,
         "msg_debug_byte_limit", "Message debugging byte limit.", false,
         config.MsgDebugByteLimit, "MAX_BYTES");
     cmd.add(arg_msg_debug_byte_limit);
+    ValueArg<decltype(config.TraceBufferSize)> arg_trace_buffer_size("",
+        "trace_buffer_size", "Number of recent events to keep for each thread "
+        "in the event trace available from the web interface.  Specify 0 to "
+        "disable event tracing.", false, config.TraceBufferSize, "EVENTS");
+    cmd.add(arg_trace_buffer_size);
+    SwitchArg arg_topic_latency_stats("", "topic_latency_stats", "Keep "
+        "message latency histograms for each topic, in addition to those for "
+        "all topics combined and for each broker.", cmd,
+        config.TopicLatencyStats);
     SwitchArg arg_skip_compare_metadata_on_refresh("",
         "skip_compare_metadata_on_refresh", "On metadata refresh, don't "
         "compare new metadata to old metadata.  Always replace the metadata "
@@ -325,6 +447,9 @@ static void ParseArgs(int argc, char *argv[], TConfig &config,
     config.StatusPort = arg_status_port.getValue();
     config.StatusLoopbackOnly = arg_status_loopback_only.getValue();
     config.MsgBufferMax = arg_msg_buffer_max.getValue();
+    ProcessPoolOccupancyLogThresholdsArg(
+        arg_pool_occupancy_log_thresholds.getValue(),
+        config.PoolOccupancyLogThresholds);
     config.MaxInputMsgSize = arg_max_input_msg_size.getValue();
     config.MaxStreamInputMsgSize = arg_max_stream_input_msg_size.getValue();
     config.AllowLargeUnixDatagrams = arg_allow_large_unix_datagrams.getValue();
@@ -347,15 +472,34 @@ static void ParseArgs(int argc, char *argv[], TConfig &config,
         arg_dispatcher_restart_max_delay.getValue();
     config.MetadataRefreshInterval = arg_metadata_refresh_interval.getValue();
     config.KafkaSocketTimeout = arg_kafka_socket_timeout.getValue();
+    config.ConnectionsPerBroker = arg_connections_per_broker.getValue();
+    config.NoStickyPartitioning = arg_no_sticky_partitioning.getValue();
+    config.NoAdaptiveBrokerSelection =
+        arg_no_adaptive_broker_selection.getValue();
+    config.BatchAutoTune = arg_batch_auto_tune.getValue();
+    config.BatchAutoTuneTargetBytes =
+        arg_batch_auto_tune_target_bytes.getValue();
+    config.BatchAutoTuneMinTime = arg_batch_auto_tune_min_time.getValue();
+    config.BatchAutoTuneMaxTime = arg_batch_auto_tune_max_time.getValue();
+    config.BatchAutoTuneInterval = arg_batch_auto_tune_interval.getValue();
+    config.MetadataFetchParallelCount =
+        arg_metadata_fetch_parallel_count.getValue();
+    config.MetadataHedgePercentile = arg_metadata_hedge_percentile.getValue();
+    config.MetadataHedgeMinDelay = arg_metadata_hedge_min_delay.getValue();
+    config.TopicScopedMetadata = arg_topic_scoped_metadata.getValue();
+    config.MetadataCacheFile = arg_metadata_cache_file.getValue();
     config.PauseRateLimitInitial = arg_pause_rate_limit_initial.getValue();
     config.PauseRateLimitMaxDouble =
         arg_pause_rate_limit_max_double.getValue();
     config.MinPauseDelay = arg_min_pause_delay.getValue();
+    config.GlobalPause = arg_global_pause.getValue();
     config.DiscardReportInterval = arg_discard_report_interval.getValue();
     config.NoLogDiscard = arg_no_log_discard.getValue();
     config.DebugDir = arg_debug_dir.getValue();
     config.MsgDebugTimeLimit = arg_msg_debug_time_limit.getValue();
     config.MsgDebugByteLimit = arg_msg_debug_byte_limit.getValue();
+    config.TraceBufferSize = arg_trace_buffer_size.getValue();
+    config.TopicLatencyStats = arg_topic_latency_stats.getValue();
     config.SkipCompareMetadataOnRefresh =
         arg_skip_compare_metadata_on_refresh.getValue();
     config.DiscardLogPath = arg_discard_log_path.getValue();
@@ -399,6 +543,21 @@ static void ParseArgs(int argc, char *argv[], TConfig &config,
   if (config.StatusPort < 1) {
     throw TArgParseError("Invalid value specified for option --status_port.");
   }
+
+  if (config.ConnectionsPerBroker < 1) {
+    throw TArgParseError(
+        "Invalid value specified for option --connections_per_broker.");
+  }
+
+  if (config.MetadataFetchParallelCount < 1) {
+    throw TArgParseError("Invalid value specified for option "
+        "--metadata_fetch_parallel_count.");
+  }
+
+  if (config.MetadataHedgePercentile > 100) {
+    throw TArgParseError(
+        "Invalid value specified for option --metadata_hedge_percentile.");
+  }
 }
 
 TConfig::TConfig(int argc, char *argv[], bool allow_input_bind_ephemeral)
@@ -419,14 +578,29 @@ TConfig::TConfig(int argc, char *argv[], bool allow_input_bind_ephemeral)
       DispatcherRestartMaxDelay(5000),
       MetadataRefreshInterval(15),
       KafkaSocketTimeout(60),
+      ConnectionsPerBroker(1),
+      NoStickyPartitioning(false),
+      NoAdaptiveBrokerSelection(false),
+      BatchAutoTune(false),
+      BatchAutoTuneTargetBytes(65536),
+      BatchAutoTuneMinTime(1),
+      BatchAutoTuneMaxTime(1000),
+      BatchAutoTuneInterval(5000),
+      MetadataFetchParallelCount(1),
+      MetadataHedgePercentile(95),
+      MetadataHedgeMinDelay(1000),
+      TopicScopedMetadata(false),
       PauseRateLimitInitial(5000),
       PauseRateLimitMaxDouble(4),
       MinPauseDelay(5000),
+      GlobalPause(false),
       DiscardReportInterval(600),
       NoLogDiscard(false),
       DebugDir("/home/dory/debug"),
       MsgDebugTimeLimit(3600),
       MsgDebugByteLimit(2UL * 1024UL * 1024UL * 1024UL),
+      TraceBufferSize(4096),
+      TopicLatencyStats(false),
       SkipCompareMetadataOnRefresh(false),
       DiscardLogMaxFileSize(1024),
       DiscardLogMaxArchiveSize(8 * 1024),
@@ -512,6 +686,24 @@ void Dory::LogConfig(const TConfig &config) {
          config.StatusLoopbackOnly ? "true" : "false");
   syslog(LOG_NOTICE, "Buffered message limit %lu kbytes",
          static_cast<unsigned long>(config.MsgBufferMax));
+
+  if (config.PoolOccupancyLogThresholds.empty()) {
+    syslog(LOG_NOTICE, "Buffer pool occupancy logging disabled");
+  } else {
+    std::string thresholds;
+
+    for (size_t percent : config.PoolOccupancyLogThresholds) {
+      if (!thresholds.empty()) {
+        thresholds += ",";
+      }
+
+      thresholds += std::to_string(percent);
+    }
+
+    syslog(LOG_NOTICE, "Buffer pool occupancy log thresholds (percent): %s",
+           thresholds.c_str());
+  }
+
   syslog(LOG_NOTICE, "Max datagram input message size %lu bytes",
          static_cast<unsigned long>(config.MaxInputMsgSize));
   syslog(LOG_NOTICE, "Max stream input message size %lu bytes",
@@ -539,12 +731,48 @@ void Dory::LogConfig(const TConfig &config) {
          static_cast<unsigned long>(config.MetadataRefreshInterval));
   syslog(LOG_NOTICE, "Kafka socket timeout %lu seconds",
          static_cast<unsigned long>(config.KafkaSocketTimeout));
+  syslog(LOG_NOTICE, "Connections per broker %lu",
+         static_cast<unsigned long>(config.ConnectionsPerBroker));
+  syslog(LOG_NOTICE, "Sticky partitioning: %s",
+         config.NoStickyPartitioning ? "false" : "true");
+  syslog(LOG_NOTICE, "Adaptive broker selection: %s",
+         config.NoAdaptiveBrokerSelection ? "false" : "true");
+  syslog(LOG_NOTICE, "Batch auto-tuning: %s",
+         config.BatchAutoTune ? "true" : "false");
+
+  if (config.BatchAutoTune) {
+    syslog(LOG_NOTICE, "Batch auto-tuning target %lu bytes, time limit %lu-%lu "
+           "milliseconds, interval %lu milliseconds",
+           static_cast<unsigned long>(config.BatchAutoTuneTargetBytes),
+           static_cast<unsigned long>(config.BatchAutoTuneMinTime),
+           static_cast<unsigned long>(config.BatchAutoTuneMaxTime),
+           static_cast<unsigned long>(config.BatchAutoTuneInterval));
+  }
+
+  syslog(LOG_NOTICE, "Metadata fetch parallel count %lu",
+         static_cast<unsigned long>(config.MetadataFetchParallelCount));
+  syslog(LOG_NOTICE, "Metadata hedge percentile %lu",
+         static_cast<unsigned long>(config.MetadataHedgePercentile));
+  syslog(LOG_NOTICE, "Metadata hedge minimum delay %lu milliseconds",
+         static_cast<unsigned long>(config.MetadataHedgeMinDelay));
+  syslog(LOG_NOTICE, "Topic-scoped metadata: %s",
+         config.TopicScopedMetadata ? "true" : "false");
+
+  if (config.MetadataCacheFile.empty()) {
+    syslog(LOG_NOTICE, "Metadata cache file is disabled");
+  } else {
+    syslog(LOG_NOTICE, "Metadata cache file: [%s]",
+           config.MetadataCacheFile.c_str());
+  }
+
   syslog(LOG_NOTICE, "Pause rate limit initial %lu milliseconds",
          static_cast<unsigned long>(config.PauseRateLimitInitial));
   syslog(LOG_NOTICE, "Pause rate limit max double %lu",
          static_cast<unsigned long>(config.PauseRateLimitMaxDouble));
   syslog(LOG_NOTICE, "Minimum pause delay %lu milliseconds",
          static_cast<unsigned long>(config.MinPauseDelay));
+  syslog(LOG_NOTICE, "Global pause: %s",
+         config.GlobalPause ? "true" : "false");
   syslog(LOG_NOTICE, "Discard reporting interval %lu seconds",
          static_cast<unsigned long>(config.DiscardReportInterval));
   syslog(LOG_NOTICE, "Debug directory [%s]", config.DebugDir.c_str());
@@ -552,6 +780,10 @@ void Dory::LogConfig(const TConfig &config) {
          static_cast<unsigned long>(config.MsgDebugTimeLimit));
   syslog(LOG_NOTICE, "Message debug byte limit %lu",
          static_cast<unsigned long>(config.MsgDebugByteLimit));
+  syslog(LOG_NOTICE, "Event trace buffer size %lu events per thread",
+         static_cast<unsigned long>(config.TraceBufferSize));
+  syslog(LOG_NOTICE, "Per-topic latency stats: %s",
+         config.TopicLatencyStats ? "true" : "false");
   syslog(LOG_NOTICE, "Skip comparing metadata on refresh: %s",
          config.SkipCompareMetadataOnRefresh ? "true" : "false");
 
@@ -24,6 +24,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include <netinet/in.h>
 #include <sys/stat.h>
@@ -65,6 +66,10 @@ namespace Dory {
 
     size_t MsgBufferMax;
 
+    /* Percentages of the message buffer pool that, when crossed, cause a log
+       message.  Empty means no occupancy logging. */
+    std::vector<size_t> PoolOccupancyLogThresholds;
+
     size_t MaxInputMsgSize;
 
     size_t MaxStreamInputMsgSize;
@@ -91,12 +96,40 @@ namespace Dory {
 
     size_t KafkaSocketTimeout;
 
+    size_t ConnectionsPerBroker;
+
+    bool NoStickyPartitioning;
+
+    bool NoAdaptiveBrokerSelection;
+
+    bool BatchAutoTune;
+
+    size_t BatchAutoTuneTargetBytes;
+
+    size_t BatchAutoTuneMinTime;
+
+    size_t BatchAutoTuneMaxTime;
+
+    size_t BatchAutoTuneInterval;
+
+    size_t MetadataFetchParallelCount;
+
+    size_t MetadataHedgePercentile;
+
+    size_t MetadataHedgeMinDelay;
+
+    bool TopicScopedMetadata;
+
+    std::string MetadataCacheFile;
+
     size_t PauseRateLimitInitial;
 
     size_t PauseRateLimitMaxDouble;
 
     size_t MinPauseDelay;
 
+    bool GlobalPause;
+
     size_t DiscardReportInterval;
 
     bool NoLogDiscard;
@@ -107,6 +140,14 @@ namespace Dory {
 
     size_t MsgDebugByteLimit;
 
+    /* Number of events in each thread's event trace ring.  0 disables event
+       tracing. */
+    size_t TraceBufferSize;
+
+    /* Keep message latency histograms per topic, and not just for all topics
+       combined and per broker. */
+    bool TopicLatencyStats;
+
     bool SkipCompareMetadataOnRefresh;
 
     std::string DiscardLogPath;
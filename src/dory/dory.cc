@@ -33,6 +33,7 @@
 #include <unistd.h>
 #include <xercesc/util/XMLException.hpp>
 
+#include <base/crc.h>
 #include <base/opt.h>
 #include <dory/dory_server.h>
 #include <dory/build_id.h>
@@ -158,6 +159,7 @@ static int DoryMain(int argc, char *argv[]) {
 
   syslog(LOG_NOTICE, "Pool block size is %lu bytes",
          static_cast<unsigned long>(dory->GetPoolBlockSize()));
+  syslog(LOG_NOTICE, "Using %s CRC32 implementation", GetCrc32ImplName());
   return dory->Run();
 }
 
@@ -26,6 +26,7 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <sstream>
@@ -130,6 +131,14 @@ namespace {
       TcpInputActive = true;
     }
 
+    /* Pass additional command line arguments to Dory.  This must be called
+       before SyncStart(). */
+    void AddArgs(const std::vector<std::string> &args) {
+      assert(this);
+      assert(!IsStarted());
+      ExtraArgs.insert(ExtraArgs.end(), args.begin(), args.end());
+    }
+
     const char *GetUnixDgSocketName() const {
       assert(this);
 
@@ -209,6 +218,8 @@ namespace {
 
     std::string DoryConf;
 
+    std::vector<std::string> ExtraArgs;
+
     int DoryReturnValue;
 
     std::unique_ptr<TDoryServer> Dory;
@@ -256,6 +267,11 @@ namespace {
     args.push_back("--log_level");
     args.push_back("LOG_INFO");
     // args.push_back("--log_echo");
+
+    for (const std::string &arg : ExtraArgs) {
+      args.push_back(arg.c_str());
+    }
+
     args.push_back(nullptr);
 
     TOpt<TDoryServer::TServerConfig> dory_config;
@@ -575,6 +591,260 @@ namespace {
     ASSERT_EQ(server.GetDoryReturnValue(), EXIT_SUCCESS);
   }
 
+  /* Return the number of messages sent on each (broker ID, connection index)
+     pair, according to the per-connection statistics. */
+  std::map<std::pair<int32_t, size_t>, uint64_t>
+  GetMsgsSentByConnection(const TDoryServer &dory) {
+    std::map<std::pair<int32_t, size_t>, uint64_t> result;
+
+    for (const auto &info : dory.GetConnectionStats().GetInfo()) {
+      result[std::make_pair(info.BrokerId, info.ConnectionIndex)] =
+          info.MsgsSent;
+    }
+
+    return result;
+  }
+
+  TEST_F(TDoryTest, MultipleConnectionsTest) {
+    std::string topic("scooby_doo");
+    std::vector<std::string> kafka_config;
+    CreateKafkaConfig(2, topic.c_str(), 2, kafka_config);
+    TMockKafkaConfig kafka(kafka_config);
+    kafka.StartKafka();
+    Dory::MockKafkaServer::TMainThread &mock_kafka = *kafka.MainThread;
+    in_port_t port = mock_kafka.VirtualPortToPhys(10000);
+    assert(port);
+    TDoryTestServer server(port, 1024, CreateSimpleDoryConf(port));
+    server.UseUnixDgSocket();
+    server.AddArgs({"--connections_per_broker", "3"});
+    bool started = server.SyncStart();
+    ASSERT_TRUE(started);
+    TDoryServer *dory = server.GetDory();
+    TDoryClientSocket sock;
+    int ret = sock.Bind(server.GetUnixDgSocketName());
+    ASSERT_EQ(ret, DORY_OK);
+    std::vector<uint8_t> dg_buf;
+
+    /* Send keyed messages for a single partition in a burst.  These must all
+       go out on one connection, in order. */
+    const size_t keyed_count = 20;
+    const std::string keyed_prefix("keyed ");
+
+    for (size_t i = 0; i < keyed_count; ++i) {
+      std::string body(keyed_prefix);
+      body += boost::lexical_cast<std::string>(i);
+      size_t dg_size = 0;
+      ret = dory_find_partition_key_msg_size(topic.size(), 0, body.size(),
+          &dg_size);
+      ASSERT_EQ(ret, DORY_OK);
+      dg_buf.resize(dg_size);
+      ret = dory_write_partition_key_msg(&dg_buf[0], dg_buf.size(), 0,
+          topic.c_str(), GetEpochMilliseconds(), nullptr, 0, body.data(),
+          body.size());
+      ASSERT_EQ(ret, DORY_OK);
+      ret = sock.Send(&dg_buf[0], dg_buf.size());
+      ASSERT_EQ(ret, DORY_OK);
+    }
+
+    for (size_t i = 0; (dory->GetAckCount() < keyed_count) && (i < 3000);
+         ++i) {
+      SleepMilliseconds(10);
+    }
+
+    ASSERT_EQ(dory->GetAckCount(), keyed_count);
+    using TTracker = TReceivedRequestTracker;
+    std::list<TTracker::TRequestInfo> received;
+    std::vector<size_t> keyed_first_msgs;
+    size_t keyed_msgs_received = 0;
+
+    for (size_t i = 0;
+         (keyed_msgs_received < keyed_count) && (i < 3000);
+         ++i) {
+      mock_kafka.NonblockingGetHandledRequests(received);
+
+      for (auto &item : received) {
+        if (item.ProduceRequestInfo.IsKnown()) {
+          const TTracker::TProduceRequestInfo &info = *item.ProduceRequestInfo;
+          ASSERT_EQ(info.Topic, topic);
+          ASSERT_EQ(info.ReturnedErrorCode, 0);
+          ASSERT_EQ(info.FirstMsgValue.compare(0, keyed_prefix.size(),
+              keyed_prefix), 0);
+          keyed_first_msgs.push_back(boost::lexical_cast<size_t>(
+              info.FirstMsgValue.substr(keyed_prefix.size())));
+          keyed_msgs_received += info.MsgCount;
+        }
+      }
+
+      received.clear();
+      SleepMilliseconds(10);
+    }
+
+    ASSERT_EQ(keyed_msgs_received, keyed_count);
+    ASSERT_FALSE(keyed_first_msgs.empty());
+    ASSERT_EQ(keyed_first_msgs.front(), 0U);
+
+    /* Produce requests for the partition must have arrived in the order the
+       messages were sent. */
+    for (size_t i = 1; i < keyed_first_msgs.size(); ++i) {
+      ASSERT_GT(keyed_first_msgs[i], keyed_first_msgs[i - 1]);
+    }
+
+    auto keyed_stats = GetMsgsSentByConnection(*dory);
+    size_t keyed_conn_count = 0;
+    uint64_t keyed_stats_total = 0;
+
+    for (const auto &item : keyed_stats) {
+      if (item.second) {
+        ++keyed_conn_count;
+        keyed_stats_total += item.second;
+      }
+    }
+
+    ASSERT_EQ(keyed_conn_count, 1U);
+    ASSERT_EQ(keyed_stats_total, keyed_count);
+
+    /* Now send AnyPartition messages in rounds, waiting for each round to be
+       ACKed.  A topic moves to another connection once its current connection
+       has sent a produce request, so a broker that gets several rounds should
+       spread them across its connections. */
+    const size_t round_count = 10;
+    const size_t round_size = 5;
+    size_t expected_ack_count = keyed_count;
+
+    for (size_t round = 0; round < round_count; ++round) {
+      for (size_t i = 0; i < round_size; ++i) {
+        std::string body("msg ");
+        body += boost::lexical_cast<std::string>((round * round_size) + i);
+        MakeDg(dg_buf, topic, body);
+        ret = sock.Send(&dg_buf[0], dg_buf.size());
+        ASSERT_EQ(ret, DORY_OK);
+      }
+
+      expected_ack_count += round_size;
+
+      for (size_t i = 0;
+           (dory->GetAckCount() < expected_ack_count) && (i < 3000);
+           ++i) {
+        SleepMilliseconds(10);
+      }
+
+      ASSERT_EQ(dory->GetAckCount(), expected_ack_count);
+    }
+
+    auto all_stats = GetMsgsSentByConnection(*dory);
+    std::map<int32_t, size_t> broker_conn_counts;
+    uint64_t any_partition_total = 0;
+
+    for (const auto &item : all_stats) {
+      uint64_t keyed_sent = keyed_stats[item.first];
+      ASSERT_GE(item.second, keyed_sent);
+      uint64_t sent = item.second - keyed_sent;
+
+      if (sent) {
+        ++broker_conn_counts[item.first.first];
+        any_partition_total += sent;
+      }
+    }
+
+    ASSERT_EQ(any_partition_total, round_count * round_size);
+    size_t max_conn_count = 0;
+
+    for (const auto &item : broker_conn_counts) {
+      max_conn_count = std::max(max_conn_count, item.second);
+    }
+
+    ASSERT_GT(max_conn_count, 1U);
+
+    TAnomalyTracker::TInfo bad_stuff;
+    dory->GetAnomalyTracker().GetInfo(bad_stuff);
+    ASSERT_EQ(bad_stuff.DiscardTopicMap.size(), 0U);
+    ASSERT_EQ(bad_stuff.DuplicateTopicMap.size(), 0U);
+    ASSERT_EQ(bad_stuff.BadTopics.size(), 0U);
+
+    server.RequestShutdown();
+    server.Join();
+    ASSERT_EQ(server.GetDoryReturnValue(), EXIT_SUCCESS);
+  }
+
+  TEST_F(TDoryTest, ScopedPauseTest) {
+    std::string topic("scooby_doo");
+    std::vector<std::string> kafka_config;
+    CreateKafkaConfig(2, topic.c_str(), 2, kafka_config);
+    TMockKafkaConfig kafka(kafka_config);
+    kafka.StartKafka();
+    Dory::MockKafkaServer::TMainThread &mock_kafka = *kafka.MainThread;
+    in_port_t port = mock_kafka.VirtualPortToPhys(10000);
+    assert(port);
+    TDoryTestServer server(port, 1024, CreateSimpleDoryConf(port));
+    server.UseUnixDgSocket();
+    bool started = server.SyncStart();
+    ASSERT_TRUE(started);
+    TDoryServer *dory = server.GetDory();
+    std::string poison_body("rejected on 1st attempt");
+
+    /* Make the mock Kafka server close the TCP connection to whichever broker
+       gets this message, rather than send an ACK. */
+    bool success = kafka.Inj.InjectDisconnectBeforeAck(poison_body.c_str(),
+                                                       nullptr);
+    ASSERT_TRUE(success);
+
+    TDoryClientSocket sock;
+    int ret = sock.Bind(server.GetUnixDgSocketName());
+    ASSERT_EQ(ret, DORY_OK);
+    std::vector<uint8_t> dg_buf;
+    const size_t msg_count = 20;
+
+    for (size_t i = 0; i < msg_count; ++i) {
+      std::string body("msg ");
+      body += boost::lexical_cast<std::string>(i);
+
+      if (i == (msg_count / 2)) {
+        body = poison_body;
+      }
+
+      MakeDg(dg_buf, topic, body);
+      ret = sock.Send(&dg_buf[0], dg_buf.size());
+      ASSERT_EQ(ret, DORY_OK);
+    }
+
+    for (size_t i = 0; (dory->GetAckCount() < msg_count) && (i < 3000); ++i) {
+      SleepMilliseconds(10);
+    }
+
+    ASSERT_EQ(dory->GetAckCount(), msg_count);
+
+    /* Only the connection that got the injected error should have been shut
+       down and reconnected.  The connection to the other broker must have
+       stayed up the whole time. */
+    std::vector<MsgDispatch::TConnectionStatsTracker::TInfo> info =
+        dory->GetConnectionStats().GetInfo();
+    ASSERT_EQ(info.size(), 2U);
+    size_t reconnected = 0;
+    size_t never_stopped = 0;
+
+    for (const auto &item : info) {
+      ASSERT_TRUE(item.Connected);
+
+      if (item.ConnectCount == 1) {
+        ++never_stopped;
+      } else if (item.ConnectCount == 2) {
+        ++reconnected;
+      }
+    }
+
+    ASSERT_EQ(reconnected, 1U);
+    ASSERT_EQ(never_stopped, 1U);
+
+    TAnomalyTracker::TInfo bad_stuff;
+    dory->GetAnomalyTracker().GetInfo(bad_stuff);
+    ASSERT_EQ(bad_stuff.DiscardTopicMap.size(), 0U);
+    ASSERT_EQ(bad_stuff.BadTopics.size(), 0U);
+
+    server.RequestShutdown();
+    server.Join();
+    ASSERT_EQ(server.GetDoryReturnValue(), EXIT_SUCCESS);
+  }
+
   TEST_F(TDoryTest, KeyValueTest) {
     std::string topic("scooby_doo");
     std::vector<std::string> kafka_config;
@@ -48,6 +48,7 @@
 #include <dory/kafka_proto/metadata/version_util.h>
 #include <dory/kafka_proto/produce/version_util.h>
 #include <dory/msg.h>
+#include <dory/util/event_trace.h>
 #include <dory/util/misc_util.h>
 #include <dory/util/time_util.h>
 #include <dory/web_interface.h>
@@ -199,6 +200,8 @@ TDoryServer::TDoryServer(TServerConfig &&config)
       Pool(PoolBlockSize,
            ComputeBlockCount(Config->MsgBufferMax, PoolBlockSize),
            Capped::TPool::TSync::Mutexed),
+      PoolMonitor(Pool, Config->PoolOccupancyLogThresholds),
+      MsgStateTracker(Config->TopicLatencyStats),
       AnomalyTracker(DiscardFileLogger, Config->DiscardReportInterval,
                      Config->DiscardReportBadMsgPrefixSize),
       StatusPort(0),
@@ -210,6 +213,8 @@ TDoryServer::TDoryServer(TServerConfig &&config)
           config.BatchConfig, DebugSetup, Dispatcher),
       MetadataTimestamp(RouterThread.GetMetadataTimestamp()),
       ShutdownRequested(ATOMIC_FLAG_INIT) {
+  TEventTrace::Init(Config->TraceBufferSize);
+
   if (!Config->ReceiveStreamSocketName.empty() ||
       Config->InputPort.IsKnown()) {
     /* Create thread pool if UNIX stream or TCP input is enabled. */
@@ -328,7 +333,8 @@ int TDoryServer::Run() {
    */
   TWebInterface web_interface(StatusPort, MsgStateTracker, AnomalyTracker,
       MetadataTimestamp, RouterThread.GetMetadataUpdateRequestSem(),
-      DebugSetup);
+      DebugSetup, Dispatcher.GetConnectionStats(),
+      RouterThread.GetBatchAutoTuner(), PoolMonitor);
 
   /* This starts the input agents and router thread but doesn't wait for the
      router thread to finish initialization. */
@@ -488,7 +494,11 @@ void TDoryServer::HandleEvents() {
   TTimerFd discard_query_check_timer(
       1000 * (1 + Config->DiscardReportInterval));
 
-  std::array<struct pollfd, 8> events;
+  /* This is for periodically checking buffer pool occupancy against the
+     configured log thresholds. */
+  TTimerFd pool_occupancy_check_timer(1000);
+
+  std::array<struct pollfd, 9> events;
   struct pollfd &discard_query_check = events[0];
   struct pollfd &unix_dg_input_agent_error = events[1];
   struct pollfd &unix_stream_input_agent_error = events[2];
@@ -497,6 +507,7 @@ void TDoryServer::HandleEvents() {
   struct pollfd &shutdown_request = events[5];
   struct pollfd &worker_pool_worker_error = events[6];
   struct pollfd &worker_pool_fatal_error = events[7];
+  struct pollfd &pool_occupancy_check = events[8];
   discard_query_check.fd = discard_query_check_timer.GetFd();
   discard_query_check.events = POLLIN;
   unix_dg_input_agent_error.fd = UnixDgInputAgent.IsKnown() ?
@@ -523,6 +534,9 @@ void TDoryServer::HandleEvents() {
 
   worker_pool_worker_error.events = POLLIN;
   worker_pool_fatal_error.events = POLLIN;
+  pool_occupancy_check.fd = PoolMonitor.IsThresholdLoggingEnabled() ?
+      int(pool_occupancy_check_timer.GetFd()) : -1;
+  pool_occupancy_check.events = POLLIN;
   bool fatal_error = false;
 
   for (; ; ) {
@@ -585,6 +599,11 @@ void TDoryServer::HandleEvents() {
       AnomalyTracker.CheckGetInfoRate();
     }
 
+    if (pool_occupancy_check.revents) {
+      pool_occupancy_check_timer.Pop();
+      PoolMonitor.CheckThresholds();
+    }
+
     if (shutdown_request.revents) {
       syslog(LOG_NOTICE, "Got shutdown signal while server running");
       break;
@@ -624,7 +643,11 @@ void TDoryServer::DiscardFinalMsgs(std::list<TMsg::TPtr> &msg_list) {
   assert(this);
 
   for (TMsg::TPtr &msg : msg_list) {
-    if (msg) {
+    if (msg && msg->IsFlushRequest()) {
+      /* A flush request carries no message data, so there is nothing to
+         report as discarded. */
+      MsgStateTracker.MsgEnterProcessed(*msg);
+    } else if (msg) {
       if (!Config->NoLogDiscard) {
         static TLogRateLimiter lim(std::chrono::seconds(30));
 
@@ -47,6 +47,7 @@
 #include <dory/metadata_timestamp.h>
 #include <dory/msg_dispatch/kafka_dispatcher.h>
 #include <dory/msg_state_tracker.h>
+#include <dory/pool_monitor.h>
 #include <dory/router_thread.h>
 #include <dory/stream_client_handler.h>
 #include <dory/stream_client_work_fn.h>
@@ -158,6 +159,12 @@ namespace Dory {
       return AnomalyTracker;
     }
 
+    /* Used by test and benchmark code. */
+    const TMsgStateTracker &GetMsgStateTracker() const {
+      assert(this);
+      return MsgStateTracker;
+    }
+
     /* Test code passes true for 'bind_ephemeral'. */
     void BindStatusSocket(bool bind_ephemeral = false);
 
@@ -187,6 +194,12 @@ namespace Dory {
       return Dispatcher.GetAckCount();
     }
 
+    /* This is called by test code. */
+    const MsgDispatch::TConnectionStatsTracker &GetConnectionStats() const {
+      assert(this);
+      return Dispatcher.GetConnectionStats();
+    }
+
     int Run();
 
     /* Called by SIGINT/SIGTERM handler.  Also called by test code to shut down
@@ -248,6 +261,9 @@ namespace Dory {
 
     Capped::TPool Pool;
 
+    /* Tracks occupancy of 'Pool' for the web interface and logging. */
+    TPoolMonitor PoolMonitor;
+
     /* This is declared _before_ the input thread, router thread, and
        dispatcher so it gets destroyed after them.  Its destructor stops
        discard file logging, which we only want to do after everything else
@@ -0,0 +1,426 @@
+/* <dory/hedged_metadata_fetcher.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/hedged_metadata_fetcher.h>.
+ */
+
+#include <dory/hedged_metadata_fetcher.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <syslog.h>
+
+#include <base/error_utils.h>
+#include <base/time_util.h>
+#include <server/counter.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Util;
+
+SERVER_COUNTER(CancelMetadataFetchAttempt);
+SERVER_COUNTER(ConnectFailOnTryGetMetadata);
+SERVER_COUNTER(ConnectSuccessOnTryGetMetadata);
+SERVER_COUNTER(HedgeMetadataFetch);
+SERVER_COUNTER(MetadataFetchAttemptFail);
+SERVER_COUNTER(MetadataFetchAttemptSuccess);
+SERVER_COUNTER(StartMetadataFetchAttempt);
+
+/* Number of recent successful fetch times used for computing the hedge delay.
+ */
+static const size_t RECENT_LATENCY_COUNT = 64;
+
+/* Don't trust the percentile until we have this many samples. */
+static const size_t MIN_LATENCY_SAMPLES = 8;
+
+static std::string BrokerKey(const THostAndPort &broker) {
+  return broker.Host + ":" + std::to_string(broker.Port);
+}
+
+THedgedMetadataFetcher::TAttempt::TAttempt(
+    const TOpt<size_t> &metadata_api_version, const THostAndPort &broker,
+    const std::vector<std::string> &topics, int timeout_ms)
+    : Broker(broker),
+      Topics(topics),
+      TimeoutMs(timeout_ms),
+      Fetcher(metadata_api_version),
+      Cancelled(false),
+      ElapsedMs(0) {
+}
+
+THedgedMetadataFetcher::TAttempt::~TAttempt() noexcept {
+  /* This will shut down the thread if something unexpected happens. */
+  ShutdownOnDestroy();
+}
+
+void THedgedMetadataFetcher::TAttempt::Cancel() {
+  assert(this);
+  std::lock_guard<std::mutex> lock(Mutex);
+  Cancelled = true;
+  CancelSem.Push();
+
+  if (Sock.IsOpen()) {
+    /* Wake up the attempt thread if it is blocked reading or writing. */
+    shutdown(Sock, SHUT_RDWR);
+  }
+}
+
+bool THedgedMetadataFetcher::TAttempt::WasCancelled() const {
+  assert(this);
+  std::lock_guard<std::mutex> lock(Mutex);
+  return Cancelled;
+}
+
+void THedgedMetadataFetcher::TAttempt::Run() {
+  assert(this);
+  uint64_t start_time = GetMonotonicRawMilliseconds();
+  TMetadataFetcher::TDisconnecter disconnecter(Fetcher);
+  syslog(LOG_INFO, "Getting metadata from broker %s port %d",
+         Broker.Host.c_str(), static_cast<int>(Broker.Port));
+
+  if (Fetcher.Connect(Broker.Host, Broker.Port, TimeoutMs,
+      CancelSem.GetFd())) {
+    ConnectSuccessOnTryGetMetadata.Increment();
+    bool cancelled = false;
+
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      cancelled = Cancelled;
+
+      if (!cancelled) {
+        Sock = Fetcher.GetSock();
+      }
+    }
+
+    if (!cancelled) {
+      Result = Fetcher.Fetch(Topics, TimeoutMs);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Sock.Reset();
+    }
+
+    if (Result) {
+      if (Result->SanityCheck()) {
+        syslog(LOG_INFO, "Metadata sanity check passed");
+      } else {
+        syslog(LOG_ERR, "Metadata sanity check failed!!!");
+        Result.reset();
+        assert(false);
+      }
+    } else if (!WasCancelled()) {
+      syslog(LOG_ERR, "Did not get valid metadata response from broker %s "
+             "port %d", Broker.Host.c_str(), static_cast<int>(Broker.Port));
+    }
+  } else {
+    ConnectFailOnTryGetMetadata.Increment();
+
+    if (!WasCancelled()) {
+      syslog(LOG_ERR, "Failed to connect to broker %s port %d for metadata",
+             Broker.Host.c_str(), static_cast<int>(Broker.Port));
+    }
+  }
+
+  ElapsedMs = GetMonotonicRawMilliseconds() - start_time;
+}
+
+THedgedMetadataFetcher::THedgedMetadataFetcher(
+    const TOpt<size_t> &metadata_api_version, size_t parallel_count,
+    size_t hedge_percentile, size_t min_hedge_delay)
+    : MetadataApiVersion(metadata_api_version),
+      ParallelCount(std::max<size_t>(parallel_count, 1)),
+      HedgePercentile(std::min<size_t>(hedge_percentile, 100)),
+      MinHedgeDelay(min_hedge_delay) {
+}
+
+THedgedMetadataFetcher::~THedgedMetadataFetcher() noexcept {
+  ReapCancelledAttempts(true);
+}
+
+std::unique_ptr<TMetadata> THedgedMetadataFetcher::Fetch(
+    const std::vector<THostAndPort> &brokers,
+    const std::vector<std::string> &topics, int timeout_ms, int cancel_fd) {
+  assert(this);
+  assert(!brokers.empty());
+  ReapCancelledAttempts(false);
+  const std::vector<size_t> order = ChooseBrokerOrder(brokers);
+  const uint64_t hedge_delay = ComputeHedgeDelay();
+  const size_t parallel_count = std::min(ParallelCount, order.size());
+  std::vector<std::unique_ptr<TAttempt>> running;
+  std::vector<struct pollfd> poll_vec;
+  std::unique_ptr<TMetadata> result;
+  std::exception_ptr error;
+  bool cancelled = false;
+  size_t next = 0;
+  uint64_t last_start_time = 0;
+
+  for (; ; ) {
+    /* Start attempts until we have the desired number running, replacing any
+       that failed. */
+    while ((running.size() < parallel_count) && (next < order.size())) {
+      const THostAndPort &broker = brokers[order[next++]];
+      StartMetadataFetchAttempt.Increment();
+      running.emplace_back(new TAttempt(MetadataApiVersion, broker,
+          topics, timeout_ms));
+      running.back()->Start();
+      last_start_time = GetMonotonicRawMilliseconds();
+    }
+
+    if (running.empty()) {
+      break;  // all brokers failed
+    }
+
+    int poll_timeout = -1;
+
+    if (hedge_delay && (next < order.size())) {
+      uint64_t hedge_time = last_start_time + hedge_delay;
+      uint64_t now = GetMonotonicRawMilliseconds();
+
+      if (now >= hedge_time) {
+        const THostAndPort &broker = brokers[order[next++]];
+        HedgeMetadataFetch.Increment();
+        syslog(LOG_NOTICE, "No metadata after %lu milliseconds: also trying "
+               "broker %s port %d", static_cast<unsigned long>(hedge_delay),
+               broker.Host.c_str(), static_cast<int>(broker.Port));
+        StartMetadataFetchAttempt.Increment();
+        running.emplace_back(new TAttempt(MetadataApiVersion, broker,
+            topics, timeout_ms));
+        running.back()->Start();
+        last_start_time = now;
+        continue;
+      }
+
+      poll_timeout = static_cast<int>(hedge_time - now);
+    }
+
+    /* The last item is for 'cancel_fd'.  poll() ignores it if 'cancel_fd' is
+       negative. */
+    poll_vec.resize(running.size() + 1);
+
+    for (size_t i = 0; i < running.size(); ++i) {
+      poll_vec[i].fd = running[i]->GetShutdownWaitFd();
+      poll_vec[i].events = POLLIN;
+      poll_vec[i].revents = 0;
+    }
+
+    poll_vec.back().fd = cancel_fd;
+    poll_vec.back().events = POLLIN;
+    poll_vec.back().revents = 0;
+
+    /* Don't check for EINTR, since this thread has signals masked. */
+    IfLt0(poll(&poll_vec[0], poll_vec.size(), poll_timeout));
+
+    if (poll_vec.back().revents) {
+      cancelled = true;
+      break;
+    }
+
+    for (size_t i = running.size(); i > 0; ) {
+      --i;
+
+      if (!poll_vec[i].revents) {
+        continue;
+      }
+
+      std::unique_ptr<TAttempt> attempt(std::move(running[i]));
+      running.erase(running.begin() + i);
+
+      try {
+        attempt->Join();
+      } catch (const Thread::TFdManagedThread::TWorkerError &x) {
+        /* Something unexpected happened.  Rethrow it once the other attempts
+           have been cancelled. */
+        error = x.ThrownException;
+        continue;
+      }
+
+      std::unique_ptr<TMetadata> md = attempt->TakeResult();
+      RecordAttempt(attempt->GetBroker(), attempt->GetElapsedMs(), !!md,
+          timeout_ms);
+
+      if (md) {
+        MetadataFetchAttemptSuccess.Increment();
+
+        if (!result) {
+          result = std::move(md);
+        }
+      } else {
+        MetadataFetchAttemptFail.Increment();
+      }
+    }
+
+    if (result || error) {
+      break;
+    }
+  }
+
+  if (!running.empty()) {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    for (std::unique_ptr<TAttempt> &attempt : running) {
+      CancelMetadataFetchAttempt.Increment();
+      attempt->Cancel();
+      CancelledAttempts.push_back(std::move(attempt));
+    }
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  if (cancelled) {
+    syslog(LOG_NOTICE, "Metadata fetch cancelled");
+  }
+
+  return std::move(result);
+}
+
+std::vector<size_t> THedgedMetadataFetcher::ChooseBrokerOrder(
+    const std::vector<THostAndPort> &brokers) {
+  assert(this);
+  std::vector<size_t> remaining(brokers.size());
+  std::vector<double> weights(brokers.size());
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    for (size_t i = 0; i < brokers.size(); ++i) {
+      remaining[i] = i;
+      auto iter = AvgLatencyMap.find(BrokerKey(brokers[i]));
+
+      /* A broker we know nothing about gets the same weight as one that
+         responds instantly, so we learn about it. */
+      uint64_t latency = (iter == AvgLatencyMap.end()) ? 0 : iter->second;
+      weights[i] = 1.0 / (1.0 + static_cast<double>(latency));
+    }
+  }
+
+  std::vector<size_t> result;
+  result.reserve(brokers.size());
+
+  /* Weighted random selection without replacement. */
+  while (!remaining.empty()) {
+    double total = 0.0;
+
+    for (size_t index : remaining) {
+      total += weights[index];
+    }
+
+    double r = total * (static_cast<double>(std::rand()) /
+        (static_cast<double>(RAND_MAX) + 1.0));
+    size_t chosen = remaining.size() - 1;
+
+    for (size_t i = 0; i < remaining.size(); ++i) {
+      r -= weights[remaining[i]];
+
+      if (r < 0.0) {
+        chosen = i;
+        break;
+      }
+    }
+
+    result.push_back(remaining[chosen]);
+    remaining.erase(remaining.begin() + chosen);
+  }
+
+  return std::move(result);
+}
+
+uint64_t THedgedMetadataFetcher::ComputeHedgeDelay() {
+  assert(this);
+
+  if (MinHedgeDelay == 0) {
+    return 0;
+  }
+
+  std::vector<uint64_t> samples;
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    samples.assign(RecentLatencies.begin(), RecentLatencies.end());
+  }
+
+  if (samples.size() < MIN_LATENCY_SAMPLES) {
+    return MinHedgeDelay;
+  }
+
+  size_t pos = ((samples.size() - 1) * HedgePercentile) / 100;
+  std::nth_element(samples.begin(), samples.begin() + pos, samples.end());
+  return std::max<uint64_t>(samples[pos], MinHedgeDelay);
+}
+
+void THedgedMetadataFetcher::RecordAttempt(const THostAndPort &broker,
+    uint64_t elapsed_ms, bool success, int timeout_ms) {
+  assert(this);
+  uint64_t sample = elapsed_ms;
+
+  if (!success) {
+    sample = std::max<uint64_t>(sample,
+        static_cast<uint64_t>(std::max(timeout_ms, 0)));
+  }
+
+  std::lock_guard<std::mutex> lock(Mutex);
+  auto result = AvgLatencyMap.insert(std::make_pair(BrokerKey(broker),
+      sample));
+
+  if (!result.second) {
+    uint64_t &avg = result.first->second;
+    avg = ((3 * avg) + sample) / 4;
+  }
+
+  if (success) {
+    RecentLatencies.push_back(elapsed_ms);
+
+    if (RecentLatencies.size() > RECENT_LATENCY_COUNT) {
+      RecentLatencies.pop_front();
+    }
+  }
+}
+
+void THedgedMetadataFetcher::ReapCancelledAttempts(bool wait) {
+  assert(this);
+  std::vector<std::unique_ptr<TAttempt>> finished;
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    for (size_t i = CancelledAttempts.size(); i > 0; ) {
+      --i;
+
+      if (wait || CancelledAttempts[i]->GetShutdownWaitFd().IsReadable()) {
+        finished.push_back(std::move(CancelledAttempts[i]));
+        CancelledAttempts.erase(CancelledAttempts.begin() + i);
+      }
+    }
+  }
+
+  /* Join outside the critical section, since this may block. */
+  for (std::unique_ptr<TAttempt> &attempt : finished) {
+    try {
+      attempt->Join();
+    } catch (const Thread::TFdManagedThread::TWorkerError &) {
+      /* We no longer care about the result. */
+    }
+  }
+}
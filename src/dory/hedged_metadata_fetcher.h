@@ -0,0 +1,197 @@
+/* <dory/hedged_metadata_fetcher.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for getting metadata from a set of brokers, sending requests to
+   several brokers in parallel and taking the first valid response.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <base/event_semaphore.h>
+#include <base/fd.h>
+#include <base/no_copy_semantics.h>
+#include <base/opt.h>
+#include <dory/metadata.h>
+#include <dory/metadata_fetcher.h>
+#include <dory/util/host_and_port.h>
+#include <thread/fd_managed_thread.h>
+
+namespace Dory {
+
+  /* Each attempt to get metadata from a broker runs in its own thread, so a
+     slow or unreachable broker doesn't hold up the others.  Fetch() starts
+     'parallel_count' attempts at once.  When an attempt fails, another broker
+     is tried in its place.  If no attempt has succeeded after a hedge delay,
+     an additional attempt is started.  The hedge delay is the given percentile
+     of recent successful fetch times, but no less than 'min_hedge_delay'
+     milliseconds.  A 'min_hedge_delay' of 0 disables hedging.  Once an
+     attempt succeeds, the others are cancelled.
+
+     Brokers are chosen randomly, weighted in favor of those that have
+     responded quickly in the past.  Fetch() may be called concurrently by
+     multiple threads, which share the broker latency information. */
+  class THedgedMetadataFetcher final {
+    NO_COPY_SEMANTICS(THedgedMetadataFetcher);
+
+    public:
+    THedgedMetadataFetcher(const Base::TOpt<size_t> &metadata_api_version,
+        size_t parallel_count, size_t hedge_percentile,
+        size_t min_hedge_delay);
+
+    /* Waits for any cancelled attempts that are still running.  Since
+       cancelling an attempt interrupts its connect and I/O, this only waits
+       for a host name lookup in progress. */
+    ~THedgedMetadataFetcher() noexcept;
+
+    /* Try the brokers in 'brokers' until one provides metadata that passes a
+       sanity check.  On success, returned unique_ptr will contain metadata.
+       If all brokers fail, returned unique_ptr will be empty.  Timeout is
+       specified in milliseconds and applies separately to each attempt.  If
+       'topics' is nonempty, only get metadata for those topics.  If
+       'cancel_fd' is nonnegative and becomes readable, the attempts in
+       progress are cancelled and the returned unique_ptr is empty. */
+    std::unique_ptr<TMetadata> Fetch(
+        const std::vector<Util::THostAndPort> &brokers,
+        const std::vector<std::string> &topics, int timeout_ms,
+        int cancel_fd = -1);
+
+    private:
+    /* Thread that tries to get metadata from a single broker. */
+    class TAttempt final : public Thread::TFdManagedThread {
+      NO_COPY_SEMANTICS(TAttempt);
+
+      public:
+      TAttempt(const Base::TOpt<size_t> &metadata_api_version,
+          const Util::THostAndPort &broker,
+          const std::vector<std::string> &topics, int timeout_ms);
+
+      virtual ~TAttempt() noexcept;
+
+      const Util::THostAndPort &GetBroker() const {
+        assert(this);
+        return Broker;
+      }
+
+      /* Called by the thread that started the attempt.  Abandons a
+         connection attempt in progress, or closes the connection to the
+         broker if one is open, so the attempt finishes quickly.  A host name
+         lookup in progress can't be cancelled, and is allowed to finish. */
+      void Cancel();
+
+      /* Called once the attempt has finished.  Returns true if it was
+         cancelled. */
+      bool WasCancelled() const;
+
+      /* Called once the attempt has finished.  Returned unique_ptr is empty
+         on failure. */
+      std::unique_ptr<TMetadata> TakeResult() {
+        assert(this);
+        return std::move(Result);
+      }
+
+      /* Called once the attempt has finished.  Returns its duration in
+         milliseconds. */
+      uint64_t GetElapsedMs() const {
+        assert(this);
+        return ElapsedMs;
+      }
+
+      protected:
+      virtual void Run() override;
+
+      private:
+      const Util::THostAndPort Broker;
+
+      /* This is a copy, since a cancelled attempt may outlive the caller's
+         vector. */
+      const std::vector<std::string> Topics;
+
+      const int TimeoutMs;
+
+      TMetadataFetcher Fetcher;
+
+      /* Protects 'Cancelled' and 'Sock'. */
+      mutable std::mutex Mutex;
+
+      bool Cancelled;
+
+      /* Duplicate of the fetcher's socket FD while a connection is open, for
+         use by Cancel().  Since we own the duplicate, its FD number can't be
+         reused while Cancel() may be using it. */
+      Base::TFd Sock;
+
+      /* Pushed by Cancel(), to abandon a connection attempt in progress. */
+      Base::TEventSemaphore CancelSem;
+
+      std::unique_ptr<TMetadata> Result;
+
+      uint64_t ElapsedMs;
+    };  // TAttempt
+
+    /* Return indexes into 'brokers' in the order they should be tried. */
+    std::vector<size_t> ChooseBrokerOrder(
+        const std::vector<Util::THostAndPort> &brokers);
+
+    /* Return the hedge delay in milliseconds, or 0 if hedging is disabled. */
+    uint64_t ComputeHedgeDelay();
+
+    /* Update latency information from a finished attempt.  A failed attempt
+       counts as taking 'timeout_ms', so the broker is less likely to be chosen
+       next time. */
+    void RecordAttempt(const Util::THostAndPort &broker, uint64_t elapsed_ms,
+        bool success, int timeout_ms);
+
+    /* Join attempts that were cancelled and have since finished.  If 'wait'
+       is true, wait for all of them. */
+    void ReapCancelledAttempts(bool wait);
+
+    const Base::TOpt<size_t> MetadataApiVersion;
+
+    const size_t ParallelCount;
+
+    const size_t HedgePercentile;
+
+    const size_t MinHedgeDelay;
+
+    /* Protects 'AvgLatencyMap', 'RecentLatencies', and 'CancelledAttempts'.
+     */
+    std::mutex Mutex;
+
+    /* Key is "host:port".  Value is exponentially weighted average fetch time
+       in milliseconds. */
+    std::unordered_map<std::string, uint64_t> AvgLatencyMap;
+
+    /* Times in milliseconds of recent successful fetches, used for computing
+       the hedge delay. */
+    std::deque<uint64_t> RecentLatencies;
+
+    /* Cancelled attempts that may still be running. */
+    std::vector<std::unique_ptr<TAttempt>> CancelledAttempts;
+  };  // THedgedMetadataFetcher
+
+}  // Dory
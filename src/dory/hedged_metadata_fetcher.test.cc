@@ -0,0 +1,247 @@
+/* <dory/hedged_metadata_fetcher.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/hedged_metadata_fetcher.h>.
+ */
+
+#include <dory/hedged_metadata_fetcher.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include <base/event_semaphore.h>
+#include <base/no_copy_semantics.h>
+#include <base/opt.h>
+#include <base/time_util.h>
+#include <dory/metadata.h>
+#include <dory/mock_kafka_server/main_thread.h>
+#include <dory/test_util/blackhole_broker.h>
+#include <dory/test_util/mock_kafka_config.h>
+#include <dory/util/host_and_port.h>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::TestUtil;
+using namespace Dory::Util;
+
+namespace {
+
+  /* The fixture for testing class THedgedMetadataFetcher. */
+  class THedgedMetadataFetcherTest : public ::testing::Test {
+    protected:
+    THedgedMetadataFetcherTest() {
+    }
+
+    virtual ~THedgedMetadataFetcherTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // THedgedMetadataFetcherTest
+
+  /* Most tests use a long socket timeout, and only check that operations
+     finish well before it expires.  This avoids depending on precise timing,
+     which is unreliable on a busy test machine. */
+  const int LONG_TIMEOUT_MS = 60000;
+
+  /* Limit on how long anything that shouldn't wait for LONG_TIMEOUT_MS may
+     take. */
+  const int WAIT_LIMIT_MS = 10000;
+
+  /* Runs THedgedMetadataFetcher::Fetch() in a separate thread, so a test can
+     observe the fetch while it is in progress, and then cancel it. */
+  class TBackgroundFetch final {
+    NO_COPY_SEMANTICS(TBackgroundFetch);
+
+    public:
+    TBackgroundFetch(THedgedMetadataFetcher &fetcher,
+        const std::vector<THostAndPort> &brokers)
+        : Thread([this, &fetcher, brokers]() {
+            Result = fetcher.Fetch(brokers, std::vector<std::string>(),
+                LONG_TIMEOUT_MS, CancelSem.GetFd());
+          }) {
+    }
+
+    ~TBackgroundFetch() noexcept {
+      if (Thread.joinable()) {
+        Cancel();
+      }
+    }
+
+    /* Cancel the fetch and wait for it to finish.  Returns the result. */
+    std::unique_ptr<TMetadata> Cancel() {
+      CancelSem.Push();
+      Thread.join();
+      return std::move(Result);
+    }
+
+    private:
+    TEventSemaphore CancelSem;
+
+    std::unique_ptr<TMetadata> Result;
+
+    std::thread Thread;
+  };  // TBackgroundFetch
+
+  TEST_F(THedgedMetadataFetcherTest, SuccessTest) {
+    std::vector<std::string> kafka_config;
+    kafka_config.push_back("ports 10000 1");
+    kafka_config.push_back("topic topic1 2 0");
+    TMockKafkaConfig kafka(kafka_config);
+    kafka.StartKafka();
+
+    /* See big comment in <dory/mock_kafka_server/port_map.h> for an
+       explanation of virtual and physical ports. */
+    in_port_t port = kafka.MainThread->VirtualPortToPhys(10000);
+    TBlackholeBroker blackhole_1, blackhole_2;
+    std::vector<THostAndPort> hosts;
+    hosts.push_back(blackhole_1.GetHostAndPort());
+    hosts.push_back(THostAndPort("localhost", port));
+    hosts.push_back(blackhole_2.GetHostAndPort());
+    uint64_t start = GetMonotonicRawMilliseconds();
+
+    {
+      /* Metadata API version 0 is forced, so no ApiVersions request is sent.
+         All three brokers are tried at once, and hedging is disabled. */
+      THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 3, 95, 0);
+      std::unique_ptr<TMetadata> md = fetcher.Fetch(hosts,
+          std::vector<std::string>(), LONG_TIMEOUT_MS);
+      ASSERT_TRUE(!!md);
+      ASSERT_GE(md->FindTopicIndex("topic1"), 0);
+
+      /* The attempts to get metadata from the other brokers were started,
+         and are still waiting for responses that will never come. */
+      ASSERT_TRUE(blackhole_1.WaitForConnection(WAIT_LIMIT_MS));
+      ASSERT_TRUE(blackhole_2.WaitForConnection(WAIT_LIMIT_MS));
+
+      /* The fetcher's destructor waits for the cancelled attempts, which
+         must finish without waiting for their timeouts. */
+    }
+
+    uint64_t elapsed = GetMonotonicRawMilliseconds() - start;
+    ASSERT_LT(elapsed, static_cast<uint64_t>(WAIT_LIMIT_MS));
+  }
+
+  TEST_F(THedgedMetadataFetcherTest, ParallelTest) {
+    std::vector<std::unique_ptr<TBlackholeBroker>> brokers;
+    std::vector<THostAndPort> hosts;
+
+    for (size_t i = 0; i < 3; ++i) {
+      brokers.emplace_back(new TBlackholeBroker);
+      hosts.push_back(brokers.back()->GetHostAndPort());
+    }
+
+    /* Hedging is disabled. */
+    THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 3, 95, 0);
+    TBackgroundFetch fetch(fetcher, hosts);
+
+    /* All three attempts are in progress at once, rather than one after
+       another. */
+    for (const std::unique_ptr<TBlackholeBroker> &broker : brokers) {
+      ASSERT_TRUE(broker->WaitForConnection(WAIT_LIMIT_MS));
+    }
+
+    ASSERT_FALSE(fetch.Cancel());
+  }
+
+  TEST_F(THedgedMetadataFetcherTest, HedgeTest) {
+    std::vector<std::unique_ptr<TBlackholeBroker>> brokers;
+    std::vector<THostAndPort> hosts;
+
+    for (size_t i = 0; i < 3; ++i) {
+      brokers.emplace_back(new TBlackholeBroker);
+      hosts.push_back(brokers.back()->GetHostAndPort());
+    }
+
+    /* One attempt at a time, plus a hedged attempt after each 100 ms delay.
+     */
+    THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 1, 95, 100);
+    TBackgroundFetch fetch(fetcher, hosts);
+
+    /* Without hedging, the second attempt wouldn't start until the first one
+       timed out. */
+    for (const std::unique_ptr<TBlackholeBroker> &broker : brokers) {
+      ASSERT_TRUE(broker->WaitForConnection(WAIT_LIMIT_MS));
+    }
+
+    ASSERT_FALSE(fetch.Cancel());
+  }
+
+  TEST_F(THedgedMetadataFetcherTest, ConnectFailTest) {
+    /* Get a port that nothing is listening on. */
+    THostAndPort host("127.0.0.1", 0);
+
+    {
+      TBlackholeBroker broker;
+      host = broker.GetHostAndPort();
+    }
+
+    std::vector<THostAndPort> hosts(4, host);
+    const std::vector<std::string> no_topics;
+    THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 2, 95, LONG_TIMEOUT_MS);
+    uint64_t start = GetMonotonicRawMilliseconds();
+    std::unique_ptr<TMetadata> md = fetcher.Fetch(hosts, no_topics,
+        LONG_TIMEOUT_MS);
+    uint64_t elapsed = GetMonotonicRawMilliseconds() - start;
+    ASSERT_FALSE(md);
+
+    /* Each failed attempt is replaced immediately, rather than after the
+       hedge delay. */
+    ASSERT_LT(elapsed, static_cast<uint64_t>(WAIT_LIMIT_MS));
+  }
+
+  TEST_F(THedgedMetadataFetcherTest, CancelConnectTest) {
+    /* Connection attempts to this broker hang. */
+    TBlackholeBroker broker(true);
+    std::vector<THostAndPort> hosts(1, broker.GetHostAndPort());
+    uint64_t start = 0;
+
+    {
+      THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 1, 95, 0);
+      TBackgroundFetch fetch(fetcher, hosts);
+
+      /* Give the attempt time to start connecting. */
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      start = GetMonotonicRawMilliseconds();
+      ASSERT_FALSE(fetch.Cancel());
+
+      /* The fetcher's destructor waits for the cancelled attempt, which must
+         abandon its connection attempt. */
+    }
+
+    uint64_t elapsed = GetMonotonicRawMilliseconds() - start;
+    ASSERT_LT(elapsed, static_cast<uint64_t>(WAIT_LIMIT_MS));
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,159 @@
+/* <dory/input_dg/flush/v0/v0_input_dg.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/input_dg/flush/v0/v0_input_dg_reader.h> and
+   <dory/input_dg/flush/v0/v0_write_msg.h>.
+ */
+
+#include <dory/input_dg/input_dg_util.h>
+#include <dory/input_dg/flush/v0/v0_write_msg.h>
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <capped/pool.h>
+#include <dory/anomaly_tracker.h>
+#include <dory/client/status_codes.h>
+#include <dory/config.h>
+#include <dory/msg.h>
+#include <dory/msg_creator.h>
+#include <dory/msg_state_tracker.h>
+#include <dory/test_util/misc_util.h>
+
+#include <gtest/gtest.h>
+
+using namespace Capped;
+using namespace Dory;
+using namespace Dory::InputDg;
+using namespace Dory::TestUtil;
+
+namespace {
+
+  struct TTestConfig {
+    std::vector<const char *> Args;
+
+    std::unique_ptr<Dory::TConfig> Cfg;
+
+    std::unique_ptr<TPool> Pool;
+
+    TDiscardFileLogger DiscardFileLogger;
+
+    TAnomalyTracker AnomalyTracker;
+
+    TMsgStateTracker MsgStateTracker;
+
+    TTestConfig();
+  };  // TTestConfig
+
+  TTestConfig::TTestConfig()
+      : Pool(new TPool(128, 16384, TPool::TSync::Mutexed)),
+        AnomalyTracker(DiscardFileLogger, 0,
+                       std::numeric_limits<size_t>::max()) {
+    Args.push_back("dory");
+    Args.push_back("--config_path");
+    Args.push_back("/nonexistent/path");
+    Args.push_back("--msg_buffer_max");
+    Args.push_back("1");  // dummy value
+    Args.push_back("--receive_socket_name");
+    Args.push_back("dummy_value");
+    Args.push_back(nullptr);
+    Cfg.reset(new Dory::TConfig(Args.size() - 1, const_cast<char **>(&Args[0]),
+        true));
+  }
+
+  TMsg::TPtr WriteAndRead(TTestConfig &cfg, const std::string &topic) {
+    std::vector<uint8_t> buf;
+    size_t dg_size = 0;
+    int result = input_dg_flush_v0_compute_msg_size(&dg_size, topic.size());
+
+    if (result != DORY_OK) {
+      return TMsg::TPtr();
+    }
+
+    buf.resize(dg_size);
+    input_dg_flush_v0_write_msg(&buf[0], topic.data(),
+        topic.data() + topic.size());
+    return BuildMsgFromDg(&buf[0], buf.size(), *cfg.Cfg, *cfg.Pool,
+        cfg.AnomalyTracker, cfg.MsgStateTracker);
+  }
+
+  /* The fixture for testing reading/writing of v0 flush input datagrams. */
+  class TV0InputDgTest : public ::testing::Test {
+    protected:
+    TV0InputDgTest() {
+    }
+
+    virtual ~TV0InputDgTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TV0InputDgTest
+
+  TEST_F(TV0InputDgTest, SingleTopic) {
+    TTestConfig cfg;
+    std::string topic("scones");
+    TMsg::TPtr msg = WriteAndRead(cfg, topic);
+    ASSERT_TRUE(!!msg);
+    SetProcessed(msg);
+    ASSERT_TRUE(msg->IsFlushRequest());
+    ASSERT_EQ(msg->GetRoutingType(), TMsg::TRoutingType::AnyPartition);
+    ASSERT_EQ(msg->GetTopic(), topic);
+    ASSERT_EQ(msg->GetKeySize(), 0U);
+    ASSERT_EQ(msg->GetValueSize(), 0U);
+  }
+
+  TEST_F(TV0InputDgTest, AllTopics) {
+    TTestConfig cfg;
+    TMsg::TPtr msg = WriteAndRead(cfg, std::string());
+    ASSERT_TRUE(!!msg);
+    SetProcessed(msg);
+    ASSERT_TRUE(msg->IsFlushRequest());
+    ASSERT_TRUE(msg->GetTopic().empty());
+  }
+
+  TEST_F(TV0InputDgTest, TopicTooLarge) {
+    size_t dg_size = 0;
+    int result = input_dg_flush_v0_compute_msg_size(&dg_size,
+        static_cast<size_t>(std::numeric_limits<int16_t>::max()) + 1);
+    ASSERT_EQ(result, DORY_TOPIC_TOO_LARGE);
+  }
+
+  TEST_F(TV0InputDgTest, DataMsgIsNotFlushRequest) {
+    TTestConfig cfg;
+    std::string topic("scones");
+    TMsg::TPtr msg = TMsgCreator::CreateAnyPartitionMsg(0, topic.data(),
+        topic.data() + topic.size(), nullptr, 0, nullptr, 0, false, *cfg.Pool,
+        cfg.MsgStateTracker);
+    ASSERT_TRUE(!!msg);
+    SetProcessed(msg);
+    ASSERT_FALSE(msg->IsFlushRequest());
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,75 @@
+/* <dory/input_dg/flush/v0/v0_input_dg_reader.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/input_dg/flush/v0/v0_input_dg_reader.h>.
+ */
+
+#include <dory/input_dg/flush/v0/v0_input_dg_reader.h>
+
+#include <base/field_access.h>
+#include <base/time_util.h>
+#include <dory/input_dg/input_dg_common.h>
+#include <dory/msg_creator.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::InputDg;
+using namespace Dory::InputDg::Flush;
+using namespace Dory::InputDg::Flush::V0;
+
+TMsg::TPtr TV0InputDgReader::BuildMsg() {
+  assert(this);
+  const uint8_t *pos = DataBegin;
+
+  if ((DataEnd - pos) < INPUT_DG_FLUSH_V0_FLAGS_FIELD_SIZE) {
+    DiscardMalformedMsg(DgBegin, DgSize, AnomalyTracker, NoLogDiscard);
+    return TMsg::TPtr();
+  }
+
+  int16_t flags = ReadInt16FromHeader(pos);
+
+  if (flags) {
+    DiscardMalformedMsg(DgBegin, DgSize, AnomalyTracker, NoLogDiscard);
+    return TMsg::TPtr();
+  }
+
+  pos += INPUT_DG_FLUSH_V0_FLAGS_FIELD_SIZE;
+
+  if ((DataEnd - pos) < INPUT_DG_FLUSH_V0_TOPIC_SZ_FIELD_SIZE) {
+    DiscardMalformedMsg(DgBegin, DgSize, AnomalyTracker, NoLogDiscard);
+    return TMsg::TPtr();
+  }
+
+  int16_t topic_sz = ReadInt16FromHeader(pos);
+  pos += INPUT_DG_FLUSH_V0_TOPIC_SZ_FIELD_SIZE;
+
+  /* An empty topic requests a flush of all topics. */
+  if ((topic_sz < 0) || ((DataEnd - pos) != topic_sz)) {
+    DiscardMalformedMsg(DgBegin, DgSize, AnomalyTracker, NoLogDiscard);
+    return TMsg::TPtr();
+  }
+
+  const char *topic_begin = reinterpret_cast<const char *>(pos);
+  const char *topic_end = topic_begin + topic_sz;
+
+  /* The request has no message data, so no memory is allocated from 'Pool'
+     and creation can't fail due to the memory cap. */
+  return TMsgCreator::CreateFlushRequestMsg(
+      static_cast<TMsg::TTimestamp>(GetEpochMilliseconds()), topic_begin,
+      topic_end, Pool, MsgStateTracker);
+}
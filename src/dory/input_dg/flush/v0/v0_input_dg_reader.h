@@ -0,0 +1,100 @@
+/* <dory/input_dg/flush/v0/v0_input_dg_reader.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for reading the contents of an input datagram that conforms to
+   version 0 of the input format for flush requests.  Builds a TMsg from the
+   datagram contents.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <base/no_copy_semantics.h>
+#include <capped/pool.h>
+#include <dory/anomaly_tracker.h>
+#include <dory/input_dg/flush/v0/v0_input_dg_constants.h>
+#include <dory/msg.h>
+#include <dory/msg_state_tracker.h>
+
+namespace Dory {
+
+  namespace InputDg {
+
+    namespace Flush {
+
+      namespace V0 {
+
+        class TV0InputDgReader final {
+          NO_COPY_SEMANTICS(TV0InputDgReader);
+
+          public:
+          TV0InputDgReader(const uint8_t *dg_begin,
+              const uint8_t *data_begin, const uint8_t *data_end,
+              Capped::TPool &pool, TAnomalyTracker &anomaly_tracker,
+              TMsgStateTracker &msg_state_tracker, bool no_log_discard)
+              : DgBegin(dg_begin),
+                DataBegin(data_begin),
+                DataEnd(data_end),
+                DgSize(data_end - dg_begin),
+                NoLogDiscard(no_log_discard),
+                Pool(pool),
+                AnomalyTracker(anomaly_tracker),
+                MsgStateTracker(msg_state_tracker) {
+            assert(DgBegin);
+            assert(DataBegin > DgBegin);
+            assert(DataEnd >= DataBegin);
+          }
+
+          TMsg::TPtr BuildMsg();
+
+          private:
+          /* Points to first byte of input datagram. */
+          const uint8_t * const DgBegin;
+
+          /* Points to first byte of version-specific part of input
+             datagram. */
+          const uint8_t * const DataBegin;
+
+          /* Points one byte past last byte of input datagram. */
+          const uint8_t * const DataEnd;
+
+          /* Size in bytes of input datagram. */
+          const size_t DgSize;
+
+          bool NoLogDiscard;
+
+          /* Pool to allocate space for TMsg we are building from input
+             datagram. */
+          Capped::TPool &Pool;
+
+          /* If the datagram is malformed, we record the discard here. */
+          TAnomalyTracker &AnomalyTracker;
+
+          TMsgStateTracker &MsgStateTracker;
+        };  // class TV0InputDgReader
+
+      }  // V0
+
+    }  // Flush
+
+  }  // InputDg
+
+}  // Dory
@@ -0,0 +1,78 @@
+/* <dory/input_dg/flush/v0/v0_write_msg.c>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/input_dg/flush/v0/v0_write_msg.h>.
+ */
+
+#include <dory/input_dg/flush/v0/v0_write_msg.h>
+
+#include <assert.h>
+#include <string.h>
+
+#include <base/field_access.h>
+#include <dory/input_dg/flush/v0/v0_input_dg_constants.h>
+#include <dory/input_dg/input_dg_constants.h>
+
+static inline size_t get_msg_overhead() {
+  return INPUT_DG_SZ_FIELD_SIZE + INPUT_DG_API_KEY_FIELD_SIZE +
+      INPUT_DG_API_VERSION_FIELD_SIZE + INPUT_DG_FLUSH_V0_FLAGS_FIELD_SIZE +
+      INPUT_DG_FLUSH_V0_TOPIC_SZ_FIELD_SIZE;
+}
+
+int input_dg_flush_v0_compute_msg_size(size_t *result, size_t topic_size) {
+  *result = 0;
+
+  if (topic_size > INT16_MAX) {
+    return DORY_TOPIC_TOO_LARGE;
+  }
+
+  *result = get_msg_overhead() + topic_size;
+  return DORY_OK;
+}
+
+void input_dg_flush_v0_write_msg(void *result_buf, const void *topic_begin,
+    const void *topic_end) {
+  assert(result_buf);
+  assert(topic_begin || (topic_end == topic_begin));
+  assert(topic_end >= topic_begin);
+  uint8_t *pos = (uint8_t *) result_buf;
+  const uint8_t *topic_start = (const uint8_t *) topic_begin;
+  const uint8_t *topic_finish = (const uint8_t *) topic_end;
+  size_t topic_size = topic_finish - topic_start;
+  size_t msg_size = 0;
+
+  if (input_dg_flush_v0_compute_msg_size(&msg_size, topic_size) != DORY_OK) {
+    assert(0);
+    return;
+  }
+
+  WriteInt32ToHeader(pos, msg_size);
+  pos += INPUT_DG_SZ_FIELD_SIZE;
+  WriteInt16ToHeader(pos, 258);
+  pos += INPUT_DG_API_KEY_FIELD_SIZE;
+  WriteInt16ToHeader(pos, 0);  // API version
+  pos += INPUT_DG_API_VERSION_FIELD_SIZE;
+  WriteInt16ToHeader(pos, 0);  // flags
+  pos += INPUT_DG_FLUSH_V0_FLAGS_FIELD_SIZE;
+  WriteInt16ToHeader(pos, topic_size);
+  pos += INPUT_DG_FLUSH_V0_TOPIC_SZ_FIELD_SIZE;
+
+  if (topic_start) {
+    memcpy(pos, topic_start, topic_size);
+  }
+}
@@ -0,0 +1,54 @@
+/* <dory/input_dg/flush/v0/v0_write_msg.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Functions for creating flush request datagrams to write to Dory's input
+   socket.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <dory/client/status_codes.h>
+
+/* This is a pure C implementation.  Avoiding C++ here allows C programs to use
+   the client library without having to link to the standard C++ library. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* See <dory/client/status_codes.h> for definitions of returned status codes.
+ */
+
+/* Compute size of datagram with topic size in bytes given by 'topic_size'.
+   An empty topic requests a flush of all topics.  On success, DORY_OK will be
+   returned, and *result will contain the computed size.  On error,
+   DORY_TOPIC_TOO_LARGE will be returned. */
+int input_dg_flush_v0_compute_msg_size(size_t *result, size_t topic_size);
+
+/* Write datagram into 'result_buf'.  It is assumed that 'result_buf' has
+   enough space for entire datagram (see
+   input_dg_flush_v0_compute_msg_size()). */
+void input_dg_flush_v0_write_msg(void *result_buf, const void *topic_begin,
+    const void *topic_end);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -28,6 +28,7 @@
 
 #include <base/field_access.h>
 #include <dory/input_dg/any_partition/any_partition_util.h>
+#include <dory/input_dg/flush/flush_util.h>
 #include <dory/input_dg/input_dg_common.h>
 #include <dory/input_dg/input_dg_constants.h>
 #include <dory/input_dg/partition_key/partition_key_util.h>
@@ -38,6 +39,7 @@ using namespace Base;
 using namespace Dory;
 using namespace Dory::InputDg;
 using namespace Dory::InputDg::AnyPartition;
+using namespace Dory::InputDg::Flush;
 using namespace Dory::InputDg::PartitionKey;
 using namespace Dory::Util;
 
@@ -83,6 +85,11 @@ TMsg::TPtr Dory::InputDg::BuildMsgFromDg(const void *dg, size_t dg_size,
           versioned_part_begin, versioned_part_end, pool, anomaly_tracker,
           msg_state_tracker, config.NoLogDiscard);
     }
+    case 258: {
+      return BuildFlushMsgFromDg(dg_bytes, dg_size, api_version,
+          versioned_part_begin, versioned_part_end, pool, anomaly_tracker,
+          msg_state_tracker, config.NoLogDiscard);
+    }
     default: {
       break;
     }
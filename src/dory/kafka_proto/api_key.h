@@ -0,0 +1,39 @@
+/* <dory/kafka_proto/api_key.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Kafka API keys for the request types that Dory deals with.  See
+   https://kafka.apache.org/protocol for more information.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace Dory {
+
+  namespace KafkaProto {
+
+    enum class TApiKey : int16_t {
+      Produce = 0,
+      Metadata = 3,
+      ApiVersions = 18
+    };  // TApiKey
+
+  }  // KafkaProto
+
+}  // Dory
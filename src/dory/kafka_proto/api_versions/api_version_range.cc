@@ -0,0 +1,56 @@
+/* <dory/kafka_proto/api_versions/api_version_range.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/kafka_proto/api_versions/api_version_range.h>.
+ */
+
+#include <dory/kafka_proto/api_versions/api_version_range.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::KafkaProto;
+using namespace Dory::KafkaProto::ApiVersions;
+
+const TApiVersionRange *Dory::KafkaProto::ApiVersions::FindApiVersionRange(
+    const std::vector<TApiVersionRange> &ranges, int16_t api_key) {
+  for (const TApiVersionRange &range : ranges) {
+    if (range.ApiKey == api_key) {
+      return &range;
+    }
+  }
+
+  return nullptr;
+}
+
+TOpt<size_t> Dory::KafkaProto::ApiVersions::ChooseHighestCommonVersion(
+    const std::vector<size_t> &supported, const TApiVersionRange &range) {
+  TOpt<size_t> result;
+
+  if ((range.MinVersion < 0) || (range.MaxVersion < range.MinVersion)) {
+    return result;
+  }
+
+  for (size_t version : supported) {
+    if ((version >= static_cast<size_t>(range.MinVersion)) &&
+        (version <= static_cast<size_t>(range.MaxVersion))) {
+      result = version;
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,74 @@
+/* <dory/kafka_proto/api_versions/api_version_range.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Representation of the range of versions a Kafka broker supports for a
+   single API, as reported in an ApiVersions response.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <base/opt.h>
+
+namespace Dory {
+
+  namespace KafkaProto {
+
+    namespace ApiVersions {
+
+      struct TApiVersionRange {
+        int16_t ApiKey;
+
+        int16_t MinVersion;
+
+        int16_t MaxVersion;
+
+        TApiVersionRange()
+            : ApiKey(0),
+              MinVersion(0),
+              MaxVersion(0) {
+        }
+
+        TApiVersionRange(int16_t api_key, int16_t min_version,
+            int16_t max_version)
+            : ApiKey(api_key),
+              MinVersion(min_version),
+              MaxVersion(max_version) {
+        }
+      };  // TApiVersionRange
+
+      /* Return the range for API 'api_key' in 'ranges', or nullptr if not
+         found. */
+      const TApiVersionRange *FindApiVersionRange(
+          const std::vector<TApiVersionRange> &ranges, int16_t api_key);
+
+      /* Return the highest version in 'supported' (Dory's supported versions
+         for some API, sorted in ascending order) that also lies within
+         'range'.  The result is unknown if there is no such version. */
+      Base::TOpt<size_t> ChooseHighestCommonVersion(
+          const std::vector<size_t> &supported,
+          const TApiVersionRange &range);
+
+    }  // ApiVersions
+
+  }  // KafkaProto
+
+}  // Dory
@@ -0,0 +1,144 @@
+/* <dory/kafka_proto/api_versions/api_versions.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit tests for the Kafka ApiVersions request and response readers and
+   writers, and for <dory/kafka_proto/api_versions/api_version_range.h>.
+ */
+
+#include <dory/kafka_proto/api_versions/api_version_range.h>
+#include <dory/kafka_proto/api_versions/api_versions_request_reader.h>
+#include <dory/kafka_proto/api_versions/api_versions_request_writer.h>
+#include <dory/kafka_proto/api_versions/api_versions_response_reader.h>
+#include <dory/kafka_proto/api_versions/api_versions_response_writer.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <base/opt.h>
+#include <dory/kafka_proto/api_key.h>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::KafkaProto;
+using namespace Dory::KafkaProto::ApiVersions;
+
+namespace {
+
+  /* The fixture for testing the ApiVersions request and response classes. */
+  class TApiVersionsTest : public ::testing::Test {
+    protected:
+    TApiVersionsTest() {
+    }
+
+    virtual ~TApiVersionsTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TApiVersionsTest
+
+  TEST_F(TApiVersionsTest, RequestTest) {
+    std::vector<uint8_t> buf;
+    TApiVersionsRequestWriter().WriteRequest(buf, 12345);
+    ASSERT_EQ(buf.size(), 14U);
+    TApiVersionsRequestReader reader(&buf[0], buf.size());
+    ASSERT_EQ(reader.GetApiVersion(), 0);
+    ASSERT_EQ(reader.GetCorrelationId(), 12345);
+
+    /* Corrupt the API key. */
+    buf[5] = 3;
+    bool threw = false;
+
+    try {
+      TApiVersionsRequestReader bad_reader(&buf[0], buf.size());
+    } catch (const std::runtime_error &) {
+      threw = true;
+    }
+
+    ASSERT_TRUE(threw);
+  }
+
+  TEST_F(TApiVersionsTest, ResponseTest) {
+    std::vector<TApiVersionRange> apis;
+    apis.push_back(TApiVersionRange(
+        static_cast<int16_t>(TApiKey::Produce), 0, 2));
+    apis.push_back(TApiVersionRange(
+        static_cast<int16_t>(TApiKey::Metadata), 0, 1));
+    apis.push_back(TApiVersionRange(
+        static_cast<int16_t>(TApiKey::ApiVersions), 0, 0));
+    std::vector<uint8_t> buf;
+    TApiVersionsResponseWriter().WriteResponse(buf, 555, 0, apis);
+    ASSERT_EQ(buf.size(), 14U + (3 * 6));
+    TApiVersionsResponseReader reader(&buf[0], buf.size());
+    ASSERT_EQ(reader.GetCorrelationId(), 555);
+    ASSERT_EQ(reader.GetErrorCode(), 0);
+    ASSERT_EQ(reader.GetApiCount(), 3U);
+    std::vector<TApiVersionRange> result = reader.GetAllApis();
+    ASSERT_EQ(result.size(), 3U);
+
+    for (size_t i = 0; i < result.size(); ++i) {
+      ASSERT_EQ(result[i].ApiKey, apis[i].ApiKey);
+      ASSERT_EQ(result[i].MinVersion, apis[i].MinVersion);
+      ASSERT_EQ(result[i].MaxVersion, apis[i].MaxVersion);
+    }
+
+    const TApiVersionRange *range = FindApiVersionRange(result,
+        static_cast<int16_t>(TApiKey::Metadata));
+    ASSERT_TRUE(range != nullptr);
+    ASSERT_EQ(range->MaxVersion, 1);
+    ASSERT_TRUE(FindApiVersionRange(result, 42) == nullptr);
+
+    /* Truncated response must be rejected. */
+    bool threw = false;
+
+    try {
+      TApiVersionsResponseReader bad_reader(&buf[0], buf.size() - 1);
+    } catch (const TApiVersionsResponseReader::TBadApiVersionsResponse &) {
+      threw = true;
+    }
+
+    ASSERT_TRUE(threw);
+  }
+
+  TEST_F(TApiVersionsTest, ChooseVersionTest) {
+    std::vector<size_t> supported = { 0, 1 };
+    TOpt<size_t> v = ChooseHighestCommonVersion(supported,
+        TApiVersionRange(3, 0, 5));
+    ASSERT_TRUE(v.IsKnown());
+    ASSERT_EQ(*v, 1U);
+    v = ChooseHighestCommonVersion(supported, TApiVersionRange(3, 0, 0));
+    ASSERT_TRUE(v.IsKnown());
+    ASSERT_EQ(*v, 0U);
+    v = ChooseHighestCommonVersion(supported, TApiVersionRange(3, 2, 5));
+    ASSERT_FALSE(v.IsKnown());
+    v = ChooseHighestCommonVersion(supported, TApiVersionRange(3, 1, 0));
+    ASSERT_FALSE(v.IsKnown());
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,60 @@
+/* <dory/kafka_proto/api_versions/api_versions_request_reader.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/kafka_proto/api_versions/api_versions_request_reader.h>.
+ */
+
+#include <dory/kafka_proto/api_versions/api_versions_request_reader.h>
+
+#include <algorithm>
+
+using namespace Dory;
+using namespace Dory::KafkaProto::ApiVersions;
+
+TApiVersionsRequestReader::TApiVersionsRequestReader(const void *request,
+    size_t request_size)
+    : Begin(reinterpret_cast<const uint8_t *>(request)) {
+  assert(Begin);
+
+  if (request_size < (THdr::CLIENT_ID_LENGTH_OFFSET +
+                      THdr::CLIENT_ID_LENGTH_SIZE)) {
+    THROW_ERROR(TBadRequestSize);
+  }
+
+  int32_t size_field = ReadInt32FromHeader(Begin);
+
+  if ((size_field < 0) ||
+      ((static_cast<size_t>(size_field) + THdr::REQUEST_SIZE_SIZE) !=
+       request_size)) {
+    THROW_ERROR(TBadRequestSize);
+  }
+
+  if (ReadInt16FromHeader(Begin + THdr::API_KEY_OFFSET) != THdr::API_KEY) {
+    THROW_ERROR(TWrongRequestType);
+  }
+
+  int16_t client_id_len =
+      ReadInt16FromHeader(Begin + THdr::CLIENT_ID_LENGTH_OFFSET);
+
+  if ((client_id_len < THdr::EMPTY_STRING_LENGTH) ||
+      ((THdr::CLIENT_ID_LENGTH_OFFSET + THdr::CLIENT_ID_LENGTH_SIZE +
+        static_cast<size_t>(std::max<int16_t>(client_id_len, 0))) >
+       request_size)) {
+    THROW_ERROR(TBadClientIdLength);
+  }
+}
@@ -0,0 +1,76 @@
+/* <dory/kafka_proto/api_versions/api_versions_request_reader.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for reading Kafka ApiVersions requests.  Used by the mock Kafka
+   server.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include <base/field_access.h>
+#include <base/thrower.h>
+#include <dory/kafka_proto/api_versions/api_versions_request_fields.h>
+
+namespace Dory {
+
+  namespace KafkaProto {
+
+    namespace ApiVersions {
+
+      class TApiVersionsRequestReader final {
+        using THdr = TApiVersionsRequestFields;
+
+        public:
+        DEFINE_ERROR(TBadRequestSize, std::runtime_error,
+            "Invalid Kafka ApiVersions request size");
+
+        DEFINE_ERROR(TWrongRequestType, std::runtime_error,
+            "Expected Kafka ApiVersions request but got some other request "
+            "type");
+
+        DEFINE_ERROR(TBadClientIdLength, std::runtime_error,
+            "Bad client ID length in Kafka ApiVersions request");
+
+        /* Construct a reader for an ApiVersions request of size
+           'request_size' starting at 'request'. */
+        TApiVersionsRequestReader(const void *request, size_t request_size);
+
+        int16_t GetApiVersion() const {
+          assert(this);
+          return ReadInt16FromHeader(Begin + THdr::API_VERSION_OFFSET);
+        }
+
+        int32_t GetCorrelationId() const {
+          assert(this);
+          return ReadInt32FromHeader(Begin + THdr::CORRELATION_ID_OFFSET);
+        }
+
+        private:
+        const uint8_t *Begin;
+      };  // TApiVersionsRequestReader
+
+    }  // ApiVersions
+
+  }  // KafkaProto
+
+}  // Dory
@@ -0,0 +1,54 @@
+/* <dory/kafka_proto/api_versions/api_versions_request_writer.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for writing Kafka ApiVersions requests.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <base/no_copy_semantics.h>
+#include <dory/kafka_proto/api_versions/api_versions_request_fields.h>
+
+namespace Dory {
+
+  namespace KafkaProto {
+
+    namespace ApiVersions {
+
+      class TApiVersionsRequestWriter final {
+        NO_COPY_SEMANTICS(TApiVersionsRequestWriter);
+
+        using THdr = TApiVersionsRequestFields;
+
+        public:
+        TApiVersionsRequestWriter() = default;
+
+        /* Write an ApiVersions request with the given correlation ID to
+           'result'.  Resize 'result' to the size of the written request. */
+        void WriteRequest(std::vector<uint8_t> &result,
+            int32_t correlation_id);
+      };  // TApiVersionsRequestWriter
+
+    }  // ApiVersions
+
+  }  // KafkaProto
+
+}  // Dory
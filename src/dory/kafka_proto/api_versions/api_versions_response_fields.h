@@ -0,0 +1,82 @@
+/* <dory/kafka_proto/api_versions/api_versions_response_fields.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Field sizes and offsets for version 0 of Kafka ApiVersions responses.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <dory/kafka_proto/request_response.h>
+
+namespace Dory {
+
+  namespace KafkaProto {
+
+    namespace ApiVersions {
+
+      class TApiVersionsResponseFields final {
+        public:
+        static const size_t CORRELATION_ID_SIZE = 4;
+
+        static const size_t ERROR_CODE_SIZE = 2;
+
+        static const size_t API_COUNT_SIZE = 4;
+
+        static const size_t API_KEY_SIZE = 2;
+
+        static const size_t MIN_VERSION_SIZE = 2;
+
+        static const size_t MAX_VERSION_SIZE = 2;
+
+        static const size_t API_LIST_ITEM_SIZE =
+            API_KEY_SIZE + MIN_VERSION_SIZE + MAX_VERSION_SIZE;
+
+        static const size_t RESPONSE_SIZE_OFFSET = 0;
+
+        static const size_t CORRELATION_ID_OFFSET = RESPONSE_SIZE_OFFSET +
+            REQUEST_OR_RESPONSE_SIZE_SIZE;
+
+        static const size_t ERROR_CODE_OFFSET = CORRELATION_ID_OFFSET +
+            CORRELATION_ID_SIZE;
+
+        static const size_t API_COUNT_OFFSET = ERROR_CODE_OFFSET +
+            ERROR_CODE_SIZE;
+
+        static const size_t API_LIST_OFFSET = API_COUNT_OFFSET +
+            API_COUNT_SIZE;
+
+        /* relative to start of API list item */
+        static const size_t REL_API_KEY_OFFSET = 0;
+
+        /* relative to start of API list item */
+        static const size_t REL_MIN_VERSION_OFFSET = REL_API_KEY_OFFSET +
+            API_KEY_SIZE;
+
+        /* relative to start of API list item */
+        static const size_t REL_MAX_VERSION_OFFSET = REL_MIN_VERSION_OFFSET +
+            MIN_VERSION_SIZE;
+      };  // TApiVersionsResponseFields
+
+    }  // ApiVersions
+
+  }  // KafkaProto
+
+}  // Dory
@@ -0,0 +1,120 @@
+/* <dory/kafka_proto/api_versions/api_versions_response_reader.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/kafka_proto/api_versions/api_versions_response_reader.h>.
+ */
+
+#include <dory/kafka_proto/api_versions/api_versions_response_reader.h>
+
+#include <base/field_access.h>
+#include <server/counter.h>
+
+using namespace Dory;
+using namespace Dory::KafkaProto::ApiVersions;
+
+SERVER_COUNTER(ApiVersionsResponseIncomplete);
+SERVER_COUNTER(ApiVersionsResponseNegativeApiCount);
+
+TApiVersionsResponseReader::TApiVersionsResponseReader(const void *buf,
+    size_t buf_size)
+    : Buf(reinterpret_cast<const uint8_t *>(buf)),
+      BufSize(buf_size),
+      ApiCount(0),
+      ApisLeft(0),
+      CurrentApiOffset(0) {
+  assert(Buf);
+
+  if (BufSize < MinSize()) {
+    ApiVersionsResponseIncomplete.Increment();
+    THROW_ERROR(TIncompleteApiVersionsResponse);
+  }
+
+  int32_t count = ReadInt32FromHeader(Buf + THdr::API_COUNT_OFFSET);
+
+  if (count < 0) {
+    ApiVersionsResponseNegativeApiCount.Increment();
+    THROW_ERROR(TNegativeApiCount);
+  }
+
+  ApiCount = static_cast<size_t>(count);
+
+  if (((BufSize - THdr::API_LIST_OFFSET) / THdr::API_LIST_ITEM_SIZE) <
+      ApiCount) {
+    ApiVersionsResponseIncomplete.Increment();
+    THROW_ERROR(TIncompleteApiVersionsResponse);
+  }
+
+  ApisLeft = ApiCount;
+}
+
+int32_t TApiVersionsResponseReader::GetCorrelationId() const {
+  assert(this);
+  return ReadInt32FromHeader(Buf + THdr::CORRELATION_ID_OFFSET);
+}
+
+int16_t TApiVersionsResponseReader::GetErrorCode() const {
+  assert(this);
+  return ReadInt16FromHeader(Buf + THdr::ERROR_CODE_OFFSET);
+}
+
+bool TApiVersionsResponseReader::NextApi() {
+  assert(this);
+
+  if (ApisLeft == 0) {
+    return false;
+  }
+
+  CurrentApiOffset = (CurrentApiOffset == 0) ?
+      THdr::API_LIST_OFFSET : (CurrentApiOffset + THdr::API_LIST_ITEM_SIZE);
+  --ApisLeft;
+  return true;
+}
+
+int16_t TApiVersionsResponseReader::GetCurrentApiKey() const {
+  assert(this);
+  assert(CurrentApiOffset);
+  return ReadInt16FromHeader(Buf + CurrentApiOffset +
+      THdr::REL_API_KEY_OFFSET);
+}
+
+int16_t TApiVersionsResponseReader::GetCurrentMinVersion() const {
+  assert(this);
+  assert(CurrentApiOffset);
+  return ReadInt16FromHeader(Buf + CurrentApiOffset +
+      THdr::REL_MIN_VERSION_OFFSET);
+}
+
+int16_t TApiVersionsResponseReader::GetCurrentMaxVersion() const {
+  assert(this);
+  assert(CurrentApiOffset);
+  return ReadInt16FromHeader(Buf + CurrentApiOffset +
+      THdr::REL_MAX_VERSION_OFFSET);
+}
+
+std::vector<TApiVersionRange> TApiVersionsResponseReader::GetAllApis() {
+  assert(this);
+  std::vector<TApiVersionRange> result;
+  result.reserve(ApisLeft);
+
+  while (NextApi()) {
+    result.push_back(TApiVersionRange(GetCurrentApiKey(),
+        GetCurrentMinVersion(), GetCurrentMaxVersion()));
+  }
+
+  return result;
+}
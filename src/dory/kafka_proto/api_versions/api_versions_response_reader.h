@@ -0,0 +1,110 @@
+/* <dory/kafka_proto/api_versions/api_versions_response_reader.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for reading version 0 Kafka ApiVersions responses.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <base/thrower.h>
+#include <dory/kafka_proto/api_versions/api_version_range.h>
+#include <dory/kafka_proto/api_versions/api_versions_response_fields.h>
+#include <dory/kafka_proto/request_response.h>
+
+namespace Dory {
+
+  namespace KafkaProto {
+
+    namespace ApiVersions {
+
+      class TApiVersionsResponseReader final {
+        using THdr = TApiVersionsResponseFields;
+
+        public:
+        class TBadApiVersionsResponse : public std::runtime_error {
+          protected:
+          explicit TBadApiVersionsResponse(const char *msg)
+              : std::runtime_error(msg) {
+          }
+
+          public:
+          virtual ~TBadApiVersionsResponse() noexcept { }
+        };  // TBadApiVersionsResponse
+
+        DEFINE_ERROR(TIncompleteApiVersionsResponse, TBadApiVersionsResponse,
+            "Kafka ApiVersions response is incomplete");
+
+        DEFINE_ERROR(TNegativeApiCount, TBadApiVersionsResponse,
+            "Kafka ApiVersions response has negative API count");
+
+        static size_t MinSize() {
+          return THdr::API_LIST_OFFSET;
+        }
+
+        /* 'buf' points to a complete response of size 'buf_size', including
+           the leading size field.  Throws a subclass of
+           TBadApiVersionsResponse if the response is malformed. */
+        TApiVersionsResponseReader(const void *buf, size_t buf_size);
+
+        int32_t GetCorrelationId() const;
+
+        int16_t GetErrorCode() const;
+
+        size_t GetApiCount() const {
+          assert(this);
+          return ApiCount;
+        }
+
+        /* Advance to the next item in the API list.  Return false if there
+           are no more items. */
+        bool NextApi();
+
+        int16_t GetCurrentApiKey() const;
+
+        int16_t GetCurrentMinVersion() const;
+
+        int16_t GetCurrentMaxVersion() const;
+
+        /* Convenience method that reads the entire API list. */
+        std::vector<TApiVersionRange> GetAllApis();
+
+        private:
+        const uint8_t * const Buf;
+
+        const size_t BufSize;
+
+        size_t ApiCount;
+
+        size_t ApisLeft;
+
+        /* Offset of current API list item, or 0 if NextApi() has not yet been
+           called. */
+        size_t CurrentApiOffset;
+      };  // TApiVersionsResponseReader
+
+    }  // ApiVersions
+
+  }  // KafkaProto
+
+}  // Dory
@@ -0,0 +1,55 @@
+/* <dory/kafka_proto/api_versions/api_versions_response_writer.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/kafka_proto/api_versions/api_versions_response_writer.h>.
+ */
+
+#include <dory/kafka_proto/api_versions/api_versions_response_writer.h>
+
+#include <cassert>
+
+#include <base/field_access.h>
+#include <dory/kafka_proto/request_response.h>
+
+using namespace Dory;
+using namespace Dory::KafkaProto;
+using namespace Dory::KafkaProto::ApiVersions;
+
+void TApiVersionsResponseWriter::WriteResponse(std::vector<uint8_t> &out,
+    int32_t correlation_id, int16_t error_code,
+    const std::vector<TApiVersionRange> &apis) {
+  assert(this);
+  out.resize(THdr::API_LIST_OFFSET + (apis.size() * THdr::API_LIST_ITEM_SIZE));
+  uint8_t *buf = &out[0];
+  WriteInt32ToHeader(buf + THdr::RESPONSE_SIZE_OFFSET,
+      static_cast<int32_t>(out.size() - REQUEST_OR_RESPONSE_SIZE_SIZE));
+  WriteInt32ToHeader(buf + THdr::CORRELATION_ID_OFFSET, correlation_id);
+  WriteInt16ToHeader(buf + THdr::ERROR_CODE_OFFSET, error_code);
+  WriteInt32ToHeader(buf + THdr::API_COUNT_OFFSET,
+      static_cast<int32_t>(apis.size()));
+  size_t offset = THdr::API_LIST_OFFSET;
+
+  for (const TApiVersionRange &api : apis) {
+    WriteInt16ToHeader(buf + offset + THdr::REL_API_KEY_OFFSET, api.ApiKey);
+    WriteInt16ToHeader(buf + offset + THdr::REL_MIN_VERSION_OFFSET,
+        api.MinVersion);
+    WriteInt16ToHeader(buf + offset + THdr::REL_MAX_VERSION_OFFSET,
+        api.MaxVersion);
+    offset += THdr::API_LIST_ITEM_SIZE;
+  }
+}
@@ -26,6 +26,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include <base/no_copy_semantics.h>
@@ -55,6 +56,10 @@ namespace Dory {
               std::vector<uint8_t> &result, const char *topic,
               int32_t correlation_id) const override;
 
+          virtual void WriteTopicsMetadataRequest(std::vector<uint8_t> &result,
+              const std::vector<std::string> &topics,
+              int32_t correlation_id) const override;
+
           virtual TMetadata *BuildMetadataFromResponse(
               const void *response_buf,
               size_t response_buf_size) const override;
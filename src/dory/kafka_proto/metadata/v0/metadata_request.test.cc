@@ -128,6 +128,40 @@ namespace {
     ASSERT_TRUE(reader->GetTopicEnd() == nullptr);
   }
 
+  TEST_F(TMetadataRequestTest, MultiTopicTest) {
+    const std::vector<std::string> topics = {"topic1", "another topic"};
+    std::vector<uint8_t> buf;
+    TMetadataRequestWriter().WriteMultiTopicRequest(buf, topics, 12345);
+    ASSERT_EQ(buf.size(), TMetadataRequestFields::TOPIC_NAME_LENGTH_OFFSET +
+        (2 * TMetadataRequestFields::TOPIC_NAME_LENGTH_SIZE) +
+        topics[0].size() + topics[1].size());
+    ASSERT_EQ(static_cast<size_t>(ReadInt32FromHeader(&buf[0])),
+        buf.size() - TMetadataRequestFields::REQUEST_SIZE_SIZE);
+    ASSERT_EQ(ReadInt32FromHeader(
+        &buf[TMetadataRequestFields::CORRELATION_ID_OFFSET]), 12345);
+    ASSERT_EQ(ReadInt32FromHeader(
+        &buf[TMetadataRequestFields::TOPIC_COUNT_OFFSET]), 2);
+    size_t offset = TMetadataRequestFields::TOPIC_NAME_LENGTH_OFFSET;
+
+    for (const std::string &topic : topics) {
+      ASSERT_EQ(static_cast<size_t>(ReadInt16FromHeader(&buf[offset])),
+          topic.size());
+      offset += TMetadataRequestFields::TOPIC_NAME_LENGTH_SIZE;
+      std::string topic_copy(reinterpret_cast<const char *>(&buf[offset]),
+          topic.size());
+      ASSERT_EQ(topic_copy, topic);
+      offset += topic.size();
+    }
+
+    /* A request for one topic is the same as a single topic request. */
+    TMetadataRequestWriter().WriteMultiTopicRequest(buf,
+        std::vector<std::string>(1, topics[0]), 12345);
+    std::vector<uint8_t> single_buf;
+    TMetadataRequestWriter().WriteSingleTopicRequest(single_buf,
+        topics[0].data(), topics[0].data() + topics[0].size(), 12345);
+    ASSERT_EQ(buf, single_buf);
+  }
+
 }  // namespace
 
 int main(int argc, char **argv) {
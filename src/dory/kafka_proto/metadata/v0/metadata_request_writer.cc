@@ -73,6 +73,43 @@ void TMetadataRequestWriter::WriteAllTopicsRequest(
   WriteHeader(&result[0], 0, correlation_id);
 }
 
+void TMetadataRequestWriter::WriteMultiTopicRequest(
+    std::vector<uint8_t> &result, const std::vector<std::string> &topics,
+    int32_t correlation_id) {
+  assert(this);
+  assert(!topics.empty());
+  size_t request_size = NUM_ALL_TOPICS_HEADER_BYTES;
+
+  for (const std::string &topic : topics) {
+    assert(!topic.empty());
+    assert(topic.size() <=
+           static_cast<size_t>(std::numeric_limits<int16_t>::max()));
+    request_size += THdr::TOPIC_NAME_LENGTH_SIZE + topic.size();
+  }
+
+  result.resize(request_size);
+  uint8_t *buf = &result[0];
+  WriteInt32ToHeader(buf,
+      static_cast<int32_t>(request_size - THdr::REQUEST_SIZE_SIZE));
+  WriteInt16ToHeader(buf + THdr::API_KEY_OFFSET, THdr::API_KEY);
+  WriteInt16ToHeader(buf + THdr::API_VERSION_OFFSET, THdr::API_VERSION);
+  WriteInt32ToHeader(buf + THdr::CORRELATION_ID_OFFSET, correlation_id);
+  WriteInt16ToHeader(buf + THdr::CLIENT_ID_LENGTH_OFFSET,
+                     THdr::EMPTY_STRING_LENGTH);
+  WriteInt32ToHeader(buf + THdr::TOPIC_COUNT_OFFSET,
+                     static_cast<int32_t>(topics.size()));
+  size_t offset = THdr::TOPIC_NAME_LENGTH_OFFSET;
+
+  for (const std::string &topic : topics) {
+    WriteInt16ToHeader(buf + offset, static_cast<int16_t>(topic.size()));
+    offset += THdr::TOPIC_NAME_LENGTH_SIZE;
+    std::memcpy(buf + offset, topic.data(), topic.size());
+    offset += topic.size();
+  }
+
+  assert(offset == request_size);
+}
+
 void TMetadataRequestWriter::WriteHeader(void *header_buf, size_t topic_size,
     int32_t correlation_id) {
   assert(this);
@@ -24,6 +24,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include <sys/uio.h>
@@ -39,12 +40,14 @@ namespace Dory {
 
       namespace V0 {
 
-        /* To keep things simple, this class only supports two kinds of
+        /* To keep things simple, this class only supports three kinds of
            metadata requests:
 
                1.  A request for a single topic.
                2.  A request for all topics, which is specified by leaving the
                    topic list empty.
+               3.  A request for a nonempty list of topics.  This is only
+                   written (not read).
          */
         class TMetadataRequestWriter final {
           NO_COPY_SEMANTICS(TMetadataRequestWriter);
@@ -98,6 +101,12 @@ namespace Dory {
           void WriteAllTopicsRequest(std::vector<uint8_t> &result,
               int32_t correlation_id);
 
+          /* Write a request for the topics in 'topics', which must not be
+             empty, with the given correlation ID to 'result'.  Resize
+             'result' to the size of the written request. */
+          void WriteMultiTopicRequest(std::vector<uint8_t> &result,
+              const std::vector<std::string> &topics, int32_t correlation_id);
+
           private:
           static const size_t NUM_SINGLE_TOPIC_HEADER_BYTES =
               THdr::TOPIC_NAME_LENGTH_OFFSET + THdr::TOPIC_NAME_LENGTH_SIZE;
@@ -25,6 +25,7 @@
 #include <algorithm>
 
 #include <dory/kafka_proto/metadata/v0/metadata_proto.h>
+#include <dory/kafka_proto/metadata/v1/metadata_proto.h>
 
 using namespace Dory;
 using namespace Dory::KafkaProto;
@@ -32,8 +33,16 @@ using namespace Dory::KafkaProto::Metadata;
 
 TMetadataProtocol *Dory::KafkaProto::Metadata::ChooseMetadataProto(
     size_t api_version) {
-  if (api_version == 0) {
-    return new Dory::KafkaProto::Metadata::V0::TMetadataProto;
+  switch (api_version) {
+    case 0: {
+      return new Dory::KafkaProto::Metadata::V0::TMetadataProto;
+    }
+    case 1: {
+      return new Dory::KafkaProto::Metadata::V1::TMetadataProto;
+    }
+    default: {
+      break;
+    }
   }
 
   return nullptr;  // unsupported API version
@@ -41,7 +50,7 @@ TMetadataProtocol *Dory::KafkaProto::Metadata::ChooseMetadataProto(
 
 const std::vector<size_t> &
 Dory::KafkaProto::Metadata::GetSupportedMetadataApiVersions() {
-  static const std::vector<size_t> supported_versions = { 0 };
+  static const std::vector<size_t> supported_versions = { 0, 1 };
   return supported_versions;
 }
 
@@ -0,0 +1,139 @@
+/* <dory/latency_tracker.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/latency_tracker.h>.
+ */
+
+#include <dory/latency_tracker.h>
+
+#include <map>
+
+#include <base/no_default_case.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Util;
+
+const char *TLatencyTracker::StageToString(TStage stage) {
+  const char *text;
+
+  switch (stage) {
+    case TStage::Intake: {
+      text = "intake";
+      break;
+    }
+    case TStage::Batching: {
+      text = "batching";
+      break;
+    }
+    case TStage::SendWait: {
+      text = "send_wait";
+      break;
+    }
+    case TStage::AckWait: {
+      text = "ack_wait";
+      break;
+    }
+    case TStage::Total: {
+      text = "total";
+      break;
+    }
+    NO_DEFAULT_CASE;
+  }
+
+  return text;
+}
+
+TLatencyTracker::TRecorder::TRecorder(TLatencyTracker &tracker,
+    const std::string &topic, long broker_id)
+    : TRecorder(tracker.GetShard(), tracker.ByTopic, topic, broker_id) {
+}
+
+TLatencyTracker::TRecorder::TRecorder(TShard &shard, bool by_topic,
+    const std::string &topic, long broker_id)
+    : Lock(shard.Mutex),
+      AllTopicsHistograms(shard.AllTopics),
+      TopicHistograms(by_topic ? &shard.Topics[topic] : nullptr),
+      BrokerHistograms((broker_id < 0) ? nullptr : &shard.Brokers[broker_id]) {
+}
+
+TLatencyTracker::TSnapshot TLatencyTracker::GetSnapshot() const {
+  assert(this);
+
+  /* Use ordered maps so the output is sorted by topic and broker ID. */
+  std::map<std::string, THistograms> topics;
+  std::map<long, THistograms> brokers;
+  TSnapshot result;
+
+  for (const TShard &shard : Shards) {
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+      result.AllTopics[i].Merge(shard.AllTopics[i]);
+    }
+
+    for (const auto &item : shard.Topics) {
+      THistograms &h = topics[item.first];
+
+      for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        h[i].Merge(item.second[i]);
+      }
+    }
+
+    for (const auto &item : shard.Brokers) {
+      THistograms &h = brokers[item.first];
+
+      for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        h[i].Merge(item.second[i]);
+      }
+    }
+  }
+
+  for (auto &item : topics) {
+    result.Topics.emplace_back(item.first, std::move(item.second));
+  }
+
+  for (auto &item : brokers) {
+    result.Brokers.emplace_back(item.first, std::move(item.second));
+  }
+
+  return result;
+}
+
+void TLatencyTracker::PruneTopics(const TTopicExistsFn &topic_exists_fn) {
+  assert(this);
+
+  for (TShard &shard : Shards) {
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+
+    for (auto iter = shard.Topics.begin(); iter != shard.Topics.end(); ) {
+      if (topic_exists_fn(iter->first)) {
+        ++iter;
+      } else {
+        iter = shard.Topics.erase(iter);
+      }
+    }
+  }
+}
+
+TLatencyTracker::TShard &TLatencyTracker::GetShard() {
+  assert(this);
+  return Shards[TThreadShard::GetIndex()];
+}
+
+const size_t TLatencyTracker::STAGE_COUNT;
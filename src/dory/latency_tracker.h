@@ -0,0 +1,183 @@
+/* <dory/latency_tracker.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for tracking per-topic and per-broker message latencies.
+ */
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <base/no_copy_semantics.h>
+#include <base/thread_shard.h>
+#include <dory/util/histogram.h>
+
+namespace Dory {
+
+  /* Keeps latency histograms, in microseconds, for the time messages spend
+     in each stage of their journey through Dory.  TMsgStateTracker records
+     into this at its state transitions.  Histograms are kept for all topics
+     combined and, for the stages after a broker has been chosen, per broker.
+     Per-topic histograms are optional, since they cost a topic lookup for
+     each recorded value and memory for each topic.
+
+     Recording is split across per-thread shards (see <base/thread_shard.h>),
+     each with its own lock, so threads assigned different shards don't
+     contend.  GetSnapshot() merges the shards. */
+  class TLatencyTracker final {
+    NO_COPY_SEMANTICS(TLatencyTracker);
+
+    public:
+    enum class TStage {
+      /* Time from message creation until the message enters the batching or
+         send wait state. */
+      Intake,
+
+      /* Time spent in the batching state. */
+      Batching,
+
+      /* Time from entering the send wait state until the message is sent to
+         a broker.  A message that gets resent records this once for each
+         send attempt. */
+      SendWait,
+
+      /* Time from sending the message until a successful ACK arrives. */
+      AckWait,
+
+      /* Time from message creation until a successful ACK arrives. */
+      Total
+    };  // TStage
+
+    static const size_t STAGE_COUNT = 5;
+
+    /* Returns the name used for 'stage' in web interface output. */
+    static const char *StageToString(TStage stage);
+
+    using THistograms = std::array<Util::THistogram, STAGE_COUNT>;
+
+    private:
+    struct TShard;
+
+    public:
+
+    /* Merged histograms for all topics combined, and for all topics (if
+       enabled) and brokers with recorded values.  Histograms for stages with
+       nothing recorded are empty.  Per-broker entries only have values for
+       stages SendWait, AckWait, and Total. */
+    struct TSnapshot {
+      THistograms AllTopics;
+
+      /* Empty unless per-topic histograms are enabled. */
+      std::vector<std::pair<std::string, THistograms>> Topics;
+
+      std::vector<std::pair<long, THistograms>> Brokers;
+    };  // TSnapshot
+
+    /* Records latencies for one topic, and optionally one broker, into the
+       calling thread's shard.  Holds the shard's lock while it exists, so
+       keep it short-lived.  Create one per group of messages with the same
+       topic, rather than one per message, where possible. */
+    class TRecorder final {
+      NO_COPY_SEMANTICS(TRecorder);
+
+      public:
+      /* A negative 'broker_id' means no broker. */
+      TRecorder(TLatencyTracker &tracker, const std::string &topic,
+          long broker_id);
+
+      void Record(TStage stage, uint64_t usec) {
+        assert(this);
+        size_t index = static_cast<size_t>(stage);
+        AllTopicsHistograms[index].Record(usec);
+
+        if (TopicHistograms) {
+          (*TopicHistograms)[index].Record(usec);
+        }
+
+        if (BrokerHistograms) {
+          (*BrokerHistograms)[index].Record(usec);
+        }
+      }
+
+      private:
+      TRecorder(TShard &shard, bool by_topic, const std::string &topic,
+          long broker_id);
+
+      std::lock_guard<std::mutex> Lock;
+
+      THistograms &AllTopicsHistograms;
+
+      /* Null if per-topic histograms are disabled. */
+      THistograms *TopicHistograms;
+
+      THistograms *BrokerHistograms;
+    };  // TRecorder
+
+    /* If 'by_topic' is true, histograms are also kept per topic. */
+    explicit TLatencyTracker(bool by_topic)
+        : ByTopic(by_topic) {
+    }
+
+    bool IsByTopic() const {
+      assert(this);
+      return ByTopic;
+    }
+
+    TSnapshot GetSnapshot() const;
+
+    /* A topic name is passed as a parameter.  Function returns true if topic
+       is present in metadata or false otherwise. */
+    using TTopicExistsFn = std::function<bool(const std::string &)>;
+
+    /* Delete histograms for topics that are no longer present in the
+       metadata. */
+    void PruneTopics(const TTopicExistsFn &topic_exists_fn);
+
+    private:
+    struct TShard {
+      /* Protects 'AllTopics', 'Topics', and 'Brokers'. */
+      mutable std::mutex Mutex;
+
+      THistograms AllTopics;
+
+      /* Keys are topics.  Empty unless per-topic histograms are enabled. */
+      std::unordered_map<std::string, THistograms> Topics;
+
+      /* Keys are broker IDs. */
+      std::unordered_map<long, THistograms> Brokers;
+    };  // TShard
+
+    /* Return the shard that the calling thread records into. */
+    TShard &GetShard();
+
+    /* See IsByTopic(). */
+    const bool ByTopic;
+
+    std::array<TShard, Base::TThreadShard::COUNT> Shards;
+  };  // TLatencyTracker
+
+}  // Dory
@@ -0,0 +1,200 @@
+/* <dory/latency_tracker.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/latency_tracker.h>.
+ */
+
+#include <dory/latency_tracker.h>
+
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <base/time_util.h>
+#include <dory/msg.h>
+#include <dory/msg_state_tracker.h>
+#include <dory/test_util/misc_util.h>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::TestUtil;
+
+namespace {
+
+  using TStage = TLatencyTracker::TStage;
+
+  const Util::THistogram &GetHistogram(
+      const TLatencyTracker::THistograms &histograms, TStage stage) {
+    return histograms[static_cast<size_t>(stage)];
+  }
+
+  /* The fixture for testing class TLatencyTracker. */
+  class TLatencyTrackerTest : public ::testing::Test {
+    protected:
+    TLatencyTrackerTest() {
+    }
+
+    virtual ~TLatencyTrackerTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TLatencyTrackerTest
+
+  TEST_F(TLatencyTrackerTest, StateTransitionTest) {
+    TTestMsgCreator mc;
+    TMsgStateTracker &tracker = mc.MsgStateTracker;
+    std::list<TMsg::TPtr> msg_list;
+    msg_list.push_back(mc.NewMsg("t1", "msg 1", 0));
+    msg_list.push_back(mc.NewMsg("t1", "msg 2", 0));
+    TMsg::TPtr other = mc.NewMsg("t2", "msg 3", 0);
+
+    for (const TMsg::TPtr &msg : msg_list) {
+      tracker.MsgEnterBatching(*msg);
+    }
+
+    SleepMilliseconds(2);
+    tracker.MsgEnterSendWait(msg_list);
+    tracker.MsgEnterAckWait(msg_list, 5);
+
+    /* A resend records nothing for the failed attempt. */
+    tracker.MsgEnterSendWait(msg_list);
+    tracker.MsgEnterAckWait(msg_list, 5);
+    tracker.MsgEnterProcessedOnAck(msg_list, 5);
+
+    /* A discard records no ACK latency. */
+    tracker.MsgEnterSendWait(*other);
+    tracker.MsgEnterProcessed(*other);
+
+    TLatencyTracker::TSnapshot snapshot =
+        tracker.GetLatencyTracker().GetSnapshot();
+    const TLatencyTracker::THistograms &all = snapshot.AllTopics;
+    ASSERT_EQ(GetHistogram(all, TStage::Intake).GetCount(), 3U);
+    ASSERT_EQ(GetHistogram(all, TStage::Batching).GetCount(), 2U);
+    ASSERT_EQ(GetHistogram(all, TStage::SendWait).GetCount(), 4U);
+    ASSERT_EQ(GetHistogram(all, TStage::AckWait).GetCount(), 2U);
+    ASSERT_EQ(GetHistogram(all, TStage::Total).GetCount(), 2U);
+
+    ASSERT_EQ(snapshot.Topics.size(), 2U);
+    ASSERT_EQ(snapshot.Topics[0].first, "t1");
+    const TLatencyTracker::THistograms &t1 = snapshot.Topics[0].second;
+    ASSERT_EQ(GetHistogram(t1, TStage::Intake).GetCount(), 2U);
+    ASSERT_EQ(GetHistogram(t1, TStage::Batching).GetCount(), 2U);
+    ASSERT_GE(GetHistogram(t1, TStage::Batching).GetMax(), 2000U);
+    ASSERT_EQ(GetHistogram(t1, TStage::SendWait).GetCount(), 4U);
+    ASSERT_EQ(GetHistogram(t1, TStage::AckWait).GetCount(), 2U);
+    ASSERT_EQ(GetHistogram(t1, TStage::Total).GetCount(), 2U);
+    ASSERT_GE(GetHistogram(t1, TStage::Total).GetMax(), 2000U);
+
+    ASSERT_EQ(snapshot.Topics[1].first, "t2");
+    const TLatencyTracker::THistograms &t2 = snapshot.Topics[1].second;
+    ASSERT_EQ(GetHistogram(t2, TStage::Intake).GetCount(), 1U);
+    ASSERT_TRUE(GetHistogram(t2, TStage::AckWait).IsEmpty());
+    ASSERT_TRUE(GetHistogram(t2, TStage::Total).IsEmpty());
+
+    /* Only the stages after broker selection are recorded per broker. */
+    ASSERT_EQ(snapshot.Brokers.size(), 1U);
+    ASSERT_EQ(snapshot.Brokers[0].first, 5);
+    const TLatencyTracker::THistograms &b5 = snapshot.Brokers[0].second;
+    ASSERT_TRUE(GetHistogram(b5, TStage::Intake).IsEmpty());
+    ASSERT_TRUE(GetHistogram(b5, TStage::Batching).IsEmpty());
+    ASSERT_EQ(GetHistogram(b5, TStage::SendWait).GetCount(), 4U);
+    ASSERT_EQ(GetHistogram(b5, TStage::AckWait).GetCount(), 2U);
+    ASSERT_EQ(GetHistogram(b5, TStage::Total).GetCount(), 2U);
+
+    tracker.PruneTopics(
+        [](const std::string &topic) {
+          return (topic == "t2");
+        });
+    snapshot = tracker.GetLatencyTracker().GetSnapshot();
+    ASSERT_EQ(snapshot.Topics.size(), 1U);
+    ASSERT_EQ(snapshot.Topics[0].first, "t2");
+  }
+
+  TEST_F(TLatencyTrackerTest, ManyThreadsTest) {
+    static const size_t thread_count = 24;
+    static const size_t record_count = 1000;
+    TLatencyTracker tracker(true);
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back(
+          [&tracker, i] {
+            for (size_t j = 0; j < record_count; ++j) {
+              TLatencyTracker::TRecorder recorder(tracker, "t",
+                  static_cast<long>(i % 2));
+              recorder.Record(TStage::AckWait, j);
+            }
+          });
+    }
+
+    for (std::thread &t : threads) {
+      t.join();
+    }
+
+    TLatencyTracker::TSnapshot snapshot = tracker.GetSnapshot();
+    ASSERT_EQ(snapshot.Topics.size(), 1U);
+    ASSERT_EQ(GetHistogram(snapshot.Topics[0].second,
+        TStage::AckWait).GetCount(), thread_count * record_count);
+    ASSERT_EQ(snapshot.Brokers.size(), 2U);
+    ASSERT_EQ(GetHistogram(snapshot.Brokers[1].second,
+        TStage::AckWait).GetCount(), (thread_count / 2) * record_count);
+    ASSERT_EQ(GetHistogram(snapshot.AllTopics, TStage::AckWait).GetCount(),
+        thread_count * record_count);
+  }
+
+  TEST_F(TLatencyTrackerTest, NoTopicBreakdownTest) {
+    TLatencyTracker tracker(false);
+    ASSERT_FALSE(tracker.IsByTopic());
+
+    {
+      TLatencyTracker::TRecorder recorder(tracker, "t1", -1);
+      recorder.Record(TStage::Intake, 10);
+    }
+
+    {
+      TLatencyTracker::TRecorder recorder(tracker, "t2", 3);
+      recorder.Record(TStage::AckWait, 20);
+      recorder.Record(TStage::Total, 30);
+    }
+
+    TLatencyTracker::TSnapshot snapshot = tracker.GetSnapshot();
+    ASSERT_TRUE(snapshot.Topics.empty());
+    ASSERT_EQ(GetHistogram(snapshot.AllTopics, TStage::Intake).GetCount(),
+        1U);
+    ASSERT_EQ(GetHistogram(snapshot.AllTopics, TStage::AckWait).GetCount(),
+        1U);
+    ASSERT_EQ(GetHistogram(snapshot.AllTopics, TStage::Total).GetMax(), 30U);
+    ASSERT_EQ(snapshot.Brokers.size(), 1U);
+    ASSERT_EQ(snapshot.Brokers[0].first, 3);
+    ASSERT_EQ(GetHistogram(snapshot.Brokers[0].second,
+        TStage::Total).GetCount(), 1U);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -23,6 +23,7 @@
 
 #include <functional>
 #include <memory>
+#include <unordered_map>
 #include <utility>
 
 #include <syslog.h>
@@ -39,14 +40,16 @@ SERVER_COUNTER(MetadataSanityCheckSuccess);
 bool TMetadata::TBroker::operator==(const TBroker &that) const {
   assert(this);
   return (Id == that.Id) && (Hostname == that.Hostname) &&
-         (Port == that.Port) && (InService == that.InService);
+         (Port == that.Port) && (Rack == that.Rack) &&
+         (InService == that.InService);
 }
 
 TMetadata::TBuilder::TBuilder()
     : RandomEngine(GetEpochMilliseconds()),
       State(TState::Initial),
       CurrentTopicIndex(0),
-      InServiceBrokerCount(0) {
+      InServiceBrokerCount(0),
+      ControllerId(-1) {
 }
 
 void TMetadata::TBuilder::OpenBrokerList() {
@@ -56,7 +59,7 @@ void TMetadata::TBuilder::OpenBrokerList() {
 }
 
 void TMetadata::TBuilder::AddBroker(int32_t kafka_id, std::string &&hostname,
-    uint16_t port) {
+    uint16_t port, std::string &&rack) {
   assert(this);
   assert(State == TState::AddingBrokers);
   auto result = BrokerMap.insert(std::make_pair(kafka_id, Brokers.size()));
@@ -65,7 +68,8 @@ void TMetadata::TBuilder::AddBroker(int32_t kafka_id, std::string &&hostname,
     THROW_ERROR(TDuplicateBroker);
   }
 
-  Brokers.push_back(TBroker(kafka_id, std::move(hostname), port));
+  Brokers.push_back(TBroker(kafka_id, std::move(hostname), port,
+      std::move(rack)));
 }
 
 void TMetadata::TBuilder::CloseBrokerList() {
@@ -229,7 +233,7 @@ TMetadata *TMetadata::TBuilder::Build() {
   GroupInServiceBrokers();
   assert(InServiceBrokerCount <= Brokers.size());
   std::unique_ptr<TMetadata> result(
-      new TMetadata(std::move(Brokers), InServiceBrokerCount,
+      new TMetadata(std::move(Brokers), InServiceBrokerCount, ControllerId,
                     std::move(TopicBrokerVec), std::move(Topics),
                     std::move(TopicNameToIndex)));
   Reset();
@@ -348,6 +352,142 @@ int TMetadata::FindTopicIndex(const std::string &topic) const {
   return topic_index;
 }
 
+/* Helper for MapUnchangedBrokers().  For each partition in 'old_partitions'
+   whose broker is still mapped in 'broker_map', unmap the broker unless
+   'new_partitions' contains the same partition with the same error code and a
+   leader at the mapped index.  A null 'new_partitions' indicates that the
+   topic no longer exists. */
+static void CheckPartitionLeaders(
+    const std::vector<TMetadata::TPartition> &old_partitions,
+    const std::vector<TMetadata::TPartition> *new_partitions,
+    std::vector<int> &broker_map) {
+  /* Key is partition ID. */
+  std::unordered_map<int32_t, const TMetadata::TPartition *> new_map;
+
+  if (new_partitions) {
+    for (const TMetadata::TPartition &p : *new_partitions) {
+      new_map[p.GetId()] = &p;
+    }
+  }
+
+  for (const TMetadata::TPartition &p : old_partitions) {
+    size_t old_index = p.GetBrokerIndex();
+
+    if ((old_index >= broker_map.size()) || (broker_map[old_index] < 0)) {
+      continue;
+    }
+
+    auto iter = new_map.find(p.GetId());
+
+    if ((iter == new_map.end()) ||
+        (iter->second->GetBrokerIndex() !=
+            static_cast<size_t>(broker_map[old_index])) ||
+        (iter->second->GetErrorCode() != p.GetErrorCode())) {
+      broker_map[old_index] = -1;
+    }
+  }
+}
+
+std::vector<int> TMetadata::MapUnchangedBrokers(const TMetadata &old_md,
+    const TMetadata &new_md) {
+  std::vector<int> result(old_md.InServiceBrokerCount, -1);
+
+  /* Key is Kafka ID, and value is index in 'new_md.Brokers'. */
+  std::unordered_map<int32_t, size_t> new_id_map;
+
+  for (size_t i = 0; i < new_md.InServiceBrokerCount; ++i) {
+    new_id_map[new_md.Brokers[i].GetId()] = i;
+  }
+
+  for (size_t i = 0; i < result.size(); ++i) {
+    const TBroker &old_broker = old_md.Brokers[i];
+    auto iter = new_id_map.find(old_broker.GetId());
+
+    if ((iter != new_id_map.end()) &&
+        (new_md.Brokers[iter->second] == old_broker)) {
+      result[i] = static_cast<int>(iter->second);
+    }
+  }
+
+  for (const auto &item : old_md.TopicNameToIndex) {
+    const TTopic &old_topic = old_md.Topics[item.second];
+    int new_topic_index = new_md.FindTopicIndex(item.first);
+    const TTopic *new_topic = (new_topic_index < 0) ?
+        nullptr : &new_md.Topics[new_topic_index];
+
+    /* Checking the OK partitions catches a partition that stays with the
+       same broker, but becomes unavailable. */
+    CheckPartitionLeaders(old_topic.OkPartitions,
+        new_topic ? &new_topic->OkPartitions : nullptr, result);
+    CheckPartitionLeaders(old_topic.AllPartitions,
+        new_topic ? &new_topic->AllPartitions : nullptr, result);
+  }
+
+  return result;
+}
+
+/* Helper for MergeTopics().  Add topic 't' of metadata 'md' to 'builder'. */
+static void AddTopicToBuilder(TMetadata::TBuilder &builder,
+    const TMetadata &md, const std::string &name, const TMetadata::TTopic &t) {
+  std::unordered_set<int32_t> ok_partitions;
+
+  for (const TMetadata::TPartition &p : t.GetOkPartitions()) {
+    ok_partitions.insert(p.GetId());
+  }
+
+  builder.OpenTopic(name);
+
+  for (const TMetadata::TPartition &p : t.GetAllPartitions()) {
+    builder.AddPartitionToTopic(p.GetId(),
+        md.GetBrokers()[p.GetBrokerIndex()].GetId(),
+        ok_partitions.count(p.GetId()) != 0, p.GetErrorCode());
+  }
+
+  builder.CloseTopic();
+}
+
+TMetadata *TMetadata::MergeTopics(const TMetadata &md, const TMetadata &from,
+    const std::vector<std::string> &topics) {
+  std::unordered_set<std::string> from_topics;
+
+  for (const std::string &topic : topics) {
+    if (from.FindTopicIndex(topic) >= 0) {
+      from_topics.insert(topic);
+    }
+  }
+
+  TBuilder builder;
+  builder.OpenBrokerList();
+  std::unordered_set<int32_t> broker_ids;
+
+  const TMetadata *sources[] = {&md, &from};
+
+  for (const TMetadata *src : sources) {
+    for (const TBroker &b : src->Brokers) {
+      if (broker_ids.insert(b.GetId()).second) {
+        builder.AddBroker(b.GetId(), std::string(b.GetHostname()),
+            b.GetPort(), std::string(b.GetRack()));
+      }
+    }
+  }
+
+  builder.CloseBrokerList();
+  builder.SetControllerId(md.ControllerId);
+
+  for (const auto &item : md.TopicNameToIndex) {
+    if (from_topics.count(item.first) == 0) {
+      AddTopicToBuilder(builder, md, item.first, md.Topics[item.second]);
+    }
+  }
+
+  for (const std::string &topic : from_topics) {
+    AddTopicToBuilder(builder, from, topic,
+        from.Topics[from.FindTopicIndex(topic)]);
+  }
+
+  return builder.Build();
+}
+
 const int32_t *TMetadata::FindPartitionChoices(const std::string &topic,
     size_t broker_index, size_t &num_choices) const {
   assert(this);
@@ -82,6 +82,13 @@ namespace Dory {
         return Port;
       }
 
+      /* Returns empty string if the broker reported no rack (metadata
+         protocol version 0, or no rack configured). */
+      const std::string &GetRack() const {
+        assert(this);
+        return Rack;
+      }
+
       bool IsInService() const {
         assert(this);
         return InService;
@@ -103,10 +110,12 @@ namespace Dory {
       }
 
       private:
-      TBroker(int32_t id, std::string &&hostname, uint16_t port)
+      TBroker(int32_t id, std::string &&hostname, uint16_t port,
+          std::string &&rack)
           : Id(id),
             Hostname(std::move(hostname)),
             Port(port),
+            Rack(std::move(rack)),
             InService(false) {
       }
 
@@ -124,6 +133,9 @@ namespace Dory {
       /* Port to connect to. */
       uint16_t Port;
 
+      /* Rack the broker resides in, or empty if unknown. */
+      std::string Rack;
+
       /* True if broker has at least one partition that can receive
          messages. */
       bool InService;
@@ -264,10 +276,23 @@ namespace Dory {
 
       void OpenBrokerList();
 
-      void AddBroker(int32_t kafka_id, std::string &&hostname, uint16_t port);
+      void AddBroker(int32_t kafka_id, std::string &&hostname, uint16_t port) {
+        assert(this);
+        AddBroker(kafka_id, std::move(hostname), port, std::string());
+      }
+
+      void AddBroker(int32_t kafka_id, std::string &&hostname, uint16_t port,
+          std::string &&rack);
 
       void CloseBrokerList();
 
+      /* A value of -1 (the default) indicates that the controller is unknown.
+       */
+      void SetControllerId(int32_t controller_id) {
+        assert(this);
+        ControllerId = controller_id;
+      }
+
       void OpenTopic(const std::string &name);
 
       void AddPartitionToTopic(int32_t partition_id, int32_t broker_id,
@@ -309,6 +334,8 @@ namespace Dory {
 
       size_t InServiceBrokerCount;
 
+      int32_t ControllerId;
+
       std::vector<int32_t> TopicBrokerVec;
 
       std::vector<TTopic> Topics;
@@ -337,6 +364,12 @@ namespace Dory {
       return InServiceBrokerCount;
     }
 
+    /* Returns Kafka ID of controller broker, or -1 if unknown. */
+    int32_t GetControllerId() const {
+      assert(this);
+      return ControllerId;
+    }
+
     const std::vector<TTopic> &GetTopics() const {
       assert(this);
       return Topics;
@@ -364,6 +397,25 @@ namespace Dory {
     const int32_t *FindPartitionChoices(const std::string &topic,
         size_t broker_index, size_t &num_choices) const;
 
+    /* Compare the in service brokers of 'old_md' and 'new_md' for the purpose
+       of applying a metadata update without disturbing brokers it doesn't
+       affect.  The returned vector has one element for each in service broker
+       of 'old_md', indexed as in the vector returned by GetBrokers().  If the
+       broker is also in service in 'new_md' with the same ID, hostname, port,
+       and rack, and still leads every partition it led in 'old_md' with the
+       same error code and availability, then the element is the broker's
+       index in 'new_md'.  Otherwise the element is -1. */
+    static std::vector<int> MapUnchangedBrokers(const TMetadata &old_md,
+        const TMetadata &new_md);
+
+    /* Return new metadata with the brokers and topics of 'md', plus each
+       topic in 'topics' that 'from' has.  Such a topic replaces any topic of
+       the same name in 'md'.  Brokers of 'from' are added if 'md' doesn't have
+       a broker with the same ID.  Caller assumes responsibility for deleting
+       returned object. */
+    static TMetadata *MergeTopics(const TMetadata &md, const TMetadata &from,
+        const std::vector<std::string> &topics);
+
     bool SanityCheckOkPartitions(const TTopic &t,
         std::unordered_set<size_t> &in_service_broker_indexes,
         std::unordered_set<int32_t> &id_set_ok,
@@ -391,10 +443,12 @@ namespace Dory {
 
     private:
     TMetadata(std::vector<TBroker> &&brokers, size_t in_service_broker_count,
-        std::vector<int32_t> &&topic_broker_vec, std::vector<TTopic> &&topics,
+        int32_t controller_id, std::vector<int32_t> &&topic_broker_vec,
+        std::vector<TTopic> &&topics,
         std::unordered_map<std::string, size_t> &&topic_name_to_index)
         : Brokers(std::move(brokers)),
           InServiceBrokerCount(in_service_broker_count),
+          ControllerId(controller_id),
           TopicBrokerVec(std::move(topic_broker_vec)),
           Topics(std::move(topics)),
           TopicNameToIndex(std::move(topic_name_to_index)) {
@@ -416,6 +470,10 @@ namespace Dory {
        messages. */
     size_t InServiceBrokerCount;
 
+    /* Kafka ID of controller broker, or -1 if unknown.  Not considered by
+       operator==() since a controller change alone doesn't affect routing. */
+    int32_t ControllerId;
+
     /* Vector of contiguous chunks of items, where each chunk represents all
        healthy partitions (with error code of 0 or 9) for a given topic/broker
        combination.  Each chunk is referenced by a TPartitionChoices struct. */
@@ -577,6 +577,220 @@ namespace {
     ASSERT_TRUE(threw);
   }
 
+  TEST_F(TMetadataTest, RackAndControllerTest) {
+    TMetadata::TBuilder builder;
+    builder.OpenBrokerList();
+    builder.AddBroker(5, "host1", 101, "rack1");
+    builder.AddBroker(2, "host2", 102);
+    builder.CloseBrokerList();
+    builder.SetControllerId(2);
+    builder.OpenTopic("topic1");
+    builder.AddPartitionToTopic(0, 5, true, 0);
+    builder.AddPartitionToTopic(1, 2, true, 0);
+    builder.CloseTopic();
+    std::unique_ptr<TMetadata> md1(builder.Build());
+    ASSERT_TRUE(!!md1);
+    ASSERT_TRUE(md1->SanityCheck());
+    ASSERT_EQ(md1->GetControllerId(), 2);
+    const std::vector<TMetadata::TBroker> &brokers = md1->GetBrokers();
+    ASSERT_EQ(brokers.size(), 2U);
+
+    for (const TMetadata::TBroker &b : brokers) {
+      ASSERT_EQ(b.GetRack(), (b.GetId() == 5) ? "rack1" : "");
+    }
+
+    /* A controller change alone does not make metadata unequal. */
+    builder.OpenBrokerList();
+    builder.AddBroker(5, "host1", 101, "rack1");
+    builder.AddBroker(2, "host2", 102);
+    builder.CloseBrokerList();
+    builder.OpenTopic("topic1");
+    builder.AddPartitionToTopic(0, 5, true, 0);
+    builder.AddPartitionToTopic(1, 2, true, 0);
+    builder.CloseTopic();
+    std::unique_ptr<TMetadata> md2(builder.Build());
+    ASSERT_TRUE(!!md2);
+    ASSERT_EQ(md2->GetControllerId(), -1);
+    ASSERT_TRUE(*md2 == *md1);
+
+    /* A rack change does. */
+    builder.OpenBrokerList();
+    builder.AddBroker(5, "host1", 101, "rack2");
+    builder.AddBroker(2, "host2", 102);
+    builder.CloseBrokerList();
+    builder.OpenTopic("topic1");
+    builder.AddPartitionToTopic(0, 5, true, 0);
+    builder.AddPartitionToTopic(1, 2, true, 0);
+    builder.CloseTopic();
+    std::unique_ptr<TMetadata> md3(builder.Build());
+    ASSERT_TRUE(!!md3);
+    ASSERT_FALSE(*md3 == *md1);
+  }
+
+  /* Return the index of the broker with Kafka ID 'id' in 'md', or -1 if not
+     found. */
+  static int FindBrokerIndex(const TMetadata &md, int32_t id) {
+    const std::vector<TMetadata::TBroker> &brokers = md.GetBrokers();
+
+    for (size_t i = 0; i < brokers.size(); ++i) {
+      if (brokers[i].GetId() == id) {
+        return static_cast<int>(i);
+      }
+    }
+
+    return -1;
+  }
+
+  TEST_F(TMetadataTest, MapUnchangedBrokersTest) {
+    TMetadata::TBuilder builder;
+    builder.OpenBrokerList();
+    builder.AddBroker(1, "host1", 101);
+    builder.AddBroker(2, "host2", 102);
+    builder.AddBroker(3, "host3", 103);
+    builder.AddBroker(4, "host4", 104);
+    builder.AddBroker(5, "host5", 105);
+    builder.CloseBrokerList();
+    builder.OpenTopic("topic1");
+    builder.AddPartitionToTopic(0, 1, true, 0);
+    builder.AddPartitionToTopic(1, 2, true, 0);
+    builder.AddPartitionToTopic(2, 3, true, 0);
+    builder.AddPartitionToTopic(3, 4, true, 0);
+    builder.CloseTopic();
+    builder.OpenTopic("topic2");
+    builder.AddPartitionToTopic(0, 5, true, 0);
+    builder.CloseTopic();
+    std::unique_ptr<TMetadata> md1(builder.Build());
+    ASSERT_TRUE(!!md1);
+    ASSERT_EQ(md1->NumInServiceBrokers(), 5U);
+
+    /* Broker 1 is unaffected.  Broker 2 is unaffected, although it gains a
+       partition.  Partition 2 of topic1 moves from broker 3 to broker 2.
+       Partition 3 of topic1 stays with broker 4, but becomes unavailable.
+       topic2 is deleted, leaving broker 5 with no partitions.  Broker 6 is
+       new. */
+    builder.OpenBrokerList();
+    builder.AddBroker(6, "host6", 106);
+    builder.AddBroker(5, "host5", 105);
+    builder.AddBroker(4, "host4", 104);
+    builder.AddBroker(3, "host3", 103);
+    builder.AddBroker(2, "host2", 102);
+    builder.AddBroker(1, "host1", 101);
+    builder.CloseBrokerList();
+    builder.OpenTopic("topic1");
+    builder.AddPartitionToTopic(0, 1, true, 0);
+    builder.AddPartitionToTopic(1, 2, true, 0);
+    builder.AddPartitionToTopic(2, 2, true, 0);
+    builder.AddPartitionToTopic(3, 4, false, 5);
+    builder.AddPartitionToTopic(4, 3, true, 0);
+    builder.CloseTopic();
+    builder.OpenTopic("topic3");
+    builder.AddPartitionToTopic(0, 6, true, 0);
+    builder.AddPartitionToTopic(1, 4, true, 0);
+    builder.CloseTopic();
+    std::unique_ptr<TMetadata> md2(builder.Build());
+    ASSERT_TRUE(!!md2);
+    ASSERT_TRUE(md2->SanityCheck());
+    std::vector<int> broker_map = TMetadata::MapUnchangedBrokers(*md1, *md2);
+    ASSERT_EQ(broker_map.size(), 5U);
+    ASSERT_EQ(broker_map[FindBrokerIndex(*md1, 1)], FindBrokerIndex(*md2, 1));
+    ASSERT_EQ(broker_map[FindBrokerIndex(*md1, 2)], FindBrokerIndex(*md2, 2));
+    ASSERT_EQ(broker_map[FindBrokerIndex(*md1, 3)], -1);
+    ASSERT_EQ(broker_map[FindBrokerIndex(*md1, 4)], -1);
+    ASSERT_EQ(broker_map[FindBrokerIndex(*md1, 5)], -1);
+
+    /* A hostname change also counts as a change. */
+    builder.OpenBrokerList();
+    builder.AddBroker(1, "host1", 101);
+    builder.AddBroker(2, "host2-new", 102);
+    builder.CloseBrokerList();
+    builder.OpenTopic("topic1");
+    builder.AddPartitionToTopic(0, 1, true, 0);
+    builder.AddPartitionToTopic(1, 2, true, 0);
+    builder.CloseTopic();
+    std::unique_ptr<TMetadata> md3(builder.Build());
+    ASSERT_TRUE(!!md3);
+    broker_map = TMetadata::MapUnchangedBrokers(*md2, *md3);
+    ASSERT_EQ(broker_map.size(), md2->NumInServiceBrokers());
+    ASSERT_EQ(broker_map[FindBrokerIndex(*md2, 1)], FindBrokerIndex(*md3, 1));
+    ASSERT_EQ(broker_map[FindBrokerIndex(*md2, 2)], -1);
+
+    /* Identical metadata maps every broker. */
+    broker_map = TMetadata::MapUnchangedBrokers(*md3, *md3);
+    ASSERT_EQ(broker_map.size(), 2U);
+    ASSERT_EQ(broker_map[0], 0);
+    ASSERT_EQ(broker_map[1], 1);
+  }
+
+  TEST_F(TMetadataTest, MergeTopicsTest) {
+    TMetadata::TBuilder builder;
+    builder.OpenBrokerList();
+    builder.AddBroker(1, "host1", 101);
+    builder.AddBroker(2, "host2", 102);
+    builder.CloseBrokerList();
+    builder.OpenTopic("topic1");
+    builder.AddPartitionToTopic(0, 1, true, 0);
+    builder.AddPartitionToTopic(1, 2, true, 0);
+    builder.CloseTopic();
+    builder.OpenTopic("topic2");
+    builder.AddPartitionToTopic(0, 1, true, 0);
+    builder.CloseTopic();
+    std::unique_ptr<TMetadata> md1(builder.Build());
+    ASSERT_TRUE(!!md1);
+
+    /* Result of a lookup for topic2 and topic3.  topic2 has moved to broker
+       3, which is new.  topic3 is new.  topic4 wasn't asked for. */
+    builder.OpenBrokerList();
+    builder.AddBroker(1, "host1", 101);
+    builder.AddBroker(2, "host2", 102);
+    builder.AddBroker(3, "host3", 103);
+    builder.CloseBrokerList();
+    builder.OpenTopic("topic2");
+    builder.AddPartitionToTopic(0, 3, true, 0);
+    builder.CloseTopic();
+    builder.OpenTopic("topic3");
+    builder.AddPartitionToTopic(0, 2, true, 0);
+    builder.AddPartitionToTopic(1, 1, false, 5);
+    builder.CloseTopic();
+    builder.OpenTopic("topic4");
+    builder.AddPartitionToTopic(0, 1, true, 0);
+    builder.CloseTopic();
+    std::unique_ptr<TMetadata> md2(builder.Build());
+    ASSERT_TRUE(!!md2);
+
+    std::unique_ptr<TMetadata> merged(TMetadata::MergeTopics(*md1, *md2,
+        {"topic2", "topic3", "topic5"}));
+    ASSERT_TRUE(!!merged);
+    ASSERT_TRUE(merged->SanityCheck());
+    ASSERT_EQ(merged->GetBrokers().size(), 3U);
+    ASSERT_EQ(merged->GetTopics().size(), 3U);
+    ASSERT_LT(merged->FindTopicIndex("topic4"), 0);
+    ASSERT_LT(merged->FindTopicIndex("topic5"), 0);
+
+    int topic_index = merged->FindTopicIndex("topic1");
+    ASSERT_GE(topic_index, 0);
+    const TMetadata::TTopic *topic = &merged->GetTopics()[topic_index];
+    ASSERT_EQ(topic->GetOkPartitions().size(), 2U);
+
+    topic_index = merged->FindTopicIndex("topic2");
+    ASSERT_GE(topic_index, 0);
+    topic = &merged->GetTopics()[topic_index];
+    ASSERT_EQ(topic->GetOkPartitions().size(), 1U);
+    ASSERT_EQ(merged->GetBrokers()[
+        topic->GetOkPartitions()[0].GetBrokerIndex()].GetId(), 3);
+
+    topic_index = merged->FindTopicIndex("topic3");
+    ASSERT_GE(topic_index, 0);
+    topic = &merged->GetTopics()[topic_index];
+    ASSERT_EQ(topic->GetOkPartitions().size(), 1U);
+    ASSERT_EQ(topic->GetOutOfServicePartitions().size(), 1U);
+    ASSERT_EQ(topic->GetOutOfServicePartitions()[0].GetErrorCode(), 5);
+
+    /* Merging no topics from the same metadata gives an identical copy. */
+    merged.reset(TMetadata::MergeTopics(*md1, *md1,
+        std::vector<std::string>()));
+    ASSERT_TRUE(*merged == *md1);
+  }
+
 }  // namespace
 
 int main(int argc, char **argv) {
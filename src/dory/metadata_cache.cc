@@ -0,0 +1,423 @@
+/* <dory/metadata_cache.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/metadata_cache.h>.
+ */
+
+#include <dory/metadata_cache.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <ios>
+#include <memory>
+#include <system_error>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <base/crc.h>
+#include <base/error_utils.h>
+#include <base/fd.h>
+#include <base/field_access.h>
+#include <base/file_reader.h>
+#include <base/io_utils.h>
+
+using namespace Base;
+using namespace Dory;
+
+/* Identifies a metadata cache file ("DMDC"), followed by the format version.
+ */
+static const uint32_t CACHE_MAGIC = 0x444d4443;
+
+static const int16_t CACHE_VERSION = 0;
+
+namespace {
+
+  class TCacheWriter final {
+    public:
+    explicit TCacheWriter(std::vector<uint8_t> &buf)
+        : Buf(buf) {
+    }
+
+    void WriteInt8(int8_t value) {
+      assert(this);
+      Buf.push_back(static_cast<uint8_t>(value));
+    }
+
+    void WriteInt16(int16_t value) {
+      assert(this);
+      WriteInt16ToHeader(Grow(sizeof(value)), value);
+    }
+
+    void WriteUint16(uint16_t value) {
+      assert(this);
+      WriteUint16ToHeader(Grow(sizeof(value)), value);
+    }
+
+    void WriteInt32(int32_t value) {
+      assert(this);
+      WriteInt32ToHeader(Grow(sizeof(value)), value);
+    }
+
+    void WriteUint32(uint32_t value) {
+      assert(this);
+      WriteUint32ToHeader(Grow(sizeof(value)), value);
+    }
+
+    void WriteString(const std::string &value) {
+      assert(this);
+      WriteInt32(static_cast<int32_t>(value.size()));
+      Buf.insert(Buf.end(), value.begin(), value.end());
+    }
+
+    private:
+    uint8_t *Grow(size_t size) {
+      assert(this);
+      size_t offset = Buf.size();
+      Buf.resize(offset + size);
+      return &Buf[offset];
+    }
+
+    std::vector<uint8_t> &Buf;
+  };  // TCacheWriter
+
+  /* Each Read*() method returns false if not enough data remains. */
+  class TCacheReader final {
+    public:
+    TCacheReader(const uint8_t *data, size_t data_size)
+        : Pos(data),
+          End(data + data_size) {
+    }
+
+    bool ReadInt8(int8_t &value) {
+      assert(this);
+
+      if (!Have(sizeof(value))) {
+        return false;
+      }
+
+      value = static_cast<int8_t>(*Pos);
+      ++Pos;
+      return true;
+    }
+
+    bool ReadInt16(int16_t &value) {
+      assert(this);
+
+      if (!Have(sizeof(value))) {
+        return false;
+      }
+
+      value = ReadInt16FromHeader(Pos);
+      Pos += sizeof(value);
+      return true;
+    }
+
+    bool ReadUint16(uint16_t &value) {
+      assert(this);
+
+      if (!Have(sizeof(value))) {
+        return false;
+      }
+
+      value = ReadUint16FromHeader(Pos);
+      Pos += sizeof(value);
+      return true;
+    }
+
+    bool ReadInt32(int32_t &value) {
+      assert(this);
+
+      if (!Have(sizeof(value))) {
+        return false;
+      }
+
+      value = ReadInt32FromHeader(Pos);
+      Pos += sizeof(value);
+      return true;
+    }
+
+    bool ReadUint32(uint32_t &value) {
+      assert(this);
+
+      if (!Have(sizeof(value))) {
+        return false;
+      }
+
+      value = ReadUint32FromHeader(Pos);
+      Pos += sizeof(value);
+      return true;
+    }
+
+    bool ReadString(std::string &value) {
+      assert(this);
+      int32_t size = 0;
+
+      if (!ReadInt32(size) || (size < 0) ||
+          !Have(static_cast<size_t>(size))) {
+        return false;
+      }
+
+      value.assign(reinterpret_cast<const char *>(Pos), size);
+      Pos += size;
+      return true;
+    }
+
+    /* Like ReadInt32(), but fail if the value is negative. */
+    bool ReadCount(size_t &value) {
+      assert(this);
+      int32_t count = 0;
+
+      if (!ReadInt32(count) || (count < 0)) {
+        return false;
+      }
+
+      value = static_cast<size_t>(count);
+      return true;
+    }
+
+    bool AtEnd() const {
+      assert(this);
+      return (Pos == End);
+    }
+
+    private:
+    bool Have(size_t size) const {
+      assert(this);
+      return (static_cast<size_t>(End - Pos) >= size);
+    }
+
+    const uint8_t *Pos;
+
+    const uint8_t *End;
+  };  // TCacheReader
+
+}  // namespace
+
+void Dory::SerializeMetadata(const TMetadata &md,
+    std::vector<uint8_t> &result) {
+  result.clear();
+  TCacheWriter writer(result);
+  writer.WriteUint32(CACHE_MAGIC);
+  writer.WriteInt16(CACHE_VERSION);
+  writer.WriteInt32(md.GetControllerId());
+  const std::vector<TMetadata::TBroker> &brokers = md.GetBrokers();
+  writer.WriteInt32(static_cast<int32_t>(brokers.size()));
+
+  for (const TMetadata::TBroker &b : brokers) {
+    writer.WriteInt32(b.GetId());
+    writer.WriteUint16(b.GetPort());
+    writer.WriteString(b.GetHostname());
+    writer.WriteString(b.GetRack());
+  }
+
+  const std::vector<TMetadata::TTopic> &topics = md.GetTopics();
+  writer.WriteInt32(static_cast<int32_t>(topics.size()));
+
+  for (const auto &item : md.GetTopicNameMap()) {
+    const TMetadata::TTopic &t = topics[item.second];
+    std::unordered_set<int32_t> ok_partitions;
+
+    for (const TMetadata::TPartition &p : t.GetOkPartitions()) {
+      ok_partitions.insert(p.GetId());
+    }
+
+    writer.WriteString(item.first);
+    const std::vector<TMetadata::TPartition> &partitions =
+        t.GetAllPartitions();
+    writer.WriteInt32(static_cast<int32_t>(partitions.size()));
+
+    for (const TMetadata::TPartition &p : partitions) {
+      writer.WriteInt32(p.GetId());
+      writer.WriteInt32(brokers[p.GetBrokerIndex()].GetId());
+      writer.WriteInt16(p.GetErrorCode());
+      writer.WriteInt8((ok_partitions.count(p.GetId()) != 0) ? 1 : 0);
+    }
+  }
+
+  writer.WriteUint32(ComputeCrc32(&result[0], result.size()));
+}
+
+static bool BuildFromCache(TCacheReader &reader, TMetadata::TBuilder &builder) {
+  uint32_t magic = 0;
+  int16_t version = 0;
+  int32_t controller_id = 0;
+  size_t broker_count = 0;
+
+  if (!reader.ReadUint32(magic) || (magic != CACHE_MAGIC) ||
+      !reader.ReadInt16(version) || (version != CACHE_VERSION) ||
+      !reader.ReadInt32(controller_id) || !reader.ReadCount(broker_count)) {
+    return false;
+  }
+
+  builder.OpenBrokerList();
+
+  for (size_t i = 0; i < broker_count; ++i) {
+    int32_t id = 0;
+    uint16_t port = 0;
+    std::string hostname, rack;
+
+    if (!reader.ReadInt32(id) || !reader.ReadUint16(port) ||
+        !reader.ReadString(hostname) || !reader.ReadString(rack)) {
+      return false;
+    }
+
+    builder.AddBroker(id, std::move(hostname), port, std::move(rack));
+  }
+
+  builder.CloseBrokerList();
+  builder.SetControllerId(controller_id);
+  size_t topic_count = 0;
+
+  if (!reader.ReadCount(topic_count)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < topic_count; ++i) {
+    std::string name;
+    size_t partition_count = 0;
+
+    if (!reader.ReadString(name) || !reader.ReadCount(partition_count)) {
+      return false;
+    }
+
+    builder.OpenTopic(name);
+
+    for (size_t j = 0; j < partition_count; ++j) {
+      int32_t partition_id = 0, broker_id = 0;
+      int16_t error_code = 0;
+      int8_t ok = 0;
+
+      if (!reader.ReadInt32(partition_id) || !reader.ReadInt32(broker_id) ||
+          !reader.ReadInt16(error_code) || !reader.ReadInt8(ok)) {
+        return false;
+      }
+
+      builder.AddPartitionToTopic(partition_id, broker_id, ok != 0,
+          error_code);
+    }
+
+    builder.CloseTopic();
+  }
+
+  return reader.AtEnd();
+}
+
+TMetadata *Dory::DeserializeMetadata(const uint8_t *data, size_t data_size) {
+  assert(data || (data_size == 0));
+
+  if (data_size < sizeof(uint32_t)) {
+    return nullptr;
+  }
+
+  size_t body_size = data_size - sizeof(uint32_t);
+
+  if (ComputeCrc32(data, body_size) !=
+      ReadUint32FromHeader(data + body_size)) {
+    return nullptr;
+  }
+
+  TCacheReader reader(data, body_size);
+  TMetadata::TBuilder builder;
+
+  try {
+    if (!BuildFromCache(reader, builder)) {
+      return nullptr;
+    }
+
+    return builder.Build();
+  } catch (const TMetadata::TBadMetadata &) {
+    return nullptr;
+  }
+}
+
+bool Dory::WriteMetadataCache(const TMetadata &md, const std::string &path) {
+  std::vector<uint8_t> buf;
+  SerializeMetadata(md, buf);
+  std::string tmp_path(path);
+  tmp_path += ".tmp";
+
+  try {
+    {
+      TFd fd = IfLt0(open(tmp_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY,
+                          S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+
+      if (!TryWriteExactly(fd, &buf[0], buf.size())) {
+        syslog(LOG_ERR, "Failed to write metadata cache file %s: short "
+               "write", tmp_path.c_str());
+        unlink(tmp_path.c_str());
+        return false;
+      }
+
+      /* Make sure the data is on disk before the rename, so a crash can't
+         leave us with a renamed file whose contents were never written. */
+      IfLt0(fsync(fd));
+    }
+
+    IfLt0(rename(tmp_path.c_str(), path.c_str()));
+
+    /* Make the rename itself durable. */
+    size_t pos = path.rfind('/');
+    std::string dir_path = (pos == std::string::npos) ?
+        std::string(".") : path.substr(0, std::max<size_t>(pos, 1));
+    TFd dir_fd = IfLt0(open(dir_path.c_str(), O_RDONLY | O_DIRECTORY));
+    IfLt0(fsync(dir_fd));
+  } catch (const std::system_error &x) {
+    syslog(LOG_ERR, "Failed to write metadata cache file %s: %s",
+           path.c_str(), x.what());
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+TMetadata *Dory::ReadMetadataCache(const std::string &path) {
+  std::string buf;
+
+  try {
+    TFileReader(path.c_str()).ReadIntoString(buf);
+  } catch (const std::ios_base::failure &x) {
+    syslog(LOG_NOTICE, "Cannot read metadata cache file %s: %s",
+           path.c_str(), x.what());
+    return nullptr;
+  }
+
+  std::unique_ptr<TMetadata> result(DeserializeMetadata(
+      reinterpret_cast<const uint8_t *>(buf.data()), buf.size()));
+
+  if (!result) {
+    syslog(LOG_WARNING, "Ignoring invalid metadata cache file %s",
+           path.c_str());
+    return nullptr;
+  }
+
+  /* Apply the same check as to metadata from Kafka, since we will route
+     messages with it before getting fresh metadata. */
+  if (!result->SanityCheck()) {
+    syslog(LOG_WARNING, "Ignoring metadata cache file %s, since its contents "
+           "failed sanity check", path.c_str());
+    return nullptr;
+  }
+
+  return result.release();
+}
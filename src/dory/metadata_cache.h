@@ -0,0 +1,57 @@
+/* <dory/metadata_cache.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Functions for saving Kafka metadata to a file and loading it back, so Dory
+   can start routing messages right away on startup instead of waiting for
+   the initial metadata request to complete.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <dory/metadata.h>
+
+namespace Dory {
+
+  /* Serialize 'md' into 'result' in a compact binary format.  The format
+     ends with a CRC, so corruption is detected when reading it back.  Any
+     existing contents of 'result' are replaced. */
+  void SerializeMetadata(const TMetadata &md, std::vector<uint8_t> &result);
+
+  /* Reconstruct metadata serialized by SerializeMetadata().  Return nullptr
+     if the data is truncated, corrupted, or otherwise invalid.  Caller
+     assumes responsibility for deleting returned object. */
+  TMetadata *DeserializeMetadata(const uint8_t *data, size_t data_size);
+
+  /* Write 'md' to the file given by 'path'.  The data is written to a
+     temporary file which is synced to disk and then renamed, so a reader never
+     sees a partially written file, even after a crash.  Return true on
+     success.  On failure, log an error and return false. */
+  bool WriteMetadataCache(const TMetadata &md, const std::string &path);
+
+  /* Read metadata written by WriteMetadataCache().  Return nullptr (after
+     logging the reason) if the file doesn't exist, its contents are invalid,
+     or the metadata fails TMetadata::SanityCheck().  Caller assumes
+     responsibility for deleting returned object. */
+  TMetadata *ReadMetadataCache(const std::string &path);
+
+}  // Dory
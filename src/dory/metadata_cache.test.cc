@@ -0,0 +1,160 @@
+/* <dory/metadata_cache.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/metadata_cache.h>.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dory/metadata_cache.h>
+
+#include <unistd.h>
+
+#include <base/tmp_file_name.h>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+using namespace Dory;
+
+namespace {
+
+  TMetadata *BuildTestMetadata() {
+    TMetadata::TBuilder builder;
+    builder.OpenBrokerList();
+    builder.AddBroker(5, "host1", 101, "rack1");
+    builder.AddBroker(2, "host2", 102);
+    builder.AddBroker(7, "host3", 103);
+    builder.CloseBrokerList();
+    builder.SetControllerId(2);
+    builder.OpenTopic("topic1");
+    builder.AddPartitionToTopic(6, 5, true, 9);
+    builder.AddPartitionToTopic(3, 2, true, 0);
+    builder.AddPartitionToTopic(7, 2, false, 5);  // out of service partition
+    builder.AddPartitionToTopic(1, 7, false, 6);  // out of service partition
+    builder.CloseTopic();
+    builder.OpenTopic("topic2");
+    builder.CloseTopic();
+    builder.OpenTopic("topic3");
+    builder.AddPartitionToTopic(0, 5, true, 0);
+    builder.CloseTopic();
+    return builder.Build();
+  }
+
+  /* The fixture for testing metadata cache functions. */
+  class TMetadataCacheTest : public ::testing::Test {
+    protected:
+    TMetadataCacheTest() {
+    }
+
+    virtual ~TMetadataCacheTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TMetadataCacheTest
+
+  TEST_F(TMetadataCacheTest, RoundTripTest) {
+    std::unique_ptr<TMetadata> md(BuildTestMetadata());
+    ASSERT_TRUE(!!md);
+    std::vector<uint8_t> buf;
+    SerializeMetadata(*md, buf);
+    std::unique_ptr<TMetadata> md2(DeserializeMetadata(&buf[0], buf.size()));
+    ASSERT_TRUE(!!md2);
+    ASSERT_TRUE(md2->SanityCheck());
+    ASSERT_TRUE(*md2 == *md);
+    ASSERT_EQ(md2->GetControllerId(), 2);
+    ASSERT_EQ(md2->NumInServiceBrokers(), 2U);
+
+    int topic_index = md2->FindTopicIndex("topic1");
+    ASSERT_GE(topic_index, 0);
+    const TMetadata::TTopic &topic = md2->GetTopics()[topic_index];
+    ASSERT_EQ(topic.GetOkPartitions().size(), 2U);
+    ASSERT_EQ(topic.GetOutOfServicePartitions().size(), 2U);
+
+    bool found_rack = false;
+
+    for (const TMetadata::TBroker &b : md2->GetBrokers()) {
+      if (b.GetId() == 5) {
+        ASSERT_EQ(b.GetRack(), "rack1");
+        found_rack = true;
+      }
+    }
+
+    ASSERT_TRUE(found_rack);
+
+    /* Empty metadata also survives the trip. */
+    md.reset(TMetadata::TBuilder().Build());
+    SerializeMetadata(*md, buf);
+    md2.reset(DeserializeMetadata(&buf[0], buf.size()));
+    ASSERT_TRUE(!!md2);
+    ASSERT_TRUE(*md2 == *md);
+  }
+
+  TEST_F(TMetadataCacheTest, BadDataTest) {
+    std::unique_ptr<TMetadata> md(BuildTestMetadata());
+    ASSERT_TRUE(!!md);
+    std::vector<uint8_t> buf;
+    SerializeMetadata(*md, buf);
+
+    /* Every truncation is rejected. */
+    for (size_t i = 0; i < buf.size(); ++i) {
+      std::unique_ptr<TMetadata> md2(DeserializeMetadata(&buf[0], i));
+      ASSERT_FALSE(!!md2) << "size " << i;
+    }
+
+    /* A flipped bit is caught by the CRC. */
+    std::vector<uint8_t> bad(buf);
+    bad[bad.size() / 2] ^= 0x10;
+    std::unique_ptr<TMetadata> md2(DeserializeMetadata(&bad[0], bad.size()));
+    ASSERT_FALSE(!!md2);
+
+    /* So is trailing garbage. */
+    bad = buf;
+    bad.push_back(0);
+    md2.reset(DeserializeMetadata(&bad[0], bad.size()));
+    ASSERT_FALSE(!!md2);
+  }
+
+  TEST_F(TMetadataCacheTest, FileTest) {
+    TTmpFileName path;
+    std::unique_ptr<TMetadata> md(ReadMetadataCache(
+        static_cast<const char *>(path)));
+    ASSERT_FALSE(!!md);  // file doesn't exist yet
+
+    md.reset(BuildTestMetadata());
+    ASSERT_TRUE(!!md);
+    ASSERT_TRUE(WriteMetadataCache(*md, static_cast<const char *>(path)));
+    std::unique_ptr<TMetadata> md2(ReadMetadataCache(
+        static_cast<const char *>(path)));
+    ASSERT_TRUE(!!md2);
+    ASSERT_TRUE(*md2 == *md);
+    unlink(path);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
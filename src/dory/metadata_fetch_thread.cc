@@ -0,0 +1,299 @@
+/* <dory/metadata_fetch_thread.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/metadata_fetch_thread.h>.
+ */
+
+#include <dory/metadata_fetch_thread.h>
+
+#include <cstdlib>
+#include <exception>
+#include <utility>
+
+#include <poll.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <base/error_utils.h>
+#include <base/gettid.h>
+#include <dory/util/dory_rate_limiter.h>
+#include <server/counter.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Util;
+
+SERVER_COUNTER(AsyncMetadataFetchFail);
+SERVER_COUNTER(AsyncMetadataFetchRequest);
+SERVER_COUNTER(AsyncMetadataFetchStale);
+SERVER_COUNTER(AsyncMetadataFetchSuccess);
+SERVER_COUNTER(AsyncTopicLookupFail);
+SERVER_COUNTER(AsyncTopicLookupRequest);
+SERVER_COUNTER(AsyncTopicLookupSuccess);
+
+static unsigned GetRandomNumber() {
+  return std::rand();
+}
+
+TMetadataFetchThread::TMetadataFetchThread(const TConfig &config,
+    THedgedMetadataFetcher &fetcher)
+    : Config(config),
+      Fetcher(fetcher),
+      RequestGeneration(0),
+      ResultGeneration(0) {
+}
+
+TMetadataFetchThread::~TMetadataFetchThread() noexcept {
+  /* This will shut down the thread if something unexpected happens. */
+  ShutdownOnDestroy();
+}
+
+void TMetadataFetchThread::RequestFetch(
+    const std::vector<THostAndPort> &brokers,
+    const std::vector<std::string> &topics, size_t generation) {
+  assert(this);
+  assert(!brokers.empty());
+  AsyncMetadataFetchRequest.Increment();
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    RequestBrokers = brokers;
+    RequestTopics = topics;
+    RequestGeneration = generation;
+  }
+
+  FetchRequestSem.Push();
+}
+
+void TMetadataFetchThread::RequestTopicLookup(
+    const std::vector<THostAndPort> &brokers, const std::string &topic) {
+  assert(this);
+  assert(!brokers.empty());
+  AsyncTopicLookupRequest.Increment();
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    LookupBrokers = brokers;
+    LookupTopics.push_back(topic);
+  }
+
+  LookupRequestSem.Push();
+}
+
+std::vector<TMetadataFetchThread::TLookupResult>
+TMetadataFetchThread::TakeLookupResults() {
+  assert(this);
+  std::vector<TLookupResult> results;
+  std::lock_guard<std::mutex> lock(Mutex);
+
+  /* Reset the semaphore while holding the lock, so it can't miss a result
+     published after we take 'LookupResults'. */
+  LookupResultSem.Reset();
+  results.swap(LookupResults);
+  return std::move(results);
+}
+
+bool TMetadataFetchThread::TakeResult(size_t current_generation,
+    std::shared_ptr<TMetadata> &result) {
+  assert(this);
+  result.reset();
+
+  if (!ResultReadySem.GetFd().IsReadable()) {
+    return false;
+  }
+
+  ResultReadySem.Pop();
+  std::lock_guard<std::mutex> lock(Mutex);
+
+  if (!Result) {
+    return false;
+  }
+
+  if (ResultGeneration == current_generation) {
+    result = std::move(Result);
+  } else {
+    AsyncMetadataFetchStale.Increment();
+    Result.reset();
+  }
+
+  return true;
+}
+
+void TMetadataFetchThread::Run() {
+  assert(this);
+  int tid = static_cast<int>(Gettid());
+  syslog(LOG_NOTICE, "Metadata fetch thread %d started", tid);
+
+  try {
+    DoRun();
+  } catch (const std::exception &x) {
+    syslog(LOG_ERR, "Fatal error in metadata fetch thread %d: %s", tid,
+           x.what());
+    _exit(EXIT_FAILURE);
+  } catch (...) {
+    syslog(LOG_ERR, "Fatal unknown error in metadata fetch thread %d", tid);
+    _exit(EXIT_FAILURE);
+  }
+
+  syslog(LOG_NOTICE, "Metadata fetch thread %d finished", tid);
+}
+
+void TMetadataFetchThread::DoRun() {
+  assert(this);
+  static const size_t POLL_ARRAY_SIZE = 3;
+  struct pollfd poll_array[POLL_ARRAY_SIZE];
+  struct pollfd &shutdown_item = poll_array[0];
+  struct pollfd &request_item = poll_array[1];
+  struct pollfd &lookup_item = poll_array[2];
+  shutdown_item.fd = GetShutdownRequestFd();
+  shutdown_item.events = POLLIN;
+  request_item.fd = FetchRequestSem.GetFd();
+  request_item.events = POLLIN;
+  lookup_item.fd = LookupRequestSem.GetFd();
+  lookup_item.events = POLLIN;
+
+  for (; ; ) {
+    shutdown_item.revents = 0;
+    request_item.revents = 0;
+    lookup_item.revents = 0;
+
+    /* Don't check for EINTR, since this thread has signals masked. */
+    IfLt0(poll(poll_array, POLL_ARRAY_SIZE, -1));
+
+    if (shutdown_item.revents) {
+      break;
+    }
+
+    /* Messages are waiting for lookups, so do them first. */
+    if (lookup_item.revents) {
+      if (!DoTopicLookups()) {
+        break;  // got shutdown request
+      }
+
+      continue;
+    }
+
+    /* Several requests may have been made since we last looked.  They are
+       all satisfied by a single fetch. */
+    FetchRequestSem.Reset();
+    std::vector<THostAndPort> brokers;
+    std::vector<std::string> topics;
+    size_t generation = 0;
+
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      brokers = RequestBrokers;
+      topics = RequestTopics;
+      generation = RequestGeneration;
+    }
+
+    std::unique_ptr<TMetadata> md = FetchWithRetry(brokers, topics);
+
+    if (!md) {
+      break;  // got shutdown request
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Result.reset(md.release());
+      ResultGeneration = generation;
+    }
+
+    /* Pushing only if not already readable keeps the semaphore's count at 1,
+       so a single TakeResult() call gets the latest snapshot. */
+    if (!ResultReadySem.GetFd().IsReadable()) {
+      ResultReadySem.Push();
+    }
+  }
+}
+
+bool TMetadataFetchThread::DoTopicLookups() {
+  assert(this);
+  LookupRequestSem.Reset();
+  std::vector<THostAndPort> brokers;
+  TLookupResult result;
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    brokers = LookupBrokers;
+    result.Topics.swap(LookupTopics);
+  }
+
+  if (result.Topics.empty()) {
+    return true;
+  }
+
+  const TFd &shutdown_request_fd = GetShutdownRequestFd();
+  result.Metadata = Fetcher.Fetch(brokers, result.Topics,
+      Config.KafkaSocketTimeout * 1000, shutdown_request_fd);
+
+  if (result.Metadata) {
+    AsyncTopicLookupSuccess.Increment();
+  } else if (shutdown_request_fd.IsReadable()) {
+    return false;
+  } else {
+    AsyncTopicLookupFail.Increment();
+    syslog(LOG_ERR, "Background topic lookup failed for all known brokers");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    LookupResults.push_back(std::move(result));
+
+    if (!LookupResultSem.GetFd().IsReadable()) {
+      LookupResultSem.Push();
+    }
+  }
+
+  return true;
+}
+
+std::unique_ptr<TMetadata> TMetadataFetchThread::FetchWithRetry(
+    const std::vector<THostAndPort> &brokers,
+    const std::vector<std::string> &topics) {
+  assert(this);
+  TDoryRateLimiter retry_rate_limiter(Config.PauseRateLimitInitial,
+      Config.PauseRateLimitMaxDouble, Config.MinPauseDelay, GetRandomNumber);
+  const TFd &shutdown_request_fd = GetShutdownRequestFd();
+
+  for (; ; ) {
+    std::unique_ptr<TMetadata> result = Fetcher.Fetch(brokers, topics,
+        Config.KafkaSocketTimeout * 1000, shutdown_request_fd);
+
+    if (result) {
+      AsyncMetadataFetchSuccess.Increment();
+      return std::move(result);
+    }
+
+    if (shutdown_request_fd.IsReadable()) {
+      return std::unique_ptr<TMetadata>();
+    }
+
+    AsyncMetadataFetchFail.Increment();
+    size_t delay = retry_rate_limiter.ComputeDelay();
+    syslog(LOG_ERR, "Background metadata request failed for all known "
+           "brokers, waiting %lu milliseconds before retry",
+           static_cast<unsigned long>(delay));
+
+    if (shutdown_request_fd.IsReadable(delay)) {
+      return std::unique_ptr<TMetadata>();
+    }
+
+    retry_rate_limiter.OnAction();
+  }
+}
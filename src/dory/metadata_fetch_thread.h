@@ -0,0 +1,187 @@
+/* <dory/metadata_fetch_thread.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Thread that fetches metadata in the background, so the router thread can
+   keep routing messages while a fetch is in progress.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <base/event_semaphore.h>
+#include <base/fd.h>
+#include <base/no_copy_semantics.h>
+#include <dory/config.h>
+#include <dory/hedged_metadata_fetcher.h>
+#include <dory/metadata.h>
+#include <dory/util/host_and_port.h>
+#include <thread/fd_managed_thread.h>
+
+namespace Dory {
+
+  /* The router thread asks this thread for metadata by calling RequestFetch().
+     The thread keeps trying until it gets metadata or is asked to shut down.
+     When metadata is available, the FD returned by GetResultFd() becomes
+     readable, and the router thread calls TakeResult() to get it.  Metadata
+     objects are never modified once published, so the router thread can adopt
+     a snapshot whenever it is ready to.
+
+     Each request is tagged with a generation number chosen by the caller.
+     The router thread changes its generation number whenever its metadata is
+     replaced by other means (for instance, a synchronous fetch), so a result
+     that arrives afterward is recognized as stale and discarded.
+
+     When topic-scoped metadata is enabled, the router thread also asks this
+     thread to look up topics it hasn't seen before, by calling
+     RequestTopicLookup().  Results are reported through GetLookupResultFd()
+     and TakeLookupResults(). */
+  class TMetadataFetchThread final : public Thread::TFdManagedThread {
+    NO_COPY_SEMANTICS(TMetadataFetchThread);
+
+    public:
+    /* 'fetcher' must outlive the thread. */
+    TMetadataFetchThread(const TConfig &config,
+        THedgedMetadataFetcher &fetcher);
+
+    virtual ~TMetadataFetchThread() noexcept;
+
+    /* Called by the router thread to start fetching metadata from one of
+       'brokers'.  If 'topics' is nonempty, only get metadata for those
+       topics.  Returns immediately.  Requests made before the thread gets
+       around to starting a fetch are satisfied by a single fetch, which is
+       tagged with the last request's 'generation'.  A request made while a
+       fetch is in progress causes another fetch once the current one
+       finishes.  A shutdown request cancels a fetch in progress. */
+    void RequestFetch(const std::vector<Util::THostAndPort> &brokers,
+        const std::vector<std::string> &topics, size_t generation);
+
+    /* Called by the router thread to get metadata for 'topic' from one of
+       'brokers'.  Returns immediately.  Lookups take priority over the
+       fetches requested by RequestFetch(), and lookups requested before the
+       thread gets around to them are done by a single fetch.  Unlike
+       RequestFetch(), a lookup is tried only once, since the router thread
+       holds messages for the topic until the lookup finishes. */
+    void RequestTopicLookup(const std::vector<Util::THostAndPort> &brokers,
+        const std::string &topic);
+
+    /* Result of a single fetch done for RequestTopicLookup(). */
+    struct TLookupResult {
+      /* Topics that were looked up. */
+      std::vector<std::string> Topics;
+
+      /* Metadata for whichever of 'Topics' exist, or empty if the lookup
+         failed. */
+      std::shared_ptr<TMetadata> Metadata;
+    };  // TLookupResult
+
+    /* Returns an FD that becomes readable when lookup results are available.
+     */
+    const Base::TFd &GetLookupResultFd() const {
+      assert(this);
+      return LookupResultSem.GetFd();
+    }
+
+    /* Called by the router thread once the FD returned by GetLookupResultFd()
+       is readable.  Returns all lookup results not yet taken, and makes the FD
+       unreadable until another result is available. */
+    std::vector<TLookupResult> TakeLookupResults();
+
+    /* Returns an FD that becomes readable when metadata is available. */
+    const Base::TFd &GetResultFd() const {
+      assert(this);
+      return ResultReadySem.GetFd();
+    }
+
+    /* Called by the router thread once the FD returned by GetResultFd() is
+       readable.  Returns false if no result is available, since it was
+       already taken.  Otherwise returns true, makes the FD unreadable until
+       the next result is available, and sets 'result' to the most recently
+       fetched metadata.  If that metadata was fetched for a generation other
+       than 'current_generation', it is stale, and 'result' is left empty. */
+    bool TakeResult(size_t current_generation,
+        std::shared_ptr<TMetadata> &result);
+
+    protected:
+    virtual void Run() override;
+
+    private:
+    void DoRun();
+
+    /* Do a single fetch for all pending topic lookups, and publish the
+       result.  Return false if we got a shutdown request. */
+    bool DoTopicLookups();
+
+    /* Keep trying to get metadata until we succeed or get a shutdown request.
+       Returned unique_ptr is empty if we got a shutdown request. */
+    std::unique_ptr<TMetadata> FetchWithRetry(
+        const std::vector<Util::THostAndPort> &brokers,
+        const std::vector<std::string> &topics);
+
+    const TConfig &Config;
+
+    THedgedMetadataFetcher &Fetcher;
+
+    /* Protects 'RequestBrokers', 'RequestTopics', 'RequestGeneration',
+       'Result', 'ResultGeneration', 'LookupBrokers', 'LookupTopics', and
+       'LookupResults'. */
+    std::mutex Mutex;
+
+    /* Brokers to try, as of the last call to RequestFetch(). */
+    std::vector<Util::THostAndPort> RequestBrokers;
+
+    /* Topics to get metadata for, as of the last call to RequestFetch(). */
+    std::vector<std::string> RequestTopics;
+
+    /* Generation number passed to the last call to RequestFetch(). */
+    size_t RequestGeneration;
+
+    /* Most recently fetched metadata, not yet taken by TakeResult(). */
+    std::shared_ptr<TMetadata> Result;
+
+    /* Generation number of the request that 'Result' satisfies. */
+    size_t ResultGeneration;
+
+    /* Brokers to try, as of the last call to RequestTopicLookup(). */
+    std::vector<Util::THostAndPort> LookupBrokers;
+
+    /* Topics passed to RequestTopicLookup() that we haven't started looking
+       up yet. */
+    std::vector<std::string> LookupTopics;
+
+    /* Lookup results not yet taken by TakeLookupResults(). */
+    std::vector<TLookupResult> LookupResults;
+
+    /* Pushed by RequestFetch(). */
+    Base::TEventSemaphore FetchRequestSem;
+
+    /* Becomes readable when 'Result' is available. */
+    Base::TEventSemaphore ResultReadySem;
+
+    /* Pushed by RequestTopicLookup(). */
+    Base::TEventSemaphore LookupRequestSem;
+
+    /* Becomes readable when 'LookupResults' is nonempty. */
+    Base::TEventSemaphore LookupResultSem;
+  };  // TMetadataFetchThread
+
+}  // Dory
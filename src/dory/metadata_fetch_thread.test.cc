@@ -0,0 +1,245 @@
+/* <dory/metadata_fetch_thread.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/metadata_fetch_thread.h>.
+ */
+
+#include <dory/metadata_fetch_thread.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include <base/opt.h>
+#include <base/time_util.h>
+#include <dory/config.h>
+#include <dory/hedged_metadata_fetcher.h>
+#include <dory/metadata.h>
+#include <dory/mock_kafka_server/main_thread.h>
+#include <dory/test_util/blackhole_broker.h>
+#include <dory/test_util/mock_kafka_config.h>
+#include <dory/util/host_and_port.h>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::TestUtil;
+using namespace Dory::Util;
+
+namespace {
+
+  /* How long to wait for a result from a responsive broker before giving up.
+     This is generous, so a slow test machine doesn't cause failures. */
+  const int RESULT_WAIT_MS = 30000;
+
+  /* The fixture for testing class TMetadataFetchThread. */
+  class TMetadataFetchThreadTest : public ::testing::Test {
+    protected:
+    TMetadataFetchThreadTest() {
+    }
+
+    virtual ~TMetadataFetchThreadTest() {
+    }
+
+    virtual void SetUp() {
+      /* The socket timeout is long, so the shutdown test shows that a
+         shutdown request doesn't wait for it. */
+      Args.push_back("dory");
+      Args.push_back("--config_path");
+      Args.push_back("/nonexistent/path");
+      Args.push_back("--msg_buffer_max");
+      Args.push_back("1");
+      Args.push_back("--receive_socket_name");
+      Args.push_back("/nonexistent/socket");
+      Args.push_back("--kafka_socket_timeout");
+      Args.push_back("60");
+      Args.push_back(nullptr);
+      Cfg.reset(new TConfig(Args.size() - 1, const_cast<char **>(&Args[0]),
+          true));
+    }
+
+    virtual void TearDown() {
+    }
+
+    std::vector<const char *> Args;
+
+    std::unique_ptr<TConfig> Cfg;
+  };  // TMetadataFetchThreadTest
+
+  /* Start a mock Kafka cluster with 2 brokers and a single topic. */
+  std::unique_ptr<TMockKafkaConfig> StartMockKafka(const std::string &topic,
+      std::vector<THostAndPort> &brokers) {
+    std::vector<std::string> kafka_config;
+    kafka_config.push_back("ports 10000 2");
+    kafka_config.push_back("topic " + topic + " 2 0");
+    std::unique_ptr<TMockKafkaConfig> kafka(
+        new TMockKafkaConfig(kafka_config));
+    kafka->StartKafka();
+
+    /* See big comment in <dory/mock_kafka_server/port_map.h> for an
+       explanation of virtual and physical ports. */
+    in_port_t port = kafka->MainThread->VirtualPortToPhys(10000);
+    brokers.assign(1, THostAndPort("localhost", port));
+    return std::move(kafka);
+  }
+
+  TEST_F(TMetadataFetchThreadTest, ResultHandoffTest) {
+    std::vector<THostAndPort> brokers;
+    std::unique_ptr<TMockKafkaConfig> kafka = StartMockKafka("topic1",
+        brokers);
+    THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 1, 95, 0);
+    TMetadataFetchThread thread(*Cfg, fetcher);
+    thread.Start();
+    ASSERT_FALSE(thread.GetResultFd().IsReadable());
+    thread.RequestFetch(brokers, std::vector<std::string>(), 1);
+    ASSERT_TRUE(thread.GetResultFd().IsReadable(RESULT_WAIT_MS));
+    std::shared_ptr<TMetadata> md;
+    ASSERT_TRUE(thread.TakeResult(1, md));
+    ASSERT_TRUE(!!md);
+    ASSERT_GE(md->FindTopicIndex("topic1"), 0);
+
+    /* The result can only be taken once. */
+    ASSERT_FALSE(thread.GetResultFd().IsReadable());
+    ASSERT_FALSE(thread.TakeResult(1, md));
+    ASSERT_FALSE(md);
+
+    /* The thread handles further requests once a result has been taken. */
+    thread.RequestFetch(brokers, std::vector<std::string>(1, "topic1"), 2);
+    ASSERT_TRUE(thread.GetResultFd().IsReadable(RESULT_WAIT_MS));
+    ASSERT_TRUE(thread.TakeResult(2, md));
+    ASSERT_TRUE(!!md);
+    ASSERT_EQ(md->GetTopics().size(), 1U);
+    ASSERT_GE(md->FindTopicIndex("topic1"), 0);
+    thread.RequestShutdown();
+    thread.Join();
+  }
+
+  TEST_F(TMetadataFetchThreadTest, StaleResultTest) {
+    std::vector<THostAndPort> brokers;
+    std::unique_ptr<TMockKafkaConfig> kafka = StartMockKafka("topic1",
+        brokers);
+    THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 1, 95, 0);
+    TMetadataFetchThread thread(*Cfg, fetcher);
+    thread.Start();
+    thread.RequestFetch(brokers, std::vector<std::string>(), 5);
+    ASSERT_TRUE(thread.GetResultFd().IsReadable(RESULT_WAIT_MS));
+
+    /* The caller's generation changed while the fetch was in progress, so
+       the result is stale.  It is consumed, but not returned. */
+    std::shared_ptr<TMetadata> md;
+    ASSERT_TRUE(thread.TakeResult(6, md));
+    ASSERT_FALSE(md);
+    ASSERT_FALSE(thread.GetResultFd().IsReadable());
+
+    /* A request made for the new generation is not discarded. */
+    thread.RequestFetch(brokers, std::vector<std::string>(), 6);
+    ASSERT_TRUE(thread.GetResultFd().IsReadable(RESULT_WAIT_MS));
+    ASSERT_TRUE(thread.TakeResult(6, md));
+    ASSERT_TRUE(!!md);
+    thread.RequestShutdown();
+    thread.Join();
+  }
+
+  TEST_F(TMetadataFetchThreadTest, TopicLookupTest) {
+    std::vector<THostAndPort> brokers;
+    std::unique_ptr<TMockKafkaConfig> kafka = StartMockKafka("topic1",
+        brokers);
+    THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 1, 95, 0);
+    TMetadataFetchThread thread(*Cfg, fetcher);
+    thread.Start();
+    ASSERT_FALSE(thread.GetLookupResultFd().IsReadable());
+    thread.RequestTopicLookup(brokers, "topic1");
+    ASSERT_TRUE(thread.GetLookupResultFd().IsReadable(RESULT_WAIT_MS));
+
+    /* A lookup result doesn't make the full fetch result FD readable. */
+    ASSERT_FALSE(thread.GetResultFd().IsReadable());
+    std::vector<TMetadataFetchThread::TLookupResult> results =
+        thread.TakeLookupResults();
+    ASSERT_FALSE(thread.GetLookupResultFd().IsReadable());
+    ASSERT_EQ(results.size(), 1U);
+    ASSERT_EQ(results[0].Topics, std::vector<std::string>(1, "topic1"));
+    ASSERT_TRUE(!!results[0].Metadata);
+    ASSERT_GE(results[0].Metadata->FindTopicIndex("topic1"), 0);
+
+    /* A lookup for a nonexistent topic succeeds, but finds nothing. */
+    thread.RequestTopicLookup(brokers, "no_such_topic");
+    ASSERT_TRUE(thread.GetLookupResultFd().IsReadable(RESULT_WAIT_MS));
+    results = thread.TakeLookupResults();
+    ASSERT_EQ(results.size(), 1U);
+    ASSERT_TRUE(!!results[0].Metadata);
+    ASSERT_LT(results[0].Metadata->FindTopicIndex("no_such_topic"), 0);
+    thread.RequestShutdown();
+    thread.Join();
+  }
+
+  TEST_F(TMetadataFetchThreadTest, TopicLookupFailTest) {
+    /* Get a port that nothing is listening on. */
+    THostAndPort host("127.0.0.1", 0);
+
+    {
+      TBlackholeBroker broker;
+      host = broker.GetHostAndPort();
+    }
+
+    THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 1, 95, 0);
+    TMetadataFetchThread thread(*Cfg, fetcher);
+    thread.Start();
+    thread.RequestTopicLookup(std::vector<THostAndPort>(1, host), "topic1");
+
+    /* Unlike a full fetch, a failed lookup isn't retried. */
+    ASSERT_TRUE(thread.GetLookupResultFd().IsReadable(RESULT_WAIT_MS));
+    std::vector<TMetadataFetchThread::TLookupResult> results =
+        thread.TakeLookupResults();
+    ASSERT_EQ(results.size(), 1U);
+    ASSERT_EQ(results[0].Topics, std::vector<std::string>(1, "topic1"));
+    ASSERT_FALSE(results[0].Metadata);
+    thread.RequestShutdown();
+    thread.Join();
+  }
+
+  TEST_F(TMetadataFetchThreadTest, ShutdownDuringFetchTest) {
+    /* This broker accepts the request, but never responds, so the fetch is
+       still in progress when we request shutdown. */
+    TBlackholeBroker broker;
+    std::vector<THostAndPort> brokers(1, broker.GetHostAndPort());
+    THedgedMetadataFetcher fetcher(TOpt<size_t>(0), 1, 95, 0);
+    TMetadataFetchThread thread(*Cfg, fetcher);
+    thread.Start();
+    thread.RequestFetch(brokers, std::vector<std::string>(), 1);
+    ASSERT_FALSE(thread.GetResultFd().IsReadable(200));
+    uint64_t start = GetMonotonicRawMilliseconds();
+    thread.RequestShutdown();
+    thread.Join();
+    uint64_t elapsed = GetMonotonicRawMilliseconds() - start;
+
+    /* Shutdown doesn't wait for the 60 second socket timeout.  The limit is
+       loose, since only the order of magnitude matters. */
+    ASSERT_LT(elapsed, 10000U);
+    ASSERT_FALSE(thread.GetResultFd().IsReadable());
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
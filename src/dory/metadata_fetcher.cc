@@ -28,7 +28,10 @@
 #include <syslog.h>
 
 #include <base/io_utils.h>
+#include <base/no_default_case.h>
+#include <dory/kafka_proto/api_key.h>
 #include <dory/kafka_proto/errors.h>
+#include <dory/kafka_proto/metadata/version_util.h>
 #include <dory/kafka_proto/request_response.h>
 #include <dory/util/connect_to_host.h>
 #include <dory/util/system_error_codes.h>
@@ -46,6 +49,8 @@ SERVER_COUNTER(BadMetadataResponse);
 SERVER_COUNTER(BadMetadataResponseSize);
 SERVER_COUNTER(MetadataHasEmptyBrokerList);
 SERVER_COUNTER(MetadataHasEmptyTopicList);
+SERVER_COUNTER(MetadataNoCommonApiVersion);
+SERVER_COUNTER(MetadataReconnectForOldBroker);
 SERVER_COUNTER(MetadataResponseHasExtraJunk);
 SERVER_COUNTER(MetadataResponseRead1LostTcpConnection);
 SERVER_COUNTER(MetadataResponseRead1Success);
@@ -61,40 +66,35 @@ SERVER_COUNTER(SendMetadataRequestSuccess);
 SERVER_COUNTER(SendMetadataRequestUnexpectedEnd);
 SERVER_COUNTER(StartSendMetadataRequest);
 
-static std::vector<uint8_t>
-CreateMetadataRequest(const TMetadataProtocol &metadata_protocol) {
-  std::vector<uint8_t> result;
-  metadata_protocol.WriteAllTopicsMetadataRequest(result, 0);
-  return std::move(result);
-}
-
-TMetadataFetcher::TMetadataFetcher(const TMetadataProtocol *metadata_protocol)
-    : MetadataProtocol(metadata_protocol),
-      MetadataRequest(CreateMetadataRequest(*metadata_protocol)) {
+TMetadataFetcher::TMetadataFetcher(const TOpt<size_t> &metadata_api_version)
+    : ForcedApiVersion(metadata_api_version),
+      MetadataProtocol(nullptr),
+      Port(0),
+      ConnectTimeoutMs(-1),
+      ConnectCancelFd(-1) {
 }
 
 bool TMetadataFetcher::Connect(const char *host_name, in_port_t port) {
   assert(this);
-  Disconnect();
-
-  try {
-    ConnectToHost(host_name, port, Sock);
-  } catch (const std::system_error &x) {
-    syslog(LOG_ERR, "Failed to connect to host %s port %d for metadata: %s",
-           host_name, static_cast<int>(port), x.what());
-    assert(!Sock.IsOpen());
-    return false;
-  } catch (const Socket::Db::TError &x) {
-    syslog(LOG_ERR, "Failed to connect to host %s port %d for metadata: %s",
-           host_name, static_cast<int>(port), x.what());
-    assert(!Sock.IsOpen());
-    return false;
-  }
+  HostName = host_name;
+  Port = port;
+  ConnectTimeoutMs = -1;
+  ConnectCancelFd = -1;
+  return DoConnect();
+}
 
-  return Sock.IsOpen();
+bool TMetadataFetcher::Connect(const std::string &host_name, in_port_t port,
+    int timeout_ms, int cancel_fd) {
+  assert(this);
+  HostName = host_name;
+  Port = port;
+  ConnectTimeoutMs = timeout_ms;
+  ConnectCancelFd = cancel_fd;
+  return DoConnect();
 }
 
-std::unique_ptr<TMetadata> TMetadataFetcher::Fetch(int timeout_ms) {
+std::unique_ptr<TMetadata> TMetadataFetcher::Fetch(
+    const std::vector<std::string> &topics, int timeout_ms) {
   assert(this);
 
   if (!Sock.IsOpen()) {
@@ -103,7 +103,18 @@ std::unique_ptr<TMetadata> TMetadataFetcher::Fetch(int timeout_ms) {
 
   std::unique_ptr<TMetadata> result;
 
-  if (!SendRequest(MetadataRequest, timeout_ms) || !ReadResponse(timeout_ms)) {
+  if (!ChooseProtocol(timeout_ms)) {
+    return std::move(result);
+  }
+
+  /* We always use a correlation ID of 0. */
+  if (topics.empty()) {
+    MetadataProtocol->WriteAllTopicsMetadataRequest(RequestBuf, 0);
+  } else {
+    MetadataProtocol->WriteTopicsMetadataRequest(RequestBuf, topics, 0);
+  }
+
+  if (!SendRequest(RequestBuf, timeout_ms) || !ReadResponse(timeout_ms)) {
     return std::move(result);
   }
 
@@ -155,10 +166,13 @@ TMetadataFetcher::TopicAutocreate(const char *topic, int timeout_ms) {
     throw std::logic_error("Must connect to host before getting metadata");
   }
 
-  std::vector<uint8_t> request;
-  MetadataProtocol->WriteSingleTopicMetadataRequest(request, topic, 0);
+  if (!ChooseProtocol(timeout_ms)) {
+    return TTopicAutocreateResult::TryOtherBroker;
+  }
+
+  MetadataProtocol->WriteSingleTopicMetadataRequest(RequestBuf, topic, 0);
 
-  if (!SendRequest(request, timeout_ms) || !ReadResponse(timeout_ms)) {
+  if (!SendRequest(RequestBuf, timeout_ms) || !ReadResponse(timeout_ms)) {
     return TTopicAutocreateResult::TryOtherBroker;
   }
 
@@ -177,6 +191,108 @@ TMetadataFetcher::TopicAutocreate(const char *topic, int timeout_ms) {
                    TTopicAutocreateResult::Fail;
 }
 
+bool TMetadataFetcher::DoConnect() {
+  assert(this);
+  Disconnect();
+
+  try {
+    if ((ConnectTimeoutMs < 0) && (ConnectCancelFd < 0)) {
+      ConnectToHost(HostName, Port, Sock);
+    } else {
+      ConnectToHost(HostName, Port, Sock, ConnectTimeoutMs, ConnectCancelFd);
+    }
+  } catch (const std::system_error &x) {
+    syslog(LOG_ERR, "Failed to connect to host %s port %d for metadata: %s",
+           HostName.c_str(), static_cast<int>(Port), x.what());
+    assert(!Sock.IsOpen());
+    return false;
+  } catch (const Socket::Db::TError &x) {
+    syslog(LOG_ERR, "Failed to connect to host %s port %d for metadata: %s",
+           HostName.c_str(), static_cast<int>(Port), x.what());
+    assert(!Sock.IsOpen());
+    return false;
+  }
+
+  return Sock.IsOpen();
+}
+
+const TMetadataProtocol *TMetadataFetcher::GetProtocol(size_t api_version) {
+  assert(this);
+
+  if (api_version >= Protocols.size()) {
+    Protocols.resize(api_version + 1);
+  }
+
+  std::unique_ptr<const TMetadataProtocol> &p = Protocols[api_version];
+
+  if (!p) {
+    p.reset(ChooseMetadataProto(api_version));
+    assert(p);
+  }
+
+  return p.get();
+}
+
+bool TMetadataFetcher::ChooseProtocol(int timeout_ms) {
+  assert(this);
+  assert(Sock.IsOpen());
+
+  if (MetadataProtocol) {
+    return true;
+  }
+
+  if (ForcedApiVersion.IsKnown()) {
+    MetadataProtocol = GetProtocol(*ForcedApiVersion);
+    return true;
+  }
+
+  /* Version 0 is supported by all brokers. */
+  size_t version = 0;
+
+  switch (ApiVersionsFetcher.Fetch(Sock, timeout_ms)) {
+    case TApiVersionsFetcher::TResult::Ok: {
+      TOpt<size_t> opt_version = ApiVersionsFetcher.ChooseVersion(
+          TApiKey::Metadata, GetSupportedMetadataApiVersions());
+
+      if (opt_version.IsKnown()) {
+        version = *opt_version;
+      } else {
+        MetadataNoCommonApiVersion.Increment();
+        syslog(LOG_WARNING, "Broker %s port %d supports no metadata API "
+            "version known to Dory: trying version 0", HostName.c_str(),
+            static_cast<int>(Port));
+      }
+
+      break;
+    }
+    case TApiVersionsFetcher::TResult::NotSupported: {
+      /* The broker predates ApiVersions requests and may have closed the
+         connection on us. */
+      MetadataReconnectForOldBroker.Increment();
+
+      if (!DoConnect()) {
+        return false;
+      }
+
+      break;
+    }
+    case TApiVersionsFetcher::TResult::Error: {
+      return false;
+    }
+    NO_DEFAULT_CASE;
+  }
+
+  if (!LastNegotiatedVersion.IsKnown() || (*LastNegotiatedVersion != version)) {
+    syslog(LOG_NOTICE, "Using metadata API version %lu with broker %s port %d",
+        static_cast<unsigned long>(version), HostName.c_str(),
+        static_cast<int>(Port));
+    LastNegotiatedVersion = version;
+  }
+
+  MetadataProtocol = GetProtocol(version);
+  return true;
+}
+
 bool TMetadataFetcher::SendRequest(const std::vector<uint8_t> &request,
     int timeout_ms) {
   assert(this);
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -31,6 +32,8 @@
 
 #include <base/fd.h>
 #include <base/no_copy_semantics.h>
+#include <base/opt.h>
+#include <dory/api_versions_fetcher.h>
 #include <dory/kafka_proto/metadata/metadata_protocol.h>
 #include <dory/metadata.h>
 
@@ -56,8 +59,11 @@ namespace Dory {
       TMetadataFetcher &Fetcher;
     };  // TDisconnecter
 
-    explicit TMetadataFetcher(
-        const KafkaProto::Metadata::TMetadataProtocol *metadata_protocol);
+    /* If 'metadata_api_version' is known, always use that version of the
+       metadata API.  Otherwise, on each new connection ask the broker which
+       versions it supports, and use the highest version supported by both
+       Dory and the broker. */
+    explicit TMetadataFetcher(const Base::TOpt<size_t> &metadata_api_version);
 
     /* Return true on success or false on failure. */
     bool Connect(const char *host_name, in_port_t port);
@@ -68,15 +74,39 @@ namespace Dory {
       return Connect(host_name.c_str(), port);
     }
 
+    /* Same as above, except that connecting gives up after 'timeout_ms'
+       milliseconds, or as soon as 'cancel_fd' becomes readable.  These also
+       apply when reconnecting to a broker that doesn't support ApiVersions
+       requests. */
+    bool Connect(const std::string &host_name, in_port_t port, int timeout_ms,
+        int cancel_fd);
+
+    /* Return the socket for the current connection.  It is not open if we are
+       not connected. */
+    const Base::TFd &GetSock() const {
+      assert(this);
+      return Sock;
+    }
+
     void Disconnect() noexcept {
       assert(this);
       Sock.Reset();
+      MetadataProtocol = nullptr;
     }
 
     /* On success, returned unique_ptr will contain metadata.  On failure,
        returned unique_ptr will be empty.  Timeout is specified in
        milliseconds.  A negative timeout value means "infinite timeout". */
-    std::unique_ptr<TMetadata> Fetch(int timeout_ms = -1);
+    std::unique_ptr<TMetadata> Fetch(int timeout_ms = -1) {
+      assert(this);
+      return Fetch(std::vector<std::string>(), timeout_ms);
+    }
+
+    /* Same as above, but only get metadata for the topics in 'topics'.  If
+       'topics' is empty, get metadata for all topics.  Topics that don't exist
+       are omitted from the returned metadata. */
+    std::unique_ptr<TMetadata> Fetch(const std::vector<std::string> &topics,
+        int timeout_ms = -1);
 
     enum class TTopicAutocreateResult {
       /* Topic was successfully created. */
@@ -97,21 +127,52 @@ namespace Dory {
     TTopicAutocreateResult TopicAutocreate(const char *topic, int timeout_ms);
 
     private:
+    bool DoConnect();
+
+    const KafkaProto::Metadata::TMetadataProtocol *GetProtocol(
+        size_t api_version);
+
+    /* Choose the metadata protocol version for the current connection, if not
+       already chosen.  Return true on success or false on failure. */
+    bool ChooseProtocol(int timeout_ms);
+
     bool SendRequest(const std::vector<uint8_t> &request, int timeout_ms);
 
     bool ReadResponse(int timeout_ms);
 
-    const std::unique_ptr<const KafkaProto::Metadata::TMetadataProtocol>
-        MetadataProtocol;
+    /* Metadata API version specified in config, or unknown if we should
+       negotiate with each broker. */
+    const Base::TOpt<size_t> ForcedApiVersion;
+
+    /* Index is API version.  Protocol objects are created on demand. */
+    std::vector<std::unique_ptr<const KafkaProto::Metadata::TMetadataProtocol>>
+        Protocols;
+
+    /* Protocol chosen for current connection, or nullptr if not yet chosen.
+     */
+    const KafkaProto::Metadata::TMetadataProtocol *MetadataProtocol;
+
+    /* Version chosen by last negotiation, for logging version changes. */
+    Base::TOpt<size_t> LastNegotiatedVersion;
+
+    TApiVersionsFetcher ApiVersionsFetcher;
 
-    /* This is the all topics metadata request that we send to a broker.  It is
-       always the same sequence of bytes (since we always use a correlation ID
-       of 0), so we may as well make it a constant and initialize it in the
-       constructor. */
-    const std::vector<uint8_t> MetadataRequest;
+    /* Host and port of current connection, needed for reconnecting to a
+       broker that doesn't support ApiVersions requests. */
+    std::string HostName;
+
+    in_port_t Port;
+
+    /* Connect timeout in milliseconds, or -1 for no timeout. */
+    int ConnectTimeoutMs;
+
+    /* FD that cancels a connection attempt when readable, or -1 if none. */
+    int ConnectCancelFd;
 
     Base::TFd Sock;
 
+    std::vector<uint8_t> RequestBuf;
+
     std::vector<uint8_t> ResponseBuf;
   };  // TMetadataFetcher
 
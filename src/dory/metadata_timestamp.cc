@@ -48,3 +48,27 @@ void TMetadataTimestamp::GetTimes(uint64_t &last_update_time,
   last_update_time = LastUpdateTime;
   last_modified_time = LastModifiedTime;
 }
+
+void TMetadataTimestamp::RecordStall(uint64_t stall_time) {
+  assert(this);
+
+  std::lock_guard<std::mutex> lock(Mutex);
+  ++StallCount;
+  StallTotalTime += stall_time;
+  StallLastTime = stall_time;
+
+  if (stall_time > StallMaxTime) {
+    StallMaxTime = stall_time;
+  }
+}
+
+void TMetadataTimestamp::GetStallStats(uint64_t &stall_count,
+    uint64_t &total_time, uint64_t &max_time, uint64_t &last_time) const {
+  assert(this);
+
+  std::lock_guard<std::mutex> lock(Mutex);
+  stall_count = StallCount;
+  total_time = StallTotalTime;
+  max_time = StallMaxTime;
+  last_time = StallLastTime;
+}
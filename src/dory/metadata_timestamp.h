@@ -37,7 +37,11 @@ namespace Dory {
     /* Trivial constructor. */
     TMetadataTimestamp()
         : LastUpdateTime(0),
-          LastModifiedTime(0) {
+          LastModifiedTime(0),
+          StallCount(0),
+          StallTotalTime(0),
+          StallMaxTime(0),
+          StallLastTime(0) {
     }
 
     /* Called by router thread when it updates its metadata. */
@@ -48,9 +52,18 @@ namespace Dory {
     void GetTimes(uint64_t &last_update_time,
                   uint64_t &last_modified_time) const;
 
+    /* Called by router thread after it has spent 'stall_time' milliseconds
+       blocked waiting for metadata, unable to route messages. */
+    void RecordStall(uint64_t stall_time);
+
+    /* Called by Mongoose thread to report router thread stalls on metadata.
+       Times are in milliseconds. */
+    void GetStallStats(uint64_t &stall_count, uint64_t &total_time,
+        uint64_t &max_time, uint64_t &last_time) const;
+
     private:
-    /* Protects 'LastUpdateTime' and 'LastModifiedTime' from concurrent access
-       by Mongoose and the router thread. */
+    /* Protects all remaining members from concurrent access by Mongoose and
+       the router thread. */
     mutable std::mutex Mutex;
 
     /* Updated with current time in UTC whenever router thread gets new
@@ -61,6 +74,16 @@ namespace Dory {
     /* Updated with current time in UTC whenever router thread gets new
        metadata and replaces its current metadata with the new metadata. */
     uint64_t LastModifiedTime;
+
+    /* Number of times the router thread has blocked waiting for metadata. */
+    uint64_t StallCount;
+
+    /* Total, maximum, and most recent stall durations in milliseconds. */
+    uint64_t StallTotalTime;
+
+    uint64_t StallMaxTime;
+
+    uint64_t StallLastTime;
   };  // TMetadataTimestamp
 
 }  // Dory
@@ -21,6 +21,9 @@
 
 #include <dory/mock_kafka_server/config.h>
 
+#include <cstdlib>
+#include <string>
+
 #include <base/basename.h>
 #include <dory/build_id.h>
 #include <dory/util/arg_parse_error.h>
@@ -28,9 +31,71 @@
 
 using namespace Base;
 using namespace Dory;
+using namespace Dory::KafkaProto::ApiVersions;
 using namespace Dory::MockKafkaServer;
 using namespace Dory::Util;
 
+/* These are the versions the mock server knows how to handle. */
+static const char DEFAULT_ADVERTISED_API_VERSIONS[] = "0:0:0,3:0:1,18:0:0";
+
+static bool ParseInt16(const std::string &s, int16_t &result) {
+  if (s.empty()) {
+    return false;
+  }
+
+  char *end = nullptr;
+  long value = std::strtol(s.c_str(), &end, 10);
+
+  if ((*end != '\0') || (value < 0) || (value > 32767)) {
+    return false;
+  }
+
+  result = static_cast<int16_t>(value);
+  return true;
+}
+
+/* Parse a comma-separated list of KEY:MIN:MAX items, or the special value
+   "none". */
+static void ParseAdvertisedApiVersions(const std::string &spec,
+    TConfig &config) {
+  config.AdvertisedApiVersions.clear();
+
+  if (spec == "none") {
+    config.ApiVersionsSupported = false;
+    return;
+  }
+
+  config.ApiVersionsSupported = true;
+  size_t pos = 0;
+
+  while (pos <= spec.size()) {
+    size_t comma = spec.find(',', pos);
+
+    if (comma == std::string::npos) {
+      comma = spec.size();
+    }
+
+    std::string item = spec.substr(pos, comma - pos);
+    size_t colon1 = item.find(':');
+    size_t colon2 = (colon1 == std::string::npos) ?
+        std::string::npos : item.find(':', colon1 + 1);
+    TApiVersionRange range;
+
+    if ((colon2 == std::string::npos) ||
+        !ParseInt16(item.substr(0, colon1), range.ApiKey) ||
+        !ParseInt16(item.substr(colon1 + 1, colon2 - colon1 - 1),
+            range.MinVersion) ||
+        !ParseInt16(item.substr(colon2 + 1), range.MaxVersion) ||
+        (range.MinVersion > range.MaxVersion)) {
+      throw TArgParseError("Invalid item [" + item +
+          "] in --advertised_api_versions: expected KEY:MIN:MAX");
+    }
+
+    config.AdvertisedApiVersions.push_back(range);
+    pos = comma + 1;
+  }
+}
+
 static void ParseArgs(int argc, char *argv[], TConfig &config) {
   using namespace TCLAP;
   const std::string prog_name = Basename(argv[0]);
@@ -51,6 +116,14 @@ static void ParseArgs(int argc, char *argv[], TConfig &config) {
         "(currently only 0 is supported).", false, config.MetadataApiVersion,
         "VERSION");
     cmd.add(arg_metadata_api_version);
+    ValueArg<std::string> arg_advertised_api_versions("",
+        "advertised_api_versions", "API versions to advertise in response to "
+        "ApiVersions requests, as a comma-separated list of KEY:MIN:MAX items "
+        "(for instance, 3:0:1 for metadata versions 0 through 1).  The value "
+        "\"none\" emulates a broker older than Kafka 0.10.0, which "
+        "disconnects on receipt of an ApiVersions request.", false,
+        DEFAULT_ADVERTISED_API_VERSIONS, "VERSIONS");
+    cmd.add(arg_advertised_api_versions);
     ValueArg<decltype(config.QuietLevel)> arg_quiet_level("", "quiet_level",
         "Limit output verbosity.", false, config.QuietLevel, "LEVEL");
     cmd.add(arg_quiet_level);
@@ -75,6 +148,8 @@ static void ParseArgs(int argc, char *argv[], TConfig &config) {
     config.OutputDir = arg_output_dir.getValue();
     config.CmdPort = arg_cmd_port.getValue();
     config.SingleOutputFile = arg_single_output_file.getValue();
+    ParseAdvertisedApiVersions(arg_advertised_api_versions.getValue(),
+        config);
   } catch (const ArgException &x) {
     throw TArgParseError(x.error(), x.argId());
   }
@@ -84,6 +159,7 @@ TConfig::TConfig(int argc, char *argv[])
     : LogEcho(false),
       ProduceApiVersion(0),
       MetadataApiVersion(0),
+      ApiVersionsSupported(true),
       QuietLevel(0),
       CmdPort(9080),
       SingleOutputFile(false) {
@@ -24,9 +24,12 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include <netinet/in.h>
 
+#include <dory/kafka_proto/api_versions/api_version_range.h>
+
 namespace Dory {
 
   namespace MockKafkaServer {
@@ -41,6 +44,14 @@ namespace Dory {
 
       size_t MetadataApiVersion;
 
+      /* If false, emulate a broker older than Kafka 0.10.0 by disconnecting
+         on receipt of an ApiVersions request. */
+      bool ApiVersionsSupported;
+
+      /* API version ranges to advertise in ApiVersions responses. */
+      std::vector<KafkaProto::ApiVersions::TApiVersionRange>
+          AdvertisedApiVersions;
+
       size_t QuietLevel;
 
       std::string SetupFile;
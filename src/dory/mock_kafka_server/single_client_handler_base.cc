@@ -33,6 +33,9 @@
 #include <base/no_default_case.h>
 #include <base/opt.h>
 #include <dory/compress/compression_type.h>
+#include <dory/kafka_proto/api_key.h>
+#include <dory/kafka_proto/api_versions/api_versions_request_reader.h>
+#include <dory/kafka_proto/api_versions/api_versions_response_writer.h>
 #include <dory/kafka_proto/produce/msg_set_reader_api.h>
 #include <dory/mock_kafka_server/cmd.h>
 #include <dory/mock_kafka_server/cmd_bucket.h>
@@ -41,6 +44,8 @@
 using namespace Base;
 using namespace Dory;
 using namespace Dory::Compress;
+using namespace Dory::KafkaProto;
+using namespace Dory::KafkaProto::ApiVersions;
 using namespace Dory::KafkaProto::Produce;
 using namespace Dory::MockKafkaServer;
 using namespace Dory::MockKafkaServer::ProdReq;
@@ -227,12 +232,22 @@ TSingleClientHandlerBase::GetRequestType() {
   int16_t api_key = ReadInt16FromHeader(&InputBuf[4]);
 
   switch (api_key) {
-    case 0: {
+    case static_cast<int16_t>(TApiKey::Produce): {
       return TRequestType::ProduceRequest;
     }
-    case 3: {
+    case static_cast<int16_t>(TApiKey::Metadata): {
       return TRequestType::MetadataRequest;
     }
+    case static_cast<int16_t>(TApiKey::ApiVersions): {
+      /* Brokers older than Kafka 0.10.0 don't know about ApiVersions
+         requests, and close the connection as for any other unknown request
+         type. */
+      if (Config.ApiVersionsSupported) {
+        return TRequestType::ApiVersionsRequest;
+      }
+
+      break;
+    }
     default: {
       break;
     }
@@ -709,6 +724,50 @@ bool TSingleClientHandlerBase::HandleMetadataRequest() {
   return true;
 }
 
+bool TSingleClientHandlerBase::HandleApiVersionsRequest() {
+  assert(this);
+  int32_t correlation_id = 0;
+
+  try {
+    TApiVersionsRequestReader reader(&InputBuf[0], InputBuf.size());
+    correlation_id = reader.GetCorrelationId();
+  } catch (const std::runtime_error &x) {
+    Out << "Error: Got bad ApiVersions request: " << x.what() << std::endl;
+    return false;
+  }
+
+  Out << "api_versions corr=" << correlation_id << " count="
+      << Config.AdvertisedApiVersions.size() << std::endl;
+  TApiVersionsResponseWriter().WriteResponse(OutputBuf, correlation_id, 0,
+      Config.AdvertisedApiVersions);
+
+  switch (TryWriteExactlyOrShutdown(ClientSocket, &OutputBuf[0],
+                                    OutputBuf.size())) {
+    case TIoResult::Success: {
+      break;
+    }
+    case TIoResult::Disconnected: {
+      Out << "Error: Got disconnected from client while sending ApiVersions "
+          << "response" << std::endl;
+      return false;
+    }
+    case TIoResult::UnexpectedEnd:
+    case TIoResult::EmptyReadUnexpectedEnd: {
+      Out << "Error: Got disconnected unexpectedly from client while sending "
+          << "ApiVersions response" << std::endl;
+      return false;
+    }
+    case TIoResult::GotShutdownRequest: {
+      Out << "Info: Got shutdown request while sending ApiVersions response"
+          << std::endl;
+      return false;
+    }
+    NO_DEFAULT_CASE;
+  }
+
+  return true;
+}
+
 const TSetup::TPartition *TSingleClientHandlerBase::FindPartition(
     const std::string &topic, int32_t partition) const {
   assert(this);
@@ -797,6 +856,10 @@ void TSingleClientHandlerBase::DoRun() {
         done = !HandleMetadataRequest();
         break;
       }
+      case TRequestType::ApiVersionsRequest: {
+        done = !HandleApiVersionsRequest();
+        break;
+      }
       NO_DEFAULT_CASE;
     }
 
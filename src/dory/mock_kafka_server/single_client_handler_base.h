@@ -75,7 +75,8 @@ namespace Dory {
       enum class TRequestType {
         UnknownRequest,
         ProduceRequest,
-        MetadataRequest
+        MetadataRequest,
+        ApiVersionsRequest
       };  // TRequestType
 
       struct TMetadataRequest {
@@ -187,6 +188,8 @@ namespace Dory {
 
       bool HandleMetadataRequest();
 
+      bool HandleApiVersionsRequest();
+
       const TSetup::TPartition *FindPartition(const std::string &topic,
           int32_t partition) const;
 
@@ -45,7 +45,7 @@ using namespace Base;
 using namespace Socket;
 using namespace Dory;
 using namespace Dory::KafkaProto;
-using namespace Dory::KafkaProto::Metadata::V0;
+using namespace Dory::KafkaProto::Metadata;
 using namespace Dory::KafkaProto::Produce;
 using namespace Dory::KafkaProto::Produce::V0;
 using namespace Dory::MockKafkaServer;
@@ -70,11 +70,53 @@ TProduceResponseWriterApi &TV0ClientHandler::GetProduceResponseWriter() {
   return ProduceResponseWriter;
 }
 
+/* The following overloads hide the differences between version 0 and version
+   1 metadata responses. */
+
+static void AddBroker(Metadata::V0::TMetadataResponseWriter &writer, int32_t node_id,
+    const char *host_begin, const char *host_end, int32_t port) {
+  writer.AddBroker(node_id, host_begin, host_end, port);
+}
+
+static void AddBroker(Metadata::V1::TMetadataResponseWriter &writer, int32_t node_id,
+    const char *host_begin, const char *host_end, int32_t port) {
+  /* Report a null rack. */
+  writer.AddBroker(node_id, host_begin, host_end, port, nullptr, nullptr);
+}
+
+static void CloseBrokerList(Metadata::V0::TMetadataResponseWriter &writer) {
+  writer.CloseBrokerList();
+}
+
+static void CloseBrokerList(Metadata::V1::TMetadataResponseWriter &writer) {
+  /* Pretend the first broker is the controller. */
+  writer.CloseBrokerList(0);
+}
+
+static void OpenTopic(Metadata::V0::TMetadataResponseWriter &writer, int16_t error,
+    const char *name_begin, const char *name_end) {
+  writer.OpenTopic(error, name_begin, name_end);
+}
+
+static void OpenTopic(Metadata::V1::TMetadataResponseWriter &writer, int16_t error,
+    const char *name_begin, const char *name_end) {
+  writer.OpenTopic(error, name_begin, name_end, false);
+}
+
 bool TV0ClientHandler::ValidateMetadataRequestHeader() {
   assert(this);
 
   try {
-    OptMetadataRequestReader.MakeKnown(&InputBuf[0], InputBuf.size());
+    if ((InputBuf.size() >=
+         (Metadata::V1::TMetadataRequestFields::API_VERSION_OFFSET +
+          Metadata::V1::TMetadataRequestFields::API_VERSION_SIZE)) &&
+        (ReadInt16FromHeader(
+             &InputBuf[Metadata::V1::TMetadataRequestFields::API_VERSION_OFFSET]) ==
+         Metadata::V1::TMetadataRequestFields::API_VERSION)) {
+      OptV1MetadataRequestReader.MakeKnown(&InputBuf[0], InputBuf.size());
+    } else {
+      OptMetadataRequestReader.MakeKnown(&InputBuf[0], InputBuf.size());
+    }
   } catch (const std::runtime_error &x) {
     Out << x.what() << std::endl;
     return false;
@@ -85,27 +127,48 @@ bool TV0ClientHandler::ValidateMetadataRequestHeader() {
 
 bool TV0ClientHandler::ValidateMetadataRequest(
           TMetadataRequest &request) {
-  assert(OptMetadataRequestReader.IsKnown());
-  request.CorrelationId = OptMetadataRequestReader->GetCorrelationId();
+  assert(OptMetadataRequestReader.IsKnown() ||
+      OptV1MetadataRequestReader.IsKnown());
+
+  bool all_topics = false;
+  const char *topic_begin = nullptr;
+  const char *topic_end = nullptr;
+
+  if (OptV1MetadataRequestReader.IsKnown()) {
+    const Metadata::V1::TMetadataRequestReader &reader =
+        *OptV1MetadataRequestReader;
+    request.CorrelationId = reader.GetCorrelationId();
+    all_topics = reader.IsAllTopics();
+    topic_begin = reader.GetTopicBegin();
+    topic_end = reader.GetTopicEnd();
+  } else {
+    const Metadata::V0::TMetadataRequestReader &reader =
+        *OptMetadataRequestReader;
+    request.CorrelationId = reader.GetCorrelationId();
+    all_topics = reader.IsAllTopics();
+    topic_begin = reader.GetTopicBegin();
+    topic_end = reader.GetTopicEnd();
+  }
 
-  if (OptMetadataRequestReader->IsAllTopics()) {
+  if (all_topics) {
     request.Topic.clear();
   } else {
-    request.Topic.assign(OptMetadataRequestReader->GetTopicBegin(),
-                         OptMetadataRequestReader->GetTopicEnd());
+    request.Topic.assign(topic_begin, topic_end);
   }
 
   return true;
 }
 
-TSingleClientHandlerBase::TSendMetadataResult
-TV0ClientHandler::SendMetadataResponse(const TMetadataRequest &request,
-    int16_t error, const std::string &error_topic, size_t delay) {
+template <typename TWriter>
+TSingleClientHandlerBase::TAction
+TV0ClientHandler::WriteMetadataResponse(TWriter &writer,
+    const TMetadataRequest &request, int16_t error,
+    const std::string &error_topic, int16_t &code,
+    std::string &topic_for_code) {
   char host_name[1024];
   IfLt0(gethostname(host_name, sizeof(host_name)));
   size_t host_name_len = std::strlen(host_name);
   const char *host_name_end = &host_name[host_name_len];
-  TMetadataResponseWriter writer;
   writer.OpenResponse(MdResponseBuf, request.CorrelationId);
   writer.OpenBrokerList();
 
@@ -116,15 +179,15 @@ TV0ClientHandler::SendMetadataResponse(const TMetadataRequest &request,
     in_port_t phys_port = PortMap->VirtualPortToPhys(Setup.BasePort + node_id);
     assert(phys_port);
 
-    writer.AddBroker(node_id, host_name, host_name_end, phys_port);
+    AddBroker(writer, node_id, host_name, host_name_end, phys_port);
   }
 
-  writer.CloseBrokerList();
+  CloseBrokerList(writer);
   writer.OpenTopicList();
   std::string topic;
   TAction action = TAction::Respond;
-  int16_t code = 0;
-  std::string topic_for_code;
+  code = 0;
+  topic_for_code.clear();
 
   if (request.Topic.empty()) {
     for (auto iter = Setup.Topics.begin();
@@ -168,7 +231,7 @@ TV0ClientHandler::SendMetadataResponse(const TMetadataRequest &request,
       code = 3;
       topic_for_code = request.Topic;
       action = TAction::RejectBadDest;
-      writer.OpenTopic(3, topic_begin, topic_end);
+      OpenTopic(writer, 3, topic_begin, topic_end);
       writer.CloseTopic();
     } else {
       WriteSingleTopic(writer, iter->second, topic_begin, topic_end,
@@ -178,9 +241,55 @@ TV0ClientHandler::SendMetadataResponse(const TMetadataRequest &request,
 
   writer.CloseTopicList();
   writer.CloseResponse();
+  return action;
+}
+
+template <typename TWriter>
+void TV0ClientHandler::WriteSingleTopic(TWriter &writer,
+    const TSetup::TTopic &topic, const char *name_begin,
+    const char *name_end, int16_t error) {
+  OpenTopic(writer, error, name_begin, name_end);
+  writer.OpenPartitionList();
+  const std::vector<TSetup::TPartition> &pvec = topic.Partitions;
+  size_t node_id = topic.FirstPortOffset;
+  size_t node_count = Setup.Ports.size();
+  assert(node_id < node_count);
+
+  for (size_t i = 0; i < pvec.size(); ++i) {
+    writer.OpenPartition(0, i, node_id);
+    writer.OpenReplicaList();
+    writer.CloseReplicaList();
+    writer.OpenCaughtUpReplicaList();
+    writer.CloseCaughtUpReplicaList();
+    writer.ClosePartition();
+    node_id = (node_id + 1) % node_count;
+  }
+
+  writer.ClosePartitionList();
+  writer.CloseTopic();
+}
+
+TSingleClientHandlerBase::TSendMetadataResult
+TV0ClientHandler::SendMetadataResponse(const TMetadataRequest &request,
+    int16_t error, const std::string &error_topic, size_t delay) {
+  int16_t code = 0;
+  std::string topic_for_code;
+  TAction action = TAction::Respond;
+
+  if (OptV1MetadataRequestReader.IsKnown()) {
+    Metadata::V1::TMetadataResponseWriter writer;
+    action = WriteMetadataResponse(writer, request, error, error_topic, code,
+        topic_for_code);
+  } else {
+    Metadata::V0::TMetadataResponseWriter writer;
+    action = WriteMetadataResponse(writer, request, error, error_topic, code,
+        topic_for_code);
+  }
+
   PrintMdReq(GetMetadataRequestCount(), request, action, topic_for_code, code,
              delay);
   OptMetadataRequestReader.Reset();
+  OptV1MetadataRequestReader.Reset();
 
   switch (TryWriteExactlyOrShutdown(ClientSocket, &MdResponseBuf[0],
                                     MdResponseBuf.size())) {
@@ -209,27 +318,3 @@ TV0ClientHandler::SendMetadataResponse(const TMetadataRequest &request,
 
   return TSendMetadataResult::SentMetadata;
 }
-
-void TV0ClientHandler::WriteSingleTopic(TMetadataResponseWriter &writer,
-    const TSetup::TTopic &topic, const char *name_begin,
-    const char *name_end, int16_t error) {
-  writer.OpenTopic(error, name_begin, name_end);
-  writer.OpenPartitionList();
-  const std::vector<TSetup::TPartition> &pvec = topic.Partitions;
-  size_t node_id = topic.FirstPortOffset;
-  size_t node_count = Setup.Ports.size();
-  assert(node_id < node_count);
-
-  for (size_t i = 0; i < pvec.size(); ++i) {
-    writer.OpenPartition(0, i, node_id);
-    writer.OpenReplicaList();
-    writer.CloseReplicaList();
-    writer.OpenCaughtUpReplicaList();
-    writer.CloseCaughtUpReplicaList();
-    writer.ClosePartition();
-    node_id = (node_id + 1) % node_count;
-  }
-
-  writer.ClosePartitionList();
-  writer.CloseTopic();
-}
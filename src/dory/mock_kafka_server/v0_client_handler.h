@@ -16,7 +16,9 @@
    limitations under the License.
    ----------------------------------------------------------------------------
 
-   Kafka protocol version 0 support for mock Kafka server.
+   Kafka protocol version 0 support for mock Kafka server.  Version 1 metadata
+   requests are also handled here, since they differ from version 0 only in
+   wire format.
  */
 
 #pragma once
@@ -33,6 +35,8 @@
 #include <base/opt.h>
 #include <dory/kafka_proto/metadata/v0/metadata_request_reader.h>
 #include <dory/kafka_proto/metadata/v0/metadata_response_writer.h>
+#include <dory/kafka_proto/metadata/v1/metadata_request_reader.h>
+#include <dory/kafka_proto/metadata/v1/metadata_response_writer.h>
 #include <dory/kafka_proto/produce/v0/msg_set_reader.h>
 #include <dory/kafka_proto/produce/v0/produce_request_reader.h>
 #include <dory/kafka_proto/produce/v0/produce_response_writer.h>
@@ -79,10 +83,17 @@ namespace Dory {
           const std::string &error_topic, size_t delay) override;
 
       private:
-      void WriteSingleTopic(
-          KafkaProto::Metadata::V0::TMetadataResponseWriter &writer,
-          const TSetup::TTopic &topic, const char *name_begin,
-          const char *name_end, int16_t error);
+      /* 'TWriter' is the metadata response writer for either version 0 or
+         version 1. */
+      template <typename TWriter>
+      TAction WriteMetadataResponse(TWriter &writer,
+          const TMetadataRequest &request, int16_t error,
+          const std::string &error_topic, int16_t &code,
+          std::string &topic_for_code);
+
+      template <typename TWriter>
+      void WriteSingleTopic(TWriter &writer, const TSetup::TTopic &topic,
+          const char *name_begin, const char *name_end, int16_t error);
 
       Dory::KafkaProto::Produce::V0::TProduceRequestReader
           ProduceRequestReader;
@@ -95,6 +106,9 @@ namespace Dory {
       Base::TOpt<KafkaProto::Metadata::V0::TMetadataRequestReader>
           OptMetadataRequestReader;
 
+      Base::TOpt<KafkaProto::Metadata::V1::TMetadataRequestReader>
+          OptV1MetadataRequestReader;
+
       std::vector<uint8_t> MdResponseBuf;
     };  // TV0ClientHandler
 
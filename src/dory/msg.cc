@@ -66,6 +66,12 @@ TMsg::TPtr TMsg::CreatePartitionKeyMsg(int32_t partition_key,
       pool));
 }
 
+TMsg::TPtr TMsg::CreateFlushRequestMsg(TTimestamp timestamp,
+    const void *topic_begin, const void *topic_end, Capped::TPool &pool) {
+  return TPtr(new TMsg(TRoutingType::AnyPartition, 0, timestamp, topic_begin,
+      topic_end, nullptr, 0, nullptr, 0, false, pool, true));
+}
+
 TMsg::~TMsg() noexcept {
   assert(this);
   MsgDestroy.Increment();
@@ -87,11 +93,14 @@ TMsg::~TMsg() noexcept {
 TMsg::TMsg(TRoutingType routing_type, int32_t partition_key,
     TTimestamp timestamp, const void *topic_begin, const void *topic_end,
     const void *key, size_t key_size, const void *value,
-    size_t value_size, bool body_truncated, Capped::TPool &pool)
+    size_t value_size, bool body_truncated, Capped::TPool &pool,
+    bool flush_request)
     : RoutingType(routing_type),
       PartitionKey(partition_key),
       Timestamp(timestamp),
-      CreationTimestamp(GetMonotonicRawMilliseconds()),
+      CreationTimeUsec(GetMonotonicRawMicroseconds()),
+      CreationTimestamp(CreationTimeUsec / 1000),
+      StateEnterTimeUsec(CreationTimeUsec),
       State(TState::New),
       FailedDeliveryAttemptCount(0),
       Topic(reinterpret_cast<const char *>(topic_begin),
@@ -99,7 +108,8 @@ TMsg::TMsg(TRoutingType routing_type, int32_t partition_key,
       Partition(0),
       KeyAndValue(MakeKeyAndValue(key, key_size, value, value_size, pool)),
       KeySize(key_size),
-      BodyTruncated(body_truncated) {
+      BodyTruncated(body_truncated),
+      FlushRequest(flush_request) {
   assert(topic_begin);
   assert(topic_end >= topic_end);
   assert(key || (key_size == 0));
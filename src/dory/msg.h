@@ -100,6 +100,13 @@ namespace Dory {
       return CreationTimestamp;
     }
 
+    /* Same as GetCreationTimestamp(), but in microseconds.  This is used for
+       latency measurement. */
+    uint64_t GetCreationTimeUsec() const {
+      assert(this);
+      return CreationTimeUsec;
+    }
+
     /* Accessor for the Kafka topic string. */
     const std::string &GetTopic() const {
       assert(this);
@@ -155,6 +162,15 @@ namespace Dory {
       return FailedDeliveryAttemptCount;
     }
 
+    /* Returns true iff. this is a flush request from a client rather than a
+       message to send to Kafka.  A flush request tells Dory to stop batching
+       and send all messages it has for the topic.  An empty topic means all
+       topics.  Flush requests are consumed by the router thread. */
+    bool IsFlushRequest() const {
+      assert(this);
+      return FlushRequest;
+    }
+
     TState GetState() const {
       assert(this);
       return State;
@@ -165,6 +181,19 @@ namespace Dory {
       State = state;
     }
 
+    /* Return the monotonic raw time in microseconds at which the message
+       entered its current state.  TMsgStateTracker maintains this along with
+       the state, for latency measurement. */
+    uint64_t GetStateEnterTimeUsec() const {
+      assert(this);
+      return StateEnterTimeUsec;
+    }
+
+    void SetStateEnterTimeUsec(uint64_t usec) {
+      assert(this);
+      StateEnterTimeUsec = usec;
+    }
+
     ~TMsg() noexcept;
 
     private:
@@ -187,11 +216,17 @@ namespace Dory {
         const void *key, size_t key_size, const void *value, size_t value_size,
         bool body_truncated, Capped::TPool &pool);
 
+    /* Create a flush request for the given topic, which may be empty.  The
+       message has an empty key and value. */
+    static TPtr CreateFlushRequestMsg(TTimestamp timestamp,
+        const void *topic_begin, const void *topic_end, Capped::TPool &pool);
+
     /* Constructor is used only by static Create() method. */
     TMsg(TRoutingType routing_type, int32_t partition_key,
          TTimestamp timestamp, const void *topic_begin, const void *topic_end,
          const void *key, size_t key_size, const void *value,
-         size_t value_size, bool body_truncated, Capped::TPool &pool);
+         size_t value_size, bool body_truncated, Capped::TPool &pool,
+         bool flush_request = false);
 
     const TRoutingType RoutingType;
 
@@ -200,6 +235,10 @@ namespace Dory {
     /* Message timestamp from input UNIX domain datagram. */
     const TTimestamp Timestamp;
 
+    /* See GetCreationTimeUsec().  CreationTimestamp is derived from this, so
+       creating a message reads the clock only once. */
+    const uint64_t CreationTimeUsec;
+
     /* This timestamp is used for per-topic message rate limiting, and is set
        based on a call to clock_gettime() with a clock type of
        CLOCK_MONOTONIC_RAW.  We use this clock type specifically because it is
@@ -211,6 +250,9 @@ namespace Dory {
        clock was used to generate that timestamp. */
     const uint64_t CreationTimestamp;
 
+    /* See GetStateEnterTimeUsec(). */
+    uint64_t StateEnterTimeUsec;
+
     /* State of message.  Destructor verifies that value is TState::Processed.
      */
     TState State;
@@ -236,6 +278,9 @@ namespace Dory {
        the maximum allowed length. */
     const bool BodyTruncated;
 
+    /* See IsFlushRequest(). */
+    const bool FlushRequest;
+
     friend class TMsgCreator;
   };  // TMsg
 
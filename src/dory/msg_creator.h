@@ -68,6 +68,15 @@ namespace Dory {
       msg_state_tracker.MsgEnterNew();
       return std::move(msg);
     }
+
+    static TMsg::TPtr CreateFlushRequestMsg(TMsg::TTimestamp timestamp,
+        const void *topic_begin, const void *topic_end, Capped::TPool &pool,
+        TMsgStateTracker &msg_state_tracker) {
+      TMsg::TPtr msg = TMsg::CreateFlushRequestMsg(timestamp, topic_begin,
+          topic_end, pool);
+      msg_state_tracker.MsgEnterNew();
+      return std::move(msg);
+    }
   };  // TMsgCreator
 
 }  // Dory
@@ -52,6 +52,27 @@ namespace Dory {
       Stopped
     };  // TDispatcherState
 
+    /* Load information for a single broker, summed over all of its
+       connections.  The router thread uses this to steer messages that may go
+       to any partition away from slow or backlogged brokers. */
+    struct TBrokerLoad {
+      /* Total size in bytes of messages queued for sending. */
+      uint64_t QueuedBytes;
+
+      /* Total size in bytes of sent produce requests waiting for ACKs. */
+      uint64_t InFlightBytes;
+
+      /* Moving average of ACK latency in microseconds, or 0 if no ACKs have
+         been received yet. */
+      uint64_t AckLatency;
+
+      TBrokerLoad()
+          : QueuedBytes(0),
+            InFlightBytes(0),
+            AckLatency(0) {
+      }
+    };  // TBrokerLoad
+
   }  // MsgDispatch
 
 }  // Dory
@@ -24,6 +24,7 @@
 #include <algorithm>
 
 #include <dory/msg_state_tracker.h>
+#include <dory/util/msg_util.h>
 #include <server/counter.h>
 
 using namespace Base;
@@ -61,18 +62,36 @@ TBrokerMsgQueue::TBrokerMsgQueue(const TGlobalBatchConfig &batch_config,
     TMsgStateTracker &msg_state_tracker)
     : PerTopicBatcher(batch_config.GetPerTopicConfig()),
       CombinedTopicsBatcher(batch_config.GetCombinedTopicsConfig()),
+      DataSize(0),
       MsgStateTracker(msg_state_tracker) {
 }
 
+void TBrokerMsgQueue::SetBrokerId(long broker_id) {
+  assert(this);
+  std::lock_guard<std::mutex> lock(Mutex);
+  TBatchStats &stats = MsgStateTracker.GetBatchStats();
+  PerTopicBatcher.SetStats(&stats, broker_id);
+  CombinedTopicsBatcher.SetStats(&stats, broker_id);
+}
+
+void TBrokerMsgQueue::SetDeliveryEstimate(size_t delivery_estimate) {
+  assert(this);
+  std::lock_guard<std::mutex> lock(Mutex);
+  PerTopicBatcher.SetDeliveryEstimate(delivery_estimate);
+  CombinedTopicsBatcher.SetDeliveryEstimate(delivery_estimate);
+}
+
 void TBrokerMsgQueue::Put(TMsg::TTimestamp now, TMsg::TPtr &&msg) {
   assert(this);
   assert(msg);
   TExpiryStatus per_topic_status, combined_topics_status;
   bool ready_list_empty_initial = false;
   bool ready_list_empty_final = false;
+  size_t data_size = msg->GetKeyAndValue().Size();
 
   {
     std::lock_guard<std::mutex> lock(Mutex);
+    DataSize += data_size;
     ready_list_empty_initial = ReadyList.empty();
     TryBatchPerTopic(now, std::move(msg), per_topic_status);
 
@@ -140,6 +159,7 @@ void TBrokerMsgQueue::PutNow(TMsg::TTimestamp now, TMsg::TPtr &&msg) {
   assert(this);
   assert(msg);
   MsgStateTracker.MsgEnterSendWait(*msg);
+  size_t data_size = msg->GetKeyAndValue().Size();
   std::list<TMsg::TPtr> single_item_list;
   single_item_list.push_back(std::move(msg));
   TExpiryStatus per_topic_status, combined_topics_status;
@@ -147,6 +167,7 @@ void TBrokerMsgQueue::PutNow(TMsg::TTimestamp now, TMsg::TPtr &&msg) {
 
   {
     std::lock_guard<std::mutex> lock(Mutex);
+    DataSize += data_size;
     was_empty = ReadyList.empty();
 
     /* Transfer any ready batches from the batchers to 'ReadyList'. */
@@ -172,11 +193,18 @@ void TBrokerMsgQueue::PutNow(TMsg::TTimestamp now,
   }
 
   MsgStateTracker.MsgEnterSendWait(batch);
+  size_t data_size = 0;
+
+  for (const std::list<TMsg::TPtr> &msg_list : batch) {
+    data_size += Util::GetDataSize(msg_list);
+  }
+
   TExpiryStatus per_topic_status, combined_topics_status;
   bool was_empty = false;
 
   {
     std::lock_guard<std::mutex> lock(Mutex);
+    DataSize += data_size;
     was_empty = ReadyList.empty();
 
     /* Transfer any ready batches from the batchers to 'ReadyList'. */
@@ -194,6 +222,42 @@ void TBrokerMsgQueue::PutNow(TMsg::TTimestamp now,
   }
 }
 
+void TBrokerMsgQueue::Flush(const std::string &topic) {
+  assert(this);
+  bool notify = false;
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    bool was_empty = ReadyList.empty();
+    std::list<std::list<TMsg::TPtr>> batch_list;
+
+    if (topic.empty()) {
+      batch_list = PerTopicBatcher.GetAllBatches();
+      batch_list.splice(batch_list.end(), CombinedTopicsBatcher.TakeBatch());
+    } else {
+      std::list<TMsg::TPtr> batch = PerTopicBatcher.TakeTopicBatch(topic);
+
+      if (!batch.empty()) {
+        batch_list.push_back(std::move(batch));
+      }
+
+      if (CombinedTopicsBatcher.ContainsTopic(topic)) {
+        batch_list.splice(batch_list.end(),
+            CombinedTopicsBatcher.TakeBatch());
+      }
+    }
+
+    MsgStateTracker.MsgEnterSendWait(batch_list);
+    ReadyList.splice(ReadyList.end(), std::move(batch_list));
+    notify = (was_empty && !ReadyList.empty());
+  }
+
+  if (notify) {
+    BrokerMsgQueueNotify.Increment();
+    SenderNotify.Push();
+  }
+}
+
 bool TBrokerMsgQueue::NonblockingGet(TMsg::TTimestamp now,
     TMsg::TTimestamp &next_batch_complete_time,
     std::list<std::list<TMsg::TPtr>> &ready_msgs) {
@@ -206,6 +270,10 @@ bool TBrokerMsgQueue::NonblockingGet(TMsg::TTimestamp now,
     /* Transfer any ready batches from the batchers to 'ReadyList'. */
     CheckBothBatchers(now, per_topic_status, combined_topics_status);
 
+    for (const std::list<TMsg::TPtr> &msg_list : ReadyList) {
+      DataSize -= Util::GetDataSize(msg_list);
+    }
+
     ready_msgs.splice(ready_msgs.end(), std::move(ReadyList));
   }
 
@@ -321,7 +389,7 @@ TBrokerMsgQueue::CheckCombinedTopicsBatcher(TMsg::TTimestamp now,
     if (*expiry_status.OptInitialExpiry <= now) {
       assert(!CombinedTopicsBatcher.IsEmpty());
       ready_batches.splice(ready_batches.end(),
-                           CombinedTopicsBatcher.TakeBatch());
+                           CombinedTopicsBatcher.GetCompleteBatch(now));
       assert(CombinedTopicsBatcher.IsEmpty());
     } else {
       expiry_status.OptFinalExpiry = expiry_status.OptInitialExpiry;
@@ -384,5 +452,6 @@ TBrokerMsgQueue::GetAllMsgs() {
     ReadyList.splice(ReadyList.end(), std::move(combined_topics));
   }
 
+  DataSize = 0;
   return std::move(ReadyList);
 }
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <list>
@@ -65,6 +66,17 @@ namespace Dory {
         return SenderNotify.GetFd();
       }
 
+      /* Set the ID of the broker this queue sends to.  Batches completed
+         afterwards are recorded under that ID in the batch stats kept by
+         'msg_state_tracker'.  Called by the connector thread's owner when the
+         connector gets its metadata. */
+      void SetBrokerId(long broker_id);
+
+      /* Set the expected time in milliseconds to send a batch and get an
+         ACK, for batchers with a latency budget.  Called by the connector
+         thread as it measures ACK latency. */
+      void SetDeliveryEstimate(size_t delivery_estimate);
+
       /* Put 'msg' into the queue, batching it at the broker level if
          appropriate.  The FD returned by GetSenderNotifyFd() will become
          readable if this triggers at least one of the following conditions:
@@ -86,6 +98,14 @@ namespace Dory {
       void PutNow(TMsg::TTimestamp now,
           std::list<std::list<TMsg::TPtr>> &&batch);
 
+      /* Move all batched messages for 'topic' to the ready list, regardless
+         of batch state.  An empty topic specifies all topics.  Since the
+         combined topics batcher keeps a single batch for many topics, its
+         entire batch is moved if it contains messages for 'topic'.  The FD
+         returned by GetSenderNotifyFd() will become readable if the ready
+         list was previously empty and now is nonempty. */
+      void Flush(const std::string &topic);
+
       /* Get all messages ready to send (grouped in per-topic lists) and pass
          them back in 'ready_msgs', which may be empty on return.  If any
          queued messages remain in the batcher, and there is a time limit on
@@ -121,6 +141,14 @@ namespace Dory {
        */
       std::list<std::list<TMsg::TPtr>> Reset();
 
+      /* Return the total size in bytes of the keys and values of all messages
+         in the queue.  This may be called by the router thread without
+         acquiring 'Mutex', so the value may be slightly out of date. */
+      size_t GetDataSize() const {
+        assert(this);
+        return DataSize.load(std::memory_order_relaxed);
+      }
+
       private:
       struct TExpiryStatus {
         Base::TOpt<TMsg::TTimestamp> OptInitialExpiry;
@@ -175,6 +203,10 @@ namespace Dory {
       /* Messages ready to send immediately. */
       std::list<std::list<TMsg::TPtr>> ReadyList;
 
+      /* Total key and value size of all messages in the batchers and
+         'ReadyList'.  Only modified while holding 'Mutex'. */
+      std::atomic<size_t> DataSize;
+
       TMsgStateTracker &MsgStateTracker;
     };  // TBrokerMsgQueue
 
@@ -0,0 +1,138 @@
+/* <dory/msg_dispatch/connection_stats.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/msg_dispatch/connection_stats.h>.
+ */
+
+#include <dory/msg_dispatch/connection_stats.h>
+
+using namespace Dory;
+using namespace Dory::MsgDispatch;
+
+void TConnectionStats::RecordConnect(uint64_t now) {
+  assert(this);
+  Connected = true;
+  ++ConnectCount;
+  uint64_t disconnect_time = DisconnectTime.exchange(0);
+
+  if (disconnect_time) {
+    uint64_t elapsed = (now > disconnect_time) ? (now - disconnect_time) : 0;
+    ++ReconnectCount;
+    ReconnectTime += elapsed;
+    LastReconnectTime = elapsed;
+  }
+}
+
+void TConnectionStats::RecordDisconnect(uint64_t now) {
+  assert(this);
+  EndSendStall(now);
+
+  if (Connected.exchange(false)) {
+    DisconnectTime = now;
+  }
+}
+
+void TConnectionStats::StartSendStall(uint64_t now) {
+  assert(this);
+
+  if (SendStallStart == 0) {
+    ++SendStallCount;
+
+    /* Avoid a start time of 0, which would look like no stall. */
+    SendStallStart = now ? now : 1;
+  }
+}
+
+void TConnectionStats::EndSendStall(uint64_t now) {
+  assert(this);
+
+  if (SendStallStart) {
+    if (now > SendStallStart) {
+      SendStallTime += now - SendStallStart;
+    }
+
+    SendStallStart = 0;
+  }
+}
+
+void TConnectionStats::RecordAckRtt(uint64_t rtt) {
+  assert(this);
+
+  {
+    std::lock_guard<std::mutex> lock(AckRttMutex);
+    AckRttHistogram.Record(rtt);
+  }
+
+  /* Weight the new sample by 1/8, so the average adapts within a few dozen
+     responses. */
+  uint64_t avg = AckLatency;
+  AckLatency = (avg == 0) ? rtt : ((avg * 7) + rtt) / 8;
+}
+
+TConnectionStats &TConnectionStatsTracker::Get(int32_t broker_id,
+    size_t connection_index) {
+  assert(this);
+  std::lock_guard<std::mutex> lock(Mutex);
+  std::unique_ptr<TConnectionStats> &stats =
+      StatsMap[TKey(broker_id, connection_index)];
+
+  if (!stats) {
+    stats.reset(new TConnectionStats);
+  }
+
+  return *stats;
+}
+
+std::vector<TConnectionStatsTracker::TInfo>
+TConnectionStatsTracker::GetInfo() const {
+  assert(this);
+  std::vector<TInfo> result;
+  std::lock_guard<std::mutex> lock(Mutex);
+  result.reserve(StatsMap.size());
+
+  for (const auto &item : StatsMap) {
+    const TConnectionStats &stats = *item.second;
+    TInfo info;
+    info.BrokerId = item.first.first;
+    info.ConnectionIndex = item.first.second;
+    info.Connected = stats.Connected;
+    info.ConnectCount = stats.ConnectCount;
+    info.ConnectFailCount = stats.ConnectFailCount;
+    info.ReconnectCount = stats.ReconnectCount;
+    info.ReconnectTime = stats.ReconnectTime;
+    info.LastReconnectTime = stats.LastReconnectTime;
+    info.RequestsSent = stats.RequestsSent;
+    info.MsgsSent = stats.MsgsSent;
+    info.BytesSent = stats.BytesSent;
+    info.ResponsesReceived = stats.ResponsesReceived;
+    info.BytesReceived = stats.BytesReceived;
+    info.AckWaitQueueSize = stats.AckWaitQueueSize;
+    info.AckWaitBytes = stats.AckWaitBytes;
+    info.AckLatency = stats.AckLatency;
+    info.SendBufBytes = stats.SendBufBytes;
+    info.RequestBytes = stats.RequestBytes;
+    info.UncompressedRequestBytes = stats.UncompressedRequestBytes;
+    info.MaxRequestBytes = stats.MaxRequestBytes;
+    info.SendStallCount = stats.SendStallCount;
+    info.SendStallTime = stats.SendStallTime;
+    info.AckRtt = stats.GetAckRttHistogram();
+    result.push_back(std::move(info));
+  }
+
+  return result;
+}
@@ -0,0 +1,274 @@
+/* <dory/msg_dispatch/connection_stats.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Per-connection statistics for the connections between Dory and the Kafka
+   brokers, reported by the web interface.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <base/no_copy_semantics.h>
+#include <dory/util/histogram.h>
+
+namespace Dory {
+
+  namespace MsgDispatch {
+
+    /* Statistics for a single TCP connection to a Kafka broker.  The
+       connector thread that owns the connection updates the values, and the
+       Mongoose thread reads them, so all members are atomic. */
+    struct TConnectionStats {
+      NO_COPY_SEMANTICS(TConnectionStats);
+
+      TConnectionStats()
+          : Connected(false),
+            ConnectCount(0),
+            ConnectFailCount(0),
+            DisconnectTime(0),
+            ReconnectCount(0),
+            ReconnectTime(0),
+            LastReconnectTime(0),
+            RequestsSent(0),
+            MsgsSent(0),
+            BytesSent(0),
+            ResponsesReceived(0),
+            BytesReceived(0),
+            AckWaitQueueSize(0),
+            AckWaitBytes(0),
+            AckLatency(0),
+            SendBufBytes(0),
+            RequestBytes(0),
+            UncompressedRequestBytes(0),
+            MaxRequestBytes(0),
+            SendStallCount(0),
+            SendStallTime(0),
+            SendStallStart(0) {
+      }
+
+      /* The methods below are called by the connector thread.  Times are from
+         GetMonotonicRawMicroseconds(). */
+
+      /* Record a successful connect at time 'now'.  If the connection was
+         previously lost, also record how long it took to reestablish. */
+      void RecordConnect(uint64_t now);
+
+      /* Record that the connection was closed at time 'now'.  Does nothing if
+         the connection wasn't open.  A send stall in progress ends here. */
+      void RecordDisconnect(uint64_t now);
+
+      /* Return true if a send stall is in progress.  This lets the caller
+         avoid reading the clock when nothing would be recorded. */
+      bool InSendStall() const {
+        assert(this);
+        return (SendStallStart != 0);
+      }
+
+      /* Record that the socket's send buffer filled up at time 'now', leaving
+         part of a produce request unsent.  Does nothing if a stall is already
+         in progress. */
+      void StartSendStall(uint64_t now);
+
+      /* Record that the socket became writable at time 'now'.  Does nothing
+         if no stall is in progress. */
+      void EndSendStall(uint64_t now);
+
+      /* Record the time in microseconds between finishing sending a produce
+         request and receiving its response, and update 'AckLatency'. */
+      void RecordAckRtt(uint64_t rtt);
+
+      /* Return a copy of the histogram of values passed to RecordAckRtt(). */
+      Util::THistogram GetAckRttHistogram() const {
+        assert(this);
+        std::lock_guard<std::mutex> lock(AckRttMutex);
+        return AckRttHistogram;
+      }
+
+      /* True while the connector thread has an open connection to the
+         broker. */
+      std::atomic<bool> Connected;
+
+      /* Number of successful connects. */
+      std::atomic<uint64_t> ConnectCount;
+
+      /* Number of failed connect attempts. */
+      std::atomic<uint64_t> ConnectFailCount;
+
+      /* Time from GetMonotonicRawMicroseconds() when the connection was last
+         lost, or 0 if the connection hasn't been lost since it was last
+         established. */
+      std::atomic<uint64_t> DisconnectTime;
+
+      /* Number of successful connects after losing a connection, and the
+         total and most recent times in microseconds from losing the
+         connection to reestablishing it.  The times include any failed
+         connect attempts and dispatcher restarts in between. */
+      std::atomic<uint64_t> ReconnectCount;
+
+      std::atomic<uint64_t> ReconnectTime;
+
+      std::atomic<uint64_t> LastReconnectTime;
+
+      /* Number of produce requests completely sent. */
+      std::atomic<uint64_t> RequestsSent;
+
+      /* Number of messages in the produce requests completely sent. */
+      std::atomic<uint64_t> MsgsSent;
+
+      std::atomic<uint64_t> BytesSent;
+
+      std::atomic<uint64_t> ResponsesReceived;
+
+      std::atomic<uint64_t> BytesReceived;
+
+      /* Number of sent produce requests waiting for a response. */
+      std::atomic<uint64_t> AckWaitQueueSize;
+
+      /* Total size in bytes of sent produce requests waiting for a response.
+       */
+      std::atomic<uint64_t> AckWaitBytes;
+
+      /* Exponentially weighted moving average of the time in microseconds
+         between finishing sending a produce request and receiving its
+         response. */
+      std::atomic<uint64_t> AckLatency;
+
+      /* Bytes of the produce request currently being sent that haven't yet
+         been written to the socket. */
+      std::atomic<uint64_t> SendBufBytes;
+
+      /* Total size in bytes of produce requests completely sent, and what
+         their total size would have been without compression. */
+      std::atomic<uint64_t> RequestBytes;
+
+      std::atomic<uint64_t> UncompressedRequestBytes;
+
+      /* Size in bytes of the largest produce request sent. */
+      std::atomic<uint64_t> MaxRequestBytes;
+
+      /* Number of times the socket's send buffer filled up, so the connector
+         had to wait for the socket to become writable before sending more of
+         a produce request, and the total time in microseconds spent waiting.
+       */
+      std::atomic<uint64_t> SendStallCount;
+
+      std::atomic<uint64_t> SendStallTime;
+
+      private:
+      /* Time when the current send stall started, or 0 if no stall is in
+         progress.  Only the connector thread accesses this. */
+      uint64_t SendStallStart;
+
+      /* Protects 'AckRttHistogram'. */
+      mutable std::mutex AckRttMutex;
+
+      Util::THistogram AckRttHistogram;
+    };  // TConnectionStats
+
+    /* Owns a TConnectionStats object for each (broker ID, connection index)
+       pair that Dory has used.  Connector threads are destroyed and recreated
+       each time the dispatcher restarts, but the statistics live here so they
+       accumulate over the lifetime of the server. */
+    class TConnectionStatsTracker final {
+      NO_COPY_SEMANTICS(TConnectionStatsTracker);
+
+      public:
+      /* Snapshot of a TConnectionStats object, for reporting. */
+      struct TInfo {
+        int32_t BrokerId;
+
+        size_t ConnectionIndex;
+
+        bool Connected;
+
+        uint64_t ConnectCount;
+
+        uint64_t RequestsSent;
+
+        uint64_t MsgsSent;
+
+        uint64_t BytesSent;
+
+        uint64_t ResponsesReceived;
+
+        uint64_t BytesReceived;
+
+        uint64_t ConnectFailCount;
+
+        uint64_t ReconnectCount;
+
+        uint64_t ReconnectTime;
+
+        uint64_t LastReconnectTime;
+
+        uint64_t AckWaitQueueSize;
+
+        uint64_t AckWaitBytes;
+
+        uint64_t AckLatency;
+
+        uint64_t SendBufBytes;
+
+        uint64_t RequestBytes;
+
+        uint64_t UncompressedRequestBytes;
+
+        uint64_t MaxRequestBytes;
+
+        uint64_t SendStallCount;
+
+        uint64_t SendStallTime;
+
+        Util::THistogram AckRtt;
+      };  // TInfo
+
+      TConnectionStatsTracker() = default;
+
+      /* Called by the router thread when starting the dispatcher.  Return the
+         stats object for the given broker and connection, creating it if it
+         doesn't yet exist.  The returned reference remains valid for the
+         lifetime of the tracker. */
+      TConnectionStats &Get(int32_t broker_id, size_t connection_index);
+
+      /* Called by the Mongoose thread.  Returns a snapshot of all stats
+         objects, ordered by broker ID and then connection index. */
+      std::vector<TInfo> GetInfo() const;
+
+      private:
+      using TKey = std::pair<int32_t, size_t>;
+
+      /* Protects 'StatsMap' from concurrent access by the router thread and
+         the Mongoose thread.  The contents of the stats objects are atomic or
+         have their own mutex, and are not protected by this mutex. */
+      mutable std::mutex Mutex;
+
+      std::map<TKey, std::unique_ptr<TConnectionStats>> StatsMap;
+    };  // TConnectionStatsTracker
+
+  }  // MsgDispatch
+
+}  // Dory
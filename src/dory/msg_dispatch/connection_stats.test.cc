@@ -0,0 +1,187 @@
+/* <dory/msg_dispatch/connection_stats.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/msg_dispatch/connection_stats.h>
+ */
+
+#include <dory/msg_dispatch/connection_stats.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace Dory;
+using namespace Dory::MsgDispatch;
+
+namespace {
+
+  /* The fixture for testing class TConnectionStats. */
+  class TConnectionStatsTest : public ::testing::Test {
+    protected:
+    TConnectionStatsTest() {
+    }
+
+    virtual ~TConnectionStatsTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TConnectionStatsTest
+
+  TEST_F(TConnectionStatsTest, ReconnectTest) {
+    TConnectionStats stats;
+
+    /* The first connect isn't a reconnect. */
+    stats.RecordConnect(1000);
+    ASSERT_TRUE(stats.Connected);
+    ASSERT_EQ(stats.ConnectCount, 1U);
+    ASSERT_EQ(stats.ReconnectCount, 0U);
+    ASSERT_EQ(stats.ReconnectTime, 0U);
+
+    /* Lose the connection, fail once, then reconnect.  The reconnect time
+       covers the failed attempt. */
+    stats.RecordDisconnect(2000);
+    ASSERT_FALSE(stats.Connected);
+    ASSERT_EQ(stats.DisconnectTime, 2000U);
+    ++stats.ConnectFailCount;
+    stats.RecordConnect(2500);
+    ASSERT_TRUE(stats.Connected);
+    ASSERT_EQ(stats.ConnectCount, 2U);
+    ASSERT_EQ(stats.DisconnectTime, 0U);
+    ASSERT_EQ(stats.ReconnectCount, 1U);
+    ASSERT_EQ(stats.ReconnectTime, 500U);
+    ASSERT_EQ(stats.LastReconnectTime, 500U);
+
+    /* A second disconnect while not connected doesn't move the disconnect
+       time. */
+    stats.RecordDisconnect(3000);
+    stats.RecordDisconnect(3100);
+    ASSERT_EQ(stats.DisconnectTime, 3000U);
+    stats.RecordConnect(3200);
+    ASSERT_EQ(stats.ReconnectCount, 2U);
+    ASSERT_EQ(stats.ReconnectTime, 700U);
+    ASSERT_EQ(stats.LastReconnectTime, 200U);
+
+    /* The clock going backwards counts as no time. */
+    stats.RecordDisconnect(4000);
+    stats.RecordConnect(3900);
+    ASSERT_EQ(stats.ReconnectCount, 3U);
+    ASSERT_EQ(stats.ReconnectTime, 700U);
+    ASSERT_EQ(stats.LastReconnectTime, 0U);
+  }
+
+  TEST_F(TConnectionStatsTest, SendStallTest) {
+    TConnectionStats stats;
+    stats.RecordConnect(1000);
+    ASSERT_FALSE(stats.InSendStall());
+
+    /* Ending a stall that hasn't started does nothing. */
+    stats.EndSendStall(1100);
+    ASSERT_EQ(stats.SendStallCount, 0U);
+    ASSERT_EQ(stats.SendStallTime, 0U);
+
+    /* Starting a stall already in progress doesn't restart it. */
+    stats.StartSendStall(1200);
+    stats.StartSendStall(1300);
+    ASSERT_TRUE(stats.InSendStall());
+    ASSERT_EQ(stats.SendStallCount, 1U);
+    stats.EndSendStall(1500);
+    ASSERT_FALSE(stats.InSendStall());
+    ASSERT_EQ(stats.SendStallTime, 300U);
+
+    stats.StartSendStall(2000);
+    stats.EndSendStall(2050);
+    ASSERT_EQ(stats.SendStallCount, 2U);
+    ASSERT_EQ(stats.SendStallTime, 350U);
+
+    /* Losing the connection ends a stall in progress. */
+    stats.StartSendStall(3000);
+    stats.RecordDisconnect(3400);
+    ASSERT_FALSE(stats.InSendStall());
+    ASSERT_EQ(stats.SendStallCount, 3U);
+    ASSERT_EQ(stats.SendStallTime, 750U);
+  }
+
+  TEST_F(TConnectionStatsTest, AckRttTest) {
+    TConnectionStats stats;
+    ASSERT_TRUE(stats.GetAckRttHistogram().IsEmpty());
+
+    /* The first sample sets the average directly.  Later samples are
+       weighted by 1/8. */
+    stats.RecordAckRtt(800);
+    ASSERT_EQ(stats.AckLatency, 800U);
+    stats.RecordAckRtt(1600);
+    ASSERT_EQ(stats.AckLatency, 900U);
+
+    for (size_t i = 0; i < 98; ++i) {
+      stats.RecordAckRtt(1000);
+    }
+
+    Util::THistogram h = stats.GetAckRttHistogram();
+    ASSERT_EQ(h.GetCount(), 100U);
+    ASSERT_GE(h.GetMax(), 1600U);
+    ASSERT_GE(h.GetPercentile(50.0), 1000U);
+    ASSERT_LE(h.GetPercentile(50.0), 1000U + (1000U / 8));
+  }
+
+  TEST_F(TConnectionStatsTest, TrackerTest) {
+    TConnectionStatsTracker tracker;
+
+    /* Stats objects are created on demand, and the same object is returned
+       for the same broker and connection. */
+    TConnectionStats &a = tracker.Get(5, 1);
+    TConnectionStats &b = tracker.Get(2, 0);
+    ASSERT_EQ(&tracker.Get(5, 1), &a);
+    a.RecordConnect(100);
+    a.StartSendStall(200);
+    a.EndSendStall(250);
+    a.RecordAckRtt(3000);
+    a.AckWaitBytes = 400;
+    a.SendBufBytes = 60;
+    b.RecordConnect(100);
+    b.RecordDisconnect(150);
+    b.RecordConnect(450);
+
+    std::vector<TConnectionStatsTracker::TInfo> info = tracker.GetInfo();
+    ASSERT_EQ(info.size(), 2U);
+    ASSERT_EQ(info[0].BrokerId, 2);
+    ASSERT_EQ(info[0].ConnectionIndex, 0U);
+    ASSERT_EQ(info[0].ReconnectCount, 1U);
+    ASSERT_EQ(info[0].LastReconnectTime, 300U);
+    ASSERT_TRUE(info[0].AckRtt.IsEmpty());
+    ASSERT_EQ(info[1].BrokerId, 5);
+    ASSERT_EQ(info[1].ConnectionIndex, 1U);
+    ASSERT_TRUE(info[1].Connected);
+    ASSERT_EQ(info[1].SendStallCount, 1U);
+    ASSERT_EQ(info[1].SendStallTime, 50U);
+    ASSERT_EQ(info[1].AckWaitBytes, 400U);
+    ASSERT_EQ(info[1].SendBufBytes, 60U);
+    ASSERT_EQ(info[1].AckLatency, 3000U);
+    ASSERT_EQ(info[1].AckRtt.GetCount(), 1U);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -22,6 +22,7 @@
 
 #include <dory/msg_dispatch/connector.h>
 
+#include <cstdio>
 #include <cstring>
 #include <exception>
 #include <stdexcept>
@@ -38,11 +39,14 @@
 #include <base/gettid.h>
 #include <base/no_default_case.h>
 #include <base/time_util.h>
+#include <dory/kafka_proto/api_key.h>
 #include <dory/kafka_proto/errors.h>
+#include <dory/kafka_proto/produce/version_util.h>
 #include <dory/kafka_proto/request_response.h>
 #include <dory/msg_dispatch/produce_response_processor.h>
 #include <dory/msg_state_tracker.h>
 #include <dory/util/connect_to_host.h>
+#include <dory/util/event_trace.h>
 #include <dory/util/system_error_codes.h>
 #include <dory/util/time_util.h>
 #include <server/counter.h>
@@ -64,6 +68,7 @@ SERVER_COUNTER(AckNotRequired);
 SERVER_COUNTER(BadProduceResponse);
 SERVER_COUNTER(BadProduceResponseSize);
 SERVER_COUNTER(BugProduceRequestEmpty);
+SERVER_COUNTER(ConnectorAdoptMetadataUpdate);
 SERVER_COUNTER(ConnectorCheckInputQueue);
 SERVER_COUNTER(ConnectorCleanupAfterJoin);
 SERVER_COUNTER(ConnectorConnectFail);
@@ -71,6 +76,8 @@ SERVER_COUNTER(ConnectorConnectSuccess);
 SERVER_COUNTER(ConnectorDoSocketRead);
 SERVER_COUNTER(ConnectorFinishRun);
 SERVER_COUNTER(ConnectorFinishWaitShutdownAck);
+SERVER_COUNTER(ConnectorNoCommonProduceApiVersion);
+SERVER_COUNTER(ConnectorReconnectForOldBroker);
 SERVER_COUNTER(ConnectorSocketBrokerClose);
 SERVER_COUNTER(ConnectorSocketError);
 SERVER_COUNTER(ConnectorSocketReadSuccess);
@@ -78,23 +85,37 @@ SERVER_COUNTER(ConnectorSocketTimeout);
 SERVER_COUNTER(ConnectorStartConnect);
 SERVER_COUNTER(ConnectorStartFastShutdown);
 SERVER_COUNTER(ConnectorStartRun);
+SERVER_COUNTER(ConnectorStartScopedPause);
 SERVER_COUNTER(ConnectorStartSlowShutdown);
 SERVER_COUNTER(ConnectorStartWaitShutdownAck);
 SERVER_COUNTER(ConnectorTruncateLongTimeout);
 SERVER_COUNTER(SendProduceRequestOk);
 
-TConnector::TConnector(size_t my_broker_index, TDispatcherSharedState &ds)
+TConnector::TConnector(size_t my_broker_index, size_t my_connection_index,
+    TDispatcherSharedState &ds)
     : MyBrokerIndex(my_broker_index),
+      BrokerId(-1),
+      MyConnectionIndex(my_connection_index),
+      Stats(nullptr),
       Ds(ds),
       DebugLoggerSend(ds.DebugSetup, TDebugSetup::TLogId::MSG_SEND),
       DebugLoggerReceive(ds.DebugSetup, TDebugSetup::TLogId::MSG_GOT_ACK),
+      PendingBrokerIndex(my_broker_index),
+      MetadataUpdatePending(false),
       InputQueue(ds.BatchConfig, ds.MsgStateTracker),
       /* TODO: rethink DebugLogger stuff */
       RequestFactory(ds.Config, ds.BatchConfig, ds.CompressionConf,
                      ds.ProduceProtocol, my_broker_index),
       PauseInProgress(false),
+      ScopedPause(false),
+      ScopedPauseFinished(false),
       Destroying(false),
+      CurrentRequestSize(0),
+      CurrentRequestUncompressedSize(0),
       ResponseReader(ds.ProduceProtocol->CreateProduceResponseReader()),
+      ProduceApiVersion(ds.Config.ProduceApiVersion.IsKnown() ?
+          *ds.Config.ProduceApiVersion : 0),
+      DeliveryEstimate(0),
       OkShutdown(true) {
 }
 
@@ -110,7 +131,27 @@ void TConnector::SetMetadata(const std::shared_ptr<TMetadata> &md) {
   assert(this);
   assert(md);
   Metadata = md;
+  BrokerId = MyBroker().GetId();
+  InputQueue.SetBrokerId(BrokerId);
   RequestFactory.Init(Ds.CompressionConf, md);
+  Stats = &Ds.ConnectionStats.Get(static_cast<int32_t>(MyBrokerId()),
+      MyConnectionIndex);
+  Stats->AckWaitQueueSize = 0;
+  Stats->AckWaitBytes = 0;
+  Stats->SendBufBytes = 0;
+}
+
+void TConnector::UpdateMetadata(const std::shared_ptr<TMetadata> &md,
+    size_t broker_index) {
+  assert(this);
+  assert(md);
+  assert(broker_index < md->NumInServiceBrokers());
+  assert(md->GetBrokers()[broker_index].GetId() == BrokerId);
+
+  std::lock_guard<std::mutex> lock(PendingMetadataMutex);
+  PendingMetadata = md;
+  PendingBrokerIndex = broker_index;
+  MetadataUpdatePending.store(true);
 }
 
 void TConnector::StartSlowShutdown(uint64_t start_time) {
@@ -175,6 +216,12 @@ void TConnector::CleanupAfterJoin() {
   ConnectorCleanupAfterJoin.Increment();
   Metadata.reset();
 
+  {
+    std::lock_guard<std::mutex> lock(PendingMetadataMutex);
+    PendingMetadata.reset();
+    MetadataUpdatePending.store(false);
+  }
+
   /* The order of the remaining steps matters because we want to avoid getting
      messages unnecessarily out of order. */
 
@@ -216,6 +263,8 @@ void TConnector::Run() {
       ~t_socket_closer() noexcept {
         /* Close TCP connection to broker if open. */
         Connector.Sock.Reset();
+
+        Connector.Stats->RecordDisconnect(GetMonotonicRawMicroseconds());
       }
 
       private:
@@ -224,9 +273,14 @@ void TConnector::Run() {
 
     assert(MyBrokerIndex < Metadata->GetBrokers().size());
     broker_id = MyBrokerId();
-    syslog(LOG_NOTICE, "Connector thread %d (index %lu broker %ld) started",
-        static_cast<int>(Gettid()), static_cast<unsigned long>(MyBrokerIndex),
-        broker_id);
+    char thread_name[TTraceRing::NAME_SIZE];
+    std::snprintf(thread_name, sizeof(thread_name), "connector %ld.%lu",
+        broker_id, static_cast<unsigned long>(MyConnectionIndex));
+    TEventTrace::SetThreadName(thread_name);
+    syslog(LOG_NOTICE, "Connector thread %d (index %lu connection %lu broker "
+        "%ld) started", static_cast<int>(Gettid()),
+        static_cast<unsigned long>(MyBrokerIndex),
+        static_cast<unsigned long>(MyConnectionIndex), broker_id);
     DoRun();
   } catch (const TShutdownOnDestroy &) {
     /* Nothing to do here. */
@@ -242,10 +296,21 @@ void TConnector::Run() {
     _exit(EXIT_FAILURE);
   }
 
-  syslog(LOG_NOTICE, "Connector thread %d (index %lu broker %ld) finished %s",
-      static_cast<int>(Gettid()), static_cast<unsigned long>(MyBrokerIndex),
-      broker_id, OkShutdown ? "normally" : "on error");
-  Ds.MarkThreadFinished();
+  syslog(LOG_NOTICE, "Connector thread %d (index %lu connection %lu broker "
+      "%ld) finished %s", static_cast<int>(Gettid()),
+      static_cast<unsigned long>(MyBrokerIndex),
+      static_cast<unsigned long>(MyConnectionIndex), broker_id,
+      OkShutdown ? "normally" : "on error");
+
+  if (ScopedPause) {
+    /* The router thread will call Ds.MarkThreadFinished() for us once it has
+       joined this thread. */
+    ScopedPauseFinished.store(true);
+    Ds.MarkConnectorFailed();
+  } else {
+    Ds.MarkThreadFinished();
+  }
+
   ConnectorFinishRun.Increment();
 }
 
@@ -256,9 +321,10 @@ bool TConnector::DoConnect() {
   const std::string &host = broker.GetHostname();
   uint16_t port = broker.GetPort();
   long broker_id = broker.GetId();
-  syslog(LOG_NOTICE, "Connector thread %d (index %lu broker %ld) connecting "
-      "to host %s port %u", static_cast<int>(Gettid()),
-      static_cast<unsigned long>(MyBrokerIndex), broker_id, host.c_str(),
+  syslog(LOG_NOTICE, "Connector thread %d (index %lu connection %lu broker "
+      "%ld) connecting to host %s port %u", static_cast<int>(Gettid()),
+      static_cast<unsigned long>(MyBrokerIndex),
+      static_cast<unsigned long>(MyConnectionIndex), broker_id, host.c_str(),
       static_cast<unsigned>(port));
 
   try {
@@ -287,16 +353,90 @@ bool TConnector::DoConnect() {
   return true;
 }
 
+bool TConnector::ChooseProduceProtocol() {
+  assert(this);
+  assert(Sock.IsOpen());
+
+  if (Ds.Config.ProduceApiVersion.IsKnown()) {
+    return true;
+  }
+
+  /* Version 0 is supported by all brokers, and is what the dispatcher's
+     default protocol implements when no version is specified. */
+  size_t version = 0;
+
+  switch (ApiVersionsFetcher.Fetch(Sock,
+      static_cast<int>(Ds.Config.KafkaSocketTimeout * 1000))) {
+    case TApiVersionsFetcher::TResult::Ok: {
+      TOpt<size_t> opt_version = ApiVersionsFetcher.ChooseVersion(
+          TApiKey::Produce, GetSupportedProduceApiVersions());
+
+      if (opt_version.IsKnown()) {
+        version = *opt_version;
+      } else {
+        ConnectorNoCommonProduceApiVersion.Increment();
+        syslog(LOG_WARNING, "Connector thread %d (index %lu broker %ld) "
+            "found no produce API version supported by both Dory and broker: "
+            "trying version 0", static_cast<int>(Gettid()),
+            static_cast<unsigned long>(MyBrokerIndex), MyBrokerId());
+      }
+
+      break;
+    }
+    case TApiVersionsFetcher::TResult::NotSupported: {
+      /* The broker predates ApiVersions requests and may have closed the
+         connection on us. */
+      ConnectorReconnectForOldBroker.Increment();
+      Sock.Reset();
+
+      if (!DoConnect()) {
+        return false;
+      }
+
+      break;
+    }
+    case TApiVersionsFetcher::TResult::Error: {
+      syslog(LOG_ERR, "Starting pause on failure to get API versions from "
+          "broker %ld", MyBrokerId());
+      return false;
+    }
+    NO_DEFAULT_CASE;
+  }
+
+  if (version != ProduceApiVersion) {
+    std::shared_ptr<TProduceProtocol> protocol;
+
+    if (version == 0) {
+      protocol = Ds.ProduceProtocol;
+    } else {
+      protocol.reset(ChooseProduceProto(version));
+      assert(protocol);
+    }
+
+    RequestFactory.SetProduceProtocol(protocol);
+    ResponseReader.reset(protocol->CreateProduceResponseReader());
+    ProduceApiVersion = version;
+    syslog(LOG_NOTICE, "Connector thread %d (index %lu broker %ld) using "
+        "produce API version %lu", static_cast<int>(Gettid()),
+        static_cast<unsigned long>(MyBrokerIndex), MyBrokerId(),
+        static_cast<unsigned long>(version));
+  }
+
+  return true;
+}
+
 bool TConnector::ConnectToBroker() {
   assert(this);
   ConnectorStartConnect.Increment();
-  bool success = DoConnect();
+  bool success = DoConnect() && ChooseProduceProtocol();
 
   if (success) {
     ConnectorConnectSuccess.Increment();
+    Stats->RecordConnect(GetMonotonicRawMicroseconds());
   } else {
     ConnectorConnectFail.Increment();
-    Ds.PauseButton.Push();
+    ++Stats->ConnectFailCount;
+    StartPause();
   }
 
   return success;
@@ -372,6 +512,48 @@ void TConnector::HandleShutdownRequest() {
   ClearShutdownRequest();
 }
 
+void TConnector::StartPause() {
+  assert(this);
+  TEventTrace::Record(TTraceEvent::PauseRequested,
+      static_cast<uint64_t>(MyBrokerId()));
+
+  if (Ds.Config.GlobalPause) {
+    Ds.PauseButton.Push();
+  } else if (!ScopedPause) {
+    syslog(LOG_NOTICE, "Connector thread %d (index %lu connection %lu broker "
+        "%ld) starting scoped pause", static_cast<int>(Gettid()),
+        static_cast<unsigned long>(MyBrokerIndex),
+        static_cast<unsigned long>(MyConnectionIndex), MyBrokerId());
+    ConnectorStartScopedPause.Increment();
+    ScopedPause = true;
+  }
+}
+
+void TConnector::AdoptPendingMetadata() {
+  assert(this);
+
+  if (!MetadataUpdatePending.load()) {
+    return;
+  }
+
+  size_t old_index = MyBrokerIndex;
+
+  {
+    std::lock_guard<std::mutex> lock(PendingMetadataMutex);
+    Metadata = std::move(PendingMetadata);
+    MyBrokerIndex = PendingBrokerIndex;
+    MetadataUpdatePending.store(false);
+  }
+
+  assert(Metadata);
+  RequestFactory.UpdateMetadata(Metadata, MyBrokerIndex);
+  ConnectorAdoptMetadataUpdate.Increment();
+  syslog(LOG_INFO, "Connector thread %d (index %lu broker %ld) adopted "
+      "updated metadata (previous index %lu)", static_cast<int>(Gettid()),
+      static_cast<unsigned long>(MyBrokerIndex), MyBrokerId(),
+      static_cast<unsigned long>(old_index));
+}
+
 void TConnector::SetPauseInProgress() {
   assert(this);
   PauseInProgress = true;
@@ -407,8 +589,17 @@ bool TConnector::TrySendProduceRequest() {
   assert(this);
 
   try {
-    SendBuf.MarkDataConsumed(IfLt0(
-        send(Sock, SendBuf.Data(), SendBuf.DataSize(), MSG_NOSIGNAL)));
+    size_t sent = IfLt0(
+        send(Sock, SendBuf.Data(), SendBuf.DataSize(), MSG_NOSIGNAL));
+    SendBuf.MarkDataConsumed(sent);
+    Stats->BytesSent += sent;
+    Stats->SendBufBytes = SendBuf.DataSize();
+
+    if (!SendBuf.DataIsEmpty() && !Stats->InSendStall()) {
+      /* The socket's send buffer is full.  We must wait for it to become
+         writable before sending the rest of the request. */
+      Stats->StartSendStall(GetMonotonicRawMicroseconds());
+    }
   } catch (const std::system_error &x) {
     if (LostTcpConnection(x)) {
       syslog(LOG_ERR, "Connector thread %d (index %lu broker %ld) starting "
@@ -416,7 +607,7 @@ bool TConnector::TrySendProduceRequest() {
           static_cast<int>(Gettid()),
           static_cast<unsigned long>(MyBrokerIndex), MyBrokerId(), x.what());
       ConnectorSocketError.Increment();
-      Ds.PauseButton.Push();
+      StartPause();
       return false;
     }
 
@@ -433,9 +624,16 @@ bool TConnector::HandleSockWriteReady() {
   assert(this);
   assert(CurrentRequest.IsKnown() == SendInProgress());
 
+  if (Stats->InSendStall()) {
+    Stats->EndSendStall(GetMonotonicRawMicroseconds());
+  }
+
   /* See whether we are starting a new produce request, or continuing a
      partially sent one. */
   if (!SendInProgress()) {
+    /* Messages routed using new metadata may be in 'RequestFactory', so adopt
+       the metadata before building the request. */
+    AdoptPendingMetadata();
     std::vector<uint8_t> buf(SendBuf.TakeStorage());
     CurrentRequest = RequestFactory.BuildRequest(buf);
 
@@ -448,6 +646,15 @@ bool TConnector::HandleSockWriteReady() {
 
     SendBuf = std::move(buf);
     assert(!SendBuf.DataIsEmpty());
+    CurrentRequestSize = SendBuf.DataSize();
+    CurrentRequestUncompressedSize =
+        RequestFactory.GetLastRequestUncompressedSize();
+    Ds.MsgStateTracker.GetBatchStats().RecordProduceRequest(MyBrokerId(),
+        RequestFactory.GetLastRequestDataSize(),
+        RequestFactory.GetProduceRequestDataLimit(),
+        RequestFactory.LastRequestReachedDataLimit());
+    TEventTrace::Record(TTraceEvent::RequestBuilt, CurrentRequestSize);
+    TEventTrace::Record(TTraceEvent::SendStart, CurrentRequestSize);
   }
 
   if (!TrySendProduceRequest()) {
@@ -462,7 +669,17 @@ bool TConnector::HandleSockWriteReady() {
     /* We finished sending the request.  Now expect a response from Kafka,
        unless RequiredAcks is 0. */
 
+    TEventTrace::Record(TTraceEvent::SendEnd, CurrentRequestSize);
     SendProduceRequestOk.Increment();
+    ++Stats->RequestsSent;
+    Stats->RequestBytes += CurrentRequestSize;
+    Stats->UncompressedRequestBytes += CurrentRequestUncompressedSize;
+
+    if (CurrentRequestSize > Stats->MaxRequestBytes) {
+      Stats->MaxRequestBytes = CurrentRequestSize;
+    }
+
+    Ds.RecordRequestSent();
     TAllTopics &all_topics = CurrentRequest->second;
     bool ack_expected = (Ds.Config.RequiredAcks != 0);
 
@@ -471,18 +688,25 @@ bool TConnector::HandleSockWriteReady() {
 
       for (auto &msg_set_elem : group) {
         if (ack_expected) {
-          Ds.MsgStateTracker.MsgEnterAckWait(msg_set_elem.second.Contents);
+          Ds.MsgStateTracker.MsgEnterAckWait(msg_set_elem.second.Contents,
+              MyBrokerId());
         } else {
           AckNotRequired.Increment();
-          Ds.MsgStateTracker.MsgEnterProcessed(msg_set_elem.second.Contents);
+          Ds.MsgStateTracker.MsgEnterProcessedNoAck(
+              msg_set_elem.second.Contents);
         }
 
         DebugLoggerSend.LogMsgList(msg_set_elem.second.Contents);
+        Stats->MsgsSent += msg_set_elem.second.Contents.size();
       }
     }
 
     if (ack_expected) {
       AckWaitQueue.emplace_back(std::move(*CurrentRequest));
+      AckWaitInfo.emplace_back(GetMonotonicRawMicroseconds(),
+          CurrentRequestSize);
+      Stats->AckWaitQueueSize = AckWaitQueue.size();
+      Stats->AckWaitBytes += CurrentRequestSize;
     }
 
     CurrentRequest.Reset();
@@ -507,7 +731,7 @@ bool TConnector::DoSockRead(size_t min_size) {
           static_cast<int>(Gettid()),
           static_cast<unsigned long>(MyBrokerIndex), MyBrokerId(), x.what());
       ConnectorSocketError.Increment();
-      Ds.PauseButton.Push();
+      StartPause();
       return false;
     }
 
@@ -520,13 +744,14 @@ bool TConnector::DoSockRead(size_t min_size) {
         "attempted read", static_cast<int>(Gettid()),
         static_cast<unsigned long>(MyBrokerIndex), MyBrokerId());
     ConnectorSocketBrokerClose.Increment();
-    Ds.PauseButton.Push();
+    StartPause();
     return false;
   }
 
   /* Read was successful, although the amount of data obtained may be less than
      what the caller hoped for. */
   ReceiveBuf.MarkSpaceConsumed(result);
+  Stats->BytesReceived += static_cast<uint64_t>(result);
   ConnectorSocketReadSuccess.Increment();
   return true;
 }
@@ -565,14 +790,38 @@ bool TConnector::TryReadProduceResponses() {
   return true;
 }
 
+void TConnector::RecordAckLatency(uint64_t send_time) {
+  assert(this);
+  uint64_t now = GetMonotonicRawMicroseconds();
+  uint64_t latency = (now > send_time) ? (now - send_time) : 0;
+  Stats->RecordAckRtt(latency);
+
+  /* Batchers with a latency budget need this.  Only update it when the
+     value in milliseconds changes, to avoid contending for the queue's
+     mutex on every response. */
+  size_t estimate = static_cast<size_t>((Stats->AckLatency + 999) / 1000);
+
+  if (estimate != DeliveryEstimate) {
+    DeliveryEstimate = estimate;
+    InputQueue.SetDeliveryEstimate(estimate);
+  }
+}
+
 bool TConnector::ProcessSingleProduceResponse(size_t response_size) {
   assert(this);
   assert(!AckWaitQueue.empty());
   assert(ReceiveBuf.DataSize() >= response_size);
   bool keep_running = true;
   bool pause = false;
+  TEventTrace::Record(TTraceEvent::ResponseProcessed, response_size);
   TProduceRequest request(std::move(AckWaitQueue.front()));
   AckWaitQueue.pop_front();
+  assert(!AckWaitInfo.empty());
+  RecordAckLatency(AckWaitInfo.front().first);
+  Stats->AckWaitBytes -= AckWaitInfo.front().second;
+  AckWaitInfo.pop_front();
+  Stats->AckWaitQueueSize = AckWaitQueue.size();
+  ++Stats->ResponsesReceived;
   TProduceResponseProcessor processor(*ResponseReader, Ds, DebugLoggerReceive,
       MyBrokerIndex, MyBrokerId());
 
@@ -604,7 +853,7 @@ bool TConnector::ProcessSingleProduceResponse(size_t response_size) {
   }
 
   if (pause) {
-    Ds.PauseButton.Push();
+    StartPause();
 
     /* Handle any messages for which we got an error ACK that requires
        rerouting based on new metadata. */
@@ -628,7 +877,7 @@ bool TConnector::TryProcessProduceResponses() {
           "pause due to unexpected response data from broker during response "
           "processing", static_cast<int>(Gettid()),
           static_cast<unsigned long>(MyBrokerIndex), MyBrokerId());
-      Ds.PauseButton.Push();
+      StartPause();
       return false;
     }
 
@@ -697,7 +946,7 @@ bool TConnector::HandleSockReadReady() {
         static_cast<int>(Gettid()), static_cast<unsigned long>(MyBrokerIndex),
         MyBrokerId(), x.what());
     BadProduceResponseSize.Increment();
-    Ds.PauseButton.Push();
+    StartPause();
     return false;
   } catch (const TProduceResponseReaderApi::TBadProduceResponse &x) {
     syslog(LOG_ERR, "Connector thread %d (index %lu broker %ld) starting "
@@ -705,7 +954,7 @@ bool TConnector::HandleSockReadReady() {
         static_cast<int>(Gettid()), static_cast<unsigned long>(MyBrokerIndex),
         MyBrokerId(), x.what());
     BadProduceResponse.Increment();
-    Ds.PauseButton.Push();
+    StartPause();
     return false;
   }
 
@@ -846,7 +1095,7 @@ void TConnector::DoRun() {
             static_cast<int>(Gettid()),
             static_cast<unsigned long>(MyBrokerIndex), broker_id);
         ConnectorSocketTimeout.Increment();
-        Ds.PauseButton.Push();
+        StartPause();
         break;
       }
 
@@ -23,11 +23,13 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -36,6 +38,7 @@
 #include <base/fd.h>
 #include <base/no_copy_semantics.h>
 #include <base/opt.h>
+#include <dory/api_versions_fetcher.h>
 #include <dory/debug/debug_logger.h>
 #include <dory/kafka_proto/produce/produce_response_reader_api.h>
 #include <dory/metadata.h>
@@ -54,18 +57,31 @@ namespace Dory {
 
     /* This class handles a TCP connection between Dory and a single Kafka
        broker.  It uses a single thread for building and sending produce
-       requests, as well as receiving and processing produce responses.  */
+       requests, as well as receiving and processing produce responses.  There
+       may be multiple TConnector objects per broker (see
+       --connections_per_broker), each with its own connection.  */
     class TConnector final : public Thread::TFdManagedThread {
       NO_COPY_SEMANTICS(TConnector);
 
       public:
-      TConnector(size_t my_broker_index, TDispatcherSharedState &ds);
+      TConnector(size_t my_broker_index, size_t my_connection_index,
+          TDispatcherSharedState &ds);
 
       virtual ~TConnector() noexcept;
 
       /* This must be called before starting the thread. */
       void SetMetadata(const std::shared_ptr<TMetadata> &md);
 
+      /* Called by the router thread while the connector thread is running, to
+         hand off new metadata in which this connector's broker has index
+         'broker_index'.  The broker must be unaffected by the change (see
+         TMetadata::MapUnchangedBrokers()).  The connector thread adopts the
+         new metadata before building its next produce request, so it is safe
+         to dispatch messages routed using the new metadata immediately after
+         calling this. */
+      void UpdateMetadata(const std::shared_ptr<TMetadata> &md,
+          size_t broker_index);
+
       void Dispatch(TMsg::TPtr &&msg) {
         assert(this);
         InputQueue.Put(Base::GetEpochMilliseconds(), std::move(msg));
@@ -84,6 +100,43 @@ namespace Dory {
         assert(batch.empty());
       }
 
+      /* See TBrokerMsgQueue::Flush(). */
+      void Flush(const std::string &topic) {
+        assert(this);
+        InputQueue.Flush(topic);
+      }
+
+      /* Return the number of produce requests completely sent on this
+         connector's connection (by this and all previous connectors for the
+         same broker and connection index).  Called by the router thread. */
+      uint64_t GetRequestsSent() const {
+        assert(this);
+        assert(Stats);
+        return Stats->RequestsSent.load(std::memory_order_relaxed);
+      }
+
+      /* Return the total size in bytes of messages waiting in our input
+         queue. */
+      size_t GetQueuedBytes() const {
+        assert(this);
+        return InputQueue.GetDataSize();
+      }
+
+      /* Return the total size in bytes of sent produce requests waiting for
+         ACKs. */
+      uint64_t GetAckWaitBytes() const {
+        assert(this);
+        assert(Stats);
+        return Stats->AckWaitBytes.load(std::memory_order_relaxed);
+      }
+
+      /* Return a moving average of ACK latency in microseconds. */
+      uint64_t GetAckLatency() const {
+        assert(this);
+        assert(Stats);
+        return Stats->AckLatency.load(std::memory_order_relaxed);
+      }
+
       void StartSlowShutdown(uint64_t start_time);
 
       void StartFastShutdown();
@@ -97,6 +150,15 @@ namespace Dory {
         return OkShutdown;
       }
 
+      /* Returns true if the connector thread shut down on its own due to a
+         scoped pause (see StartPause()).  Once this returns true, the thread
+         has finished executing, or is about to, so it can be joined without
+         blocking indefinitely. */
+      bool ShutdownWasScopedPause() const {
+        assert(this);
+        return ScopedPauseFinished.load();
+      }
+
       std::list<std::list<TMsg::TPtr>> GetNoAckQueueAfterShutdown() {
         assert(this);
         return std::move(NoAckAfterShutdown);
@@ -116,11 +178,17 @@ namespace Dory {
         return Metadata->GetBrokers()[MyBrokerIndex];
       }
 
+      /* The broker ID never changes, so unlike MyBroker(), this may be called
+         by the router thread. */
       long MyBrokerId() const {
         assert(this);
-        return MyBroker().GetId();
+        return BrokerId;
       }
 
+      /* Called by the connector thread to adopt metadata handed off by
+         UpdateMetadata(), if any. */
+      void AdoptPendingMetadata();
+
       bool SendInProgress() const {
         assert(this);
         return !SendBuf.DataIsEmpty();
@@ -128,12 +196,25 @@ namespace Dory {
 
       bool DoConnect();
 
+      /* If no produce API version was specified in the config, ask the broker
+         which versions it supports and switch to the highest version
+         supported by both Dory and the broker.  This is done on each new
+         connection.  Return true on success or false on failure. */
+      bool ChooseProduceProtocol();
+
       bool ConnectToBroker();
 
       void SetFastShutdownState();
 
       void HandleShutdownRequest();
 
+      /* Called on detecting an error that requires new metadata.  If the
+         --global_pause option was specified, push the pause button, which
+         causes all connector threads to shut down.  Otherwise only this
+         connector shuts down, and the router thread is notified once it has
+         finished (a scoped pause). */
+      void StartPause();
+
       void SetPauseInProgress();
 
       void HandlePauseDetected();
@@ -148,6 +229,11 @@ namespace Dory {
 
       bool TryReadProduceResponses();
 
+      /* Update the ack latency average in 'Stats' for a response to a
+         request whose send completed at time 'send_time', as returned by
+         GetMonotonicRawMicroseconds(). */
+      void RecordAckLatency(uint64_t send_time);
+
       bool ProcessSingleProduceResponse(size_t response_size);
 
       bool TryProcessProduceResponses();
@@ -171,9 +257,23 @@ namespace Dory {
       std::list<std::list<TMsg::TPtr>> NoAckAfterShutdown;
 
       /* The TKafkaDispatcher object maintains a vector of TConnector objects,
-         one for each active broker.  Here we store the vector index of this
-         TConnector. */
-      const size_t MyBrokerIndex;
+         one or more for each active broker.  Here we store the index of the
+         broker this TConnector handles.  This may change when the connector
+         thread adopts new metadata.  It is atomic because the router thread
+         reads it for logging. */
+      std::atomic<size_t> MyBrokerIndex;
+
+      /* Kafka ID of the broker this TConnector handles.  Set by
+         SetMetadata(). */
+      int32_t BrokerId;
+
+      /* Identifies which of the broker's connections this TConnector handles.
+         Ranges from 0 to (connections per broker - 1). */
+      const size_t MyConnectionIndex;
+
+      /* Statistics for this connection, which the web interface reports.
+         These are set when the metadata is set. */
+      TConnectionStats *Stats;
 
       /* Dispatcher state shared by all TConnector objects. */
       TDispatcherSharedState &Ds;
@@ -209,6 +309,19 @@ namespace Dory {
 
       std::shared_ptr<TMetadata> Metadata;
 
+      /* Protects 'PendingMetadata' and 'PendingBrokerIndex', which
+         UpdateMetadata() sets for the connector thread to adopt. */
+      std::mutex PendingMetadataMutex;
+
+      std::shared_ptr<TMetadata> PendingMetadata;
+
+      size_t PendingBrokerIndex;
+
+      /* Set when 'PendingMetadata' is waiting to be adopted.  This lets the
+         connector thread check for new metadata without acquiring the mutex.
+       */
+      std::atomic<bool> MetadataUpdatePending;
+
       /* This becomes known when a batch time limit is set for messages being
          batched inside the 'InputQueue' member for this connector thread (see
          below).  Once the time limit expires, we extract all ready messages
@@ -258,6 +371,15 @@ namespace Dory {
          setting this flag. */
       bool PauseInProgress;
 
+      /* Set by StartPause() when this connector is shutting down due to a
+         scoped pause.  Only accessed by the connector thread. */
+      bool ScopedPause;
+
+      /* Set when the connector thread finishes shutting down due to a scoped
+         pause.  The router thread reads this to find out which connectors it
+         must join and restart. */
+      std::atomic<bool> ScopedPauseFinished;
+
       /* This flag is only set on destructor invocation.  If the connector
          thread is still executing at this point, then a fatal error has
          occurred, so it must shut down immediately. */
@@ -278,11 +400,25 @@ namespace Dory {
          finished sending the request and are waiting for the response. */
       Base::TOpt<TProduceRequest> CurrentRequest;
 
+      /* Size in bytes of 'CurrentRequest' once serialized. */
+      size_t CurrentRequestSize;
+
+      /* Size in bytes 'CurrentRequest' would have had without compression.
+       */
+      size_t CurrentRequestUncompressedSize;
+
       /* This handles the details of reading and processing produce responses.
        */
       std::unique_ptr<KafkaProto::Produce::TProduceResponseReaderApi>
           ResponseReader;
 
+      /* Used for produce API version negotiation. */
+      TApiVersionsFetcher ApiVersionsFetcher;
+
+      /* Produce API version that 'RequestFactory' and 'ResponseReader' are
+         currently set up for. */
+      size_t ProduceApiVersion;
+
       /* We read produce response data from the socket into this buffer.  For
          eficiency, we attempt to do large reads.  Therefore at any given
          instant, the buffer may contain data belonging to multiple produce
@@ -292,6 +428,16 @@ namespace Dory {
       /* FIFO queue of sent produce requests waiting for responses. */
       std::list<TProduceRequest> AckWaitQueue;
 
+      /* For each item in 'AckWaitQueue', the time from
+         GetMonotonicRawMicroseconds() when we finished sending the request,
+         and the request size in bytes.  Used for statistics. */
+      std::list<std::pair<uint64_t, size_t>> AckWaitInfo;
+
+      /* Expected send and ACK time in milliseconds, derived from the ACK
+         latency average and last passed to InputQueue.SetDeliveryEstimate().
+       */
+      size_t DeliveryEstimate;
+
       /* Messages that we got no ACK for, and need to be rerouted after pause
          finishes.  The router thread will reroute these and report them as
          possible duplicates. */
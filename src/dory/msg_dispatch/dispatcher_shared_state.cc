@@ -25,6 +25,7 @@
 
 #include <syslog.h>
 
+#include <base/time_util.h>
 #include <dory/msg_state_tracker.h>
 #include <server/counter.h>
 
@@ -48,6 +49,8 @@ TDispatcherSharedState::TDispatcherSharedState(const TConfig &config,
       AnomalyTracker(anomaly_tracker),
       DebugSetup(debug_setup),
       BatchConfig(batch_config),
+      StartTime(GetMonotonicRawMilliseconds()),
+      FirstRequestSent(false),
       RunningThreadCount(0),
       AckCount(0) {
 }
@@ -90,11 +93,26 @@ void TDispatcherSharedState::Discard(std::list<std::list<TMsg::TPtr>> &&batch,
 }
 
 void TDispatcherSharedState::MarkAllThreadsRunning(
-    size_t in_service_broker_count) {
+    size_t connector_thread_count) {
   assert(this);
   assert(RunningThreadCount.load() == 0);
   assert(!ShutdownFinished.GetFd().IsReadable());
-  std::atomic_store(&RunningThreadCount, in_service_broker_count);
+  std::atomic_store(&RunningThreadCount, connector_thread_count);
+}
+
+void TDispatcherSharedState::MarkThreadsRestarted(
+    size_t connector_thread_count) {
+  assert(this);
+
+  /* A connector thread that shuts down due to a scoped pause doesn't call
+     MarkThreadFinished() itself.  The router thread calls it after joining
+     the thread, and then calls us when restarting the thread.  Therefore the
+     count only drops to 0 here if all connector threads were joined, and
+     'ShutdownFinished' was pushed by the router thread. */
+  if (RunningThreadCount.fetch_add(connector_thread_count) == 0) {
+    assert(ShutdownFinished.GetFd().IsReadable());
+    ShutdownFinished.Reset();
+  }
 }
 
 void TDispatcherSharedState::MarkThreadFinished() {
@@ -117,3 +135,13 @@ void TDispatcherSharedState::ResetThreadFinishedState() {
   assert(ShutdownFinished.GetFd().IsReadable());
   ShutdownFinished.Reset();
 }
+
+void TDispatcherSharedState::RecordFirstRequestSent() {
+  assert(this);
+
+  if (!FirstRequestSent.exchange(true)) {
+    syslog(LOG_NOTICE, "Time to first send: %llu milliseconds since startup",
+           static_cast<unsigned long long>(
+               GetMonotonicRawMilliseconds() - StartTime));
+  }
+}
@@ -24,6 +24,7 @@
 #include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <list>
 #include <memory>
 #include <string>
@@ -38,6 +39,7 @@
 #include <dory/debug/debug_setup.h>
 #include <dory/kafka_proto/produce/produce_protocol.h>
 #include <dory/msg.h>
+#include <dory/msg_dispatch/connection_stats.h>
 #include <dory/msg_state_tracker.h>
 #include <dory/util/pause_button.h>
 
@@ -64,6 +66,10 @@ namespace Dory {
 
       const Batch::TGlobalBatchConfig BatchConfig;
 
+      /* Statistics for each connection to a broker, reported by the web
+         interface. */
+      TConnectionStatsTracker ConnectionStats;
+
       TDispatcherSharedState(const TConfig &config,
           const Conf::TCompressionConf &compression_conf,
           TMsgStateTracker &msg_state_tracker,
@@ -81,6 +87,16 @@ namespace Dory {
         ++AckCount;
       }
 
+      /* Called by a connector thread each time it finishes sending a produce
+         request.  The first call logs the time elapsed since startup. */
+      void RecordRequestSent() {
+        assert(this);
+
+        if (!FirstRequestSent.load(std::memory_order_relaxed)) {
+          RecordFirstRequestSent();
+        }
+      }
+
       void Discard(TMsg::TPtr &&msg, TAnomalyTracker::TDiscardReason reason);
 
       void Discard(std::list<TMsg::TPtr> &&msg_list,
@@ -99,22 +115,61 @@ namespace Dory {
         return RunningThreadCount.load();
       }
 
-      void MarkAllThreadsRunning(size_t in_service_broker_count);
+      void MarkAllThreadsRunning(size_t connector_thread_count);
 
-      /* Called by connector threads when finished shutting down. */
+      /* Called by the router thread when starting connector threads while
+         the dispatcher is running: either to restart connector threads that
+         shut down on their own due to a scoped pause, or to add connector
+         threads for new brokers on a metadata update. */
+      void MarkThreadsRestarted(size_t connector_thread_count);
+
+      /* Called by connector threads when finished shutting down.  For a
+         connector thread that shut down due to a scoped pause, the router
+         thread calls this on the connector's behalf once it has joined the
+         thread. */
       void MarkThreadFinished();
 
       void HandleAllThreadsFinished();
 
       void ResetThreadFinishedState();
 
+      /* Becomes readable when a connector thread shuts down on its own due to
+         an error that only affects its own connection (a scoped pause). */
+      const Base::TFd &GetConnectorFailureFd() const {
+        assert(this);
+        return ConnectorFailure.GetFd();
+      }
+
+      /* Called by a connector thread when it finishes shutting down due to a
+         scoped pause. */
+      void MarkConnectorFailed() {
+        assert(this);
+        ConnectorFailure.Push();
+      }
+
+      /* Called by the router thread before it looks for connector threads
+         that have shut down due to a scoped pause. */
+      void ResetConnectorFailure() {
+        assert(this);
+        ConnectorFailure.Reset();
+      }
+
       private:
+      void RecordFirstRequestSent();
+
+      /* Monotonic raw time in milliseconds when Dory started. */
+      const uint64_t StartTime;
+
+      std::atomic<bool> FirstRequestSent;
+
       /* This is the total number of connector threads that have been started
          and have not yet called MarkShutdownFinished(); */
       std::atomic<size_t> RunningThreadCount;
 
       Base::TEventSemaphore ShutdownFinished;
 
+      Base::TEventSemaphore ConnectorFailure;
+
       std::atomic<size_t> AckCount;
     };  // TDispatcherSharedState
 
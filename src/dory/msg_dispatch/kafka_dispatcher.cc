@@ -21,8 +21,12 @@
 
 #include <dory/msg_dispatch/kafka_dispatcher.h>
 
+#include <algorithm>
+#include <functional>
+
 #include <syslog.h>
 
+#include <dory/util/event_trace.h>
 #include <dory/util/time_util.h>
 #include <server/counter.h>
 
@@ -38,14 +42,20 @@ using namespace Dory::Util;
 SERVER_COUNTER(BugDispatchBatchOutOfRangeIndex);
 SERVER_COUNTER(BugDispatchMsgOutOfRangeIndex);
 SERVER_COUNTER(BugGetAckWaitQueueOutOfRangeIndex);
+SERVER_COUNTER(DispatchFlush);
 SERVER_COUNTER(DispatchOneBatch);
 SERVER_COUNTER(DispatchOneMsg);
 SERVER_COUNTER(FinishDispatcherJoinAll);
+SERVER_COUNTER(JoinFailedConnector);
+SERVER_COUNTER(KeepConnectorOnMetadataUpdate);
+SERVER_COUNTER(RestartFailedConnector);
 SERVER_COUNTER(SkipOutOfServiceBroker);
+SERVER_COUNTER(StartConnectorOnMetadataUpdate);
 SERVER_COUNTER(StartDispatcherFastShutdown);
 SERVER_COUNTER(StartDispatcherJoinAll);
 SERVER_COUNTER(StartDispatcherSlowShutdown);
 SERVER_COUNTER(StartKafkaDispatcher);
+SERVER_COUNTER(StopConnectorOnMetadataUpdate);
 
 TKafkaDispatcher::TKafkaDispatcher(const TConfig &config,
     const TCompressionConf &compression_conf,
@@ -53,7 +63,10 @@ TKafkaDispatcher::TKafkaDispatcher(const TConfig &config,
     const TGlobalBatchConfig &batch_config, const TDebugSetup &debug_setup)
     : Ds(config, compression_conf, msg_state_tracker, anomaly_tracker,
       debug_setup, batch_config), State(TState::Stopped),
-      OkShutdown(true) {
+      OkShutdown(true), BrokerCount(0),
+      ConnectionsPerBroker(std::max<size_t>(config.ConnectionsPerBroker, 1)),
+      TmpConnectionBatches(ConnectionsPerBroker),
+      TmpConnectionMsgs(ConnectionsPerBroker) {
 }
 
 void TKafkaDispatcher::SetProduceProtocol(
@@ -69,7 +82,7 @@ TKafkaDispatcherApi::TState TKafkaDispatcher::GetState() const {
 
 size_t TKafkaDispatcher::GetBrokerCount() const {
   assert(this);
-  return Connectors.size();
+  return BrokerCount;
 }
 
 void TKafkaDispatcher::Start(const std::shared_ptr<TMetadata> &md) {
@@ -99,22 +112,32 @@ void TKafkaDispatcher::Start(const std::shared_ptr<TMetadata> &md) {
      and less susceptible to bugs being introduced. */
 
   Connectors.clear();
-  Connectors.resize(num_in_service);
-  Ds.MarkAllThreadsRunning(num_in_service);
+  FailedConnectors.clear();
+  Ds.ResetConnectorFailure();
+  Metadata = md;
+  Connectors.resize(num_in_service * ConnectionsPerBroker);
+  BrokerCount = num_in_service;
+  AnyPartitionConnectionCounters.assign(num_in_service, 0);
+  StickyConnections.clear();
+  StickyConnections.resize(num_in_service);
+  Ds.MarkAllThreadsRunning(Connectors.size());
 
   for (size_t i = 0; i < Connectors.size(); ++i) {
-    assert(brokers[i].IsInService());
+    size_t broker_index = i / ConnectionsPerBroker;
+    size_t conn_index = i % ConnectionsPerBroker;
+    assert(brokers[broker_index].IsInService());
     std::unique_ptr<TConnector> &broker_ptr = Connectors[i];
     assert(!broker_ptr);
-    broker_ptr.reset(new TConnector(i, Ds));
-    syslog(LOG_NOTICE, "Starting connector thread for broker index %lu (Kafka "
-           "ID %lu)", static_cast<unsigned long>(i),
-           static_cast<unsigned long>(brokers[i].GetId()));
+    broker_ptr.reset(new TConnector(broker_index, conn_index, Ds));
+    syslog(LOG_NOTICE, "Starting connector thread %lu for broker index %lu "
+           "(Kafka ID %lu)", static_cast<unsigned long>(conn_index),
+           static_cast<unsigned long>(broker_index),
+           static_cast<unsigned long>(brokers[broker_index].GetId()));
     broker_ptr->SetMetadata(md);
     broker_ptr->Start();
   }
 
-  for (size_t i = Connectors.size(); i < brokers.size(); ++i) {
+  for (size_t i = num_in_service; i < brokers.size(); ++i) {
     assert(!brokers[i].IsInService());
     syslog(LOG_NOTICE,
            "Skipping out of service broker index %lu (Kafka ID %lu)",
@@ -132,7 +155,7 @@ void TKafkaDispatcher::Dispatch(TMsg::TPtr &&msg, size_t broker_index) {
   assert(State != TState::Stopped);
   DispatchOneMsg.Increment();
 
-  if (broker_index >= Connectors.size()) {
+  if (broker_index >= BrokerCount) {
     assert(false);
     static TLogRateLimiter lim(std::chrono::seconds(30));
 
@@ -140,7 +163,7 @@ void TKafkaDispatcher::Dispatch(TMsg::TPtr &&msg, size_t broker_index) {
       syslog(LOG_ERR, "Bug!!! Cannot dispatch message because broker index is "
              "out of range: index %lu broker count %lu",
              static_cast<unsigned long>(broker_index),
-             static_cast<unsigned long>(Connectors.size()));
+             static_cast<unsigned long>(BrokerCount));
     }
 
     BugDispatchMsgOutOfRangeIndex.Increment();
@@ -148,8 +171,9 @@ void TKafkaDispatcher::Dispatch(TMsg::TPtr &&msg, size_t broker_index) {
     return;
   }
 
-  assert(Connectors[broker_index]);
-  Connectors[broker_index]->Dispatch(std::move(msg));
+  size_t conn = ChooseConnector(*msg, broker_index);
+  assert(Connectors[conn]);
+  Connectors[conn]->Dispatch(std::move(msg));
   assert(!msg);
 }
 
@@ -159,7 +183,7 @@ void TKafkaDispatcher::DispatchNow(TMsg::TPtr &&msg, size_t broker_index) {
   assert(State != TState::Stopped);
   DispatchOneMsg.Increment();
 
-  if (broker_index >= Connectors.size()) {
+  if (broker_index >= BrokerCount) {
     assert(false);
     static TLogRateLimiter lim(std::chrono::seconds(30));
 
@@ -167,7 +191,7 @@ void TKafkaDispatcher::DispatchNow(TMsg::TPtr &&msg, size_t broker_index) {
       syslog(LOG_ERR, "Bug!!! Cannot dispatch message because broker index is "
              "out of range: index %lu broker count %lu",
              static_cast<unsigned long>(broker_index),
-             static_cast<unsigned long>(Connectors.size()));
+             static_cast<unsigned long>(BrokerCount));
     }
 
     BugDispatchMsgOutOfRangeIndex.Increment();
@@ -175,8 +199,9 @@ void TKafkaDispatcher::DispatchNow(TMsg::TPtr &&msg, size_t broker_index) {
     return;
   }
 
-  assert(Connectors[broker_index]);
-  Connectors[broker_index]->DispatchNow(std::move(msg));
+  size_t conn = ChooseConnector(*msg, broker_index);
+  assert(Connectors[conn]);
+  Connectors[conn]->DispatchNow(std::move(msg));
   assert(!msg);
 }
 
@@ -191,7 +216,7 @@ void TKafkaDispatcher::DispatchNow(std::list<std::list<TMsg::TPtr>> &&batch,
 
   DispatchOneBatch.Increment();
 
-  if (broker_index >= Connectors.size()) {
+  if (broker_index >= BrokerCount) {
     assert(false);
     static TLogRateLimiter lim(std::chrono::seconds(30));
 
@@ -199,7 +224,7 @@ void TKafkaDispatcher::DispatchNow(std::list<std::list<TMsg::TPtr>> &&batch,
       syslog(LOG_ERR, "Bug!!! Cannot dispatch message batch because broker "
              "index is out of range: index %lu broker count %lu",
              static_cast<unsigned long>(broker_index),
-             static_cast<unsigned long>(Connectors.size()));
+             static_cast<unsigned long>(BrokerCount));
     }
 
     BugDispatchBatchOutOfRangeIndex.Increment();
@@ -207,11 +232,29 @@ void TKafkaDispatcher::DispatchNow(std::list<std::list<TMsg::TPtr>> &&batch,
     return;
   }
 
-  assert(Connectors[broker_index]);
-  Connectors[broker_index]->DispatchNow(std::move(batch));
+  TEventTrace::Record(TTraceEvent::BatchHandoff, broker_index);
+
+  if (ConnectionsPerBroker == 1) {
+    assert(Connectors[broker_index]);
+    Connectors[broker_index]->DispatchNow(std::move(batch));
+  } else {
+    DispatchNowToConnections(std::move(batch), broker_index);
+  }
+
   assert(batch.empty());
 }
 
+void TKafkaDispatcher::Flush(const std::string &topic) {
+  assert(this);
+  assert(State != TState::Stopped);
+  DispatchFlush.Increment();
+
+  for (std::unique_ptr<TConnector> &c : Connectors) {
+    assert(c);
+    c->Flush(topic);
+  }
+}
+
 void TKafkaDispatcher::StartSlowShutdown(uint64_t start_time) {
   assert(this);
   assert(State != TState::Stopped);
@@ -222,12 +265,18 @@ void TKafkaDispatcher::StartSlowShutdown(uint64_t start_time) {
   } else {
     for (std::unique_ptr<TConnector> &c : Connectors) {
       assert(c);
-      c->StartSlowShutdown(start_time);
+
+      if (c->IsStarted()) {
+        c->StartSlowShutdown(start_time);
+      }
     }
 
     for (std::unique_ptr<TConnector> &c : Connectors) {
       assert(c);
-      c->WaitForShutdownAck();
+
+      if (c->IsStarted()) {
+        c->WaitForShutdownAck();
+      }
     }
   }
 
@@ -244,12 +293,18 @@ void TKafkaDispatcher::StartFastShutdown() {
   } else {
     for (std::unique_ptr<TConnector> &c : Connectors) {
       assert(c);
-      c->StartFastShutdown();
+
+      if (c->IsStarted()) {
+        c->StartFastShutdown();
+      }
     }
 
     for (std::unique_ptr<TConnector> &c : Connectors) {
       assert(c);
-      c->WaitForShutdownAck();
+
+      if (c->IsStarted()) {
+        c->WaitForShutdownAck();
+      }
     }
   }
 
@@ -275,8 +330,16 @@ void TKafkaDispatcher::JoinAll() {
 
   for (std::unique_ptr<TConnector> &c : Connectors) {
     assert(c);
-    c->Join();
-    c->CleanupAfterJoin();
+
+    if (c->IsStarted()) {
+      c->Join();
+      c->CleanupAfterJoin();
+
+      if (c->ShutdownWasScopedPause()) {
+        /* The connector left this for us to do. */
+        Ds.MarkThreadFinished();
+      }
+    }
 
     if (!c->ShutdownWasOk()) {
       ok_shutdown = false;
@@ -297,44 +360,427 @@ bool TKafkaDispatcher::ShutdownWasOk() const {
   return OkShutdown;
 }
 
+const TFd &TKafkaDispatcher::GetConnectorFailureFd() const {
+  assert(this);
+  return Ds.GetConnectorFailureFd();
+}
+
+size_t TKafkaDispatcher::JoinFailedConnectors() {
+  assert(this);
+  assert(State == TState::Started);
+
+  /* Reset before looking, so a connector that fails after we look will make
+     the FD readable again. */
+  Ds.ResetConnectorFailure();
+  size_t count = 0;
+
+  for (size_t i = 0; i < Connectors.size(); ++i) {
+    std::unique_ptr<TConnector> &c = Connectors[i];
+    assert(c);
+
+    if (c->IsStarted() && c->ShutdownWasScopedPause()) {
+      JoinFailedConnector.Increment();
+      syslog(LOG_NOTICE, "Joining connector thread %lu for broker index %lu "
+             "after scoped pause",
+             static_cast<unsigned long>(i % ConnectionsPerBroker),
+             static_cast<unsigned long>(i / ConnectionsPerBroker));
+      c->Join();
+      c->CleanupAfterJoin();
+      Ds.MarkThreadFinished();
+      FailedConnectors.push_back(i);
+      ++count;
+    }
+  }
+
+  return count;
+}
+
+void TKafkaDispatcher::RestartFailedConnectors() {
+  assert(this);
+  assert(State == TState::Started);
+  assert(Metadata);
+
+  if (FailedConnectors.empty()) {
+    return;
+  }
+
+  /* As in Start(), we don't reuse connectors. */
+  for (size_t i : FailedConnectors) {
+    Connectors[i].reset(new TConnector(i / ConnectionsPerBroker,
+        i % ConnectionsPerBroker, Ds));
+    Connectors[i]->SetMetadata(Metadata);
+  }
+
+  Ds.MarkThreadsRestarted(FailedConnectors.size());
+
+  for (size_t i : FailedConnectors) {
+    RestartFailedConnector.Increment();
+    syslog(LOG_NOTICE, "Restarting connector thread %lu for broker index %lu "
+           "after scoped pause",
+           static_cast<unsigned long>(i % ConnectionsPerBroker),
+           static_cast<unsigned long>(i / ConnectionsPerBroker));
+    Connectors[i]->Start();
+  }
+
+  FailedConnectors.clear();
+}
+
+bool TKafkaDispatcher::UpdateMetadata(const std::shared_ptr<TMetadata> &md,
+    std::list<std::list<TMsg::TPtr>> &no_ack,
+    std::list<std::list<TMsg::TPtr>> &send_wait) {
+  assert(this);
+  assert(md);
+  assert(Metadata);
+
+  if ((State != TState::Started) || !FailedConnectors.empty()) {
+    return false;
+  }
+
+  const std::vector<int> broker_map =
+      TMetadata::MapUnchangedBrokers(*Metadata, *md);
+  assert(broker_map.size() == BrokerCount);
+
+  if (std::none_of(broker_map.begin(), broker_map.end(),
+      [](int index) { return index >= 0; })) {
+    return false;
+  }
+
+  const std::vector<TMetadata::TBroker> &brokers = md->GetBrokers();
+  size_t num_in_service = std::min(md->NumInServiceBrokers(), brokers.size());
+  std::vector<std::unique_ptr<TConnector>> new_connectors(
+      num_in_service * ConnectionsPerBroker);
+  std::vector<std::unique_ptr<TConnector>> stopping;
+
+  for (size_t i = 0; i < broker_map.size(); ++i) {
+    int new_index = broker_map[i];
+
+    for (size_t j = 0; j < ConnectionsPerBroker; ++j) {
+      std::unique_ptr<TConnector> &c =
+          Connectors[(i * ConnectionsPerBroker) + j];
+      assert(c);
+
+      if (new_index < 0) {
+        stopping.push_back(std::move(c));
+      } else {
+        KeepConnectorOnMetadataUpdate.Increment();
+
+        /* A connector that has already shut down due to a scoped pause is
+           moved along with the others.  The router thread will join and
+           restart it as usual, using the new metadata. */
+        c->UpdateMetadata(md, new_index);
+        new_connectors[(new_index * ConnectionsPerBroker) + j] = std::move(c);
+      }
+    }
+  }
+
+  /* Shut down connectors for brokers affected by the change.  As with a full
+     fast shutdown, send all of the requests before waiting for any of the
+     ACKs. */
+  for (std::unique_ptr<TConnector> &c : stopping) {
+    if (c->IsStarted()) {
+      StopConnectorOnMetadataUpdate.Increment();
+      c->StartFastShutdown();
+    }
+  }
+
+  for (std::unique_ptr<TConnector> &c : stopping) {
+    if (c->IsStarted()) {
+      c->WaitForShutdownAck();
+      c->Join();
+      c->CleanupAfterJoin();
+
+      if (c->ShutdownWasScopedPause()) {
+        /* The connector left this for us to do. */
+        Ds.MarkThreadFinished();
+      }
+    }
+
+    if (!c->ShutdownWasOk()) {
+      syslog(LOG_WARNING, "Connector shut down for metadata update "
+             "terminated on error");
+    }
+
+    no_ack.splice(no_ack.end(), c->GetNoAckQueueAfterShutdown());
+    send_wait.splice(send_wait.end(), c->GetSendWaitQueueAfterShutdown());
+  }
+
+  stopping.clear();
+  Metadata = md;
+  std::vector<size_t> to_start;
+
+  /* As in Start(), we don't reuse connectors. */
+  for (size_t i = 0; i < new_connectors.size(); ++i) {
+    std::unique_ptr<TConnector> &c = new_connectors[i];
+
+    if (!c) {
+      assert(brokers[i / ConnectionsPerBroker].IsInService());
+      c.reset(new TConnector(i / ConnectionsPerBroker,
+          i % ConnectionsPerBroker, Ds));
+      c->SetMetadata(md);
+      to_start.push_back(i);
+    }
+  }
+
+  Connectors = std::move(new_connectors);
+  BrokerCount = num_in_service;
+  AnyPartitionConnectionCounters.assign(num_in_service, 0);
+  StickyConnections.clear();
+  StickyConnections.resize(num_in_service);
+
+  if (!to_start.empty()) {
+    Ds.MarkThreadsRestarted(to_start.size());
+  }
+
+  for (size_t i : to_start) {
+    StartConnectorOnMetadataUpdate.Increment();
+    syslog(LOG_NOTICE, "Starting connector thread %lu for broker index %lu "
+           "(Kafka ID %lu) on metadata update",
+           static_cast<unsigned long>(i % ConnectionsPerBroker),
+           static_cast<unsigned long>(i / ConnectionsPerBroker),
+           static_cast<unsigned long>(
+               brokers[i / ConnectionsPerBroker].GetId()));
+    Connectors[i]->Start();
+  }
+
+  return true;
+}
+
 std::list<std::list<TMsg::TPtr>>
 TKafkaDispatcher::GetNoAckQueueAfterShutdown(size_t broker_index) {
   assert(this);
-  assert(State == TState::Stopped);
+  assert((State == TState::Stopped) || !FailedConnectors.empty());
 
-  if (broker_index >= Connectors.size()) {
+  if (broker_index >= BrokerCount) {
     assert(false);
     syslog(LOG_ERR, "Bug!!! Cannot get ACK wait queue for out of range broker "
            "index %lu broker count %lu",
            static_cast<unsigned long>(broker_index),
-           static_cast<unsigned long>(Connectors.size()));
+           static_cast<unsigned long>(BrokerCount));
     BugGetAckWaitQueueOutOfRangeIndex.Increment();
     return std::list<std::list<TMsg::TPtr>>();
   }
 
-  assert(Connectors[broker_index]);
-  return Connectors[broker_index]->GetNoAckQueueAfterShutdown();
+  std::list<std::list<TMsg::TPtr>> result;
+
+  for (size_t i = 0; i < ConnectionsPerBroker; ++i) {
+    std::unique_ptr<TConnector> &c =
+        Connectors[(broker_index * ConnectionsPerBroker) + i];
+    assert(c);
+
+    /* After JoinFailedConnectors(), the dispatcher may still be running.  In
+       that case, only the joined connectors have anything for us. */
+    if (!c->IsStarted()) {
+      result.splice(result.end(), c->GetNoAckQueueAfterShutdown());
+    }
+  }
+
+  return result;
 }
 
 std::list<std::list<TMsg::TPtr>>
 TKafkaDispatcher::GetSendWaitQueueAfterShutdown(size_t broker_index) {
   assert(this);
-  assert(State == TState::Stopped);
+  assert((State == TState::Stopped) || !FailedConnectors.empty());
 
-  if (broker_index >= Connectors.size()) {
+  if (broker_index >= BrokerCount) {
     assert(false);
     syslog(LOG_ERR, "Bug!!! Cannot get send wait queue for out of range "
            "broker index %lu broker count %lu",
            static_cast<unsigned long>(broker_index),
-           static_cast<unsigned long>(Connectors.size()));
+           static_cast<unsigned long>(BrokerCount));
     return std::list<std::list<TMsg::TPtr>>();
   }
 
-  assert(Connectors[broker_index]);
-  return Connectors[broker_index]->GetSendWaitQueueAfterShutdown();
+  std::list<std::list<TMsg::TPtr>> result;
+
+  for (size_t i = 0; i < ConnectionsPerBroker; ++i) {
+    std::unique_ptr<TConnector> &c =
+        Connectors[(broker_index * ConnectionsPerBroker) + i];
+    assert(c);
+
+    /* After JoinFailedConnectors(), the dispatcher may still be running.  In
+       that case, only the joined connectors have anything for us. */
+    if (!c->IsStarted()) {
+      result.splice(result.end(), c->GetSendWaitQueueAfterShutdown());
+    }
+  }
+
+  return result;
+}
+
+uint64_t TKafkaDispatcher::GetRequestsSent(size_t broker_index) const {
+  assert(this);
+
+  if (broker_index >= BrokerCount) {
+    return 0;
+  }
+
+  uint64_t result = 0;
+
+  for (size_t i = 0; i < ConnectionsPerBroker; ++i) {
+    const std::unique_ptr<TConnector> &c =
+        Connectors[(broker_index * ConnectionsPerBroker) + i];
+    assert(c);
+    result += c->GetRequestsSent();
+  }
+
+  return result;
+}
+
+TBrokerLoad TKafkaDispatcher::GetBrokerLoad(size_t broker_index) const {
+  assert(this);
+  TBrokerLoad result;
+
+  if ((broker_index >= BrokerCount) || (ConnectionsPerBroker == 0)) {
+    return result;
+  }
+
+  uint64_t latency_sum = 0;
+  size_t latency_count = 0;
+
+  for (size_t i = 0; i < ConnectionsPerBroker; ++i) {
+    const std::unique_ptr<TConnector> &c =
+        Connectors[(broker_index * ConnectionsPerBroker) + i];
+    assert(c);
+    result.QueuedBytes += c->GetQueuedBytes();
+    result.InFlightBytes += c->GetAckWaitBytes();
+    uint64_t latency = c->GetAckLatency();
+
+    /* Connections that haven't received any ACKs yet don't contribute to the
+       latency average. */
+    if (latency) {
+      latency_sum += latency;
+      ++latency_count;
+    }
+  }
+
+  if (latency_count) {
+    result.AckLatency = latency_sum / latency_count;
+  }
+
+  return result;
 }
 
 size_t TKafkaDispatcher::GetAckCount() const {
   assert(this);
   return Ds.GetAckCount();
 }
+
+size_t TKafkaDispatcher::ChooseConnector(const TMsg &msg,
+    size_t broker_index) {
+  assert(this);
+  size_t conn = (msg.GetRoutingType() == TMsg::TRoutingType::PartitionKey) ?
+      PartitionKeyConnection(msg.GetTopic(), msg.GetPartition()) :
+      AnyPartitionConnection(broker_index, msg.GetTopic());
+  assert(conn < ConnectionsPerBroker);
+  return (broker_index * ConnectionsPerBroker) + conn;
+}
+
+size_t TKafkaDispatcher::PartitionKeyConnection(const std::string &topic,
+    int32_t partition) const {
+  assert(this);
+
+  if (ConnectionsPerBroker == 1) {
+    return 0;
+  }
+
+  /* Combine the topic hash with the partition, and then mix the bits so
+     consecutive partitions don't land on consecutive connections. */
+  uint64_t h = std::hash<std::string>()(topic);
+  h ^= static_cast<uint32_t>(partition) + 0x9e3779b97f4a7c15ULL + (h << 6) +
+      (h >> 2);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return static_cast<size_t>(h % ConnectionsPerBroker);
+}
+
+size_t TKafkaDispatcher::AnyPartitionConnection(size_t broker_index,
+    const std::string &topic) {
+  assert(this);
+  assert(broker_index < AnyPartitionConnectionCounters.size());
+  assert(broker_index < StickyConnections.size());
+
+  if (ConnectionsPerBroker == 1) {
+    return 0;
+  }
+
+  size_t first_conn = broker_index * ConnectionsPerBroker;
+  auto &topic_map = StickyConnections[broker_index];
+  auto iter = topic_map.find(topic);
+
+  if (iter != topic_map.end()) {
+    const TStickyConnection &sticky = iter->second;
+    assert(Connectors[first_conn + sticky.Conn]);
+
+    if (Connectors[first_conn + sticky.Conn]->GetRequestsSent() ==
+        sticky.RequestsSent) {
+      return sticky.Conn;
+    }
+  }
+
+  size_t &counter = AnyPartitionConnectionCounters[broker_index];
+  size_t conn = counter;
+  counter = (counter + 1) % ConnectionsPerBroker;
+  assert(Connectors[first_conn + conn]);
+  TStickyConnection &sticky = topic_map[topic];
+  sticky.Conn = conn;
+  sticky.RequestsSent = Connectors[first_conn + conn]->GetRequestsSent();
+  return conn;
+}
+
+void TKafkaDispatcher::DispatchNowToConnections(
+    std::list<std::list<TMsg::TPtr>> &&batch, size_t broker_index) {
+  assert(this);
+  assert(TmpConnectionBatches.size() == ConnectionsPerBroker);
+  assert(TmpConnectionMsgs.size() == ConnectionsPerBroker);
+  size_t first_conn = broker_index * ConnectionsPerBroker;
+
+  /* Each list in 'batch' contains messages for a single topic.  Split each
+     list by connection, preserving message order. */
+  for (std::list<TMsg::TPtr> &msg_list : batch) {
+    /* Chosen on the first AnyPartition message in the list. */
+    size_t any_partition_conn = ConnectionsPerBroker;
+
+    for (auto iter = msg_list.begin(), next = iter;
+         iter != msg_list.end();
+         iter = next) {
+      ++next;
+      assert(*iter);
+      const TMsg &msg = **iter;
+      size_t conn = 0;
+
+      if (msg.GetRoutingType() == TMsg::TRoutingType::PartitionKey) {
+        conn = PartitionKeyConnection(msg.GetTopic(), msg.GetPartition());
+      } else {
+        if (any_partition_conn == ConnectionsPerBroker) {
+          any_partition_conn = AnyPartitionConnection(broker_index,
+              msg.GetTopic());
+        }
+
+        conn = any_partition_conn;
+      }
+
+      std::list<TMsg::TPtr> &dst = TmpConnectionMsgs[conn];
+      dst.splice(dst.end(), msg_list, iter);
+    }
+
+    for (size_t i = 0; i < ConnectionsPerBroker; ++i) {
+      if (!TmpConnectionMsgs[i].empty()) {
+        TmpConnectionBatches[i].push_back(std::move(TmpConnectionMsgs[i]));
+        TmpConnectionMsgs[i].clear();
+      }
+    }
+  }
+
+  batch.clear();
+
+  for (size_t i = 0; i < ConnectionsPerBroker; ++i) {
+    if (!TmpConnectionBatches[i].empty()) {
+      assert(Connectors[first_conn + i]);
+      Connectors[first_conn + i]->DispatchNow(
+          std::move(TmpConnectionBatches[i]));
+      TmpConnectionBatches[i].clear();
+    }
+  }
+}
@@ -16,8 +16,9 @@
    limitations under the License.
    ----------------------------------------------------------------------------
 
-   Class for dispatching messages to Kafka brokers.  For each broker, there is
-   a TCP connection and a thread for sending requests and receiving responses.
+   Class for dispatching messages to Kafka brokers.  For each broker, there are
+   one or more TCP connections (see --connections_per_broker), each with its
+   own thread for sending requests and receiving responses.
  */
 
 #pragma once
@@ -27,6 +28,7 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -75,6 +77,8 @@ namespace Dory {
 
       virtual void DispatchNow(TMsg::TPtr &&msg, size_t broker_index) override;
 
+      virtual void Flush(const std::string &topic) override;
+
       virtual void DispatchNow(std::list<std::list<TMsg::TPtr>> &&batch,
                                size_t broker_index) override;
 
@@ -90,22 +94,110 @@ namespace Dory {
 
       virtual bool ShutdownWasOk() const override;
 
+      virtual const Base::TFd &GetConnectorFailureFd() const override;
+
+      virtual size_t JoinFailedConnectors() override;
+
+      virtual void RestartFailedConnectors() override;
+
+      virtual bool UpdateMetadata(const std::shared_ptr<TMetadata> &md,
+          std::list<std::list<TMsg::TPtr>> &no_ack,
+          std::list<std::list<TMsg::TPtr>> &send_wait) override;
+
       virtual std::list<std::list<TMsg::TPtr>>
       GetNoAckQueueAfterShutdown(size_t broker_index) override;
 
       virtual std::list<std::list<TMsg::TPtr>>
       GetSendWaitQueueAfterShutdown(size_t broker_index) override;
 
+      virtual uint64_t GetRequestsSent(size_t broker_index) const override;
+
+      virtual TBrokerLoad GetBrokerLoad(size_t broker_index) const override;
+
       virtual size_t GetAckCount() const override;
 
+      /* Returns per-connection statistics for the web interface. */
+      const TConnectionStatsTracker &GetConnectionStats() const {
+        assert(this);
+        return Ds.ConnectionStats;
+      }
+
       private:
+      /* Return the index in 'Connectors' of the connection to use for 'msg',
+         which is going to the broker with index 'broker_index'.  See
+         PartitionKeyConnection() and AnyPartitionConnection(). */
+      size_t ChooseConnector(const TMsg &msg, size_t broker_index);
+
+      /* Return the connection (relative to the broker's first connection) to
+         use for PartitionKey messages with the given topic and partition.  A
+         given partition always maps to the same connection, so per-partition
+         ordering is preserved.  The mapping hashes the topic and partition
+         rather than taking the partition modulo the connection count, since
+         the latter leaves connections idle when the broker count and
+         connection count share a factor. */
+      size_t PartitionKeyConnection(const std::string &topic,
+          int32_t partition) const;
+
+      /* Return the connection (relative to the broker's first connection) to
+         use for AnyPartition messages with topic 'topic' going to the broker
+         with index 'broker_index'.  A topic sticks to one connection until
+         that connection sends a produce request, so messages for the topic
+         accumulate in one batch.  After that, the topic moves to the next
+         connection in round robin order. */
+      size_t AnyPartitionConnection(size_t broker_index,
+          const std::string &topic);
+
+      void DispatchNowToConnections(std::list<std::list<TMsg::TPtr>> &&batch,
+          size_t broker_index);
+
       TDispatcherSharedState Ds;
 
       TState State;
 
       bool OkShutdown;
 
+      /* Metadata passed to Start() or UpdateMetadata().
+         RestartFailedConnectors() uses this. */
+      std::shared_ptr<TMetadata> Metadata;
+
+      /* Indexes in 'Connectors' of connectors that were joined by
+         JoinFailedConnectors() and not yet restarted. */
+      std::vector<size_t> FailedConnectors;
+
+      /* Number of in service brokers, as of the last call to Start() or
+         UpdateMetadata(). */
+      size_t BrokerCount;
+
+      /* Copy of config value, saved for quick access. */
+      const size_t ConnectionsPerBroker;
+
+      /* There are 'ConnectionsPerBroker' connectors for each broker.  The
+         connectors for broker index i occupy positions
+         [i * ConnectionsPerBroker, (i + 1) * ConnectionsPerBroker). */
       std::vector<std::unique_ptr<TConnector>> Connectors;
+
+      /* Connection chosen for a topic by AnyPartitionConnection(), along with
+         that connection's produce request count at the time of the choice. */
+      struct TStickyConnection {
+        size_t Conn;
+
+        uint64_t RequestsSent;
+      };  // TStickyConnection
+
+      /* Indexed by broker index.  Used by AnyPartitionConnection(). */
+      std::vector<size_t> AnyPartitionConnectionCounters;
+
+      /* Indexed by broker index.  Each map is keyed by topic.  Used by
+         AnyPartitionConnection(). */
+      std::vector<std::unordered_map<std::string, TStickyConnection>>
+          StickyConnections;
+
+      /* Scratch space for DispatchNowToConnections(), indexed by connection
+         (relative to a broker's first connection).  Kept here to avoid
+         repeated allocation. */
+      std::vector<std::list<std::list<TMsg::TPtr>>> TmpConnectionBatches;
+
+      std::vector<std::list<TMsg::TPtr>> TmpConnectionMsgs;
     };  // TKafkaDispatcher
 
   }  // MsgDispatch
@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <list>
 #include <memory>
+#include <string>
 
 #include <base/fd.h>
 #include <base/no_copy_semantics.h>
@@ -80,6 +81,11 @@ namespace Dory {
       virtual void DispatchNow(std::list<std::list<TMsg::TPtr>> &&batch,
                                size_t broker_index) = 0;
 
+      /* Tell all connector threads to stop batching messages for 'topic' and
+         send what they have.  An empty topic specifies all topics.  Used
+         when a client requests a flush. */
+      virtual void Flush(const std::string &topic) = 0;
+
       /* Slow shutdown is used when Dory receives a shutdown request.  Tell
          the connector threads to start slow shutdown.  In the case where the
          dispatcher was just restarted due to a pause event and we are
@@ -128,16 +134,61 @@ namespace Dory {
          has been called. */
       virtual bool ShutdownWasOk() const = 0;
 
-      /* After shutdown is finished, get all messages that didn't get an ACK
-         from the given broker. */
+      /* Unless the --global_pause option was specified, an error that
+         requires new metadata causes a scoped pause: only the connector
+         thread that detects the error shuts down, and the other connector
+         threads keep running.  The returned FD becomes readable when a
+         connector thread has shut down due to a scoped pause. */
+      virtual const Base::TFd &GetConnectorFailureFd() const = 0;
+
+      /* Join all connector threads that have shut down due to a scoped pause,
+         and return how many there were.  This can be called while the
+         dispatcher is running.  Afterwards, GetNoAckQueueAfterShutdown() and
+         GetSendWaitQueueAfterShutdown() return the messages left behind by
+         the joined connectors. */
+      virtual size_t JoinFailedConnectors() = 0;
+
+      /* Replace the connectors joined by JoinFailedConnectors() with new ones,
+         using the metadata passed to Start(), and start them running. */
+      virtual void RestartFailedConnectors() = 0;
+
+      /* Apply new metadata 'md' to the running dispatcher without restarting
+         it.  Connectors for brokers unaffected by the change (see
+         TMetadata::MapUnchangedBrokers()) keep their TCP connections and
+         queued messages, and switch to the new metadata.  Connectors for the
+         remaining brokers are shut down, and messages they left behind are
+         appended to 'no_ack' (sent, but not acknowledged) and 'send_wait' (not
+         yet sent) for rerouting.  New connectors are started for brokers that
+         don't already have them.  Return false without doing anything if the
+         change can't be applied this way (for instance, when no broker is
+         unaffected), in which case the caller must restart the dispatcher. */
+      virtual bool UpdateMetadata(const std::shared_ptr<TMetadata> &md,
+          std::list<std::list<TMsg::TPtr>> &no_ack,
+          std::list<std::list<TMsg::TPtr>> &send_wait) = 0;
+
+      /* After shutdown is finished, or after JoinFailedConnectors() has been
+         called, get all messages that didn't get an ACK from the given broker.
+       */
       virtual std::list<std::list<TMsg::TPtr>>
       GetNoAckQueueAfterShutdown(size_t broker_index) = 0;
 
-      /* After shutdown is finished, get all messages waiting to be sent to the
-         given broker. */
+      /* After shutdown is finished, or after JoinFailedConnectors() has been
+         called, get all messages waiting to be sent to the given broker. */
       virtual std::list<std::list<TMsg::TPtr>>
       GetSendWaitQueueAfterShutdown(size_t broker_index) = 0;
 
+      /* Return the total number of produce requests sent to the broker given
+         by 'broker_index' (over all of its connections), which specifies the
+         index of the broker in the broker vector of the metadata.  The router
+         thread watches for a change in this value to learn that messages it
+         routed to the broker have probably been sent. */
+      virtual uint64_t GetRequestsSent(size_t broker_index) const = 0;
+
+      /* Return load information for the broker given by 'broker_index',
+         which specifies the index of the broker in the broker vector of the
+         metadata.  Safe to call while the dispatcher is running. */
+      virtual TBrokerLoad GetBrokerLoad(size_t broker_index) const = 0;
+
       /* For testing. */
       virtual size_t GetAckCount() const = 0;
 
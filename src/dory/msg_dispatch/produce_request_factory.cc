@@ -67,10 +67,29 @@ TProduceRequestFactory::TProduceRequestFactory(const TConfig &config,
       RequestWriter(produce_protocol->CreateProduceRequestWriter()),
       MsgSetWriter(produce_protocol->CreateMsgSetWriter()),
       DefaultTopicConf(compression_conf.GetDefaultTopicConfig()),
-      CorrIdCounter(0) {
+      CorrIdCounter(0),
+      CompressionSavings(0),
+      LastRequestUncompressedSize(0),
+      LastRequestDataSize(0),
+      LastRequestDataLimitReached(false) {
   InitTopicDataMap(compression_conf);
 }
 
+void TProduceRequestFactory::SetProduceProtocol(
+    const std::shared_ptr<TProduceProtocol> &produce_protocol) {
+  assert(this);
+  assert(produce_protocol);
+
+  if (produce_protocol == ProduceProtocol) {
+    return;
+  }
+
+  SingleMsgOverhead = produce_protocol->GetSingleMsgOverhead();
+  RequestWriter.reset(produce_protocol->CreateProduceRequestWriter());
+  MsgSetWriter.reset(produce_protocol->CreateMsgSetWriter());
+  ProduceProtocol = produce_protocol;
+}
+
 void TProduceRequestFactory::Init(
     const TCompressionConf &compression_conf,
     const std::shared_ptr<TMetadata> &md) {
@@ -88,6 +107,14 @@ void TProduceRequestFactory::Reset() {
   TopicDataMap.clear();
 }
 
+void TProduceRequestFactory::UpdateMetadata(
+    const std::shared_ptr<TMetadata> &md, size_t broker_index) {
+  assert(this);
+  assert(md);
+  Metadata = md;
+  BrokerIndex = broker_index;
+}
+
 TOpt<TProduceRequest> TProduceRequestFactory::BuildRequest(
     std::vector<uint8_t> &dst) {
   assert(this);
@@ -118,6 +145,7 @@ TOpt<TProduceRequest> TProduceRequestFactory::BuildRequest(
       static_cast<int32_t>(Config.ReplicationTimeout));
   const TAllTopics &all_topics = request.second;
   assert(!all_topics.empty());
+  CompressionSavings = 0;
 
   for (const auto &topic_elem : all_topics) {
     const std::string &topic = topic_elem.first;
@@ -139,6 +167,7 @@ TOpt<TProduceRequest> TProduceRequestFactory::BuildRequest(
 
   RequestWriter->CloseRequest();
   SerializeProduceRequest.Increment();
+  LastRequestUncompressedSize = dst.size() + CompressionSavings;
   return TOpt<TProduceRequest>(std::move(request));
 }
 
@@ -294,6 +323,7 @@ bool TProduceRequestFactory::TryConsumeFrontMsg(
   size_t new_result_data_size = result_data_size + data_size;
 
   if (new_result_data_size > ProduceRequestDataLimit) {
+    LastRequestDataLimitReached = true;
     return false;
   }
 
@@ -329,6 +359,7 @@ TAllTopics TProduceRequestFactory::BuildRequestContents() {
   assert(this);
   assert(!InputQueue.empty());
   TAllTopics result;
+  LastRequestDataLimitReached = false;
   size_t result_data_size = AddFirstMsg(result);
 
   /* Once we have reached the data limit for an entire request, we can't add
@@ -375,8 +406,12 @@ TAllTopics TProduceRequestFactory::BuildRequestContents() {
         break;
       }
     }
+  } else if (!InputQueue.empty()) {
+    LastRequestDataLimitReached = true;
   }
 
+  LastRequestDataSize = result_data_size;
+
   for (auto &elem : result) {
     GetTopicData(elem.first).AnyPartitionChooser.ClearChoice();
   }
@@ -470,6 +505,11 @@ void TProduceRequestFactory::WriteOneMsgSet(
         RequestWriter->AdjustValueSize(compressed_size);
         RequestWriter->CloseMsg();
         MsgSetCompressionYes.Increment();
+
+        if (CompressionBuf.size() > compressed_size) {
+          CompressionSavings += CompressionBuf.size() - compressed_size;
+        }
+
         return;
       }
 
@@ -70,6 +70,28 @@ namespace Dory {
 
       void Reset();
 
+      /* Switch to new metadata in which this factory's broker has index
+         'broker_index', without disturbing queued messages or the correlation
+         ID sequence.  The new metadata must preserve all partitions the broker
+         leads (see TMetadata::MapUnchangedBrokers()), so partition choices
+         already made for queued messages remain valid. */
+      void UpdateMetadata(const std::shared_ptr<TMetadata> &md,
+          size_t broker_index);
+
+      /* Switch to a different version of the produce protocol.  This is done
+         when a connector negotiates a produce API version with its broker.
+         Queued messages are unaffected, since the protocol is only used when
+         building requests. */
+      void SetProduceProtocol(
+          const std::shared_ptr<KafkaProto::Produce::TProduceProtocol>
+              &produce_protocol);
+
+      const std::shared_ptr<KafkaProto::Produce::TProduceProtocol> &
+      GetProduceProtocol() const {
+        assert(this);
+        return ProduceProtocol;
+      }
+
       bool IsEmpty() const {
         assert(this);
         return InputQueue.empty();
@@ -136,6 +158,36 @@ namespace Dory {
          AnyPartition and PartitionKey messages. */
       Base::TOpt<TProduceRequest> BuildRequest(std::vector<uint8_t> &dst);
 
+      /* Return what the size in bytes of the request most recently built by
+         BuildRequest() would have been if none of its message sets had been
+         compressed.  Used for statistics. */
+      size_t GetLastRequestUncompressedSize() const {
+        assert(this);
+        return LastRequestUncompressedSize;
+      }
+
+      /* Return the total size in bytes of the message keys and values in the
+         request most recently built by BuildRequest().  This is the size
+         that is compared against the produce request data limit.  Used for
+         statistics. */
+      size_t GetLastRequestDataSize() const {
+        assert(this);
+        return LastRequestDataSize;
+      }
+
+      /* Return true if the request most recently built by BuildRequest()
+         was cut short by the produce request data limit, leaving queued
+         messages that did not fit.  Used for statistics. */
+      bool LastRequestReachedDataLimit() const {
+        assert(this);
+        return LastRequestDataLimitReached;
+      }
+
+      size_t GetProduceRequestDataLimit() const {
+        assert(this);
+        return ProduceRequestDataLimit;
+      }
+
       private:
       struct TTopicData {
         /* This is null in the case where no compression is used. */
@@ -180,27 +232,25 @@ namespace Dory {
 
       const TConfig &Config;
 
-      const size_t BrokerIndex;
+      size_t BrokerIndex;
 
-      const std::shared_ptr<KafkaProto::Produce::TProduceProtocol>
-          ProduceProtocol;
+      std::shared_ptr<KafkaProto::Produce::TProduceProtocol> ProduceProtocol;
 
       const size_t ProduceRequestDataLimit;
 
       const size_t MessageMaxBytes;
 
-      const size_t SingleMsgOverhead;
+      size_t SingleMsgOverhead;
 
       /* If (compressed message set size / uncompressed message set size)
          exceeds this value, then we send it uncompressed so the broker avoids
          spending CPU cycles dealing with the compression. */
       const float MaxCompressionRatio;
 
-      const std::unique_ptr<KafkaProto::Produce::TProduceRequestWriterApi>
+      std::unique_ptr<KafkaProto::Produce::TProduceRequestWriterApi>
           RequestWriter;
 
-      const std::unique_ptr<KafkaProto::Produce::TMsgSetWriterApi>
-          MsgSetWriter;
+      std::unique_ptr<KafkaProto::Produce::TMsgSetWriterApi> MsgSetWriter;
 
       Conf::TCompressionConf::TConf DefaultTopicConf;
 
@@ -219,6 +269,19 @@ namespace Dory {
          compressed into the destination buffer for the serialized produce
          request. */
       std::vector<uint8_t> CompressionBuf;
+
+      /* Total number of bytes saved by compressing message sets in the
+         request being built. */
+      size_t CompressionSavings;
+
+      /* See GetLastRequestUncompressedSize(). */
+      size_t LastRequestUncompressedSize;
+
+      /* See GetLastRequestDataSize(). */
+      size_t LastRequestDataSize;
+
+      /* See LastRequestReachedDataLimit(). */
+      bool LastRequestDataLimitReached;
     };  // TProduceRequestFactory
 
   }  // MsgDispatch
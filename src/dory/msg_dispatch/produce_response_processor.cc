@@ -243,7 +243,7 @@ bool TProduceResponseProcessor::ProcessOneAck(std::list<TMsg::TPtr> &&msg_set,
     case TAckResultAction::Ok: {  // got successful ACK
       ConnectorGotSuccessfulAck.Increment();
       DebugLogger.LogMsgList(msg_set);
-      Ds.MsgStateTracker.MsgEnterProcessed(msg_set);
+      Ds.MsgStateTracker.MsgEnterProcessedOnAck(msg_set, MyBrokerId);
       msg_set.clear();
       break;
     }
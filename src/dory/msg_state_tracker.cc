@@ -21,9 +21,12 @@
 
 #include <dory/msg_state_tracker.h>
 
+#include <algorithm>
+
 #include <syslog.h>
 
 #include <base/no_default_case.h>
+#include <base/time_util.h>
 #include <dory/util/time_util.h>
 
 using namespace Base;
@@ -40,17 +43,35 @@ void TMsgStateTracker::MsgEnterNew() {
 
 void TMsgStateTracker::MsgEnterBatching(TMsg &msg) {
   assert(this);
+  uint64_t now = GetMonotonicRawMicroseconds();
+
+  {
+    TLatencyTracker::TRecorder recorder(LatencyTracker, msg.GetTopic(), -1);
+    RecordLatency(recorder, msg, TMsg::TState::Batching, now);
+  }
+
   TDeltaComputer comp;
-  comp.CountBatchingEntered(msg.GetState());
+  comp.CountBatchingEntered(msg.GetState(),
+      msg.GetKeyAndValue().Size());
   msg.SetState(TMsg::TState::Batching);
+  msg.SetStateEnterTimeUsec(now);
   UpdateStats(msg.GetTopic(), comp);
 }
 
 void TMsgStateTracker::MsgEnterSendWait(TMsg &msg) {
   assert(this);
+  uint64_t now = GetMonotonicRawMicroseconds();
+
+  {
+    TLatencyTracker::TRecorder recorder(LatencyTracker, msg.GetTopic(), -1);
+    RecordLatency(recorder, msg, TMsg::TState::SendWait, now);
+  }
+
   TDeltaComputer comp;
-  comp.CountSendWaitEntered(msg.GetState());
+  comp.CountSendWaitEntered(msg.GetState(),
+      msg.GetKeyAndValue().Size());
   msg.SetState(TMsg::TState::SendWait);
+  msg.SetStateEnterTimeUsec(now);
   UpdateStats(msg.GetTopic(), comp);
 }
 
@@ -63,14 +84,22 @@ void TMsgStateTracker::MsgEnterSendWait(
   }
 
   const std::string &topic = msg_list.front()->GetTopic();
+  uint64_t now = GetMonotonicRawMicroseconds();
   TDeltaComputer comp;
 
-  for (auto &msg_ptr : msg_list) {
-    assert(msg_ptr);
-    TMsg &msg = *msg_ptr;
-    assert(msg.GetTopic() == topic);
-    comp.CountSendWaitEntered(msg.GetState());
-    msg.SetState(TMsg::TState::SendWait);
+  {
+    TLatencyTracker::TRecorder recorder(LatencyTracker, topic, -1);
+
+    for (auto &msg_ptr : msg_list) {
+      assert(msg_ptr);
+      TMsg &msg = *msg_ptr;
+      assert(msg.GetTopic() == topic);
+      RecordLatency(recorder, msg, TMsg::TState::SendWait, now);
+      comp.CountSendWaitEntered(msg.GetState(),
+          msg.GetKeyAndValue().Size());
+      msg.SetState(TMsg::TState::SendWait);
+      msg.SetStateEnterTimeUsec(now);
+    }
   }
 
   UpdateStats(topic, comp);
@@ -87,13 +116,23 @@ void TMsgStateTracker::MsgEnterSendWait(
 
 void TMsgStateTracker::MsgEnterAckWait(TMsg &msg) {
   assert(this);
+  uint64_t now = GetMonotonicRawMicroseconds();
+
+  {
+    TLatencyTracker::TRecorder recorder(LatencyTracker, msg.GetTopic(), -1);
+    RecordLatency(recorder, msg, TMsg::TState::AckWait, now);
+  }
+
   TDeltaComputer comp;
-  comp.CountAckWaitEntered(msg.GetState());
+  comp.CountAckWaitEntered(msg.GetState(),
+      msg.GetKeyAndValue().Size());
   msg.SetState(TMsg::TState::AckWait);
+  msg.SetStateEnterTimeUsec(now);
   UpdateStats(msg.GetTopic(), comp);
 }
 
-void TMsgStateTracker::MsgEnterAckWait(const std::list<TMsg::TPtr> &msg_list) {
+void TMsgStateTracker::MsgEnterAckWait(const std::list<TMsg::TPtr> &msg_list,
+    long broker_id) {
   assert(this);
 
   if (msg_list.empty()) {
@@ -101,14 +140,22 @@ void TMsgStateTracker::MsgEnterAckWait(const std::list<TMsg::TPtr> &msg_list) {
   }
 
   const std::string &topic = msg_list.front()->GetTopic();
+  uint64_t now = GetMonotonicRawMicroseconds();
   TDeltaComputer comp;
 
-  for (auto &msg_ptr : msg_list) {
-    assert(msg_ptr);
-    TMsg &msg = *msg_ptr;
-    assert(msg.GetTopic() == topic);
-    comp.CountAckWaitEntered(msg.GetState());
-    msg.SetState(TMsg::TState::AckWait);
+  {
+    TLatencyTracker::TRecorder recorder(LatencyTracker, topic, broker_id);
+
+    for (auto &msg_ptr : msg_list) {
+      assert(msg_ptr);
+      TMsg &msg = *msg_ptr;
+      assert(msg.GetTopic() == topic);
+      RecordLatency(recorder, msg, TMsg::TState::AckWait, now);
+      comp.CountAckWaitEntered(msg.GetState(),
+          msg.GetKeyAndValue().Size());
+      msg.SetState(TMsg::TState::AckWait);
+      msg.SetStateEnterTimeUsec(now);
+    }
   }
 
   UpdateStats(topic, comp);
@@ -126,7 +173,8 @@ void TMsgStateTracker::MsgEnterAckWait(
 void TMsgStateTracker::MsgEnterProcessed(TMsg &msg) {
   assert(this);
   TDeltaComputer comp;
-  comp.CountProcessedEntered(msg.GetState());
+  comp.CountProcessedEntered(msg.GetState(),
+      msg.GetKeyAndValue().Size());
   msg.SetState(TMsg::TState::Processed);
   UpdateStats(msg.GetTopic(), comp);
 }
@@ -134,32 +182,45 @@ void TMsgStateTracker::MsgEnterProcessed(TMsg &msg) {
 void TMsgStateTracker::MsgEnterProcessed(
     const std::list<TMsg::TPtr> &msg_list) {
   assert(this);
+  DoMsgEnterProcessed(msg_list, false);
+}
+
+void TMsgStateTracker::MsgEnterProcessed(
+    const std::list<std::list<TMsg::TPtr>> &msg_list_list) {
+  assert(this);
+
+  for (const auto &msg_list : msg_list_list) {
+    MsgEnterProcessed(msg_list);
+  }
+}
+
+void TMsgStateTracker::MsgEnterProcessedOnAck(
+    const std::list<TMsg::TPtr> &msg_list, long broker_id) {
+  assert(this);
 
   if (msg_list.empty()) {
     return;
   }
 
-  const std::string &topic = msg_list.front()->GetTopic();
-  TDeltaComputer comp;
+  uint64_t now = GetMonotonicRawMicroseconds();
 
-  for (auto &msg_ptr : msg_list) {
-    assert(msg_ptr);
-    TMsg &msg = *msg_ptr;
-    assert(msg.GetTopic() == topic);
-    comp.CountProcessedEntered(msg.GetState());
-    msg.SetState(TMsg::TState::Processed);
+  {
+    TLatencyTracker::TRecorder recorder(LatencyTracker,
+        msg_list.front()->GetTopic(), broker_id);
+
+    for (auto &msg_ptr : msg_list) {
+      assert(msg_ptr);
+      RecordLatency(recorder, *msg_ptr, TMsg::TState::Processed, now);
+    }
   }
 
-  UpdateStats(topic, comp);
+  DoMsgEnterProcessed(msg_list, true);
 }
 
-void TMsgStateTracker::MsgEnterProcessed(
-    const std::list<std::list<TMsg::TPtr>> &msg_list_list) {
+void TMsgStateTracker::MsgEnterProcessedNoAck(
+    const std::list<TMsg::TPtr> &msg_list) {
   assert(this);
-
-  for (const auto &msg_list : msg_list_list) {
-    MsgEnterProcessed(msg_list);
-  }
+  DoMsgEnterProcessed(msg_list, true);
 }
 
 void TMsgStateTracker::GetStats(std::vector<TTopicStatsItem> &result,
@@ -180,8 +241,25 @@ void TMsgStateTracker::GetStats(std::vector<TTopicStatsItem> &result,
   new_count = NewCount;
 }
 
+void TMsgStateTracker::GetDeliveredCounts(
+    std::vector<TDeliveredItem> &delivered,
+    uint64_t &other_topics_delivered) const {
+  assert(this);
+  delivered.clear();
+
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    delivered.assign(DeliveredCounts.begin(), DeliveredCounts.end());
+    other_topics_delivered = OtherTopicsDelivered;
+  }
+
+  std::sort(delivered.begin(), delivered.end());
+}
+
 void TMsgStateTracker::PruneTopics(const TTopicExistsFn &topic_exists_fn) {
   assert(this);
+  LatencyTracker.PruneTopics(topic_exists_fn);
+  BatchStats.PruneTopics(topic_exists_fn);
   std::lock_guard<std::mutex> lock(Mutex);
 
   for (auto iter = TopicStats.begin(); iter != TopicStats.end(); ) {
@@ -198,14 +276,64 @@ void TMsgStateTracker::PruneTopics(const TTopicExistsFn &topic_exists_fn) {
   }
 }
 
+void TMsgStateTracker::RecordLatency(TLatencyTracker::TRecorder &recorder,
+    const TMsg &msg, TMsg::TState new_state, uint64_t now) {
+  using TStage = TLatencyTracker::TStage;
+  uint64_t enter_time = msg.GetStateEnterTimeUsec();
+  uint64_t elapsed = (now > enter_time) ? (now - enter_time) : 0;
+
+  /* Only transitions along the normal delivery path are recorded.  For
+     instance, a message that goes from AckWait back to SendWait after an
+     error records nothing for that transition. */
+  switch (msg.GetState()) {
+    case TMsg::TState::New: {
+      if ((new_state == TMsg::TState::Batching) ||
+          (new_state == TMsg::TState::SendWait)) {
+        recorder.Record(TStage::Intake, elapsed);
+      }
+
+      break;
+    }
+    case TMsg::TState::Batching: {
+      if (new_state == TMsg::TState::SendWait) {
+        recorder.Record(TStage::Batching, elapsed);
+      }
+
+      break;
+    }
+    case TMsg::TState::SendWait: {
+      if (new_state == TMsg::TState::AckWait) {
+        recorder.Record(TStage::SendWait, elapsed);
+      }
+
+      break;
+    }
+    case TMsg::TState::AckWait: {
+      if (new_state == TMsg::TState::Processed) {
+        uint64_t creation_time = msg.GetCreationTimeUsec();
+        recorder.Record(TStage::AckWait, elapsed);
+        recorder.Record(TStage::Total,
+            (now > creation_time) ? (now - creation_time) : 0);
+      }
+
+      break;
+    }
+    case TMsg::TState::Processed: {
+      break;
+    }
+    NO_DEFAULT_CASE;
+  }
+}
+
 void TMsgStateTracker::TDeltaComputer::CountBatchingEntered(
-    TMsg::TState prev_state) {
+    TMsg::TState prev_state, size_t size) {
   assert(this);
 
   switch (prev_state) {
     case TMsg::TState::New: {
       --NewDelta;
       ++BatchingDelta;
+      QueuedBytesDelta += static_cast<long>(size);
       break;
     }
     case TMsg::TState::Batching: {
@@ -253,13 +381,14 @@ void TMsgStateTracker::TDeltaComputer::CountBatchingEntered(
 }
 
 void TMsgStateTracker::TDeltaComputer::CountSendWaitEntered(
-    TMsg::TState prev_state) {
+    TMsg::TState prev_state, size_t size) {
   assert(this);
 
   switch (prev_state) {
     case TMsg::TState::New: {
       --NewDelta;
       ++SendWaitDelta;
+      QueuedBytesDelta += static_cast<long>(size);
       break;
     }
     case TMsg::TState::Batching: {
@@ -290,7 +419,7 @@ void TMsgStateTracker::TDeltaComputer::CountSendWaitEntered(
 }
 
 void TMsgStateTracker::TDeltaComputer::CountAckWaitEntered(
-    TMsg::TState prev_state) {
+    TMsg::TState prev_state, size_t /*size*/) {
   assert(this);
 
   switch (prev_state) {
@@ -345,7 +474,7 @@ void TMsgStateTracker::TDeltaComputer::CountAckWaitEntered(
 }
 
 void TMsgStateTracker::TDeltaComputer::CountProcessedEntered(
-    TMsg::TState prev_state) {
+    TMsg::TState prev_state, size_t size) {
   assert(this);
 
   switch (prev_state) {
@@ -365,10 +494,12 @@ void TMsgStateTracker::TDeltaComputer::CountProcessedEntered(
     }
     case TMsg::TState::SendWait: {
       --SendWaitDelta;
+      QueuedBytesDelta -= static_cast<long>(size);
       break;
     }
     case TMsg::TState::AckWait: {
       --AckWaitDelta;
+      QueuedBytesDelta -= static_cast<long>(size);
       break;
     }
     case TMsg::TState::Processed: {
@@ -385,6 +516,33 @@ void TMsgStateTracker::TDeltaComputer::CountProcessedEntered(
   }
 }
 
+void TMsgStateTracker::DoMsgEnterProcessed(
+    const std::list<TMsg::TPtr> &msg_list, bool delivered) {
+  assert(this);
+
+  if (msg_list.empty()) {
+    return;
+  }
+
+  const std::string &topic = msg_list.front()->GetTopic();
+  TDeltaComputer comp;
+
+  for (auto &msg_ptr : msg_list) {
+    assert(msg_ptr);
+    TMsg &msg = *msg_ptr;
+    assert(msg.GetTopic() == topic);
+    comp.CountProcessedEntered(msg.GetState(),
+        msg.GetKeyAndValue().Size());
+    msg.SetState(TMsg::TState::Processed);
+  }
+
+  if (delivered) {
+    comp.CountDelivered(msg_list.size());
+  }
+
+  UpdateStats(topic, comp);
+}
+
 void TMsgStateTracker::UpdateStats(const std::string &topic,
     const TDeltaComputer &comp) {
   assert(this);
@@ -392,6 +550,7 @@ void TMsgStateTracker::UpdateStats(const std::string &topic,
   long batching_delta = comp.GetBatchingDelta();
   long send_wait_delta = comp.GetSendWaitDelta();
   long ack_wait_delta = comp.GetAckWaitDelta();
+  long queued_bytes_delta = comp.GetQueuedBytesDelta();
 
   std::lock_guard<std::mutex> lock(Mutex);
 
@@ -416,6 +575,8 @@ void TMsgStateTracker::UpdateStats(const std::string &topic,
     assert(w.TopicStats.SendWaitCount >= 0);
     w.TopicStats.AckWaitCount += ack_wait_delta;
     assert(w.TopicStats.AckWaitCount >= 0);
+    w.TopicStats.QueuedBytes += queued_bytes_delta;
+    assert(w.TopicStats.QueuedBytes >= 0);
 
     if (w.OkToDelete && (w.TopicStats.BatchingCount == 0) &&
         (w.TopicStats.SendWaitCount == 0) &&
@@ -425,4 +586,17 @@ void TMsgStateTracker::UpdateStats(const std::string &topic,
   }
 
   NewCount += new_delta;
+  uint64_t delivered_delta = comp.GetDeliveredDelta();
+
+  if (delivered_delta) {
+    auto iter = DeliveredCounts.find(topic);
+
+    if (iter != DeliveredCounts.end()) {
+      iter->second += delivered_delta;
+    } else if (DeliveredCounts.size() < MAX_DELIVERED_TOPICS) {
+      DeliveredCounts.insert(std::make_pair(topic, delivered_delta));
+    } else {
+      OtherTopicsDelivered += delivered_delta;
+    }
+  }
 }
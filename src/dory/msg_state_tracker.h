@@ -22,6 +22,7 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <mutex>
 #include <string>
@@ -30,12 +31,15 @@
 #include <vector>
 
 #include <base/no_copy_semantics.h>
+#include <dory/batch/batch_stats.h>
+#include <dory/latency_tracker.h>
 #include <dory/msg.h>
 
 namespace Dory {
 
   /* Singleton class for tracking info on message states.  If Kafka starts
-     falling behind, this lets us see which topics are lagging. */
+     falling behind, this lets us see which topics are lagging.  The time each
+     message spends in each state is also recorded in a TLatencyTracker. */
   class TMsgStateTracker final {
     NO_COPY_SEMANTICS(TMsgStateTracker);
 
@@ -47,15 +51,28 @@ namespace Dory {
 
       long AckWaitCount;
 
+      /* Total size in bytes of the keys and values of the messages counted
+         above.  This shows which topics are using buffer space. */
+      long QueuedBytes;
+
       TTopicStats()
           : BatchingCount(0),
             SendWaitCount(0),
-            AckWaitCount(0) {
+            AckWaitCount(0),
+            QueuedBytes(0) {
       }
     };  // TTopicStats
 
-    TMsgStateTracker()
-        : NewCount(0) {
+    /* The maximum number of topics to keep delivered message counts for.
+       See GetDeliveredCounts(). */
+    static const size_t MAX_DELIVERED_TOPICS = 10000;
+
+    /* If 'topic_latency_stats' is true, message latencies are recorded per
+       topic as well as for all topics combined. */
+    explicit TMsgStateTracker(bool topic_latency_stats = false)
+        : NewCount(0),
+          OtherTopicsDelivered(0),
+          LatencyTracker(topic_latency_stats) {
     }
 
     /* A brand new message has been created.  Update our stats to indicate
@@ -88,8 +105,11 @@ namespace Dory {
     void MsgEnterAckWait(TMsg &msg);
 
     /* Same as above, but process an entire list of messages.  All messages in
-       list _must_ have same topic. */
-    void MsgEnterAckWait(const std::list<TMsg::TPtr> &msg_list);
+       list _must_ have same topic.  If 'broker_id' is nonnegative, it
+       identifies the broker the messages were sent to, and the time they
+       waited to be sent is also recorded for that broker. */
+    void MsgEnterAckWait(const std::list<TMsg::TPtr> &msg_list,
+        long broker_id = -1);
 
     /* Same as above, but process an entire list of message lists.  All
        messages in each inner list _must_ have same topic, but outer list can
@@ -113,6 +133,36 @@ namespace Dory {
     void MsgEnterProcessed(
         const std::list<std::list<TMsg::TPtr>> &msg_list_list);
 
+    /* Same as MsgEnterProcessed(msg_list), but called when broker
+       'broker_id' has returned a successful ACK for the messages.  The ACK
+       latency and total time in Dory are recorded for each message, and the
+       messages are counted as delivered. */
+    void MsgEnterProcessedOnAck(const std::list<TMsg::TPtr> &msg_list,
+        long broker_id);
+
+    /* Same as MsgEnterProcessed(msg_list), but called when the messages have
+       been sent to Kafka and no ACK is expected because required_acks is 0.
+       The messages are counted as delivered. */
+    void MsgEnterProcessedNoAck(const std::list<TMsg::TPtr> &msg_list);
+
+    const TLatencyTracker &GetLatencyTracker() const {
+      assert(this);
+      return LatencyTracker;
+    }
+
+    /* Batch completion and produce request fill stats.  These are kept here
+       because the router and connector threads that complete batches
+       already share this object. */
+    Batch::TBatchStats &GetBatchStats() {
+      assert(this);
+      return BatchStats;
+    }
+
+    const Batch::TBatchStats &GetBatchStats() const {
+      assert(this);
+      return BatchStats;
+    }
+
     /* The first item is the topic, and the second item is stats for that
        topic. */   
     using TTopicStatsItem = std::pair<std::string, TTopicStats>;
@@ -124,6 +174,18 @@ namespace Dory {
     void GetStats(std::vector<TTopicStatsItem> &topic_stats,
                   long &new_count) const;
 
+    /* The first item is the topic, and the second item is the number of
+       messages delivered for that topic. */
+    using TDeliveredItem = std::pair<std::string, uint64_t>;
+
+    /* On return, 'delivered' will be filled with the number of messages
+       delivered to Kafka for each topic since Dory started, ordered by topic.
+       Counts are kept for at most MAX_DELIVERED_TOPICS topics, and
+       'other_topics_delivered' gives the total for any additional topics.
+       Counts are not removed by PruneTopics(), so they never decrease. */
+    void GetDeliveredCounts(std::vector<TDeliveredItem> &delivered,
+        uint64_t &other_topics_delivered) const;
+
     /* A topic name is passed as a parameter.  Function returns true if topic
        is present in metadata or false otherwise. */
     using TTopicExistsFn = std::function<bool(const std::string &)>;
@@ -137,13 +199,25 @@ namespace Dory {
     void PruneTopics(const TTopicExistsFn &topic_exists_fn);
 
     private:
+    /* Record the latency of leaving the current state of 'msg' and entering
+       'new_state' at time 'now' (monotonic raw microseconds). */
+    static void RecordLatency(TLatencyTracker::TRecorder &recorder,
+        const TMsg &msg, TMsg::TState new_state, uint64_t now);
+
+    /* Implements MsgEnterProcessed(msg_list).  If 'delivered' is true, the
+       messages are also counted as delivered. */
+    void DoMsgEnterProcessed(const std::list<TMsg::TPtr> &msg_list,
+        bool delivered);
+
     class TDeltaComputer final {
       public:
       TDeltaComputer()
           : NewDelta(0),
             BatchingDelta(0),
             SendWaitDelta(0),
-            AckWaitDelta(0) {
+            AckWaitDelta(0),
+            QueuedBytesDelta(0),
+            DeliveredDelta(0) {
       }
 
       long GetNewDelta() const {
@@ -166,13 +240,30 @@ namespace Dory {
         return AckWaitDelta;
       }
 
-      void CountBatchingEntered(TMsg::TState prev_state);
+      long GetQueuedBytesDelta() const {
+        assert(this);
+        return QueuedBytesDelta;
+      }
+
+      uint64_t GetDeliveredDelta() const {
+        assert(this);
+        return DeliveredDelta;
+      }
 
-      void CountSendWaitEntered(TMsg::TState prev_state);
+      /* In the methods below, 'size' is the size of the key and value of the
+         message changing state. */
+      void CountBatchingEntered(TMsg::TState prev_state, size_t size);
 
-      void CountAckWaitEntered(TMsg::TState prev_state);
+      void CountSendWaitEntered(TMsg::TState prev_state, size_t size);
 
-      void CountProcessedEntered(TMsg::TState prev_state);
+      void CountAckWaitEntered(TMsg::TState prev_state, size_t size);
+
+      void CountProcessedEntered(TMsg::TState prev_state, size_t size);
+
+      void CountDelivered(size_t count) {
+        assert(this);
+        DeliveredDelta += count;
+      }
 
       private:
       long NewDelta;
@@ -182,6 +273,10 @@ namespace Dory {
       long SendWaitDelta;
 
       long AckWaitDelta;
+
+      long QueuedBytesDelta;
+
+      uint64_t DeliveredDelta;
     };  // TDeltaComputer
 
     struct TTopicStatsWrapper {
@@ -199,7 +294,8 @@ namespace Dory {
 
     void UpdateStats(const std::string &topic, const TDeltaComputer &comp);
 
-    /* Protects 'TopicStats' and 'NewCount'. */
+    /* Protects 'TopicStats', 'NewCount', 'DeliveredCounts', and
+       'OtherTopicsDelivered'. */
     mutable std::mutex Mutex;
 
     /* Keys are topics, and values are per-topic stats. */
@@ -208,6 +304,21 @@ namespace Dory {
     /* Messages in state TMsg::TState::New are not broken down by topic, since
        some may have invalid topics. */
     long NewCount;
+
+    /* Keys are topics, and values are delivered message counts.  See
+       GetDeliveredCounts(). */
+    std::unordered_map<std::string, uint64_t> DeliveredCounts;
+
+    uint64_t OtherTopicsDelivered;
+
+    /* Latencies of state transitions, for all topics combined, per broker,
+       and optionally per topic.  This has its own locking, separate from
+       'Mutex'. */
+    TLatencyTracker LatencyTracker;
+
+    /* See GetBatchStats().  This has its own locking, separate from
+       'Mutex'. */
+    Batch::TBatchStats BatchStats;
   };  // TMsgStateTracker
 
 }  // Dory
@@ -0,0 +1,165 @@
+/* <dory/msg_state_tracker.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/msg_state_tracker.h>.
+ */
+
+#include <dory/msg_state_tracker.h>
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <dory/msg.h>
+#include <dory/test_util/misc_util.h>
+
+#include <gtest/gtest.h>
+
+using namespace Dory;
+using namespace Dory::TestUtil;
+
+namespace {
+
+  const TMsgStateTracker::TTopicStats *
+  FindTopic(const std::vector<TMsgStateTracker::TTopicStatsItem> &stats,
+      const std::string &topic) {
+    for (const auto &item : stats) {
+      if (item.first == topic) {
+        return &item.second;
+      }
+    }
+
+    return nullptr;
+  }
+
+  /* The fixture for testing class TMsgStateTracker. */
+  class TMsgStateTrackerTest : public ::testing::Test {
+    protected:
+    TMsgStateTrackerTest() {
+    }
+
+    virtual ~TMsgStateTrackerTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TMsgStateTrackerTest
+
+  TEST_F(TMsgStateTrackerTest, QueuedBytesTest) {
+    TTestMsgCreator mc;
+    TMsgStateTracker &tracker = mc.MsgStateTracker;
+    std::list<TMsg::TPtr> msg_list;
+    msg_list.push_back(mc.NewMsg("t1", "12345", 0));
+    msg_list.push_back(mc.NewMsg("t1", "1234567890", 0));
+    TMsg::TPtr other = mc.NewMsg("t2", "abc", 0);
+    std::vector<TMsgStateTracker::TTopicStatsItem> stats;
+    long new_count = 0;
+    tracker.GetStats(stats, new_count);
+    ASSERT_TRUE(stats.empty());
+    ASSERT_EQ(new_count, 3);
+
+    for (const TMsg::TPtr &msg : msg_list) {
+      tracker.MsgEnterBatching(*msg);
+    }
+
+    tracker.MsgEnterSendWait(*other);
+    tracker.GetStats(stats, new_count);
+    ASSERT_EQ(stats.size(), 2U);
+    ASSERT_EQ(new_count, 0);
+    const TMsgStateTracker::TTopicStats *t1 = FindTopic(stats, "t1");
+    ASSERT_TRUE(t1 != nullptr);
+    ASSERT_EQ(t1->BatchingCount, 2);
+    ASSERT_EQ(t1->QueuedBytes, 15);
+    const TMsgStateTracker::TTopicStats *t2 = FindTopic(stats, "t2");
+    ASSERT_TRUE(t2 != nullptr);
+    ASSERT_EQ(t2->SendWaitCount, 1);
+    ASSERT_EQ(t2->QueuedBytes, 3);
+
+    /* Byte counts are unaffected by transitions between the queued states,
+       including resends. */
+    tracker.MsgEnterSendWait(msg_list);
+    tracker.MsgEnterAckWait(msg_list, 1);
+    tracker.MsgEnterSendWait(*msg_list.front());
+    tracker.GetStats(stats, new_count);
+    t1 = FindTopic(stats, "t1");
+    ASSERT_TRUE(t1 != nullptr);
+    ASSERT_EQ(t1->SendWaitCount, 1);
+    ASSERT_EQ(t1->AckWaitCount, 1);
+    ASSERT_EQ(t1->QueuedBytes, 15);
+
+    /* The message left in SendWait is discarded. */
+    tracker.MsgEnterProcessed(*msg_list.front());
+    tracker.GetStats(stats, new_count);
+    t1 = FindTopic(stats, "t1");
+    ASSERT_TRUE(t1 != nullptr);
+    ASSERT_EQ(t1->QueuedBytes, 10);
+
+    msg_list.pop_front();
+    tracker.MsgEnterProcessedOnAck(msg_list, 1);
+    tracker.MsgEnterProcessed(*other);
+    tracker.GetStats(stats, new_count);
+    ASSERT_TRUE(stats.empty());
+  }
+
+  TEST_F(TMsgStateTrackerTest, DeliveredTest) {
+    TTestMsgCreator mc;
+    TMsgStateTracker &tracker = mc.MsgStateTracker;
+    std::list<TMsg::TPtr> acked;
+    acked.push_back(mc.NewMsg("t1", "a", 0));
+    acked.push_back(mc.NewMsg("t1", "b", 0));
+    std::list<TMsg::TPtr> no_ack;
+    no_ack.push_back(mc.NewMsg("t2", "c", 0));
+    std::list<TMsg::TPtr> discarded;
+    discarded.push_back(mc.NewMsg("t1", "d", 0));
+    tracker.MsgEnterSendWait(acked);
+    tracker.MsgEnterSendWait(no_ack);
+    tracker.MsgEnterSendWait(discarded);
+    tracker.MsgEnterAckWait(acked, 1);
+
+    /* ACKed messages and messages sent with no ACK expected are counted.
+       Discarded messages aren't. */
+    tracker.MsgEnterProcessedOnAck(acked, 1);
+    tracker.MsgEnterProcessedNoAck(no_ack);
+    tracker.MsgEnterProcessed(discarded);
+    std::vector<TMsgStateTracker::TDeliveredItem> delivered;
+    uint64_t other_topics_delivered = 1;
+    tracker.GetDeliveredCounts(delivered, other_topics_delivered);
+    ASSERT_EQ(delivered.size(), 2U);
+    ASSERT_EQ(delivered[0].first, "t1");
+    ASSERT_EQ(delivered[0].second, 2U);
+    ASSERT_EQ(delivered[1].first, "t2");
+    ASSERT_EQ(delivered[1].second, 1U);
+    ASSERT_EQ(other_topics_delivered, 0U);
+
+    /* Counts survive deletion of their topics. */
+    tracker.PruneTopics([](const std::string &) { return false; });
+    tracker.GetDeliveredCounts(delivered, other_topics_delivered);
+    ASSERT_EQ(delivered.size(), 2U);
+    ASSERT_EQ(delivered[0].second, 2U);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,86 @@
+/* <dory/pool_monitor.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/pool_monitor.h>.
+ */
+
+#include <dory/pool_monitor.h>
+
+#include <algorithm>
+
+#include <syslog.h>
+
+using namespace Capped;
+using namespace Dory;
+
+TPoolMonitor::TPoolMonitor(TPool &pool,
+    const std::vector<size_t> &log_thresholds_percent, TClockFn clock_fn)
+    : Pool(pool),
+      Thresholds(log_thresholds_percent),
+      ClockFn(clock_fn),
+      HighWaterMarkResetTime(clock_fn()),
+      Level(0) {
+  std::sort(Thresholds.begin(), Thresholds.end());
+  Thresholds.erase(std::unique(Thresholds.begin(), Thresholds.end()),
+      Thresholds.end());
+}
+
+size_t TPoolMonitor::ResetHighWaterMark() {
+  assert(this);
+  size_t result = Pool.ResetHighWaterMark();
+  HighWaterMarkResetTime.store(ClockFn(), std::memory_order_relaxed);
+  return result;
+}
+
+size_t TPoolMonitor::CheckThresholds() {
+  assert(this);
+
+  if (Thresholds.empty()) {
+    return 0;
+  }
+
+  size_t block_count = Pool.GetBlockCount();
+  size_t allocated = Pool.GetAllocatedBlockCount();
+
+  /* Compare allocated / block_count against threshold / 100 without
+     division, so that small pools are handled exactly. */
+  size_t level = 0;
+
+  while ((level < Thresholds.size()) &&
+      ((allocated * 100) >= (Thresholds[level] * block_count))) {
+    ++level;
+  }
+
+  if (level > Level) {
+    syslog(LOG_WARNING, "Buffer pool occupancy rose to %u%% threshold: %lu "
+        "of %lu blocks allocated, high water mark %lu",
+        static_cast<unsigned>(Thresholds[level - 1]),
+        static_cast<unsigned long>(allocated),
+        static_cast<unsigned long>(block_count),
+        static_cast<unsigned long>(Pool.GetHighWaterMark()));
+  } else if (level < Level) {
+    syslog(LOG_NOTICE, "Buffer pool occupancy fell below %u%% threshold: %lu "
+        "of %lu blocks allocated",
+        static_cast<unsigned>(Thresholds[level]),
+        static_cast<unsigned long>(allocated),
+        static_cast<unsigned long>(block_count));
+  }
+
+  Level = level;
+  return level;
+}
@@ -0,0 +1,97 @@
+/* <dory/pool_monitor.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for reporting on buffer pool occupancy.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <base/no_copy_semantics.h>
+#include <base/time_util.h>
+#include <capped/pool.h>
+
+namespace Dory {
+
+  /* Wraps the buffer pool that holds message contents, and keeps track of
+     when its high water mark was last reset.  Also logs when pool occupancy
+     crosses any of a configured list of thresholds, so that a pool that is
+     filling up is noticed before messages are discarded. */
+  class TPoolMonitor final {
+    NO_COPY_SEMANTICS(TPoolMonitor);
+
+    public:
+    using TClockFn = std::function<uint64_t()>;
+
+    /* 'log_thresholds_percent' gives occupancy levels, as percentages of the
+       pool's total block count, that CheckThresholds() logs crossings of.  It
+       need not be sorted.  An empty list disables logging. */
+    TPoolMonitor(Capped::TPool &pool,
+        const std::vector<size_t> &log_thresholds_percent,
+        TClockFn clock_fn = &Base::GetEpochSeconds);
+
+    Capped::TPool &GetPool() const {
+      assert(this);
+      return Pool;
+    }
+
+    /* Reset the pool's high water mark and return its previous value.  May be
+       called from any thread. */
+    size_t ResetHighWaterMark();
+
+    /* Return the time, in seconds since the epoch, when the high water mark
+       was last reset (or when we were created, if it has never been reset).
+       May be called from any thread. */
+    uint64_t GetHighWaterMarkResetTime() const {
+      assert(this);
+      return HighWaterMarkResetTime.load(std::memory_order_relaxed);
+    }
+
+    bool IsThresholdLoggingEnabled() const {
+      assert(this);
+      return !Thresholds.empty();
+    }
+
+    /* Compare the pool's current occupancy against the configured thresholds,
+       and log if any have been crossed (in either direction) since the last
+       call.  Returns the number of thresholds that occupancy is currently at
+       or above.  This is intended to be called periodically, always from the
+       same thread. */
+    size_t CheckThresholds();
+
+    private:
+    Capped::TPool &Pool;
+
+    /* Sorted in ascending order, with duplicates removed. */
+    std::vector<size_t> Thresholds;
+
+    const TClockFn ClockFn;
+
+    std::atomic<uint64_t> HighWaterMarkResetTime;
+
+    /* The value CheckThresholds() returned last time it was called. */
+    size_t Level;
+  };  // TPoolMonitor
+
+}  // Dory
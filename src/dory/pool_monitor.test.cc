@@ -0,0 +1,112 @@
+/* <dory/pool_monitor.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/pool_monitor.h>.
+ */
+
+#include <dory/pool_monitor.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <capped/pool.h>
+
+#include <gtest/gtest.h>
+
+using namespace Capped;
+using namespace Dory;
+
+namespace {
+
+  /* The fixture for testing class TPoolMonitor. */
+  class TPoolMonitorTest : public ::testing::Test {
+    protected:
+    TPoolMonitorTest() {
+    }
+
+    virtual ~TPoolMonitorTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TPoolMonitorTest
+
+  TEST_F(TPoolMonitorTest, ThresholdTest) {
+    TPool pool(64, 10, TPool::TSync::Unguarded);
+    TPoolMonitor monitor(pool, {90, 50, 50});
+    ASSERT_TRUE(monitor.IsThresholdLoggingEnabled());
+    ASSERT_EQ(monitor.CheckThresholds(), 0U);
+    std::vector<void *> blocks;
+
+    for (size_t i = 0; i < 4; ++i) {
+      blocks.push_back(pool.Alloc());
+    }
+
+    ASSERT_EQ(monitor.CheckThresholds(), 0U);
+    blocks.push_back(pool.Alloc());
+    ASSERT_EQ(monitor.CheckThresholds(), 1U);
+
+    for (size_t i = 0; i < 4; ++i) {
+      blocks.push_back(pool.Alloc());
+    }
+
+    ASSERT_EQ(monitor.CheckThresholds(), 2U);
+
+    while (blocks.size() > 4) {
+      pool.Free(blocks.back());
+      blocks.pop_back();
+    }
+
+    ASSERT_EQ(monitor.CheckThresholds(), 0U);
+
+    for (void *block : blocks) {
+      pool.Free(block);
+    }
+
+    TPoolMonitor disabled(pool, {});
+    ASSERT_FALSE(disabled.IsThresholdLoggingEnabled());
+    ASSERT_EQ(disabled.CheckThresholds(), 0U);
+  }
+
+  TEST_F(TPoolMonitorTest, HighWaterMarkTest) {
+    uint64_t now = 1000;
+    TPool pool(64, 10, TPool::TSync::Mutexed);
+    TPoolMonitor monitor(pool, {},
+        [&now]() -> uint64_t {
+          return now;
+        });
+    ASSERT_EQ(monitor.GetHighWaterMarkResetTime(), 1000U);
+    void *b1 = pool.Alloc();
+    void *b2 = pool.Alloc();
+    pool.Free(b2);
+    now = 1005;
+    ASSERT_EQ(monitor.ResetHighWaterMark(), 2U);
+    ASSERT_EQ(monitor.GetHighWaterMarkResetTime(), 1005U);
+    ASSERT_EQ(pool.GetHighWaterMark(), 1U);
+    pool.Free(b1);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
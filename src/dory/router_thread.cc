@@ -36,10 +36,11 @@
 #include <base/no_default_case.h>
 #include <base/time_util.h>
 #include <dory/kafka_proto/metadata/metadata_protocol.h>
-#include <dory/kafka_proto/metadata/version_util.h>
 #include <dory/kafka_proto/produce/produce_protocol.h>
 #include <dory/kafka_proto/produce/version_util.h>
+#include <dory/metadata_cache.h>
 #include <dory/util/connect_to_host.h>
+#include <dory/util/event_trace.h>
 #include <dory/util/system_error_codes.h>
 #include <dory/util/time_util.h>
 #include <dory/util/topic_map.h>
@@ -56,11 +57,11 @@ using namespace Dory::KafkaProto::Produce;
 using namespace Dory::MsgDispatch;
 using namespace Dory::Util;
 
+SERVER_COUNTER(AdaptiveBrokerSwitch);
+SERVER_COUNTER(BatchAutoTuneChange);
 SERVER_COUNTER(BatchExpiryDetected);
 SERVER_COUNTER(ConnectFailOnTopicAutocreate);
-SERVER_COUNTER(ConnectFailOnTryGetMetadata);
 SERVER_COUNTER(ConnectSuccessOnTopicAutocreate);
-SERVER_COUNTER(ConnectSuccessOnTryGetMetadata);
 SERVER_COUNTER(DiscardBadTopicMsgOnRoute);
 SERVER_COUNTER(DiscardBadTopicOnReroute);
 SERVER_COUNTER(DiscardDeletedTopicMsg);
@@ -71,29 +72,53 @@ SERVER_COUNTER(DiscardNoAvailablePartitionOnReroute);
 SERVER_COUNTER(DiscardNoLongerAvailableTopicMsg);
 SERVER_COUNTER(DiscardOnTopicAutocreateFail);
 SERVER_COUNTER(FinishRefreshMetadata);
+SERVER_COUNTER(FlushRequestReceived);
 SERVER_COUNTER(GetMetadataFail);
 SERVER_COUNTER(GetMetadataSuccess);
+SERVER_COUNTER(MetadataAppliedIncrementally);
+SERVER_COUNTER(MetadataCacheWrite);
+SERVER_COUNTER(MetadataCacheWriteFail);
 SERVER_COUNTER(MetadataChangedOnRefresh);
 SERVER_COUNTER(MetadataUnchangedOnRefresh);
 SERVER_COUNTER(MetadataUpdated);
 SERVER_COUNTER(PerTopicBatchAnyPartition);
 SERVER_COUNTER(PossibleDuplicateMsg);
+SERVER_COUNTER(PruneKnownTopic);
 SERVER_COUNTER(RefreshMetadataSuccess);
 SERVER_COUNTER(RouteMsgBatchList);
 SERVER_COUNTER(RouterThreadFinishPause);
+SERVER_COUNTER(RouterThreadFinishScopedPause);
 SERVER_COUNTER(RouterThreadGetMsgList);
 SERVER_COUNTER(RouterThreadStartPause);
+SERVER_COUNTER(RouterThreadStartScopedPause);
 SERVER_COUNTER(RouteSingleAnyPartitionMsg);
 SERVER_COUNTER(RouteSingleMsg);
 SERVER_COUNTER(RouteSinglePartitionKeyMsg);
 SERVER_COUNTER(SetBatchExpiry);
 SERVER_COUNTER(StartRefreshMetadata);
+SERVER_COUNTER(StickyBrokerSwitch);
 SERVER_COUNTER(TopicHasNoAvailablePartitions);
+SERVER_COUNTER(TopicLookup);
+SERVER_COUNTER(TopicLookupFail);
+SERVER_COUNTER(TopicLookupNotFound);
+SERVER_COUNTER(UseCachedMetadata);
 
 static unsigned GetRandomNumber() {
   return std::rand();
 }
 
+static TBatchAutoTuner::TParams MakeBatchAutoTunerParams(
+    const TConfig &config, size_t produce_request_data_limit) {
+  TBatchAutoTuner::TParams params;
+  params.Enable = config.BatchAutoTune;
+  params.TargetBytes = config.BatchAutoTuneTargetBytes;
+  params.MinTimeLimit = config.BatchAutoTuneMinTime;
+  params.MaxTimeLimit = config.BatchAutoTuneMaxTime;
+  params.MaxBytes = produce_request_data_limit;
+  params.Interval = config.BatchAutoTuneInterval;
+  return params;
+}
+
 TRouterThread::TRouterThread(const TConfig &config, const TConf &conf,
     TAnomalyTracker &anomaly_tracker, TMsgStateTracker &msg_state_tracker,
     const Batch::TGlobalBatchConfig &batch_config,
@@ -110,10 +135,24 @@ TRouterThread::TRouterThread(const TConfig &config, const TConf &conf,
       Destroying(false),
       NeedToContinueShutdown(false),
       OkShutdown(true),
+      HedgedMetadataFetcher(config.MetadataApiVersion,
+          config.MetadataFetchParallelCount, config.MetadataHedgePercentile,
+          config.MetadataHedgeMinDelay),
+      MetadataFetchThread(config, HedgedMetadataFetcher),
+      AsyncMetadataFetchInProgress(false),
+      PendingPause(TPendingPause::None),
+      PauseStallStartTime(0),
+      MetadataGeneration(0),
       KnownBrokers(conf.GetInitialBrokers()),
+      ProduceRequestDataLimit(batch_config.GetProduceRequestDataLimit()),
+      RandomEngine(GetRandomNumber()),
       PerTopicBatcher(batch_config.GetPerTopicConfig()),
+      BatchAutoTuner(MakeBatchAutoTunerParams(config,
+          batch_config.GetProduceRequestDataLimit())),
       Dispatcher(dispatcher),
       DebugLogger(debug_setup, TDebugSetup::TLogId::MSG_RECEIVE) {
+  /* No broker is chosen until after router-level batching is done. */
+  PerTopicBatcher.SetStats(&msg_state_tracker.GetBatchStats(), -1);
 }
 
 TRouterThread::~TRouterThread() noexcept {
@@ -128,9 +167,15 @@ void TRouterThread::Run() {
   assert(this);
   int tid = static_cast<int>(Gettid());
   syslog(LOG_NOTICE, "Router thread %d started", tid);
+  TEventTrace::SetThreadName("router");
 
   try {
     DoRun();
+
+    if (MetadataFetchThread.IsStarted()) {
+      MetadataFetchThread.RequestShutdown();
+      MetadataFetchThread.Join();
+    }
   } catch (const TShutdownOnDestroy &) {
     _exit(EXIT_FAILURE);
   } catch (const std::exception &x) {
@@ -176,7 +221,13 @@ void TRouterThread::Discard(TMsg::TPtr &&msg,
   assert(this);
   assert(msg);
   TMsg::TPtr to_discard(std::move(msg));
-  AnomalyTracker.TrackDiscard(to_discard, reason);
+
+  /* A flush request isn't a message from the client's point of view, so
+     don't report it as discarded. */
+  if (!to_discard->IsFlushRequest()) {
+    AnomalyTracker.TrackDiscard(to_discard, reason);
+  }
+
   MsgStateTracker.MsgEnterProcessed(*to_discard);
 }
 
@@ -208,44 +259,7 @@ void TRouterThread::Discard(std::list<std::list<TMsg::TPtr>> &&batch_list,
   MsgStateTracker.MsgEnterProcessed(to_discard);
 }
 
-bool TRouterThread::UpdateMetadataAfterTopicAutocreate(
-    const std::string &topic) {
-  assert(this);
-  size_t sleep_ms = 3000;
-  static const size_t NUM_ATTEMPTS = 3;
-
-  /* Wait a few seconds, and then update our metadata.  If metadata does not
-     yet show the new topic, wait a bit longer and try again.  If new topic
-     still does not appear after a few iterations of this, then give up. */
-  for (size_t i = 0; ; ) {
-    SleepMilliseconds(sleep_ms);
-
-    if (!HandleMetadataUpdate()) {
-      /* Shutdown delay expired during metadata update. */
-      return false;
-    }
-
-    if (Metadata->FindTopicIndex(topic) >= 0) {
-      /* Success: topic appears in new metadata */
-      return true;
-    }
-
-    if (++i == NUM_ATTEMPTS) {
-      break;
-    }
-
-    sleep_ms *= 2;
-    syslog(LOG_INFO, "Newly created topic [%s] does not yet appear in "
-           "metadata: will fetch metadata again in %d milliseconds",
-           topic.c_str(), static_cast<int>(sleep_ms));
-  }
-
-  syslog(LOG_WARNING, "Newly created topic [%s] does not appear in metadata "
-         "after %d updates", topic.c_str(), static_cast<int>(NUM_ATTEMPTS));
-  return true;  // keep running
-}
-
-bool TRouterThread::AutocreateTopic(TMsg::TPtr &msg) {
+void TRouterThread::AutocreateTopic(TMsg::TPtr &&msg) {
   assert(this);
   assert(!KnownBrokers.empty());
   assert(msg);
@@ -275,17 +289,18 @@ bool TRouterThread::AutocreateTopic(TMsg::TPtr &msg) {
         Config.KafkaSocketTimeout * 1000)) {
       case TMetadataFetcher::TTopicAutocreateResult::Success: {
         syslog(LOG_NOTICE, "Automatic creation of topic [%s] was successful: "
-               "updating metadata", topic.c_str());
-
-        /* Update metadata so it shows the newly created topic. */
-        bool keep_running = UpdateMetadataAfterTopicAutocreate(topic);
-
-        if (!keep_running) {
-          /* Shutdown delay expired during metadata update. */
-          DiscardOnShutdownDuringMetadataUpdate(std::move(msg));
-        }
-
-        return keep_running;
+               "will look up its metadata in %lu milliseconds", topic.c_str(),
+               static_cast<unsigned long>(AUTOCREATE_LOOKUP_DELAY));
+
+        /* The new topic takes a few seconds to appear in metadata.  Hold the
+           message until a lookup finds the topic, and keep routing messages
+           for other topics in the meantime. */
+        TAutocreateRetry &retry = AutocreateRetries[topic];
+        retry.LookupCount = 0;
+        retry.Delay = AUTOCREATE_LOOKUP_DELAY;
+        retry.NextLookupTime = GetEpochMilliseconds() + retry.Delay;
+        MsgsAwaitingLookup[topic].push_back(std::move(msg));
+        return;
       }
       case TMetadataFetcher::TTopicAutocreateResult::Fail: {
         fail = true;
@@ -319,48 +334,252 @@ bool TRouterThread::AutocreateTopic(TMsg::TPtr &msg) {
   Discard(std::move(msg),
           TAnomalyTracker::TDiscardReason::FailedTopicAutocreate);
   DiscardOnTopicAutocreateFail.Increment();
-  return true;
 }
 
-bool TRouterThread::ValidateNewMsg(TMsg::TPtr &msg) {
+void TRouterThread::StartAutocreateLookups(uint64_t now) {
   assert(this);
-  assert(Metadata);
-  const std::string &topic = msg->GetTopic();
-  int topic_index = Metadata->FindTopicIndex(topic);
+  assert(!KnownBrokers.empty());
 
-  if (topic_index < 0) {
-    if (Config.TopicAutocreate) {
-      if (!AutocreateTopic(msg)) {
-        /* Shutdown delay expired during metadata update. */
-        assert(!msg);
-        return false;
-      }
+  for (auto &item : AutocreateRetries) {
+    TAutocreateRetry &retry = item.second;
 
-      /* On successful topic autocreate, the message will still exist.  On
-         failure, it will have been discarded. */
-      if (!msg) {
-        return true;
-      }
+    if ((retry.NextLookupTime != 0) && (now >= retry.NextLookupTime)) {
+      retry.NextLookupTime = 0;
+      ++retry.LookupCount;
+      TopicLookup.Increment();
+      syslog(LOG_INFO, "Router thread looking up metadata for newly created "
+             "topic [%s]", item.first.c_str());
+      MetadataFetchThread.RequestTopicLookup(KnownBrokers, item.first);
+    }
+  }
+}
+
+TOpt<uint64_t> TRouterThread::GetNextAutocreateLookupTime() const {
+  assert(this);
+  TOpt<uint64_t> result;
+
+  for (const auto &item : AutocreateRetries) {
+    uint64_t t = item.second.NextLookupTime;
 
-      topic_index = Metadata->FindTopicIndex(topic);
+    if ((t != 0) && (result.IsUnknown() || (t < *result))) {
+      result = t;
     }
+  }
 
-    if (topic_index < 0) {
-      if (!Config.NoLogDiscard) {
-        static TLogRateLimiter lim(std::chrono::seconds(30));
+  return result;
+}
 
-        if (lim.Test()) {
-          syslog(LOG_ERR, "Discarding message due to unknown topic: [%s]",
-                 topic.c_str());
+void TRouterThread::StartTopicLookup(TMsg::TPtr &&msg) {
+  assert(this);
+  assert(msg);
+  assert(!KnownBrokers.empty());
+  const std::string topic = msg->GetTopic();
+  KnownTopics.insert(topic);
+  MsgsAwaitingLookup[topic].push_back(std::move(msg));
+  TopicLookup.Increment();
+  syslog(LOG_INFO, "Router thread looking up metadata for new topic [%s]",
+         topic.c_str());
+  MetadataFetchThread.RequestTopicLookup(KnownBrokers, topic);
+}
+
+void TRouterThread::HandleTopicLookupResults(uint64_t now) {
+  assert(this);
+  std::vector<TMetadataFetchThread::TLookupResult> results =
+      MetadataFetchThread.TakeLookupResults();
+
+  if (ShutdownStartTime.IsKnown() && !NeedToContinueShutdown) {
+    /* The messages that were waiting for the lookups were handled when
+       ContinueShutdown() ran. */
+    assert(MsgsAwaitingLookup.empty());
+    assert(AutocreateRetries.empty());
+    return;
+  }
+
+  std::shared_ptr<TMetadata> merged;
+  std::list<TMsg::TPtr> released, not_created;
+  size_t found_count = 0;
+
+  for (const TMetadataFetchThread::TLookupResult &result : results) {
+    std::vector<std::string> found;
+
+    if (!result.Metadata) {
+      TopicLookupFail.Increment();
+      syslog(LOG_ERR, "Router thread failed to get metadata for %lu new "
+             "topics", static_cast<unsigned long>(result.Topics.size()));
+    }
+
+    for (const std::string &topic : result.Topics) {
+      bool topic_found = result.Metadata &&
+          (result.Metadata->FindTopicIndex(topic) >= 0);
+      auto retry_iter = AutocreateRetries.find(topic);
+
+      if (topic_found) {
+        found.push_back(topic);
+      } else if (retry_iter != AutocreateRetries.end()) {
+        TAutocreateRetry &retry = retry_iter->second;
+
+        if (retry.LookupCount < AUTOCREATE_LOOKUP_COUNT) {
+          /* Keep holding the messages, and look again later. */
+          retry.Delay *= 2;
+          retry.NextLookupTime = now + retry.Delay;
+          syslog(LOG_INFO, "Newly created topic [%s] does not yet appear in "
+                 "metadata: will look up again in %lu milliseconds",
+                 topic.c_str(), static_cast<unsigned long>(retry.Delay));
+          continue;
         }
+
+        syslog(LOG_WARNING, "Newly created topic [%s] does not appear in "
+               "metadata after %lu lookups", topic.c_str(),
+               static_cast<unsigned long>(retry.LookupCount));
+      } else if (result.Metadata) {
+        TopicLookupNotFound.Increment();
+        syslog(LOG_WARNING, "Metadata lookup found no topic [%s]",
+               topic.c_str());
       }
 
-      AnomalyTracker.TrackBadTopicDiscard(msg);
-      MsgStateTracker.MsgEnterProcessed(*msg);
-      DiscardBadTopicMsgOnRoute.Increment();
-      msg.reset();
-      return true;
+      auto iter = MsgsAwaitingLookup.find(topic);
+
+      if (iter != MsgsAwaitingLookup.end()) {
+        /* Messages for a topic we gave up on after creating it are discarded
+           rather than routed, since routing them would just create the topic
+           again. */
+        std::list<TMsg::TPtr> &dst = (topic_found ||
+            (retry_iter == AutocreateRetries.end())) ? released : not_created;
+        dst.splice(dst.end(), iter->second);
+        MsgsAwaitingLookup.erase(iter);
+      }
+
+      if (retry_iter != AutocreateRetries.end()) {
+        AutocreateRetries.erase(retry_iter);
+      }
+    }
+
+    if (!found.empty()) {
+      merged.reset(TMetadata::MergeTopics(merged ? *merged : *Metadata,
+          *result.Metadata, found));
+      found_count += found.size();
+    }
+  }
+
+  for (TMsg::TPtr &msg : not_created) {
+    DiscardUnknownTopicMsg(std::move(msg));
+  }
+
+  if (merged) {
+    assert(merged->SanityCheck());
+
+    /* The lookups only add topics, so a background fetch in progress is still
+       current.  Its result gets the new topics added when it arrives.
+
+       If a new topic has partitions on brokers we aren't connected to, the
+       incremental update starts connectors for them without disturbing the
+       others.  As with a refresh, the dispatcher is restarted only if it
+       can't be updated incrementally (for instance, while a failed connector
+       is waiting to be handled). */
+    size_t generation = MetadataGeneration;
+    ReplaceMetadataOnRefresh(std::move(merged));
+    MetadataGeneration = generation;
+    syslog(LOG_NOTICE, "Added metadata for %lu new topics",
+           static_cast<unsigned long>(found_count));
+  }
+
+  RouteNewMsgs(std::move(released), now);
+}
+
+std::list<TMsg::TPtr> TRouterThread::TakeMsgsAwaitingLookup() {
+  assert(this);
+  std::list<TMsg::TPtr> result;
+
+  for (auto &item : MsgsAwaitingLookup) {
+    result.splice(result.end(), item.second);
+  }
+
+  MsgsAwaitingLookup.clear();
+  AutocreateRetries.clear();
+  return std::move(result);
+}
+
+void TRouterThread::PruneKnownTopics(const TMetadata &md) {
+  assert(this);
+
+  for (auto iter = KnownTopics.begin(); iter != KnownTopics.end(); ) {
+    if ((md.FindTopicIndex(*iter) < 0) &&
+        (MsgsAwaitingLookup.count(*iter) == 0)) {
+      PruneKnownTopic.Increment();
+      iter = KnownTopics.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
+
+std::vector<std::string> TRouterThread::GetMetadataTopics() const {
+  assert(this);
+
+  if (!Config.TopicScopedMetadata) {
+    return std::vector<std::string>();
+  }
+
+  return std::vector<std::string>(KnownTopics.begin(), KnownTopics.end());
+}
+
+void TRouterThread::DiscardUnknownTopicMsg(TMsg::TPtr &&msg) {
+  assert(this);
+  assert(msg);
+
+  if (!Config.NoLogDiscard) {
+    static TLogRateLimiter lim(std::chrono::seconds(30));
+
+    if (lim.Test()) {
+      syslog(LOG_ERR, "Discarding message due to unknown topic: [%s]",
+             msg->GetTopic().c_str());
+    }
+  }
+
+  AnomalyTracker.TrackBadTopicDiscard(msg);
+  MsgStateTracker.MsgEnterProcessed(*msg);
+  DiscardBadTopicMsgOnRoute.Increment();
+  msg.reset();
+}
+
+void TRouterThread::ValidateNewMsg(TMsg::TPtr &msg) {
+  assert(this);
+  assert(Metadata);
+  const std::string &topic = msg->GetTopic();
+  int topic_index = Metadata->FindTopicIndex(topic);
+  auto iter = MsgsAwaitingLookup.find(topic);
+
+  if (iter != MsgsAwaitingLookup.end()) {
+    /* Wait behind earlier messages for the topic, even if a refresh has since
+       added it to our metadata. */
+    iter->second.push_back(std::move(msg));
+    return;
+  }
+
+  if (Config.TopicScopedMetadata) {
+    if ((topic_index < 0) && ShutdownStartTime.IsUnknown() &&
+        (KnownTopics.count(topic) == 0)) {
+      StartTopicLookup(std::move(msg));
+      return;
+    }
+
+    /* The topic may be in our metadata because we got metadata for all
+       topics on startup. */
+    KnownTopics.insert(topic);
+  }
+
+  if (topic_index < 0) {
+    /* During shutdown, there is no time to wait for a new topic to appear in
+       metadata. */
+    if (Config.TopicAutocreate && ShutdownStartTime.IsUnknown()) {
+      /* On success, the message waits in 'MsgsAwaitingLookup'.  On failure,
+         it is discarded. */
+      AutocreateTopic(std::move(msg));
+    } else {
+      DiscardUnknownTopicMsg(std::move(msg));
     }
+
+    return;
   }
 
   if (msg->BodyIsTruncated() ||
@@ -419,8 +638,6 @@ bool TRouterThread::ValidateNewMsg(TMsg::TPtr &msg) {
       DiscardDueToRateLimit.Increment();
     }
   }
-
-  return true;
 }
 
 void TRouterThread::ValidateBeforeReroute(std::list<TMsg::TPtr> &msg_list) {
@@ -516,11 +733,62 @@ size_t TRouterThread::ChooseAnyPartitionBrokerIndex(const std::string &topic) {
      chosen here.  The connector thread chooses a partition from all available
      partitions assigned to its broker that match the message topic.  This
      approach allows the connector thread to decide how frequently it rotates
-     through the partitions for a topic assigned to its broker. */
+     through the partitions for a topic assigned to its broker.
+
+     Unless adaptive broker selection is disabled, the round-robin choice is
+     then compared against a second broker chosen at random from the topic's
+     available partitions, and we take whichever one ComputeBrokerCost()
+     considers less loaded (the "power of two choices" technique).  This
+     steers traffic away from brokers that are slow to ACK or have a large
+     backlog, while only consulting two brokers per decision.  Ties go to the
+     round-robin choice, so with evenly loaded brokers the behavior is the
+     same as plain round-robin. */
   assert(RouteCounters.size() == topic_vec.size());
   const TMetadata::TPartition &partition =
       partition_vec[++RouteCounters[topic_index] % partition_vec.size()];
-  return partition.GetBrokerIndex();
+  size_t broker_index = partition.GetBrokerIndex();
+
+  if (Config.NoAdaptiveBrokerSelection || (partition_vec.size() < 2)) {
+    return broker_index;
+  }
+
+  std::uniform_int_distribution<size_t> dist(0, partition_vec.size() - 1);
+  size_t other_broker_index =
+      partition_vec[dist(RandomEngine)].GetBrokerIndex();
+
+  size_t choice = ChooseLessLoadedBroker(Dispatcher, ProduceRequestDataLimit,
+      broker_index, other_broker_index);
+
+  if (choice != broker_index) {
+    AdaptiveBrokerSwitch.Increment();
+  }
+
+  return choice;
+}
+
+size_t TRouterThread::ChooseStickyBrokerIndex(const TMsg &msg) {
+  assert(this);
+  assert(Metadata);
+  size_t topic_index = LookupValidTopicIndex(msg.GetTopic());
+  assert(StickyChoices.size() == Metadata->GetTopics().size());
+  TOpt<TStickyBrokerChoice> &opt_choice = StickyChoices[topic_index];
+  size_t data_size = msg.GetKeySize() + msg.GetValueSize();
+
+  if (opt_choice.IsKnown()) {
+    if (opt_choice->TryStick(Dispatcher, data_size,
+            ProduceRequestDataLimit)) {
+      return opt_choice->GetBrokerIndex();
+    }
+
+    StickyBrokerSwitch.Increment();
+  }
+
+  /* Choose the next broker in the same manner as for a batch.  Over time,
+     this balances the load across the topic's available partitions. */
+  TStickyBrokerChoice &choice = opt_choice.MakeKnown();
+  choice.Choose(Dispatcher, ChooseAnyPartitionBrokerIndex(msg.GetTopic()),
+      data_size);
+  return choice.GetBrokerIndex();
 }
 
 const TMetadata::TPartition &TRouterThread::ChoosePartitionByKey(
@@ -572,7 +840,8 @@ size_t TRouterThread::AssignBroker(TMsg::TPtr &msg) {
   /* Don't set the partition here.  For AnyPartition messages, partition
      selection is done by the connector thread, right before sending to Kafka.
    */
-  return ChooseAnyPartitionBrokerIndex(topic);
+  return Config.NoStickyPartitioning ?
+      ChooseAnyPartitionBrokerIndex(topic) : ChooseStickyBrokerIndex(*msg);
 }
 
 void TRouterThread::Route(TMsg::TPtr &&msg) {
@@ -723,18 +992,22 @@ void TRouterThread::RouteFinalMsgs() {
     RouteAnyPartitionNow(PerTopicBatcher.GetAllBatches());
   }
 
-  /* Get any remaining queued messages from the input thread. */
-  std::list<TMsg::TPtr> msg_list = MsgChannel.NonblockingGet();
-
-  bool keep_running = true;
+  /* Messages waiting for topic lookups are routed if their topics are now
+     known, and otherwise handled like messages for unknown topics.  Then get
+     any remaining queued messages from the input thread. */
+  std::list<TMsg::TPtr> msg_list = TakeMsgsAwaitingLookup();
+  msg_list.splice(msg_list.end(), MsgChannel.NonblockingGet());
 
   for (TMsg::TPtr &msg : msg_list) {
-    keep_running = ValidateNewMsg(msg);
-
-    if (!keep_running) {
-      break;
+    if (msg->IsFlushRequest()) {
+      /* Everything is about to be sent without batching anyway. */
+      MsgStateTracker.MsgEnterProcessed(*msg);
+      msg.reset();
+      continue;
     }
 
+    ValidateNewMsg(msg);
+
     if (msg) {
       DebugLogger.LogMsg(msg);
       RouteNow(std::move(msg));
@@ -742,22 +1015,11 @@ void TRouterThread::RouteFinalMsgs() {
 
     assert(!msg);
   }
-
-  if (!keep_running) {
-    /* The shutdown timeout expired while we were updating metadata after
-       automatic topic creation.  Discard all remaining messages before we shut
-       down. */
-    for (TMsg::TPtr &msg : msg_list) {
-      if (msg) {
-        DiscardOnShutdownDuringMetadataUpdate(std::move(msg));
-      }
-    }
-  }
 }
 
 void TRouterThread::DiscardFinalMsgs() {
   assert(this);
-  std::list<TMsg::TPtr> msg_list;
+  std::list<TMsg::TPtr> msg_list = TakeMsgsAwaitingLookup();
 
   /* Get any remaining queued messages from the input thread. */
   msg_list.splice(msg_list.end(), MsgChannel.NonblockingGet());
@@ -787,24 +1049,19 @@ void TRouterThread::DiscardFinalMsgs() {
 void TRouterThread::InitWireProtocol() {
   assert(this);
 
-  /* This code is just a placeholder, since Dory currently supports only
-     version 0 of the metadata and produce wire protocols.  Eventually code
-     will go here that handles cases where a specific metadata or produce
-     protocol version was not specified as a command line arg.  In this case,
-     we will probe the Kafka cluster and choose the highest version supported
-     by both Dory and the Kafka brokers. */
-  size_t metadata_api_version = Config.MetadataApiVersion.IsKnown() ?
-      *Config.MetadataApiVersion : 0;
-  std::unique_ptr<TMetadataProtocol> metadata_protocol(
-      ChooseMetadataProto(metadata_api_version));
-  assert(metadata_protocol);
+  /* If a metadata API version was not specified as a command line arg, the
+     metadata fetcher asks each broker it connects to which versions it
+     supports, and chooses the highest version supported by both Dory and the
+     broker.  Likewise, each connector negotiates a produce API version with
+     its broker.  The produce protocol created here is the default, which
+     connectors fall back to when negotiation isn't possible. */
   size_t produce_api_version = Config.ProduceApiVersion.IsKnown() ?
       *Config.ProduceApiVersion : 0;
   std::unique_ptr<TProduceProtocol> produce_protocol(
       ChooseProduceProto(produce_api_version));
   assert(produce_protocol);
 
-  MetadataFetcher.reset(new TMetadataFetcher(metadata_protocol.release()));
+  MetadataFetcher.reset(new TMetadataFetcher(Config.MetadataApiVersion));
   SingleMsgOverhead = produce_protocol->GetSingleMsgOverhead();
   Dispatcher.SetProduceProtocol(produce_protocol.release());
 }
@@ -814,20 +1071,36 @@ bool TRouterThread::Init() {
   InitWireProtocol();
   std::shared_ptr<TMetadata> meta;
 
-  syslog(LOG_NOTICE, "Router thread sending initial metadata request");
-  meta = GetInitialMetadata();
+  if (!Config.MetadataCacheFile.empty()) {
+    meta.reset(ReadMetadataCache(Config.MetadataCacheFile));
+  }
 
-  if (!meta) {
-    syslog(LOG_NOTICE, "Router thread got shutdown request while getting "
-           "initial metadata");
+  /* If we have cached metadata, start routing messages with it right away.
+     Fresh metadata will be fetched in the background once initialization is
+     finished.  If the cached metadata is out of date, errors from Kafka will
+     trigger a metadata update in the usual manner. */
+  bool use_cached_metadata = !!meta;
 
-    /* Discard any remaining queued messages from the input thread.
+  if (use_cached_metadata) {
+    UseCachedMetadata.Increment();
+    syslog(LOG_NOTICE, "Router thread using cached metadata from %s",
+           Config.MetadataCacheFile.c_str());
+  } else {
+    syslog(LOG_NOTICE, "Router thread sending initial metadata request");
+    meta = GetInitialMetadata();
+
+    if (!meta) {
+      syslog(LOG_NOTICE, "Router thread got shutdown request while getting "
+             "initial metadata");
 
-       TODO: Examine what input thread does in this case.  This may not be
-       necessary. */
-    DiscardFinalMsgs();
+      /* Discard any remaining queued messages from the input thread.
 
-    return false;
+         TODO: Examine what input thread does in this case.  This may not be
+         necessary. */
+      DiscardFinalMsgs();
+
+      return false;
+    }
   }
 
   SetMetadata(std::move(meta));
@@ -838,7 +1111,14 @@ bool TRouterThread::Init() {
 
   PauseRateLimiter.reset(new TDoryRateLimiter(Config.PauseRateLimitInitial,
       Config.PauseRateLimitMaxDouble, Config.MinPauseDelay, GetRandomNumber));
-  InitMetadataRefreshTimer();
+  MetadataFetchThread.Start();
+
+  if (use_cached_metadata) {
+    StartAsyncMetadataFetch();  // this also initializes the refresh timer
+  } else {
+    InitMetadataRefreshTimer();
+  }
+
   syslog(LOG_NOTICE, "Router thread finished initialization");
   InitFinishedSem.Push();
   return true;
@@ -855,36 +1135,49 @@ void TRouterThread::CheckDispatcherShutdown() {
   }
 }
 
-bool TRouterThread::ReplaceMetadataOnRefresh(
+bool TRouterThread::UpdateMetadataIncrementally(
+    std::shared_ptr<TMetadata> &meta) {
+  assert(this);
+  assert(meta);
+  std::list<std::list<TMsg::TPtr>> to_reroute, send_wait;
+
+  if (!Dispatcher.UpdateMetadata(meta, to_reroute, send_wait)) {
+    syslog(LOG_NOTICE, "Metadata change affects all brokers, or dispatcher "
+           "is busy: restarting dispatcher");
+    return false;
+  }
+
+  MetadataAppliedIncrementally.Increment();
+  syslog(LOG_NOTICE, "Router thread applied metadata update to running "
+         "dispatcher");
+  TrackPossibleDuplicates(to_reroute);
+  to_reroute.splice(to_reroute.end(), std::move(send_wait));
+  SetMetadata(std::move(meta), false);
+  RefreshMetadataSuccess.Increment();
+  Reroute(std::move(to_reroute));
+  InitMetadataRefreshTimer();
+  return true;
+}
+
+void TRouterThread::ReplaceMetadataOnRefresh(
     std::shared_ptr<TMetadata> &&meta) {
   assert(this);
+  assert(meta);
   std::shared_ptr<TMetadata> md = std::move(meta);
+
+  if (UpdateMetadataIncrementally(md)) {
+    return;
+  }
+
   syslog(LOG_NOTICE, "Router thread starting fast dispatcher shutdown for "
          "metadata refresh");
   Dispatcher.StartFastShutdown();
   syslog(LOG_NOTICE, "Router thread started fast dispatcher shutdown for "
          "metadata refresh");
-
-  if (!md) {
-    syslog(LOG_NOTICE, "Starting metadata fetch 2");
-    md = GetMetadata();
-    syslog(LOG_NOTICE, "Finished metadata fetch 2");
-
-    if (md) {
-      MetadataTimestamp.RecordUpdate(true);
-    }
-  }
-
   syslog(LOG_NOTICE, "Waiting for dispatcher shutdown to finish");
   CheckDispatcherShutdown();
   syslog(LOG_NOTICE, "Router thread finished waiting for dispatcher shutdown "
          "on metadata refresh");
-
-  if (!md) {
-    syslog(LOG_ERR, "Metadata fetch 2 cut short by shutdown delay expiration");
-    return false;
-  }
-
   SetMetadata(std::move(md), false);
   RefreshMetadataSuccess.Increment();
   std::list<std::list<TMsg::TPtr>> to_reroute = EmptyDispatcher();
@@ -894,41 +1187,30 @@ bool TRouterThread::ReplaceMetadataOnRefresh(
   syslog(LOG_NOTICE, "Router thread started dispatcher");
   Reroute(std::move(to_reroute));
   InitMetadataRefreshTimer();
-  return true;
 }
 
-/* Return true on success, or false if we got a shutdown signal and the
-   shutdown delay expired while trying to refresh metadata. */
-bool TRouterThread::RefreshMetadata() {
+void TRouterThread::TrackPossibleDuplicates(
+    const std::list<std::list<TMsg::TPtr>> &batch_list) {
   assert(this);
-  assert(ShutdownStartTime.IsUnknown());
-  std::shared_ptr<TMetadata> meta;
 
-  if (!Config.SkipCompareMetadataOnRefresh) {
-    syslog(LOG_INFO, "Starting metadata fetch 1");
-    meta = GetMetadata();
-    syslog(LOG_INFO, "Finished metadata fetch 1");
+  for (const std::list<TMsg::TPtr> &msg_list : batch_list) {
+    for (const TMsg::TPtr &msg : msg_list) {
+      /* We are resending a message that we previously sent but didn't get an
+         ACK for.  Track this event, since it may cause a duplicate message. */
 
-    if (!meta) {
-      syslog(LOG_ERR,
-             "Metadata fetch 1 cut short by shutdown delay expiration");
-      return false;
-    }
+      if (!Config.NoLogDiscard) {
+        static TLogRateLimiter lim(std::chrono::seconds(30));
 
-    bool unchanged = (*meta == *Metadata);
-    MetadataTimestamp.RecordUpdate(!unchanged);
+        if (lim.Test()) {
+          syslog(LOG_WARNING, "Possible duplicate message (topic: [%s])",
+                 msg->GetTopic().c_str());
+        }
+      }
 
-    if (unchanged) {
-      MetadataUnchangedOnRefresh.Increment();
-      syslog(LOG_INFO, "Metadata is unchanged on refresh");
-      InitMetadataRefreshTimer();
-      return true;
+      AnomalyTracker.TrackDuplicate(msg);
+      PossibleDuplicateMsg.Increment();
     }
-
-    MetadataChangedOnRefresh.Increment();
   }
-
-  return ReplaceMetadataOnRefresh(std::move(meta));
 }
 
 std::list<std::list<TMsg::TPtr>> TRouterThread::EmptyDispatcher() {
@@ -940,27 +1222,7 @@ std::list<std::list<TMsg::TPtr>> TRouterThread::EmptyDispatcher() {
 
   for (size_t i = 0; i < broker_count; ++i) {
     tmp = Dispatcher.GetNoAckQueueAfterShutdown(i);
-
-    for (const std::list<TMsg::TPtr> &msg_list : tmp) {
-      for (const TMsg::TPtr &msg : msg_list) {
-        /* We are resending a message that we previously sent but didn't get an
-           ACK for.  Track this event, since it may cause a duplicate message.
-         */
-
-        if (!Config.NoLogDiscard) {
-          static TLogRateLimiter lim(std::chrono::seconds(30));
-
-          if (lim.Test()) {
-            syslog(LOG_WARNING, "Possible duplicate message (topic: [%s])",
-                   msg->GetTopic().c_str());
-          }
-        }
-
-        AnomalyTracker.TrackDuplicate(msg);
-        PossibleDuplicateMsg.Increment();
-      }
-    }
-
+    TrackPossibleDuplicates(tmp);
     tmp.splice(tmp.end(), Dispatcher.GetSendWaitQueueAfterShutdown(i));
 
     if (!tmp.empty()) {
@@ -997,41 +1259,205 @@ std::list<std::list<TMsg::TPtr>> TRouterThread::EmptyDispatcher() {
   return std::move(result);
 }
 
-bool TRouterThread::RespondToPause() {
+void TRouterThread::RespondToPause() {
   assert(this);
+  assert(PendingPause != TPendingPause::Global);
   RouterThreadStartPause.Increment();
+  TEventTrace::Record(TTraceEvent::PauseStart, 0);
 
-  if (!HandlePause()) {
-    /* Shutdown delay expired while getting metadata.  The dispatcher is
-       already shut down, so we are finished. */
+  /* Impose a delay before handling a pause that occurs shortly after a
+     previous pause.  If something goes seriously wrong, this prevents us from
+     going into a tight pause loop. */
+  size_t delay = PauseRateLimiter->ComputeDelay();
+  syslog(LOG_NOTICE, "Router thread detected pause: waiting %lu milliseconds "
+         "before responding", static_cast<unsigned long>(delay));
+  SleepMilliseconds(delay);
+  PauseRateLimiter->OnAction();
 
-    std::list<std::list<TMsg::TPtr>> to_discard = EmptyDispatcher();
+  syslog(LOG_NOTICE, "Router thread shutting down dispatcher on pause");
+  Dispatcher.StartFastShutdown();
+  syslog(LOG_NOTICE, "Router thread waiting for dispatcher shutdown");
+  CheckDispatcherShutdown();
 
-    for (const std::list<TMsg::TPtr> &msg_list : to_discard) {
-      assert(!msg_list.empty());
+  if (PendingPause == TPendingPause::Scoped) {
+    /* The dispatcher restart that finishes this pause also takes care of the
+       failed connectors. */
+    syslog(LOG_NOTICE, "Pause replaces scoped pause in progress");
+    TEventTrace::Record(TTraceEvent::PauseEnd, 1);
+  }
+
+  /* There are no connectors to route to until we get metadata and restart
+     the dispatcher, so DoRun() holds new messages in the meantime.  It still
+     watches for a shutdown request, and for expiration of the shutdown delay
+     if one is in progress. */
+  syslog(LOG_NOTICE, "Router thread requesting metadata in response to "
+         "pause");
+  PendingPause = TPendingPause::Global;
+  PauseStallStartTime = GetMonotonicRawMilliseconds();
+  StartPauseMetadataFetch();
+}
 
-      if (!Config.NoLogDiscard) {
-        static TLogRateLimiter lim(std::chrono::seconds(30));
+void TRouterThread::FinishPause(std::shared_ptr<TMetadata> &&meta) {
+  assert(this);
+  assert(meta);
+  assert(PendingPause == TPendingPause::Global);
+  PendingPause = TPendingPause::None;
+  MetadataTimestamp.RecordStall(
+      GetMonotonicRawMilliseconds() - PauseStallStartTime);
+  SetMetadata(std::move(meta));
+  syslog(LOG_NOTICE, "Router thread got metadata in response to pause: "
+         "starting dispatcher");
+  std::list<std::list<TMsg::TPtr>> to_reroute = EmptyDispatcher();
+  Dispatcher.Start(Metadata);
+  syslog(LOG_NOTICE, "Router thread started new dispatcher");
+  Reroute(std::move(to_reroute));
 
-        if (lim.Test()) {
-          syslog(LOG_ERR, "Router thread discarding message with topic [%s] "
-                 "on shutdown delay expiration during pause",
-          msg_list.front()->GetTopic().c_str());
-        }
-      }
-    }
-
-    Discard(std::move(to_discard),
-            TAnomalyTracker::TDiscardReason::ServerShutdown);
-    return false;
+  /* If we got a shutdown request while waiting for metadata, ContinueShutdown()
+     forwards it to the new dispatcher on the next pass through the main loop.
+     If the shutdown was already in progress before the pause, resend it here.
+     The dispatcher gets the original start time, and therefore sets its
+     deadline correctly. */
+  if (ShutdownStartTime.IsKnown() && !NeedToContinueShutdown) {
+    syslog(LOG_NOTICE,
+           "Router thread resending shutdown request to restarted dispatcher");
+    Dispatcher.StartSlowShutdown(*ShutdownStartTime);
+    syslog(LOG_NOTICE,
+           "Router thread resent shutdown request to restarted dispatcher");
   }
 
-  /* We successfully handled the pause.  Since we just got metadata, restart
-     the metadata refresh timer. */
+  /* We just got metadata, so restart the metadata refresh timer. */
   InitMetadataRefreshTimer();
 
   RouterThreadFinishPause.Increment();
-  return true;
+  TEventTrace::Record(TTraceEvent::PauseEnd, 0);
+}
+
+void TRouterThread::HandleConnectorFailure() {
+  assert(this);
+  assert(!ScopedPauseTimer);
+
+  if (ShutdownStartTime.IsKnown()) {
+    /* Handling a scoped pause during a slow shutdown is not worth the extra
+       complexity.  Fall back to a global pause, which restarts the dispatcher
+       and resends the shutdown request. */
+    syslog(LOG_NOTICE, "Router thread handling scoped pause as global pause "
+           "during shutdown");
+    RespondToPause();
+    return;
+  }
+
+  RouterThreadStartScopedPause.Increment();
+  TEventTrace::Record(TTraceEvent::PauseStart, 1);
+
+  /* As with a global pause, impose a delay before responding.  Use a timer
+     rather than sleeping, so we keep routing messages to the brokers that are
+     still healthy in the meantime. */
+  size_t delay = PauseRateLimiter->ComputeDelay();
+  syslog(LOG_NOTICE, "Router thread detected scoped pause: waiting %lu "
+         "milliseconds before responding", static_cast<unsigned long>(delay));
+  ScopedPauseTimer.reset(new TTimerFd(std::max<size_t>(delay, 1)));
+}
+
+void TRouterThread::RespondToScopedPause() {
+  assert(this);
+  ScopedPauseTimer.reset();
+
+  if (ShutdownStartTime.IsKnown()) {
+    /* The shutdown started while we were waiting on the timer.  See
+       HandleConnectorFailure(). */
+    syslog(LOG_NOTICE, "Router thread handling scoped pause as global pause "
+           "during shutdown");
+    TEventTrace::Record(TTraceEvent::PauseEnd, 1);
+    RespondToPause();
+    return;
+  }
+
+  PauseRateLimiter->OnAction();
+  size_t failed_count = Dispatcher.JoinFailedConnectors();
+
+  if (failed_count == 0) {
+    /* The dispatcher was restarted for some other reason (for instance, a
+       metadata refresh) after the failure was detected. */
+    syslog(LOG_NOTICE, "Router thread found no failed connectors to restart "
+           "on scoped pause");
+    RouterThreadFinishScopedPause.Increment();
+    TEventTrace::Record(TTraceEvent::PauseEnd, 1);
+    return;
+  }
+
+  /* Keep routing messages while we wait for metadata.  The connectors that
+     didn't fail keep sending, and messages for the failed ones wait in their
+     queues until FinishScopedPause() reroutes them. */
+  syslog(LOG_NOTICE, "Router thread requesting metadata in response to "
+         "scoped pause for %lu connectors",
+         static_cast<unsigned long>(failed_count));
+  PendingPause = TPendingPause::Scoped;
+  StartPauseMetadataFetch();
+}
+
+void TRouterThread::FinishScopedPause(std::shared_ptr<TMetadata> &&meta) {
+  assert(this);
+  assert(meta);
+  assert(PendingPause == TPendingPause::Scoped);
+  PendingPause = TPendingPause::None;
+  bool unchanged = (*meta == *Metadata);
+  MetadataTimestamp.RecordUpdate(!unchanged);
+
+  if (unchanged) {
+    /* The other connectors are still running, so this only gets the messages
+       left behind by the failed ones. */
+    std::list<std::list<TMsg::TPtr>> to_reroute = EmptyDispatcher();
+    Dispatcher.RestartFailedConnectors();
+    syslog(LOG_NOTICE, "Router thread restarted failed connectors with "
+           "unchanged metadata");
+    Reroute(std::move(to_reroute));
+  } else {
+    /* Partitions may have moved between brokers, so everything must be
+       rerouted.  The failed connectors have already been joined, and the
+       dispatcher will get their messages along with everything else. */
+    syslog(LOG_NOTICE, "Metadata changed on scoped pause: restarting "
+           "dispatcher");
+    ReplaceMetadataOnRefresh(std::move(meta));
+  }
+
+  RouterThreadFinishScopedPause.Increment();
+  TEventTrace::Record(TTraceEvent::PauseEnd, 1);
+}
+
+void TRouterThread::StartPauseMetadataFetch() {
+  assert(this);
+  assert(PendingPause != TPendingPause::None);
+
+  /* A background fetch already in progress may have started before the
+     pause, so make its result stale.  The fetch thread does another fetch
+     for this request once the current one finishes. */
+  ++MetadataGeneration;
+  AsyncFetchTopics = GetMetadataTopics();
+  MetadataFetchThread.RequestFetch(KnownBrokers, AsyncFetchTopics,
+      MetadataGeneration);
+  AsyncMetadataFetchInProgress = true;
+}
+
+void TRouterThread::AbandonPendingPause() {
+  assert(this);
+  assert(PendingPause != TPendingPause::None);
+  syslog(LOG_NOTICE, "Shutdown delay expired while getting metadata for "
+         "pause");
+
+  if (PendingPause == TPendingPause::Scoped) {
+    /* For a global pause, RespondToPause() already shut down the
+       dispatcher. */
+    Dispatcher.StartFastShutdown();
+    CheckDispatcherShutdown();
+  } else {
+    MetadataTimestamp.RecordStall(
+        GetMonotonicRawMilliseconds() - PauseStallStartTime);
+  }
+
+  DiscardOnShutdownDuringMetadataUpdate(EmptyDispatcher());
+  TEventTrace::Record(TTraceEvent::PauseEnd,
+      (PendingPause == TPendingPause::Scoped) ? 1 : 0);
+  PendingPause = TPendingPause::None;
 }
 
 void TRouterThread::DiscardOnShutdownDuringMetadataUpdate(TMsg::TPtr &&msg) {
@@ -1070,7 +1496,7 @@ void TRouterThread::DiscardOnShutdownDuringMetadataUpdate(
   }
 }
 
-bool TRouterThread::HandleMetadataUpdate() {
+void TRouterThread::StartAsyncMetadataFetch() {
   assert(this);
 
   if (MetadataUpdateRequestSem.GetFd().IsReadable()) {
@@ -1079,18 +1505,109 @@ bool TRouterThread::HandleMetadataUpdate() {
            "update request");
   }
 
+  /* Rearm the timer now, so it doesn't keep firing while the fetch is in
+     progress. */
+  InitMetadataRefreshTimer();
+
+  if (AsyncMetadataFetchInProgress) {
+    syslog(LOG_INFO, "Background metadata fetch already in progress");
+    return;
+  }
+
   StartRefreshMetadata.Increment();
-  bool keep_running = true;
+  syslog(LOG_INFO, "Router thread starting background metadata fetch");
+  AsyncFetchTopics = GetMetadataTopics();
+  MetadataFetchThread.RequestFetch(KnownBrokers, AsyncFetchTopics,
+      MetadataGeneration);
+  AsyncMetadataFetchInProgress = true;
+}
 
-  if (!RefreshMetadata()) {
-    /* Shutdown delay expired while getting metadata.  The dispatcher is
-       already shut down, so we are finished. */
-    DiscardOnShutdownDuringMetadataUpdate(EmptyDispatcher());
-    keep_running = false;
+void TRouterThread::HandleAsyncMetadataResult() {
+  assert(this);
+  std::shared_ptr<TMetadata> meta;
+
+  if (!MetadataFetchThread.TakeResult(MetadataGeneration, meta)) {
+    return;  // result was already taken
+  }
+
+  if (!meta && (PendingPause != TPendingPause::None)) {
+    /* The fetch for the pause is still to come. */
+    syslog(LOG_INFO, "Router thread ignoring background metadata fetch "
+           "result, since it was requested before pause");
+    return;
+  }
+
+  AsyncMetadataFetchInProgress = false;
+
+  if (meta) {
+    UpdateKnownBrokers(*meta);
+  }
+
+  switch (PendingPause) {
+    case TPendingPause::None: {
+      break;
+    }
+    case TPendingPause::Global: {
+      FinishPause(std::move(meta));
+      return;
+    }
+    case TPendingPause::Scoped: {
+      FinishScopedPause(std::move(meta));
+      return;
+    }
+    NO_DEFAULT_CASE;
   }
 
   FinishRefreshMetadata.Increment();
-  return keep_running;
+
+  if (!meta) {
+    syslog(LOG_INFO, "Router thread ignoring background metadata fetch "
+           "result, since metadata was replaced during fetch");
+    return;
+  }
+
+  if (ShutdownStartTime.IsKnown()) {
+    syslog(LOG_INFO, "Router thread ignoring background metadata fetch "
+           "result during shutdown");
+    return;
+  }
+
+  if (!AsyncFetchTopics.empty()) {
+    /* Keep topics that were looked up after we requested the fetch, since
+       the result doesn't have them. */
+    std::unordered_set<std::string> requested(AsyncFetchTopics.begin(),
+        AsyncFetchTopics.end());
+    std::vector<std::string> looked_up;
+
+    for (const std::string &topic : KnownTopics) {
+      if (requested.count(topic) == 0) {
+        looked_up.push_back(topic);
+      }
+    }
+
+    if (!looked_up.empty()) {
+      meta.reset(TMetadata::MergeTopics(*meta, *Metadata, looked_up));
+    }
+
+    PruneKnownTopics(*meta);
+  }
+
+  if (!Config.SkipCompareMetadataOnRefresh) {
+    bool unchanged = (*meta == *Metadata);
+    MetadataTimestamp.RecordUpdate(!unchanged);
+
+    if (unchanged) {
+      MetadataUnchangedOnRefresh.Increment();
+      syslog(LOG_INFO, "Metadata is unchanged on refresh");
+      return;
+    }
+
+    MetadataChangedOnRefresh.Increment();
+  } else {
+    MetadataTimestamp.RecordUpdate(true);
+  }
+
+  ReplaceMetadataOnRefresh(std::move(meta));
 }
 
 void TRouterThread::ContinueShutdown() {
@@ -1103,6 +1620,13 @@ void TRouterThread::ContinueShutdown() {
    */
   MetadataRefreshTimer.reset();
 
+  /* A failed connector doesn't count toward the dispatcher's shutdown
+     finished notification until we have joined it, so don't make a pending
+     scoped pause wait out its full delay. */
+  if (ScopedPauseTimer) {
+    ScopedPauseTimer.reset(new TTimerFd(1));
+  }
+
   /* Get any remaining queued messages from the input thread and forward them
      to the brokers.  When the brokers get the slow shutdown message, they will
      expect to receive no more messages, and will terminate once their queues
@@ -1118,30 +1642,55 @@ void TRouterThread::ContinueShutdown() {
 
 int TRouterThread::ComputeMainLoopPollTimeout() {
   assert(this);
+  uint64_t now = GetEpochMilliseconds();
+  TOpt<uint64_t> opt_expiry;
 
-  if (OptNextBatchExpiry.IsUnknown()) {
-    return -1;  // infinite timeout
+  if (OptNextBatchExpiry.IsKnown() &&
+      (PendingPause != TPendingPause::Global)) {
+    uint64_t expiry = *OptNextBatchExpiry;
+
+    if ((expiry > now) && ((expiry - now) >
+        static_cast<uint64_t>(std::numeric_limits<int>::max()))) {
+      syslog(LOG_WARNING, "Likely bug: batch timeout is ridiculously large: "
+             "expiry %llu now %llu", static_cast<unsigned long long>(expiry),
+             static_cast<unsigned long long>(now));
+      OptNextBatchExpiry.Reset();
+      OptNextBatchExpiry.MakeKnown(now);
+      return 0;
+    }
+
+    opt_expiry = expiry;
   }
 
-  uint64_t expiry = *OptNextBatchExpiry;
-  uint64_t now = GetEpochMilliseconds();
+  TOpt<uint64_t> opt_lookup_time = GetNextAutocreateLookupTime();
 
-  if (expiry <= now) {
-    return 0;
+  if (opt_lookup_time.IsKnown() &&
+      (opt_expiry.IsUnknown() || (*opt_lookup_time < *opt_expiry))) {
+    opt_expiry = *opt_lookup_time;
   }
 
-  uint64_t delta = expiry - now;
+  if ((PendingPause != TPendingPause::None) && ShutdownStartTime.IsKnown()) {
+    /* Wake up when the shutdown delay expires, so we can give up waiting for
+       metadata. */
+    uint64_t deadline = *ShutdownStartTime + Config.ShutdownMaxDelay;
 
-  if (delta > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
-    syslog(LOG_WARNING, "Likely bug: batch timeout is ridiculously large: "
-           "expiry %llu now %llu", static_cast<unsigned long long>(expiry),
-           static_cast<unsigned long long>(now));
-    OptNextBatchExpiry.Reset();
-    OptNextBatchExpiry.MakeKnown(now);
+    if (opt_expiry.IsUnknown() || (deadline < *opt_expiry)) {
+      opt_expiry = deadline;
+    }
+  }
+
+  if (opt_expiry.IsUnknown()) {
+    return -1;  // infinite timeout
+  }
+
+  uint64_t expiry = *opt_expiry;
+
+  if (expiry <= now) {
     return 0;
   }
 
-  return delta;
+  return static_cast<int>(std::min<uint64_t>(expiry - now,
+      static_cast<uint64_t>(std::numeric_limits<int>::max())));
 }
 
 void TRouterThread::InitMainLoopPollArray() {
@@ -1157,14 +1706,28 @@ void TRouterThread::InitMainLoopPollArray() {
       MainLoopPollArray[TMainLoopPollItem::MdRefresh];
   struct pollfd &shutdown_finished_item =
       MainLoopPollArray[TMainLoopPollItem::ShutdownFinished];
+  struct pollfd &connector_failure_item =
+      MainLoopPollArray[TMainLoopPollItem::ConnectorFailure];
+  struct pollfd &scoped_pause_item =
+      MainLoopPollArray[TMainLoopPollItem::ScopedPause];
+  struct pollfd &md_fetch_result_item =
+      MainLoopPollArray[TMainLoopPollItem::MdFetchResult];
+  struct pollfd &topic_lookup_result_item =
+      MainLoopPollArray[TMainLoopPollItem::TopicLookupResult];
   bool shutdown_started = ShutdownStartTime.IsKnown();
-  pause_item.fd = Dispatcher.GetPauseFd();
+
+  /* While waiting for metadata to finish a pause, watch only for events that
+     don't involve restarting the dispatcher.  After a global pause, the
+     dispatcher is shut down, so also stop routing messages. */
+  bool pause_pending = (PendingPause != TPendingPause::None);
+  bool global_pause_pending = (PendingPause == TPendingPause::Global);
+  pause_item.fd = global_pause_pending ? -1 : int(Dispatcher.GetPauseFd());
   pause_item.events = POLLIN;
   pause_item.revents = 0;
   shutdown_request_item.fd = GetShutdownRequestFd();
   shutdown_request_item.events = POLLIN;
   shutdown_request_item.revents = 0;
-  msg_available_item.fd = shutdown_started ?
+  msg_available_item.fd = (shutdown_started || global_pause_pending) ?
       -1 : int(MsgChannel.GetMsgAvailableFd());
   msg_available_item.events = POLLIN;
   msg_available_item.revents = 0;
@@ -1175,10 +1738,29 @@ void TRouterThread::InitMainLoopPollArray() {
       -1 : int(MetadataRefreshTimer->GetFd());
   md_refresh_item.events = POLLIN;
   md_refresh_item.revents = 0;
-  shutdown_finished_item.fd = shutdown_started ?  
+  shutdown_finished_item.fd = (shutdown_started && !pause_pending) ?
       int(Dispatcher.GetShutdownWaitFd()) : -1;
   shutdown_finished_item.events = POLLIN;
   shutdown_finished_item.revents = 0;
+
+  /* While a scoped pause is waiting on its timer, stop watching for connector
+     failures.  Any that occur in the meantime will be handled when the timer
+     expires. */
+  connector_failure_item.fd = (ScopedPauseTimer || pause_pending) ?
+      -1 : int(Dispatcher.GetConnectorFailureFd());
+  connector_failure_item.events = POLLIN;
+  connector_failure_item.revents = 0;
+  scoped_pause_item.fd = (ScopedPauseTimer && !pause_pending) ?
+      int(ScopedPauseTimer->GetFd()) : -1;
+  scoped_pause_item.events = POLLIN;
+  scoped_pause_item.revents = 0;
+  md_fetch_result_item.fd = MetadataFetchThread.GetResultFd();
+  md_fetch_result_item.events = POLLIN;
+  md_fetch_result_item.revents = 0;
+  topic_lookup_result_item.fd = pause_pending ?
+      -1 : int(MetadataFetchThread.GetLookupResultFd());
+  topic_lookup_result_item.events = POLLIN;
+  topic_lookup_result_item.revents = 0;
 }
 
 void TRouterThread::DoRun() {
@@ -1192,7 +1774,9 @@ void TRouterThread::DoRun() {
   }
 
   for (; ; ) {
-    if (NeedToContinueShutdown) {
+    /* A shutdown request that arrives while a pause is waiting for metadata
+       is forwarded to the dispatcher once the pause is finished. */
+    if (NeedToContinueShutdown && (PendingPause == TPendingPause::None)) {
       ContinueShutdown();
     }
 
@@ -1213,31 +1797,67 @@ void TRouterThread::DoRun() {
       break;
     }
 
-    if (MainLoopPollArray[TMainLoopPollItem::Pause].revents &&
-        !RespondToPause()) {
-      break;  // shutdown delay expired during pause
+    if (MainLoopPollArray[TMainLoopPollItem::Pause].revents) {
+      RespondToPause();
+    }
+
+    /* Below, skip events that were seen before a pause started waiting for
+       metadata.  See InitMainLoopPollArray(). */
+    if (MainLoopPollArray[TMainLoopPollItem::ConnectorFailure].revents &&
+        (PendingPause == TPendingPause::None)) {
+      HandleConnectorFailure();
+    }
+
+    if (MainLoopPollArray[TMainLoopPollItem::ScopedPause].revents &&
+        (PendingPause == TPendingPause::None)) {
+      RespondToScopedPause();
     }
 
     if ((MainLoopPollArray[TMainLoopPollItem::MdUpdateRequest].revents ||
-         MainLoopPollArray[TMainLoopPollItem::MdRefresh].revents) &&
-        !HandleMetadataUpdate()) {
-      break;  // shutdown delay expired during metadata update
+         MainLoopPollArray[TMainLoopPollItem::MdRefresh].revents)) {
+      StartAsyncMetadataFetch();
+    }
+
+    if (MainLoopPollArray[TMainLoopPollItem::MdFetchResult].revents) {
+      HandleAsyncMetadataResult();
     }
 
     uint64_t now = GetEpochMilliseconds();
 
+    if ((PendingPause != TPendingPause::None) && ShutdownStartTime.IsKnown() &&
+        (now >= (*ShutdownStartTime + Config.ShutdownMaxDelay))) {
+      AbandonPendingPause();
+      break;  // shutdown delay expired while getting metadata for pause
+    }
+
+    if (MainLoopPollArray[TMainLoopPollItem::TopicLookupResult].revents &&
+        (PendingPause == TPendingPause::None)) {
+      HandleTopicLookupResults(now);
+    }
+
+    if (!AutocreateRetries.empty()) {
+      StartAutocreateLookups(now);
+    }
+
     if (OptNextBatchExpiry.IsKnown() &&
+        (PendingPause != TPendingPause::Global) &&
         (now >= static_cast<uint64_t>(*OptNextBatchExpiry))) {
       HandleBatchExpiry(now);
     }
 
-    if (MainLoopPollArray[TMainLoopPollItem::MsgAvailable].revents) {
+    if (MainLoopPollArray[TMainLoopPollItem::MsgAvailable].revents &&
+        (PendingPause != TPendingPause::Global)) {
       HandleMsgAvailable(now);
     }
   }
 
   Discard(PerTopicBatcher.GetAllBatches(),
           TAnomalyTracker::TDiscardReason::ServerShutdown);
+
+  for (TMsg::TPtr &msg : TakeMsgsAwaitingLookup()) {
+    Discard(std::move(msg), TAnomalyTracker::TDiscardReason::ServerShutdown);
+  }
+
   OkShutdown = true;
 }
 
@@ -1285,25 +1905,94 @@ void TRouterThread::HandleBatchExpiry(uint64_t now) {
   }
 }
 
+size_t TRouterThread::GetMaxAckLatency() const {
+  assert(this);
+
+  if (!Metadata) {
+    return 0;
+  }
+
+  uint64_t max_latency = 0;
+
+  for (size_t i = 0; i < Metadata->GetBrokers().size(); ++i) {
+    max_latency = std::max(max_latency,
+        Dispatcher.GetBrokerLoad(i).AckLatency);
+  }
+
+  /* Convert microseconds to milliseconds, rounding up. */
+  return static_cast<size_t>((max_latency + 999) / 1000);
+}
+
+void TRouterThread::UpdateDeliveryEstimate() {
+  assert(this);
+
+  if (Metadata) {
+    PerTopicBatcher.SetDeliveryEstimate(GetMaxAckLatency());
+  }
+}
+
+void TRouterThread::AutoTuneBatching(uint64_t now) {
+  assert(this);
+  auto changes = BatchAutoTuner.Tune(static_cast<TMsg::TTimestamp>(now),
+      GetMaxAckLatency(), *PerTopicBatcher.GetConfig());
+
+  for (const auto &item : changes) {
+    PerTopicBatcher.SetTopicConfig(item.first, item.second);
+    BatchAutoTuneChange.Increment();
+  }
+
+  if (!changes.empty()) {
+    OptNextBatchExpiry = PerTopicBatcher.GetNextCompleteTime();
+  }
+}
+
 void TRouterThread::HandleMsgAvailable(uint64_t now) {
   assert(this);
   RouterThreadGetMsgList.Increment();
-  std::list<std::list<TMsg::TPtr>> ready_batches;
+
+  if (PerTopicBatcher.IsEnabled()) {
+    UpdateDeliveryEstimate();
+
+    if (BatchAutoTuner.IsDue(static_cast<TMsg::TTimestamp>(now))) {
+      AutoTuneBatching(now);
+    }
+  }
+
   std::list<TMsg::TPtr> msg_list = MsgChannel.Get();
+  TEventTrace::Record(TTraceEvent::RouterGetMsgs, msg_list.size());
+  RouteNewMsgs(std::move(msg_list), now);
+}
+
+void TRouterThread::RouteNewMsgs(std::list<TMsg::TPtr> &&new_msgs,
+    uint64_t now) {
+  assert(this);
+  std::list<TMsg::TPtr> msg_list(std::move(new_msgs));
+  std::list<std::list<TMsg::TPtr>> ready_batches;
   std::list<TMsg::TPtr> remaining;
-  bool keep_running = true;
 
   for (auto iter = msg_list.begin(), next = iter;
        iter != msg_list.end();
        iter = next) {
     ++next;
     TMsg::TPtr &msg_ptr = *iter;
-    keep_running = ValidateNewMsg(msg_ptr);
 
-    if (!keep_running) {
-      break;
+    if (msg_ptr->IsFlushRequest()) {
+      /* Route the messages that preceded the request first, so that the
+         flush applies to them. */
+      RouteAnyPartitionNow(std::move(ready_batches));
+      ready_batches.clear();
+
+      for (TMsg::TPtr &remaining_ptr : remaining) {
+        Route(std::move(remaining_ptr));
+      }
+
+      remaining.clear();
+      HandleFlushRequest(std::move(msg_ptr));
+      continue;
     }
 
+    ValidateNewMsg(msg_ptr);
+
     if (!msg_ptr) {
       continue;
     }
@@ -1317,6 +2006,12 @@ void TRouterThread::HandleMsgAvailable(uint64_t now) {
     if ((msg_ptr->GetRoutingType() == TMsg::TRoutingType::AnyPartition) &&
         PerTopicBatcher.IsEnabled()) {
       TMsg &msg = *msg_ptr;
+
+      if (BatchAutoTuner.IsEnabled()) {
+        BatchAutoTuner.RecordMsg(msg.GetTopic(),
+            msg.GetKeySize() + msg.GetValueSize());
+      }
+
       ready_batches.splice(ready_batches.end(),
                            PerTopicBatcher.AddMsg(std::move(msg_ptr), now));
 
@@ -1342,81 +2037,39 @@ void TRouterThread::HandleMsgAvailable(uint64_t now) {
     }
   }
 
-  if (keep_running) {
-    RouteAnyPartitionNow(std::move(ready_batches));
+  RouteAnyPartitionNow(std::move(ready_batches));
 
-    for (TMsg::TPtr &msg_ptr : remaining) {
-      Route(std::move(msg_ptr));
-    }
-  } else {
-    /* Shutdown delay expired while fetching metadata due to topic autocreate.
-       Discard all remaining messages. */
-    for (TMsg::TPtr &msg_ptr : msg_list) {
-      if (msg_ptr) {
-        DiscardOnShutdownDuringMetadataUpdate(std::move(msg_ptr));
-      }
-    }
-
-    DiscardOnShutdownDuringMetadataUpdate(std::move(remaining));
-    DiscardOnShutdownDuringMetadataUpdate(std::move(ready_batches));
+  for (TMsg::TPtr &msg_ptr : remaining) {
+    Route(std::move(msg_ptr));
   }
 }
 
-bool TRouterThread::HandlePause() {
+void TRouterThread::HandleFlushRequest(TMsg::TPtr &&msg) {
   assert(this);
+  assert(msg);
+  assert(msg->IsFlushRequest());
+  TMsg::TPtr request(std::move(msg));
+  const std::string &topic = request->GetTopic();
+  FlushRequestReceived.Increment();
 
-  /* Impose a delay before handling a pause that occurs shortly after a
-     previous pause.  If something goes seriously wrong, this prevents us from
-     going into a tight pause loop. */
-  size_t delay = PauseRateLimiter->ComputeDelay();
-  syslog(LOG_NOTICE, "Router thread detected pause: waiting %lu milliseconds "
-         "before responding", static_cast<unsigned long>(delay));
-  SleepMilliseconds(delay);
-  PauseRateLimiter->OnAction();
-
-  syslog(LOG_NOTICE, "Router thread shutting down dispatcher on pause");
-  Dispatcher.StartFastShutdown();
-  syslog(LOG_NOTICE, "Router thread waiting for dispatcher shutdown");
-  CheckDispatcherShutdown();
-  bool shutdown_previously_started = ShutdownStartTime.IsKnown();
-  syslog(LOG_NOTICE, "Router thread getting metadata in response to pause");
-  std::shared_ptr<TMetadata> meta = GetMetadata();
-
-  if (!meta) {
-    syslog(LOG_NOTICE, "Shutdown delay expired while getting metadata");
-    return false;
-  }
+  if (PerTopicBatcher.IsEnabled()) {
+    if (topic.empty()) {
+      RouteAnyPartitionNow(PerTopicBatcher.GetAllBatches());
+    } else {
+      std::list<TMsg::TPtr> batch = PerTopicBatcher.TakeTopicBatch(topic);
 
-  SetMetadata(std::move(meta));
-  syslog(LOG_NOTICE, "Router thread got metadata in response to pause: "
-         "starting dispatcher");
-  std::list<std::list<TMsg::TPtr>> to_reroute = EmptyDispatcher();
-  Dispatcher.Start(Metadata);
-  syslog(LOG_NOTICE, "Router thread started new dispatcher");
-  Reroute(std::move(to_reroute));
+      if (!batch.empty()) {
+        std::list<std::list<TMsg::TPtr>> batch_list;
+        batch_list.push_back(std::move(batch));
+        RouteAnyPartitionNow(std::move(batch_list));
+      }
+    }
 
-  if (ShutdownStartTime.IsKnown()) {
-    if (!shutdown_previously_started) {
-      /* We received the shutdown request while fetching metadata.  Get any
-         remaining queued messages from the input thread and forward them to
-         the brokers.  When the brokers get the slow shutdown message, they
-         will expect to receive no more messages, and will terminate once their
-         queues are empty or the shutdown period expires. */
-      RouteFinalMsgs();
-    }
-
-    /* Notify the dispatcher that a slow shutdown is in progress.  If the
-       shutdown was already in progress before the pause, the dispatcher will
-       get the original start time, and therefore set its deadline correctly.
-     */
-    syslog(LOG_NOTICE,
-           "Router thread resending shutdown request to restarted dispatcher");
-    Dispatcher.StartSlowShutdown(*ShutdownStartTime);
-    syslog(LOG_NOTICE,
-           "Router thread resent shutdown request to restarted dispatcher");
+    OptNextBatchExpiry = PerTopicBatcher.GetNextCompleteTime();
   }
 
-  return true;
+  Dispatcher.Flush(topic);
+  MsgStateTracker.MsgEnterProcessed(*request);
 }
 
 void TRouterThread::UpdateKnownBrokers(const TMetadata &md) {
@@ -1434,52 +2087,12 @@ void TRouterThread::UpdateKnownBrokers(const TMetadata &md) {
 std::shared_ptr<TMetadata> TRouterThread::TryGetMetadata() {
   assert(this);
   assert(!KnownBrokers.empty());
-  TMetadataFetcher::TDisconnecter disconnecter(*MetadataFetcher);
-  size_t chosen = std::rand() % KnownBrokers.size();
-  std::shared_ptr<TMetadata> result;
-
-  for (size_t i = 0;
-       i < KnownBrokers.size();
-       chosen = ((chosen + 1) % KnownBrokers.size()), ++i) {
-    const TKafkaBroker &broker = KnownBrokers[chosen];
-    syslog(LOG_INFO, "Router thread getting metadata from broker %s port %d",
-           broker.Host.c_str(), static_cast<int>(broker.Port));
-
-    if (!MetadataFetcher->Connect(broker.Host, broker.Port)) {
-      ConnectFailOnTryGetMetadata.Increment();
-      syslog(LOG_ERR, "Router thread failed to connect to broker for "
-             "metadata");
-      continue;
-    }
-
-    ConnectSuccessOnTryGetMetadata.Increment();
-    result = std::move(
-        MetadataFetcher->Fetch(Config.KafkaSocketTimeout * 1000));
-
-    if (result) {
-      break;  // success
-    }
-
-    /* Failed to get metadata: try next broker. */
-    syslog(LOG_ERR, "Router thread did not get valid metadata response from "
-           "broker");
-  }
-
-  bool success = false;
+  syslog(LOG_INFO, "Router thread getting metadata");
+  std::shared_ptr<TMetadata> result = HedgedMetadataFetcher.Fetch(
+      KnownBrokers, GetMetadataTopics(), Config.KafkaSocketTimeout * 1000);
 
   if (result) {
-    if (result->SanityCheck()) {
-      success = true;
-      syslog(LOG_INFO, "Metadata sanity check passed");
-      UpdateKnownBrokers(*result);
-    } else {
-      syslog(LOG_ERR, "Metadata sanity check failed!!!");
-      result.reset();
-      assert(false);
-    }
-  }
-
-  if (success) {
+    UpdateKnownBrokers(*result);
     GetMetadataSuccess.Increment();
   } else {
     GetMetadataFail.Increment();
@@ -1524,107 +2137,6 @@ std::shared_ptr<TMetadata> TRouterThread::GetInitialMetadata() {
   return std::move(result);
 }
 
-std::shared_ptr<TMetadata> TRouterThread::GetMetadataBeforeSlowShutdown() {
-  assert(this);
-  std::shared_ptr<TMetadata> result;
-  TDoryRateLimiter retry_rate_limiter(Config.PauseRateLimitInitial,
-      Config.PauseRateLimitMaxDouble, Config.MinPauseDelay, GetRandomNumber);
-
-  /* A slow shutdown is not currently in progress, so we will watch for a
-     shutdown notification while attempting to get metadata. */
-  const TFd &shutdown_request_fd = GetShutdownRequestFd();
-
-  for (; ; ) {
-    /* TODO: Add shutdown request monitoring inside this call. */
-    result = TryGetMetadata();
-
-    if (result) {
-      break;
-    }
-
-    size_t delay = retry_rate_limiter.ComputeDelay();
-    syslog(LOG_ERR, "Metadata request failed for all known brokers, waiting "
-           "%lu milliseconds before retry (1)",
-           static_cast<unsigned long>(delay));
-
-    if (shutdown_request_fd.IsReadable(delay)) {
-      /* We got a shutdown request while waiting to retry.  We will keep
-         trying, but must stop once the deadline has expired. */
-      StartShutdown();
-      break;
-    }
-
-    retry_rate_limiter.OnAction();
-  }
-
-  return std::move(result);
-}
-
-std::shared_ptr<TMetadata> TRouterThread::GetMetadataDuringSlowShutdown() {
-  assert(this);
-  std::shared_ptr<TMetadata> result;
-  size_t shutdown_delay = Config.ShutdownMaxDelay;
-  uint64_t finish_time = *ShutdownStartTime + shutdown_delay;
-  uint64_t now = GetEpochMilliseconds();
-
-  if (now >= finish_time) {
-    return std::move(result);  // deadline expired
-  }
-
-  TDoryRateLimiter retry_rate_limiter(Config.PauseRateLimitInitial,
-      Config.PauseRateLimitMaxDouble, Config.MinPauseDelay, GetRandomNumber);
-
-  for (; ; ) {
-    result = TryGetMetadata();
-    now = GetEpochMilliseconds();
-
-    if (now >= finish_time) {
-      result.reset();  // deadline expired
-      break;
-    }
-
-    if (result) {
-      break;
-    }
-
-    uint64_t time_left = finish_time - now;
-    size_t delay = retry_rate_limiter.ComputeDelay();
-    syslog(LOG_ERR, "Metadata request failed for all known brokers, waiting "
-           "%lu milliseconds before retry (2)",
-           static_cast<unsigned long>(delay));
-    SleepMilliseconds(delay);
-
-    if (time_left <= delay) {
-      /* Deadline expiration prevents retry. */
-      break;
-    }
-
-    retry_rate_limiter.OnAction();
-  }
-
-  return std::move(result);
-}
-
-std::shared_ptr<TMetadata> TRouterThread::GetMetadata() {
-  assert(this);
-  std::shared_ptr<TMetadata> result;
-
-  if (ShutdownStartTime.IsUnknown()) {
-    result = std::move(GetMetadataBeforeSlowShutdown());
-
-    if (result) {
-      return std::move(result);
-    }
-
-    /* We got a shutdown request while trying to get metadata.  Keep trying,
-       but stop once the deadline has expired. */
-  }
-
-  /* From here onward we handle the case where a slow shutdown is in progress.
-   */
-  return std::move(GetMetadataDuringSlowShutdown());
-}
-
 void TRouterThread::UpdateBatchStateForNewMetadata(const TMetadata &old_md,
     const TMetadata &new_md) {
   assert(this);
@@ -1637,10 +2149,17 @@ void TRouterThread::UpdateBatchStateForNewMetadata(const TMetadata &old_md,
   for (const auto &old_item : old_topic_name_map) {
     assert(old_item.second < old_topic_vec.size());
     const TMetadata::TTopic &old_topic = old_topic_vec[old_item.second];
+    int new_topic_index = new_md.FindTopicIndex(old_item.first);
 
-    if (!old_topic.GetOkPartitions().empty()) {
-      int new_topic_index = new_md.FindTopicIndex(old_item.first);
+    if (new_topic_index < 0) {
+      /* Forget any auto-tuned limits for a deleted topic.  Those for a topic
+         that is only unavailable are kept, and apply again once it has
+         available partitions. */
+      PerTopicBatcher.ClearTopicConfig(old_item.first);
+      BatchAutoTuner.DeleteTopic(old_item.first);
+    }
 
+    if (!old_topic.GetOkPartitions().empty()) {
       if (new_topic_index < 0) {
         deleted_topic_msgs.splice(deleted_topic_msgs.end(),
             PerTopicBatcher.DeleteTopic(old_item.first));
@@ -1724,11 +2243,17 @@ void TRouterThread::SetMetadata(std::shared_ptr<TMetadata> &&meta,
      is routed. */
   RouteCounters.resize(meta->GetTopics().size(), 0);
 
+  /* Broker indexes may differ in the new metadata, so start over with sticky
+     partitioning. */
+  StickyChoices.assign(meta->GetTopics().size(),
+      TOpt<TStickyBrokerChoice>());
+
   if (Metadata) {
     UpdateBatchStateForNewMetadata(*Metadata, *meta);
   }
 
   Metadata = std::move(meta);
+  ++MetadataGeneration;
   MetadataUpdated.Increment();
 
   MsgStateTracker.PruneTopics(
@@ -1749,5 +2274,13 @@ void TRouterThread::SetMetadata(std::shared_ptr<TMetadata> &&meta,
     }
   }
 
+  if (!Config.MetadataCacheFile.empty()) {
+    if (WriteMetadataCache(*Metadata, Config.MetadataCacheFile)) {
+      MetadataCacheWrite.Increment();
+    } else {
+      MetadataCacheWriteFail.Increment();
+    }
+  }
+
   TmpBrokerMap.clear();
 }
@@ -28,9 +28,11 @@
 #include <list>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <netinet/in.h>
@@ -42,8 +44,10 @@
 #include <base/opt.h>
 #include <base/timer_fd.h>
 #include <dory/anomaly_tracker.h>
+#include <dory/batch/batch_auto_tuner.h>
 #include <dory/batch/global_batch_config.h>
 #include <dory/batch/per_topic_batcher.h>
+#include <dory/broker_cost.h>
 #include <dory/conf/conf.h>
 #include <dory/conf/topic_rate_conf.h>
 #include <dory/config.h>
@@ -51,11 +55,14 @@
 #include <dory/debug/debug_setup.h>
 #include <dory/metadata_timestamp.h>
 #include <dory/metadata.h>
+#include <dory/hedged_metadata_fetcher.h>
+#include <dory/metadata_fetch_thread.h>
 #include <dory/metadata_fetcher.h>
 #include <dory/msg.h>
 #include <dory/msg_dispatch/kafka_dispatcher_api.h>
 #include <dory/msg_rate_limiter.h>
 #include <dory/msg_state_tracker.h>
+#include <dory/sticky_broker_choice.h>
 #include <dory/util/dory_rate_limiter.h>
 #include <dory/util/host_and_port.h>
 #include <dory/util/poll_array.h>
@@ -109,6 +116,12 @@ namespace Dory {
       return MetadataTimestamp;
     }
 
+    /* The web interface reports the tuner's decisions. */
+    const Batch::TBatchAutoTuner &GetBatchAutoTuner() const {
+      assert(this);
+      return BatchAutoTuner;
+    }
+
     /* Used by main thread during shutdown. */
     std::list<TMsg::TPtr> GetRemainingMsgs() {
       assert(this);
@@ -119,6 +132,36 @@ namespace Dory {
     virtual void Run() override;
 
     private:
+    /* After automatic creation of a topic, wait this many milliseconds before
+       looking up the topic, and double the wait before each lookup after
+       that. */
+    static const size_t AUTOCREATE_LOOKUP_DELAY = 3000;
+
+    /* Give up on a newly created topic if it doesn't appear after this many
+       lookups. */
+    static const size_t AUTOCREATE_LOOKUP_COUNT = 3;
+
+    /* Kind of pause waiting for metadata from 'MetadataFetchThread'. */
+    enum class TPendingPause {
+      None,
+      Global,
+      Scoped
+    };  // TPendingPause
+
+    /* State of a topic whose messages are held until the topic appears in
+       metadata after automatic creation. */
+    struct TAutocreateRetry {
+      /* Number of lookups requested so far. */
+      size_t LookupCount;
+
+      /* Milliseconds to wait before the next lookup. */
+      size_t Delay;
+
+      /* When to request the next lookup, in milliseconds since the epoch, or
+         0 while a lookup is in progress. */
+      uint64_t NextLookupTime;
+    };  // TAutocreateRetry
+
     class TShutdownOnDestroy final : public std::runtime_error {
       public:
       TShutdownOnDestroy() 
@@ -142,24 +185,56 @@ namespace Dory {
     void Discard(std::list<std::list<TMsg::TPtr>> &&batch_list,
         TAnomalyTracker::TDiscardReason reason);
 
-    bool UpdateMetadataAfterTopicAutocreate(const std::string &topic);
-
-    /* A false return value indicates that we started a metadata fetch after
-       successful automatic topic creation, and the shutdown delay expired
-       during metadata fetch.  Therefore we should terminate execution.  A true
-       return value means "keep executing".  In the above-mentioned case where
-       false is returned, or in case of topic autocreate failure, 'msg' will be
-       discarded, and empty on return.  Otherwise 'msg' retains its
-       contents. */
-    bool AutocreateTopic(TMsg::TPtr &msg);
-
-    /* A false return value indicates that we started a metadata fetch due to
-       automatic topic creation, and the shutdown delay expired during metadata
-       fetch.  Therefore we should terminate execution.  A true return value
-       means "keep executing".  In the above-mentioned case where false is
-       returned, or in case of validation failure, 'msg' will be discarded and
-       empty on return.  Otherwise 'msg' retains its contents. */
-    bool ValidateNewMsg(TMsg::TPtr &msg);
+    /* Ask a broker to create the topic of 'msg'.  On success, hold 'msg' in
+       'MsgsAwaitingLookup' until the topic appears in metadata.  The lookups
+       are done by 'MetadataFetchThread' at the times given by
+       'AutocreateRetries', so the router thread keeps routing messages for
+       other topics.  On failure, discard 'msg'. */
+    void AutocreateTopic(TMsg::TPtr &&msg);
+
+    /* Ask 'MetadataFetchThread' to look up the newly created topics in
+       'AutocreateRetries' that are due for a lookup as of 'now'. */
+    void StartAutocreateLookups(uint64_t now);
+
+    /* Return the earliest time that a lookup is due for a topic in
+       'AutocreateRetries', or nothing if no lookup is due. */
+    Base::TOpt<uint64_t> GetNextAutocreateLookupTime() const;
+
+    /* Called when topic-scoped metadata is enabled and we get a message for
+       a topic that we haven't seen before.  Add the topic to 'KnownTopics',
+       hold 'msg' in 'MsgsAwaitingLookup', and ask 'MetadataFetchThread' to
+       look up the topic.  The router thread keeps routing messages for other
+       topics while the lookup is in progress. */
+    void StartTopicLookup(TMsg::TPtr &&msg);
+
+    /* Called when 'MetadataFetchThread' has topic lookup results for us.  Add
+       the topics that were found to our metadata, and route the messages that
+       were waiting for the lookups.  A newly created topic that wasn't found
+       is looked up again later, up to AUTOCREATE_LOOKUP_COUNT times. */
+    void HandleTopicLookupResults(uint64_t now);
+
+    /* Remove and return all messages held in 'MsgsAwaitingLookup', and forget
+       about pending autocreate lookups. */
+    std::list<TMsg::TPtr> TakeMsgsAwaitingLookup();
+
+    /* Remove topics from 'KnownTopics' that 'md' doesn't have, unless a lookup
+       is in progress for them.  This keeps messages for nonexistent topics
+       from growing 'KnownTopics' without bound.  Such a topic is looked up
+       again if another message arrives for it. */
+    void PruneKnownTopics(const TMetadata &md);
+
+    /* Return the topics to request metadata for.  An empty result means "all
+       topics". */
+    std::vector<std::string> GetMetadataTopics() const;
+
+    /* Discard 'msg' because its topic doesn't exist. */
+    void DiscardUnknownTopicMsg(TMsg::TPtr &&msg);
+
+    /* In case of validation failure, 'msg' will be discarded and empty on
+       return.  If 'msg' must wait for a topic lookup (possibly after
+       automatic topic creation), it is moved to 'MsgsAwaitingLookup', and is
+       also empty on return.  Otherwise 'msg' retains its contents. */
+    void ValidateNewMsg(TMsg::TPtr &msg);
 
     void ValidateBeforeReroute(std::list<TMsg::TPtr> &msg_list);
 
@@ -178,6 +253,10 @@ namespace Dory {
 
     size_t ChooseAnyPartitionBrokerIndex(const std::string &topic);
 
+    /* Choose a broker for a single AnyPartition message using sticky
+       partitioning (see 'StickyChoices'). */
+    size_t ChooseStickyBrokerIndex(const TMsg &msg);
+
     const TMetadata::TPartition &ChoosePartitionByKey(
         const TMetadata::TTopic &topic_meta, int32_t partition_key);
 
@@ -226,13 +305,52 @@ namespace Dory {
 
     void CheckDispatcherShutdown();
 
-    bool ReplaceMetadataOnRefresh(std::shared_ptr<TMetadata> &&meta);
+    /* Try to apply new metadata 'meta' without restarting the dispatcher.
+       Return true on success, or false if the dispatcher must be restarted,
+       in which case 'meta' is left unchanged. */
+    bool UpdateMetadataIncrementally(std::shared_ptr<TMetadata> &meta);
+
+    /* Apply new metadata 'meta', restarting the dispatcher if it can't be
+       updated incrementally. */
+    void ReplaceMetadataOnRefresh(std::shared_ptr<TMetadata> &&meta);
 
-    bool RefreshMetadata();
+    /* Track messages in 'batch_list', which we previously sent but didn't get
+       an ACK for, as possible duplicates. */
+    void TrackPossibleDuplicates(
+        const std::list<std::list<TMsg::TPtr>> &batch_list);
 
     std::list<std::list<TMsg::TPtr>> EmptyDispatcher();
 
-    bool RespondToPause();
+    /* Called when the dispatcher's pause FD becomes readable.  Shut down the
+       dispatcher and ask 'MetadataFetchThread' for metadata.  FinishPause()
+       restarts the dispatcher once the metadata arrives. */
+    void RespondToPause();
+
+    /* Called with the metadata requested by RespondToPause().  Restart the
+       dispatcher using 'meta'. */
+    void FinishPause(std::shared_ptr<TMetadata> &&meta);
+
+    /* Called when a connector has shut down due to a scoped pause.  Start the
+       timer that determines when we respond. */
+    void HandleConnectorFailure();
+
+    /* Called when 'ScopedPauseTimer' expires.  Join the failed connectors and
+       ask 'MetadataFetchThread' for metadata.  Messages keep getting routed
+       to the other connectors in the meantime. */
+    void RespondToScopedPause();
+
+    /* Called with the metadata requested by RespondToScopedPause().  Restart
+       the failed connectors, or restart the whole dispatcher if the metadata
+       has changed. */
+    void FinishScopedPause(std::shared_ptr<TMetadata> &&meta);
+
+    /* Ask 'MetadataFetchThread' for metadata on behalf of the pause given by
+       'PendingPause'. */
+    void StartPauseMetadataFetch();
+
+    /* Called when the shutdown delay expires while 'PendingPause' is waiting
+       for metadata.  Shut down the dispatcher and discard its messages. */
+    void AbandonPendingPause();
 
     void DiscardOnShutdownDuringMetadataUpdate(TMsg::TPtr &&msg);
 
@@ -242,7 +360,15 @@ namespace Dory {
     void DiscardOnShutdownDuringMetadataUpdate(
         std::list<std::list<TMsg::TPtr>> &&batch_list);
 
-    bool HandleMetadataUpdate();
+    /* Ask 'MetadataFetchThread' for metadata, in response to a periodic
+       refresh or a user-initiated update request.  The router thread keeps
+       routing messages while the fetch is in progress. */
+    void StartAsyncMetadataFetch();
+
+    /* Called when 'MetadataFetchThread' has metadata for us.  If a pause is
+       waiting for the metadata, finish the pause.  Otherwise apply the
+       metadata if it has changed. */
+    void HandleAsyncMetadataResult();
 
     void ContinueShutdown();
 
@@ -256,9 +382,26 @@ namespace Dory {
 
     void HandleBatchExpiry(uint64_t now);
 
+    /* Return the worst recent ACK latency over all brokers in milliseconds,
+       rounded up. */
+    size_t GetMaxAckLatency() const;
+
+    /* Pass the worst recent ACK latency over all brokers to the per-topic
+       batcher, for topics with a latency budget. */
+    void UpdateDeliveryEstimate();
+
+    /* Apply new per-topic batching limits from 'BatchAutoTuner'. */
+    void AutoTuneBatching(uint64_t now);
+
     void HandleMsgAvailable(uint64_t now);
 
-    bool HandlePause();
+    /* Validate and route newly arrived messages in 'msg_list', or add them to
+       the per-topic batcher. */
+    void RouteNewMsgs(std::list<TMsg::TPtr> &&msg_list, uint64_t now);
+
+    /* Send all batched messages for the topic of flush request 'msg' (or
+       for all topics if the topic is empty), and consume the request. */
+    void HandleFlushRequest(TMsg::TPtr &&msg);
 
     void UpdateKnownBrokers(const TMetadata &md);
 
@@ -275,16 +418,6 @@ namespace Dory {
        improved on, but it should be good enough for now. */
     std::shared_ptr<TMetadata> GetInitialMetadata();
 
-    std::shared_ptr<TMetadata> GetMetadataBeforeSlowShutdown();
-
-    std::shared_ptr<TMetadata> GetMetadataDuringSlowShutdown();
-
-    /* Keep trying to get metadata until we succeed or get a shutdown request.
-       Returned shared_ptr contains a TMeta on success, or nothing if our
-       attempts were cut short by a shutdown request.  This behavior can
-       probably be improved on, but it should be good enough for now. */
-    std::shared_ptr<TMetadata> GetMetadata();
-
     void UpdateBatchStateForNewMetadata(const TMetadata &old_md,
         const TMetadata &new_md);
 
@@ -334,10 +467,62 @@ namespace Dory {
     /* Object responsible for getting metadata requests from brokers. */
     std::unique_ptr<TMetadataFetcher> MetadataFetcher;
 
+    /* Gets metadata from whichever known broker responds first.  Shared with
+       'MetadataFetchThread', so both benefit from the broker latency
+       information it collects. */
+    THedgedMetadataFetcher HedgedMetadataFetcher;
+
+    /* Fetches metadata in the background for periodic refreshes,
+       user-initiated updates, and pauses, and looks up new topics (including
+       those created by automatic topic creation).  The initial metadata fetch
+       on startup is done by the router thread itself, using
+       'HedgedMetadataFetcher'. */
+    TMetadataFetchThread MetadataFetchThread;
+
+    /* True while we are waiting for a result from 'MetadataFetchThread'. */
+    bool AsyncMetadataFetchInProgress;
+
+    /* Indicates whether a pause is waiting for the result of the fetch in
+       progress.  See RespondToPause() and RespondToScopedPause(). */
+    TPendingPause PendingPause;
+
+    /* When a global pause started waiting for metadata, from
+       GetMonotonicRawMilliseconds().  Nothing is routed while the pause
+       waits, so the wait is recorded as a stall in 'MetadataTimestamp'. */
+    uint64_t PauseStallStartTime;
+
+    /* Incremented each time SetMetadata() replaces our metadata, except when
+       the new metadata only adds looked-up topics, and when a pause requests
+       metadata.  Passed to 'MetadataFetchThread' with each request, so a
+       result is ignored if it was requested before a pause, or if our
+       metadata has since been replaced. */
+    size_t MetadataGeneration;
+
+    /* Topics passed to 'MetadataFetchThread' by the last call to
+       StartAsyncMetadataFetch().  Empty means "all topics". */
+    std::vector<std::string> AsyncFetchTopics;
+
     /* List of known Kafka brokers.  We pick one of these when we need to send
        a metadata request. */
     std::vector<TKafkaBroker> KnownBrokers;
 
+    /* When topic-scoped metadata is enabled, this contains all topics we have
+       gotten messages for, except those that didn't exist as of the last
+       metadata refresh.  We only request metadata for these topics, except
+       when it is empty. */
+    std::unordered_set<std::string> KnownTopics;
+
+    /* Messages held while 'MetadataFetchThread' looks up their topics.  Key
+       is topic.  A topic is present while its lookup is in progress, or while
+       it waits to appear in metadata after automatic creation, so later
+       messages for it wait behind earlier ones. */
+    std::unordered_map<std::string, std::list<TMsg::TPtr>>
+        MsgsAwaitingLookup;
+
+    /* Key is a topic that we created automatically, and whose messages are
+       held in 'MsgsAwaitingLookup' until it appears in metadata. */
+    std::unordered_map<std::string, TAutocreateRetry> AutocreateRetries;
+
     /* Metadata used for routing messages to brokers. */
     std::shared_ptr<TMetadata> Metadata;
 
@@ -348,11 +533,32 @@ namespace Dory {
        time a message for the corresponding topic is routed. */
     std::vector<size_t> RouteCounters;
 
+    /* The vector item indexes correspond to the topic indexes in the metadata.
+       Each item tracks the broker that single AnyPartition messages for the
+       topic are currently sticking to.  The connector thread likewise sticks
+       to one partition for the topic until it sends a produce request. */
+    std::vector<Base::TOpt<TStickyBrokerChoice>> StickyChoices;
+
+    /* Maximum amount of message data in a produce request.  When doing
+       sticky partitioning, this is the maximum amount of message data to
+       route to a broker before choosing another one.  It also scales the
+       backlog component of the broker cost used for adaptive broker
+       selection (see <dory/broker_cost.h>). */
+    const size_t ProduceRequestDataLimit;
+
+    /* Used for choosing a second candidate broker in
+       ChooseAnyPartitionBrokerIndex(). */
+    std::default_random_engine RandomEngine;
+
     /* Per-topic batching for AnyPartition messages is done here, before
        messages get routed to a broker.  Per-topic batching for PartitionKey
        messages is done at the broker level. */
     Batch::TPerTopicBatcher PerTopicBatcher;
 
+    /* Adjusts the limits of 'PerTopicBatcher' based on observed traffic, if
+       enabled. */
+    Batch::TBatchAutoTuner BatchAutoTuner;
+
     /* Key is broker index (not ID) and value is list of messages grouped by
        topic.  Used as temporary storage when routing messages. */
     std::unordered_map<size_t, std::list<std::list<TMsg::TPtr>>> TmpBrokerMap;
@@ -372,10 +578,14 @@ namespace Dory {
       MsgAvailable = 2,
       MdUpdateRequest = 3,
       MdRefresh = 4,
-      ShutdownFinished = 5
+      ShutdownFinished = 5,
+      ConnectorFailure = 6,
+      ScopedPause = 7,
+      MdFetchResult = 8,
+      TopicLookupResult = 9
     };  // TMainLoopPollItem
 
-    Util::TPollArray<TMainLoopPollItem, 6> MainLoopPollArray;
+    Util::TPollArray<TMainLoopPollItem, 10> MainLoopPollArray;
 
     /* This becomes known when a slow shutdown starts.  The units are
        milliseconds since the epoch. */
@@ -392,6 +602,11 @@ namespace Dory {
        pause. */
     std::unique_ptr<Util::TDoryRateLimiter> PauseRateLimiter;
 
+    /* Non-null while a scoped pause is waiting for the delay imposed by
+       'PauseRateLimiter' to expire.  Meanwhile we keep routing messages, and
+       the connectors that didn't fail keep sending. */
+    std::unique_ptr<Base::TTimerFd> ScopedPauseTimer;
+
     /* Push to tell daemon to update its metadata. */
     Base::TEventSemaphore MetadataUpdateRequestSem;
 
@@ -0,0 +1,46 @@
+/* <dory/sticky_broker_choice.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/sticky_broker_choice.h>.
+ */
+
+#include <dory/sticky_broker_choice.h>
+
+using namespace Dory;
+using namespace Dory::MsgDispatch;
+
+bool TStickyBrokerChoice::TryStick(const TKafkaDispatcherApi &dispatcher,
+    size_t data_size, size_t data_limit) {
+  assert(this);
+
+  if ((dispatcher.GetRequestsSent(BrokerIndex) != RequestsSent) ||
+      (DataSize >= data_limit)) {
+    return false;
+  }
+
+  DataSize += data_size;
+  return true;
+}
+
+void TStickyBrokerChoice::Choose(const TKafkaDispatcherApi &dispatcher,
+    size_t broker_index, size_t data_size) {
+  assert(this);
+  BrokerIndex = broker_index;
+  RequestsSent = dispatcher.GetRequestsSent(broker_index);
+  DataSize = data_size;
+}
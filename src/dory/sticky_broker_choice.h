@@ -0,0 +1,99 @@
+/* <dory/sticky_broker_choice.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for tracking the broker that AnyPartition messages for a topic are
+   currently sticking to.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <dory/msg_dispatch/kafka_dispatcher_api.h>
+
+namespace Dory {
+
+  /* Single AnyPartition messages for a topic keep going to the same broker
+     until that broker sends a produce request (or until enough data to fill
+     one has been routed to it), and only then is another broker chosen.  This
+     way the messages accumulate in one batch instead of being spread thinly
+     across all brokers.  The router thread keeps one of these per topic.
+
+     The produce request count that ends the stick is per broker, not per
+     topic: a produce request the broker sends for any topic ends the stick for
+     all topics currently sticking to it.  This is intentional.  Each produce
+     request a connector builds takes everything it has ready for all topics,
+     up to the request size limit, so once a request has gone out, the batch
+     that our topic's messages were accumulating in has most likely been sent,
+     and there is no benefit in staying with that broker. */
+  class TStickyBrokerChoice final {
+    public:
+    TStickyBrokerChoice()
+        : BrokerIndex(0),
+          RequestsSent(0),
+          DataSize(0) {
+    }
+
+    TStickyBrokerChoice(const TStickyBrokerChoice &) = default;
+
+    TStickyBrokerChoice &operator=(const TStickyBrokerChoice &) = default;
+
+    /* Index (not ID) of broker that messages for the topic currently go to.
+       Only meaningful after Choose() has been called. */
+    size_t GetBrokerIndex() const noexcept {
+      assert(this);
+      return BrokerIndex;
+    }
+
+    /* Total key and value size of messages routed to the broker since it was
+       chosen. */
+    size_t GetDataSize() const noexcept {
+      assert(this);
+      return DataSize;
+    }
+
+    /* Return true if a message whose key and value size is 'data_size' should
+       go to the current broker, in which case 'data_size' is added to the
+       amount of data routed there.  Return false if the broker has sent a
+       produce request since it was chosen, or at least 'data_limit' bytes
+       have already been routed to it.  In that case, the caller should choose
+       another broker and call Choose(). */
+    bool TryStick(const MsgDispatch::TKafkaDispatcherApi &dispatcher,
+        size_t data_size, size_t data_limit);
+
+    /* Start sticking to broker 'broker_index', with 'data_size' bytes routed
+       to it so far. */
+    void Choose(const MsgDispatch::TKafkaDispatcherApi &dispatcher,
+        size_t broker_index, size_t data_size);
+
+    private:
+    /* Index (not ID) of broker that messages for the topic currently go to. */
+    size_t BrokerIndex;
+
+    /* Value returned by dispatcher.GetRequestsSent() for the broker when we
+       chose it. */
+    uint64_t RequestsSent;
+
+    /* Total key and value size of messages routed to the broker since we
+       chose it. */
+    size_t DataSize;
+  };  // TStickyBrokerChoice
+
+}  // Dory
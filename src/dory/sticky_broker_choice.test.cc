@@ -0,0 +1,116 @@
+/* <dory/sticky_broker_choice.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/sticky_broker_choice.h>
+ */
+
+#include <dory/sticky_broker_choice.h>
+
+#include <dory/test_util/mock_kafka_dispatcher.h>
+
+#include <gtest/gtest.h>
+
+using namespace Dory;
+using namespace Dory::TestUtil;
+
+namespace {
+
+  /* The fixture for testing class TStickyBrokerChoice. */
+  class TStickyBrokerChoiceTest : public ::testing::Test {
+    protected:
+    TStickyBrokerChoiceTest() {
+    }
+
+    virtual ~TStickyBrokerChoiceTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TStickyBrokerChoiceTest
+
+  TEST_F(TStickyBrokerChoiceTest, RequestsSentTest) {
+    TMockKafkaDispatcher dispatcher;
+    dispatcher.SetRequestsSent(0, 5);
+    dispatcher.SetRequestsSent(1, 7);
+    TStickyBrokerChoice choice;
+    choice.Choose(dispatcher, 1, 10);
+    ASSERT_EQ(choice.GetBrokerIndex(), 1U);
+    ASSERT_EQ(choice.GetDataSize(), 10U);
+
+    /* No produce request sent by broker 1 yet, so we stick. */
+    ASSERT_TRUE(choice.TryStick(dispatcher, 20, 1000));
+    ASSERT_TRUE(choice.TryStick(dispatcher, 30, 1000));
+    ASSERT_EQ(choice.GetBrokerIndex(), 1U);
+    ASSERT_EQ(choice.GetDataSize(), 60U);
+
+    /* A produce request sent by some other broker doesn't matter. */
+    dispatcher.SetRequestsSent(0, 6);
+    ASSERT_TRUE(choice.TryStick(dispatcher, 40, 1000));
+    ASSERT_EQ(choice.GetDataSize(), 100U);
+
+    /* Broker 1 sends a produce request.  This may have been for a different
+       topic, since the count is per broker, but it still ends the stick. */
+    dispatcher.SetRequestsSent(1, 8);
+    ASSERT_FALSE(choice.TryStick(dispatcher, 50, 1000));
+    ASSERT_EQ(choice.GetDataSize(), 100U);
+
+    /* Choosing the same broker again picks up its current count. */
+    choice.Choose(dispatcher, 1, 50);
+    ASSERT_EQ(choice.GetDataSize(), 50U);
+    ASSERT_TRUE(choice.TryStick(dispatcher, 60, 1000));
+    ASSERT_EQ(choice.GetDataSize(), 110U);
+    dispatcher.SetRequestsSent(1, 9);
+    ASSERT_FALSE(choice.TryStick(dispatcher, 70, 1000));
+
+    choice.Choose(dispatcher, 0, 70);
+    ASSERT_EQ(choice.GetBrokerIndex(), 0U);
+    ASSERT_TRUE(choice.TryStick(dispatcher, 80, 1000));
+    dispatcher.SetRequestsSent(1, 10);
+    ASSERT_TRUE(choice.TryStick(dispatcher, 90, 1000));
+    dispatcher.SetRequestsSent(0, 7);
+    ASSERT_FALSE(choice.TryStick(dispatcher, 100, 1000));
+  }
+
+  TEST_F(TStickyBrokerChoiceTest, DataLimitTest) {
+    TMockKafkaDispatcher dispatcher;
+    TStickyBrokerChoice choice;
+    choice.Choose(dispatcher, 2, 40);
+
+    /* The limit is checked before the new message is added, so the data
+       routed to a broker may exceed the limit by up to one message. */
+    ASSERT_TRUE(choice.TryStick(dispatcher, 40, 100));
+    ASSERT_EQ(choice.GetDataSize(), 80U);
+    ASSERT_TRUE(choice.TryStick(dispatcher, 40, 100));
+    ASSERT_EQ(choice.GetDataSize(), 120U);
+    ASSERT_FALSE(choice.TryStick(dispatcher, 1, 100));
+    ASSERT_EQ(choice.GetDataSize(), 120U);
+
+    choice.Choose(dispatcher, 3, 100);
+    ASSERT_EQ(choice.GetBrokerIndex(), 3U);
+    ASSERT_FALSE(choice.TryStick(dispatcher, 1, 100));
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
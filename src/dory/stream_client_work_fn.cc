@@ -31,6 +31,7 @@
 #include <base/no_default_case.h>
 #include <dory/input_dg/input_dg_util.h>
 #include <dory/msg.h>
+#include <dory/util/event_trace.h>
 #include <dory/util/system_error_codes.h>
 #include <dory/util/time_util.h>
 #include <server/counter.h>
@@ -100,6 +101,8 @@ void TStreamClientWorkFn::operator()() {
     NewUnixClient.Increment();
   }
 
+  TEventTrace::SetThreadName(IsTcp ? "tcp_input" : "unix_stream_input");
+
   struct pollfd &sock_item = MainLoopPollArray[TMainLoopPollItem::Sock];
   struct pollfd &shutdown_item =
       MainLoopPollArray[TMainLoopPollItem::ShutdownRequest];
@@ -335,6 +338,8 @@ bool TStreamClientWorkFn::TryProcessMsgData() {
         *Pool, *AnomalyTracker, *MsgStateTracker);
 
     if (msg) {
+      TEventTrace::Record(TTraceEvent::MsgHandoff,
+          msg->GetKeyAndValue().Size());
       OutputQueue->Put(std::move(msg));
 
       if (IsTcp) {
@@ -0,0 +1,54 @@
+/* <dory/test_util/blackhole_broker.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/test_util/blackhole_broker.h>.
+ */
+
+#include <dory/test_util/blackhole_broker.h>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <base/error_utils.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::TestUtil;
+
+TBlackholeBroker::TBlackholeBroker(bool hang_connect)
+    : Sock(IfLt0(socket(AF_INET, SOCK_STREAM, 0))),
+      Port(0) {
+  struct sockaddr_in addr;
+  addr.sin_family = AF_INET;
+  addr.sin_port = 0;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  IfLt0(bind(Sock, reinterpret_cast<struct sockaddr *>(&addr),
+      sizeof(addr)));
+
+  /* With a backlog of 0, Linux queues a single connection. */
+  IfLt0(listen(Sock, hang_connect ? 0 : 16));
+  socklen_t len = sizeof(addr);
+  IfLt0(getsockname(Sock, reinterpret_cast<struct sockaddr *>(&addr), &len));
+  Port = ntohs(addr.sin_port);
+
+  if (hang_connect) {
+    QueueFiller = IfLt0(socket(AF_INET, SOCK_STREAM, 0));
+    IfLt0(connect(QueueFiller, reinterpret_cast<struct sockaddr *>(&addr),
+        sizeof(addr)));
+  }
+}
@@ -0,0 +1,77 @@
+/* <dory/test_util/blackhole_broker.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Fake Kafka broker that accepts TCP connections but never responds.
+ */
+
+#pragma once
+
+#include <cassert>
+
+#include <netinet/in.h>
+
+#include <base/fd.h>
+#include <base/no_copy_semantics.h>
+#include <dory/util/host_and_port.h>
+
+namespace Dory {
+
+  namespace TestUtil {
+
+    /* Listening socket on the loopback interface that never accepts.  The
+       kernel completes TCP handshakes on our behalf, so a request sent to
+       this "broker" is sent, but never answered.  If 'hang_connect' is true,
+       the listen queue is kept full, so the kernel drops connection requests
+       and a client's connect() hangs instead. */
+    class TBlackholeBroker final {
+      NO_COPY_SEMANTICS(TBlackholeBroker);
+
+      public:
+      explicit TBlackholeBroker(bool hang_connect = false);
+
+      in_port_t GetPort() const {
+        assert(this);
+        return Port;
+      }
+
+      Util::THostAndPort GetHostAndPort() const {
+        assert(this);
+        return Util::THostAndPort("127.0.0.1", Port);
+      }
+
+      /* Return true if a connection completes within 'timeout_ms'
+         milliseconds, or has already completed.  Not meaningful if
+         'hang_connect' was true. */
+      bool WaitForConnection(int timeout_ms) const {
+        assert(this);
+        return Sock.IsReadable(timeout_ms);
+      }
+
+      private:
+      Base::TFd Sock;
+
+      /* Connection that fills the listen queue when 'hang_connect' is true.
+       */
+      Base::TFd QueueFiller;
+
+      in_port_t Port;
+    };  // TBlackholeBroker
+
+  }  // TestUtil
+
+}  // Dory
@@ -38,9 +38,11 @@ namespace Dory {
 
       TMsgStateTracker MsgStateTracker;
 
+      /* Per-topic latency stats are enabled so tests can check them. */
       TTestMsgCreator()
           : Pool(new Capped::TPool(64, 1024 * 1024,
-                                   Capped::TPool::TSync::Mutexed)) {
+                                   Capped::TPool::TSync::Mutexed)),
+            MsgStateTracker(true) {
       }
 
       TMsg::TPtr NewMsg(const std::string &topic, const std::string &value,
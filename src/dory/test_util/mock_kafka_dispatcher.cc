@@ -24,21 +24,22 @@
 using namespace Base;
 using namespace Dory;
 using namespace Dory::Batch;
+using namespace Dory::Conf;
 using namespace Dory::Debug;
-using namespace Dory::KafkaProto;
 using namespace Dory::MsgDispatch;
 using namespace Dory::TestUtil;
 
 TMockKafkaDispatcher::TMockKafkaDispatcher(const TConfig &/*config*/,
-    const TWireProtocol &/*kafka_protocol*/,
+    const TCompressionConf &/*compression_conf*/,
     TMsgStateTracker &/*msg_state_tracker*/,
-    TAnomalyTracker &/*anomaly_trackeri*/,
-    const TBatchConfig &/*batch_config*/,
-    std::unordered_set<std::string> &&/*batch_topic_filter*/,
-    bool /*batch_topic_filter_exclude*/, size_t /*produce_request_data_limit*/,
+    TAnomalyTracker &/*anomaly_tracker*/,
+    const TGlobalBatchConfig &/*batch_config*/,
     const TDebugSetup &/*debug_setup*/) {
 }
 
+TMockKafkaDispatcher::TMockKafkaDispatcher() {
+}
+
 void TMockKafkaDispatcher::SetProduceProtocol(
           KafkaProto::Produce::TProduceProtocol * /*protocol*/) noexcept {
   assert(this);
@@ -77,8 +78,8 @@ void TMockKafkaDispatcher::Start(
 
 }
 
-void TMockKafkaDispatcher::Dispatch(
-    std::list<std::list<TMsg::TPtr>> &&/*batch*/, size_t /*broker_index*/) {
+void TMockKafkaDispatcher::Dispatch(TMsg::TPtr &&/*msg*/,
+    size_t /*broker_index*/) {
   assert(this);
 
 
@@ -87,9 +88,18 @@ void TMockKafkaDispatcher::Dispatch(
 
 }
 
-void TMockKafkaDispatcher::Dispatch(TMsg::TPtr &&/*msg*/,
+void TMockKafkaDispatcher::DispatchNow(TMsg::TPtr &&/*msg*/,
     size_t /*broker_index*/) {
   assert(this);
+}
+
+void TMockKafkaDispatcher::DispatchNow(
+    std::list<std::list<TMsg::TPtr>> &&/*batch*/, size_t /*broker_index*/) {
+  assert(this);
+}
+
+void TMockKafkaDispatcher::Flush(const std::string &/*topic*/) {
+  assert(this);
 
 
 
@@ -156,6 +166,49 @@ bool TMockKafkaDispatcher::ShutdownWasOk() const {
   return true;
 }
 
+const TFd &TMockKafkaDispatcher::GetConnectorFailureFd() const {
+  assert(this);
+
+
+
+
+
+  static TFd placeholder;
+  return placeholder;
+}
+
+size_t TMockKafkaDispatcher::JoinFailedConnectors() {
+  assert(this);
+
+
+
+
+
+  return 0;
+}
+
+void TMockKafkaDispatcher::RestartFailedConnectors() {
+  assert(this);
+
+
+
+
+
+}
+
+bool TMockKafkaDispatcher::UpdateMetadata(
+    const std::shared_ptr<TMetadata> &/*md*/,
+    std::list<std::list<TMsg::TPtr>> &/*no_ack*/,
+    std::list<std::list<TMsg::TPtr>> &/*send_wait*/) {
+  assert(this);
+
+
+
+
+
+  return false;
+}
+
 std::list<std::list<TMsg::TPtr>>
 TMockKafkaDispatcher::GetNoAckQueueAfterShutdown(size_t /*broker_index*/) {
   assert(this);
@@ -178,6 +231,18 @@ TMockKafkaDispatcher::GetSendWaitQueueAfterShutdown(size_t /*broker_index*/) {
   return std::list<std::list<TMsg::TPtr>>();
 }
 
+uint64_t TMockKafkaDispatcher::GetRequestsSent(size_t broker_index) const {
+  assert(this);
+  auto iter = RequestsSent.find(broker_index);
+  return (iter == RequestsSent.end()) ? 0 : iter->second;
+}
+
+TBrokerLoad TMockKafkaDispatcher::GetBrokerLoad(size_t broker_index) const {
+  assert(this);
+  auto iter = BrokerLoads.find(broker_index);
+  return (iter == BrokerLoads.end()) ? TBrokerLoad() : iter->second;
+}
+
 size_t TMockKafkaDispatcher::GetAckCount() const {
   assert(this);
 
@@ -27,15 +27,16 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <base/fd.h>
 #include <base/no_copy_semantics.h>
 #include <dory/anomaly_tracker.h>
-#include <dory/batch/batch_config.h>
+#include <dory/batch/global_batch_config.h>
+#include <dory/conf/compression_conf.h>
 #include <dory/config.h>
 #include <dory/debug/debug_setup.h>
-#include <dory/kafka_proto/wire_protocol.h>
 #include <dory/metadata.h>
 #include <dory/msg.h>
 #include <dory/msg_dispatch/kafka_dispatcher_api.h>
@@ -52,14 +53,15 @@ namespace Dory {
 
       public:
       TMockKafkaDispatcher(const TConfig &config,
-          const KafkaProto::TWireProtocol &kafka_protocol,
+          const Conf::TCompressionConf &compression_conf,
           TMsgStateTracker &msg_state_tracker,
           TAnomalyTracker &anomaly_tracker,
-          const Batch::TBatchConfig &batch_config,
-          std::unordered_set<std::string> &&batch_topic_filter,
-          bool batch_topic_filter_exclude, size_t produce_request_data_limit,
+          const Batch::TGlobalBatchConfig &batch_config,
           const Debug::TDebugSetup &debug_setup);
 
+      /* For tests that only use the broker stats methods. */
+      TMockKafkaDispatcher();
+
       virtual ~TMockKafkaDispatcher() noexcept { }
 
       void SetProduceProtocol(
@@ -71,11 +73,16 @@ namespace Dory {
 
       virtual void Start(const std::shared_ptr<TMetadata> &md) override;
 
-      virtual void Dispatch(std::list<std::list<TMsg::TPtr>> &&batch,
-                            size_t broker_index) override;
-
       virtual void Dispatch(TMsg::TPtr &&msg, size_t broker_index) override;
 
+      virtual void DispatchNow(TMsg::TPtr &&msg,
+                               size_t broker_index) override;
+
+      virtual void DispatchNow(std::list<std::list<TMsg::TPtr>> &&batch,
+                               size_t broker_index) override;
+
+      virtual void Flush(const std::string &topic) override;
+
       virtual void StartSlowShutdown(uint64_t start_time) override;
 
       virtual void StartFastShutdown() override;
@@ -88,13 +95,48 @@ namespace Dory {
 
       virtual bool ShutdownWasOk() const override;
 
+      virtual const Base::TFd &GetConnectorFailureFd() const override;
+
+      virtual size_t JoinFailedConnectors() override;
+
+      virtual void RestartFailedConnectors() override;
+
+      virtual bool UpdateMetadata(const std::shared_ptr<TMetadata> &md,
+          std::list<std::list<TMsg::TPtr>> &no_ack,
+          std::list<std::list<TMsg::TPtr>> &send_wait) override;
+
       virtual std::list<std::list<TMsg::TPtr>>
       GetNoAckQueueAfterShutdown(size_t broker_index) override;
 
       virtual std::list<std::list<TMsg::TPtr>>
       GetSendWaitQueueAfterShutdown(size_t broker_index) override;
 
+      virtual uint64_t GetRequestsSent(size_t broker_index) const override;
+
+      virtual MsgDispatch::TBrokerLoad
+      GetBrokerLoad(size_t broker_index) const override;
+
       virtual size_t GetAckCount() const override;
+
+      /* Set the value that GetRequestsSent() returns for the given broker.
+         The default is 0. */
+      void SetRequestsSent(size_t broker_index, uint64_t requests_sent) {
+        assert(this);
+        RequestsSent[broker_index] = requests_sent;
+      }
+
+      /* Set the value that GetBrokerLoad() returns for the given broker.  The
+         default is a default-constructed TBrokerLoad (no load). */
+      void SetBrokerLoad(size_t broker_index,
+          const MsgDispatch::TBrokerLoad &load) {
+        assert(this);
+        BrokerLoads[broker_index] = load;
+      }
+
+      private:
+      std::unordered_map<size_t, uint64_t> RequestsSent;
+
+      std::unordered_map<size_t, MsgDispatch::TBrokerLoad> BrokerLoads;
     };  // TMockKafkaDispatcher
 
   }  // TestUtil
@@ -36,6 +36,7 @@
 #include <base/error_utils.h>
 #include <base/gettid.h>
 #include <dory/input_dg/input_dg_util.h>
+#include <dory/util/event_trace.h>
 #include <dory/util/time_util.h>
 #include <server/counter.h>
 #include <socket/address.h>
@@ -93,6 +94,7 @@ void TUnixDgInputAgent::Run() {
   assert(this);
   int tid = static_cast<int>(Gettid());
   syslog(LOG_NOTICE, "UNIX datagram input thread %d started", tid);
+  TEventTrace::SetThreadName("unix_dg_input");
 
   try {
     OpenUnixSocket();
@@ -194,6 +196,8 @@ void TUnixDgInputAgent::ForwardMessages() {
 
     if (msg) {
       /* Forward message to router thread. */
+      TEventTrace::Record(TTraceEvent::MsgHandoff,
+          msg->GetKeyAndValue().Size());
       OutputQueue.Put(std::move(msg));
       UnixDgInputAgentForwardMsg.Increment();
     }
@@ -23,6 +23,10 @@
 #include <cassert>
 #include <cerrno>
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+
 #include <base/error_utils.h>
 #include <dory/util/connect_to_host.h>
 #include <socket/db/cursor.h>
@@ -68,3 +72,73 @@ void Dory::Util::ConnectToHost(const char *host_name, in_port_t port,
     }
   }
 }
+
+void Dory::Util::ConnectToHost(const char *host_name, in_port_t port,
+    TFd &result_socket, int timeout_ms, int cancel_fd) {
+  assert(host_name);
+  result_socket.Reset();
+
+  for (Db::TCursor csr(host_name, nullptr, AF_INET, SOCK_STREAM, 0,
+                       AI_PASSIVE);
+       csr;
+       ++csr) {
+    TAddress address = *csr;
+    address.SetPort(port);
+    TFd sock = csr.NewCompatSocket();
+
+    /* Connect in nonblocking mode, so we can wait for 'cancel_fd' and the
+       timeout while the connection is in progress. */
+    int flags = 0;
+    IfLt0(flags = fcntl(sock, F_GETFL, 0));
+    IfLt0(fcntl(sock, F_SETFL, flags | O_NONBLOCK));
+    int err = 0;
+
+    if (connect(sock, address, address.GetLen())) {
+      if (errno != EINPROGRESS) {
+        err = errno;
+      } else {
+        struct pollfd poll_array[2];
+        poll_array[0].fd = sock;
+        poll_array[0].events = POLLOUT;
+        poll_array[0].revents = 0;
+        poll_array[1].fd = cancel_fd;
+        poll_array[1].events = POLLIN;
+        poll_array[1].revents = 0;
+        int ret = 0;
+
+        /* Don't check for EINTR, since Dory's threads have signals masked. */
+        IfLt0(ret = poll(poll_array, 2, timeout_ms));
+
+        if (poll_array[1].revents) {
+          return;  // cancelled
+        }
+
+        if (ret == 0) {
+          err = ETIMEDOUT;
+        } else {
+          socklen_t len = sizeof(err);
+          IfLt0(getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len));
+        }
+      }
+    }
+
+    if (err == 0) {
+      IfLt0(fcntl(sock, F_SETFL, flags));
+      result_socket = std::move(sock);
+      break;  // success
+    }
+
+    switch (err) {
+      case ECONNREFUSED:
+      case ETIMEDOUT:
+      case EHOSTUNREACH:
+      case EHOSTDOWN: {
+        /* These errors aren't serious.  Move on to the next host. */
+        break;
+      }
+      default: {
+        ThrowSystemError(err);
+      }
+    }
+  }
+}
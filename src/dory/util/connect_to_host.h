@@ -42,6 +42,20 @@ namespace Dory {
       ConnectToHost(host_name.c_str(), port, result_socket);
     }
 
+    /* Same as above, except that each connection attempt gives up after
+       'timeout_ms' milliseconds (a negative value means "infinite timeout"),
+       and all attempts are abandoned if 'cancel_fd' becomes readable.  A
+       negative 'cancel_fd' is ignored.  Host name lookup is not affected by
+       'timeout_ms' or 'cancel_fd'. */
+    void ConnectToHost(const char *host_name, in_port_t port,
+        Base::TFd &result_socket, int timeout_ms, int cancel_fd);
+
+    inline void ConnectToHost(const std::string &host_name, in_port_t port,
+        Base::TFd &result_socket, int timeout_ms, int cancel_fd) {
+      ConnectToHost(host_name.c_str(), port, result_socket, timeout_ms,
+          cancel_fd);
+    }
+
   }  // Util
 
 }  // namespace Dory
@@ -0,0 +1,59 @@
+/* <dory/util/escape_string.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/util/escape_string.h>.
+ */
+
+#include <dory/util/escape_string.h>
+
+#include <cstdio>
+
+using namespace Dory;
+using namespace Dory::Util;
+
+void Dory::Util::WriteEscapedString(std::ostream &os, const std::string &s,
+    bool escape_control_chars) {
+  for (char c : s) {
+    switch (c) {
+      case '\\': {
+        os << "\\\\";
+        break;
+      }
+      case '"': {
+        os << "\\\"";
+        break;
+      }
+      case '\n': {
+        os << "\\n";
+        break;
+      }
+      default: {
+        if (escape_control_chars && (static_cast<unsigned char>(c) < 0x20)) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x",
+              static_cast<unsigned>(static_cast<unsigned char>(c)));
+          os << buf;
+        } else {
+          os << c;
+        }
+
+        break;
+      }
+    }
+  }
+}
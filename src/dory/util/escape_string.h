@@ -0,0 +1,42 @@
+/* <dory/util/escape_string.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Backslash escaping for strings written in text formats.
+ */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+
+namespace Dory {
+
+  namespace Util {
+
+    /* Write 's' to 'os', escaping backslash, double quote, and newline
+       characters with a backslash.  This is the escaping JSON strings and
+       OpenMetrics label values have in common.  If 'escape_control_chars' is
+       true, other characters below 0x20 are written as \u00XX escapes, as
+       JSON requires.  Otherwise they are written unchanged, since OpenMetrics
+       allows them and has no escape for them. */
+    void WriteEscapedString(std::ostream &os, const std::string &s,
+        bool escape_control_chars);
+
+  }  // Util
+
+}  // Dory
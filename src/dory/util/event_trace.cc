@@ -0,0 +1,365 @@
+/* <dory/util/event_trace.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/util/event_trace.h>.
+ */
+
+#include <dory/util/event_trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+
+#include <base/gettid.h>
+#include <base/no_default_case.h>
+#include <dory/util/json_util.h>
+
+using namespace Dory;
+using namespace Dory::Util;
+
+/* Rings of exited threads are kept until there are more than this many, so
+   that (for instance) the history of connectors that just shut down for a
+   pause is still available. */
+static const size_t MAX_RELEASED_RINGS = 16;
+
+/* Protects 'Rings' and the non-atomic fields of each ring. */
+static std::mutex RegistryMutex;
+
+static std::vector<std::unique_ptr<TTraceRing>> Rings;
+
+static size_t EventsPerThread = 0;
+
+static uint64_t NextReleaseSeq = 0;
+
+/* Tick counter value at the time Init() was called, and the corresponding
+   wall clock and monotonic clock times in microseconds.  These are used to
+   convert tick values to times. */
+static uint64_t BaseTicks = 0;
+
+static uint64_t BaseEpochUsec = 0;
+
+static uint64_t BaseMonotonicUsec = 0;
+
+bool TEventTrace::Enabled = false;
+
+thread_local TTraceRing *TEventTrace::ThreadRing = nullptr;
+
+static uint64_t ReadClockUsec(clockid_t clock) {
+  struct timespec t;
+  clock_gettime(clock, &t);
+  return (static_cast<uint64_t>(t.tv_sec) * 1000000) +
+      (static_cast<uint64_t>(t.tv_nsec) / 1000);
+}
+
+/* Returns a ring to the registry when its owning thread exits. */
+static void ReleaseRing(TTraceRing *ring) noexcept {
+  std::lock_guard<std::mutex> lock(RegistryMutex);
+  ring->InUse = false;
+  ring->ReleaseSeq = NextReleaseSeq++;
+}
+
+namespace {
+
+  struct TRingReleaser final {
+    TTraceRing *Ring = nullptr;
+
+    ~TRingReleaser() noexcept {
+      if (Ring) {
+        ReleaseRing(Ring);
+      }
+    }
+  };  // TRingReleaser
+
+}  // namespace
+
+static thread_local TRingReleaser ThreadRingReleaser;
+
+TTraceRing::TTraceRing(size_t size)
+    : Size(size),
+      Slots(new TSlot[size]),
+      Committed(0),
+      Claimed(0),
+      Tid(0),
+      InUse(false),
+      ReleaseSeq(0) {
+  assert(Size > 0);
+  Name[0] = '\0';
+}
+
+TTraceRing::~TTraceRing() noexcept {
+  delete[] Slots;
+}
+
+void TEventTrace::Init(size_t events_per_thread) {
+  std::lock_guard<std::mutex> lock(RegistryMutex);
+  EventsPerThread = events_per_thread;
+  BaseTicks = ReadTicks();
+  BaseEpochUsec = ReadClockUsec(CLOCK_REALTIME);
+  BaseMonotonicUsec = ReadClockUsec(CLOCK_MONOTONIC_RAW);
+  Enabled = (events_per_thread != 0);
+}
+
+void TEventTrace::SetThreadName(const char *name) {
+  assert(name);
+
+  if (!Enabled) {
+    return;
+  }
+
+  TTraceRing *ring = ThreadRing ? ThreadRing : AcquireRing();
+
+  if (ring) {
+    std::lock_guard<std::mutex> lock(RegistryMutex);
+    std::strncpy(ring->Name, name, sizeof(ring->Name) - 1);
+    ring->Name[sizeof(ring->Name) - 1] = '\0';
+  }
+}
+
+TTraceRing *TEventTrace::AcquireRing() noexcept {
+  assert(!ThreadRing);
+  TTraceRing *ring = nullptr;
+
+  try {
+    std::lock_guard<std::mutex> lock(RegistryMutex);
+
+    if (EventsPerThread == 0) {
+      return nullptr;
+    }
+
+    size_t released_count = 0;
+    TTraceRing *oldest = nullptr;
+
+    for (const auto &item : Rings) {
+      if (!item->InUse) {
+        ++released_count;
+
+        if ((oldest == nullptr) || (item->ReleaseSeq < oldest->ReleaseSeq)) {
+          oldest = item.get();
+        }
+      }
+    }
+
+    if (released_count >= MAX_RELEASED_RINGS) {
+      /* No thread writes to a released ring, so it is safe to reset. */
+      ring = oldest;
+      ring->Committed.store(0, std::memory_order_relaxed);
+      ring->Claimed.store(0, std::memory_order_relaxed);
+    } else {
+      Rings.emplace_back(new TTraceRing(EventsPerThread));
+      ring = Rings.back().get();
+    }
+
+    ring->Tid = static_cast<int>(Base::Gettid());
+    std::snprintf(ring->Name, sizeof(ring->Name), "thread %d", ring->Tid);
+    ring->InUse = true;
+  } catch (const std::bad_alloc &) {
+    /* Tracing is best effort.  Leave this thread untraced. */
+    return nullptr;
+  }
+
+  ThreadRing = ring;
+  ThreadRingReleaser.Ring = ring;
+  return ring;
+}
+
+namespace {
+
+  struct TEventInfo {
+    /* Name shown in the trace viewer. */
+    const char *Name;
+
+    /* Chrome trace event phase: 'B' (begin), 'E' (end), or 'i' (instant). */
+    char Phase;
+
+    /* Name of the event's argument. */
+    const char *ArgName;
+  };  // TEventInfo
+
+  struct TSnapshotEvent {
+    uint64_t Ticks;
+
+    uint64_t Word;
+  };  // TSnapshotEvent
+
+  struct TRingSnapshot {
+    std::string Name;
+
+    int Tid;
+
+    bool InUse;
+
+    std::vector<TSnapshotEvent> Events;
+  };  // TRingSnapshot
+
+}  // namespace
+
+static TEventInfo GetEventInfo(TTraceEvent event) {
+  TEventInfo info;
+
+  switch (event) {
+    case TTraceEvent::MsgHandoff: {
+      info = {"msg_handoff", 'i', "bytes"};
+      break;
+    }
+    case TTraceEvent::RouterGetMsgs: {
+      info = {"router_get_msgs", 'i', "msgs"};
+      break;
+    }
+    case TTraceEvent::BatchHandoff: {
+      info = {"batch_handoff", 'i', "broker_index"};
+      break;
+    }
+    case TTraceEvent::RequestBuilt: {
+      info = {"request_built", 'i', "bytes"};
+      break;
+    }
+    case TTraceEvent::SendStart: {
+      info = {"send", 'B', "bytes"};
+      break;
+    }
+    case TTraceEvent::SendEnd: {
+      info = {"send", 'E', "bytes"};
+      break;
+    }
+    case TTraceEvent::ResponseProcessed: {
+      info = {"response_processed", 'i', "bytes"};
+      break;
+    }
+    case TTraceEvent::PauseRequested: {
+      info = {"pause_requested", 'i', "broker"};
+      break;
+    }
+    case TTraceEvent::PauseStart: {
+      info = {"pause", 'B', "scoped"};
+      break;
+    }
+    case TTraceEvent::PauseEnd: {
+      info = {"pause", 'E', "scoped"};
+      break;
+    }
+    NO_DEFAULT_CASE;
+  }
+
+  return info;
+}
+
+/* Copy the events from 'ring', omitting any that the owning thread may have
+   overwritten while we were copying.  Caller must hold the registry mutex. */
+static void CopyRing(const TTraceRing &ring,
+    std::vector<TSnapshotEvent> &result) {
+  uint64_t committed = ring.Committed.load(std::memory_order_acquire);
+  uint64_t start = (committed > ring.Size) ? (committed - ring.Size) : 0;
+  result.clear();
+  result.reserve(committed - start);
+
+  for (uint64_t i = start; i < committed; ++i) {
+    const TTraceRing::TSlot &slot = ring.Slots[i % ring.Size];
+    result.push_back({slot.Ticks.load(std::memory_order_relaxed),
+        slot.Word.load(std::memory_order_relaxed)});
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint64_t claimed = ring.Claimed.load(std::memory_order_relaxed);
+  uint64_t valid_start = (claimed > ring.Size) ? (claimed - ring.Size) : 0;
+
+  if (valid_start > start) {
+    result.erase(result.begin(), result.begin() +
+        static_cast<std::ptrdiff_t>(
+            std::min<uint64_t>(valid_start - start, result.size())));
+  }
+}
+
+void TEventTrace::WriteChromeTraceJson(std::ostream &os) {
+  std::vector<TRingSnapshot> snapshots;
+  uint64_t base_ticks = 0;
+  uint64_t base_epoch_usec = 0;
+  uint64_t base_monotonic_usec = 0;
+  uint64_t now_ticks = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(RegistryMutex);
+    base_ticks = BaseTicks;
+    base_epoch_usec = BaseEpochUsec;
+    base_monotonic_usec = BaseMonotonicUsec;
+    now_ticks = ReadTicks();
+    snapshots.resize(Rings.size());
+
+    for (size_t i = 0; i < Rings.size(); ++i) {
+      const TTraceRing &ring = *Rings[i];
+      TRingSnapshot &snapshot = snapshots[i];
+      snapshot.Name = ring.Name;
+      snapshot.Tid = ring.Tid;
+      snapshot.InUse = ring.InUse;
+      CopyRing(ring, snapshot.Events);
+    }
+  }
+
+  /* Calibrate the tick rate against the monotonic clock over the whole time
+     since Init() was called. */
+  uint64_t elapsed_usec =
+      ReadClockUsec(CLOCK_MONOTONIC_RAW) - base_monotonic_usec;
+  double ticks_per_usec = ((elapsed_usec > 0) && (now_ticks > base_ticks)) ?
+      (static_cast<double>(now_ticks - base_ticks) /
+          static_cast<double>(elapsed_usec)) :
+      1000.0;
+  int pid = static_cast<int>(getpid());
+  char buf[64];
+  bool first_time = true;
+  os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+  for (const TRingSnapshot &snapshot : snapshots) {
+    os << (first_time ? "" : ",") << std::endl
+        << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid
+        << ", \"tid\": " << snapshot.Tid << ", \"args\": {\"name\": ";
+    WriteJsonString(os, snapshot.InUse ?
+        snapshot.Name : (snapshot.Name + " (exited)"));
+    os << "}}";
+    first_time = false;
+
+    for (const TSnapshotEvent &event : snapshot.Events) {
+      TEventInfo info =
+          GetEventInfo(static_cast<TTraceEvent>(event.Word & 0xff));
+      double offset = (event.Ticks >= base_ticks) ?
+          (static_cast<double>(event.Ticks - base_ticks) / ticks_per_usec) :
+          -(static_cast<double>(base_ticks - event.Ticks) / ticks_per_usec);
+      std::snprintf(buf, sizeof(buf), "%.3f",
+          static_cast<double>(base_epoch_usec) + offset);
+      os << "," << std::endl
+          << "  {\"name\": \"" << info.Name << "\", \"cat\": \"dory\", "
+          << "\"ph\": \"" << info.Phase << "\", ";
+
+      if (info.Phase == 'i') {
+        os << "\"s\": \"t\", ";
+      }
+
+      os << "\"ts\": " << buf << ", \"pid\": " << pid << ", \"tid\": "
+          << snapshot.Tid << ", \"args\": {\"" << info.ArgName << "\": "
+          << (event.Word >> 8) << "}}";
+    }
+  }
+
+  os << std::endl << "]}" << std::endl;
+}
@@ -0,0 +1,209 @@
+/* <dory/util/event_trace.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Low-overhead per-thread event tracing.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include <base/no_construction.h>
+#include <base/no_copy_semantics.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+namespace Dory {
+
+  namespace Util {
+
+    /* Kinds of events recorded by TEventTrace.  The meaning of each event's
+       argument is given below. */
+    enum class TTraceEvent : uint8_t {
+      /* An input thread passed a message to the router thread.  Argument is
+         the size of the message's key and value. */
+      MsgHandoff,
+
+      /* The router thread got messages from the input threads.  Argument is
+         the message count. */
+      RouterGetMsgs,
+
+      /* The router thread passed a batch to the dispatcher.  Argument is the
+         broker index. */
+      BatchHandoff,
+
+      /* A connector built a produce request.  Argument is the request size in
+         bytes. */
+      RequestBuilt,
+
+      /* A connector started and finished sending a produce request.
+         Argument is the request size in bytes. */
+      SendStart,
+      SendEnd,
+
+      /* A connector processed a produce response.  Argument is the response
+         size in bytes. */
+      ResponseProcessed,
+
+      /* A connector requested a pause.  Argument is the broker ID. */
+      PauseRequested,
+
+      /* The router thread started and finished handling a pause.  Argument
+         is 0 for a global pause or 1 for a scoped pause. */
+      PauseStart,
+      PauseEnd
+    };  // TTraceEvent
+
+    /* A single thread's events, used only by TEventTrace below.  Only the
+       owning thread writes to a ring, but any thread may read it while holding
+       TEventTrace's registry mutex.  Slots are atomic so that concurrent reads
+       are well defined; on x86 the relaxed stores compile to ordinary moves.
+     */
+    class TTraceRing final {
+      NO_COPY_SEMANTICS(TTraceRing);
+
+      public:
+      static const size_t NAME_SIZE = 32;
+
+      struct TSlot {
+        std::atomic<uint64_t> Ticks;
+
+        /* Low 8 bits hold the event type, and the rest hold the argument. */
+        std::atomic<uint64_t> Word;
+      };  // TSlot
+
+      explicit TTraceRing(size_t size);
+
+      ~TTraceRing() noexcept;
+
+      void Append(uint64_t ticks, TTraceEvent event, uint64_t arg) noexcept {
+        assert(this);
+        uint64_t index = Committed.load(std::memory_order_relaxed);
+        TSlot &slot = Slots[index % Size];
+
+        /* Announce that the slot is being overwritten before touching it, so
+           a concurrent reader can tell which of its copies may be torn. */
+        Claimed.store(index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.Ticks.store(ticks, std::memory_order_relaxed);
+        slot.Word.store((arg << 8) | static_cast<uint8_t>(event),
+            std::memory_order_relaxed);
+        Committed.store(index + 1, std::memory_order_release);
+      }
+
+      const size_t Size;
+
+      TSlot *const Slots;
+
+      /* Number of events whose writes have finished. */
+      std::atomic<uint64_t> Committed;
+
+      /* Number of events whose writes have started. */
+      std::atomic<uint64_t> Claimed;
+
+      /* The remaining fields are protected by the registry mutex. */
+
+      char Name[NAME_SIZE];
+
+      int Tid;
+
+      bool InUse;
+
+      /* Order in which the owning thread released the ring.  Used to pick the
+         oldest released ring for reuse. */
+      uint64_t ReleaseSeq;
+    };  // TTraceRing
+
+    /* Always-on tracing of key events, for diagnosing pause storms and
+       latency spikes at a finer grain than syslog allows.  Each thread that
+       records events gets its own fixed-size ring buffer, so recording never
+       blocks, allocates (after the first event), or contends with other
+       threads.  Timestamps are read from the CPU's time stamp counter where
+       available.  WriteChromeTraceJson() takes a snapshot of all rings.
+
+       Rings of threads that have exited are kept, so their recent history
+       remains visible, until enough new threads have started that their rings
+       are reused. */
+    class TEventTrace final {
+      NO_CONSTRUCTION(TEventTrace);
+
+      public:
+      /* Set the number of events each thread's ring holds.  A value of 0
+         disables tracing.  Call once at startup, before any events are
+         recorded. */
+      static void Init(size_t events_per_thread);
+
+      static bool IsEnabled() noexcept {
+        return Enabled;
+      }
+
+      /* Name the calling thread in trace output (for instance, "router").
+         Names longer than the available space are truncated. */
+      static void SetThreadName(const char *name);
+
+      /* Record an event for the calling thread. */
+      static void Record(TTraceEvent event, uint64_t arg = 0) noexcept {
+        if (Enabled) {
+          TTraceRing *ring = ThreadRing;
+
+          if ((ring != nullptr) || ((ring = AcquireRing()) != nullptr)) {
+            ring->Append(ReadTicks(), event, arg);
+          }
+        }
+      }
+
+      /* Write a snapshot of all rings to 'os' in the Chrome trace event
+         JSON format, which can be loaded by chrome://tracing and Perfetto. */
+      static void WriteChromeTraceJson(std::ostream &os);
+
+      private:
+      /* Read the time stamp counter, or a nanosecond clock if the CPU doesn't
+         have one. */
+      static uint64_t ReadTicks() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return (static_cast<uint64_t>(t.tv_sec) * 1000000000) +
+            static_cast<uint64_t>(t.tv_nsec);
+#endif
+      }
+
+      /* Assign a ring to the calling thread and return it, or return null if
+         tracing is disabled. */
+      static TTraceRing *AcquireRing() noexcept;
+
+      static bool Enabled;
+
+      /* The calling thread's ring, or null if it has not recorded any events
+         yet. */
+      static thread_local TTraceRing *ThreadRing;
+    };  // TEventTrace
+
+  }  // Util
+
+}  // Dory
@@ -0,0 +1,166 @@
+/* <dory/util/event_trace.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/util/event_trace.h>.
+ */
+
+#include <dory/util/event_trace.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <base/gettid.h>
+
+#include <gtest/gtest.h>
+
+using namespace Dory;
+using namespace Dory::Util;
+
+namespace {
+
+  const size_t RING_SIZE = 64;
+
+  /* Return the lines of trace output for thread 'tid' that contain 'text'. */
+  std::vector<std::string> FindLines(const std::string &trace, int tid,
+      const std::string &text) {
+    std::vector<std::string> result;
+    std::istringstream is(trace);
+    std::string tid_text = "\"tid\": " + std::to_string(tid) + ",";
+
+    for (std::string line; std::getline(is, line); ) {
+      if ((line.find(tid_text) != std::string::npos) &&
+          (line.find(text) != std::string::npos)) {
+        result.push_back(line);
+      }
+    }
+
+    return result;
+  }
+
+  std::string GetTrace() {
+    std::ostringstream os;
+    TEventTrace::WriteChromeTraceJson(os);
+    return os.str();
+  }
+
+  /* The fixture for testing class TEventTrace. */
+  class TEventTraceTest : public ::testing::Test {
+    protected:
+    TEventTraceTest() {
+    }
+
+    virtual ~TEventTraceTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TEventTraceTest
+
+  TEST_F(TEventTraceTest, BasicTest) {
+    int tid = 0;
+    std::thread t(
+        [&tid]() {
+          tid = static_cast<int>(Base::Gettid());
+          TEventTrace::SetThreadName("worker \"1\"");
+          TEventTrace::Record(TTraceEvent::RequestBuilt, 100);
+          TEventTrace::Record(TTraceEvent::SendStart, 100);
+          TEventTrace::Record(TTraceEvent::SendEnd, 100);
+          std::string trace = GetTrace();
+          ASSERT_EQ(FindLines(trace, tid, "\"ph\": \"M\"").size(), 1U);
+          ASSERT_EQ(
+              FindLines(trace, tid, "\"name\": \"worker \\\"1\\\"\"").size(),
+              1U);
+          std::vector<std::string> lines =
+              FindLines(trace, tid, "\"name\": \"request_built\"");
+          ASSERT_EQ(lines.size(), 1U);
+          ASSERT_NE(lines[0].find("\"args\": {\"bytes\": 100}"),
+              std::string::npos);
+          ASSERT_EQ(FindLines(trace, tid, "\"ph\": \"B\"").size(), 1U);
+          ASSERT_EQ(FindLines(trace, tid, "\"ph\": \"E\"").size(), 1U);
+        });
+    t.join();
+
+    /* The thread's events remain after it exits. */
+    std::string trace = GetTrace();
+    ASSERT_EQ(FindLines(trace, tid, "\"name\": \"send\"").size(), 2U);
+    ASSERT_EQ(FindLines(trace, tid, "(exited)").size(), 1U);
+  }
+
+  TEST_F(TEventTraceTest, WrapTest) {
+    int tid = 0;
+    std::thread t(
+        [&tid]() {
+          tid = static_cast<int>(Base::Gettid());
+
+          for (size_t i = 0; i < (3 * RING_SIZE) + 5; ++i) {
+            TEventTrace::Record(TTraceEvent::MsgHandoff, i);
+          }
+        });
+    t.join();
+    std::vector<std::string> lines =
+        FindLines(GetTrace(), tid, "\"name\": \"msg_handoff\"");
+    ASSERT_EQ(lines.size(), RING_SIZE);
+
+    /* Only the most recent events are kept, in order. */
+    ASSERT_NE(lines.front().find("{\"bytes\": " +
+        std::to_string((2 * RING_SIZE) + 5) + "}"), std::string::npos);
+    ASSERT_NE(lines.back().find("{\"bytes\": " +
+        std::to_string((3 * RING_SIZE) + 4) + "}"), std::string::npos);
+  }
+
+  TEST_F(TEventTraceTest, ConcurrentTest) {
+    /* Take snapshots while other threads are recording.  Many threads are
+       started, so rings of exited threads get reused. */
+    const size_t thread_count = 40;
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back(
+          []() {
+            for (size_t j = 0; j < 10000; ++j) {
+              TEventTrace::Record(TTraceEvent::ResponseProcessed, j);
+            }
+          });
+
+      if ((i % 4) == 0) {
+        ASSERT_FALSE(GetTrace().empty());
+      }
+    }
+
+    for (std::thread &t : threads) {
+      t.join();
+    }
+
+    std::string trace = GetTrace();
+    ASSERT_EQ(trace.substr(trace.size() - 3), "]}\n");
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  TEventTrace::Init(RING_SIZE);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
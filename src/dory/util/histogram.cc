@@ -0,0 +1,129 @@
+/* <dory/util/histogram.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/util/histogram.h>.
+ */
+
+#include <dory/util/histogram.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Dory;
+using namespace Dory::Util;
+
+static const size_t SUB_BUCKET_COUNT =
+    1U << THistogram::SUB_BUCKET_BITS;
+
+void THistogram::Record(uint64_t value) {
+  assert(this);
+  value = std::min(value, MAX_VALUE);
+  size_t index = BucketIndex(value);
+
+  if (index >= Buckets.size()) {
+    Buckets.resize(index + 1, 0);
+  }
+
+  ++Buckets[index];
+  ++Count;
+  Sum += value;
+  Max = std::max(Max, value);
+}
+
+void THistogram::Merge(const THistogram &other) {
+  assert(this);
+
+  if (other.Buckets.empty()) {
+    return;
+  }
+
+  if (Buckets.size() < other.Buckets.size()) {
+    Buckets.resize(other.Buckets.size(), 0);
+  }
+
+  for (size_t i = 0; i < other.Buckets.size(); ++i) {
+    Buckets[i] += other.Buckets[i];
+  }
+
+  Count += other.Count;
+  Sum += other.Sum;
+  Max = std::max(Max, other.Max);
+}
+
+uint64_t THistogram::GetPercentile(double percentile) const {
+  assert(this);
+  assert(percentile >= 0.0);
+  assert(percentile <= 100.0);
+
+  if (Count == 0) {
+    return 0;
+  }
+
+  uint64_t target = static_cast<uint64_t>(
+      std::ceil((percentile / 100.0) * static_cast<double>(Count)));
+  target = std::max<uint64_t>(target, 1);
+  uint64_t seen = 0;
+
+  for (size_t i = 0; i < Buckets.size(); ++i) {
+    seen += Buckets[i];
+
+    if (seen >= target) {
+      return std::min(BucketUpperBound(i), Max);
+    }
+  }
+
+  return Max;
+}
+
+void THistogram::Clear() {
+  assert(this);
+  Buckets.clear();
+  Count = 0;
+  Sum = 0;
+  Max = 0;
+}
+
+size_t THistogram::BucketIndex(uint64_t value) {
+  assert(value <= MAX_VALUE);
+
+  if (value < SUB_BUCKET_COUNT) {
+    return static_cast<size_t>(value);
+  }
+
+  /* 'value' is in [2^msb, 2^(msb + 1)).  Shift it so that only its top
+     SUB_BUCKET_BITS + 1 bits remain, which selects one of SUB_BUCKET_COUNT
+     equal buckets within that range. */
+  unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+  unsigned shift = msb - SUB_BUCKET_BITS;
+  return ((shift + 1) * SUB_BUCKET_COUNT) +
+      static_cast<size_t>((value >> shift) - SUB_BUCKET_COUNT);
+}
+
+uint64_t THistogram::BucketUpperBound(size_t index) {
+  if (index < SUB_BUCKET_COUNT) {
+    return index;
+  }
+
+  size_t shift = (index / SUB_BUCKET_COUNT) - 1;
+  uint64_t sub = (index % SUB_BUCKET_COUNT) + SUB_BUCKET_COUNT;
+  return ((sub + 1) << shift) - 1;
+}
+
+const unsigned THistogram::SUB_BUCKET_BITS;
+
+const uint64_t THistogram::MAX_VALUE;
@@ -0,0 +1,130 @@
+/* <dory/util/histogram.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Histogram for recording integer values such as latencies and sizes.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Dory {
+
+  namespace Util {
+
+    /* A histogram of nonnegative integer values with log-linear buckets, in the style of
+       HdrHistogram.  Values less than 2^SUB_BUCKET_BITS each get their own
+       bucket.  Above that, each range of values between consecutive powers of
+       2 is split into 2^SUB_BUCKET_BITS equal buckets, so a value read back
+       from the histogram differs from the recorded value by less than
+       1 / 2^SUB_BUCKET_BITS.  Values larger than MAX_VALUE are recorded as
+       MAX_VALUE.  The bucket array only extends as far as the largest bucket
+       used, so a histogram of small values stays small.  Not thread-safe. */
+    class THistogram final {
+      public:
+      /* Each power of 2 range is split into 2^SUB_BUCKET_BITS buckets, so
+         values are accurate to within 12.5%. */
+      static const unsigned SUB_BUCKET_BITS = 3;
+
+      /* Larger values are clamped to this.  For values in microseconds, this
+         is about 19 hours. */
+      static const uint64_t MAX_VALUE = (1ULL << 36) - 1;
+
+      THistogram()
+          : Count(0),
+            Sum(0),
+            Max(0) {
+      }
+
+      bool IsEmpty() const {
+        assert(this);
+        return (Count == 0);
+      }
+
+      /* Return the number of recorded values. */
+      uint64_t GetCount() const {
+        assert(this);
+        return Count;
+      }
+
+      /* Return the sum of the recorded values (after clamping). */
+      uint64_t GetSum() const {
+        assert(this);
+        return Sum;
+      }
+
+      /* Return the largest recorded value (after clamping), or 0 if the
+         histogram is empty. */
+      uint64_t GetMax() const {
+        assert(this);
+        return Max;
+      }
+
+      /* Return the mean of the recorded values, or 0 if the histogram is
+         empty. */
+      uint64_t GetMean() const {
+        assert(this);
+        return Count ? (Sum / Count) : 0;
+      }
+
+      /* Return the number of buckets currently allocated. */
+      size_t GetBucketCount() const {
+        assert(this);
+        return Buckets.size();
+      }
+
+      void Record(uint64_t value);
+
+      /* Add all values recorded in 'other' to this histogram. */
+      void Merge(const THistogram &other);
+
+      /* Return the smallest value v such that at least 'percentile' percent
+         of the recorded values are <= v, subject to bucket precision.  The
+         value returned is the upper bound of the bucket containing the
+         percentile, limited to GetMax().  'percentile' must be in the range
+         [0, 100].  Returns 0 if the histogram is empty. */
+      uint64_t GetPercentile(double percentile) const;
+
+      void Clear();
+
+      /* Return the index of the bucket that 'value' is recorded in.  'value'
+         must be at most MAX_VALUE. */
+      static size_t BucketIndex(uint64_t value);
+
+      /* Return the largest value recorded in bucket 'index'. */
+      static uint64_t BucketUpperBound(size_t index);
+
+      private:
+      /* Counts for each bucket, up to the largest bucket with a nonzero
+         count.  This is empty until the first value is recorded, so unused
+         histograms are cheap. */
+      std::vector<uint64_t> Buckets;
+
+      uint64_t Count;
+
+      uint64_t Sum;
+
+      uint64_t Max;
+    };  // THistogram
+
+  }  // Util
+
+}  // Dory
@@ -0,0 +1,157 @@
+/* <dory/util/histogram.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/util/histogram.h>.
+ */
+
+#include <dory/util/histogram.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+using namespace Dory;
+using namespace Dory::Util;
+
+namespace {
+
+  /* The fixture for testing class THistogram. */
+  class THistogramTest : public ::testing::Test {
+    protected:
+    THistogramTest() {
+    }
+
+    virtual ~THistogramTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // THistogramTest
+
+  TEST_F(THistogramTest, BucketTest) {
+    /* Small values get exact buckets. */
+    for (uint64_t i = 0; i < 8; ++i) {
+      ASSERT_EQ(THistogram::BucketIndex(i), i);
+      ASSERT_EQ(THistogram::BucketUpperBound(i), i);
+    }
+
+    /* Bucket indexes are contiguous, each value falls within its bucket's
+       bounds, and each bucket is within 1/8 of its lower bound. */
+    size_t prev_index = THistogram::BucketIndex(7);
+
+    for (uint64_t v = 8; v < (1ULL << 20); ++v) {
+      size_t index = THistogram::BucketIndex(v);
+      ASSERT_TRUE((index == prev_index) || (index == (prev_index + 1)));
+      ASSERT_LE(v, THistogram::BucketUpperBound(index));
+      ASSERT_GT(v, THistogram::BucketUpperBound(index - 1));
+      ASSERT_LE(THistogram::BucketUpperBound(index) - v, v / 8);
+      prev_index = index;
+    }
+
+    size_t max_index =
+        THistogram::BucketIndex(THistogram::MAX_VALUE);
+    ASSERT_EQ(THistogram::BucketUpperBound(max_index),
+        THistogram::MAX_VALUE);
+  }
+
+  TEST_F(THistogramTest, PercentileTest) {
+    THistogram h;
+    ASSERT_TRUE(h.IsEmpty());
+    ASSERT_EQ(h.GetPercentile(50.0), 0U);
+
+    for (uint64_t v = 1; v <= 1000; ++v) {
+      h.Record(v);
+    }
+
+    ASSERT_FALSE(h.IsEmpty());
+    ASSERT_EQ(h.GetCount(), 1000U);
+    ASSERT_EQ(h.GetSum(), 500500U);
+    ASSERT_EQ(h.GetMax(), 1000U);
+    ASSERT_EQ(h.GetMean(), 500U);
+    ASSERT_EQ(h.GetPercentile(0.0), 1U);
+    ASSERT_EQ(h.GetPercentile(100.0), 1000U);
+
+    uint64_t p50 = h.GetPercentile(50.0);
+    ASSERT_GE(p50, 500U);
+    ASSERT_LE(p50, 500U + (500U / 8));
+    uint64_t p99 = h.GetPercentile(99.0);
+    ASSERT_GE(p99, 990U);
+    ASSERT_LE(p99, 1000U);
+
+    /* Values past the maximum are clamped. */
+    h.Record(THistogram::MAX_VALUE + 12345);
+    ASSERT_EQ(h.GetMax(), THistogram::MAX_VALUE);
+    ASSERT_EQ(h.GetPercentile(100.0), THistogram::MAX_VALUE);
+
+    h.Clear();
+    ASSERT_TRUE(h.IsEmpty());
+    ASSERT_EQ(h.GetMax(), 0U);
+  }
+
+  TEST_F(THistogramTest, MergeTest) {
+    THistogram a, b, empty;
+    a.Record(10);
+    a.Record(20);
+    b.Record(30000);
+    a.Merge(empty);
+    ASSERT_EQ(a.GetCount(), 2U);
+    empty.Merge(b);
+    ASSERT_EQ(empty.GetCount(), 1U);
+    ASSERT_EQ(empty.GetMax(), 30000U);
+    a.Merge(b);
+    ASSERT_EQ(a.GetCount(), 3U);
+    ASSERT_EQ(a.GetSum(), 30030U);
+    ASSERT_EQ(a.GetMax(), 30000U);
+    ASSERT_GE(a.GetPercentile(50.0), 20U);
+    ASSERT_LE(a.GetPercentile(50.0), 20U + (20U / 8));
+    ASSERT_GE(a.GetPercentile(100.0), 30000U);
+
+    /* Merging a histogram with more buckets extends the smaller one. */
+    THistogram c;
+    c.Record(1);
+    c.Merge(a);
+    ASSERT_EQ(c.GetCount(), 4U);
+    ASSERT_EQ(c.GetMax(), 30000U);
+    ASSERT_EQ(c.GetPercentile(0.0), 1U);
+  }
+
+  TEST_F(THistogramTest, SizeTest) {
+    /* The bucket array grows only as far as needed, so a histogram's memory
+       use depends on its largest value, not MAX_VALUE. */
+    THistogram h;
+    h.Record(5000);
+    ASSERT_EQ(h.GetBucketCount(), THistogram::BucketIndex(5000) + 1);
+    ASSERT_LT(h.GetBucketCount(), 100U);
+    h.Record(10);
+    ASSERT_EQ(h.GetBucketCount(), THistogram::BucketIndex(5000) + 1);
+    h.Record(THistogram::MAX_VALUE);
+    ASSERT_EQ(h.GetBucketCount(),
+        THistogram::BucketIndex(THistogram::MAX_VALUE) + 1);
+    ASSERT_LT(h.GetBucketCount(), 300U);
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
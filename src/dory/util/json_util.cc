@@ -0,0 +1,60 @@
+/* <dory/util/json_util.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/util/json_util.h>.
+ */
+
+#include <dory/util/json_util.h>
+
+#include <sstream>
+
+#include <dory/util/escape_string.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Util;
+
+void Dory::Util::WriteJsonString(std::ostream &os, const std::string &s) {
+  os << '"';
+  WriteEscapedString(os, s, true);
+  os << '"';
+}
+
+std::string Dory::Util::JsonString(const std::string &s) {
+  std::ostringstream oss;
+  WriteJsonString(oss, s);
+  return oss.str();
+}
+
+void Dory::Util::WriteHistogramJson(std::ostream &os, const THistogram &h,
+    TIndent &ind0) {
+  os << "{" << std::endl;
+
+  {
+    TIndent ind1(ind0);
+    os << ind1 << "\"count\": " << h.GetCount() << "," << std::endl
+        << ind1 << "\"mean\": " << h.GetMean() << "," << std::endl
+        << ind1 << "\"p50\": " << h.GetPercentile(50.0) << "," << std::endl
+        << ind1 << "\"p90\": " << h.GetPercentile(90.0) << "," << std::endl
+        << ind1 << "\"p99\": " << h.GetPercentile(99.0) << "," << std::endl
+        << ind1 << "\"p999\": " << h.GetPercentile(99.9) << "," << std::endl
+        << ind1 << "\"max\": " << h.GetMax() << std::endl;
+  }
+
+  os << ind0 << "}";
+}
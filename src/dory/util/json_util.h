@@ -0,0 +1,51 @@
+/* <dory/util/json_util.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Helpers for writing JSON output.
+ */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+
+#include <base/indent.h>
+#include <dory/util/histogram.h>
+
+namespace Dory {
+
+  namespace Util {
+
+    /* Write 's' to 'os' as a quoted JSON string with special characters
+       escaped. */
+    void WriteJsonString(std::ostream &os, const std::string &s);
+
+    /* Return 's' as a quoted JSON string with special characters escaped. */
+    std::string JsonString(const std::string &s);
+
+    /* Write a summary of 'h' to 'os' as a JSON object: the count, mean,
+       several percentiles, and the maximum.  The caller has written any
+       field name and indentation before the opening brace.  The closing
+       brace is written at indentation level 'ind0', without a trailing
+       newline. */
+    void WriteHistogramJson(std::ostream &os, const THistogram &h,
+        Base::TIndent &ind0);
+
+  }  // Util
+
+}  // Dory
@@ -0,0 +1,101 @@
+/* <dory/util/json_util.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/util/json_util.h>.
+ */
+
+#include <dory/util/json_util.h>
+
+#include <sstream>
+#include <string>
+
+#include <base/indent.h>
+#include <dory/util/escape_string.h>
+#include <dory/util/histogram.h>
+
+#include <gtest/gtest.h>
+
+using namespace Base;
+using namespace Dory;
+using namespace Dory::Util;
+
+namespace {
+
+  /* The fixture for testing JSON output helpers. */
+  class TJsonUtilTest : public ::testing::Test {
+    protected:
+    TJsonUtilTest() {
+    }
+
+    virtual ~TJsonUtilTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TJsonUtilTest
+
+  TEST_F(TJsonUtilTest, JsonStringTest) {
+    ASSERT_EQ(JsonString(""), "\"\"");
+    ASSERT_EQ(JsonString("abc"), "\"abc\"");
+    ASSERT_EQ(JsonString("a\"b\\c\nd"), "\"a\\\"b\\\\c\\nd\"");
+    ASSERT_EQ(JsonString(std::string("\t\x01\x1f", 3)),
+        "\"\\u0009\\u0001\\u001f\"");
+    ASSERT_EQ(JsonString("\xc3\xa9"), "\"\xc3\xa9\"");
+  }
+
+  TEST_F(TJsonUtilTest, EscapedStringTest) {
+    /* Without JSON control character escapes, as for OpenMetrics label
+       values, only backslash, double quote, and newline are escaped. */
+    std::ostringstream oss;
+    WriteEscapedString(oss, std::string("a\"b\\c\nd\te\x01", 10), false);
+    ASSERT_EQ(oss.str(), std::string("a\\\"b\\\\c\\nd\te\x01", 13));
+  }
+
+  TEST_F(TJsonUtilTest, HistogramJsonTest) {
+    THistogram h;
+
+    for (uint64_t i = 1; i <= 4; ++i) {
+      h.Record(i);
+    }
+
+    std::ostringstream oss;
+    std::string indent_str;
+    TIndent ind0(indent_str, TIndent::StartAt::Zero, 2);
+    oss << "\"h\": ";
+    WriteHistogramJson(oss, h, ind0);
+    ASSERT_EQ(oss.str(),
+        "\"h\": {\n"
+        "  \"count\": 4,\n"
+        "  \"mean\": 2,\n"
+        "  \"p50\": 2,\n"
+        "  \"p90\": 4,\n"
+        "  \"p99\": 4,\n"
+        "  \"p999\": 4,\n"
+        "  \"max\": 4\n"
+        "}");
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
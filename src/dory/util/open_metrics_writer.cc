@@ -0,0 +1,132 @@
+/* <dory/util/open_metrics_writer.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Implements <dory/util/open_metrics_writer.h>.
+ */
+
+#include <dory/util/open_metrics_writer.h>
+
+#include <cstdio>
+
+#include <base/no_default_case.h>
+#include <dory/util/escape_string.h>
+
+using namespace Dory;
+using namespace Dory::Util;
+
+static const char *TypeToString(TOpenMetricsWriter::TType type) {
+  const char *text = "";
+
+  switch (type) {
+    case TOpenMetricsWriter::TType::Counter: {
+      text = "counter";
+      break;
+    }
+    case TOpenMetricsWriter::TType::Gauge: {
+      text = "gauge";
+      break;
+    }
+    NO_DEFAULT_CASE;
+  }
+
+  return text;
+}
+
+void TOpenMetricsWriter::StartFamily(const char *name, TType type,
+    const char *help) {
+  assert(this);
+  assert(name);
+  assert(help);
+  Name = name;
+  Type = type;
+  Os << "# TYPE " << Name << ' ' << TypeToString(type) << '\n'
+      << "# HELP " << Name << ' ';
+
+  /* Backslash and newline must be escaped in help text. */
+  for (const char *p = help; *p; ++p) {
+    switch (*p) {
+      case '\\': {
+        Os << "\\\\";
+        break;
+      }
+      case '\n': {
+        Os << "\\n";
+        break;
+      }
+      default: {
+        Os << *p;
+        break;
+      }
+    }
+  }
+
+  Os << '\n';
+}
+
+void TOpenMetricsWriter::WriteSample(std::initializer_list<TLabel> labels,
+    uint64_t value) {
+  assert(this);
+  WriteSampleName(labels);
+  Os << ' ' << value << '\n';
+}
+
+void TOpenMetricsWriter::WriteSample(std::initializer_list<TLabel> labels,
+    double value) {
+  assert(this);
+  WriteSampleName(labels);
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.9g", value);
+  Os << ' ' << buf << '\n';
+}
+
+void TOpenMetricsWriter::Finish() {
+  assert(this);
+  Os << "# EOF\n";
+  Os.flush();
+}
+
+void TOpenMetricsWriter::WriteSampleName(
+    std::initializer_list<TLabel> labels) {
+  assert(this);
+  assert(!Name.empty());
+  Os << Name;
+
+  if (Type == TType::Counter) {
+    Os << "_total";
+  }
+
+  if (labels.size() == 0) {
+    return;
+  }
+
+  Os << '{';
+  bool first_time = true;
+
+  for (const TLabel &label : labels) {
+    if (!first_time) {
+      Os << ',';
+    }
+
+    Os << label.first << "=\"";
+    WriteEscapedString(Os, label.second, false);
+    Os << '"';
+    first_time = false;
+  }
+
+  Os << '}';
+}
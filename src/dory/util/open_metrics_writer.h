@@ -0,0 +1,90 @@
+/* <dory/util/open_metrics_writer.h>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Class for writing metrics in the OpenMetrics text format.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include <base/no_copy_semantics.h>
+
+namespace Dory {
+
+  namespace Util {
+
+    /* Writes metrics in the OpenMetrics text exposition format (also
+       understood by Prometheus) to an output stream.  Each sample is written
+       to the stream as soon as it is supplied, so the caller never needs to
+       build the entire exposition in memory.  All samples of a metric family
+       must be written immediately after the call to StartFamily() for that
+       family. */
+    class TOpenMetricsWriter final {
+      NO_COPY_SEMANTICS(TOpenMetricsWriter);
+
+      public:
+      enum class TType {
+        Counter,
+        Gauge
+      };  // TType
+
+      /* A (label name, label value) pair.  Label values are escaped as
+         needed when written. */
+      using TLabel = std::pair<const char *, std::string>;
+
+      explicit TOpenMetricsWriter(std::ostream &os)
+          : Os(os),
+            Type(TType::Gauge) {
+      }
+
+      /* Start a new metric family.  For a counter, 'name' should not include
+         the "_total" suffix, which is appended to each sample name. */
+      void StartFamily(const char *name, TType type, const char *help);
+
+      void WriteSample(std::initializer_list<TLabel> labels, uint64_t value);
+
+      void WriteSample(std::initializer_list<TLabel> labels, double value);
+
+      void WriteSample(uint64_t value) {
+        assert(this);
+        WriteSample({}, value);
+      }
+
+      /* Write the "# EOF" line that terminates the exposition. */
+      void Finish();
+
+      private:
+      void WriteSampleName(std::initializer_list<TLabel> labels);
+
+      std::ostream &Os;
+
+      /* Name and type of the family most recently started. */
+      std::string Name;
+
+      TType Type;
+    };  // TOpenMetricsWriter
+
+  }  // Util
+
+}  // Dory
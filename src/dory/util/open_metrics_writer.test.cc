@@ -0,0 +1,98 @@
+/* <dory/util/open_metrics_writer.test.cc>
+
+   ----------------------------------------------------------------------------
+   Copyright 2017 Dave Peterson <dave@dspeterson.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+   ----------------------------------------------------------------------------
+
+   Unit test for <dory/util/open_metrics_writer.h>.
+ */
+
+#include <dory/util/open_metrics_writer.h>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace Dory;
+using namespace Dory::Util;
+
+namespace {
+
+  /* The fixture for testing class TOpenMetricsWriter. */
+  class TOpenMetricsWriterTest : public ::testing::Test {
+    protected:
+    TOpenMetricsWriterTest() {
+    }
+
+    virtual ~TOpenMetricsWriterTest() {
+    }
+
+    virtual void SetUp() {
+    }
+
+    virtual void TearDown() {
+    }
+  };  // TOpenMetricsWriterTest
+
+  TEST_F(TOpenMetricsWriterTest, FormatTest) {
+    std::ostringstream oss;
+    TOpenMetricsWriter writer(oss);
+    writer.StartFamily("dory_msgs", TOpenMetricsWriter::TType::Counter,
+        "Messages.");
+    writer.WriteSample({{"topic", "a"}, {"state", "sent"}},
+        static_cast<uint64_t>(5));
+    writer.WriteSample({{"topic", "b"}, {"state", "sent"}},
+        static_cast<uint64_t>(0));
+    writer.StartFamily("dory_blocks", TOpenMetricsWriter::TType::Gauge,
+        "Blocks.");
+    writer.WriteSample(static_cast<uint64_t>(12));
+    writer.StartFamily("dory_latency_seconds",
+        TOpenMetricsWriter::TType::Gauge, "Latency.");
+    writer.WriteSample({{"broker", "3"}}, 0.25);
+    writer.Finish();
+    ASSERT_EQ(oss.str(),
+        "# TYPE dory_msgs counter\n"
+        "# HELP dory_msgs Messages.\n"
+        "dory_msgs_total{topic=\"a\",state=\"sent\"} 5\n"
+        "dory_msgs_total{topic=\"b\",state=\"sent\"} 0\n"
+        "# TYPE dory_blocks gauge\n"
+        "# HELP dory_blocks Blocks.\n"
+        "dory_blocks 12\n"
+        "# TYPE dory_latency_seconds gauge\n"
+        "# HELP dory_latency_seconds Latency.\n"
+        "dory_latency_seconds{broker=\"3\"} 0.25\n"
+        "# EOF\n");
+  }
+
+  TEST_F(TOpenMetricsWriterTest, EscapeTest) {
+    std::ostringstream oss;
+    TOpenMetricsWriter writer(oss);
+    writer.StartFamily("x", TOpenMetricsWriter::TType::Gauge,
+        "Back\\slash\nnewline \"quotes\".");
+    writer.WriteSample({{"topic", "a\\b\"c\nd"}}, static_cast<uint64_t>(1));
+    ASSERT_EQ(oss.str(),
+        "# TYPE x gauge\n"
+        "# HELP x Back\\\\slash\\nnewline \"quotes\".\n"
+        "x{topic=\"a\\\\b\\\"c\\nd\"} 1\n");
+  }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
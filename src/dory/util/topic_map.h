@@ -49,6 +49,12 @@ namespace Dory {
         return TopicHash.empty();
       }
 
+      /* Return true if the map contains messages for the given topic. */
+      bool Contains(const std::string &topic) const {
+        assert(this);
+        return (TopicHash.count(topic) != 0);
+      }
+
       void Clear() {
         assert(this);
         TopicHash.clear();
@@ -23,12 +23,15 @@
 
 #include <algorithm>
 #include <cstring>
+#include <functional>
 #include <sstream>
+#include <streambuf>
 #include <vector>
 
 #include <syslog.h>
 
 #include <base/error_utils.h>
+#include <base/no_copy_semantics.h>
 #include <base/no_default_case.h>
 #include <dory/web_request_handler.h>
 #include <server/counter.h>
@@ -39,16 +42,116 @@ using namespace Dory;
 using namespace Server;
 
 SERVER_COUNTER(MongooseEventLog);
-SERVER_COUNTER(MongooseGetServerInfoRequest);
+SERVER_COUNTER(MongooseGetBatchStatsRequest);
+SERVER_COUNTER(MongooseGetBrokerStatsRequest);
+SERVER_COUNTER(MongooseGetConnectionStatsRequest);
 SERVER_COUNTER(MongooseGetCountersRequest);
 SERVER_COUNTER(MongooseGetDiscardsRequest);
+SERVER_COUNTER(MongooseGetLatencyStatsRequest);
 SERVER_COUNTER(MongooseGetMetadataFetchTimeRequest);
+SERVER_COUNTER(MongooseGetMetricsRequest);
+SERVER_COUNTER(MongooseGetPoolStatsRequest);
 SERVER_COUNTER(MongooseGetQueueStatsRequest);
+SERVER_COUNTER(MongooseGetServerInfoRequest);
+SERVER_COUNTER(MongooseGetTraceRequest);
 SERVER_COUNTER(MongooseHttpRequest);
 SERVER_COUNTER(MongooseStdException);
 SERVER_COUNTER(MongooseUnknownException);
 SERVER_COUNTER(MongooseUrlDecodeError);
 
+namespace {
+
+  /* Stream buffer that sends its contents to a Mongoose connection using HTTP
+     chunked transfer encoding.  This allows a large response to be sent as it
+     is generated, rather than first building it in memory to determine its
+     length. */
+  class TChunkedResponseBuf final : public std::streambuf {
+    NO_COPY_SEMANTICS(TChunkedResponseBuf);
+
+    public:
+    explicit TChunkedResponseBuf(mg_connection *conn)
+        : Conn(conn),
+          Buf(BUF_SIZE) {
+      setp(&Buf[0], &Buf[0] + Buf.size());
+    }
+
+    /* Send any buffered data, followed by the empty chunk that terminates the
+       response. */
+    void Finish() {
+      assert(this);
+      SendChunk();
+      mg_write(Conn, "0\r\n\r\n", 5);
+    }
+
+    protected:
+    virtual int_type overflow(int_type c) override {
+      assert(this);
+      SendChunk();
+
+      if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+      }
+
+      return traits_type::not_eof(c);
+    }
+
+    /* Data is sent only when the buffer fills or Finish() is called, so that
+       flushing the stream doesn't produce lots of tiny chunks. */
+    virtual int sync() override {
+      return 0;
+    }
+
+    private:
+    static const size_t BUF_SIZE = 16 * 1024;
+
+    void SendChunk() {
+      assert(this);
+      size_t size = static_cast<size_t>(pptr() - pbase());
+
+      if (size) {
+        mg_printf(Conn, "%lx\r\n", static_cast<unsigned long>(size));
+        mg_write(Conn, pbase(), size);
+        mg_write(Conn, "\r\n", 2);
+        setp(&Buf[0], &Buf[0] + Buf.size());
+      }
+    }
+
+    mg_connection * const Conn;
+
+    std::vector<char> Buf;
+  };  // TChunkedResponseBuf
+
+  /* Send a 200 response with the given content type, streaming the body
+     written by 'write_body' using chunked transfer encoding.  Since the
+     headers have already been sent when the body is generated, an exception
+     thrown while generating it can't be reported as an error response.
+     Instead it is logged and the chunked response is ended cleanly, leaving
+     the client with a truncated body.  Both formats streamed this way have
+     explicit terminators ("# EOF" for OpenMetrics, and the closing brace for
+     JSON), so the client can tell that the body is incomplete. */
+  void SendStreamedResponse(mg_connection *conn, const char *content_type,
+      const std::function<void(std::ostream &)> &write_body) {
+    mg_printf(conn, "HTTP/1.1 200 OK\r\nContent-Type: %s\r\n"
+                    "Transfer-Encoding: chunked\r\n\r\n", content_type);
+    TChunkedResponseBuf buf(conn);
+    std::ostream out(&buf);
+
+    try {
+      write_body(out);
+    } catch (const std::exception &x) {
+      MongooseStdException.Increment();
+      syslog(LOG_ERR, "Error while streaming HTTP response: %s", x.what());
+    } catch (...) {
+      MongooseUnknownException.Increment();
+      syslog(LOG_ERR, "Unknown error while streaming HTTP response");
+    }
+
+    buf.Finish();
+  }
+
+}  // namespace
+
 const char *TWebInterface::ToErrorBlurb(TRequestType request_type) {
   switch (request_type) {
     case TRequestType::UNIMPLEMENTED_REQUEST_METHOD: {
@@ -78,6 +181,27 @@ const char *TWebInterface::ToErrorBlurb(TRequestType request_type) {
     case TRequestType::GET_QUEUE_STATS: {
       return "Get queue stats";
     }
+    case TRequestType::GET_CONNECTION_STATS: {
+      return "Get connection stats";
+    }
+    case TRequestType::GET_BROKER_STATS: {
+      return "Get broker stats";
+    }
+    case TRequestType::GET_LATENCY_STATS: {
+      return "Get latency stats";
+    }
+    case TRequestType::GET_BATCH_STATS: {
+      return "Get batch stats";
+    }
+    case TRequestType::GET_POOL_STATS: {
+      return "Get pool stats";
+    }
+    case TRequestType::GET_METRICS: {
+      return "Get metrics";
+    }
+    case TRequestType::GET_TRACE: {
+      return "Get trace";
+    }
     case TRequestType::MSG_DEBUG_GET_TOPICS: {
       return "Msg debug get topics";
     }
@@ -99,6 +223,9 @@ const char *TWebInterface::ToErrorBlurb(TRequestType request_type) {
     case TRequestType::METADATA_UPDATE: {
       return "Metadata update";
     }
+    case TRequestType::POOL_RESET_HIGH_WATER_MARK: {
+      return "Pool reset high water mark";
+    }
     NO_DEFAULT_CASE;
   }
 
@@ -190,6 +317,22 @@ void TWebInterface::WriteFrontPage(std::ostream &os) {
       << "      Get queued message info: [<a href=\"/queues/plain\">"
       << "plain</a>]" << std::endl
       << "          [<a href=\"/queues/json\">JSON</a>]<br/>" << std::endl
+      << "      Get broker connection info: [<a href=\"/connections/plain\">"
+      << "plain</a>]" << std::endl
+      << "          [<a href=\"/connections/json\">JSON</a>]<br/>"
+      << std::endl
+      << "      Get per-broker connection details:" << std::endl
+      << "          [<a href=\"/brokers/json\">JSON</a>]<br/>" << std::endl
+      << "      Get message latency info:" << std::endl
+      << "          [<a href=\"/latency/json\">JSON</a>]<br/>" << std::endl
+      << "      Get batching and produce request fill info:" << std::endl
+      << "          [<a href=\"/batches/json\">JSON</a>]<br/>" << std::endl
+      << "      Get buffer pool info:" << std::endl
+      << "          [<a href=\"/pool/json\">JSON</a>]<br/>" << std::endl
+      << "      Get metrics in OpenMetrics format:" << std::endl
+      << "          [<a href=\"/metrics\">text</a>]<br/>" << std::endl
+      << "      Get event trace in Chrome trace format:" << std::endl
+      << "          [<a href=\"/trace/json\">JSON</a>]<br/>" << std::endl
       << "      Get metadata fetch time:" << std::endl
       << "          [<a href=\"/metadata_fetch_time/plain\">plain</a>]"
       << std::endl
@@ -203,6 +346,13 @@ void TWebInterface::WriteFrontPage(std::ostream &os) {
       << std::endl
       << "      </div>" << std::endl
       << "    </form>" << std::endl
+      << "    <form action=\"/pool/reset_high_water_mark\" method=\"post\">"
+      << std::endl
+      << "      <div>" << std::endl
+      << "        <input type=\"submit\" "
+      << "value=\"Reset Buffer Pool High Water Mark\"/>" << std::endl
+      << "      </div>" << std::endl
+      << "    </form>" << std::endl
       << "  </body>" << std::endl
       << "</html>" << std::endl;
 }
@@ -278,12 +428,71 @@ void TWebInterface::HandleHttpRequest(mg_connection *conn,
     } else if (!std::strcmp(request_info->uri, "/queues/plain")) {
       request_type = TRequestType::GET_QUEUE_STATS;
       MongooseGetQueueStatsRequest.Increment();
-      TWebRequestHandler().HandleQueueStatsRequestPlain(oss, MsgStateTracker);
+      TWebRequestHandler().HandleQueueStatsRequestPlain(oss, MsgStateTracker,
+          BatchAutoTuner);
     } else if (!std::strcmp(request_info->uri, "/queues/json")) {
       request_type = TRequestType::GET_QUEUE_STATS;
       MongooseGetQueueStatsRequest.Increment();
-      TWebRequestHandler().HandleQueueStatsRequestJson(oss, MsgStateTracker);
+      TWebRequestHandler().HandleQueueStatsRequestJson(oss, MsgStateTracker,
+          BatchAutoTuner);
+      response_type = TResponseType::Json;
+    } else if (!std::strcmp(request_info->uri, "/connections/plain")) {
+      request_type = TRequestType::GET_CONNECTION_STATS;
+      MongooseGetConnectionStatsRequest.Increment();
+      TWebRequestHandler().HandleConnectionStatsRequestPlain(oss,
+          ConnectionStats);
+    } else if (!std::strcmp(request_info->uri, "/connections/json")) {
+      request_type = TRequestType::GET_CONNECTION_STATS;
+      MongooseGetConnectionStatsRequest.Increment();
+      TWebRequestHandler().HandleConnectionStatsRequestJson(oss,
+          ConnectionStats);
+      response_type = TResponseType::Json;
+    } else if (!std::strcmp(request_info->uri, "/brokers/json")) {
+      request_type = TRequestType::GET_BROKER_STATS;
+      MongooseGetBrokerStatsRequest.Increment();
+      TWebRequestHandler().HandleBrokerStatsRequestJson(oss, ConnectionStats);
+      response_type = TResponseType::Json;
+    } else if (!std::strcmp(request_info->uri, "/latency/json")) {
+      request_type = TRequestType::GET_LATENCY_STATS;
+      MongooseGetLatencyStatsRequest.Increment();
+      TWebRequestHandler().HandleLatencyStatsRequestJson(oss,
+          MsgStateTracker.GetLatencyTracker());
       response_type = TResponseType::Json;
+    } else if (!std::strcmp(request_info->uri, "/batches/json")) {
+      request_type = TRequestType::GET_BATCH_STATS;
+      MongooseGetBatchStatsRequest.Increment();
+      TWebRequestHandler().HandleBatchStatsRequestJson(oss,
+          MsgStateTracker.GetBatchStats());
+      response_type = TResponseType::Json;
+    } else if (!std::strcmp(request_info->uri, "/pool/json")) {
+      request_type = TRequestType::GET_POOL_STATS;
+      MongooseGetPoolStatsRequest.Increment();
+      TWebRequestHandler().HandlePoolStatsRequestJson(oss, PoolMonitor,
+          MsgStateTracker);
+      response_type = TResponseType::Json;
+    } else if (!std::strcmp(request_info->uri, "/metrics")) {
+      request_type = TRequestType::GET_METRICS;
+      MongooseGetMetricsRequest.Increment();
+
+      /* The response may be large when there are many topics, so it is
+         streamed to the client as it is generated. */
+      SendStreamedResponse(conn,
+          "application/openmetrics-text; version=1.0.0; charset=utf-8",
+          [this](std::ostream &out) {
+            TWebRequestHandler().HandleMetricsRequest(out, MsgStateTracker,
+                AnomalyTracker, PoolMonitor, ConnectionStats);
+          });
+      return;
+    } else if (!std::strcmp(request_info->uri, "/trace/json")) {
+      request_type = TRequestType::GET_TRACE;
+      MongooseGetTraceRequest.Increment();
+
+      /* As with /metrics, stream the response since it may be large. */
+      SendStreamedResponse(conn, "application/json",
+          [](std::ostream &out) {
+            TWebRequestHandler().HandleTraceRequest(out);
+          });
+      return;
     } else if (!std::strcmp(request_info->uri, "/msg_debug/get_topics")) {
       request_type = TRequestType::MSG_DEBUG_GET_TOPICS;
       TWebRequestHandler().HandleGetDebugTopicsRequest(oss, DebugSetup);
@@ -318,11 +527,17 @@ void TWebInterface::HandleHttpRequest(mg_connection *conn,
       request_type = TRequestType::METADATA_UPDATE;
       TWebRequestHandler().HandleMetadataUpdateRequest(oss,
           MetadataUpdateRequestSem);
+    } else if (!std::strcmp(request_info->uri,
+                            "/pool/reset_high_water_mark")) {
+      request_type = TRequestType::POOL_RESET_HIGH_WATER_MARK;
+      TWebRequestHandler().HandlePoolResetHighWaterMarkRequest(oss,
+          PoolMonitor);
     } else {
       request_type = TRequestType::UNKNOWN_POST_REQUEST;
       mg_printf(conn, "HTTP/1.1 404 NOT FOUND\r\n"
                       "Content-Type: text/plain\r\n\r\n"
-                      "[not found: try /metadata_update]");
+                      "[not found: try /metadata_update or "
+                      "/pool/reset_high_water_mark]");
       return;
     }
   } else {
@@ -32,9 +32,12 @@
 #include <base/indent.h>
 #include <base/no_copy_semantics.h>
 #include <dory/anomaly_tracker.h>
+#include <dory/batch/batch_auto_tuner.h>
 #include <dory/debug/debug_setup.h>
 #include <dory/metadata_timestamp.h>
+#include <dory/msg_dispatch/connection_stats.h>
 #include <dory/msg_state_tracker.h>
+#include <dory/pool_monitor.h>
 #include <third_party/mongoose/mongoose.h>
 
 namespace Dory {
@@ -47,14 +50,20 @@ namespace Dory {
                   TAnomalyTracker &anomaly_tracker,
                   const TMetadataTimestamp &metadata_timestamp,
                   Base::TEventSemaphore &metadata_update_request_sem,
-                  Debug::TDebugSetup &debug_setup)
+                  Debug::TDebugSetup &debug_setup,
+                  const MsgDispatch::TConnectionStatsTracker &connection_stats,
+                  const Batch::TBatchAutoTuner &batch_auto_tuner,
+                  TPoolMonitor &pool_monitor)
         : Port(port),
           HttpServerStarted(false),
           MsgStateTracker(msg_state_tracker),
           AnomalyTracker(anomaly_tracker),
           MetadataTimestamp(metadata_timestamp),
           MetadataUpdateRequestSem(metadata_update_request_sem),
-          DebugSetup(debug_setup) {
+          DebugSetup(debug_setup),
+          ConnectionStats(connection_stats),
+          BatchAutoTuner(batch_auto_tuner),
+          PoolMonitor(pool_monitor) {
     }
 
     virtual ~TWebInterface() noexcept {
@@ -95,13 +104,21 @@ namespace Dory {
       GET_DISCARDS,
       GET_METADATA_FETCH_TIME,
       GET_QUEUE_STATS,
+      GET_CONNECTION_STATS,
+      GET_BROKER_STATS,
+      GET_LATENCY_STATS,
+      GET_BATCH_STATS,
+      GET_POOL_STATS,
+      GET_METRICS,
+      GET_TRACE,
       MSG_DEBUG_GET_TOPICS,
       MSG_DEBUG_ADD_ALL_TOPICS,
       MSG_DEBUG_DEL_ALL_TOPICS,
       MSG_DEBUG_TRUNCATE_FILES,
       MSG_DEBUG_ADD_TOPIC,
       MSG_DEBUG_DEL_TOPIC,
-      METADATA_UPDATE
+      METADATA_UPDATE,
+      POOL_RESET_HIGH_WATER_MARK
     };  // TRequestType
 
     static const char *ToErrorBlurb(TRequestType request_type);
@@ -131,6 +148,12 @@ namespace Dory {
     Base::TEventSemaphore &MetadataUpdateRequestSem;
 
     Debug::TDebugSetup &DebugSetup;
+
+    const MsgDispatch::TConnectionStatsTracker &ConnectionStats;
+
+    const Batch::TBatchAutoTuner &BatchAutoTuner;
+
+    TPoolMonitor &PoolMonitor;
   };  // TWebInterface
 
 }  // Dory
@@ -21,11 +21,13 @@
 
 #include <dory/web_request_handler.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iomanip>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <sys/types.h>
 #include <time.h>
@@ -33,12 +35,17 @@
 
 #include <base/time_util.h>
 #include <dory/build_id.h>
+#include <dory/util/event_trace.h>
+#include <dory/util/histogram.h>
+#include <dory/util/json_util.h>
+#include <dory/util/open_metrics_writer.h>
 #include <server/counter.h>
 #include <third_party/base64/base64.h>
 
 using namespace Base;
 using namespace Dory;
 using namespace Dory::Debug;
+using namespace Dory::Util;
 using namespace Server;
 
 /* Size of string buffer to use for converting time_t (seconds since epoch)
@@ -255,6 +262,9 @@ void TWebRequestHandler::HandleMetadataFetchTimeRequestPlain(std::ostream &os,
   assert(this);
   uint64_t last_update_time = 0, last_modified_time = 0;
   metadata_timestamp.GetTimes(last_update_time, last_modified_time);
+  uint64_t stall_count = 0, stall_total = 0, stall_max = 0, stall_last = 0;
+  metadata_timestamp.GetStallStats(stall_count, stall_total, stall_max,
+      stall_last);
   uint64_t now = GetEpochMilliseconds();
   time_t start_time = GetServerStartTime();
   char last_update_time_buf[TIME_BUF_SIZE],
@@ -272,7 +282,12 @@ void TWebRequestHandler::HandleMetadataFetchTimeRequestPlain(std::ostream &os,
       << "metadata last updated at (milliseconds since epoch): "
       << last_update_time << " " << last_update_time_buf << std::endl
       << "metadata last modified at (milliseconds since epoch): "
-      << last_modified_time << " " << last_modified_time_buf << std::endl;
+      << last_modified_time << " " << last_modified_time_buf << std::endl
+      << "router stalls on metadata: " << stall_count << std::endl
+      << "router stall time total (milliseconds): " << stall_total
+      << std::endl
+      << "router stall time max (milliseconds): " << stall_max << std::endl
+      << "router stall time last (milliseconds): " << stall_last << std::endl;
 }
 
 void TWebRequestHandler::HandleMetadataFetchTimeRequestJson(std::ostream &os,
@@ -280,6 +295,9 @@ void TWebRequestHandler::HandleMetadataFetchTimeRequestJson(std::ostream &os,
   assert(this);
   uint64_t last_update_time = 0, last_modified_time = 0;
   metadata_timestamp.GetTimes(last_update_time, last_modified_time);
+  uint64_t stall_count = 0, stall_total = 0, stall_max = 0, stall_last = 0;
+  metadata_timestamp.GetStallStats(stall_count, stall_total, stall_max,
+      stall_last);
   uint64_t now = GetEpochMilliseconds();
   time_t start_time = GetServerStartTime();
   std::string indent_str;
@@ -293,15 +311,23 @@ void TWebRequestHandler::HandleMetadataFetchTimeRequestJson(std::ostream &os,
         << ind1 << "\"since\": " << start_time << "," << std::endl
         << ind1 << "\"now\": " << now << "," << std::endl
         << ind1 << "\"last_updated\": " << last_update_time << "," << std::endl
-        << ind1 << "\"last_modified\": " << last_modified_time
-        << std::endl;
+        << ind1 << "\"last_modified\": " << last_modified_time << ","
+        << std::endl
+        << ind1 << "\"router_stall_count\": " << stall_count << ","
+        << std::endl
+        << ind1 << "\"router_stall_ms_total\": " << stall_total << ","
+        << std::endl
+        << ind1 << "\"router_stall_ms_max\": " << stall_max << ","
+        << std::endl
+        << ind1 << "\"router_stall_ms_last\": " << stall_last << std::endl;
   }
 
   os << ind0 << "}" << std::endl;
 }
 
 void TWebRequestHandler::HandleQueueStatsRequestPlain(std::ostream &os,
-    const TMsgStateTracker &tracker) {
+    const TMsgStateTracker &tracker,
+    const Batch::TBatchAutoTuner &auto_tuner) {
   assert(this);
   std::vector<TMsgStateTracker::TTopicStatsItem> topic_stats;
   long new_count = 0;
@@ -342,10 +368,23 @@ void TWebRequestHandler::HandleQueueStatsRequestPlain(std::ostream &os,
       << (new_count + total_batch + total_send_wait + total_ack_wait)
       << " total (all states: new + batch + send_wait + ack_wait)"
       << std::endl;
+
+  if (auto_tuner.IsEnabled()) {
+    os << std::endl;
+
+    for (const auto &item : auto_tuner.GetDecisions()) {
+      os << "auto-tuned time_limit: " << std::setw(6) << item.TimeLimit
+          << "  byte_limit: " << std::setw(10) << item.ByteCount
+          << "  msg_rate: " << std::setw(10)
+          << static_cast<unsigned long>(item.MsgRate)
+          << "  topic: [" << item.Topic << "]" << std::endl;
+    }
+  }
 }
 
 void TWebRequestHandler::HandleQueueStatsRequestJson(std::ostream &os,
-    const TMsgStateTracker &tracker) {
+    const TMsgStateTracker &tracker,
+    const Batch::TBatchAutoTuner &auto_tuner) {
   assert(this);
   std::vector<TMsgStateTracker::TTopicStatsItem> topic_stats;
   long new_count = 0;
@@ -382,7 +421,9 @@ void TWebRequestHandler::HandleQueueStatsRequestJson(std::ostream &os,
               << std::endl
               << ind3 << "\"send_wait\": " << item.second.SendWaitCount << ","
               << std::endl
-              << ind3 << "\"ack_wait\": " << item.second.AckWaitCount
+              << ind3 << "\"ack_wait\": " << item.second.AckWaitCount << ","
+              << std::endl
+              << ind3 << "\"bytes\": " << item.second.QueuedBytes
               << std::endl;
         }
 
@@ -394,12 +435,744 @@ void TWebRequestHandler::HandleQueueStatsRequestJson(std::ostream &os,
     }
 
     os << ind1 << "]," << std::endl
-        << ind1 << "\"new\": " << new_count << std::endl;
+        << ind1 << "\"new\": " << new_count << "," << std::endl
+        << ind1 << "\"batch_auto_tune\": [";
+
+    {
+      TIndent ind2(ind1);
+      bool first_time = true;
+
+      for (const auto &item : auto_tuner.GetDecisions()) {
+        if (!first_time) {
+          os << "," << std::endl;
+        }
+
+        os << ind2 << "{" << std::endl;
+
+        {
+          TIndent ind3(ind2);
+          os << ind3 << "\"topic\": \"" << item.Topic << "\"," << std::endl
+              << ind3 << "\"msg_rate\": " << item.MsgRate << "," << std::endl
+              << ind3 << "\"byte_rate\": " << item.ByteRate << ","
+              << std::endl
+              << ind3 << "\"time_limit\": " << item.TimeLimit << ","
+              << std::endl
+              << ind3 << "\"byte_limit\": " << item.ByteCount << std::endl;
+        }
+
+        os << ind2 << "}";
+        first_time = false;
+      }
+
+      os << std::endl;
+    }
+
+    os << ind1 << "]" << std::endl;
+  }
+
+  os << ind0 << "}" << std::endl;
+}
+
+void TWebRequestHandler::HandleConnectionStatsRequestPlain(std::ostream &os,
+    const MsgDispatch::TConnectionStatsTracker &tracker) {
+  assert(this);
+  std::vector<MsgDispatch::TConnectionStatsTracker::TInfo> info =
+      tracker.GetInfo();
+  uint64_t now = GetEpochSeconds();
+  char now_time_buf[TIME_BUF_SIZE];
+  FillTimeBuf(now, now_time_buf);
+  time_t start_time = GetServerStartTime();
+  char start_time_buf[TIME_BUF_SIZE];
+  FillTimeBuf(start_time, start_time_buf);
+  os << "pid: " << getpid() << std::endl
+      << "version: " << dory_build_id << std::endl
+      << "since: " << start_time << " " << start_time_buf << std::endl
+      << "now: " << now << " " << now_time_buf << std::endl << std::endl;
+
+  for (const auto &item : info) {
+    os << "broker: " << std::setw(6) << item.BrokerId
+        << "  connection: " << std::setw(3) << item.ConnectionIndex
+        << "  connected: " << (item.Connected ? "yes" : " no")
+        << "  connects: " << std::setw(6) << item.ConnectCount
+        << "  ack_wait: " << std::setw(6) << item.AckWaitQueueSize
+        << std::endl
+        << "    requests_sent: " << std::setw(10) << item.RequestsSent
+        << "  msgs_sent: " << std::setw(12) << item.MsgsSent
+        << "  bytes_sent: " << std::setw(14) << item.BytesSent << std::endl
+        << "    responses_received: " << std::setw(10)
+        << item.ResponsesReceived
+        << "  bytes_received: " << std::setw(14) << item.BytesReceived
+        << std::endl
+        << "    ack_wait_bytes: " << std::setw(10) << item.AckWaitBytes
+        << "  ack_latency_us: " << std::setw(10) << item.AckLatency
+        << std::endl;
+  }
+}
+
+void TWebRequestHandler::HandleConnectionStatsRequestJson(std::ostream &os,
+    const MsgDispatch::TConnectionStatsTracker &tracker) {
+  assert(this);
+  std::vector<MsgDispatch::TConnectionStatsTracker::TInfo> info =
+      tracker.GetInfo();
+  uint64_t now = GetEpochSeconds();
+  time_t start_time = GetServerStartTime();
+  std::string indent_str;
+  TIndent ind0(indent_str, TIndent::StartAt::Zero, 4);
+  os << ind0 << "{" << std::endl;
+
+  {
+    TIndent ind1(ind0);
+    os << ind1 << "\"pid\": " << getpid() << "," << std::endl
+        << ind1 << "\"version\": \"" << dory_build_id << "\"," << std::endl
+        << ind1 << "\"since\": " << start_time << "," << std::endl
+        << ind1 << "\"now\": " << now << "," << std::endl
+        << ind1 << "\"connections\": [" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      bool first_time = true;
+
+      for (const auto &item : info) {
+        if (!first_time) {
+          os << "," << std::endl;
+        }
+
+        os << ind2 << "{" << std::endl;
+
+        {
+          TIndent ind3(ind2);
+          os << ind3 << "\"broker\": " << item.BrokerId << "," << std::endl
+              << ind3 << "\"connection\": " << item.ConnectionIndex << ","
+              << std::endl
+              << ind3 << "\"connected\": "
+              << (item.Connected ? "true" : "false") << "," << std::endl
+              << ind3 << "\"connects\": " << item.ConnectCount << ","
+              << std::endl
+              << ind3 << "\"requests_sent\": " << item.RequestsSent << ","
+              << std::endl
+              << ind3 << "\"msgs_sent\": " << item.MsgsSent << ","
+              << std::endl
+              << ind3 << "\"bytes_sent\": " << item.BytesSent << ","
+              << std::endl
+              << ind3 << "\"responses_received\": "
+              << item.ResponsesReceived << "," << std::endl
+              << ind3 << "\"bytes_received\": " << item.BytesReceived << ","
+              << std::endl
+              << ind3 << "\"ack_wait\": " << item.AckWaitQueueSize << ","
+              << std::endl
+              << ind3 << "\"ack_wait_bytes\": " << item.AckWaitBytes << ","
+              << std::endl
+              << ind3 << "\"ack_latency_us\": " << item.AckLatency
+              << std::endl;
+        }
+
+        os << ind2 << "}";
+        first_time = false;
+      }
+
+      if (!first_time) {
+        os << std::endl;
+      }
+    }
+
+    os << ind1 << "]" << std::endl;
+  }
+
+  os << ind0 << "}" << std::endl;
+}
+
+void TWebRequestHandler::HandleBrokerStatsRequestJson(std::ostream &os,
+    const MsgDispatch::TConnectionStatsTracker &tracker) {
+  assert(this);
+  std::vector<MsgDispatch::TConnectionStatsTracker::TInfo> info =
+      tracker.GetInfo();
+  uint64_t now = GetEpochSeconds();
+  time_t start_time = GetServerStartTime();
+  std::string indent_str;
+  TIndent ind0(indent_str, TIndent::StartAt::Zero, 4);
+  os << ind0 << "{" << std::endl;
+
+  {
+    TIndent ind1(ind0);
+    os << ind1 << "\"pid\": " << getpid() << "," << std::endl
+        << ind1 << "\"version\": \"" << dory_build_id << "\"," << std::endl
+        << ind1 << "\"since\": " << start_time << "," << std::endl
+        << ind1 << "\"now\": " << now << "," << std::endl
+        << ind1 << "\"brokers\": [" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      bool first_time = true;
+
+      /* 'info' is ordered by broker ID, so each broker's connections are
+         adjacent. */
+      for (size_t begin = 0, end = 0; begin < info.size(); begin = end) {
+        int32_t broker_id = info[begin].BrokerId;
+        size_t connected = 0;
+        uint64_t in_flight_requests = 0;
+        uint64_t in_flight_bytes = 0;
+        uint64_t unsent_bytes = 0;
+        THistogram rtt;
+
+        for (end = begin;
+             (end < info.size()) && (info[end].BrokerId == broker_id);
+             ++end) {
+          const auto &item = info[end];
+
+          if (item.Connected) {
+            ++connected;
+          }
+
+          in_flight_requests += item.AckWaitQueueSize;
+          in_flight_bytes += item.AckWaitBytes;
+          unsent_bytes += item.SendBufBytes;
+          rtt.Merge(item.AckRtt);
+        }
+
+        if (!first_time) {
+          os << "," << std::endl;
+        }
+
+        os << ind2 << "{" << std::endl;
+
+        {
+          TIndent ind3(ind2);
+          os << ind3 << "\"broker\": " << broker_id << "," << std::endl
+              << ind3 << "\"connected\": " << connected << "," << std::endl
+              << ind3 << "\"in_flight_requests\": " << in_flight_requests
+              << "," << std::endl
+              << ind3 << "\"in_flight_bytes\": " << in_flight_bytes << ","
+              << std::endl
+              << ind3 << "\"unsent_bytes\": " << unsent_bytes << ","
+              << std::endl
+              << ind3 << "\"rtt_us\": ";
+          WriteHistogramJson(os, rtt, ind3);
+          os << "," << std::endl
+              << ind3 << "\"connections\": [" << std::endl;
+
+          for (size_t i = begin; i < end; ++i) {
+            WriteConnectionStatsJson(os, info[i], ind3);
+            os << ((i + 1 < end) ? "," : "") << std::endl;
+          }
+
+          os << ind3 << "]" << std::endl;
+        }
+
+        os << ind2 << "}";
+        first_time = false;
+      }
+
+      if (!first_time) {
+        os << std::endl;
+      }
+    }
+
+    os << ind1 << "]" << std::endl;
+  }
+
+  os << ind0 << "}" << std::endl;
+}
+
+void TWebRequestHandler::HandleLatencyStatsRequestJson(std::ostream &os,
+    const TLatencyTracker &tracker) {
+  assert(this);
+  TLatencyTracker::TSnapshot snapshot = tracker.GetSnapshot();
+  uint64_t now = GetEpochSeconds();
+  time_t start_time = GetServerStartTime();
+  std::string indent_str;
+  TIndent ind0(indent_str, TIndent::StartAt::Zero, 4);
+  os << ind0 << "{" << std::endl;
+
+  {
+    TIndent ind1(ind0);
+    os << ind1 << "\"pid\": " << getpid() << "," << std::endl
+        << ind1 << "\"version\": \"" << dory_build_id << "\"," << std::endl
+        << ind1 << "\"since\": " << start_time << "," << std::endl
+        << ind1 << "\"now\": " << now << "," << std::endl
+        << ind1 << "\"all_topics\": {";
+
+    {
+      TIndent ind2(ind1);
+      WriteLatencyStatsJson(os, snapshot.AllTopics, ind2, false);
+    }
+
+    os << ind1 << "}," << std::endl
+        << ind1 << "\"topics\": [" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      bool first_time = true;
+
+      for (const auto &item : snapshot.Topics) {
+        if (!first_time) {
+          os << "," << std::endl;
+        }
+
+        os << ind2 << "{" << std::endl;
+
+        {
+          TIndent ind3(ind2);
+          os << ind3 << "\"topic\": \"" << item.first << "\"";
+          WriteLatencyStatsJson(os, item.second, ind3);
+        }
+
+        os << ind2 << "}";
+        first_time = false;
+      }
+
+      if (!first_time) {
+        os << std::endl;
+      }
+    }
+
+    os << ind1 << "]," << std::endl
+        << ind1 << "\"brokers\": [" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      bool first_time = true;
+
+      for (const auto &item : snapshot.Brokers) {
+        if (!first_time) {
+          os << "," << std::endl;
+        }
+
+        os << ind2 << "{" << std::endl;
+
+        {
+          TIndent ind3(ind2);
+          os << ind3 << "\"broker\": " << item.first;
+          WriteLatencyStatsJson(os, item.second, ind3);
+        }
+
+        os << ind2 << "}";
+        first_time = false;
+      }
+
+      if (!first_time) {
+        os << std::endl;
+      }
+    }
+
+    os << ind1 << "]" << std::endl;
+  }
+
+  os << ind0 << "}" << std::endl;
+}
+
+void TWebRequestHandler::HandleBatchStatsRequestJson(std::ostream &os,
+    const Batch::TBatchStats &stats) {
+  assert(this);
+  Batch::TBatchStats::TSnapshot snapshot = stats.GetSnapshot();
+  uint64_t now = GetEpochSeconds();
+  time_t start_time = GetServerStartTime();
+  std::string indent_str;
+  TIndent ind0(indent_str, TIndent::StartAt::Zero, 4);
+  os << ind0 << "{" << std::endl;
+
+  {
+    TIndent ind1(ind0);
+    os << ind1 << "\"pid\": " << getpid() << "," << std::endl
+        << ind1 << "\"version\": \"" << dory_build_id << "\"," << std::endl
+        << ind1 << "\"since\": " << start_time << "," << std::endl
+        << ind1 << "\"now\": " << now << "," << std::endl
+        << ind1 << "\"topics\": [" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      bool first_time = true;
+
+      for (const auto &item : snapshot.Topics) {
+        if (!first_time) {
+          os << "," << std::endl;
+        }
+
+        os << ind2 << "{" << std::endl;
+
+        {
+          TIndent ind3(ind2);
+          os << ind3 << "\"topic\": \"" << item.first << "\"";
+          WriteBatchStatsJson(os, item.second, ind3);
+        }
+
+        os << ind2 << "}";
+        first_time = false;
+      }
+
+      if (!first_time) {
+        os << std::endl;
+      }
+    }
+
+    os << ind1 << "]," << std::endl
+        << ind1 << "\"brokers\": [" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      bool first_time = true;
+
+      for (const auto &item : snapshot.Brokers) {
+        if (!first_time) {
+          os << "," << std::endl;
+        }
+
+        os << ind2 << "{" << std::endl;
+
+        {
+          TIndent ind3(ind2);
+          os << ind3 << "\"broker\": " << item.first;
+          WriteBatchStatsJson(os, item.second, ind3);
+        }
+
+        os << ind2 << "}";
+        first_time = false;
+      }
+
+      if (!first_time) {
+        os << std::endl;
+      }
+    }
+
+    os << ind1 << "]," << std::endl
+        << ind1 << "\"produce_requests\": [" << std::endl;
+
+    {
+      TIndent ind2(ind1);
+      bool first_time = true;
+
+      for (const auto &item : snapshot.Requests) {
+        if (!first_time) {
+          os << "," << std::endl;
+        }
+
+        const Batch::TBatchStats::TRequestInfo &info = item.second;
+        os << ind2 << "{" << std::endl;
+
+        {
+          TIndent ind3(ind2);
+          os << ind3 << "\"broker\": " << item.first << "," << std::endl
+              << ind3 << "\"data_limit\": " << info.DataLimit << ","
+              << std::endl
+              << ind3 << "\"limit_reached\": " << info.LimitReachedCount
+              << "," << std::endl
+              << ind3 << "\"data_bytes\": ";
+          WriteHistogramJson(os, info.DataBytes, ind3);
+          os << "," << std::endl << ind3 << "\"fill_percent\": ";
+          WriteHistogramJson(os, info.FillPercent, ind3);
+          os << std::endl;
+        }
+
+        os << ind2 << "}";
+        first_time = false;
+      }
+
+      if (!first_time) {
+        os << std::endl;
+      }
+    }
+
+    os << ind1 << "]" << std::endl;
+  }
+
+  os << ind0 << "}" << std::endl;
+}
+
+/* Write a metric family with one sample per broker connection in 'info'.
+   'get_value' maps an item of 'info' to its value. */
+template <typename TGetValue>
+static void WriteConnectionFamily(TOpenMetricsWriter &writer,
+    const std::vector<MsgDispatch::TConnectionStatsTracker::TInfo> &info,
+    const char *name, TOpenMetricsWriter::TType type, const char *help,
+    TGetValue get_value) {
+  writer.StartFamily(name, type, help);
+
+  for (const auto &item : info) {
+    writer.WriteSample({{"broker", std::to_string(item.BrokerId)},
+        {"connection", std::to_string(item.ConnectionIndex)}},
+        get_value(item));
+  }
+}
+
+/* Write a counter family with one sample per topic in 'totals', using the
+   member of TTopicTotals given by 'field'.  Counts for topics beyond the limit
+   that TAnomalyTracker keeps totals for are reported with an empty topic
+   label. */
+static void WriteTopicTotalsFamily(TOpenMetricsWriter &writer,
+    const TAnomalyTracker::TTotals &totals, const char *name,
+    const char *help, uint64_t TAnomalyTracker::TTopicTotals::*field) {
+  writer.StartFamily(name, TOpenMetricsWriter::TType::Counter, help);
+
+  for (const auto &item : totals.Topics) {
+    writer.WriteSample({{"topic", item.first}}, item.second.*field);
+  }
+
+  if (totals.OtherTopics.*field) {
+    writer.WriteSample({{"topic", ""}}, totals.OtherTopics.*field);
+  }
+}
+
+void TWebRequestHandler::HandlePoolStatsRequestJson(std::ostream &os,
+    const TPoolMonitor &pool_monitor, const TMsgStateTracker &tracker) {
+  assert(this);
+  const Capped::TPool &pool = pool_monitor.GetPool();
+  std::vector<TMsgStateTracker::TTopicStatsItem> topic_stats;
+  long new_count = 0;
+  tracker.GetStats(topic_stats, new_count);
+
+  /* List the topics using the most buffer space first. */
+  std::sort(topic_stats.begin(), topic_stats.end(),
+      [](const TMsgStateTracker::TTopicStatsItem &x,
+         const TMsgStateTracker::TTopicStatsItem &y) {
+        return x.second.QueuedBytes > y.second.QueuedBytes;
+      });
+  long total_bytes = 0;
+
+  for (const auto &item : topic_stats) {
+    total_bytes += item.second.QueuedBytes;
+  }
+
+  uint64_t now = GetEpochSeconds();
+  time_t start_time = GetServerStartTime();
+  std::string indent_str;
+  TIndent ind0(indent_str, TIndent::StartAt::Zero, 4);
+  os << ind0 << "{" << std::endl;
+
+  {
+    TIndent ind1(ind0);
+    os << ind1 << "\"pid\": " << getpid() << "," << std::endl
+        << ind1 << "\"version\": \"" << dory_build_id << "\"," << std::endl
+        << ind1 << "\"since\": " << start_time << "," << std::endl
+        << ind1 << "\"now\": " << now << "," << std::endl
+        << ind1 << "\"block_size\": " << pool.GetBlockSize() << ","
+        << std::endl
+        << ind1 << "\"blocks\": " << pool.GetBlockCount() << "," << std::endl
+        << ind1 << "\"allocated_blocks\": " << pool.GetAllocatedBlockCount()
+        << "," << std::endl
+        << ind1 << "\"high_water_mark\": " << pool.GetHighWaterMark() << ","
+        << std::endl
+        << ind1 << "\"high_water_mark_since\": "
+        << pool_monitor.GetHighWaterMarkResetTime() << "," << std::endl
+        << ind1 << "\"queued_bytes\": " << total_bytes << "," << std::endl
+        << ind1 << "\"topics\": [";
+
+    {
+      TIndent ind2(ind1);
+      bool first_time = true;
+
+      for (const auto &item : topic_stats) {
+        if (!first_time) {
+          os << "," << std::endl;
+        }
+
+        os << ind2 << "{" << std::endl;
+
+        {
+          TIndent ind3(ind2);
+          os << ind3 << "\"topic\": \"" << item.first << "\"," << std::endl
+              << ind3 << "\"msgs\": " << (item.second.BatchingCount +
+                  item.second.SendWaitCount + item.second.AckWaitCount)
+              << "," << std::endl
+              << ind3 << "\"bytes\": " << item.second.QueuedBytes
+              << std::endl;
+        }
+
+        os << ind2 << "}";
+        first_time = false;
+      }
+
+      os << std::endl;
+    }
+
+    os << ind1 << "]" << std::endl;
   }
 
   os << ind0 << "}" << std::endl;
 }
 
+void TWebRequestHandler::HandleMetricsRequest(std::ostream &os,
+    const TMsgStateTracker &msg_state_tracker,
+    const TAnomalyTracker &anomaly_tracker, const TPoolMonitor &pool_monitor,
+    const MsgDispatch::TConnectionStatsTracker &connection_stats) {
+  assert(this);
+  const Capped::TPool &pool = pool_monitor.GetPool();
+  using TType = TOpenMetricsWriter::TType;
+  using TInfo = MsgDispatch::TConnectionStatsTracker::TInfo;
+  TOpenMetricsWriter writer(os);
+  writer.StartFamily("dory_build_info", TType::Gauge,
+      "Dory build information.");
+  writer.WriteSample({{"version", dory_build_id}}, static_cast<uint64_t>(1));
+  writer.StartFamily("dory_start_time_seconds", TType::Gauge,
+      "Time when Dory started, in seconds since the epoch.");
+  writer.WriteSample(static_cast<uint64_t>(GetServerStartTime()));
+
+  TCounter::Sample();
+  writer.StartFamily("dory_counter", TType::Counter,
+      "Values of Dory's internal event counters.");
+
+  for (const TCounter *counter = TCounter::GetFirstCounter();
+       counter != nullptr;
+       counter = counter->GetNextCounter()) {
+    writer.WriteSample({{"name", counter->GetName()},
+        {"file", counter->GetCodeLocation().GetFile()}},
+        counter->GetCount());
+  }
+
+  std::vector<TMsgStateTracker::TTopicStatsItem> topic_stats;
+  long new_count = 0;
+  msg_state_tracker.GetStats(topic_stats, new_count);
+  writer.StartFamily("dory_new_msgs", TType::Gauge,
+      "Messages received but not yet assigned to a topic queue.");
+  writer.WriteSample(static_cast<uint64_t>(new_count));
+  writer.StartFamily("dory_queued_msgs", TType::Gauge,
+      "Messages queued for sending, by topic and state.");
+
+  for (const auto &item : topic_stats) {
+    writer.WriteSample({{"topic", item.first}, {"state", "batch"}},
+        static_cast<uint64_t>(item.second.BatchingCount));
+    writer.WriteSample({{"topic", item.first}, {"state", "send_wait"}},
+        static_cast<uint64_t>(item.second.SendWaitCount));
+    writer.WriteSample({{"topic", item.first}, {"state", "ack_wait"}},
+        static_cast<uint64_t>(item.second.AckWaitCount));
+  }
+
+  writer.StartFamily("dory_queued_bytes", TType::Gauge,
+      "Bytes of message keys and values queued for sending, by topic.");
+
+  for (const auto &item : topic_stats) {
+    writer.WriteSample({{"topic", item.first}},
+        static_cast<uint64_t>(item.second.QueuedBytes));
+  }
+
+  /* Free the topic stats before getting more data. */
+  topic_stats.clear();
+  topic_stats.shrink_to_fit();
+
+  writer.StartFamily("dory_buffer_pool_block_size_bytes", TType::Gauge,
+      "Size of each block in the message buffer pool.");
+  writer.WriteSample(static_cast<uint64_t>(pool.GetBlockSize()));
+  writer.StartFamily("dory_buffer_pool_blocks", TType::Gauge,
+      "Total number of blocks in the message buffer pool.");
+  writer.WriteSample(static_cast<uint64_t>(pool.GetBlockCount()));
+  writer.StartFamily("dory_buffer_pool_allocated_blocks", TType::Gauge,
+      "Number of message buffer pool blocks currently in use.");
+  writer.WriteSample(static_cast<uint64_t>(pool.GetAllocatedBlockCount()));
+  writer.StartFamily("dory_buffer_pool_high_water_mark_blocks", TType::Gauge,
+      "Most message buffer pool blocks in use at once since the high water "
+      "mark was last reset.");
+  writer.WriteSample(static_cast<uint64_t>(pool.GetHighWaterMark()));
+
+  std::vector<TInfo> info = connection_stats.GetInfo();
+  WriteConnectionFamily(writer, info, "dory_broker_connected", TType::Gauge,
+      "1 if the connection to the broker is open, else 0.",
+      [](const TInfo &item) -> uint64_t {
+        return item.Connected ? 1 : 0;
+      });
+  WriteConnectionFamily(writer, info, "dory_broker_connects",
+      TType::Counter, "Successful connects to the broker.",
+      [](const TInfo &item) { return item.ConnectCount; });
+  WriteConnectionFamily(writer, info, "dory_broker_requests_sent",
+      TType::Counter, "Produce requests sent to the broker.",
+      [](const TInfo &item) { return item.RequestsSent; });
+  WriteConnectionFamily(writer, info, "dory_broker_msgs_sent",
+      TType::Counter, "Messages in produce requests sent to the broker.",
+      [](const TInfo &item) { return item.MsgsSent; });
+  WriteConnectionFamily(writer, info, "dory_broker_sent_bytes",
+      TType::Counter, "Bytes sent to the broker.",
+      [](const TInfo &item) { return item.BytesSent; });
+  WriteConnectionFamily(writer, info, "dory_broker_responses_received",
+      TType::Counter, "Produce responses received from the broker.",
+      [](const TInfo &item) { return item.ResponsesReceived; });
+  WriteConnectionFamily(writer, info, "dory_broker_received_bytes",
+      TType::Counter, "Bytes received from the broker.",
+      [](const TInfo &item) { return item.BytesReceived; });
+  WriteConnectionFamily(writer, info, "dory_broker_ack_wait_requests",
+      TType::Gauge, "Produce requests waiting for a response.",
+      [](const TInfo &item) { return item.AckWaitQueueSize; });
+  WriteConnectionFamily(writer, info, "dory_broker_ack_wait_bytes",
+      TType::Gauge, "Bytes of produce requests waiting for a response.",
+      [](const TInfo &item) { return item.AckWaitBytes; });
+  WriteConnectionFamily(writer, info, "dory_broker_connect_failures",
+      TType::Counter, "Failed attempts to connect to the broker.",
+      [](const TInfo &item) { return item.ConnectFailCount; });
+  WriteConnectionFamily(writer, info, "dory_broker_reconnects",
+      TType::Counter, "Connects to the broker after losing the connection.",
+      [](const TInfo &item) { return item.ReconnectCount; });
+  WriteConnectionFamily(writer, info, "dory_broker_reconnect_seconds",
+      TType::Counter, "Time spent reconnecting after losing the connection.",
+      [](const TInfo &item) {
+        return static_cast<double>(item.ReconnectTime) / 1000000.0;
+      });
+  WriteConnectionFamily(writer, info, "dory_broker_request_bytes",
+      TType::Counter, "Size of produce requests sent to the broker.",
+      [](const TInfo &item) { return item.RequestBytes; });
+  WriteConnectionFamily(writer, info,
+      "dory_broker_uncompressed_request_bytes", TType::Counter,
+      "Size of produce requests sent to the broker, before compression.",
+      [](const TInfo &item) { return item.UncompressedRequestBytes; });
+  WriteConnectionFamily(writer, info, "dory_broker_send_stalls",
+      TType::Counter, "Times the connection's socket send buffer filled up.",
+      [](const TInfo &item) { return item.SendStallCount; });
+  WriteConnectionFamily(writer, info, "dory_broker_send_stall_seconds",
+      TType::Counter, "Time spent waiting for the socket to become writable.",
+      [](const TInfo &item) {
+        return static_cast<double>(item.SendStallTime) / 1000000.0;
+      });
+  WriteConnectionFamily(writer, info, "dory_broker_ack_latency_seconds",
+      TType::Gauge, "Moving average of produce response latency.",
+      [](const TInfo &item) {
+        return static_cast<double>(item.AckLatency) / 1000000.0;
+      });
+  info.clear();
+  info.shrink_to_fit();
+
+  {
+    std::vector<TMsgStateTracker::TDeliveredItem> delivered;
+    uint64_t other_topics_delivered = 0;
+    msg_state_tracker.GetDeliveredCounts(delivered, other_topics_delivered);
+    writer.StartFamily("dory_delivered_msgs", TType::Counter,
+        "Messages delivered to Kafka, by topic.");
+
+    for (const auto &item : delivered) {
+      writer.WriteSample({{"topic", item.first}}, item.second);
+    }
+
+    if (other_topics_delivered) {
+      writer.WriteSample({{"topic", ""}}, other_topics_delivered);
+    }
+  }
+
+  TAnomalyTracker::TTotals totals;
+  anomaly_tracker.GetTotals(totals);
+  WriteTopicTotalsFamily(writer, totals, "dory_discarded_msgs",
+      "Messages with valid topics discarded.",
+      &TAnomalyTracker::TTopicTotals::DiscardCount);
+  WriteTopicTotalsFamily(writer, totals, "dory_rate_limit_discarded_msgs",
+      "Messages discarded due to rate limiting.",
+      &TAnomalyTracker::TTopicTotals::RateLimitDiscardCount);
+  WriteTopicTotalsFamily(writer, totals, "dory_possible_duplicate_msgs",
+      "Messages possibly sent more than once.",
+      &TAnomalyTracker::TTopicTotals::DuplicateCount);
+  writer.StartFamily("dory_input_discarded_msgs", TType::Counter,
+      "Input messages discarded before a topic was known, by reason.");
+  writer.WriteSample({{"reason", "malformed"}}, totals.MalformedMsgCount);
+  writer.WriteSample({{"reason", "unsupported_api_key"}},
+      totals.UnsupportedApiKeyMsgCount);
+  writer.WriteSample({{"reason", "unsupported_version"}},
+      totals.UnsupportedVersionMsgCount);
+  writer.WriteSample({{"reason", "bad_topic"}}, totals.BadTopicMsgCount);
+  writer.StartFamily("dory_unclean_disconnects", TType::Counter,
+      "Stream clients that disconnected while sending a message.");
+  writer.WriteSample({{"transport", "unix_stream"}},
+      totals.UnixStreamUncleanDisconnectCount);
+  writer.WriteSample({{"transport", "tcp"}}, totals.TcpUncleanDisconnectCount);
+  writer.Finish();
+}
+
+void TWebRequestHandler::HandleTraceRequest(std::ostream &os) {
+  assert(this);
+  TEventTrace::WriteChromeTraceJson(os);
+}
+
 void TWebRequestHandler::HandleGetDebugTopicsRequest(std::ostream &os,
     const Debug::TDebugSetup &debug_setup) {
   assert(this);
@@ -472,6 +1245,17 @@ void TWebRequestHandler::HandleMetadataUpdateRequest(std::ostream &os,
       << std::endl;
 }
 
+void TWebRequestHandler::HandlePoolResetHighWaterMarkRequest(std::ostream &os,
+    TPoolMonitor &pool_monitor) {
+  assert(this);
+  size_t old_mark = pool_monitor.ResetHighWaterMark();
+  uint64_t now = pool_monitor.GetHighWaterMarkResetTime();
+  char time_buf[TIME_BUF_SIZE];
+  FillTimeBuf(now, time_buf);
+  os << "Buffer pool high water mark reset at " << now << " " << time_buf
+      << " (previous value " << old_mark << " blocks)" << std::endl;
+}
+
 void TWebRequestHandler::WriteDiscardReportPlain(std::ostream &os,
     const TAnomalyTracker::TInfo &info) {
   assert(this);
@@ -884,3 +1668,112 @@ void TWebRequestHandler::WriteDiscardReportJson(std::ostream &os,
 
   os << ind0 << "]" << std::endl;
 }
+
+void TWebRequestHandler::WriteLatencyStatsJson(std::ostream &os,
+    const TLatencyTracker::THistograms &histograms, TIndent &ind0,
+    bool continue_object) {
+  assert(this);
+  bool need_comma = continue_object;
+
+  /* Write one field for each stage with recorded values, then end the
+     line. */
+  for (size_t i = 0; i < histograms.size(); ++i) {
+    const THistogram &h = histograms[i];
+
+    if (h.IsEmpty()) {
+      continue;
+    }
+
+    os << (need_comma ? "," : "") << std::endl << ind0 << "\""
+        << TLatencyTracker::StageToString(
+               static_cast<TLatencyTracker::TStage>(i))
+        << "_us\": ";
+    WriteHistogramJson(os, h, ind0);
+    need_comma = true;
+  }
+
+  os << std::endl;
+}
+
+void TWebRequestHandler::WriteBatchStatsJson(std::ostream &os,
+    const Batch::TBatchStats::TBatchInfo &info, TIndent &ind0) {
+  assert(this);
+
+  /* The caller has written the first field of the enclosing object, without
+     a trailing comma. */
+  os << "," << std::endl << ind0 << "\"completed_by\": {" << std::endl;
+
+  {
+    TIndent ind1(ind0);
+
+    for (size_t i = 0; i < info.CompletionCounts.size(); ++i) {
+      os << ind1 << "\""
+          << Batch::TBatchStats::ReasonToString(
+                 static_cast<Batch::TBatchStats::TCompletionReason>(i))
+          << "\": " << info.CompletionCounts[i]
+          << (((i + 1) < info.CompletionCounts.size()) ? "," : "")
+          << std::endl;
+    }
+  }
+
+  os << ind0 << "}," << std::endl << ind0 << "\"batch_msgs\": ";
+  WriteHistogramJson(os, info.MsgCounts, ind0);
+  os << "," << std::endl << ind0 << "\"batch_bytes\": ";
+  WriteHistogramJson(os, info.ByteCounts, ind0);
+  os << std::endl;
+}
+
+void TWebRequestHandler::WriteConnectionStatsJson(std::ostream &os,
+    const MsgDispatch::TConnectionStatsTracker::TInfo &info, TIndent &ind0) {
+  assert(this);
+  TIndent ind1(ind0);
+  os << ind1 << "{" << std::endl;
+
+  {
+    TIndent ind2(ind1);
+    os << ind2 << "\"connection\": " << info.ConnectionIndex << ","
+        << std::endl
+        << ind2 << "\"connected\": " << (info.Connected ? "true" : "false")
+        << "," << std::endl
+        << ind2 << "\"connects\": " << info.ConnectCount << "," << std::endl
+        << ind2 << "\"connect_failures\": " << info.ConnectFailCount << ","
+        << std::endl
+        << ind2 << "\"reconnects\": " << info.ReconnectCount << ","
+        << std::endl
+        << ind2 << "\"reconnect_time_us\": " << info.ReconnectTime << ","
+        << std::endl
+        << ind2 << "\"last_reconnect_time_us\": " << info.LastReconnectTime
+        << "," << std::endl
+        << ind2 << "\"requests_sent\": " << info.RequestsSent << ","
+        << std::endl
+        << ind2 << "\"msgs_sent\": " << info.MsgsSent << "," << std::endl
+        << ind2 << "\"bytes_sent\": " << info.BytesSent << "," << std::endl
+        << ind2 << "\"responses_received\": " << info.ResponsesReceived
+        << "," << std::endl
+        << ind2 << "\"bytes_received\": " << info.BytesReceived << ","
+        << std::endl
+        << ind2 << "\"in_flight_requests\": " << info.AckWaitQueueSize << ","
+        << std::endl
+        << ind2 << "\"in_flight_bytes\": " << info.AckWaitBytes << ","
+        << std::endl
+        << ind2 << "\"unsent_bytes\": " << info.SendBufBytes << ","
+        << std::endl
+        << ind2 << "\"request_bytes\": " << info.RequestBytes << ","
+        << std::endl
+        << ind2 << "\"uncompressed_request_bytes\": "
+        << info.UncompressedRequestBytes << "," << std::endl
+        << ind2 << "\"max_request_bytes\": " << info.MaxRequestBytes << ","
+        << std::endl
+        << ind2 << "\"send_stalls\": " << info.SendStallCount << ","
+        << std::endl
+        << ind2 << "\"send_stall_time_us\": " << info.SendStallTime << ","
+        << std::endl
+        << ind2 << "\"ack_latency_us\": " << info.AckLatency << ","
+        << std::endl
+        << ind2 << "\"rtt_us\": ";
+    WriteHistogramJson(os, info.AckRtt, ind2);
+    os << std::endl;
+  }
+
+  os << ind1 << "}";
+}
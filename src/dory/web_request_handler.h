@@ -27,9 +27,15 @@
 #include <base/indent.h>
 #include <base/no_copy_semantics.h>
 #include <dory/anomaly_tracker.h>
+#include <dory/batch/batch_auto_tuner.h>
+#include <dory/batch/batch_stats.h>
 #include <dory/debug/debug_setup.h>
+#include <dory/latency_tracker.h>
 #include <dory/metadata_timestamp.h>
+#include <dory/msg_dispatch/connection_stats.h>
 #include <dory/msg_state_tracker.h>
+#include <dory/pool_monitor.h>
+#include <dory/util/histogram.h>
 
 namespace Dory {
 
@@ -60,10 +66,43 @@ namespace Dory {
         const TMetadataTimestamp &metadata_timestamp);
 
     void HandleQueueStatsRequestPlain(std::ostream &os,
-        const TMsgStateTracker &tracker);
+        const TMsgStateTracker &tracker,
+        const Batch::TBatchAutoTuner &auto_tuner);
 
     void HandleQueueStatsRequestJson(std::ostream &os,
-        const TMsgStateTracker &tracker);
+        const TMsgStateTracker &tracker,
+        const Batch::TBatchAutoTuner &auto_tuner);
+
+    void HandleConnectionStatsRequestPlain(std::ostream &os,
+        const MsgDispatch::TConnectionStatsTracker &tracker);
+
+    void HandleConnectionStatsRequestJson(std::ostream &os,
+        const MsgDispatch::TConnectionStatsTracker &tracker);
+
+    void HandleBrokerStatsRequestJson(std::ostream &os,
+        const MsgDispatch::TConnectionStatsTracker &tracker);
+
+    void HandleLatencyStatsRequestJson(std::ostream &os,
+        const TLatencyTracker &tracker);
+
+    void HandleBatchStatsRequestJson(std::ostream &os,
+        const Batch::TBatchStats &stats);
+
+    void HandlePoolStatsRequestJson(std::ostream &os,
+        const TPoolMonitor &pool_monitor, const TMsgStateTracker &tracker);
+
+    /* Write metrics in the OpenMetrics text format.  Output is written to
+       'os' as it is generated, so 'os' may send it directly to the client. */
+    void HandleMetricsRequest(std::ostream &os,
+        const TMsgStateTracker &msg_state_tracker,
+        const TAnomalyTracker &anomaly_tracker,
+        const TPoolMonitor &pool_monitor,
+        const MsgDispatch::TConnectionStatsTracker &connection_stats);
+
+    /* Write a snapshot of all threads' event traces in the Chrome trace event
+       format.  As with HandleMetricsRequest(), output is written to 'os' as
+       it is generated. */
+    void HandleTraceRequest(std::ostream &os);
 
     void HandleGetDebugTopicsRequest(std::ostream &os,
         const Debug::TDebugSetup &debug_setup);
@@ -86,12 +125,29 @@ namespace Dory {
     void HandleMetadataUpdateRequest(std::ostream &os,
         Base::TEventSemaphore &update_request_sem);
 
+    void HandlePoolResetHighWaterMarkRequest(std::ostream &os,
+        TPoolMonitor &pool_monitor);
+
     private:
     void WriteDiscardReportPlain(std::ostream &os,
         const TAnomalyTracker::TInfo &info);
 
     void WriteDiscardReportJson(std::ostream &os,
         const TAnomalyTracker::TInfo &info, Base::TIndent &ind0);
+
+    /* If 'continue_object' is true, the caller has written the first field
+       of the enclosing object, without a trailing comma.  Otherwise the
+       caller has just written the object's opening brace. */
+    void WriteLatencyStatsJson(std::ostream &os,
+        const TLatencyTracker::THistograms &histograms, Base::TIndent &ind0,
+        bool continue_object = true);
+
+    void WriteBatchStatsJson(std::ostream &os,
+        const Batch::TBatchStats::TBatchInfo &info, Base::TIndent &ind0);
+
+    void WriteConnectionStatsJson(std::ostream &os,
+        const MsgDispatch::TConnectionStatsTracker::TInfo &info,
+        Base::TIndent &ind0);
   };  // TWebRequestHandler
 
 }  // Dory
@@ -21,28 +21,33 @@
 
 #include <server/counter.h>
 
-#include <server/exclusive_lock.h>
-
 using namespace Base;
 using namespace Server;
 
 TCounter::TCounter(const TCodeLocation &code_location, const char *name)
     : CodeLocation(code_location),
       Name(name),
-      UnsampledCount(0),
+      SampledTotal(0),
+      ResetBase(0),
       SampledCount(0) {
   assert(name);
+
+  for (TShard &shard : Shards) {
+    shard.Count = 0;
+  }
+
   NextCounter = FirstCounter;
   FirstCounter = this;
 }
 
 time_t TCounter::Reset() {
-  TExclusiveLock<TBlockingAsset> lock(Asset);
+  std::lock_guard<std::mutex> lock(SampleMutex);
   ResetTime = time(0);
 
   for (TCounter *counter = FirstCounter;
        counter;
        counter = counter->NextCounter) {
+    counter->ResetBase = counter->SampledTotal;
     counter->SampledCount = 0;
   }
 
@@ -50,18 +55,39 @@ time_t TCounter::Reset() {
 }
 
 void TCounter::Sample() {
-  TExclusiveLock<TBlockingAsset> lock(Asset);
+  std::lock_guard<std::mutex> lock(SampleMutex);
   SampleTime = time(0);
 
+  for (TShardLock &shard_lock : ShardLocks) {
+    shard_lock.Mutex.lock();
+  }
+
   for (TCounter *counter = FirstCounter;
        counter;
        counter = counter->NextCounter) {
-    counter->SampledCount += counter->UnsampledCount;
-    counter->UnsampledCount = 0;
+    counter->SampledTotal = counter->SumShards();
+    counter->SampledCount = counter->SampledTotal - counter->ResetBase;
+  }
+
+  for (TShardLock &shard_lock : ShardLocks) {
+    shard_lock.Mutex.unlock();
   }
 }
 
-TBlockingAsset TCounter::Asset;
+uint64_t TCounter::SumShards() const {
+  assert(this);
+  uint64_t sum = 0;
+
+  for (const TShard &shard : Shards) {
+    sum += shard.Count;
+  }
+
+  return sum;
+}
+
+std::mutex TCounter::SampleMutex;
+
+TCounter::TShardLock TCounter::ShardLocks[TThreadShard::COUNT];
 
 TCounter *TCounter::FirstCounter = 0;
 
@@ -22,13 +22,14 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <ctime>
+#include <mutex>
 
 #include <base/code_location.h>
 #include <base/no_copy_semantics.h>
-#include <server/blocking_asset.h>
-#include <server/shared_lock.h>
+#include <base/thread_shard.h>
 
 /* A macro to simplify declaring counters. */
 #define SERVER_COUNTER(name) static ::Server::TCounter name(HERE, #name);
@@ -78,8 +79,7 @@ namespace Server {
         }
 
      You may also call Reset(), which resets all the sampled values to zero.
-     Doing this periodically helps to avoid overflows; however, the counters
-     are unsigned 32-bit numbers, so don't sweat it.
+     The counters are unsigned 64-bit numbers, so overflow isn't a concern.
 
      You may also call GetSampleTime() to get the time at which the counters
      were last sampled, and GetResetTime() to get the time at which the
@@ -88,7 +88,16 @@ namespace Server {
      The counters in the program are kept in a singly-linked list formed during
      pre-main initialization.  The GetFirstCounter() and GetNextCounter()
      functions allow you to access this list.  The counters appear in no
-     particular order. */
+     particular order.
+
+     Each counter is split into TThreadShard::COUNT shards, each on its own
+     cache line, and each thread increments the shard for its shard index.
+     An increment takes only the lock for the caller's shard index, which is
+     shared by all counters and normally held by no other thread, so
+     concurrent increments don't contend.  Sample() takes the locks for all
+     shard indexes before summing the shards.  This blocks increments while
+     the sampled values are copied, giving a consistent snapshot of all
+     counters at a single moment in time. */
   class TCounter {
     NO_COPY_SEMANTICS(TCounter);
 
@@ -104,7 +113,7 @@ namespace Server {
     }
 
     /* The count as of the last time the counters were sampled. */
-    uint32_t GetCount() const {
+    uint64_t GetCount() const {
       assert(this);
       return SampledCount;
     }
@@ -124,10 +133,11 @@ namespace Server {
 
     /* Increment the counter.  This will not change the current frozen value,
        but will be reflected in the next frozen value. */
-    void Increment(uint32_t delta = 1) {
+    void Increment(uint64_t delta = 1) {
       assert(this);
-      TSharedLock<TBlockingAsset> lock(Asset);
-      __sync_add_and_fetch(&UnsampledCount, delta);
+      size_t index = Base::TThreadShard::GetIndex();
+      std::lock_guard<std::mutex> lock(ShardLocks[index].Mutex);
+      Shards[index].Count += delta;
     }
 
     /* The time of the most recent reset of the counters.
@@ -160,31 +170,51 @@ namespace Server {
     }
 
     private:
+    /* One slice of the count, padded to fill a cache line so that threads
+       using different shards don't share a line. */
+    struct alignas(64) TShard {
+      uint64_t Count;
+    };  // TShard
+
+    /* A lock for one shard index, padded like TShard. */
+    struct alignas(64) TShardLock {
+      std::mutex Mutex;
+    };  // TShardLock
+
+    /* Return the sum of all shards.  The caller must hold all shard
+       locks. */
+    uint64_t SumShards() const;
+
+    /* The currently incrementing count, split into shards.  The shards are
+       never cleared.  Instead, Sample() sums them and subtracts ResetBase to
+       get SampledCount. */
+    TShard Shards[Base::TThreadShard::COUNT];
+
     /* See accessor. */
     Base::TCodeLocation CodeLocation;
 
     /* See accessor. */
     const char *Name;
 
-    /* The currently incrementing count.  There is no direct access to this
-       variable; instead, the Sample() function adds this variable to
-       SampledCount, then sets this variable back to zero. */
-    uint32_t UnsampledCount;
+    /* The sum of the shards as of the last call to Sample(). */
+    uint64_t SampledTotal;
+
+    /* The value of SampledTotal as of the last call to Reset(). */
+    uint64_t ResetBase;
 
     /* See accessor. */
-    uint32_t SampledCount;
+    uint64_t SampledCount;
 
     /* See accessor. */
     TCounter *NextCounter;
 
-    /* We use this asset to coordinate the incrementing and freezing functions.
-       When any counter is incrementing, it acquires this asset in shared mode.
-       This allows multiple counters to be incrementing simultaneously with a
-       minimum of synchronization overhead.  During a freeze operation, this
-       asset is acquired exclusively, temporarily blocking all increments while
-       the frozen values are copied.  This allows us to get a consistent
-       snapshot of all counters at a single moment in time. */
-    static TBlockingAsset Asset;
+    /* Serializes Sample() and Reset().  Increments never acquire it.  When
+       both this and the shard locks are held, this is acquired first. */
+    static std::mutex SampleMutex;
+
+    /* Index is shard index.  An increment holds the lock for its shard
+       index, and Sample() holds all of them. */
+    static TShardLock ShardLocks[Base::TThreadShard::COUNT];
 
     /* See accessor. */
     static TCounter *FirstCounter;
@@ -24,6 +24,7 @@
 #include <cstdio>
 #include <cstring>
 #include <thread>
+#include <vector>
 #include <unistd.h>
 #include <sys/epoll.h>
   
@@ -42,7 +43,11 @@ using namespace Socket;
 namespace {
 
   SERVER_COUNTER(Connections);
+  SERVER_COUNTER(ManyThreads);
   SERVER_COUNTER(Requests);
+  SERVER_COUNTER(SnapshotAfter);
+  SERVER_COUNTER(SnapshotBefore);
+  SERVER_COUNTER(Wide);
   
   static const size_t BufSize = 1024;
   
@@ -174,6 +179,96 @@ namespace {
     ASSERT_FALSE(Requests.GetCount());
   }
 
+  TEST_F(TCounterTest, ManyThreads) {
+    static const size_t thread_count = 40;
+    static const uint64_t increment_count = 100000;
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back(
+          [] {
+            for (uint64_t j = 0; j < increment_count; ++j) {
+              ManyThreads.Increment();
+            }
+          });
+    }
+
+    /* Samples taken while the threads are running must never go backward. */
+    uint64_t prev = 0;
+
+    for (size_t i = 0; i < 100; ++i) {
+      TCounter::Sample();
+      uint64_t count = ManyThreads.GetCount();
+      ASSERT_GE(count, prev);
+      prev = count;
+    }
+
+    for (std::thread &t : threads) {
+      t.join();
+    }
+
+    TCounter::Sample();
+    ASSERT_EQ(ManyThreads.GetCount(), thread_count * increment_count);
+
+    /* Increments after a reset are counted from zero. */
+    TCounter::Reset();
+    ASSERT_EQ(ManyThreads.GetCount(), 0U);
+    ManyThreads.Increment(3);
+    TCounter::Sample();
+    ASSERT_EQ(ManyThreads.GetCount(), 3U);
+  }
+
+  TEST_F(TCounterTest, Snapshot) {
+    static const size_t thread_count = 8;
+    static const uint64_t increment_count = 100000;
+    std::vector<std::thread> threads;
+
+    /* Each thread increments 'SnapshotBefore' and then 'SnapshotAfter', so
+       at any single moment 'SnapshotBefore' is at least 'SnapshotAfter'.
+       Counters are sampled in reverse order of declaration, so
+       'SnapshotBefore' is read first.  Without a consistent snapshot,
+       increments made while Sample() is between the two could make
+       'SnapshotAfter' come out larger. */
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back(
+          [] {
+            for (uint64_t j = 0; j < increment_count; ++j) {
+              SnapshotBefore.Increment();
+              SnapshotAfter.Increment();
+            }
+          });
+    }
+
+    size_t bad_sample_count = 0;
+
+    for (size_t i = 0; i < 100000; ++i) {
+      TCounter::Sample();
+
+      if (SnapshotBefore.GetCount() < SnapshotAfter.GetCount()) {
+        ++bad_sample_count;
+      }
+    }
+
+    for (std::thread &t : threads) {
+      t.join();
+    }
+
+    ASSERT_EQ(bad_sample_count, 0U);
+    TCounter::Sample();
+    ASSERT_EQ(SnapshotBefore.GetCount(), thread_count * increment_count);
+    ASSERT_EQ(SnapshotAfter.GetCount(), thread_count * increment_count);
+  }
+
+  TEST_F(TCounterTest, Wide) {
+    /* Counts don't wrap at 32 bits. */
+    const uint64_t big = 1ULL << 32;
+    Wide.Increment(big);
+    Wide.Increment(big);
+    Wide.Increment();
+    TCounter::Sample();
+    ASSERT_EQ(Wide.GetCount(), (2 * big) + 1);
+  }
+
 }  // namespace
 
 int main(int argc, char **argv) {